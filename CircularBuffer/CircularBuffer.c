@@ -68,6 +68,7 @@ HLE_S32 CircularBufferFreeUserID(CircularBuffer_t *cBuf,HLE_S32 userid)
 	cBuf->userArray[userid].ReadCircleNum = 0;
 	cBuf->userArray[userid].diffpos = 0;
 	cBuf->userArray[userid].throwframcount = 0;
+	cBuf->userArray[userid].resynccount = 0;
 
 	return 0;
 }
@@ -106,6 +107,7 @@ HLE_S32 CircularBufferResetUserInfo(CircularBuffer_t *cBuf,HLE_S32 userid)
 	cBuf->userArray[userid].occupied = 1;//重置的用户都是已经在使用中的用户，注意别赋值为0 
 	cBuf->userArray[userid].diffpos = 0; 
 	cBuf->userArray[userid].throwframcount = 0; 
+	cBuf->userArray[userid].resynccount = 0;
 	
 	pthread_mutex_unlock(&cBuf->BufManageMutex);
 
@@ -176,6 +178,7 @@ CircularBuffer_t* CircularBufferCreate(E_IMAGE_SIZE resolution, HLE_U32 audioflg
 		FrameBufferPool->userArray[i].ReadCircleNum = 0;
 		FrameBufferPool->userArray[i].diffpos = 0;
 		FrameBufferPool->userArray[i].throwframcount = 0;
+		FrameBufferPool->userArray[i].resynccount = 0;
 	}
 	FrameBufferPool->bufStart = (HLE_U8*)FrameBufferPool + sizeof(CircularBuffer_t);
 	FrameBufferPool->bufSize = bufsize;
@@ -428,7 +431,7 @@ READ_AGAIN:	//重新读（读指针有重定位，或者异常）
 	if(cBuf->userArray[userID].ReadFrmIndex == cBuf->FrmList_w &&
 	   cBuf->userArray[userID].ReadCircleNum == cBuf->circleNum)
 	{
-		CBUF_ERROR_LOG("No frame data to be read!\n");
+		CBUF_DEBUG_LOG("No frame data to be read!\n");
 		pthread_mutex_unlock(&cBuf->BufManageMutex);
 		usleep(100);
 		goto READ_AGAIN;
@@ -444,7 +447,7 @@ READ_AGAIN:	//重新读（读指针有重定位，或者异常）
 		(cBuf->userArray[userID].ReadCircleNum < cBuf->circleNum))
 	{		
 		#if 1 //DEBUG
-		CBUF_ERROR_LOG("<output> change cycle,ReadFrmIndex = %d,TotalFrm=%d,ReadCircleNum=%lu,circlenum=%lu\n", 
+		CBUF_DEBUG_LOG("<output> change cycle,ReadFrmIndex = %d,TotalFrm=%d,ReadCircleNum=%lu,circlenum=%lu\n", 
 			cBuf->userArray[userID].ReadFrmIndex,cBuf->totalFrm,
 			cBuf->userArray[userID].ReadCircleNum,cBuf->circleNum);	 
 		#endif
@@ -453,7 +456,7 @@ READ_AGAIN:	//重新读（读指针有重定位，或者异常）
 		
 		if(cBuf->userArray[userID].ReadFrmIndex == cBuf->FrmList_w)//重绕后刚好碰见 “写指针” 索引，则无数据可读
 		{
-			CBUF_ERROR_LOG("No frame data to be read!\n");
+			CBUF_DEBUG_LOG("No frame data to be read!\n");
 			pthread_mutex_unlock(&cBuf->BufManageMutex);
 			usleep(100);
 			goto READ_AGAIN;
@@ -469,11 +472,10 @@ READ_AGAIN:	//重新读（读指针有重定位，或者异常）
 	  && cBuf->FrmList[cBuf->userArray[userID].ReadFrmIndex].frmStartPos < cBuf->writePos)
 	{
 		//表示读的太慢,跳转到当前写的位置（保证视频的实时性）
-		#if 1 //DEBUG
-		CBUF_ERROR_LOG("--------err: data recover,ReadFrmIndex = %d,TotalFrm=%d,ReadCircleNum=%lu,circlenum=%lu\n", 
-			cBuf->userArray[userID].ReadFrmIndex,cBuf->totalFrm,
-			cBuf->userArray[userID].ReadCircleNum,cBuf->circleNum);
-		#endif
+		if(0 == cBuf->userArray[userID].resynccount++ % CBUF_RESYNC_LOG_INTERVAL) //每次重定位都打印会拖慢读者，按间隔打印
+			CBUF_ERROR_LOG("--------err: data recover(%lu),ReadFrmIndex = %d,TotalFrm=%d,ReadCircleNum=%lu,circlenum=%lu\n", 
+				cBuf->userArray[userID].resynccount,cBuf->userArray[userID].ReadFrmIndex,cBuf->totalFrm,
+				cBuf->userArray[userID].ReadCircleNum,cBuf->circleNum);
 
 		cBuf->userArray[userID].ReadFrmIndex = cBuf->IFrmIndex_w;//跳转需要跳到I帧上，否则会引起视频花屏
 		cBuf->userArray[userID].ReadCircleNum = cBuf->circleNum;
@@ -488,10 +490,9 @@ READ_AGAIN:	//重新读（读指针有重定位，或者异常）
 	if(cBuf->circleNum - cBuf->userArray[userID].ReadCircleNum >= 2)
 	{
 		//*表示读的太慢,跳转到当前写的位置（因读指针数据已经被覆盖,且需保证视频的实时性）
-		#if 1
-		CBUF_ERROR_LOG("----err: data recover,circlenum:%lu, ReadCircleNum:%lu\n",
-			cBuf->circleNum, cBuf->userArray[userID].ReadCircleNum);
-		#endif
+		if(0 == cBuf->userArray[userID].resynccount++ % CBUF_RESYNC_LOG_INTERVAL)
+			CBUF_ERROR_LOG("----err: data recover(%lu),circlenum:%lu, ReadCircleNum:%lu\n",
+				cBuf->userArray[userID].resynccount,cBuf->circleNum, cBuf->userArray[userID].ReadCircleNum);
 		cBuf->userArray[userID].ReadFrmIndex = cBuf->IFrmIndex_w;//跳转需要跳到I帧上，否则会引起视频花屏
 		cBuf->userArray[userID].ReadCircleNum = cBuf->circleNum;
 		pthread_mutex_unlock(&cBuf->BufManageMutex);
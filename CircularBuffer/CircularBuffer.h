@@ -41,8 +41,11 @@ typedef struct _UserInfo_t
 	HLE_U32			ReadCircleNum;			/*此用户对帧缓冲池的访问圈数，初始时等于帧缓冲池中的circlenum*/
 	HLE_U32			diffpos;				/*读指针和写指针位置差值，单位为帧*/
 	HLE_U32 		throwframcount;			/*从开始计数丢帧的个数*/
+	HLE_U32			resynccount;			/*读指针被踩、重定位到最新I帧的次数*/
 }UserInfo_t;
 
+#define CBUF_RESYNC_LOG_INTERVAL	64		/*读指针重定位每这么多次打印一次（第一次总是打印）*/
+
 
 //一个 video/audio 帧在缓冲池的信息描述结构体
 typedef struct  _FrameInfo_t
@@ -0,0 +1,656 @@
+/***************************************************************************
+* @file: hls_http_cache.c
+* @author:
+* @date:  10,19,2026
+* @brief:  HTTP 数据源的分块缓存
+*			1.curl 句柄池：句柄用完不 cleanup，同一 host 优先复用同一句柄，
+*			  从而复用 keep-alive 连接，不必每次读都重新建连。
+*			2.按 HLS_HTTP_CACHE_BLOCK_SIZE 对齐的块缓存（LRU 淘汰），key 为 (URL, 块号)。
+*			3.一次读操作缺失的相邻块合并成一个 Range 请求；顺序读时额外预读，
+*			  解析 fMP4 时大量的小块读基本都能命中缓存。
+*			4.cache_ctx.lock 只保护缓存元数据，网络请求期间不持有：请求中的块标记为
+*			  BLOCK_LOADING，其它读到该块的线程在 block_cond 上等待，不会重复请求；
+*			  不同块的请求可以同时进行（最多 HLS_HTTP_HANDLE_NUM 个）。
+* @attention:
+***************************************************************************/
+#include "hls_http_cache.h"
+
+#ifdef HLS_HTTP_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <curl/curl.h>
+
+#include "mod_conf.h"
+#include "hls_print.h"
+
+#define BLOCK_FREE		(-1)
+
+/*---#缓存块状态------------------------------------------------------------*/
+#define BLOCK_READY		0		//数据有效
+#define BLOCK_LOADING	1		//请求进行中（不能被淘汰，读取者等待）
+
+typedef struct _http_handle_t
+{
+	CURL*			curl;
+	char			host[128];		//上一次请求的 host，同 host 复用该句柄的连接
+	int				busy;
+}http_handle_t;
+
+typedef struct _http_url_t
+{
+	int				used;
+	char			url[HLS_HTTP_URL_LEN];
+	long long		full_size;		//文件总大小（-1：未知）
+	long long		last_block;		//上一次读到的块号，用于判断是否顺序读
+	unsigned int	lru;
+}http_url_t;
+
+typedef struct _http_block_t
+{
+	int				url_id;			//BLOCK_FREE / urls[] 下标
+	int				state;			//BLOCK_READY / BLOCK_LOADING
+	int				stale;			//加载期间所属 URL 被淘汰或失效，加载完成后直接释放
+	long long		block_no;
+	int				len;			//块中有效数据长度（小于块大小说明到了文件末尾）
+	unsigned int	lru;
+	char*			data;
+}http_block_t;
+
+typedef struct _http_cache_ctx_t
+{
+	int					init_done;
+	pthread_mutex_t		lock;			//缓存元数据（urls/block/stat），网络请求期间不持有
+	pthread_cond_t		block_cond;		//有块加载完成（或失败）
+	pthread_mutex_t		handle_lock;
+	pthread_cond_t		handle_cond;
+	http_handle_t		handle[HLS_HTTP_HANDLE_NUM];
+	http_url_t			urls[HLS_HTTP_MAX_URLS];
+	http_block_t		block[HLS_HTTP_CACHE_BLOCKS];
+	char*				pool;			//所有缓存块的数据区（一次分配）
+	unsigned int		tick;
+	hls_http_cache_stat_t stat;
+}http_cache_ctx_t;
+
+static http_cache_ctx_t cache_ctx;
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;	//init/exit 互斥
+
+/*---#一次 Range 请求的上下文：收到的数据依次分散写入各个缓存块-------------------*/
+typedef struct _http_fetch_t
+{
+	http_block_t*	blk[HLS_HTTP_MAX_COALESCE];
+	int				n_blk;
+	long long		pos;			//已写入的字节数（相对请求起始位置）
+	long long		skip;			//服务器忽略 Range 返回 200 时需要跳过的字节数
+	long long		range_start;
+	int				http_code;
+	long long		full_size;
+	long			connects;		//本次请求新建的连接数
+}http_fetch_t;
+
+
+static void get_host(const char* url, char* host, int host_size)
+{
+	const char* p = strstr(url, "://");
+	int i = 0;
+
+	p = p ? p + 3 : url;
+	while(p[i] && p[i] != '/' && i < host_size - 1)
+	{
+		host[i] = p[i];
+		i++;
+	}
+	host[i] = 0;
+}
+
+/*******************************************************************************
+*@ Description    :从句柄池取一个 curl 句柄，同 host 的空闲句柄优先（可复用其 keep-alive 连接）
+*******************************************************************************/
+static http_handle_t* handle_acquire(const char* url)
+{
+	char host[128];
+	http_handle_t* h = NULL;
+	int i;
+
+	get_host(url, host, sizeof(host));
+	pthread_mutex_lock(&cache_ctx.handle_lock);
+	while(1)
+	{
+		for(i = 0; i < HLS_HTTP_HANDLE_NUM; i++)
+		{
+			if(cache_ctx.handle[i].busy)
+				continue;
+			if(0 == strcmp(cache_ctx.handle[i].host, host))
+			{
+				h = &cache_ctx.handle[i];
+				break;
+			}
+			if(NULL == h)
+				h = &cache_ctx.handle[i];
+		}
+		if(h)
+			break;
+		pthread_cond_wait(&cache_ctx.handle_cond, &cache_ctx.handle_lock);
+	}
+	h->busy = 1;
+	strcpy(h->host, host);
+	pthread_mutex_unlock(&cache_ctx.handle_lock);
+	return h;
+}
+
+static void handle_release(http_handle_t* h)
+{
+	pthread_mutex_lock(&cache_ctx.handle_lock);
+	h->busy = 0;
+	pthread_mutex_unlock(&cache_ctx.handle_lock);
+	pthread_cond_signal(&cache_ctx.handle_cond);
+}
+
+static size_t fetch_header_func(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+	http_fetch_t* f = (http_fetch_t*)userdata;
+	long long b, e, full;
+
+	if(!strncmp(ptr, "HTTP/", 5))
+	{
+		char* sp = strchr(ptr, ' ');
+		if(sp)
+			f->http_code = atoi(sp + 1);
+		f->full_size = -1; //重定向时会收到多组响应头，以最后一组为准
+	}
+	else if(!strncasecmp(ptr, "Content-Range:", 14))
+	{
+		//Content-Range: bytes 0-16383/123456
+		char* p = strstr(ptr, "bytes");
+		if(p && sscanf(p + 5, " %lld-%lld/%lld", &b, &e, &full) == 3)
+			f->full_size = full;
+	}
+	else if(!strncasecmp(ptr, "Content-Length:", 15) && f->full_size < 0)
+	{
+		//只有返回 200（整文件）时 Content-Length 才是文件大小，206 以 Content-Range 为准
+		f->full_size = -2 - atoll(ptr + 15);
+	}
+	return size * nmemb;
+}
+
+static size_t fetch_write_func(void* buffer, size_t size, size_t nmemb, void* userdata)
+{
+	http_fetch_t* f = (http_fetch_t*)userdata;
+	char* src = (char*)buffer;
+	long long bs = (long long)(size * nmemb);
+
+	if(f->http_code == 200 && f->skip < 0) //服务器不支持 Range，从文件开头跳到请求位置
+		f->skip = f->range_start;
+	if(f->skip > 0)
+	{
+		long long s = bs < f->skip ? bs : f->skip;
+		f->skip -= s;
+		src += s;
+		bs -= s;
+	}
+
+	while(bs > 0)
+	{
+		int idx = (int)(f->pos / HLS_HTTP_CACHE_BLOCK_SIZE);
+		int off = (int)(f->pos % HLS_HTTP_CACHE_BLOCK_SIZE);
+		int n;
+		if(idx >= f->n_blk) //多出的数据直接丢弃（服务器返回了整文件）
+			break;
+		n = HLS_HTTP_CACHE_BLOCK_SIZE - off;
+		if(n > bs)
+			n = (int)bs;
+		memcpy(f->blk[idx]->data + off, src, n);
+		f->blk[idx]->len = off + n;
+		f->pos += n;
+		src += n;
+		bs -= n;
+	}
+	return size * nmemb;
+}
+
+/*******************************************************************************
+*@ Description    :生成实际请求的 URL
+*@ Input          :<url>文件 URL <flags>FIRST_ACCESS：用户首次访问
+*@ Output         :<req_url>
+*@ attention      :除首次访问外都加上 access=server，源站据此区分服务端回源和用户访问
+*******************************************************************************/
+static void make_request_url(char* req_url, int req_size, const char* url, int flags)
+{
+	if (flags & HLS_HTTP_FIRST_ACCESS)
+		snprintf(req_url, req_size, "%s", url);
+	else
+		snprintf(req_url, req_size, "%s%caccess=server", url, strchr(url, '?') ? '&' : '?');
+}
+
+/*******************************************************************************
+*@ Description    :发出一个 Range 请求，填充 n_blk 个连续块
+*@ Return         :成功：0 失败：-1
+*@ attention      :不持有 cache_ctx.lock 调用，f->blk[] 处于 BLOCK_LOADING 状态，只有本线程写
+*******************************************************************************/
+static int fetch_blocks(const char* url, http_fetch_t* f, long long first_block)
+{
+	http_handle_t* h;
+	CURLcode res;
+	char range_str[64];
+
+	f->range_start = first_block * HLS_HTTP_CACHE_BLOCK_SIZE;
+	f->pos = 0;
+	f->skip = -1;
+	f->http_code = 0;
+	f->full_size = -1;
+	snprintf(range_str, sizeof(range_str), "%lld-%lld", f->range_start,
+			f->range_start + (long long)f->n_blk * HLS_HTTP_CACHE_BLOCK_SIZE - 1);
+
+	h = handle_acquire(url);
+	curl_easy_setopt(h->curl, CURLOPT_URL, url);
+	curl_easy_setopt(h->curl, CURLOPT_RANGE, range_str);
+	curl_easy_setopt(h->curl, CURLOPT_WRITEFUNCTION, fetch_write_func);
+	curl_easy_setopt(h->curl, CURLOPT_WRITEDATA, f);
+	curl_easy_setopt(h->curl, CURLOPT_HEADERFUNCTION, fetch_header_func);
+	curl_easy_setopt(h->curl, CURLOPT_HEADERDATA, f);
+	curl_easy_setopt(h->curl, CURLOPT_FOLLOWLOCATION, get_allow_redirect() ? 1L : 0L);
+	curl_easy_setopt(h->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(h->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(h->curl, CURLOPT_VERBOSE, 0L);
+
+	res = curl_easy_perform(h->curl);
+	curl_easy_getinfo(h->curl, CURLINFO_NUM_CONNECTS, &f->connects);
+	handle_release(h);
+
+	if(res != CURLE_OK || (f->http_code != 200 && f->http_code != 206))
+	{
+		HLS_ERROR_LOG("range request %s [%s] failed! res(%d) http_code(%d)\n", url, range_str, (int)res, f->http_code);
+		return -1;
+	}
+	if(f->full_size <= -2) //只有 Content-Length，仅在返回整文件（200）时可信
+		f->full_size = (f->http_code == 200) ? -2 - f->full_size : -1;
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :查找/分配缓存（调用者需持有 cache_ctx.lock）
+*******************************************************************************/
+static http_block_t* block_find(int url_id, long long block_no)
+{
+	int i;
+	for(i = 0; i < HLS_HTTP_CACHE_BLOCKS; i++)
+	{
+		if(cache_ctx.block[i].url_id == url_id && cache_ctx.block[i].block_no == block_no
+		   && !cache_ctx.block[i].stale)
+			return &cache_ctx.block[i];
+	}
+	return NULL;
+}
+
+/*释放某个 URL 的所有块，正在加载的块由加载线程完成后释放*/
+static void block_drop_url(int url_id)
+{
+	int i;
+	for(i = 0; i < HLS_HTTP_CACHE_BLOCKS; i++)
+	{
+		http_block_t* b = &cache_ctx.block[i];
+		if(b->url_id != url_id)
+			continue;
+		if(b->state == BLOCK_LOADING)
+			b->stale = 1;
+		else
+			b->url_id = BLOCK_FREE;
+	}
+}
+
+static http_block_t* block_alloc(void)
+{
+	http_block_t* victim = NULL;
+	int i;
+	for(i = 0; i < HLS_HTTP_CACHE_BLOCKS; i++)
+	{
+		http_block_t* b = &cache_ctx.block[i];
+		if(b->url_id == BLOCK_FREE)
+		{
+			victim = b;
+			break;
+		}
+		if(b->state != BLOCK_LOADING && (NULL == victim || b->lru < victim->lru))
+			victim = b;
+	}
+	if(victim)
+	{
+		victim->url_id = BLOCK_FREE;
+		victim->state = BLOCK_LOADING;
+		victim->stale = 0;
+		victim->len = 0;
+	}
+	return victim;
+}
+
+static int url_lookup(const char* url)
+{
+	int i;
+	int victim = -1;
+
+	for(i = 0; i < HLS_HTTP_MAX_URLS; i++)
+	{
+		if(cache_ctx.urls[i].used && 0 == strcmp(cache_ctx.urls[i].url, url))
+		{
+			cache_ctx.urls[i].lru = ++cache_ctx.tick;
+			return i;
+		}
+		if(victim < 0 || !cache_ctx.urls[i].used ||
+		   (cache_ctx.urls[victim].used && cache_ctx.urls[i].lru < cache_ctx.urls[victim].lru))
+			victim = i;
+	}
+
+	//淘汰最久未使用的 URL 及其所有缓存块
+	block_drop_url(victim);
+	memset(&cache_ctx.urls[victim], 0, sizeof(http_url_t));
+	cache_ctx.urls[victim].used = 1;
+	strncpy(cache_ctx.urls[victim].url, url, HLS_HTTP_URL_LEN - 1);
+	cache_ctx.urls[victim].full_size = -1;
+	cache_ctx.urls[victim].last_block = -2;
+	cache_ctx.urls[victim].lru = ++cache_ctx.tick;
+	return victim;
+}
+
+/*******************************************************************************
+*@ Description    :从 block_no 开始，把连续缺失的块（最多 want 个）合并成一个请求取回
+*@ Return         :成功：0 失败：-1
+*@ attention      :调用时持有 cache_ctx.lock，请求期间释放，返回时重新持有；
+					返回后 url_id 可能已被其它 URL 占用，调用者需重新 url_lookup
+*******************************************************************************/
+static int fetch_run(int url_id, long long block_no, int want, int flags)
+{
+	http_url_t* u = &cache_ctx.urls[url_id];
+	http_fetch_t f;
+	char url[HLS_HTTP_URL_LEN];
+	char req_url[HLS_HTTP_URL_LEN + 16];
+	int ret;
+	int i;
+
+	if(want > HLS_HTTP_MAX_COALESCE)
+		want = HLS_HTTP_MAX_COALESCE;
+	if(u->full_size >= 0)
+	{
+		long long last = (u->full_size + HLS_HTTP_CACHE_BLOCK_SIZE - 1) / HLS_HTTP_CACHE_BLOCK_SIZE - 1;
+		if(block_no + want - 1 > last)
+			want = (int)(last - block_no + 1);
+		if(want <= 0)
+			return -1;
+	}
+
+	memset(&f, 0, sizeof(f));
+	for(i = 0; i < want; i++)
+	{
+		if(i > 0 && block_find(url_id, block_no + i)) //遇到已缓存或正在加载的块就停止合并
+			break;
+		f.blk[i] = block_alloc();
+		if(NULL == f.blk[i])
+			break;
+		f.blk[i]->url_id = url_id;
+		f.blk[i]->block_no = block_no + i;
+		f.n_blk++;
+	}
+	if(f.n_blk == 0)
+		return -1;
+
+	strcpy(url, u->url);
+	make_request_url(req_url, sizeof(req_url), url, flags);
+	pthread_mutex_unlock(&cache_ctx.lock);
+	ret = fetch_blocks(req_url, &f, block_no);
+	pthread_mutex_lock(&cache_ctx.lock);
+
+	cache_ctx.stat.requests++;
+	cache_ctx.stat.connects += f.connects;
+	cache_ctx.stat.bytes_fetched += f.pos;
+
+	//请求期间 URL 可能被淘汰（块被标记为 stale），此时不更新文件大小
+	if(0 == ret && f.full_size >= 0 && !f.blk[0]->stale && u->used && 0 == strcmp(u->url, url))
+		u->full_size = f.full_size;
+	for(i = 0; i < f.n_blk; i++)
+	{
+		http_block_t* b = f.blk[i];
+		b->state = BLOCK_READY;
+		if(ret < 0 || b->stale)
+		{
+			b->url_id = BLOCK_FREE;
+			b->stale = 0;
+		}
+		else
+		{
+			b->lru = ++cache_ctx.tick;
+		}
+	}
+	pthread_cond_broadcast(&cache_ctx.block_cond);
+	return ret;
+}
+
+/*******************************************************************************
+*@ Description    :初始化（分配缓存块和 curl 句柄）
+*@ Return         :成功：0 失败：-1
+*******************************************************************************/
+int hls_http_cache_init(void)
+{
+	int i;
+
+	pthread_mutex_lock(&init_lock);
+	if(cache_ctx.init_done)
+	{
+		pthread_mutex_unlock(&init_lock);
+		return 0;
+	}
+
+	memset(&cache_ctx, 0, sizeof(cache_ctx));
+	cache_ctx.pool = (char*)malloc(HLS_HTTP_CACHE_BLOCKS * HLS_HTTP_CACHE_BLOCK_SIZE);
+	if(NULL == cache_ctx.pool)
+	{
+		HLS_ERROR_LOG("malloc cache pool failed!\n");
+		pthread_mutex_unlock(&init_lock);
+		return -1;
+	}
+	for(i = 0; i < HLS_HTTP_CACHE_BLOCKS; i++)
+	{
+		cache_ctx.block[i].url_id = BLOCK_FREE;
+		cache_ctx.block[i].data = cache_ctx.pool + i * HLS_HTTP_CACHE_BLOCK_SIZE;
+	}
+
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+	for(i = 0; i < HLS_HTTP_HANDLE_NUM; i++)
+	{
+		cache_ctx.handle[i].curl = curl_easy_init();
+		if(NULL == cache_ctx.handle[i].curl)
+		{
+			HLS_ERROR_LOG("curl_easy_init failed!\n");
+			goto ERR;
+		}
+	}
+
+	pthread_mutex_init(&cache_ctx.lock, NULL);
+	pthread_cond_init(&cache_ctx.block_cond, NULL);
+	pthread_mutex_init(&cache_ctx.handle_lock, NULL);
+	pthread_cond_init(&cache_ctx.handle_cond, NULL);
+	cache_ctx.init_done = 1;
+	pthread_mutex_unlock(&init_lock);
+	return 0;
+
+ERR:
+	for(i = 0; i < HLS_HTTP_HANDLE_NUM; i++)
+	{
+		if(cache_ctx.handle[i].curl) curl_easy_cleanup(cache_ctx.handle[i].curl);
+	}
+	free(cache_ctx.pool);
+	memset(&cache_ctx, 0, sizeof(cache_ctx));
+	pthread_mutex_unlock(&init_lock);
+	return -1;
+}
+
+/*******************************************************************************
+*@ Description    :释放缓存和 curl 句柄（关闭 keep-alive 连接）
+*@ attention      :调用时不能有其它线程在读
+*******************************************************************************/
+void hls_http_cache_exit(void)
+{
+	int i;
+
+	pthread_mutex_lock(&init_lock);
+	if(!cache_ctx.init_done)
+	{
+		pthread_mutex_unlock(&init_lock);
+		return;
+	}
+
+	HLS_DEBUG_LOG("http cache: read_calls(%u) hits(%u) misses(%u) waits(%u) requests(%u) connects(%u) bytes(%lld)\n",
+			cache_ctx.stat.read_calls, cache_ctx.stat.block_hits, cache_ctx.stat.block_misses, cache_ctx.stat.block_waits,
+			cache_ctx.stat.requests, cache_ctx.stat.connects, cache_ctx.stat.bytes_fetched);
+	for(i = 0; i < HLS_HTTP_HANDLE_NUM; i++)
+		curl_easy_cleanup(cache_ctx.handle[i].curl);
+	curl_global_cleanup();
+	pthread_cond_destroy(&cache_ctx.handle_cond);
+	pthread_mutex_destroy(&cache_ctx.handle_lock);
+	pthread_cond_destroy(&cache_ctx.block_cond);
+	pthread_mutex_destroy(&cache_ctx.lock);
+	free(cache_ctx.pool);
+	memset(&cache_ctx, 0, sizeof(cache_ctx));
+	pthread_mutex_unlock(&init_lock);
+}
+
+/*******************************************************************************
+*@ Description    :读取远端文件的一段数据
+*@ Input          :<url>文件 URL
+					<offset>相对文件开始的偏移
+					<size>读取长度
+					<flags>HLS_HTTP_FIRST_ACCESS：用户首次访问（请求不加 access=server）
+*@ Output         :<out_buf>
+*@ Return         :实际读取的长度（到文件末尾时小于 size），失败：-1
+*@ attention      :
+*******************************************************************************/
+int hls_http_cache_read(const char* url, char* out_buf, long long offset, int size, int flags)
+{
+	int url_id;
+	int done = 0;
+	long long last_block;
+	long long pos = offset;
+
+	if(!cache_ctx.init_done || NULL == url || NULL == out_buf || offset < 0 || size < 0)
+		return -1;
+
+	pthread_mutex_lock(&cache_ctx.lock);
+	cache_ctx.stat.read_calls++;
+	last_block = (offset + size - 1) / HLS_HTTP_CACHE_BLOCK_SIZE;
+
+	while(done < size)
+	{
+		long long bno = pos / HLS_HTTP_CACHE_BLOCK_SIZE;
+		int boff = (int)(pos % HLS_HTTP_CACHE_BLOCK_SIZE);
+		http_block_t* blk;
+		int n;
+
+		//每次都重新查找：释放锁期间 URL 可能被淘汰后分配到别的下标
+		url_id = url_lookup(url);
+		blk = block_find(url_id, bno);
+		if(NULL == blk)
+		{
+			//本次读需要的剩余块一次取回；顺序读时预读满 HLS_HTTP_MAX_COALESCE 块
+			int want = (int)(last_block - bno + 1);
+			if(cache_ctx.urls[url_id].last_block + 1 >= bno && cache_ctx.urls[url_id].last_block <= bno)
+				want = HLS_HTTP_MAX_COALESCE;
+			cache_ctx.stat.block_misses++;
+			if(fetch_run(url_id, bno, want, flags) < 0)
+			{
+				pthread_mutex_unlock(&cache_ctx.lock);
+				return done > 0 ? done : -1;
+			}
+			continue;
+		}
+		if(blk->state == BLOCK_LOADING)
+		{
+			//其它线程正在取这个块，等它完成（失败时块被释放，下一轮自己取）
+			cache_ctx.stat.block_waits++;
+			pthread_cond_wait(&cache_ctx.block_cond, &cache_ctx.lock);
+			continue;
+		}
+		cache_ctx.stat.block_hits++;
+
+		blk->lru = ++cache_ctx.tick;
+		cache_ctx.urls[url_id].last_block = bno;
+		if(boff >= blk->len) //文件末尾
+			break;
+		n = blk->len - boff;
+		if(n > size - done)
+			n = size - done;
+		memcpy(out_buf + done, blk->data + boff, n);
+		done += n;
+		pos += n;
+		if(blk->len < HLS_HTTP_CACHE_BLOCK_SIZE && boff + n >= blk->len)
+			break;
+	}
+
+	pthread_mutex_unlock(&cache_ctx.lock);
+	return done;
+}
+
+/*******************************************************************************
+*@ Description    :获取远端文件大小（未知时读取第一块，同时缓存文件头）
+*@ Input          :<url>文件 URL <flags>同 hls_http_cache_read
+*@ Return         :成功：文件大小 失败：-1
+*******************************************************************************/
+long long hls_http_cache_get_size(const char* url, int flags)
+{
+	char tmp[1];
+	long long size;
+	int url_id;
+
+	if(!cache_ctx.init_done || NULL == url)
+		return -1;
+
+	pthread_mutex_lock(&cache_ctx.lock);
+	url_id = url_lookup(url);
+	size = cache_ctx.urls[url_id].full_size;
+	pthread_mutex_unlock(&cache_ctx.lock);
+	if(size >= 0)
+		return size;
+
+	if(hls_http_cache_read(url, tmp, 0, sizeof(tmp), flags) < 0)
+		return -1;
+
+	pthread_mutex_lock(&cache_ctx.lock);
+	url_id = url_lookup(url);
+	size = cache_ctx.urls[url_id].full_size;
+	pthread_mutex_unlock(&cache_ctx.lock);
+	return size;
+}
+
+/*******************************************************************************
+*@ Description    :丢弃某个 URL 的所有缓存块（远端文件更新时调用）
+*******************************************************************************/
+void hls_http_cache_invalidate(const char* url)
+{
+	int i;
+
+	if(!cache_ctx.init_done || NULL == url)
+		return;
+
+	pthread_mutex_lock(&cache_ctx.lock);
+	for(i = 0; i < HLS_HTTP_MAX_URLS; i++)
+	{
+		if(cache_ctx.urls[i].used && 0 == strcmp(cache_ctx.urls[i].url, url))
+		{
+			block_drop_url(i);
+			memset(&cache_ctx.urls[i], 0, sizeof(http_url_t));
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cache_ctx.lock);
+}
+
+void hls_http_cache_get_stat(hls_http_cache_stat_t* stat)
+{
+	if(NULL == stat)
+		return;
+	pthread_mutex_lock(&cache_ctx.lock);
+	memcpy(stat, &cache_ctx.stat, sizeof(hls_http_cache_stat_t));
+	pthread_mutex_unlock(&cache_ctx.lock);
+}
+
+#endif /*HLS_HTTP_SOURCE*/
+
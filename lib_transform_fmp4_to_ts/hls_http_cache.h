@@ -0,0 +1,44 @@
+/***************************************************************************
+* @file: hls_http_cache.h
+* @author:
+* @date:  10,19,2026
+* @brief:  HTTP 数据源的分块缓存：curl 句柄复用（keep-alive）+ 按块对齐的 LRU 缓存
+*			+ 相邻缺失块合并成一次 Range 请求
+* @attention:HLS_HTTP_SOURCE 打开时 http:// 开头的源文件经本模块读取，需要链接 libcurl；
+*			 目标没有 libcurl 时注释掉该定义（hls_file.c 只保留本地文件数据源）
+***************************************************************************/
+#ifndef _HLS_HTTP_CACHE_H
+#define _HLS_HTTP_CACHE_H
+
+#define HLS_HTTP_SOURCE							//打开 HTTP 数据源
+
+#define HLS_HTTP_CACHE_BLOCK_SIZE	(16*1024)	//缓存块大小（Range 请求按该大小对齐）
+#define HLS_HTTP_CACHE_BLOCKS		64			//缓存块个数（总缓存 = 1M）
+#define HLS_HTTP_MAX_COALESCE		8			//一次 Range 请求最多合并的块数（含预读）
+#define HLS_HTTP_HANDLE_NUM			2			//curl 句柄池大小
+#define HLS_HTTP_MAX_URLS			8			//同时缓存的 URL 个数
+#define HLS_HTTP_URL_LEN			1024
+
+#define HLS_HTTP_FIRST_ACCESS		1			//用户首次访问（与 hls_file.h 的 FIRST_ACCESS 相同），其余请求加 access=server
+
+/*---#缓存命中统计------------------------------------------------------------*/
+typedef struct _hls_http_cache_stat_t
+{
+	unsigned int	read_calls;		//hls_http_cache_read 调用次数
+	unsigned int	block_hits;		//命中的块数
+	unsigned int	block_misses;	//未命中的块数
+	unsigned int	block_waits;	//等待其它线程正在加载的块的次数
+	unsigned int	requests;		//实际发出的 HTTP 请求数
+	unsigned int	connects;		//新建连接数（未能复用 keep-alive 连接）
+	long long		bytes_fetched;	//从网络取回的字节数
+}hls_http_cache_stat_t;
+
+int hls_http_cache_init(void);
+void hls_http_cache_exit(void);
+long long hls_http_cache_get_size(const char* url, int flags);
+int hls_http_cache_read(const char* url, char* out_buf, long long offset, int size, int flags);
+void hls_http_cache_invalidate(const char* url);
+void hls_http_cache_get_stat(hls_http_cache_stat_t* stat);
+
+#endif
+
@@ -14,6 +14,7 @@
 #include "mod_conf.h"
 #include "typeport.h"
 #include "hls_main.h"
+#include "hls_http_cache.h"
 
 
 //#include "lame/lame.h"
@@ -1061,6 +1062,9 @@ void hls_main_exit(hls_out_info_t* hls_info)
 
 	if(media_stats_info.stats_buffer) {free(media_stats_info.stats_buffer); media_stats_info.stats_buffer = NULL;}
 	if(file_source_info.source) {free(file_source_info.source);file_source_info.source = NULL;}
+#ifdef HLS_HTTP_SOURCE
+	hls_http_cache_exit();	//HTTP 数据源的缓存和 keep-alive 连接（下次 http_open 时重新初始化）
+#endif
 }
 
 extern void hls_file_global_variable_reset(void);
@@ -25,6 +25,7 @@
 #include <arpa/inet.h>
 #include <math.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include "Box.h"
 #include "my_inet.h"
 
@@ -678,214 +679,82 @@ int* read_stco(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_sou
 
 
 /*
-功能：获取fmp4文件 一个traf-->trun 音视频 	   帧的大小，数组指针
-参数：
-	@size_array:(返回)每个帧的大小数组指针,如果没有该字段则返回 NULL
-	@flags_array:(返回)每个帧的flags数组指针，如果没有该字段则返回 NULL
-返回：成功：数组元素个数		   		失败：-1
-注意：使用后需要（先判断不为空） free(size_array)  			  		free(flags_array) 
+fmp4文件的 sample 表：
+	所有 moof-->traf(tfhd/tfdt/trun) 只遍历一次，每个 trun box 整块读入内存后再解析，
+	结果按 SoA（structure of arrays）排列在同一块连续内存中：
+	------------------------------------------------------------------------------------------------
+	| V_dts | V_pts | A_dts | V_size | V_offset | V_flags | A_size | A_offset |
+	|-----(long long, 以各自 trak 的 timescale 为单位)-----|---------(unsigned int)-----------------|
+	------------------------------------------------------------------------------------------------
+	文件模式下表会序列化到 <mp4文件名>.stbl，同一录像再次切片时直接加载，跳过 moof 解析。
 */
-int get_fmp4_sample_size_and_flags(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* traf,int**size_array,int**flags_array)
-{
-	if(NULL == mp4 || NULL == source || NULL == traf)
-	{
-		ERROR_LOG("Illegal parameter !\n");
-		return -1;
-	}
-
-	unsigned int flag = 0; //该flag是box头部的flag，非samples的flag，不能混淆
-	unsigned int Sample_count = 0;//当前trun下的 samples（帧） 个数
-	unsigned int first_size_offset = 0;//第一个size数据开始的位置偏移
-	unsigned int first_flag_offset = 0;//第一个flag数据开始的位置偏移
-	unsigned int size_offset = 0; //统计 两个size 字段之间的距离(flags之间的偏移等于size_offset)
-	MP4_BOX* trun =  find_box(traf, "trun");
-	if(trun)
-	{
-		//sample_count
-		source->read(mp4_file,mp4, &Sample_count, 4, trun->box_first_byte + 12, 0);
-		Sample_count = t_ntohl(Sample_count);
-		int *size_array_tmp = (int *)HLS_MALLOC(context, sizeof(int) * Sample_count);
-		if(NULL == size_array_tmp)
-		{
-			ERROR_LOG("malloc failed !\n");
-			return -1;
-		}
-
-		int *flags_array_tmp = (int *)HLS_MALLOC(context, sizeof(int) * Sample_count);
-		if(NULL == flags_array_tmp)
-		{
-			ERROR_LOG("malloc failed !\n");
-			HLS_FREE(size_array_tmp);
-			return -1;
-		}
-		
-
-		//flag  注意值占 3 字节 
-		source->read(mp4_file,mp4, &flag, 4, trun->box_first_byte + 8, 0);
-		DEBUG_LOG("flag = %x\n",flag);
-		
-		flag = t_ntohl(flag);
-		flag = flag & 0x00FFFFFF; //去掉最高位一个字节
-		
-		DEBUG_LOG("flag = %x\n",flag);
-
-		/*---计算读取第一个 sample_size 的偏移位置----------------------*/
-		first_size_offset = trun->box_first_byte + 16 ; //计算到sample_count字段
-		first_flag_offset = trun->box_first_byte + 16 ; //计算到sample_count字段
-		
-		//以下两个字段为可选字段，不一定每个mp4文件都填充，所以需判断flag来动态变换 first_size_offset 的偏移长度
-		if(flag & E_data_offset)
-		{
-			first_size_offset += 4;
-			first_flag_offset += 4;
-			//DEBUG_LOG("E_data_offset\n");
-		}
-			
-		if(flag & E_first_sample_flags)
-		{
-			first_size_offset += 4;
-			first_flag_offset += 4;
-			//DEBUG_LOG("E_first_sample_flags\n");
-		}
-			
-		if(flag & E_sample_duration)
-		{
-			first_size_offset += 4;
-			first_flag_offset += 4;
-			//DEBUG_LOG("E_sample_duration\n");
-
-		}
-		DEBUG_LOG("first_size_offset = %d\n",first_size_offset);
-
-		if(flag & E_sample_size)
-		{
-			first_flag_offset += 4;
-			//DEBUG_LOG("E_sample_size\n");
-		}
-		
-		/*------------------------------------------------------------------*/
-
-		/*---统计两个sample_size 字段之间的间隔字节数-------------------*/
-		if(flag & E_sample_duration)
-		{
-			size_offset += 4;
-			//DEBUG_LOG("E_sample_duration\n");
-		}
-			
-		if(flag & E_sample_size)
-		{
-			size_offset += 4;
-			//DEBUG_LOG("E_sample_size\n");
-		}
-			
-		if(flag & E_sample_flags)
-		{
-			size_offset += 4;
-			//DEBUG_LOG("E_sample_size\n");
-		}
-			
-		if(flag & E_sample_composition_time_offset)
-		{
-			size_offset += 4;
-			//DEBUG_LOG("E_sample_size\n");
-		}
-			
-
-		DEBUG_LOG("size_offset = %d\n",size_offset);
-		/*------------------------------------------------------------------*/
-
-		//开始填充 size_array 信息数组
-		int i = 0;
-		for (i=0 ; i<Sample_count ; i++)
-		{
-			if(flag & E_sample_size)
-			{
-				source->read(mp4_file,mp4, &size_array_tmp[i], 4 , first_size_offset + i*size_offset , 0);
-				size_array_tmp[i] = t_ntohl(size_array_tmp[i]);
-			}
-			
-			
-			if(flag & E_sample_flags)
-			{
-				source->read(mp4_file,mp4, &flags_array_tmp[i], 4 , first_flag_offset + i*size_offset , 0);
-				flags_array_tmp[i] = t_ntohl(flags_array_tmp[i]);			
-			}
-			DEBUG_LOG("flags_array_tmp[%d] = %u\n",i,flags_array_tmp[i]);
-			usleep(5);
-		}
-
-		if(flag & E_sample_size)
-		{
-			*size_array = size_array_tmp;
-		}
-		else
-		{
-			HLS_FREE(size_array_tmp);
-			size_array_tmp = NULL;
-			*flags_array = NULL;
-		}
-		
-
-		if(flag & E_sample_flags)
-		{
-			*flags_array = flags_array_tmp;
-		}
-		else
-		{
-			HLS_FREE(flags_array_tmp);
-			flags_array_tmp = NULL;
-			*flags_array = NULL;
-		}
-			
-
-		return Sample_count;
-		
-	}
-
-	return -1;
-	
-
-}
-
-
-
-
-
-
-
-/*
-//fmp4文件Sample count 信息描述结构(video/audio 帧在每个mdat box中的sample（帧）数量信息)
-typedef struct _sample_count_t
+#define SAMPLE_TABLE_MAGIC		0x4C425453		//"STBL"
+#define SAMPLE_TABLE_VERSION	2
+#define SAMPLE_TABLE_POSTFIX	".stbl"
+#define SAMPLE_TABLE_INIT_NUM	512				//首次分配的 sample 个数（不够时按 2 倍扩容）
+#define SAMPLE_TABLE_MAX_NUM	(1 << 24)		//单个轨道 sample 个数上限（block 大小不超过 32 位）
+
+//tfhd flags
+#define TFHD_BASE_DATA_OFFSET			0x000001
+#define TFHD_SAMPLE_DESCRIPTION_INDEX	0x000002
+#define TFHD_DEFAULT_SAMPLE_DURATION	0x000008
+#define TFHD_DEFAULT_SAMPLE_SIZE		0x000010
+#define TFHD_DEFAULT_SAMPLE_FLAGS		0x000020
+
+typedef struct _sample_table_t
 {
 	unsigned int	init_done;		//初始化已经完成 1：完成 			 0：未完成（未完成不能使用）
-	unsigned int 	V_trun_num;		//视频 trun box 的总个数----对应 mdat box总个数
-	unsigned int* 	V_sample_array;	//视频Sample count 信息数组的头指针
-	unsigned int 	A_trun_num;		//音频 trun box 的总个数----对应 mdat box总个数
-	unsigned int*	A_sample_array;	//音频Sample count 信息数组的头指针
-}sample_count_t;
-
-sample_count_t sample_count = {0};	//描述音视频 Sample count 信息。(video/audio 帧在每个mdat box中的sample（帧）数量信息)
-*/
-
-
-//fmp4文件samples（帧）大小 + flags 信息描述结构
+	unsigned int 	V_sample_num;	//视频sample（帧）的总个数
+	unsigned int 	A_sample_num;	//音频sample（帧）的总个数
+	unsigned int	V_capacity;		//当前 block 能容纳的视频 sample 个数
+	unsigned int	A_capacity;		//当前 block 能容纳的音频 sample 个数
+	long long*		V_dts;			//视频帧 dts（trak timescale 单位，第一帧为 0）
+	long long*		V_pts;			//视频帧 pts = dts + composition_time_offset
+	long long*		A_dts;			//音频帧 dts（trak timescale 单位，第一帧为 0）
+	unsigned int*	V_size;
+	unsigned int*	V_offset;		//相对于文件开头
+	unsigned int*	V_flags;		//trun 中原始的 sample_flags
+	unsigned int*	A_size;
+	unsigned int*	A_offset;
+	char*			block;			//以上数组共用的一块内存
+	unsigned int	block_size;
+}sample_table_t;
+
+static sample_table_t sample_table = {0};
+
+/*---#序列化文件头--------------------------------------------------------------*/
+typedef struct _sample_table_file_head_t
+{
+	unsigned int	magic;
+	unsigned int	version;
+	unsigned int	mp4_size;		//源文件大小，不一致说明缓存已过期
+	unsigned int	mp4_mtime;		//源文件修改时间，不一致说明缓存已过期（同名文件被覆盖、大小不变）
+	int				V_trak_id;
+	int				A_trak_id;
+	unsigned int	V_sample_num;
+	unsigned int	A_sample_num;
+	unsigned int	block_size;
+	unsigned int	checksum;		//block 的 FNV-1a 校验
+}sample_table_file_head_t;
+
+
+//fmp4文件samples（帧）大小 + flags 信息描述结构（指向 sample_table 中的数组，不单独分配内存）
 typedef struct _sample_size_t
 {
 	unsigned int	init_done;		//初始化已经完成 1：完成 			 0：未完成（未完成不能使用）
 	unsigned int 	V_sample_num;	//视频sample（帧）的总个数
 	unsigned int* 	V_size_array;	//每个视频sample（帧）大小信息数据的头指针
 	unsigned int* 	V_flags_array;	//每个视频sample（帧）flags信息数据的头指针
-	
+
 	unsigned int 	A_sample_num;	//音频sample（帧）的总个数
 	unsigned int*	A_size_array;	//每个音频sample（帧）大小信息数据的头指针
-	//unsigned int*	A_flags_array;	//每个音频sample（帧）flags信息数据的头指针 (audio 一般不需要该参数)
 }sample_size_t;
 
 sample_size_t sample_size = {0};	//描述音视频sample大小信息。
 
 
 
-//fmp4文件samples（帧）偏移信息描述结构
+//fmp4文件samples（帧）偏移信息描述结构（指向 sample_table 中的数组，不单独分配内存）
 typedef struct _sample_offset_t
 {
 	unsigned int	init_done;		//初始化已经完成 1：完成 			 0：未完成（未完成不能使用）
@@ -897,535 +766,572 @@ typedef struct _sample_offset_t
 
 sample_offset_t sample_offset = {0};	//描述音视频 sample 偏移信息。
 
+
+static unsigned int sample_table_calc_block_size(unsigned int V_num,unsigned int A_num)
+{
+	return (V_num * 2 + A_num) * sizeof(long long) + (V_num * 3 + A_num * 2) * sizeof(unsigned int);
+}
+
+/*按 SoA 布局把各数组指针指向 block（8 字节的数组放在前边，保证对齐）*/
+static void sample_table_layout(sample_table_t* tab,char* block,unsigned int V_num,unsigned int A_num)
+{
+	char* p = block;
+	tab->V_dts = (long long*)p;		p += V_num * sizeof(long long);
+	tab->V_pts = (long long*)p;		p += V_num * sizeof(long long);
+	tab->A_dts = (long long*)p;		p += A_num * sizeof(long long);
+	tab->V_size = (unsigned int*)p;	p += V_num * sizeof(unsigned int);
+	tab->V_offset = (unsigned int*)p;	p += V_num * sizeof(unsigned int);
+	tab->V_flags = (unsigned int*)p;	p += V_num * sizeof(unsigned int);
+	tab->A_size = (unsigned int*)p;	p += A_num * sizeof(unsigned int);
+	tab->A_offset = (unsigned int*)p;
+	tab->block = block;
+	tab->block_size = sample_table_calc_block_size(V_num,A_num);
+}
+
 /*
-初始化 全局参数 sample_size
-即初始化（整个文件）video/audio帧的 size 信息
-返回：
-	成功：0	
-	失败：-1
-注意：在调用该接口前需确保 video_frames 和 audio_frames已经初始化
+计算能放下 num + add 个 sample 的容量（按 2 倍扩容，不超过 SAMPLE_TABLE_MAX_NUM）
+返回：成功：0	超过上限：-1
 */
-int init_sample_size_array(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* root)
+static int sample_table_grow(unsigned int num,unsigned int add,unsigned int* cap)
 {
-	if(NULL == mp4 || NULL == source || NULL == root)
+	if(num > SAMPLE_TABLE_MAX_NUM || add > SAMPLE_TABLE_MAX_NUM - num)
+		return -1;
+	if(*cap == 0)
+		*cap = SAMPLE_TABLE_INIT_NUM;
+	while(*cap < num + add)
+		*cap = (*cap > SAMPLE_TABLE_MAX_NUM / 2) ? SAMPLE_TABLE_MAX_NUM : *cap * 2;
+	return 0;
+}
+
+/*
+扩容 sample 表（保证能再放下 V_add 个视频帧、A_add 个音频帧）
+返回：成功：0	失败：-1
+*/
+static int sample_table_reserve(void* context,sample_table_t* tab,unsigned int V_add,unsigned int A_add)
+{
+	unsigned int V_cap = tab->V_capacity;
+	unsigned int A_cap = tab->A_capacity;
+	sample_table_t new_tab;
+	char* block = NULL;
+
+	if(sample_table_grow(tab->V_sample_num,V_add,&V_cap) < 0 || sample_table_grow(tab->A_sample_num,A_add,&A_cap) < 0)
 	{
-		ERROR_LOG("Illegal parameter !\n");
+		ERROR_LOG("too many samples ! V(%u + %u) A(%u + %u)\n",tab->V_sample_num,V_add,tab->A_sample_num,A_add);
 		return -1;
 	}
-	
-	if(frame_info.inited != 1)
+	if(V_cap == tab->V_capacity && A_cap == tab->A_capacity && tab->block)
+		return 0;
+
+	block = (char*)HLS_MALLOC(context,sample_table_calc_block_size(V_cap,A_cap));
+	if(NULL == block)
 	{
-		ERROR_LOG("frame num not init!\n");
+		ERROR_LOG("malloc failed ! V_cap(%u) A_cap(%u)\n",V_cap,A_cap);
 		return -1;
 	}
 
-	if(sample_size.init_done) //不能够反复初始化
+	memset(&new_tab,0,sizeof(new_tab));
+	sample_table_layout(&new_tab,block,V_cap,A_cap);
+	if(tab->block)
 	{
-	 	DEBUG_LOG("sample_size Already initialized !\n");
-	 	return 0;
+		memcpy(new_tab.V_dts,tab->V_dts,tab->V_sample_num * sizeof(long long));
+		memcpy(new_tab.V_pts,tab->V_pts,tab->V_sample_num * sizeof(long long));
+		memcpy(new_tab.A_dts,tab->A_dts,tab->A_sample_num * sizeof(long long));
+		memcpy(new_tab.V_size,tab->V_size,tab->V_sample_num * sizeof(unsigned int));
+		memcpy(new_tab.V_offset,tab->V_offset,tab->V_sample_num * sizeof(unsigned int));
+		memcpy(new_tab.V_flags,tab->V_flags,tab->V_sample_num * sizeof(unsigned int));
+		memcpy(new_tab.A_size,tab->A_size,tab->A_sample_num * sizeof(unsigned int));
+		memcpy(new_tab.A_offset,tab->A_offset,tab->A_sample_num * sizeof(unsigned int));
+		HLS_FREE(tab->block);
 	}
 
-	/*---初始化全局参数sample_size------------------------------------------------------------------*/
-	sample_size.V_sample_num = frame_info.video_frames;
-	sample_size.A_sample_num = frame_info.audio_frames;
-	sample_size.V_size_array = HLS_MALLOC(context, frame_info.video_frames * sizeof(int));
-	if(NULL == sample_size.V_size_array)
+	new_tab.V_sample_num = tab->V_sample_num;
+	new_tab.A_sample_num = tab->A_sample_num;
+	new_tab.V_capacity = V_cap;
+	new_tab.A_capacity = A_cap;
+	*tab = new_tab;
+	return 0;
+}
+
+/*把 block 收缩成紧凑布局（V_capacity == V_sample_num），便于直接序列化*/
+static int sample_table_shrink(void* context,sample_table_t* tab)
+{
+	sample_table_t old = *tab;
+	char* block = NULL;
+
+	if(tab->V_capacity == tab->V_sample_num && tab->A_capacity == tab->A_sample_num)
+		return 0;
+
+	block = (char*)HLS_MALLOC(context,sample_table_calc_block_size(old.V_sample_num,old.A_sample_num) + 1);
+	if(NULL == block)
 	{
 		ERROR_LOG("malloc failed !\n");
 		return -1;
 	}
+	sample_table_layout(tab,block,old.V_sample_num,old.A_sample_num);
+	memcpy(tab->V_dts,old.V_dts,old.V_sample_num * sizeof(long long));
+	memcpy(tab->V_pts,old.V_pts,old.V_sample_num * sizeof(long long));
+	memcpy(tab->A_dts,old.A_dts,old.A_sample_num * sizeof(long long));
+	memcpy(tab->V_size,old.V_size,old.V_sample_num * sizeof(unsigned int));
+	memcpy(tab->V_offset,old.V_offset,old.V_sample_num * sizeof(unsigned int));
+	memcpy(tab->V_flags,old.V_flags,old.V_sample_num * sizeof(unsigned int));
+	memcpy(tab->A_size,old.A_size,old.A_sample_num * sizeof(unsigned int));
+	memcpy(tab->A_offset,old.A_offset,old.A_sample_num * sizeof(unsigned int));
+	tab->V_capacity = old.V_sample_num;
+	tab->A_capacity = old.A_sample_num;
+	HLS_FREE(old.block);
+	return 0;
+}
 
-	sample_size.V_flags_array = HLS_MALLOC(context, frame_info.video_frames * sizeof(int));
-	if(NULL == sample_size.V_flags_array)
+static unsigned int sample_table_checksum(const char* buf,unsigned int size)
+{
+	unsigned int h = 2166136261u;
+	unsigned int i;
+	for(i = 0; i < size; i++)
 	{
-		ERROR_LOG("malloc failed !\n");
-		HLS_FREE(sample_size.V_size_array);
-		sample_size.V_size_array = NULL;
+		h ^= (unsigned char)buf[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static unsigned int read_be32(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+/*
+解析一个 traf（tfhd + tfdt + trun），把其中的 sample 追加到 sample_table
+@next_dts：(输入/输出) 该轨道下一个 sample 的 dts（tfdt 存在时以 tfdt 为准）
+返回：成功：追加的 sample 个数	失败：-1
+*/
+static int sample_table_add_traf(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,
+										MP4_BOX* moof,MP4_BOX* traf,long long* V_next_dts,long long* A_next_dts)
+{
+	unsigned char head[48] = {0};
+	unsigned char* trun_buf = NULL;
+	unsigned char* p = NULL;
+	unsigned char* end = NULL;
+	unsigned int tf_flags,tr_flags;
+	unsigned int default_duration = 0,default_size = 0,default_flags = 0;
+	unsigned int first_flags = 0;
+	unsigned int count,max_count,i;
+	unsigned int bytes_per_sample = 0;
+	long long base = moof->box_first_byte;		//没有 base_data_offset 时以 moof 开始位置为基准（default-base-is-moof）
+	long long data_pos;
+	long long* next_dts;
+	int track_id;
+	int is_video;
+	MP4_BOX* tfhd = find_box(traf,"tfhd");
+	MP4_BOX* tfdt = find_box(traf,"tfdt");
+	MP4_BOX* trun = find_box(traf,"trun");
+
+	if(NULL == tfhd || NULL == trun)
+	{
+		ERROR_LOG("traf without tfhd/trun!\n");
 		return -1;
 	}
 
-	sample_size.A_size_array = HLS_MALLOC(context, frame_info.audio_frames * sizeof(int));
-	if(NULL == sample_size.A_size_array)
+	/*---tfhd：track_id + 可选的默认值（按 flags 依次排列）-------------------------*/
+	source->read(mp4_file,mp4,head,tfhd->box_size < (int)sizeof(head) ? tfhd->box_size : (int)sizeof(head),tfhd->box_first_byte,0);
+	tf_flags = read_be32(head + 8) & 0x00FFFFFF;
+	track_id = (int)read_be32(head + 12);
+	if(track_id == get_video_trak_id())
+		is_video = 1;
+	else if(track_id == get_audio_trak_id())
+		is_video = 0;
+	else
+	{
+		ERROR_LOG("unknown track_id(%d) !\n",track_id);
+		return 0;
+	}
+	next_dts = is_video ? V_next_dts : A_next_dts;
+
+	p = head + 16;
+	if(tf_flags & TFHD_BASE_DATA_OFFSET)
+	{
+		base = ((long long)read_be32(p) << 32) | read_be32(p + 4);
+		p += 8;
+	}
+	if(tf_flags & TFHD_SAMPLE_DESCRIPTION_INDEX)
+		p += 4;
+	if(tf_flags & TFHD_DEFAULT_SAMPLE_DURATION)
+	{
+		default_duration = read_be32(p);
+		p += 4;
+	}
+	if(tf_flags & TFHD_DEFAULT_SAMPLE_SIZE)
+	{
+		default_size = read_be32(p);
+		p += 4;
+	}
+	if(tf_flags & TFHD_DEFAULT_SAMPLE_FLAGS)
+		default_flags = read_be32(p);
+
+	/*---tfdt：baseMediaDecodeTime（version 1 为 64 位）----------------------------*/
+	if(tfdt)
+	{
+		memset(head,0,sizeof(head));
+		source->read(mp4_file,mp4,head,20,tfdt->box_first_byte,0);
+		if(1 == head[8])
+			*next_dts = ((long long)read_be32(head + 12) << 32) | read_be32(head + 16);
+		else
+			*next_dts = read_be32(head + 12);
+	}
+
+	/*---trun：整块读入再解析，避免逐字段调用 source->read-------------------------*/
+	if(trun->box_size < 16)
+	{
+		ERROR_LOG("trun too small ! box_size(%d)\n",trun->box_size);
+		return -1;
+	}
+	trun_buf = (unsigned char*)HLS_MALLOC(context,trun->box_size);
+	if(NULL == trun_buf)
 	{
 		ERROR_LOG("malloc failed !\n");
-		HLS_FREE(sample_size.V_size_array);
-		sample_size.V_size_array = NULL;
-		HLS_FREE(sample_size.V_flags_array);
-		sample_size.V_flags_array = NULL;
 		return -1;
 	}
-	/*-----------------------------------------------------------------------------------------------*/	
-	
-	/*===获取每个音视频帧的 大小信息数组==============================================================*/
-	//1.找出所有moof box节点，构成moof节点数组
-	MP4_BOX** moof_array = NULL;
-	MP4_BOX** traf_array = NULL;
-	unsigned int delta_counter = 0;
-	unsigned int V_index = 0;
-	unsigned int A_index = 0;
-	int i = 0;
-	
-	int moof_num = find_box_one_level(context,root,"moof",&moof_array);
-	DEBUG_LOG("moof_num = %d\n",moof_num);
-	for(i=0 ; i<moof_num ; i++)
+	if(source->read(mp4_file,mp4,trun_buf,trun->box_size,trun->box_first_byte,0) != trun->box_size)
 	{
-		int traf_num = find_box_one_level(context,moof_array[i],"traf",&traf_array);
-		DEBUG_LOG("moof_array[%d] --> traf_num = %d\n",i,traf_num);
-		int j = 0;
-		for(j=0 ; j<traf_num ; j++)
-		{
-			/*---区分开 video/audio traf 的根节点---*/	
-			//先解析tfhd确定当前traf的trak_id
-			int track_id;
-			MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-			if(NULL == tfhd)
-			{
-				ERROR_LOG("find_box failed!\n");
-				goto ERR;
-			}
-			else
-			{
-				source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-				track_id = t_ntohl(track_id);
-				
-			}
+		ERROR_LOG("read trun failed !\n");
+		HLS_FREE(trun_buf);
+		return -1;
+	}
+	end = trun_buf + trun->box_size;
+	tr_flags = read_be32(trun_buf + 8) & 0x00FFFFFF;
+	count = read_be32(trun_buf + 12);
+	p = trun_buf + 16;
 
-			if(track_id == get_video_trak_id()) // 是 video traf
-			{
-				int* size_array = NULL;
-				int* flags_array = NULL;
-				int array_num = 0;
-				DEBUG_LOG("parse video  traf_array[%d].......................\n",j);
-				array_num = get_fmp4_sample_size_and_flags(mp4_file,context,mp4,source,traf_array[j],&size_array,&flags_array);
-				if(array_num <= 0)
-				{
-					ERROR_LOG("get_fmp4_sample_size_and_flags failed!\n");
-					if(NULL != size_array)
-						HLS_FREE(size_array);
-					if(NULL != flags_array)
-						HLS_FREE(flags_array);
-					goto ERR;
-				}
-				//DEBUG_LOG("memcpy(&sample_size.V_size_array[V_index],size_array,array_num*sizeof(int));\n");
+	data_pos = base;
+	if(tr_flags & E_data_offset)
+	{
+		data_pos = base + (int)read_be32(p);
+		p += 4;
+	}
+	if(tr_flags & E_first_sample_flags)
+	{
+		first_flags = read_be32(p);
+		p += 4;
+	}
+	if(p > end)
+	{
+		ERROR_LOG("trun truncated ! box_size(%d) flags(0x%x)\n",trun->box_size,tr_flags);
+		HLS_FREE(trun_buf);
+		return -1;
+	}
 
-				if(NULL != size_array)
-					memcpy(&sample_size.V_size_array[V_index],size_array,array_num*sizeof(int));
+	/*sample_count 来自文件，不可信：按 box 剩余的字节数（或文件大小）限制，再扩容*/
+	if(tr_flags & E_sample_duration)					bytes_per_sample += 4;
+	if(tr_flags & E_sample_size)						bytes_per_sample += 4;
+	if(tr_flags & E_sample_flags)						bytes_per_sample += 4;
+	if(tr_flags & E_sample_composition_time_offset)	bytes_per_sample += 4;
+	if(bytes_per_sample > 0)
+		max_count = (unsigned int)(end - p) / bytes_per_sample;
+	else	//没有逐帧字段：每个 sample 至少占 1 字节
+		max_count = (unsigned int)source->get_file_size(mp4_file,mp4,0) / (default_size > 0 ? default_size : 1);
+	if(count > max_count)
+	{
+		ERROR_LOG("trun sample_count(%u) exceeds box, clamp to %u\n",count,max_count);
+		count = max_count;
+	}
 
-				if(NULL != flags_array)
-					memcpy(&sample_size.V_flags_array[V_index],flags_array,array_num*sizeof(int));
-				
-				V_index += array_num;
+	if(sample_table_reserve(context,&sample_table,is_video ? count : 0,is_video ? 0 : count) < 0)
+	{
+		HLS_FREE(trun_buf);
+		return -1;
+	}
 
-				/*
-				DEBUG_LOG("sample_size.V_flags_array[0] = %d sample_size.V_flags_array[1] = %d sample_size.V_flags_array[2] = %d\n",
-							sample_size.V_flags_array[0],sample_size.V_flags_array[1],sample_size.V_flags_array[2]);
-				*/
-				
-				if(NULL != size_array)
-					HLS_FREE(size_array);
-				if(NULL != flags_array)
-					HLS_FREE(flags_array);
-			}
+	for(i = 0; i < count; i++)
+	{
+		unsigned int duration = default_duration;
+		unsigned int size = default_size;
+		unsigned int flags = (0 == i && (tr_flags & E_first_sample_flags)) ? first_flags : default_flags;
+		int cts = 0;
 
-			if(track_id == get_audio_trak_id()) // 是 audio traf
-			{
-				int* size_array = NULL;
-				int* flags_array = NULL;
-				int array_num = 0;
-				DEBUG_LOG("parse audio  traf_array[%d].......................\n",j);
-				array_num = get_fmp4_sample_size_and_flags(mp4_file,context,mp4,source,traf_array[j],&size_array,&flags_array);
-				if(array_num <= 0)
-				{
-					ERROR_LOG("get_fmp4_sample_size_and_flags failed!\n");
-					if(NULL != size_array)
-						HLS_FREE(size_array);
-					if(NULL != flags_array)
-						HLS_FREE(flags_array);
-					goto ERR;
-				}
-				memcpy(&sample_size.A_size_array[A_index],size_array,array_num*sizeof(int));
-				A_index += array_num;
+		if(tr_flags & E_sample_duration)	{ if(p + 4 > end) break; duration = read_be32(p); p += 4; }
+		if(tr_flags & E_sample_size)		{ if(p + 4 > end) break; size = read_be32(p); p += 4; }
+		if(tr_flags & E_sample_flags)		{ if(p + 4 > end) break; flags = read_be32(p); p += 4; }
+		if(tr_flags & E_sample_composition_time_offset)	{ if(p + 4 > end) break; cts = (int)read_be32(p); p += 4; }
 
-				if(NULL != size_array)
-					HLS_FREE(size_array);
-				if(NULL != flags_array)
-					HLS_FREE(flags_array);
-				
-			}
-			
+		if(is_video)
+		{
+			unsigned int n = sample_table.V_sample_num++;
+			sample_table.V_dts[n] = *next_dts;
+			sample_table.V_pts[n] = *next_dts + cts;
+			sample_table.V_size[n] = size;
+			sample_table.V_offset[n] = (unsigned int)data_pos;
+			sample_table.V_flags[n] = flags;
 		}
-			
+		else
+		{
+			unsigned int n = sample_table.A_sample_num++;
+			sample_table.A_dts[n] = *next_dts;
+			sample_table.A_size[n] = size;
+			sample_table.A_offset[n] = (unsigned int)data_pos;
+		}
+		*next_dts += duration;
+		data_pos += size;
 	}
-	sample_size.init_done = 1;
 
-	
-	/*============================================================================================*/
-	/*--DEBUG------------------------------------*/
-	if(frame_info.video_frames != V_index || frame_info.audio_frames != A_index)
+	HLS_FREE(trun_buf);
+	if(i != count)
 	{
-		ERROR_LOG("video_frames(%d) != V_index(%d) \n",frame_info.video_frames,V_index);
-		ERROR_LOG("aideo_frames(%d) != V_index(%d) \n",frame_info.audio_frames,A_index);
+		ERROR_LOG("trun truncated ! sample_count(%u) parsed(%u)\n",count,i);
+		return -1;
 	}
-	/*-------------------------------------------*/
-	
-	HLS_FREE(traf_array);
-	HLS_FREE(moof_array);
-	return 0;
-ERR:
-	HLS_FREE(traf_array);
-	HLS_FREE(moof_array);
-	return -1;
-
+	return count;
 }
 
-
 /*
-初始化全局参数 sample_offset
-即初始化（整个文件）video/audio帧  的 offset信息
-返回：
-	成功：0	
-	失败-1
-注意：在调用该接口前需确保 video_frames 和 audio_frames已经初始化
+一次遍历所有 moof，建立 sample 表
+返回：成功：0	失败：-1
 */
-int init_sample_offset_array(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* root)
+static int sample_table_build(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* root)
 {
-	if(NULL == mp4 || NULL == source || NULL == root)
-	{
-		ERROR_LOG("Illegal parameter !\n");
-		return -1;
-	}
-	
-	if(frame_info.inited != 1)
-	{
-		ERROR_LOG("frame num not init!\n");
-		return -1;
-	}
-	
-	if(sample_offset.init_done) //不能够反复初始化
-	{
-		DEBUG_LOG("sample_offset Already initialized !\n");
-		return 0;
-	}
-
-	unsigned int Vtrun_num = 0; //video trun box的个数
-	unsigned int Atrun_num = 0; //audio trun box的个数
-	unsigned int* Vtrun_sample_array = NULL; //记录每个 video trun里边 sample_count 字段信息
-	unsigned int* Atrun_sample_array = NULL; //记录每个 audio trun里边 sample_count 字段信息
 	MP4_BOX** moof_array = NULL;
 	MP4_BOX** traf_array = NULL;
-	MP4_BOX** mdat_array = NULL;
+	long long V_next_dts = 0;
+	long long A_next_dts = 0;
+	int moof_num,traf_num;
+	int i,j;
 
-	int traf_num = 0;
-	int moof_num = 0;
-	int i = 0;
-	int j = 0;
-	int track_id = -1;
-	
-	/*---确定 Audio trun box 和 Video trun box 的个数----------------------------------------------------------*/
-	
 	moof_num = find_box_one_level(context,root,"moof",&moof_array);
-	if(moof_num < 0)
+	if(moof_num <= 0)
 	{
-		ERROR_LOG("find_box_one_level!\n");
-		goto ERR;
+		ERROR_LOG("find_box_one_level moof failed!\n");
+		return -1;
 	}
-	
 	DEBUG_LOG("moof_num = %d\n",moof_num);
 
-	for(i=0 ; i<moof_num ; i++)
+	for(i = 0; i < moof_num; i++)
 	{
 		traf_num = find_box_one_level(context,moof_array[i],"traf",&traf_array);
-		DEBUG_LOG("moof_array[%d] --> traf_num = %d\n",i,traf_num);
-
-		for(j=0 ; j<traf_num ; j++)
+		if(traf_num < 0)
 		{
-			/*---区分开 video/audio traf 的根节点---*/	
-			//先解析tfhd确定当前traf的trak_id
-			MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-			if(NULL == tfhd)
-			{
-				ERROR_LOG("find_box failed!\n");
+			ERROR_LOG("find_box_one_level traf failed!\n");
+			goto ERR;
+		}
+		for(j = 0; j < traf_num; j++)
+		{
+			if(sample_table_add_traf(mp4_file,context,mp4,source,moof_array[i],traf_array[j],&V_next_dts,&A_next_dts) < 0)
 				goto ERR;
-			}
-			else
-			{
-				source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-				track_id = t_ntohl(track_id);
-				
-			}
-
-			if(track_id == get_video_trak_id()) // 是 video traf
-			{
-				if(find_box(traf_array[j], "trun") != NULL)
-					Vtrun_num ++ ;
-				
-			}
-
-			if(track_id == get_audio_trak_id()) // 是 audio traf
-			{
-				if(find_box(traf_array[j], "trun") != NULL)
-					Atrun_num ++ ;
-			}
-			
 		}
-
-		HLS_FREE(traf_array); 
+		HLS_FREE(traf_array);
 		traf_array = NULL;
 	}
-	//HLS_FREE(moof_array); 后边直接用，结尾再释放，减少CPU冗余计算
-	//moof_array = NULL;
-		
-	if(Vtrun_num != Atrun_num ||moof_num != Vtrun_num)
+	HLS_FREE(moof_array);
+	moof_array = NULL;
+
+	/*dts 从 0 开始（tfdt 里的是录像开始后的绝对时间）*/
+	if(sample_table.V_sample_num > 0)
 	{
-		ERROR_LOG("moof_num(%d) != Vtrun_num(%d) != Atrun_num(%d) !\n",moof_num,Vtrun_num,Atrun_num);
-		goto ERR;
+		long long first = sample_table.V_dts[0];
+		for(i = 0; i < (int)sample_table.V_sample_num; i++)
+		{
+			sample_table.V_dts[i] -= first;
+			sample_table.V_pts[i] -= first;
+		}
 	}
-
-	/*---分配数组的内存，记录每个 video/audio trun box 里边的 samples（帧）数量--------------------------------*/
-
-	Atrun_sample_array = (unsigned int *)HLS_MALLOC(context, Atrun_num * sizeof(int));
-	if(NULL == Atrun_sample_array)
+	if(sample_table.A_sample_num > 0)
 	{
-		ERROR_LOG("malloc failed !\n");
-		goto ERR;
+		long long first = sample_table.A_dts[0];
+		for(i = 0; i < (int)sample_table.A_sample_num; i++)
+			sample_table.A_dts[i] -= first;
 	}
 
-	Vtrun_sample_array = (unsigned int *)HLS_MALLOC(context, Vtrun_num * sizeof(int));
-	if(NULL == Vtrun_sample_array)
-	{
-		ERROR_LOG("malloc failed !\n");
+	if(sample_table_shrink(context,&sample_table) < 0)
 		goto ERR;
-	}
-	
-	/*----初始化  数组元素(Vtrun_sample_array[]/Atrun_sample_array[])--------------------------------------------*/
-	/*
-		确定mdat box里边的samples数据，video/audio         samples 谁填充在前边，谁在后边
-		即确定video/audio trak 的先后顺序:
-		在 traf[0]下解析 tfhd 确定traf[0] 的 trak_id 是 哪个，即能确定哪个trak在前边
-	*/
-	int first_track = -1; //video/audio 轨道的先后顺序（mdat box里边谁的数据排在前边）
-	
-	/* D
-	moof_num = find_box_one_level(context,root,"moof",&moof_array);
-	*/
-	unsigned int Atrun_index = 0;  
-	unsigned int Vtrun_index = 0;
-	
-	for(i=0 ; i<moof_num ; i++)
-	{
-		traf_num = find_box_one_level(context,moof_array[i],"traf",&traf_array);
-	
-		for(j=0 ; j<traf_num ; j++)
-		{
-			if(0 == i && 0 == j)//由第一个 moof 的第一个 traf 来确定排在前边的轨道是video 还是 audio 轨道
-			{
-				MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-				if(NULL == tfhd)
-				{
-					ERROR_LOG("find_box failed!\n");
-					goto ERR;
-				}
-				else
-				{
-					source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-					track_id = t_ntohl(track_id);
-					first_track = track_id;
-				}
-			
-			}
+	return 0;
 
-	
-			/*---区分开 video/audio traf 的根节点---*/	
-			//先解析tfhd确定当前traf的trak_id
-			int track_id;
-			MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-			if(NULL == tfhd)
-			{
-				ERROR_LOG("find_box failed!\n");
-				goto ERR; 
-			}
-			else
-			{
-				source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-				track_id = t_ntohl(track_id);
-				
-			}
+ERR:
+	if(NULL != traf_array)
+		HLS_FREE(traf_array);
+	if(NULL != moof_array)
+		HLS_FREE(moof_array);
+	if(NULL != sample_table.block)
+		HLS_FREE(sample_table.block);
+	memset(&sample_table,0,sizeof(sample_table));
+	return -1;
+}
 
-			MP4_BOX* trun =  find_box(traf_array[j],"trun");
-			if(NULL == tfhd)
-			{
-				ERROR_LOG("find_box failed!\n");
-				goto ERR;
-			}
+/*源文件的修改时间（取不到返回 0，0 不作为有效的缓存）*/
+static unsigned int sample_table_mtime(FILE_info_t* mp4_file)
+{
+	struct stat st;
+	if(stat(mp4_file->file_name,&st) < 0)
+		return 0;
+	return (unsigned int)st.st_mtime;
+}
 
-			if(track_id == get_video_trak_id()) // 是 video traf
-			{
-				unsigned int sample_count = 0;
-				source->read(mp4_file,mp4,&sample_count,4,trun->box_first_byte+12,0);
-				sample_count = t_ntohl(sample_count);
-				Vtrun_sample_array[Vtrun_index] = sample_count;
-				Vtrun_index ++;				
-			}
+/*
+从 <mp4文件名>.stbl 加载 sample 表（只在文件模式下使用）
+返回：成功：0	失败（文件不存在/已过期/损坏）：-1
+*/
+static int sample_table_load(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source)
+{
+	char path[64];
+	sample_table_file_head_t head;
+	char* block = NULL;
+	FILE* fp = NULL;
+	unsigned int mtime;
 
-			if(track_id == get_audio_trak_id()) // 是 audio traf
-			{
-				unsigned int sample_count = 0;
-				source->read(mp4_file,mp4,&sample_count,4,trun->box_first_byte+12,0);
-				sample_count = t_ntohl(sample_count);
-				Atrun_sample_array[Atrun_index] = sample_count;
-				Atrun_index ++;				
-			}
-				
-		}
-		HLS_FREE(traf_array);
-		traf_array = NULL;
-			
-	}
-	//HLS_FREE(moof_array);
-	//moof_array = NULL;
-	
-	if(Vtrun_index != Vtrun_num ||Atrun_index != Atrun_num)
+	if(HLS_FILE_MODE != get_run_mode())
+		return -1;
+	mtime = sample_table_mtime(mp4_file);
+	if(0 == mtime)
+		return -1;
+
+	snprintf(path,sizeof(path),"%s%s",mp4_file->file_name,SAMPLE_TABLE_POSTFIX);
+	fp = fopen(path,"rb");
+	if(NULL == fp)
+		return -1;
+
+	if(fread(&head,1,sizeof(head),fp) != sizeof(head) ||
+		SAMPLE_TABLE_MAGIC != head.magic || SAMPLE_TABLE_VERSION != head.version ||
+		head.mp4_size != (unsigned int)source->get_file_size(mp4_file,mp4,0) || head.mp4_mtime != mtime ||
+		head.V_sample_num > SAMPLE_TABLE_MAX_NUM || head.A_sample_num > SAMPLE_TABLE_MAX_NUM ||
+		head.V_trak_id != get_video_trak_id() || head.A_trak_id != get_audio_trak_id() ||
+		head.block_size != sample_table_calc_block_size(head.V_sample_num,head.A_sample_num))
 	{
-		ERROR_LOG("Vtrun_index(%d) != Vtrun_num(%d) ||Atrun_index(%d) != Atrun_num(%d) !\n",Vtrun_index,Vtrun_num,Atrun_index,Atrun_num);
+		DEBUG_LOG("%s is stale, rebuild\n",path);
+		fclose(fp);
 		return -1;
 	}
-	
-	/*---初始化全局参数sample_offset------------------------------------------------------------------*/
-	sample_offset.V_sample_num = frame_info.video_frames;
-	sample_offset.A_sample_num = frame_info.audio_frames;
-	sample_offset.V_offset_array = HLS_MALLOC(context, frame_info.video_frames * sizeof(int));
-	if(NULL == sample_offset.V_offset_array)
+
+	block = (char*)HLS_MALLOC(context,head.block_size + 1);
+	if(NULL == block)
 	{
 		ERROR_LOG("malloc failed !\n");
-		goto ERR;
+		fclose(fp);
+		return -1;
 	}
-
-	sample_offset.A_offset_array = HLS_MALLOC(context, frame_info.audio_frames * sizeof(int));
-	if(NULL == sample_offset.A_offset_array)
+	if(fread(block,1,head.block_size,fp) != head.block_size ||
+		sample_table_checksum(block,head.block_size) != head.checksum)
 	{
-		ERROR_LOG("malloc failed !\n");
-		goto ERR;//所有全局指针变量指向的内存统一在线程最后退出时释放。
+		ERROR_LOG("%s corrupted, rebuild\n",path);
+		HLS_FREE(block);
+		fclose(fp);
+		return -1;
 	}
+	fclose(fp);
 
-	
-	/*===获取每个音视频帧的 偏移信息数组==============================================================*/
-
-	unsigned int  V_offset_index = 0; 	//sample_offset->V_offset_array 的下标值
-	unsigned int  A_offset_index = 0; 	//sample_offset->A_offset_array 的下标值
-	unsigned int  V_size_index = 0; 	//sample_size->V_size_array的下标值
-	unsigned int  A_size_index = 0; 	//sample_size->A_size_array的下标值
+	memset(&sample_table,0,sizeof(sample_table));
+	sample_table_layout(&sample_table,block,head.V_sample_num,head.A_sample_num);
+	sample_table.V_sample_num = sample_table.V_capacity = head.V_sample_num;
+	sample_table.A_sample_num = sample_table.A_capacity = head.A_sample_num;
+	DEBUG_LOG("load %s : video(%u) audio(%u)\n",path,head.V_sample_num,head.A_sample_num);
+	return 0;
+}
 
-	if(frame_info.inited != 1)
-	{
-		ERROR_LOG("frame num not init!\n");
-		goto ERR;
+/*把 sample 表写到 <mp4文件名>.stbl（先写临时文件再 rename，写失败不影响本次切片）*/
+static void sample_table_save(FILE_info_t* mp4_file, file_handle_t* mp4, file_source_t* source)
+{
+	char path[64];
+	char tmp_path[64];
+	sample_table_file_head_t head;
+	FILE* fp = NULL;
+
+	if(HLS_FILE_MODE != get_run_mode())
+		return;
+	memset(&head,0,sizeof(head));
+	head.mp4_mtime = sample_table_mtime(mp4_file);
+	if(0 == head.mp4_mtime)		//没有修改时间无法判断是否过期，不保存
+		return;
+
+	snprintf(path,sizeof(path),"%s%s",mp4_file->file_name,SAMPLE_TABLE_POSTFIX);
+	snprintf(tmp_path,sizeof(tmp_path),"%s.tmp",path);
+
+	head.magic = SAMPLE_TABLE_MAGIC;
+	head.version = SAMPLE_TABLE_VERSION;
+	head.mp4_size = (unsigned int)source->get_file_size(mp4_file,mp4,0);
+	head.V_trak_id = get_video_trak_id();
+	head.A_trak_id = get_audio_trak_id();
+	head.V_sample_num = sample_table.V_sample_num;
+	head.A_sample_num = sample_table.A_sample_num;
+	head.block_size = sample_table.block_size;
+	head.checksum = sample_table_checksum(sample_table.block,sample_table.block_size);
+
+	fp = fopen(tmp_path,"wb");
+	if(NULL == fp)
+	{
+		ERROR_LOG("open %s failed !\n",tmp_path);
+		return;
+	}
+	if(fwrite(&head,1,sizeof(head),fp) != sizeof(head) ||
+		fwrite(sample_table.block,1,sample_table.block_size,fp) != sample_table.block_size)
+	{
+		ERROR_LOG("write %s failed !\n",tmp_path);
+		fclose(fp);
+		remove(tmp_path);
+		return;
+	}
+	fclose(fp);
+	if(rename(tmp_path,path) < 0)
+	{
+		ERROR_LOG("rename %s failed !\n",tmp_path);
+		remove(tmp_path);
 	}
-	
-	int mdat_num = find_box_one_level(context,root,"mdat",&mdat_array);
-	DEBUG_LOG("mdat_num = %d\n",mdat_num);
-	if(mdat_num != moof_num )
+}
+
+/*
+初始化 sample 表：优先加载序列化的 .stbl，没有（或已过期）再解析 moof 并保存
+同时设置 frame_info 中的音视频帧数
+返回：成功：0	失败：-1
+*/
+int init_sample_table(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* root)
+{
+	if(NULL == mp4 || NULL == source || NULL == root)
 	{
-		ERROR_LOG("moof num != mdat num !\n");
-		goto ERR;
+		ERROR_LOG("Illegal parameter !\n");
+		return -1;
 	}
 
-	if(mdat_num != Atrun_index || mdat_num != Vtrun_index )
+	if(sample_table.init_done) //不能够反复初始化
 	{
-		ERROR_LOG("mdat_num(%d) Atrun_index(%d) Vtrun_index(%d)\n",mdat_num,Atrun_index,Vtrun_index);
-		goto ERR;
+		DEBUG_LOG("sample_table Already initialized !\n");
+		return 0;
 	}
-	
-	for(i=0 ; i<mdat_num ; i++)  
+
+	if(sample_table_load(mp4_file,context,mp4,source) < 0)
 	{
-		if(first_track == get_video_trak_id()) //在前边的是video帧
+		if(sample_table_build(mp4_file,context,mp4,source,root) < 0)
 		{
-			unsigned int V_start_pos = mdat_array[i]->box_first_byte + 8;	//记录 mdat box video 数据部分开始位置
-			unsigned int A_start_pos = mdat_array[i]->box_first_byte + 8;	//记录 mdat box audio 数据部分开始位置
-			unsigned int j = 0; 
-			unsigned int count_V_sample_size = 0;
-			unsigned int count_A_sample_size = 0;
-			for(j=0 ; j < Vtrun_sample_array[i] ; j++) //记录视频帧的偏移
-			{
-				sample_offset.V_offset_array[V_offset_index] = 	V_start_pos + count_V_sample_size;
-				V_offset_index ++;
-				count_V_sample_size += sample_size.V_size_array[V_size_index];
-				V_size_index ++;
-				A_start_pos += count_V_sample_size; //音频sample开始位置偏移到视频sample的后边	
-			}
-
-			for(j=0 ; j < Atrun_sample_array[i] ; j++) //记录音频帧的偏移
-			{
-			
-				sample_offset.A_offset_array[A_offset_index] = 	A_start_pos + count_A_sample_size;
-				A_offset_index ++;
-				count_A_sample_size +=  sample_size.A_size_array[A_size_index];
-				A_size_index ++;	
-			}
-			
+			ERROR_LOG("sample_table_build failed !\n");
+			return -1;
 		}
-		else if(first_track == get_audio_trak_id())//在前边的是audio帧
-		{
-			unsigned int V_start_pos = mdat_array[i]->box_first_byte + 8;//记录 mdat box video 数据部分开始位置
-			unsigned int A_start_pos = mdat_array[i]->box_first_byte + 8;	//记录 mdat box audio 数据部分开始位置
-			unsigned int j = 0; 
-			unsigned int count_V_sample_size = 0;
-			unsigned int count_A_sample_size = 0;
-			for(j=0 ; j < Atrun_sample_array[i] ; j++) //记录音频帧的偏移
-			{
-			
-				sample_offset.A_offset_array[A_offset_index] = 	A_start_pos + count_A_sample_size;
-				A_offset_index ++;
-				count_A_sample_size +=  sample_size.A_size_array[A_size_index];
-				A_size_index ++;	
-				V_start_pos += count_A_sample_size; //视频sample开始位置偏移到音频sample的后边	
-			}
-						
-			for(j=0 ; j < Vtrun_sample_array[i] ; j++) //记录视频帧的偏移
-			{
-				sample_offset.V_offset_array[V_offset_index] = 	V_start_pos + count_V_sample_size;
-				V_offset_index ++;
-				count_V_sample_size += sample_size.V_size_array[V_size_index];
-				V_size_index ++;
-	
-			}
+		sample_table_save(mp4_file,mp4,source);
+	}
+	sample_table.init_done = 1;
 
+	frame_info.video_frames = sample_table.V_sample_num;
+	frame_info.audio_frames = sample_table.A_sample_num;
+	frame_info.inited = 1;
 
-		}
-		else
-		{
-			ERROR_LOG("first_track is not audio or video!\n");
-			goto ERR;
-		}
-		
-			
-	}
+	/*---sample_size / sample_offset 直接指向 sample 表，不再单独分配-----------------*/
+	sample_size.V_sample_num = sample_table.V_sample_num;
+	sample_size.V_size_array = sample_table.V_size;
+	sample_size.V_flags_array = sample_table.V_flags;
+	sample_size.A_sample_num = sample_table.A_sample_num;
+	sample_size.A_size_array = sample_table.A_size;
+	sample_size.init_done = 1;
+
+	sample_offset.V_sample_num = sample_table.V_sample_num;
+	sample_offset.V_offset_array = sample_table.V_offset;
+	sample_offset.A_sample_num = sample_table.A_sample_num;
+	sample_offset.A_offset_array = sample_table.A_offset;
 	sample_offset.init_done = 1;
-	/*================================================================================================*/
-	if(NULL != moof_array)
-		HLS_FREE(moof_array);
-	if(NULL != traf_array)
-		HLS_FREE(traf_array);
-	if(NULL != Atrun_sample_array)
-		HLS_FREE(Atrun_sample_array);
-	if(NULL != Vtrun_sample_array)
-		HLS_FREE(Vtrun_sample_array);
-	if(NULL != mdat_array)
-		HLS_FREE(mdat_array);
+
+	DEBUG_LOG("video_frames = %d audio_frames = %d\n",frame_info.video_frames,frame_info.audio_frames);
 	return 0;
-	
-ERR:
-	if(NULL != moof_array)
-		HLS_FREE(moof_array);
-	if(NULL != traf_array)
-		HLS_FREE(traf_array);
-	if(NULL != Atrun_sample_array)
-		HLS_FREE(Atrun_sample_array);
-	if(NULL != Vtrun_sample_array)
-		HLS_FREE(Vtrun_sample_array);
-	if(NULL != mdat_array)
-		HLS_FREE(mdat_array);
-	return -1;
-	
+}
+
+/*释放 sample 表（sample_size / sample_offset 只是指向它）*/
+static void free_sample_table(void)
+{
+	if(NULL != sample_table.block)
+		HLS_FREE(sample_table.block);
+	memset(&sample_table,0,sizeof(sample_table));
+	memset(&sample_size,0,sizeof(sample_size));
+	memset(&sample_offset,0,sizeof(sample_offset));
 }
 
 
@@ -2203,101 +2109,6 @@ int  get_pts(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_sourc
 
 }
 
-/*
-功能：获取fmp4文件 一个video traf-->trun 视频  	   帧的持续时间（内部时间，非实际时间）数组指针
-参数：
-	@duration_array:每个帧的持续时间（内部时间，非实际时间）数组指针
-返回：成功：数组元素个数		   		失败：-1
-注意：使用后需要 free(duration_array)  
-*/
-int get_fmp4_video_sample_duration(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_source_t* source,MP4_BOX* traf_video,int**duration_array)
-{
-	if(NULL == mp4 || NULL == source || NULL == traf_video)
-	{
-		ERROR_LOG("Illegal parameter !\n");
-		return -1;
-	}
-
-	
-	/*---读取 tfhd-->Default sample duration，以防trun-->duration没有填充，就用该值-------*/
-	unsigned int 	default_sample_duration = 0; 	
-	MP4_BOX* tfhd =  find_box(traf_video, "tfhd");
-	if(tfhd)
-	{
-		source->read(mp4_file,mp4, &default_sample_duration, 4, tfhd->box_first_byte + 24, 0);
-		default_sample_duration = t_ntohl(default_sample_duration);
-		if(0 == default_sample_duration)
-		{
-			//文件中该项没有填充，以trun-->duration为准
-			//do noting
-		}
-		
-	}
-
-	unsigned int flag = 0;
-	unsigned int Sample_count = 0;//当前trun下的 samples（帧） 个数
-	unsigned int first_duration_offset = 0;//第一个duration数据开始的位置偏移
-	unsigned int Duration_offset = 0; //统计 两个sample_duration 字段之间的距离
-	MP4_BOX* trun =  find_box(traf_video, "trun");
-	if(trun)
-	{
-		//sample_count
-		source->read(mp4_file,mp4, &Sample_count, 4, trun->box_first_byte + 12, 0);
-		Sample_count = t_ntohl(Sample_count);
-		int* duration_array_tmp = HLS_MALLOC(context, sizeof(int) * Sample_count);
-		if(NULL == duration_array_tmp)
-		{
-			ERROR_LOG("malloc failed !\n");
-			return -1;
-		}
-
-		//flag  
-		source->read(mp4_file,mp4, &flag, 4, trun->box_first_byte + 8, 0);
-		flag = t_ntohl(flag);
-		flag = flag & 0x00FFFFFF;//flag只占三字节
-
-		/*---计算读取第一个 sample_duration 的偏移位置----------------------*/
-		first_duration_offset = trun->box_first_byte + 16 ; //计算到sample_count字段
-		//以下两个字段为可选字段，不一定每个mp4文件都填充，所以需判断flag来动态变换 first_duration_offset 的偏移长度
-		if(flag & E_data_offset)
-			first_duration_offset += 4;
-		if(flag & E_first_sample_flags)
-			first_duration_offset += 4;
-		/*------------------------------------------------------------------*/
-
-		/*---统计两个sample_duration 字段之间的间隔字节数-------------------*/
-		if(flag & E_sample_duration)
-			Duration_offset += 4;
-		if(flag & E_sample_size)
-			Duration_offset += 4;
-		if(flag & E_sample_flags)
-			Duration_offset += 4;
-		if(flag & E_sample_composition_time_offset)
-			Duration_offset += 4;
-		/*------------------------------------------------------------------*/
-
-		//开始填充 duration_array 信息数组
-		int i = 0;
-		for (i=0 ; i<Sample_count ; i++)
-		{
-			source->read(mp4_file,mp4, &duration_array_tmp[i], 4 , first_duration_offset + i*Duration_offset , 0);
-			duration_array_tmp[i] = t_ntohl(duration_array_tmp[i]);
-			DEBUG_LOG("duration_array_tmp[%d] = %d\n",i,duration_array_tmp[i]);
-			usleep(5);
-		}
-
-		*duration_array = duration_array_tmp;
-		return Sample_count;
-		
-	}
-
-	return -1;
-	
-
-}
-
-
-
 /*
 获取视频帧的dts,计算每一个帧的dts值，放到参数dts所指向的数组中
 返回：成功 ：0 	失败：-1
@@ -2352,62 +2163,13 @@ int get_video_dts(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_
 	}
 	else if(FMP4 == get_mp4_file_type())
 	{
-		/*---获取每个视频帧的 所占的时间单元数数组----------------------*/
-		//1.找出所有moof box节点，构成moof节点数组
-		MP4_BOX** moof_array = NULL;
-		MP4_BOX** traf_array = NULL;
-		unsigned int delta_counter = 0;
-		
-		int moof_num = find_box_one_level(context,root,"moof",&moof_array);
-		DEBUG_LOG("moof_num = %d\n",moof_num);
-		for(i=0 ; i<moof_num ; i++)
+		/*---fmp4 的 dts 已在 sample 表中（tfdt + trun duration 累加，整数计算无误差）---*/
+		if(1 != sample_table.init_done || nframes > sample_table.V_sample_num)
 		{
-			int traf_num = find_box_one_level(context,moof_array[i],"traf",&traf_array);
-			DEBUG_LOG("traf_num = %d\n",traf_num);
-			int j = 0;
-			for(j=0 ; j<traf_num ; j++)
-			{
-				/*---确保传进去的是 video traf 的根节点-----*/	
-				//先解析tfhd确定当前traf的trak_id
-				int track_id;
-				MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-				if(NULL == tfhd)
-				{
-					ERROR_LOG("find_box failed!\n");
-					continue;
-				}
-				else
-				{
-					source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-					track_id = t_ntohl(track_id);
-					
-				}
-				/*------------------------------------------*/
-
-				if(track_id == get_video_trak_id()) // 是 video traf
-				{
-					int* duration_array = NULL;
-					int array_num = 0;
-					array_num = get_fmp4_video_sample_duration(mp4_file,context , mp4 , source ,traf_array[j], &duration_array);
-					if(array_num > 0 && NULL != duration_array)
-					{
-						//将该分支的 sample_duration 数组拷贝到整个大的 sample_duration数组
-						memcpy(&delta[delta_counter],duration_array,sizeof(int)*array_num);
-						delta_counter += array_num;
-						
-					}
-					HLS_FREE(duration_array);
-				}
-				
-			}
-			
+			ERROR_LOG("sample_table not init ! nframes(%d) V_sample_num(%u)\n",nframes,sample_table.V_sample_num);
+			HLS_FREE(delta);
+			return -1;
 		}
-		
-	
-		DEBUG_LOG("delta[0] = %d delta[1] = %d delta[2] = %d\n",delta[0],delta[1],delta[2]);
-		HLS_FREE(moof_array);
-		HLS_FREE(traf_array);
-		
 	}
 	else
 	{
@@ -2442,6 +2204,16 @@ int get_video_dts(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_
 	timescale = t_ntohl(timescale);
 	DEBUG_LOG("timescale = %d \n",timescale);
 	
+	if(FMP4 == get_mp4_file_type())
+	{
+		//每帧单独由 64 位时间戳换算，不做浮点累加
+		for(int i=0; i<nframes; i++) 
+			dts[i] = (float)((double)sample_table.V_dts[i]/timescale);
+		HLS_FREE(delta);
+		DEBUG_LOG("dts[0] = %f  dts[nframes-1] = %f\n",dts[0],dts[nframes-1]);
+		return 0;
+	}
+	
 	dts[0]=0;
 	double real_dts=0;
 //	real_pts+=(double)delta[i-1]/SamplingFrequencies[DecoderSpecificInfo];
@@ -2450,8 +2222,6 @@ int get_video_dts(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file_
 	{
 		real_dts += (double)delta[i-1]/timescale;
 		dts[i]=(float)real_dts;
-		DEBUG_LOG("real_dts = %f dts[%d] = %f\n",real_dts,i,dts[i]);
-		usleep(5);
 	}
 	HLS_FREE(delta);
 	DEBUG_LOG("dts[0] = %f  dts[nframes-1] = %f\n",dts[0],dts[nframes-1]);
@@ -2508,9 +2278,15 @@ int  get_video_pts(FILE_info_t* mp4_file,void* context, file_handle_t* mp4, file
 	}
 	else if(FMP4 == get_mp4_file_type())
 	{
+		if(1 != sample_table.init_done || nframes > sample_table.V_sample_num)
+		{
+			ERROR_LOG("sample_table not init !\n");
+			HLS_FREE(delta);
+			return -1;
+		}
 		for(int i=0; i<nframes; i++) 
 		{
-			delta[i] = 0;  //暂时置为0，后边如若有问题再修改(如果一个视频没有B帧，则pts永远和dts相同)
+			delta[i] = (int)(sample_table.V_pts[i] - sample_table.V_dts[i]);  //trun 中的 composition_time_offset（没有B帧时为0）
 		}
 	
 	}
@@ -2686,98 +2462,19 @@ int mp4_media_get_stats(FILE_info_t* mp4_file,void* context, file_handle_t* mp4,
 		}
 		else if(FMP4 == get_mp4_file_type())//FMP4文件
 		{
-			//1.找出所有moof box节点，构成moof节点数组
-			MP4_BOX** moof_array = NULL;
-			MP4_BOX** traf_array = NULL;
-			
-			int moof_num = find_box_one_level(context,root,"moof",&moof_array);
-			DEBUG_LOG("moof_num = %d\n",moof_num);
-			
-			/*for (i = 0 ; i < moof_num;i++)
+			//一次遍历所有 moof-->traf 建立 sample 表（或直接加载 .stbl），同时得到 video/audio 帧总数
+			if(init_sample_table(mp4_file,context,mp4,source,root) < 0)
 			{
-				printf("moof_array[i] = %x\n",moof_array[i]);
-			}
-			*/
-
-			//2.遍历每一个moof节点，找出里边的traf节点，统计 video/audio 帧数信息
-			for (i = 0 ; i < moof_num;i++)
-			{
-				int traf_num = find_box_one_level(context,moof_array[i],"traf",&traf_array);
-				DEBUG_LOG("moof_array[%d] --> traf_num = %d\n",i,traf_num);
-				if(traf_num < 0)
-				{
-					ERROR_LOG("find_box_one_level error !\n");
-					HLS_FREE(traf_array);
-					HLS_FREE(moof_array);
-					return -1;
-				}
-				
-				//3.循环读取每个moof-->traf-->trun下的 Sample count字段求 video/audio 帧总数
-				for(j = 0 ; j < traf_num ; j++)
-				{
-					//先解析tfhd确定当前traf的trak_id
-					MP4_BOX* tfhd =  find_box(traf_array[j],"tfhd");
-					if(NULL == tfhd)
-					{
-						ERROR_LOG("find_box failed!\n");
-						continue;
-					}
-					else
-					{
-						int track_id;
-						source->read(mp4_file,mp4,&track_id,4,tfhd->box_first_byte+12,0);
-						track_id = t_ntohl(track_id);
-						//DEBUG_LOG("track_id = %d\n",track_id);
-						
-						//解析trun下的 Sample count字段
-						MP4_BOX* trun =  find_box(traf_array[j],"trun");
-						if(NULL == trun)
-						{
-							ERROR_LOG("find_box failed!\n");
-							continue;
-						}
-						int sample_count = 0;
-						source->read(mp4_file,mp4,&sample_count,4,trun->box_first_byte+12,0);
-						sample_count = t_ntohl(sample_count);
-		
-						if(track_id == get_video_trak_id())//video
-						{
-							if(frame_info.inited !=1 )
-								frame_info.video_frames += sample_count;
-						}
-						else if(track_id == get_audio_trak_id())//audio
-						{
-							if(frame_info.inited !=1 )
-								frame_info.audio_frames += sample_count;
-						}
-						else
-						{
-							ERROR_LOG("unknown track_id !\n");
-							continue;
-						}	
-					
-					}
-
-				}
-				
-				HLS_FREE(traf_array); //该释放操作不能放到外层
-				traf_array = NULL;
-				
+				ERROR_LOG("init_sample_table failed !\n");
+				HLS_FREE(moov_traks);
+				i_want_to_break_free(root);
+				return -1;
 			}
 
 			//求应分配内存空间大小
 			//MediaStatsT += (2*(sizeof(float)+sizeof(int))*frame_info.video_frames);
 			MediaStatsT += ((2*sizeof(float) + sizeof(int))*frame_info.video_frames);
 			MediaStatsT += ((sizeof(float)+sizeof(int))*frame_info.audio_frames);
-			
-			frame_info.inited = 1;
-			
-			DEBUG_LOG("video_frames = %d\n",frame_info.video_frames);
-			DEBUG_LOG("audio_frames = %d\n",frame_info.audio_frames);
-			
-			HLS_FREE(moof_array);
-			moof_array = NULL;
-		
 		}
 		else
 		{
@@ -2796,15 +2493,9 @@ int mp4_media_get_stats(FILE_info_t* mp4_file,void* context, file_handle_t* mp4,
 	
 	/******如果传入的指针不为空（外部已经分配好内存），则直接进行trak信息填充**********/
 	/*----增加初始化 video/audio 帧（sample）大小信息的逻辑----------------------*/
-	if(init_sample_size_array(mp4_file,context,mp4,source,root) < 0)
-	{
-		ERROR_LOG("init_sample_size_offset_array failed !\n");
-		goto ERR;
-	}
-
-	if(init_sample_offset_array(mp4_file,context,mp4,source,root) < 0)
+	if(init_sample_table(mp4_file,context,mp4,source,root) < 0)
 	{
-		ERROR_LOG("init_sample_offset_array failed !\n");
+		ERROR_LOG("init_sample_table failed !\n");
 		goto ERR;
 	}
 	DEBUG_LOG("into position A , n_tracks = %d\n",n_tracks);
@@ -3704,21 +3395,7 @@ ERR:
 
 void hls_exit(void)
 {
-	if(NULL != sample_offset.V_offset_array)
-		HLS_FREE(sample_offset.V_offset_array);
-	if(NULL != sample_offset.A_offset_array)
-		HLS_FREE(sample_offset.A_offset_array);
-	sample_offset.init_done = 0;
-	
-	if(NULL != sample_size.V_size_array)
-		HLS_FREE(sample_size.V_size_array);
-	if(NULL != sample_size.V_flags_array)
-		HLS_FREE(sample_size.V_flags_array);
-	if(NULL != sample_size.A_size_array)
-		HLS_FREE(sample_size.A_size_array);
-	sample_size.init_done = 0;
-	
-	
+	free_sample_table(); //sample_size / sample_offset 只是指向 sample 表，一起释放
 }
 
 
@@ -3780,6 +3457,7 @@ void hls_media_mp4_global_variable_reset(void)
 	video_trak_id = -1;
 	memset(&sample_size,0,sizeof(sample_size));
 	memset(&sample_offset,0,sizeof(sample_offset));
+	memset(&sample_table,0,sizeof(sample_table));
 	
 }
 
@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------/
+/  SD 卡录像（libencoder/sd_record.c）使用的 FatFs 对外符号改名
+/---------------------------------------------------------------------------/
+/  LiteOS 内核的 FAT 文件系统（libfat.a，LOSCFG_FS_FAT=y）也是由 FatFs 移植的，
+/  同样导出 f_mount/f_mkfs/disk_read/get_fattime 等符号。这里的 ff.c 和 sd_diskio.c
+/  都链接进 libencoder.a，不改名会和 libfat.a 重复定义，或者替换掉内核 FAT 的
+/  disk_read/disk_write。由 ffconf.h 包含，ff.h、diskio.h 的声明和所有调用方
+/  都会一起改名（diskio.h 之前必须先包含 ff.h）。
+/---------------------------------------------------------------------------*/
+#ifndef FFRENAME_DEFINED
+#define FFRENAME_DEFINED
+
+#define f_chdir         sdfat_f_chdir
+#define f_chdrive       sdfat_f_chdrive
+#define f_chmod         sdfat_f_chmod
+#define f_close         sdfat_f_close
+#define f_closedir      sdfat_f_closedir
+#define f_expand        sdfat_f_expand
+#define f_fdisk         sdfat_f_fdisk
+#define f_findfirst     sdfat_f_findfirst
+#define f_findnext      sdfat_f_findnext
+#define f_forward       sdfat_f_forward
+#define f_getcwd        sdfat_f_getcwd
+#define f_getfree       sdfat_f_getfree
+#define f_getlabel      sdfat_f_getlabel
+#define f_gets          sdfat_f_gets
+#define f_lseek         sdfat_f_lseek
+#define f_mkdir         sdfat_f_mkdir
+#define f_mkfs          sdfat_f_mkfs
+#define f_mount         sdfat_f_mount
+#define f_open          sdfat_f_open
+#define f_opendir       sdfat_f_opendir
+#define f_printf        sdfat_f_printf
+#define f_putc          sdfat_f_putc
+#define f_puts          sdfat_f_puts
+#define f_read          sdfat_f_read
+#define f_readdir       sdfat_f_readdir
+#define f_rename        sdfat_f_rename
+#define f_setcp         sdfat_f_setcp
+#define f_setlabel      sdfat_f_setlabel
+#define f_stat          sdfat_f_stat
+#define f_sync          sdfat_f_sync
+#define f_truncate      sdfat_f_truncate
+#define f_unlink        sdfat_f_unlink
+#define f_utime         sdfat_f_utime
+#define f_write         sdfat_f_write
+#define ff_cre_syncobj  sdfat_ff_cre_syncobj
+#define ff_del_syncobj  sdfat_ff_del_syncobj
+#define ff_memalloc     sdfat_ff_memalloc
+#define ff_memfree      sdfat_ff_memfree
+#define ff_oem2uni      sdfat_ff_oem2uni
+#define ff_rel_grant    sdfat_ff_rel_grant
+#define ff_req_grant    sdfat_ff_req_grant
+#define ff_uni2oem      sdfat_ff_uni2oem
+#define ff_wtoupper     sdfat_ff_wtoupper
+#define get_fattime     sdfat_get_fattime
+#define disk_initialize sdfat_disk_initialize
+#define disk_ioctl      sdfat_disk_ioctl
+#define disk_read       sdfat_disk_read
+#define disk_status     sdfat_disk_status
+#define disk_write      sdfat_disk_write
+
+/* 类型名：LiteOS 的 dirent.h 也定义了 DIR */
+#define DIR             sdfat_DIR
+
+#endif
@@ -56,13 +56,14 @@ typedef enum _ts_flag_e
 /*---# amazon 云推送文件之信息结构----------*/
 typedef struct _put_file_info_t
 {
-	int 		mode;						//传输模式（1：直接open文件的方式 ；2：直接使用文件缓存buf的模式）
+	int 		mode;						//传输模式（1：直接open文件的方式 ；2：直接使用文件缓存buf的模式 ；3：upload_stream_t 管道流式上传）
 	int 		file_tlen; 					//文件的时长	
 	file_type_e file_type; 					//文件类型： 6s预录TS/jpeg/告警视频TS 
 	ts_flag_e 	ts_flag;					//ts文件的flag标志（详见 ts_flag_e 枚举变量）
 	char		file_name[62];				//文件名
 	char*		file_buf;					//mod == 2专用，文件的缓存位置（若 mode == 1,该参数置NULL）
 	int			file_buf_len;				//file_buf的长度，同上
+	struct _upload_stream_t* stream;		//mod == 3专用，生产者写入数据的管道（见 amazon_upload.h）
 	char 		m3u8name[64];				//绝对m3u8文件名(内容由S3程序自动生成，这里只需要提供文件名字即可)
 	char 		datetime[24];				//时间信息
 	
@@ -94,12 +95,21 @@ int is_amazon_info_update(void);
 					<file_len>文件的长度
 *@ Output         :
 *@ Return         :成功：0 ； 失败：-1
-*@ attention      :
+*@ attention      :按优先级调度（详见 upload_sched.h），file_buf/stream 的所有权交给上传模块
 *******************************************************************************/
 int push_to_upload_file_queue(put_file_info_t *file_info);
 
 /*******************************************************************************
-*@ Description    :从（上传 amazom 云）上传队列，出队最旧的一个节点
+*@ Description    :将文件放入到（上传 amazom 云）上传队列，不阻塞
+*@ Input          :<file_info> 文件描述信息
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :录像/告警线程使用，队列满时丢弃同优先级最旧的文件（不等待上传线程）
+*******************************************************************************/
+int push_to_upload_file_queue_nowait(put_file_info_t *file_info);
+
+/*******************************************************************************
+*@ Description    :从（上传 amazom 云）上传队列，出队优先级最高的一个节点（队列为空时阻塞）
 *@ Input          :
 *@ Output         :<file_buf> 文件buf指针
 					<file_len>文件的长度
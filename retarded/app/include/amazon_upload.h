@@ -0,0 +1,126 @@
+/***************************************************************************
+* @file: amazon_upload.h
+* @author:
+* @date:  10,19,2026
+* @brief:  录像文件的流式上传（固定大小缓存 + 生产者背压 + 按分片续传）
+* @attention:
+	1.生产者（录像/切片）通过 upload_stream_t 管道写入数据，管道满时写入阻塞（背压），
+	  不再需要把整个文件缓存在内存中。
+	2.文件大于 UPLOAD_PART_SIZE 时使用分片（multipart）上传，某一分片失败只重传该分片。
+	3.管道由生产者和上传线程各持有一个引用，双方都结束后自动释放。
+	4.推入上传队列时还不知道的信息（切片标志、时长）由生产者在结束前通过 upload_stream_set_info 补充。
+***************************************************************************/
+#ifndef _AMAZON_UPLOAD_H_
+#define _AMAZON_UPLOAD_H_
+
+#include "amazon_S3.h"
+
+#define UPLOAD_PIPE_SIZE			(64*1024)	//生产者与上传线程之间的管道大小
+#ifndef UPLOAD_PART_SIZE
+#define UPLOAD_PART_SIZE			(5*1024*1024)	//分片大小（S3 要求除最后一片外 >= 5MB，主机测试用更小的分片）
+#endif
+#define UPLOAD_PART_INIT_SIZE		(256*1024)	//管道模式分片缓存的初始大小（不够时按 2 倍扩容到 UPLOAD_PART_SIZE）
+#define UPLOAD_PART_RETRY			3			//每个分片的最大重传次数
+#define UPLOAD_STREAM_WRITE_TIMEOUT	60			//生产者写管道的最长阻塞时间（秒），超时则放弃本次上传
+#define UPLOAD_SIGN_PAYLOAD			1			//1：管道模式的分片在读入时增量计算 SHA256 并参与签名 ；0：全部使用 UNSIGNED-PAYLOAD
+												//（文件模式和 buf 模式总是 UNSIGNED-PAYLOAD，不为签名多读一遍数据）
+
+
+typedef struct _upload_stream_t upload_stream_t;
+
+/*******************************************************************************
+*@ Description    :创建上传管道（引用计数为 2：生产者 + 上传线程）
+*@ Input          :
+*@ Output         :
+*@ Return         :成功：管道指针 ； 失败：NULL
+*@ attention      :创建后填入 put_file_info_t.stream（mode = 3）再 push_to_upload_file_queue
+*******************************************************************************/
+upload_stream_t* upload_stream_create(void);
+
+/*******************************************************************************
+*@ Description    :生产者写入数据（管道满时阻塞等待上传线程读取）
+*@ Input          :<s>管道指针
+					<data>数据
+					<len>数据长度
+*@ Output         :
+*@ Return         :成功：0 ； 失败（上传已放弃/超时）：-1
+*@ attention      :
+*******************************************************************************/
+int upload_stream_write(upload_stream_t* s, const void* data, int len);
+
+/*******************************************************************************
+*@ Description    :生产者写入数据（不阻塞，只写入管道中放得下的部分）
+*@ Input          :<s>管道指针
+					<data>数据
+					<len>数据长度
+*@ Output         :
+*@ Return         :写入的字节数（管道满时为 0） ； 失败（上传已放弃）：-1
+*@ attention      :用于不能被上传阻塞的生产者（录像线程），没写入的部分由生产者自己缓存
+*******************************************************************************/
+int upload_stream_try_write(upload_stream_t* s, const void* data, int len);
+
+/*******************************************************************************
+*@ Description    :生产者补充文件信息（推入上传队列时还不知道的切片标志和时长）
+*@ Input          :<s>管道指针
+					<ts_flag>切片标志（ts_flag_e）
+					<file_tlen>文件时长（秒）
+*@ Output         :
+*@ Return         :
+*@ attention      :在 upload_stream_close 之前调用；上传成功后覆盖 put_file_info_t 中的对应项
+*******************************************************************************/
+void upload_stream_set_info(upload_stream_t* s, int ts_flag, int file_tlen);
+
+/*******************************************************************************
+*@ Description    :生产者结束写入，并释放生产者持有的引用
+*@ Input          :<s>管道指针
+					<ok>1：数据完整（上传线程读到结束标记） 0：录制失败（放弃本次上传）
+*@ Output         :
+*@ Return         :
+*@ attention      :调用后生产者不能再使用 s
+*******************************************************************************/
+void upload_stream_close(upload_stream_t* s, int ok);
+
+/*******************************************************************************
+*@ Description    :生产者结束写入（数据完整），没写进管道的剩余数据交给上传线程，不阻塞
+*@ Input          :<s>管道指针
+					<buf>剩余的数据（malloc 分配，可为 NULL）
+					<len>剩余数据的长度
+*@ Output         :
+*@ Return         :
+*@ attention      :buf 的所有权交给管道（上传线程读完管道后接着读 buf，释放管道时 free）；
+					调用后生产者不能再使用 s 和 buf
+*******************************************************************************/
+void upload_stream_close_buf(upload_stream_t* s, char* buf, int len);
+
+/*******************************************************************************
+*@ Description    :上传线程读取数据（管道空时阻塞）
+*@ Input          :<s>管道指针
+					<size>buf 大小
+*@ Output         :<buf>读到的数据
+*@ Return         :读到的字节数 ； 0：数据已读完 ； -1：生产者放弃
+*@ attention      :
+*******************************************************************************/
+int upload_stream_read(upload_stream_t* s, void* buf, int size);
+
+/*******************************************************************************
+*@ Description    :上传线程释放引用（数据未读完时通知生产者放弃写入）
+*@ Input          :<s>管道指针
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void upload_stream_release(upload_stream_t* s);
+
+/*******************************************************************************
+*@ Description    :流式上传一个文件（mode 1：SD/flash 上的文件 ； mode 3：upload_stream_t 管道）
+*@ Input          :<info>文件描述信息
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :mode 3 时函数返回前会释放 info->stream 的引用，上传成功时用生产者补充的信息
+					（upload_stream_set_info）更新 info->ts_flag/file_tlen
+*******************************************************************************/
+int amazon_stream_upload(put_file_info_t* info);
+
+
+#endif
+
@@ -0,0 +1,227 @@
+/***************************************************************************
+* @file: json_stream.h
+* @author:
+* @date:  10,19,2026
+* @brief:  不分配内存的 JSON 读写：按需取词的读取器 + 字段表绑定 + 写入固定缓存的生成器
+* @attention:
+	1.读取器每次 json_next 取一个词（对象/数组的开始结束、键、值），字符串直接指向原文，
+	  不建树、不分配内存；json_parse 按字段表把需要的键写入调用者的结构体，其他键跳过。
+	2.生成器直接写入调用者提供的缓存（紧凑格式），空间不够时 json_write_finish 返回失败。
+	3.cJSON 兼容层：json_cjson_parse 在调用者提供的节点池中建立 cJSON 结构的树
+	  （可以继续用 cJSON_GetObjectItem 等读取，不能 cJSON_Delete），
+	  json_cjson_print 把已有的 cJSON 树输出到固定缓存（与 cJSON_PrintUnformatted 相同的格式）。
+	4.最多嵌套 JSON_DEPTH_MAX 层。
+***************************************************************************/
+#ifndef _JSON_STREAM_H_
+#define _JSON_STREAM_H_
+
+#include <stddef.h>
+#include "typeport.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define JSON_DEPTH_MAX		32		//最多嵌套层数
+#define JSON_TABLE_MAX		32		//一个字段表最多的字段数
+
+/*---词的类型-----------------------------*/
+typedef enum _json_tok_e
+{
+	JSON_TOK_ERROR = -1,		//格式错误
+	JSON_TOK_END = 0,			//文档结束
+	JSON_TOK_OBJ_BEGIN,
+	JSON_TOK_OBJ_END,
+	JSON_TOK_ARR_BEGIN,
+	JSON_TOK_ARR_END,
+	JSON_TOK_KEY,
+	JSON_TOK_STRING,
+	JSON_TOK_NUMBER,
+	JSON_TOK_TRUE,
+	JSON_TOK_FALSE,
+	JSON_TOK_NULL
+}json_tok_e;
+
+typedef struct _json_token_t
+{
+	int 		type;			//json_tok_e
+	const char 	*str;			//键/字符串（不含引号，未转义）、数字的原文
+	int 		len;
+	int 		depth;			//词所在的层数（开始/结束符号计为外层）
+}json_token_t;
+
+/*读取器状态（放在栈上即可）*/
+typedef struct _json_reader_t
+{
+	const char 	*start;
+	const char 	*p;
+	const char 	*end;
+	HLE_U32 	arr_mask;		//bit i：第 i+1 层是数组
+	int 		depth;
+	int 		state;
+}json_reader_t;
+
+/*---字段表-----------------------------*/
+typedef enum _json_type_e
+{
+	JSON_T_INT = 1,				//int
+	JSON_T_BOOL,				//int：true 为 1，false 为 0（也接受数字）
+	JSON_T_STRING,				//char[size]，超长时解析失败
+	JSON_T_OBJECT				//嵌套对象：sub 为它的字段表，写入同一个结构体
+}json_type_e;
+
+#define JSON_F_REQUIRED		0x01	//缺少该字段时 json_parse 返回失败
+
+typedef struct _json_field_t
+{
+	const char 	*key;
+	HLE_U8 		type;			//json_type_e
+	HLE_U8 		flags;
+	HLE_U16 	size;			//JSON_T_STRING 的缓存大小
+	HLE_U32 	offset;			//在结构体中的偏移
+	const struct _json_field_t *sub;
+}json_field_t;
+
+#define JSON_FIELD_INT(st, member, key, flags)	{key, JSON_T_INT, flags, 0, offsetof(st, member), NULL}
+#define JSON_FIELD_BOOL(st, member, key, flags)	{key, JSON_T_BOOL, flags, 0, offsetof(st, member), NULL}
+#define JSON_FIELD_STR(st, member, key, flags)	{key, JSON_T_STRING, flags, sizeof (((st *)0)->member), offsetof(st, member), NULL}
+#define JSON_FIELD_OBJ(key, sub, flags)			{key, JSON_T_OBJECT, flags, 0, 0, sub}
+#define JSON_FIELD_END							{NULL, 0, 0, 0, 0, NULL}
+
+/*---生成器-----------------------------*/
+typedef struct _json_writer_t
+{
+	char 		*buf;
+	int 		size;
+	int 		len;
+	int 		depth;
+	HLE_U32 	more;			//bit i：第 i 层已经有成员（下一个成员前要加逗号）
+	int 		error;			//空间不够或层数错误
+}json_writer_t;
+
+/*---cJSON 兼容层的节点池-----------------------------*/
+typedef struct _json_cjson_pool_t
+{
+	cJSON 		*nodes;			//节点数组
+	int 		num;
+	char 		*strbuf;		//键和字符串值（转义后）的存放空间
+	int 		strsize;
+	int 		used;			//已用节点数（json_cjson_parse 清零）
+	int 		strused;
+}json_cjson_pool_t;
+
+
+/*******************************************************************************
+*@ Description    :初始化读取器
+*@ Input          :<text>JSON 文本 <len>长度，<0 时按 strlen
+*@ Output         :<rd>读取器
+*@ Return         :
+*@ attention      :文本在读取期间不能释放或修改
+*******************************************************************************/
+void json_reader_init(json_reader_t *rd, const char *text, int len);
+
+/*******************************************************************************
+*@ Description    :取下一个词
+*@ Input          :<rd>读取器
+*@ Output         :<tok>词
+*@ Return         :词的类型（json_tok_e），JSON_TOK_ERROR 之后一直返回错误
+*@ attention      :
+*******************************************************************************/
+int json_next(json_reader_t *rd, json_token_t *tok);
+
+/*******************************************************************************
+*@ Description    :跳过下一个值（取到键之后调用；值为对象/数组时跳过整个子树）
+*@ Input          :<rd>读取器
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int json_skip(json_reader_t *rd);
+
+/*出错时的字节偏移（日志用）*/
+int json_reader_pos(const json_reader_t *rd);
+
+/*******************************************************************************
+*@ Description    :数字词转成 int（小数部分截去，超出范围时取 INT_MAX/INT_MIN），不使用浮点
+*@ Input          :<tok>JSON_TOK_NUMBER
+*@ Output         :<val>数值
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int json_tok_int(const json_token_t *tok, int *val);
+
+/*******************************************************************************
+*@ Description    :键/字符串词转义后拷贝到 dst（\uXXXX 转成 UTF-8），以 '\0' 结尾
+*@ Input          :<tok>JSON_TOK_KEY/JSON_TOK_STRING <size>dst 大小
+*@ Output         :<dst>字符串
+*@ Return         :成功：字符串长度 ； 失败（dst 放不下或转义错误）：-1
+*@ attention      :
+*******************************************************************************/
+int json_tok_string(const json_token_t *tok, char *dst, int size);
+
+/*******************************************************************************
+*@ Description    :按字段表解析 JSON 对象，结果写入 base 指向的结构体
+*@ Input          :<text>JSON 文本 <len>长度，<0 时按 strlen
+					<fields>字段表（以 JSON_FIELD_END 结尾）
+*@ Output         :<base>结构体（只写入出现的字段，其他成员保持不变）
+					<err_pos>出错时的字节偏移，可以为 NULL
+*@ Return         :成功：0 ； 格式错误：HLE_RET_ERROR ； 类型不符/字符串超长/缺少必需字段：HLE_RET_EINVAL
+*@ attention      :字段表中没有的键整体跳过；值为 null 的字段视为没有出现
+*******************************************************************************/
+int json_parse(const char *text, int len, const json_field_t *fields, void *base, int *err_pos);
+
+/*******************************************************************************
+*@ Description    :生成器：开始输出到 buf
+*@ Input          :<buf><size>输出缓存
+*@ Output         :<w>生成器
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void json_write_init(json_writer_t *w, char *buf, int size);
+
+/*key 为 NULL 时作为数组成员（或顶层的值）输出*/
+void json_write_obj_begin(json_writer_t *w, const char *key);
+void json_write_obj_end(json_writer_t *w);
+void json_write_arr_begin(json_writer_t *w, const char *key);
+void json_write_arr_end(json_writer_t *w);
+void json_write_string(json_writer_t *w, const char *key, const char *val);
+void json_write_int(json_writer_t *w, const char *key, int val);
+void json_write_u64(json_writer_t *w, const char *key, HLE_U64 val);
+void json_write_bool(json_writer_t *w, const char *key, int val);
+void json_write_null(json_writer_t *w, const char *key);
+
+/*******************************************************************************
+*@ Description    :生成器：结束输出
+*@ Input          :<w>生成器
+*@ Output         :
+*@ Return         :成功：输出长度（buf 以 '\0' 结尾）；空间不够或对象/数组没有结束：-1
+*@ attention      :
+*******************************************************************************/
+int json_write_finish(json_writer_t *w);
+
+/*******************************************************************************
+*@ Description    :cJSON 兼容：在节点池中解析出 cJSON 树
+*@ Input          :<text>JSON 文本 <pool>节点池
+*@ Output         :
+*@ Return         :成功：根节点 ； 失败（格式错误或节点池不够）：NULL
+*@ attention      :节点和字符串都在池中，用完后直接丢弃池，不能调用 cJSON_Delete
+*******************************************************************************/
+cJSON *json_cjson_parse(const char *text, json_cjson_pool_t *pool);
+
+/*******************************************************************************
+*@ Description    :cJSON 兼容：把 cJSON 树输出到固定缓存（格式与 cJSON_PrintUnformatted 相同）
+*@ Input          :<item>cJSON 树 <buf><size>输出缓存
+*@ Output         :
+*@ Return         :成功：输出长度 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int json_cjson_print(cJSON *item, char *buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -186,6 +186,28 @@ typedef struct _med_ser_init_info_t
 	//强制I帧回调函数
 	HLE_S32 (*encoder_force_iframe)(HLE_S32 channel, HLE_S32 stream_id);
 
+	/*
+	 encoder_get_packet 的不阻塞版本，参数相同。
+	 队列里暂时没有帧时返回成功，*pack_addr 为 NULL。
+	 media server 的流发送线程用它在一个线程里服务所有会话的码流。
+	*/
+	HLE_S32 (*encoder_try_get_packet)(HLE_S32 queue_id,HLE_S8 have_audio, void **pack_addr, void**frame_addr,HLE_S32* frame_length);
+
+	/*
+	 设置码流队列由空变为非空时的回调（在编码线程中调用，不能阻塞），notify 为 NULL 时取消
+	 @stream_id : encoder_request_stream 返回的值
+	*/
+	HLE_S32 (*encoder_set_packet_notify)(int stream_id, void (*notify)(void *arg), void *arg);
+
+	/*
+	 实时流 ABR 调整编码参数（可为 NULL，此时 ABR 只做主/子码流切换）
+	 @stream_index : 码流编号（同 encoder_request_stream）
+	 @level : 拥塞等级 [0, 6)，码率按 (6 - level) / 6 缩放
+	 @fps_div : 帧率除数，1 为不降帧率
+	 @gop_sec : GOP 时长（秒）
+	*/
+	HLE_S32 (*encoder_set_rate_ctrl)(int channel, int stream_index, int level, int fps_div, int gop_sec);
+
 }med_ser_init_info_t;
 
 
@@ -236,6 +258,8 @@ HLE_S32 media_server_if_upgrading(void);
 
 char* http_dowload_file(int argc, char  *argv[]);
 char* http_post(char *host_url);
+//HTTP GET，body 边接收边交给 on_data（返回 <0 中断），body 完整接收返回 0，否则返回 -1
+int http_get_stream(const char *url, int (*on_data)(void *arg, const void *data, int len), void *arg);
 
 int dowload_upadte_file(int argc,char**argv);
 #ifdef __cplusplus
@@ -59,7 +59,10 @@ typedef enum
 	CMD_SET_MEG_PUSH_LEVEL 	= 0x1158,		//设置消息推送时间间隔
 	//添加：
 	CMD_SET_SPEAKER_START	= 0x1168,		//设置对讲开始
-	CMD_SET_SPEAKER_STOP	= 0x1178		//设置对讲结束
+	CMD_SET_SPEAKER_STOP	= 0x1178,		//设置对讲结束
+	CMD_GET_METRICS			= 0x1188,		//获取运行统计（JSON）
+	CMD_GET_TRACE			= 0x1198,		//获取逐帧跟踪记录（metrics_trace_rec_t 数组）
+	CMD_SET_SD_FORMAT		= 0x11A8		//格式化 SD 卡（FAT32），之后重新开始录像
 
 	
 }E_CMD_TYPE;
@@ -478,6 +481,22 @@ typedef struct
 	HLE_S32       echo;						//0:成功,-1:失败
 }S_SET_RESTORE_ECHO ;
 
+/*---# 格式化 SD 卡 ------------------------------------------------------------*/
+//command = CMD_SET_SD_FORMAT;
+typedef struct
+{
+	DEF_CMD_HEADER;
+	HLE_U32	headFlag1	;					//0x55555555
+	HLE_U32	headFlag2	;					//0xaaaaaaaa
+}S_SET_SD_FORMAT_REQUEST;
+
+typedef struct
+{
+	DEF_CMD_HEADER;
+	HLE_S32       echo;						/*0:已开始格式化（卡上的数据全部丢失，耗时为秒级，
+												完成后自动开始录像）,-1:失败（标志错误或正在格式化）*/
+}S_SET_SD_FORMAT_ECHO ;
+
 /*---# 设置时区(校时) ------------------------------------------------------------*/
 //command = CMD_SET_TIME_ZONE;			
 typedef struct
@@ -563,6 +582,24 @@ typedef struct
 	int ret;		//0:设置成功，1：设置失败
 }S_SET_MSG_PUSH_LEVEL_ECHO;
 
+/*---# 获取运行统计 ------------------------------------------------------------*/
+//command = CMD_GET_METRICS;
+typedef struct
+{
+	DEF_CMD_HEADER ;
+}S_GET_METRICS_REQUEST;
+/*回应（变长）：DEF_CMD_HEADER + JSON 文本（不含 '\0'），length 为 JSON 文本的字节数，
+  JSON 的内容见 metrics.h（counters/gauges/hists/trace 以及各模块的状态）*/
+
+/*---# 获取逐帧跟踪记录 ------------------------------------------------------------*/
+//command = CMD_GET_TRACE;
+typedef struct
+{
+	DEF_CMD_HEADER ;
+}S_GET_TRACE_REQUEST;
+/*回应（变长）：DEF_CMD_HEADER + metrics_trace_rec_t[n]（从旧到新，每条 16 字节），
+  length 为 n * 16；发送期间设备暂停跟踪，发送完恢复*/
+
 
 
 
@@ -0,0 +1,193 @@
+/***************************************************************************
+* @file: metrics.h
+* @author:
+* @date:  10,19,2026
+* @brief:  统一的运行统计：计数器、直方图、水位、逐帧事件跟踪
+* @attention:
+	1.计数器和直方图按任务分片（METRICS_SHARDS 份，下标由任务 ID 得到），热点路径上只是
+	  本分片的普通加法（不加锁、不用原子读改写），读取时把所有分片加起来。
+	2.水位（gauge）记录当前值和历史最大值，由持有状态的模块在状态变化时设置。
+	3.跟踪器是固定大小的二进制环（METRICS_TRACE_NUM 条 16 字节的记录），第一次打开跟踪时分配，
+	  写满后覆盖最旧的记录。
+	4.关闭时热点路径只多一次标志判断；编译时定义 METRICS_DISABLE 则所有埋点宏都为空。
+	5.读取：shell 命令 metrics，或 P2P 信令 CMD_GET_METRICS（JSON 快照）/ CMD_GET_TRACE（二进制记录）。
+***************************************************************************/
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "typeport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define METRICS_SHARDS			16			//计数器分片数（2 的幂）
+#define METRICS_HIST_BUCKETS	16			//直方图桶数：桶 0 为 0，桶 i 为 [2^(i-1), 2^i)，最后一个桶包含更大的值
+#define METRICS_TRACE_NUM		4096		//跟踪环的记录数（2 的幂）
+#define METRICS_COLLECTOR_MAX	8			//最多注册的采集回调
+#define METRICS_JSON_MAX		4096		//JSON 快照的最大长度
+
+#define METRICS_F_ON			0x01		//打开计数器/直方图/水位
+#define METRICS_F_TRACE			0x02		//打开逐帧跟踪
+
+/*---计数器-----------------------------*/
+typedef enum _metrics_counter_e
+{
+	MET_C_VENC_FRAMES = 0,		//取到的视频编码帧
+	MET_C_AENC_FRAMES,			//取到的音频编码帧
+	MET_C_SPM_ALLOC_FAIL,		//码流包内存分配失败
+	MET_C_SPM_WAIT,				//码流包用完，等待归还
+	MET_C_SDP_DROP,				//分发队列积压丢帧
+	MET_C_SDP_SLAB_FAIL,		//分发队列节点分配失败
+	MET_C_TS_AFRAMES,			//TS 录像写入的音频帧
+	MET_C_TS_VFRAMES,			//TS 录像写入的视频帧
+	MET_C_FMP4_AFRAMES,			//fMP4 录像写入的音频帧
+	MET_C_FMP4_VFRAMES,			//fMP4 录像写入的视频帧
+	MET_C_NET_FRAMES,			//实时流写入传输层的帧
+	MET_C_NET_BYTES,			//实时流写入传输层的字节
+	MET_C_NET_WRITE_ERR,		//实时流写入失败
+	MET_C_NET_DISCARD,			//发送缓存超过阈值丢弃的帧
+	MET_C_UPLOAD_PUSH,			//进入上传队列的文件
+	MET_C_UPLOAD_DROP,			//上传队列丢弃的文件
+	MET_C_NUM
+}metrics_counter_e;
+
+/*---水位（当前值 + 最大值）-----------------------------*/
+typedef enum _metrics_gauge_e
+{
+	MET_G_SPM_PACKS = 0,		//已分配的码流包
+	MET_G_SPM_KB,				//码流包占用的内存（KB）
+	MET_G_SDP_VFRAMES,			//最近一次入队的分发队列中的视频帧数（最大值为所有队列的最大积压）
+	MET_G_NET_RING,				//实时流广播组环中的帧数
+	MET_G_UPLOAD_KB,			//上传队列缓存的数据（KB）
+	MET_G_NUM
+}metrics_gauge_e;
+
+/*---直方图-----------------------------*/
+typedef enum _metrics_hist_e
+{
+	MET_H_VENC_MS = 0,			//VENC u64PTS 到取出码流的时间（毫秒）
+	MET_H_NET_MS,				//VENC u64PTS 到写入传输层的时间（毫秒）
+	MET_H_UPLOAD_WAIT_S,		//文件在上传队列中的等待时间（秒）
+	MET_H_NUM
+}metrics_hist_e;
+
+/*---跟踪事件-----------------------------*/
+typedef enum _metrics_trace_e
+{
+	TRACE_VENC_GET = 1,			//取到视频帧：stream 编码通道，arg1 pts（毫秒），arg2 长度
+	TRACE_AENC_GET,				//取到音频帧
+	TRACE_SDP_DROP,				//分发队列丢帧：stream 编码通道，arg1 队列号，arg2 积压的视频帧数
+	TRACE_NET_SEND,				//写入传输层：stream 广播组，arg1 pts，arg2 长度
+	TRACE_NET_DISCARD,			//发送缓存超过阈值：stream 广播组，arg1 丢弃的帧数，arg2 发送缓存字节数
+	TRACE_MUX_TS,				//TS 录像写入一帧：arg1 pts，arg2 长度
+	TRACE_MUX_FMP4,				//fMP4 录像写入一帧
+	TRACE_UPLOAD_POP			//上传队列出队：stream 优先级，arg1 等待秒数，arg2 字节数
+}metrics_trace_e;
+
+/*跟踪记录（16 字节，CMD_GET_TRACE 按此格式原样发送，小端）*/
+typedef struct _metrics_trace_rec_t
+{
+	HLE_U32 	ts_us;				//事件时间（PTS 时钟的低 32 位，微秒）
+	HLE_U16 	event;				//metrics_trace_e
+	HLE_U8 		stream;
+	HLE_U8 		type;				//FRAME_HDR.type（帧事件）
+	HLE_U32 	arg1;
+	HLE_U32 	arg2;
+}metrics_trace_rec_t;
+
+struct _json_writer_t;
+/*采集回调：生成快照时调用，把模块的状态写成一个对象的成员*/
+typedef void (*metrics_collect_f)(struct _json_writer_t *w);
+
+extern HLE_U32 g_metrics_flags;
+
+#ifndef METRICS_DISABLE
+#define METRICS_FLAGS()				__atomic_load_n(&g_metrics_flags, __ATOMIC_RELAXED)
+#define METRICS_ON()				(METRICS_FLAGS() & METRICS_F_ON)
+#define METRICS_ADD(id, n)			do { if (METRICS_ON()) metrics_counter_add(id, n); } while (0)
+#define METRICS_INC(id)				METRICS_ADD(id, 1)
+#define METRICS_GAUGE(id, val)		do { if (METRICS_ON()) metrics_gauge_set(id, val); } while (0)
+#define METRICS_HIST(id, val)		do { if (METRICS_ON()) metrics_hist_add(id, val); } while (0)
+#define METRICS_TRACE(ev, stream, type, arg1, arg2)	\
+	do { if (METRICS_FLAGS() & METRICS_F_TRACE) metrics_trace(ev, stream, type, arg1, arg2); } while (0)
+#else
+#define METRICS_FLAGS()				0
+#define METRICS_ON()				0
+#define METRICS_ADD(id, n)			do { } while (0)
+#define METRICS_INC(id)				do { } while (0)
+#define METRICS_GAUGE(id, val)		do { } while (0)
+#define METRICS_HIST(id, val)		do { } while (0)
+#define METRICS_TRACE(ev, stream, type, arg1, arg2)	do { } while (0)
+#endif
+
+/*埋点宏调用的实现（不检查开关，一般不直接调用）*/
+void metrics_counter_add(int id, HLE_U32 n);
+void metrics_gauge_set(int id, HLE_S32 val);
+void metrics_hist_add(int id, HLE_U32 val);
+void metrics_trace(int event, int stream, int type, HLE_U32 arg1, HLE_U32 arg2);
+
+/*******************************************************************************
+*@ Description    :当前时间（与 VENC u64PTS 同一个时钟）
+*@ Input          :
+*@ Output         :
+*@ Return         :微秒
+*@ attention      :帧时延 = metrics_now_us()/1000 - pts_msec，只在 METRICS_FLAGS() 非 0 时调用
+*******************************************************************************/
+HLE_U64 metrics_now_us(void);
+
+/*******************************************************************************
+*@ Description    :打开/关闭统计和跟踪
+*@ Input          :<flags>METRICS_F_ON | METRICS_F_TRACE 的组合
+*@ Output         :
+*@ Return         :成功：0 ； 跟踪环分配失败：HLE_RET_ENORESOURCE（统计仍按 flags 设置）
+*@ attention      :跟踪环在第一次打开跟踪时分配，之后不再释放（关闭跟踪时可能还有任务在写）
+*******************************************************************************/
+int metrics_set_flags(HLE_U32 flags);
+
+/*统计清零（计数器、直方图、水位的最大值），跟踪环不变*/
+void metrics_clear(void);
+
+/*******************************************************************************
+*@ Description    :注册采集回调
+*@ Input          :<name>快照中对象的键（静态字符串） <fn>回调
+*@ Output         :
+*@ Return         :成功：0 ； 失败：HLE_RET_ENORESOURCE
+*@ attention      :同一个 name 重复注册时替换原来的回调；fn 为 NULL 时注销
+*******************************************************************************/
+int metrics_register_collector(const char *name, metrics_collect_f fn);
+
+/*******************************************************************************
+*@ Description    :生成 JSON 快照
+*@ Input          :<buf><size>输出缓存（METRICS_JSON_MAX 足够）
+*@ Output         :
+*@ Return         :成功：长度 ； 缓存不够：-1
+*@ attention      :
+*******************************************************************************/
+int metrics_snapshot(char *buf, int size);
+
+/*******************************************************************************
+*@ Description    :读取跟踪记录
+*@ Input          :<cursor>要读的第一条记录的序号（比环中最旧的记录还旧时从最旧的开始）
+					<max>最多读取的条数
+*@ Output         :<cursor>下一次读取的序号
+					<out>记录
+*@ Return         :读到的条数
+*@ attention      :第一次读取全部记录时 cursor 取 metrics_trace_pos() - METRICS_TRACE_NUM；
+					跟踪打开期间读取，最新的一条可能还没有写完
+*******************************************************************************/
+int metrics_trace_read(HLE_U32 *cursor, metrics_trace_rec_t *out, int max);
+
+/*已经写入的跟踪记录总数（下一条记录的序号）*/
+HLE_U32 metrics_trace_pos(void);
+
+/*shell 命令：metrics [show | on | off | clear | trace on | trace off | trace dump [n]]*/
+int metrics_shell(int argc, char *argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,38 @@
+/***************************************************************************
+* @file:pcm_resample.h
+* @author:
+* @date:  10,19,2026
+* @brief:  定点多相（polyphase）PCM 重采样，支持任意有理数比例（out_rate/in_rate 约分为 L/M）
+* @attention:输入输出均为交织的 16bit PCM；句柄内部保存滤波历史，同一路音频需连续调用
+***************************************************************************/
+#ifndef _PCM_RESAMPLE_H
+#define _PCM_RESAMPLE_H
+
+#define PCM_RESAMPLE_TAPS			32		//每个相位的滤波器抽头数（必须为偶数）
+#define PCM_RESAMPLE_MAX_PHASES		1024	//约分后 L 的上限（系数表大小 = L * PCM_RESAMPLE_TAPS * 2 字节）
+#define PCM_RESAMPLE_MAX_CHANNELS	2
+#define PCM_RESAMPLE_CHUNK			256		//内部每次处理的输入样本数（每声道）
+
+typedef struct _pcm_resample_t pcm_resample_t;
+
+/*---#-统计信息（用于评估 CPU 负载 / 丢数据）----------------------------------*/
+typedef struct _pcm_resample_stat_t
+{
+	int					in_rate;
+	int					out_rate;
+	int					up;				//约分后的 L
+	int					down;			//约分后的 M
+	unsigned long long	in_samples;		//累计输入样本数（每声道）
+	unsigned long long	out_samples;	//累计输出样本数（每声道）
+	unsigned int		clipped;		//输出饱和次数
+}pcm_resample_stat_t;
+
+pcm_resample_t* pcm_resample_create(int in_rate,int out_rate,int channels);
+int pcm_resample_max_output(pcm_resample_t*rs,int in_samples);
+int pcm_resample_process(pcm_resample_t*rs,const short*in,int in_samples,short*out,int out_max_samples);
+void pcm_resample_reset(pcm_resample_t*rs);
+void pcm_resample_get_stat(pcm_resample_t*rs,pcm_resample_stat_t*stat);
+void pcm_resample_destroy(pcm_resample_t*rs);
+
+#endif
+
@@ -1,10 +1,12 @@
- 
+
 /***************************************************************************
 * @file: system_upgrade.h
-* @author:   
+* @author:
 * @date:  5,5,2019
 * @brief:  系统升级相关函数头文件
-* @attention:
+* @attention:升级包 = 升级包头（UPGRADE_MANIFEST_SIZE 字节，RSA 签名）+ 镜像。
+			 升级数据可以分段输入（upgrade_begin/upgrade_feed/upgrade_end），边接收边擦写 flash，
+			 镜像写完并校验通过后才切换 config 分区中的启动分区。
 ***************************************************************************/
 #ifndef SYSTEM_UPGRADE_H
 #define SYSTEM_UPGRADE_H
@@ -12,16 +14,81 @@
 //升级状态
 typedef enum _upgrade_status_e
 {
+	UP_DOWNLOAD_FAILED = -12,	   //下载升级包失败
+	UP_BUSY = -11,				   //已经有升级在进行
+	UP_NO_MEMORY = -10,			   //内存不足
+	UP_WRITE_FAILED = -9,		   //写 flash 失败
+	UP_ERASE_FAILED = -8,		   //擦除 flash 失败
+	UP_CHECKSUM_FAILED = -7,	   //镜像校验失败（长度或 SHA256 与升级包头不符）
+	UP_VERSION_FAILED = -6,		   //版本校验失败（不高于当前运行的版本）
 	UP_SELECT_REGION_FAILED = -5,  //选择升级分区失败
+	UP_SIGNATURE_FAILED = -4,	   //升级包头签名校验失败
+	UP_BAD_MANIFEST = -3,		   //升级包头格式错误
 	UP_REGION_OVERFLOW = -2,	   //区域溢出（升级文件太大，系统分区放不下）
-	UP_ILLEGAL_PARAMETER = -1,	   //参数非法 
+	UP_ILLEGAL_PARAMETER = -1,	   //参数非法
 	UP_OK = 0
 }upgrade_status_e;
 
+#define UPGRADE_MANIFEST_MAGIC		0x484C4555	//"HLEU"
+#define UPGRADE_MANIFEST_SIZE		512			//升级包头大小（镜像紧跟其后）
+#define UPGRADE_SIGNATURE_MAX		256			//RSA-2048
+
+/*升级包头：除 signature 以外的部分（sig_len 之前）用 RSA-SHA256 签名*/
+typedef struct _upgrade_manifest_t
+{
+	unsigned int	magic;					//UPGRADE_MANIFEST_MAGIC
+	unsigned int	fw_version;				//固件版本号（递增），只接受比当前运行版本高的升级包
+	unsigned int	image_size;				//镜像大小（字节）
+	unsigned char	image_sha256[32];		//镜像的 SHA256
+	char			fw_name[64];			//固件描述，只用于打印
+	unsigned char	reserved[144];
+	unsigned int	sig_len;				//签名长度
+	unsigned char	signature[UPGRADE_SIGNATURE_MAX];
+}upgrade_manifest_t;
+
+typedef struct _upgrade_ctx_t upgrade_ctx_t;
+
+/*******************************************************************************
+*@ Description    :开始一次升级
+*@ Input          :
+*@ Output         :<status>失败原因
+*@ Return         :升级上下文；失败返回 NULL（已经有升级在进行 / 内存不足）
+*@ attention      :分区在收到并校验完升级包头之后才选择和擦除
+*******************************************************************************/
+upgrade_ctx_t *upgrade_begin(upgrade_status_e *status);
+
+/*******************************************************************************
+*@ Description    :输入升级包数据（任意长度分段）
+*@ Input          :<ctx>升级上下文
+					<data><len>数据
+*@ Output         :
+*@ Return         :UP_OK 或错误码（出错后后续输入都返回该错误，调用者应调用 upgrade_end 结束）
+*@ attention      :写满一个扇区就交给 flash 线程擦写，缓存用完时阻塞等待 flash 线程
+*******************************************************************************/
+upgrade_status_e upgrade_feed(upgrade_ctx_t *ctx, const void *data, unsigned int len);
+
+/*******************************************************************************
+*@ Description    :结束升级
+*@ Input          :<ctx>升级上下文（调用后释放）
+					<commit>1：数据已经全部输入，校验镜像并切换启动分区；0：放弃升级
+*@ Output         :
+*@ Return         :UP_OK 或错误码
+*@ attention      :失败时升级分区保持 FLAG_BAD，仍然从当前分区启动
+*******************************************************************************/
+upgrade_status_e upgrade_end(upgrade_ctx_t *ctx, int commit);
+
+//升级进度（0-100）
+int upgrade_progress(const upgrade_ctx_t *ctx);
+
+//是否有升级在进行
+int upgrade_is_running(void);
+
+//从 URL（http）下载升级包并升级（边下载边写 flash）
+upgrade_status_e upgrade_from_url(const char *url);
+
 upgrade_status_e upgrade_write_norflash(void *buf,unsigned int buf_len);
 int set_boot_region_bad(void);
 
 
 #endif
 
-
@@ -0,0 +1,41 @@
+/***************************************************************************
+* @file:ts_live_interface.h
+* @author:
+* @date:  10,19,2026
+* @brief:  直播 HLS 切片（边收帧边打包成TS分片，内存中维护滑动窗口 + m3u8）
+* @attention:
+***************************************************************************/
+#ifndef _TS_LIVE_INTERFACE_H
+#define _TS_LIVE_INTERFACE_H
+
+#include "ts_interface.h"
+
+#define TS_LIVE_MAX_WINDOW		8			//m3u8 滑动窗口最多容纳的分片个数
+#define TS_LIVE_GRACE_SEGMENTS	1			//移出 m3u8 后仍然保留（可读）的分片个数，防止客户端拿着旧列表请求时分片已被覆盖
+#define TS_LIVE_M3U8_BUF_SIZE	1024		//m3u8 文本缓存大小
+
+
+/*---#-直播切片配置-----------------------------------------------------------*/
+typedef struct _ts_live_init_t
+{
+	int 			target_duration;		//目标分片时长（s），在该时长后遇到的第一个关键帧处切片
+	int 			window_size;			//m3u8 中保留的分片个数（1 ~ TS_LIVE_MAX_WINDOW）
+	int 			segment_buf_size;		//单个分片的缓存大小（预分配，内存总量 = (window_size + 1 + TS_LIVE_GRACE_SEGMENTS) * segment_buf_size）
+	char			name_prefix[32];		//m3u8 中分片文件名前缀（生成 <name_prefix>_<seq>.ts）
+	char			out_dir[64];			//不为空时同时把分片和 m3u8 写到该目录下（m3u8 先写临时文件再 rename）
+	ts_audio_init_t	audio_config;			//输入的 audio 配置信息（AAC 裸流，内部加 ADTS 头）
+}ts_live_init_t;
+
+
+int TS_live_init(ts_live_init_t *config);
+/*---# 循环放入帧数据（pts 为编码器帧头中的毫秒时间戳）-------------------*/
+int TS_live_put_video(void*frame,int frame_len,int is_key_frame,unsigned long long pts_msec);
+int TS_live_put_audio(void*frame,int frame_len,unsigned long long pts_msec);
+/*---# 供本地 HTTP 服务读取-------------------------------------------------*/
+int TS_live_get_playlist(char*out_buf,int out_buf_size);
+int TS_live_get_segment_size(unsigned int seq);
+int TS_live_read_segment(unsigned int seq,char*out_buf,int read_size,int offset);
+void TS_live_exit(void);
+
+#endif
+
@@ -0,0 +1,116 @@
+/***************************************************************************
+* @file: upload_sched.h
+* @author:
+* @date:  10,19,2026
+* @brief:  amazon 云上传调度（按优先级出队 + 按字节数准入 + 超时丢弃 + 多上传线程 + 限速）
+* @attention:
+	1.优先级：告警抓拍 JPEG > 告警录像 > 6s 预览 > m3u8，高优先级的节点总是先出队。
+	2.准入按队列中缓存的总字节数计算（而不是节点个数）。放不下时先丢弃更低优先级的节点，
+	  仍放不下则阻塞生产者（背压），超时后再丢弃同优先级最旧的节点。
+	  录像/告警线程不能被阻塞，用 upload_sched_push_nowait：不等待，直接丢弃同优先级最旧的节点。
+	3.每个节点都有截止时间，过期未上传的节点直接丢弃（不再占用带宽）。
+	4.告警录像的多个分段需要按顺序更新 m3u8，同一时刻只允许一个录像节点在上传。
+	5.所有上传线程共用一个令牌桶限速，给实时预览留出上行带宽。
+***************************************************************************/
+#ifndef _UPLOAD_SCHED_H_
+#define _UPLOAD_SCHED_H_
+
+#include "amazon_S3.h"
+
+#define UPLOAD_SCHED_MAX_BYTES		(1024*1024*4)	//队列中缓存的总字节数上限
+#define UPLOAD_SCHED_WAIT_TIME		10				//队列满时生产者最长等待时间（秒）
+#define UPLOAD_SCHED_WORKERS		2				//上传线程个数
+#define UPLOAD_SCHED_RATE			(256*1024)		//默认上传限速（字节/秒），0：不限速
+#define UPLOAD_SCHED_BURST			(64*1024)		//令牌桶容量（允许的突发字节数）
+
+/*---上传优先级（数值越小越优先）-----------------------------*/
+typedef enum _upload_prio_e
+{
+	UPLOAD_PRIO_JPG = 0,		//告警抓拍图片（app 端的缩略图）
+	UPLOAD_PRIO_CLIP,			//告警录像（TS_FLAG_START/MID/END/ONE）
+	UPLOAD_PRIO_PREVIEW,		//6s 预览视频（TS_FLAG_6S）
+	UPLOAD_PRIO_M3U,			//m3u8 文件
+	UPLOAD_PRIO_NUM
+}upload_prio_e;
+
+/*节点被丢弃（过期/队列满被挤掉）时的回调，负责释放节点资源*/
+typedef void (*upload_drop_f)(put_file_info_t *info, const char *reason);
+
+
+/*******************************************************************************
+*@ Description    :初始化上传调度器
+*@ Input          :<drop_cb>节点被丢弃时的回调（NULL：只释放 file_buf/stream）
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int upload_sched_init(upload_drop_f drop_cb);
+
+/*******************************************************************************
+*@ Description    :文件信息放入调度队列
+*@ Input          :<info>文件描述信息
+*@ Output         :
+*@ Return         :成功：0 ； 失败（被拒绝）：-1
+*@ attention      :无论成功与否，info 中 file_buf/stream 的所有权都交给调度器
+*******************************************************************************/
+int upload_sched_push(put_file_info_t *info);
+
+/*******************************************************************************
+*@ Description    :文件信息放入调度队列（不阻塞）
+*@ Input          :<info>文件描述信息
+*@ Output         :
+*@ Return         :成功：0 ； 失败（被拒绝）：-1
+*@ attention      :与 upload_sched_push 相同，只是放不下时不等待上传线程，
+					直接丢弃同优先级最旧的节点（只剩更高优先级的节点时拒绝新节点）
+*******************************************************************************/
+int upload_sched_push_nowait(put_file_info_t *info);
+
+/*******************************************************************************
+*@ Description    :取出当前优先级最高的节点（队列为空时阻塞等待）
+*@ Input          :
+*@ Output         :<info>文件描述信息
+					<prio>节点的优先级（上传结束后传给 upload_sched_done）
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int upload_sched_pop(put_file_info_t *info, int *prio);
+
+/*******************************************************************************
+*@ Description    :节点上传结束（成功或失败）
+*@ Input          :<prio>upload_sched_pop 返回的优先级
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void upload_sched_done(int prio);
+
+/*******************************************************************************
+*@ Description    :上传限速：发送 bytes 字节之前调用，超出速率时阻塞
+*@ Input          :<bytes>即将发送的字节数
+*@ Output         :
+*@ Return         :
+*@ attention      :所有上传线程共用一个令牌桶
+*******************************************************************************/
+void upload_sched_throttle(int bytes);
+
+/*******************************************************************************
+*@ Description    :设置上传限速
+*@ Input          :<rate>字节/秒，0：不限速
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void upload_sched_set_rate(int rate);
+
+/*******************************************************************************
+*@ Description    :获取文件对应的上传优先级
+*@ Input          :<info>文件描述信息
+*@ Output         :
+*@ Return         :upload_prio_e
+*@ attention      :
+*******************************************************************************/
+int upload_sched_prio(const put_file_info_t *info);
+
+
+#endif
+
@@ -25,10 +25,13 @@
 
 #include "dlfcn.h"
 //#include "curl/curl.h"
-#include "cJSON/cJSON.h"
+#include "json_stream.h"
 #include "amazon_S3.h"
 #include "typeport.h"
 #include "https_post.h"
+#include "aws_sigv4.h"
+#include "amazon_upload.h"
+#include "upload_sched.h"
 
 
 #define A_PUT_SUCCESS 1		//发送成功
@@ -51,8 +54,6 @@ const char base[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456
 static AMAZON_INFO g_amazon_info = {0,-1," "," "," "," "," "," "," "," ", " "}; 
 
 
-static char aws_yymmdd[12];  //上传 amazon web service 的时间戳
-static char aws_TimeStamp[20];
 
 /*---#获取设备的uiid------------------------------------------------------------*/
 //extern char *ipc_get_tutk_guid(void);
@@ -93,7 +94,7 @@ char *url_add_info_interface[3]={
 
 
 
-char *curl_get(cJSON *pushMsg, char *url);
+char *curl_get(const char *postData, char *url);
 
 
 int is_amazon_info_update(void)
@@ -158,13 +159,15 @@ void http_parse_url(const char *url, char *host, int *port, char *file_name)
     for (i = 0; patterns[i]; i++)//分离下载地址中的http协议
         if (strncmp(url, patterns[i], strlen(patterns[i])) == 0)
             start = strlen(patterns[i]);
+    if (start == strlen("https://"))//https 默认端口为443
+        *port = 443;
 
     //解析域名, 这里处理时域名后面的端口号会保留
     for (i = start; url[i] != '/' && url[i] != '\0'; i++, j++)
         host[j] = url[i];
     host[j] = '\0';
 
-    //解析端口号, 如果没有, 那么设置端口为80
+    //解析端口号, 如果没有, 那么设置端口为默认值(http:80 https:443)
     char *pos = strstr(host, ":");
     if (pos)
         sscanf(pos, ":%d", port);
@@ -315,199 +318,149 @@ int amazon_info_complet(char *path, char *url, char *type, char *finename)
 }
 
 /*******************************************************************************
-*@ Description    :  将http请求字符串转换成签名
-*@ Input          : <http_req>:http请求（字符串）
-*@ Output         : <stringToSign>:签名（字符串）
-*@ Return         :
+*@ Description    : amazon 云返回信息写入函数
+					（libcurl 进行 http put 操作接收到 amazon 云 的返回信息） 
+*@ Input          :<ptr> 所指向要写的数据
+					<size>每个数据块的大小
+					<nmemb>数据的块数
+*@ Output         :<stream>信息的输出位置
+*@ Return         :总数据的大小（size * nmemb）
 *******************************************************************************/
-void make_StringToSign(const char *http_req, char *stringToSign)
+size_t amazonWriteData(void *ptr, size_t size, size_t nmemb, void *stream)
 {
-	unsigned char sha[33] = {0}; //哈希值
-	char hex[65] = {0};
-	
-	SHA256((unsigned char*)http_req, strlen(http_req), sha);//求哈希值
-	make_hex(sha ,32, hex);
-
-	
-	strcpy(stringToSign, "AWS4-HMAC-SHA256\n");
-	strcat(stringToSign, aws_TimeStamp);
-	strcat(stringToSign, "\n");
-	char Scope[64];
-	snprintf(Scope,64,"%s/%s/s3/aws4_request\n", aws_yymmdd, g_amazon_info.regon);
-	strcat(stringToSign, Scope);
-	strcat(stringToSign, hex);
-	//printf("stringToSign==%s\n",stringToSign);
+    size_t data_size = size * nmemb;
+	if(data_size<1024)
+    	strcat((char *)stream, (char *)ptr);  
+    return data_size;
 }
 
 
 /*******************************************************************************
-*@ Description    :生成数字签名（测试版本） 
-*@ Input          :<YourSecretAccessKeyID>设备的私匙
-					<StringToSign>要转换成签名的链接（字符串）
-					
-*@ Output         :<Signature> 生成的签名
-*@ Return         :
+*@ Description    :  依据文件标记/类型，获取 amazon 云端子目录以及 http 的 Content-Type
+*@ Input          :	<tsflag>:TS文件的文件标记
+					<type>：文件类型
+*@ Output         :	<sub_dir>:云端子目录（不同文件类型推送路径不一样）
+					<filetype>:Content-Type
+*@ Return         :	上传超时时间（秒）
 *******************************************************************************/
-#if 1
-void make_signatue(char *YourSecretAccessKeyID, char *StringToSign, char *Signature)//SECRET_ACCESS_KEYID
+int amazon_get_dir_and_type(ts_flag_e tsflag, file_type_e type, char *sub_dir, char *filetype)
 {
-	int len = 0;
-
-	unsigned char Hamc_sha1[36];  unsigned char Hamc_sha2[36];
-	const EVP_MD * engine = NULL;
-	engine = EVP_sha256();
-	HMAC_CTX ctx; 
-
-	char AWS4_key[64]; strncpy(AWS4_key, "AWS4",64); strcat(AWS4_key, YourSecretAccessKeyID); 
-	HMAC_CTX_init(&ctx);  	
-	HMAC_Init_ex(&ctx, AWS4_key, strlen(AWS4_key), engine, NULL);  	
-	HMAC_Update(&ctx, (unsigned char*)aws_yymmdd, strlen(aws_yymmdd));
-	HMAC_Final(&ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_init(&ctx); 
-	HMAC_Init_ex(&ctx, Hamc_sha1, len, engine, NULL);  	
-	HMAC_Update(&ctx, (unsigned char*)g_amazon_info.regon, strlen(g_amazon_info.regon));////////////gai
-	HMAC_Final(&ctx, Hamc_sha2, &len);	
-	HMAC_CTX_cleanup(&ctx); 
-
-
-	HMAC_CTX_init(&ctx); 
-	HMAC_Init_ex(&ctx, Hamc_sha2, len, engine, NULL);  	
-	HMAC_Update(&ctx, (unsigned char*)"s3", strlen("s3"));////////////gai
-	HMAC_Final(&ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_init(&ctx); 
-	HMAC_Init_ex(&ctx, Hamc_sha1, len, engine, NULL);  	
-	HMAC_Update(&ctx, (unsigned char*)"aws4_request", strlen("aws4_request"));////////////gai
-	HMAC_Final(&ctx, Hamc_sha2, &len);	//printf("len =%d\n",len);
-	HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_init(&ctx); 
-	HMAC_Init_ex(&ctx, Hamc_sha2, len, engine, NULL);  	
-	HMAC_Update(&ctx, (unsigned char*)StringToSign, strlen(StringToSign));////////////gai
-	HMAC_Final(&ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	HMAC_CTX_cleanup(&ctx); 
-	
-	make_hex(Hamc_sha1 ,32, Signature);	
-}
-
-#else
-void make_signatue(char *YourSecretAccessKeyID, char *StringToSign, char *Signature)//SECRET_ACCESS_KEYID
-{
-	int len = 0;
-
-	unsigned char Hamc_sha1[36];  unsigned char Hamc_sha2[36];
-	const EVP_MD * engine = NULL;
-	engine = EVP_sha256();
-	HMAC_CTX *ctx = NULL; 
-	ctx = HMAC_CTX_new();
+	if(tsflag == TS_FLAG_JPG)//文件类型是JPEG，则需要到jpeg的目录下去取
+	{
+		strcpy(sub_dir,A_JPG_DIR);
+		strcpy(filetype,"image/jpeg");
+		return 50;
+	}
 	
-	char AWS4_key[64]; strcpy(AWS4_key, "AWS4"); strcat(AWS4_key, YourSecretAccessKeyID); 
-	HMAC_CTX_reset(ctx);	//HMAC_CTX_init(&ctx);  	
-	HMAC_Init_ex(ctx, AWS4_key, strlen(AWS4_key), engine, NULL);  	
-	HMAC_Update(ctx, (unsigned char*)aws_yymmdd, strlen(aws_yymmdd));
-	HMAC_Final(ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	//HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_reset(ctx); 
-	HMAC_Init_ex(ctx, Hamc_sha1, len, engine, NULL);  	
-	HMAC_Update(ctx, (unsigned char*)g_amazon_info.regon, strlen(g_amazon_info.regon));////////////gai
-	HMAC_Final(ctx, Hamc_sha2, &len);	
-	//HMAC_CTX_cleanup(&ctx); 
-
-
-	HMAC_CTX_reset(ctx); 
-	HMAC_Init_ex(ctx, Hamc_sha2, len, engine, NULL);  	
-	HMAC_Update(ctx, (unsigned char*)"s3", strlen("s3"));////////////gai
-	HMAC_Final(ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	//HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_reset(ctx); 
-	HMAC_Init_ex(ctx, Hamc_sha1, len, engine, NULL);  	
-	HMAC_Update(ctx, (unsigned char*)"aws4_request", strlen("aws4_request"));////////////gai
-	HMAC_Final(ctx, Hamc_sha2, &len);	//printf("len =%d\n",len);
-	//HMAC_CTX_cleanup(&ctx); 
-
-	HMAC_CTX_reset(ctx); 
-	HMAC_Init_ex(ctx, Hamc_sha2, len, engine, NULL);  	
-	HMAC_Update(ctx, (unsigned char*)StringToSign, strlen(StringToSign));////////////gai
-	HMAC_Final(ctx, Hamc_sha1, &len);	//printf("len =%d\n",len);
-	HMAC_CTX_free(ctx); 
+	if(tsflag == TS_FLAG_6S)
+		strcpy(sub_dir,A_VIDEO6s_DIR);
+	else //ts文件属于告警录像文件
+		strcpy(sub_dir,A_VIDEO_DIR);
 	
-	make_hex(Hamc_sha1 ,32, Signature);	
+	if(type == TYPE_TS || type == TYPE_FMP4)
+		strcpy(filetype,"video/mp2t");//x-mpeg
+	else
+		strcpy(filetype,"audio/mpegurl");
+
+	return (tsflag == TS_FLAG_6S) ? 50 : 150;
 }
-#endif
 
 /*******************************************************************************
-*@ Description    :生成签名（亚马逊版本） 
-*@ Input          :<YourSecretAccessKeyID> 设备端私匙
-					<Stringtosign>要转换成签名的链接（字符串）
-*@ Output         :
-*@ Return         : 签名
+*@ Description    :  构造 amazon 云的请求行 + 请求头（含 SigV4 签名 Authorization）
+*@ Input          :	<method>:请求方法（PUT/POST/DELETE）
+					<http_url>:完整的url（可带 ?uploads 等 query 参数，路径/参数值需已经过 URI 编码）
+					<filetype>:Content-Type
+					<content_len>:body 的长度
+					<payload_hash>:body 的 SHA256（十六进制），NULL 则使用 UNSIGNED-PAYLOAD（不对 body 做哈希）
+					<size>:headers 缓存大小
+*@ Output         :	<headers>:请求头字符串（每行以\r\n结束，不包含最后的空行）
+*@ Return         :成功：0  	失败：-1
+*@ attention      :签名密钥按天缓存（aws_sigv4.c），每次请求只需对规范请求做一次哈希 + 一次 HMAC
 *******************************************************************************/
-#if 1
-char *make_signatue_am(char *YourSecretAccessKeyID, char *Stringtosign)//SECRET_ACCESS_KEYID
+int amazon_make_headers(const char *method, const char *http_url, const char *filetype, int content_len,
+							const char *payload_hash, char *headers, int size)
 {
-	char *Signature = NULL;
-	char Hamc_sha1[256];
-	const EVP_MD * engine = NULL;
-	engine = EVP_sha1();
-	HMAC_CTX ctx;  
-	HMAC_CTX_init(&ctx);  
-	HMAC_Init_ex(&ctx, YourSecretAccessKeyID, strlen(YourSecretAccessKeyID), engine, NULL);  
-	HMAC_Update(&ctx, (unsigned char*)Stringtosign, strlen(Stringtosign));		// input is OK; &input is WRONG !!!  
-	int len = 0;
-	HMAC_Final(&ctx, Hamc_sha1, &len);  
-	HMAC_CTX_cleanup(&ctx); 
-	
-	Signature = base64_encode1(Hamc_sha1,20);
-	//printf("\n%d  %d\nSignature=%s\n", strlen(Hamc_sha1),strlen(Signature),Signature);
-	return Signature;
-}
+	if(NULL == method || NULL == http_url || NULL == filetype || NULL == headers || size <= 0)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+	if(NULL == payload_hash)
+		payload_hash = AWS_UNSIGNED_PAYLOAD;
 
-#else
-char *make_signatue_am(char *YourSecretAccessKeyID, char *Stringtosign)//SECRET_ACCESS_KEYID
-{
-	char *Signature = NULL;
-	char Hamc_sha1[256];
-	const EVP_MD * engine = NULL;
-	engine = EVP_sha1();
-  
-	HMAC_CTX *ctx = NULL; 
-	ctx = HMAC_CTX_new();
-	
-	HMAC_CTX_reset(ctx);  
-	HMAC_Init_ex(ctx, YourSecretAccessKeyID, strlen(YourSecretAccessKeyID), engine, NULL);  
-	HMAC_Update(ctx, (unsigned char*)Stringtosign, strlen(Stringtosign));		// input is OK; &input is WRONG !!!  
-	int len = 0;
-	HMAC_Final(ctx, Hamc_sha1, &len);  
-	HMAC_CTX_free(ctx); 
-	
-	Signature = base64_encode1(Hamc_sha1,20);
-	//printf("\n%d  %d\nSignature=%s\n", strlen(Hamc_sha1),strlen(Signature),Signature);
-	return Signature;
-}
+	/*---#构造应答的时间戳，年月日，时分秒------------------------------------------------------------*/
+	char amz_date[20];
+	time_t timer=time(NULL); 
+	struct tm gmt;
+	gmtime_r(&timer,&gmt);
+	snprintf(amz_date, sizeof(amz_date),"%04d%02d%02dT%02d%02d%02dZ", 1900+gmt.tm_year, 1+gmt.tm_mon, gmt.tm_mday, gmt.tm_hour, gmt.tm_min, gmt.tm_sec);
 
-#endif
+	char time_str[64];
+	get_datetime(time_str);
 
+	/*---#url 拆分成路径和 query（签名用）------------------------------------------------------------*/
+	char uri[512];
+	const char *query = NULL;
+	const char *p = strstr(http_url,"://");
+	p = p ? strchr(p + 3,'/') : http_url;
+	if(NULL == p)
+		p = "/";
+	snprintf(uri,sizeof(uri),"%s",p);
+	char *q = strchr(uri,'?');
+	if(q)
+	{
+		*q = '\0';
+		query = q + 1;
+	}
 
-/*******************************************************************************
-*@ Description    : amazon 云返回信息写入函数
-					（libcurl 进行 http put 操作接收到 amazon 云 的返回信息） 
-*@ Input          :<ptr> 所指向要写的数据
-					<size>每个数据块的大小
-					<nmemb>数据的块数
-*@ Output         :<stream>信息的输出位置
-*@ Return         :总数据的大小（size * nmemb）
-*******************************************************************************/
-size_t amazonWriteData(void *ptr, size_t size, size_t nmemb, void *stream)
-{
-    size_t data_size = size * nmemb;
-	if(data_size<1024)
-    	strcat((char *)stream, (char *)ptr);  
-    return data_size;
+	/*---#SigV4 签名------------------------------------------------------------*/
+	aws_header_t sign_headers[] = {
+		{"content-type", 			filetype},
+		{"host", 					g_amazon_info.host},
+		{"x-amz-acl", 				"public-read"},
+		{"x-amz-content-sha256", 	payload_hash},
+		{"x-amz-date", 				amz_date},
+	};
+	aws_sigv4_req_t req;
+	memset(&req,0,sizeof(req));
+	req.method 			= method;
+	req.uri 			= uri;
+	req.query 			= query;
+	req.headers 		= sign_headers;
+	req.header_num 		= sizeof(sign_headers)/sizeof(sign_headers[0]);
+	req.payload_hash 	= payload_hash;
+	req.amz_date 		= amz_date;
+	req.region 			= g_amazon_info.regon;
+	req.service 		= "s3";
+	req.access_key 		= g_amazon_info.aws_access_keyid;
+	req.secret_key 		= g_amazon_info.secret_aceess_keyid;
+
+	char authorization[512];
+	if(aws_sigv4_sign(&req,authorization,sizeof(authorization)) < 0)
+	{
+		ERROR_LOG("aws_sigv4_sign failed!\n");
+		return -1;
+	}
+
+	int len = snprintf(headers,size,"%s %s HTTP/1.1\r\n"
+							"Content-Type: %s\r\n"
+							"Content-Length: %d\r\n"
+							"Host: %s\r\n"
+							"Date: %s\r\n"
+							"X-Amz-Date: %s\r\n"					//X-Amz-Date: 20150830T123600Z
+							"x-amz-acl: public-read\r\n"
+							"x-amz-content-sha256: %s\r\n"
+							"Authorization: %s\r\n"
+							"Connection: keep-alive\r\n",
+							method, http_url, filetype, content_len, g_amazon_info.host, time_str, amz_date,
+							payload_hash, authorization);
+	if(len < 0 || len >= size)
+	{
+		ERROR_LOG("headers buf too small(%d)!\n",size);
+		return -1;
+	}
+	DEBUG_LOG("********************\nheaders:\n%s\n********************\n", headers);
+	return 0;
 }
 
 
@@ -534,98 +487,14 @@ int amazon_curl_send(char *filename,void*file_buf,int file_len,ts_flag_e tsflag,
 	char sub_dir[16] = {0};  // amazon 云端目标路径中的子项目录（不同文件类型推送路径不一样）	
 	char path[256] = {0}; //推送amazon云的路径
 	char http_url[512] = {0}; //完整的	推送amazon云的 URL
-	int timeout = 0;;
-
-	/*---#构造应答的时间戳，年月日，时分秒------------------------------------------------------------*/
-	time_t timer=time(NULL); 
-	struct tm *gmt = gmtime(&timer);
-	snprintf(aws_yymmdd,12 ,"%04d%02d%02d", 1900+gmt->tm_year, 1+gmt->tm_mon, gmt->tm_mday);
-	snprintf(aws_TimeStamp, 20,"%04d%02d%02dT%02d%02d%02dZ", 1900+gmt->tm_year, 1+gmt->tm_mon, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec);
-	DEBUG_LOG("aws_yymmdd =%s, aws_TimeStamp=%s\n",aws_yymmdd, aws_TimeStamp);
+	char host[128];
+	char* response = NULL;
 
 	/*---#构造amazon云端子目录（将文件推送到哪个子目录）-----------------------------------------------*/
-	if(tsflag == TS_FLAG_JPG)//文件类型是JPEG，则需要到jpeg的目录下去取
-	{
-		strcpy(sub_dir,A_JPG_DIR);
-		strcpy(filetype,"image/jpeg");
-		timeout = 50;
-	}
-	else if(tsflag == TS_FLAG_6S )
-	{
-		strcpy(sub_dir,A_VIDEO6s_DIR);
-		if(type==TYPE_TS||TYPE_FMP4)
-			strcpy(filetype,"video/mp2t");//x-mpeg
-		else
-			strcpy(filetype,"audio/mpegurl");
-		timeout = 50;
-	}
-	/*
-	else if(tsflag == TS_FLAG_ONE)// ?????????????
-	{
-		goto ERR;
-	}
-	*/
-	else//ts文件属于告警录像文件
-	{
-		strcpy(sub_dir,A_VIDEO_DIR);
-		if(type==TYPE_TS||TYPE_FMP4)
-			strcpy(filetype,"video/mp2t");//x-mpeg
-		else
-			strcpy(filetype,"audio/mpegurl");
-		timeout = 150;
-	}
+	amazon_get_dir_and_type(tsflag, type, sub_dir, filetype);
 	
 	/*---构造完整 amazon 云 文件推送的 url 字符串---------------*/
 	amazon_info_complet(path, http_url, sub_dir, filename);
-		
-	////////////////////////////////////////////////////////////////aws
-	/*---http PUT命令构造-----------------
-	PUT
-	
-	filetype
-	time_str
-	aws_TimeStamp
-	x-amz-acl:public-read
-	*/
-	char http_req[256];	
-	http_req[0] = '\0';
-	strcat(http_req,"PUT\n");	 
-	strcat(http_req,"\n");
-	strcat(http_req,filetype);	
-	strcat(http_req,"\n");		
-
-	char time_str[64];
-	get_datetime(time_str);
-	strcat(http_req,time_str);
-	strcat(http_req,"\n");
-	strcat(http_req,aws_TimeStamp);
-	strcat(http_req,"\n");
-	
-	strcat(http_req,"x-amz-acl:public-read\n");//test		
-
-	//strcat(http_req,"x-amz-content-sha256: UNSIGNED-PAYLOAD\n");
-	
-	//printf("http_req//////////////////\n%s\n////////////////\n",http_req);
-	
-	/*---将请求字符串转换成数字签名 Signature--------------------------------*/
-	char stringToSign[256] = {0};
-	make_StringToSign(http_req , stringToSign);
-	unsigned char Signature[65] = {0};
-	make_signatue(g_amazon_info.secret_aceess_keyid, stringToSign, Signature);
-
-	/*---依据签名生成数字证书 Authorization,加到请求头里边------------------------------------------------*/
-	char Authorization[1024];	
-	Authorization[0] = '\0';
-	snprintf(Authorization,1024	,"Authorization: AWS4-HMAC-SHA256 "
-							"Credential=%s/%s/%s/s3/aws4_request, "
-							"SignedHeaders=content-type;host;x-amz-date;x-amz-acl, "
-							"Signature=%s",
-							g_amazon_info.aws_access_keyid, 
-							aws_yymmdd, 
-							g_amazon_info.regon,
-							Signature
-							);
-	DEBUG_LOG("********************\nAuthorization:\n%s\n********************\n", Authorization);
 
 	/*--- https 设置请求头------------------------------*/
 	char * headers = (char*)malloc(1024*3);
@@ -635,61 +504,22 @@ int amazon_curl_send(char *filename,void*file_buf,int file_len,ts_flag_e tsflag,
 		goto ERR;
 	}
 	memset(headers,0,1024*3);
-
-	snprintf(headers,1024*3,"POST %s HTTP/1.0\r\n", http_url);
-	char content_type[128] = {0};
-	snprintf(content_type,sizeof(content_type),"Content-Type: %s",filetype);
-	strcat(headers,content_type);
-	strcat(headers,"\r\n");
-	
-	char contentlen[64];
-	snprintf(contentlen,64,"Content-Length: %d", file_len);
-	strcat(headers,contentlen);
-	strcat(headers,"\r\n");
-	
-	char host[128];
-	snprintf(host,sizeof(host),"Host: %s",g_amazon_info.host);
-	strcat(headers,host);
-	strcat(headers,"\r\n");
-
-	
-	char time_str1[64];	
-	snprintf(time_str1,sizeof(time_str1),"Date: %s",time_str);
-	strcat(headers,time_str1);
-	strcat(headers,"\r\n");
-	
-	char aws_date[64];
-	snprintf(aws_date,sizeof(aws_date),"X-Amz-Date: %s",aws_TimeStamp);//X-Amz-Date: 20150830T123600Z
-	strcat(headers,aws_date);
-	strcat(headers,"\r\n");
-	
-	strcat(headers,"x-amz-acl: public-read");
-	strcat(headers,"\r\n");
-	
-	strcat(headers,"x-amz-content-sha256: UNSIGNED-PAYLOAD");
-	strcat(headers,"\r\n");
-	
-	strcat(headers,Authorization);
-	strcat(headers,"\r\n");
-	
-	strcat(headers,"Connection: Keep-Alive");
-	strcat(headers,"\r\n");
-	
-	strcat(headers,"Expect: 100-continue");
-	strcat(headers,"\r\n");
+	if(amazon_make_headers("PUT", http_url, filetype, file_len, NULL, headers, 1024*3 - 2) < 0)
+		goto ERR;
+	strcat(headers,"\r\n"); //请求头结束的空行
 	
-	//char host[128] = {0};
 	char file_name[64] = {0};
 	int port;
 	
-	char* response = calloc(1024,1);
+	response = calloc(1024,1);
 	if(NULL == response)
 	{
 		ERROR_LOG("calloc failed!\n");
-		return -1;
+		goto ERR;
 	}
 	
 	http_parse_url(http_url, host, &port,file_name);
+	upload_sched_throttle(file_len);
 	int ret = https_post(host,port,http_url,headers,(char*)file_buf,file_len,response,1024);
 	if(ret < 0)
 	{
@@ -756,194 +586,8 @@ ERR:
 *******************************************************************************/
 int amazon_curl_send_am(char *filename,void*file_buf,int file_len, char tsflag, char type)
 {	
-	DEBUG_LOG("1000000013 ,%s, %d\n",filename,tsflag);
-	char filetype[16]; 
-	char sub_dir[16]; //文件对应的子目录
-	char path[256];
-	char url[512];	
-	int timeout;
-
-	if(tsflag == TS_FLAG_JPG)
-	{
-		strcpy(sub_dir,A_JPG_DIR);
-		strcpy(filetype,"image/jpeg");
-		timeout = 50;
-	}
-	else if(tsflag == TS_FLAG_6S)
-	{
-		strcpy(sub_dir,A_VIDEO6s_DIR);
-		if(type==TYPE_TS||TYPE_FMP4)
-			strcpy(filetype,"video/mp2t");//x-mpeg
-		else
-			strcpy(filetype,"audio/mpegurl");
-		timeout = 50;
-	}
-	/*else if(tsflag == TS_FLAG_ONE)
-	{
-		return -1;
-	}
-	*/
-	else  //是告警的视频文件
-	{
-		strcpy(sub_dir,A_VIDEO_DIR);
-		if(type==TYPE_TS||TYPE_FMP4)
-			strcpy(filetype,"video/mp2t");//x-mpeg
-		else
-			strcpy(filetype,"audio/mpegurl");
-		timeout = 150;
-	}
-	amazon_info_complet(path, url, sub_dir, filename);//获取文件上传云服务的 URL
-	/*printf("1000011filename=%s,type=%s,path=%s\n url=%s\n%s,id=%s,key=%s\n",filename,sub_dir, path, url,
-	 	filetype,g_amazon_info.aws_access_keyid,g_amazon_info.secret_aceess_keyid);
-	*/
-
-	
-	/*---http PUT命令构造-----------------
-		PUT
-		
-		filetype
-		time_str
-		x-amz-acl:public-read
-		path
-		
-	*/
-	char Stringtosign[256];	
-	Stringtosign[0] = '\0';
-	strcat(Stringtosign,"PUT\n");	 
-	strcat(Stringtosign,"\n");
-	strcat(Stringtosign,filetype);	
-	strcat(Stringtosign,"\n");	
-	//strcat(Stringtosign,"image/jpeg\n");//"image/jpeg\n");	 	
-	
-	char time_str[64];
-	get_datetime(time_str);
-	strcat(Stringtosign,time_str);
-	strcat(Stringtosign,"\n");
-
-	if(type==TYPE_TS||TYPE_FMP4)
-		strcat(Stringtosign,"x-amz-acl:public-read\n");//test 	
-	 
-	strcat(Stringtosign,path);	
-	//printf("##########Stringtosign=#########\n%s\n#####################################\n", Stringtosign);
-
-	/*---#生成数字签名------------------------------------------------------------*/
-	char *Signature = NULL; //签名
-	Signature = make_signatue_am(g_amazon_info.secret_aceess_keyid,Stringtosign);
-
-	/*---#生成证书------------------------------------------------------------*/
-	char Authorization[1024];
-	Authorization[0] = '\0';
-	strcpy(Authorization,"Authorization: AWS ");
-	strcat(Authorization,g_amazon_info.aws_access_keyid);
-	strcat(Authorization,":");
-	strcat(Authorization,Signature);
-	free(Signature);
-	DEBUG_LOG("len=%d   %s\n",strlen(Authorization),Authorization);
-
-	/*---#设置请求头------------------------------------------------------------*/
-	char * headers = (char*)calloc(1024*3,sizeof(char));
-	if(NULL == headers)
-	{
-		ERROR_LOG("malloc failed!\n");
-		goto ERR;
-	}
-	//struct curl_slist *headers = NULL;
-	
-	snprintf(headers,1024*3, "POST %s HTTP/1.0\r\n", url);
-	char content_type[128]; 
-	strcpy(content_type, "Content-Type: ");
-	strcat(content_type,filetype);
-
-	strcat(headers,content_type);
-	strcat(headers,"\r\n");
-
-
-	char contentlen[64];
-	snprintf(contentlen,sizeof(contentlen),"Content-Length: %ld", file_len);
-	strcat(headers,contentlen);
-	strcat(headers,"\r\n");
-
-	char host[128];
-	snprintf(host,sizeof(host),"Host: %s",g_amazon_info.host);
-	strcat(headers,host);
-	strcat(headers,"\r\n");
-	//strcat(headers,g_amazon_info.host); //"s3.amazonaws.com"); //bucket-1-20180131.s3.cn-northwest-1.amazonaws.com.cn
-	DEBUG_LOG("host...................%s\n",g_amazon_info.host);
-	
-	char time_str1[64];
-	strcpy(time_str1,"Date: ");
-	strcat(time_str1,time_str);
-	strcat(headers,time_str1);
-	strcat(headers,"\r\n");
-
-	strcat(headers,Authorization);
-	strcat(headers,"\r\n");
-
-	
-	if(type==TYPE_TS||TYPE_FMP4) 
-	{
-		strcat(headers,"x-amz-acl: public-read");
-		strcat(headers,"\r\n");
-	}
-		
-	strcat(headers,"Connection: Keep-Alive");
-	strcat(headers,"\r\n");
-	strcat(headers,"Expect: 100-continue");
-	strcat(headers,"\r\n");
-
-	//char host[128] = {0};
-	char file_name[64] = {0};
-	int port;
-	
-	char* response = calloc(1024,1);
-	if(NULL == response)
-	{
-		ERROR_LOG("calloc failed!\n");
-		return -1;
-	}
-	
-	http_parse_url(url, host, &port,file_name);
-	int ret = https_post(host,port,url,headers,file_buf,file_len,response,1024);
-	if(ret < 0)
-	{
-		ERROR_LOG("https_post failed !\n");
-		goto ERR;
-	}
-	DEBUG_LOG(" ---push local file = %s ---servers response:%s---\n",filename, response);
-
-	
-	#if 0
-	/*---#初始化 + 设置选项------------------------------------------------------------*/
-	CURL *curl = curl_easy_init();
-	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);//设定为不验证证书和host    
-	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L); 
-	
-	curl_easy_setopt(curl, CURLOPT_URL, url);//url
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);//超时时间（单位：s）
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);//将设置 http 请求头参数
-	curl_easy_setopt(curl, CURLOPT_PUT, 1L); //设置用HTTP上传一个文件 
-	curl_easy_setopt(curl,  CURLOPT_INFILE, fp); //文件句柄设置
-	curl_easy_setopt(curl,  CURLOPT_INFILESIZE, fsize);  //文件大小设置
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, amazonWriteData);//设置一旦检测到有数据需要接收时的回调函数
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, str);//设置上方 amazonWriteData 回调函数的第4个参数（数据输出的大方）
-	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); 
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-
-	/*---#请求 + 打印返回信息------------------------------------------------------------*/
-	int ret= curl_easy_perform(curl);
-	curl_easy_cleanup(curl); 
-	#endif
-
-	
-
-	if(response) free(response);
-	if(headers) free(headers);
-	return 0;	
-ERR:
-
-	if(response) free(response);
-	if(headers) free(headers);
-	return -1;
+	//美国线上环境与开发/测试环境一样使用 SigV4 签名的 PUT（原 V2 签名只对 "PUT" 签名却发送 "POST"）
+	return amazon_curl_send(filename,file_buf,file_len,(ts_flag_e)tsflag,(file_type_e)type);
 }
 
 
@@ -1152,14 +796,16 @@ void amazon_send_even_info(put_file_info_t *info)//"/bucket-1-20180131/3db73d9c1
 	struct tm *lct = localtime(&timer);
 	snprintf(day,32,"%4d%02d%02d-%02d:%02d:%02d",lct->tm_year+1900,lct->tm_mon+1,lct->tm_mday,lct->tm_hour, lct->tm_min, lct->tm_sec);
 	
-	cJSON *jpush;
-	jpush = cJSON_CreateObject(); 
+	char post[1024];
+	json_writer_t jpush;
+	json_write_init(&jpush, post, sizeof(post));
+	json_write_obj_begin(&jpush, NULL);
 	
 	/*---#设备uiid------------------------------------------------------------*/
-	cJSON_AddStringToObject(jpush, "uiid", target);	
+	json_write_string(&jpush, "uiid", target);
 	
 	/*---#文件存储桶------------------------------------------------------------*/
-	cJSON_AddStringToObject(jpush, "bucket", g_amazon_info.bucket);
+	json_write_string(&jpush, "bucket", g_amazon_info.bucket);
 	
 	int name_offset = 0;
 	if(!strncmp(info->file_name,"/jffs0/",7)) name_offset = 7;
@@ -1174,54 +820,56 @@ void amazon_send_even_info(put_file_info_t *info)//"/bucket-1-20180131/3db73d9c1
 			
 	/*---#缩略图上传路径------------------------------------------------------------*/
 	snprintf(picpath,128,"%s/%s/%s/picture/%s",g_amazon_info.bucket, g_amazon_info.deviceid, g_amazon_info.date,info->file_name + name_offset);
-	cJSON_AddStringToObject(jpush, "picturePath", picpath);
+	json_write_string(&jpush, "picturePath", picpath);
 	
 	/*---#6秒视频索引文件上传路径------------------------------------------------------------*/
 	snprintf(vid6spath,128,"%s/%s/%s/video6s/%s",g_amazon_info.bucket, g_amazon_info.deviceid, g_amazon_info.date,info->file_name + name_offset);
-	cJSON_AddStringToObject(jpush, "video6sPath", vid6spath);
+	json_write_string(&jpush, "video6sPath", vid6spath);
 
 	if(strstr(info->file_name+5, "m3u8"))
 	{
 		/*---#完整视频索引文件上传路径------------------------------------------------------------*/
 		snprintf(vidpath,128,"%s/%s/%s/video/%s",g_amazon_info.bucket, g_amazon_info.deviceid, g_amazon_info.date,info->file_name + name_offset);
-		cJSON_AddStringToObject(jpush, "videoPath", vidpath);
+		json_write_string(&jpush, "videoPath", vidpath);
 	}
 	
 	/*---#视频上传时间 格式： yyyyMMdd-HH:mm:ss------------------------------------------------------------*/
-	cJSON_AddStringToObject(jpush, "time", day);
+	json_write_string(&jpush, "time", day);
+	json_write_obj_end(&jpush);
+	if(json_write_finish(&jpush) < 0)
+	{
+		ERROR_LOG("push message too long!\n");
+		return;
+	}
 
 	/*---#推送!!!------------------------------------------------------------*/
-	char *str = curl_get(jpush, url_add_info_interface[url_index]); 
-	cJSON_Delete(jpush);
+	char *str = curl_get(post, url_add_info_interface[url_index]); 
 	free(str);
 	
 }
 
 
 /*******************************************************************************
-*@ Description    :  往云端推送m3u8文件+TS文件+JPEG+fmp4文件
+*@ Description    :  往云端推送m3u8文件+TS文件+JPEG+fmp4文件（在调用线程中同步完成）
 *@ Input          :<arg>: put_file_info_t 信息
 *@ Output         :
-*@ Return         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :返回前释放 file_buf/stream
 *******************************************************************************/
-void* amazon_put_even(void *arg)
+static int amazon_put_file(put_file_info_t *arg)
 {
-	if(NULL == arg)
-	{
-		ERROR_LOG("Illegal parameter!\n");
-		pthread_exit(NULL);
-	}
-		
 	/*---#备份参数------------------------------------------------------------*/
 	put_file_info_t file_info;
 	memcpy(&file_info,arg,sizeof(put_file_info_t));
 	DEBUG_LOG("file_name : %s\n",file_info.file_name);
-	int ret;
-	static int failnum = 0; //上传失败的TS/fmp4文件个数
+	int ret = -1;
+	static int failnum = 0; //上传失败的TS/fmp4文件个数（上传线程共用，原子加）
 	/*---#分文件类型传输------------------------------------------------------------*/
 	if(file_info.file_type == TYPE_JPG)
 	{
-		if(url_index != AMAZON_PRODUCE)//开发环境/测试环境
+		if(file_info.mode == 1 || file_info.mode == 3) //文件/管道：流式上传，不需要整个文件的缓存
+			ret = amazon_stream_upload(&file_info);
+		else if(url_index != AMAZON_PRODUCE)//开发环境/测试环境
 			ret = amazon_curl_send(file_info.file_name ,file_info.file_buf,file_info.file_buf_len, file_info.ts_flag ,file_info.file_type); 
 		else //美国线上环境
 			ret = amazon_curl_send_am(file_info.file_name,file_info.file_buf,file_info.file_buf_len, file_info.ts_flag ,file_info.file_type);
@@ -1232,7 +880,9 @@ void* amazon_put_even(void *arg)
 	}
 	else if(file_info.file_type == TYPE_TS || file_info.file_type == TYPE_FMP4)
 	{
-		if(url_index != AMAZON_PRODUCE)//开发环境/测试环境
+		if(file_info.mode == 1 || file_info.mode == 3) //文件/管道：流式上传，不需要整个文件的缓存
+			ret = amazon_stream_upload(&file_info);
+		else if(url_index != AMAZON_PRODUCE)//开发环境/测试环境
 			ret = amazon_curl_send(file_info.file_name,file_info.file_buf,file_info.file_buf_len, file_info.ts_flag, file_info.file_type); 
 		else //美国线上环境
 			ret = amazon_curl_send_am(file_info.file_name,file_info.file_buf,file_info.file_buf_len, file_info.ts_flag, file_info.file_type); 
@@ -1243,8 +893,7 @@ void* amazon_put_even(void *arg)
 				m3u8_file_write(&file_info, A_PUT_FAIL);	
 				DEBUG_LOG("-1----------------put failed !!!!\n");
 			}
-			failnum ++;
-			ERROR_LOG("amazon_curl_send() fail:%d--->%s\n",failnum,file_info.file_name);
+			ERROR_LOG("amazon_curl_send() fail:%d--->%s\n",__atomic_add_fetch(&failnum,1,__ATOMIC_RELAXED),file_info.file_name);
 		}
 		else //put 成功
 		{
@@ -1261,7 +910,7 @@ void* amazon_put_even(void *arg)
 			if(ret != 0)
 			{
 				/*--- m3u8 发送失败，要不要重传？？？------------------------------------------------*/
-				printf("amazon_curl_send() fail:%d--->%s\n",++failnum,file_info.m3u8name);
+				printf("amazon_curl_send() fail:%d--->%s\n",__atomic_add_fetch(&failnum,1,__ATOMIC_RELAXED),file_info.m3u8name);
 			}
 			else  //m3u8文件发送成功，构造消息推送到云服务器,告知有新的图片视频文件上传
 			{   
@@ -1291,9 +940,30 @@ void* amazon_put_even(void *arg)
 		free(file_info.file_buf); 
 		file_info.file_buf = NULL;
 	}
+	if(file_info.stream) //未上传（如不支持的类型）时也要释放管道引用
+	{
+		upload_stream_release(file_info.stream);
+		file_info.stream = NULL;
+	}
 	
+	return ret == 0 ? 0 : -1;
+}
+
+/*******************************************************************************
+*@ Description    :  往云端推送文件的线程入口
+*@ Input          :<arg>: put_file_info_t 信息
+*@ Output         :
+*@ Return         :
+*******************************************************************************/
+void* amazon_put_even(void *arg)
+{
+	if(NULL == arg)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		pthread_exit(NULL);
+	}
+	amazon_put_file((put_file_info_t*)arg);
 	pthread_exit(NULL);
-	
 }
 
 /*******************************************************************************
@@ -1320,14 +990,13 @@ void amazon_put_even_thread(put_file_info_t *put_file)
 /*---#------------------------------------------------------------*/
 /*******************************************************************************
 *@ Description    : 推送消息到云服务器（视频图片信息推送接口） 
-*@ Input          : <pushMsg> 推送的消息字符串（jason格式）
+*@ Input          : <postData> 推送的消息字符串（jason格式，json_writer 生成）
 					<url>云服务的目标 url
 *@ Output         :
 *@ Return         :amazon 云 的返回信息（字符串指针）使用结束后需要free
 *******************************************************************************/
-char *curl_get(cJSON *pushMsg, char *url)
+char *curl_get(const char *postData, char *url)
 {
-	char *postData = cJSON_Print(pushMsg);
 	DEBUG_LOG("postData=%s;\n",postData);
 
 	char* content_type = "Content-Type: application/json";
@@ -1347,6 +1016,7 @@ char *curl_get(cJSON *pushMsg, char *url)
 	if(ret < 0)
 	{
 		ERROR_LOG("http_post_data failed !\n");
+		free(ret_buf);
 		return NULL;
 	}
 
@@ -1355,6 +1025,7 @@ char *curl_get(cJSON *pushMsg, char *url)
         if(tmp_fd < 0)
         {
             ERROR_LOG("open failed !\n");
+            free(ret_buf);
             return NULL;
         };
             
@@ -1363,6 +1034,7 @@ char *curl_get(cJSON *pushMsg, char *url)
         {
             ERROR_LOG("write error!\n");
             close(tmp_fd);
+            free(ret_buf);
             return NULL;
         }
         close(tmp_fd);
@@ -1376,6 +1048,31 @@ char *curl_get(cJSON *pushMsg, char *url)
 }
 
 
+/*---#amazon "验证设备图片视频上传接口" 返回信息中用到的字段------------------------------------------------------------*/
+typedef struct
+{
+	int 		status;
+	AMAZON_INFO info;
+}AMAZON_REPLY;
+
+static const json_field_t amazon_model_fields[] =
+{
+	JSON_FIELD_INT(AMAZON_REPLY, info.record_en, "serverStatus", JSON_F_REQUIRED),
+	JSON_FIELD_STR(AMAZON_REPLY, info.host, "host", JSON_F_REQUIRED),
+	JSON_FIELD_STR(AMAZON_REPLY, info.bucket, "bucket", JSON_F_REQUIRED),
+	JSON_FIELD_STR(AMAZON_REPLY, info.deviceid, "deviceCode", JSON_F_REQUIRED),
+	JSON_FIELD_STR(AMAZON_REPLY, info.aws_access_keyid, "s3AccessKey", JSON_F_REQUIRED),
+	JSON_FIELD_STR(AMAZON_REPLY, info.secret_aceess_keyid, "s3SecretAccessKey", JSON_F_REQUIRED),
+	JSON_FIELD_END
+};
+
+static const json_field_t amazon_reply_fields[] =
+{
+	JSON_FIELD_INT(AMAZON_REPLY, status, "status", JSON_F_REQUIRED),
+	JSON_FIELD_OBJ("model", amazon_model_fields, JSON_F_REQUIRED),
+	JSON_FIELD_END
+};
+
 /*******************************************************************************
 amazon "验证设备图片视频上传接口" 返回示例：
 {
@@ -1403,42 +1100,39 @@ int amazon_info_parse(AMAZON_INFO *rinfo,  const char *str)
 	if(str == NULL ||rinfo== NULL)
 		return -1;
 	
-	cJSON *jroot = cJSON_Parse(str);
-	if(!jroot)
+	AMAZON_REPLY reply;
+	int err_pos = 0;
+	memset(&reply, 0, sizeof(reply));
+	reply.status = -1;
+	int ret = json_parse(str, -1, amazon_reply_fields, &reply, &err_pos);
+	if(HLE_RET_ERROR == ret)
 	{
-		ERROR_LOG("amazon_info_parse fail!!\n");
+		ERROR_LOG("amazon_info_parse fail!! pos=%d\n", err_pos);
 		return -1;
 	}	
-	//memset(rinfo, 0, sizeof(AMAZON_INFO));
 	
-	cJSON *item, *item1;
-	item = cJSON_GetObjectItem(jroot,"status");  //200
-	if(item->valueint != 200)
+	if(reply.status != 200)
 	{ 
 		//rinfo->record_en = 1;
-		ERROR_LOG("status error!!! ,status=%d\n",item->valueint);
+		ERROR_LOG("status error!!! ,status=%d\n",reply.status);
+		return -1;
+	}
+	if(ret != HLE_RET_OK)
+	{
+		ERROR_LOG("amazon reply item missing or invalid!\n");
 		return -1;
 	}
-	
-	item = cJSON_GetObjectItem(jroot,"model"); 
 
-	item1 = cJSON_GetObjectItem(item,"serverStatus"); //0:上传缩略图,6s视频,长视频  1:只上传缩略图,6s视频
-	rinfo->record_en = item1->valueint;
+	rinfo->record_en = reply.info.record_en;
 	//if(rinfo->record_en == 1)
 		//return 0;
 	
-	item1 = cJSON_GetObjectItem(item,"date"); //上传日期(需要自己更新的，不用服务器下发的)
-	//mystrcpy(rinfo->date, item1->valuestring);  
-	item1 = cJSON_GetObjectItem(item,"host"); //上传域名
-	strcpy(rinfo->host, item1->valuestring);
-	item1 = cJSON_GetObjectItem(item,"bucket"); //上传桶目录
-	strcpy(rinfo->bucket, item1->valuestring);
-	item1 = cJSON_GetObjectItem(item,"deviceCode"); //设备编码目录
-	strcpy(rinfo->deviceid, item1->valuestring);
-	item1 = cJSON_GetObjectItem(item,"s3AccessKey"); //公匙
-	strcpy(rinfo->aws_access_keyid, item1->valuestring);
-	item1 = cJSON_GetObjectItem(item,"s3SecretAccessKey"); //私匙
-	strcpy(rinfo->secret_aceess_keyid, item1->valuestring);
+	//"date" 上传日期(需要自己更新的，不用服务器下发的)
+	strcpy(rinfo->host, reply.info.host);
+	strcpy(rinfo->bucket, reply.info.bucket);
+	strcpy(rinfo->deviceid, reply.info.deviceid);
+	strcpy(rinfo->aws_access_keyid, reply.info.aws_access_keyid);
+	strcpy(rinfo->secret_aceess_keyid, reply.info.secret_aceess_keyid);
 
 	if(strstr(rinfo->host, "cn-")) //域名里边带有cn-，则地区是中国（用的是中国的服务器）
 		strcpy(rinfo->regon, "cn-northwest-1");
@@ -1450,7 +1144,6 @@ int amazon_info_parse(AMAZON_INFO *rinfo,  const char *str)
 									rinfo->record_en,rinfo->date,rinfo->host,rinfo->bucket,rinfo->deviceid,
 									rinfo->aws_access_keyid,rinfo->secret_aceess_keyid);
 
-	cJSON_Delete(jroot);
 	return 0;
 }
 
@@ -1468,16 +1161,24 @@ int amazon_info_parse(AMAZON_INFO *rinfo,  const char *str)
 *******************************************************************************/
 void* get_amazon_put_info(void *arg)
 { 
-	cJSON *jpush;
+	char post[256];
+	json_writer_t jpush;
 	char *target = ipc_get_tutk_guid(); 
-	jpush = cJSON_CreateObject(); 
-	cJSON_AddStringToObject(jpush, "uiid", target);	 
-	char *str = curl_get(jpush, url_verify_up_interface[url_index]); //推送设备的 uiid 到云，获得 amazon 云的返回信息
-	cJSON_Delete(jpush); 
+	json_write_init(&jpush, post, sizeof(post));
+	json_write_obj_begin(&jpush, NULL);
+	json_write_string(&jpush, "uiid", target);
+	json_write_obj_end(&jpush);
+	if(json_write_finish(&jpush) < 0)
+	{
+		ERROR_LOG("uiid too long!\n");
+		return (void *)-1;
+	}
+	char *str = curl_get(post, url_verify_up_interface[url_index]); //推送设备的 uiid 到云，获得 amazon 云的返回信息
 	
 	if(0!=amazon_info_parse(&g_amazon_info, str))//解析亚马逊云的返回信息，解析到 g_amazon_info 变量
 	{
 		ERROR_LOG("amazon_info_parse fail!  %s\n",url_verify_up_interface[url_index]);
+		free(str);
 		return (void *)-1;
 	}
 	g_amazon_info.today_req = 1;
@@ -1609,101 +1310,100 @@ void amazon_S3_req_thread(void)
 /*======================================================================================================
 							告警音视频文件上传队列部分
 ======================================================================================================*/
-#include "link_queue.h"
 
+/*******************************************************************************
+*@ Description    :上传调度器丢弃节点（过期/队列满）时的回调
+*@ Input          :<info>被丢弃的文件信息
+					<reason>丢弃原因
+*@ Output         :
+*@ Return         :
+*@ attention      :file_buf/stream 由调度器释放，这里只处理业务相关的状态
+*******************************************************************************/
+static void amazon_upload_drop(put_file_info_t *info, const char *reason)
+{
+	if((info->file_type == TYPE_TS || info->file_type == TYPE_FMP4) &&
+		info->ts_flag >= TS_FLAG_START && info->ts_flag <= TS_FLAG_END)//连续的录像分段：m3u8 中记为失败
+	{
+		m3u8_file_write(info, A_PUT_FAIL);
+	}
+}
 
-QHeader* 				upload_file_queue = NULL;		//amazom上传文件队列头结点指针
-pthread_mutex_t 		up_file_queue_mut;				//队列锁
 /*******************************************************************************
 *@ Description    :将文件放入到（上传 amazom 云）上传队列
 *@ Input          :<file_info> 文件描述信息
 *@ Output         :
 *@ Return         :成功：0 ； 失败：-1
-*@ attention      :
+*@ attention      :按优先级入队（详见 upload_sched.h），队列放不下时先挤掉更低优先级的文件，
+					再阻塞等待上传线程取走节点（背压），超时后丢弃同优先级最旧的节点。
+					无论成功与否 file_buf/stream 都交给上传模块释放。
 *******************************************************************************/
 int push_to_upload_file_queue(put_file_info_t *file_info)
 {
-	if(NULL != upload_file_queue && NULL != file_info)
+	if(NULL == file_info)
+		return -1;
+
+	if(upload_sched_push(file_info) < 0)
 	{
-		int ret =0;		
-		pthread_mutex_lock(&up_file_queue_mut);
-		if(-3 == LQueueIsEmpty(upload_file_queue)) //如果队列已经满了，则先释放一个最旧的节点
-		{ 
-			put_file_info_t info = {0};
-			pop_frome_upload_file_queue(&info);
-			if(info.file_buf) free(info.file_buf);
-			
-		}
-		printf("---push file addr(%p)------ \n",file_info->file_buf);
-		ret = InLQueue(upload_file_queue,file_info);
-		pthread_mutex_unlock(&up_file_queue_mut);
-		if(ret < 0)
-		{
-			ERROR_LOG("InLQueue failed !\n");
-			return -1;
-		}
-		
-		return 0;
+		ERROR_LOG("upload_sched_push failed !\n");
+		return -1;
 	}
+	return 0;
+}
 
-	return -1;
+/*******************************************************************************
+*@ Description    :将文件放入到（上传 amazom 云）上传队列，不阻塞
+*@ Input          :<file_info> 文件描述信息
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :录像/告警线程调用：队列放不下时不等待，直接丢弃同优先级最旧的节点。
+					无论成功与否 file_buf/stream 都交给上传模块释放。
+*******************************************************************************/
+int push_to_upload_file_queue_nowait(put_file_info_t *file_info)
+{
+	if(NULL == file_info)
+		return -1;
+
+	if(upload_sched_push_nowait(file_info) < 0)
+	{
+		ERROR_LOG("upload_sched_push_nowait failed !\n");
+		return -1;
+	}
+	return 0;
 }
 
 /*******************************************************************************
-*@ Description    :从（上传 amazom 云）上传队列，出队最旧的一个节点
+*@ Description    :从（上传 amazom 云）上传队列，出队优先级最高的一个节点
 *@ Input          :
 *@ Output         :<file_info> （上传）文件的描述信息
 *@ Return         :成功：0 ； 失败：-1
-*@ attention      :
+*@ attention      :队列为空时阻塞等待；上传结束后需要调用 upload_sched_done
+					（该接口不返回优先级，默认按 upload_sched_prio(file_info) 计算）
 *******************************************************************************/
 int pop_frome_upload_file_queue(put_file_info_t* file_info)
 {
-	if(NULL != upload_file_queue && NULL != file_info)
-	{
-		int ret =0;
-		
-		pthread_mutex_lock(&up_file_queue_mut);
-		ret = DeLQueue(upload_file_queue,file_info);
-		pthread_mutex_unlock(&up_file_queue_mut);
-		if(ret < 0)
-		{
-			ERROR_LOG("DeLQueue failed !\n");
-			return -1;
-		}
+	if(NULL == file_info)
+		return -1;
 
-		//DEBUG
-		printf("---pop file addr(%p) \n",file_info->file_buf);
-		
-		return 0;
+	if(upload_sched_pop(file_info,NULL) < 0)
+	{
+		ERROR_LOG("upload_sched_pop failed !\n");
+		return -1;
 	}
 
-	return -1;
+	return 0;
 }
 
 extern int create_write_file(char*file_name,void* data,unsigned int data_len);
 /*******************************************************************************
-*@ Description    : 负责图片视频上传的线程入口（该线程需要常驻）
+*@ Description    : 上传线程（共 UPLOAD_SCHED_WORKERS 个）：按优先级取出文件并同步上传
 *@ Input          :
 *@ Output         :
 *@ Return         :
 *******************************************************************************/
-void* amazon_upload_thread(void*args)
+static void* amazon_upload_worker(void*args)
 {
-
 	pthread_detach(pthread_self());
 
-	//暂时屏蔽
-	//amazon_S3_req_thread();
-	pthread_mutex_init(&up_file_queue_mut,NULL);
-	
-	//初始化上传文件队列
-	upload_file_queue = CreateLQueue();
-	if(NULL == upload_file_queue)
-	{
-		ERROR_LOG("CreateLQueue failed!\n");
-		pthread_exit(NULL);
-	}
-
 	while(1)
 	{
 		#if 0  //临时注释，目前访问 amazon 服务器还无法正常返回
@@ -1713,42 +1413,81 @@ void* amazon_upload_thread(void*args)
             sleep(1);
         }
 		#endif 
-						
-		while(0 == LQueueIsEmpty(upload_file_queue))//队列不为空
+
+		put_file_info_t  pop_node = {0};
+		int prio = 0;
+		if(upload_sched_pop(&pop_node,&prio) < 0) //队列为空时阻塞，不需要轮询
 		{
-			put_file_info_t  pop_node = {0};
-			pop_frome_upload_file_queue(&pop_node);
-			
-			/*if(pop_node.file_type == TYPE_TS)//debug
-					create_write_file("/jffs0/MD_TS_01.ts",pop_node.file_buf,pop_node.file_buf_len);//DEBUG
-			*/
-			#if 1 //DEBUG 部分
-			if(pop_node.file_buf) 
-			{
-				printf("pop_node.file_buf_len = %d Bytes\n",pop_node.file_buf_len);
-				free(pop_node.file_buf); 
-				pop_node.file_buf = NULL;
-			}
+			sleep(1);
+			continue;
+		}
+		
+		/*if(pop_node.file_type == TYPE_TS)//debug
+				create_write_file("/jffs0/MD_TS_01.ts",pop_node.file_buf,pop_node.file_buf_len);//DEBUG
+		*/
+		#if 1 //DEBUG 部分
+		if(pop_node.file_buf) 
+		{
+			printf("pop_node.file_buf_len = %d Bytes\n",pop_node.file_buf_len);
+			free(pop_node.file_buf); 
+			pop_node.file_buf = NULL;
+		}
+		if(pop_node.stream) //读空管道，生产者不会被阻塞
+		{
+			char drain[1024];
+			int drain_len = 0;
+			int n;
+			while((n = upload_stream_read(pop_node.stream,drain,sizeof(drain))) > 0)
+				drain_len += n;
+			printf("pop_node.stream len = %d Bytes\n",drain_len);
+			upload_stream_release(pop_node.stream);
+			pop_node.stream = NULL;
+		}
 
-			#else   //正常的推送逻辑
-				amazon_put_even_thread(&pop_node);
-			#endif 
-			
+		#else   //正常的推送逻辑
+			amazon_put_file(&pop_node);
+		#endif 
 
-			
-		}
+		upload_sched_done(prio);
+	}
 
-		//do other things.....
-		usleep(100);
+	return NULL;
+}
+
+/*******************************************************************************
+*@ Description    : 负责图片视频上传的线程入口（该线程需要常驻）
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*******************************************************************************/
+void* amazon_upload_thread(void*args)
+{
+	int i;
+
+	//暂时屏蔽
+	//amazon_S3_req_thread();
+
+	for(i = 1; i < UPLOAD_SCHED_WORKERS; i++)
+	{
+		pthread_t threadID;
+		if(pthread_create(&threadID, NULL, &amazon_upload_worker, NULL) != 0)
+			ERROR_LOG("create amazon_upload_worker failed!\n");
 	}
-	
 
+	return amazon_upload_worker(args); //当前线程作为第一个上传线程
 }
 
 
 int  start_amazon_upload_thread(void)
 {
 	pthread_t threadID;
+
+	//先初始化上传调度器，线程启动之前入队的文件也不会丢失
+	if(upload_sched_init(amazon_upload_drop) < 0)
+	{
+		ERROR_LOG("upload_sched_init failed!\n");
+		return -1;
+	}
     HLE_S32 err = pthread_create(&threadID, NULL, &amazon_upload_thread, NULL);
     if (0 != err) 
     {
@@ -0,0 +1,789 @@
+/***************************************************************************
+* @file: amazon_upload.c
+* @author:
+* @date:  10,19,2026
+* @brief:  录像文件的流式上传（固定大小缓存 + 生产者背压 + 按分片续传）
+* @attention:
+	内存占用为 UPLOAD_PIPE_SIZE（管道）+ 当前分片的缓存（仅管道模式，随数据量从
+	UPLOAD_PART_INIT_SIZE 扩容，最大 UPLOAD_PART_SIZE）+ HTTPS_STREAM_BLOCK（写 SSL 的块）。
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "typeport.h"
+#include "amazon_S3.h"
+#include "amazon_upload.h"
+#include "https_post.h"
+#include "upload_sched.h"
+#include "aws_sigv4.h"
+
+#define UPLOAD_HEADERS_SIZE		(1024*3)	//请求头缓存大小
+#define UPLOAD_RESP_SIZE		1024		//响应 body 缓存大小
+#define UPLOAD_RESP_HEAD_SIZE	1024		//响应头缓存大小
+#define UPLOAD_ID_LEN			256			//multipart UploadId 最大长度
+#define UPLOAD_ETAG_LEN			48			//分片 ETag 最大长度
+#define UPLOAD_ETAG_STEP		16			//ETag 数组每次扩容的个数
+
+extern int amazon_get_dir_and_type(ts_flag_e tsflag, file_type_e type, char *sub_dir, char *filetype);
+extern int amazon_make_headers(const char *method, const char *http_url, const char *filetype, int content_len,
+								const char *payload_hash, char *headers, int size);
+extern int amazon_info_complet(char *path, char *url, char *type, char *finename);
+extern void http_parse_url(const char *url, char *host, int *port, char *file_name);
+extern unsigned long get_file_size(const char *path);
+
+
+/*======================================================================================================
+							生产者 --> 上传线程 的管道（环形缓冲）
+======================================================================================================*/
+struct _upload_stream_t
+{
+	pthread_mutex_t	mut;
+	pthread_cond_t	cond;
+	char			buf[UPLOAD_PIPE_SIZE];
+	int				r_pos;			//读位置
+	int				w_pos;			//写位置
+	int				count;			//当前缓存的数据量
+	int				closed;			//1：生产者已写完
+	int				aborted;		//1：任意一方放弃上传
+	int				refs;			//引用计数（生产者 + 上传线程）
+	char*			tail;			//生产者结束时交出的剩余数据（管道读完后接着读）
+	int				tail_len;
+	int				tail_pos;
+	int				info_set;		//1：生产者补充了以下信息
+	int				ts_flag;
+	int				file_tlen;
+};
+
+static void upload_stream_unref(upload_stream_t* s)
+{
+	int refs;
+	pthread_mutex_lock(&s->mut);
+	refs = --s->refs;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+
+	if(0 == refs)
+	{
+		if(s->tail)
+			free(s->tail);
+		pthread_mutex_destroy(&s->mut);
+		pthread_cond_destroy(&s->cond);
+		free(s);
+	}
+}
+
+upload_stream_t* upload_stream_create(void)
+{
+	upload_stream_t* s = (upload_stream_t*)calloc(1,sizeof(upload_stream_t));
+	if(NULL == s)
+	{
+		ERROR_LOG("calloc failed!\n");
+		return NULL;
+	}
+	pthread_mutex_init(&s->mut,NULL);
+	pthread_cond_init(&s->cond,NULL);
+	s->refs = 2;
+	return s;
+}
+
+int upload_stream_write(upload_stream_t* s, const void* data, int len)
+{
+	const char* p = (const char*)data;
+	struct timespec deadline;
+	struct timeval now;
+
+	if(NULL == s || NULL == data || len < 0)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+
+	gettimeofday(&now,NULL);
+	deadline.tv_sec = now.tv_sec + UPLOAD_STREAM_WRITE_TIMEOUT;
+	deadline.tv_nsec = now.tv_usec * 1000;
+
+	pthread_mutex_lock(&s->mut);
+	while(len > 0)
+	{
+		int n;
+		while(s->count == UPLOAD_PIPE_SIZE && !s->aborted) //管道满：等待上传线程读走（背压）
+		{
+			if(ETIMEDOUT == pthread_cond_timedwait(&s->cond,&s->mut,&deadline))
+			{
+				ERROR_LOG("upload stream write timeout, give up!\n");
+				s->aborted = 1;
+				pthread_cond_broadcast(&s->cond);
+			}
+		}
+		if(s->aborted)
+		{
+			pthread_mutex_unlock(&s->mut);
+			return -1;
+		}
+
+		n = UPLOAD_PIPE_SIZE - s->count;
+		if(n > len)
+			n = len;
+		if(n > UPLOAD_PIPE_SIZE - s->w_pos) //环形缓冲尾部
+			n = UPLOAD_PIPE_SIZE - s->w_pos;
+		memcpy(s->buf + s->w_pos,p,n);
+		s->w_pos = (s->w_pos + n) % UPLOAD_PIPE_SIZE;
+		s->count += n;
+		p += n;
+		len -= n;
+		pthread_cond_broadcast(&s->cond);
+	}
+	pthread_mutex_unlock(&s->mut);
+	return 0;
+}
+
+int upload_stream_try_write(upload_stream_t* s, const void* data, int len)
+{
+	int total = 0;
+
+	if(NULL == s || NULL == data || len < 0)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(&s->mut);
+	if(s->aborted)
+	{
+		pthread_mutex_unlock(&s->mut);
+		return -1;
+	}
+	while(len > 0 && s->count < UPLOAD_PIPE_SIZE) //最多两段（环形缓冲尾部 + 头部）
+	{
+		int n = UPLOAD_PIPE_SIZE - s->count;
+		if(n > len)
+			n = len;
+		if(n > UPLOAD_PIPE_SIZE - s->w_pos)
+			n = UPLOAD_PIPE_SIZE - s->w_pos;
+		memcpy(s->buf + s->w_pos,(const char*)data + total,n);
+		s->w_pos = (s->w_pos + n) % UPLOAD_PIPE_SIZE;
+		s->count += n;
+		total += n;
+		len -= n;
+	}
+	if(total > 0)
+		pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+	return total;
+}
+
+void upload_stream_set_info(upload_stream_t* s, int ts_flag, int file_tlen)
+{
+	if(NULL == s)
+		return;
+
+	pthread_mutex_lock(&s->mut);
+	s->ts_flag = ts_flag;
+	s->file_tlen = file_tlen;
+	s->info_set = 1;
+	pthread_mutex_unlock(&s->mut);
+}
+
+void upload_stream_close(upload_stream_t* s, int ok)
+{
+	if(NULL == s)
+		return;
+
+	pthread_mutex_lock(&s->mut);
+	if(ok)
+		s->closed = 1;
+	else
+		s->aborted = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+
+	upload_stream_unref(s);
+}
+
+void upload_stream_close_buf(upload_stream_t* s, char* buf, int len)
+{
+	if(NULL == s)
+	{
+		if(buf)
+			free(buf);
+		return;
+	}
+
+	pthread_mutex_lock(&s->mut);
+	if(buf && len > 0 && !s->aborted)
+	{
+		s->tail = buf;
+		s->tail_len = len;
+		buf = NULL;
+	}
+	s->closed = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+
+	if(buf) //上传已放弃
+		free(buf);
+	upload_stream_unref(s);
+}
+
+int upload_stream_read(upload_stream_t* s, void* buf, int size)
+{
+	int n;
+
+	if(NULL == s || NULL == buf || size <= 0)
+		return -1;
+
+	pthread_mutex_lock(&s->mut);
+	while(0 == s->count && !s->closed && !s->aborted)
+		pthread_cond_wait(&s->cond,&s->mut);
+
+	if(s->aborted)
+	{
+		pthread_mutex_unlock(&s->mut);
+		return -1;
+	}
+	if(0 == s->count) //closed：管道已读完，再读生产者交出的剩余数据
+	{
+		n = s->tail_len - s->tail_pos;
+		if(n > size)
+			n = size;
+		if(n > 0)
+		{
+			memcpy(buf,s->tail + s->tail_pos,n);
+			s->tail_pos += n;
+		}
+		pthread_mutex_unlock(&s->mut);
+		return n;
+	}
+
+	n = s->count;
+	if(n > size)
+		n = size;
+	if(n > UPLOAD_PIPE_SIZE - s->r_pos)
+		n = UPLOAD_PIPE_SIZE - s->r_pos;
+	memcpy(buf,s->buf + s->r_pos,n);
+	s->r_pos = (s->r_pos + n) % UPLOAD_PIPE_SIZE;
+	s->count -= n;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+	return n;
+}
+
+void upload_stream_release(upload_stream_t* s)
+{
+	if(NULL == s)
+		return;
+
+	pthread_mutex_lock(&s->mut);
+	if(!s->closed || s->count > 0 || s->tail_pos < s->tail_len) //数据没有读完，通知生产者不要再写
+		s->aborted = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mut);
+
+	upload_stream_unref(s);
+}
+
+
+/*======================================================================================================
+							请求 body 的读取源（每次重传前 reset，从分片开头重新读取）
+======================================================================================================*/
+typedef struct _mem_reader_t
+{
+	const char*		buf;
+	int				len;
+	int				pos;
+}mem_reader_t;
+
+typedef struct _file_reader_t
+{
+	int				fd;
+	unsigned int	start;			//当前分片的起始位置（重传时回到这里）
+	unsigned int	offset;			//当前读位置（相对文件开头）
+}file_reader_t;
+
+static int mem_body_read(void* arg, char* buf, int size)
+{
+	mem_reader_t* rd = (mem_reader_t*)arg;
+	int n = rd->len - rd->pos;
+	if(n > size)
+		n = size;
+	memcpy(buf,rd->buf + rd->pos,n);
+	rd->pos += n;
+	return n;
+}
+
+static int file_body_read(void* arg, char* buf, int size)
+{
+	file_reader_t* rd = (file_reader_t*)arg;
+	int n;
+	if(lseek(rd->fd,rd->offset,SEEK_SET) < 0)
+		return -1;
+	n = read(rd->fd,buf,size);
+	if(n > 0)
+		rd->offset += n;
+	return n;
+}
+
+
+/*======================================================================================================
+							上传会话
+======================================================================================================*/
+typedef struct _upload_session_t
+{
+	char			url[512];						//对象的完整 url（不含 query）
+	char			filetype[16];					//Content-Type
+	char			upload_id[UPLOAD_ID_LEN];		//multipart 的 UploadId
+	char			upload_id_enc[UPLOAD_ID_LEN*3];	//URI 编码后的 UploadId（用于 query）
+	const char*		payload_hash;					//当前请求 body 的 SHA256（NULL：UNSIGNED-PAYLOAD）
+	int				part_num;						//已经上传成功的分片个数
+	int				etag_cap;
+	char			(*etags)[UPLOAD_ETAG_LEN];		//每个分片的 ETag
+	char*			headers;
+	char			resp_head[UPLOAD_RESP_HEAD_SIZE];
+	char			resp[UPLOAD_RESP_SIZE];
+}upload_session_t;
+
+/*限速的 body 读取：每读出一块先向上传调度器申请带宽*/
+typedef struct _shaped_reader_t
+{
+	https_body_read_f	rd;
+	void*				arg;
+}shaped_reader_t;
+
+static int shaped_body_read(void* arg, char* buf, int size)
+{
+	shaped_reader_t* sr = (shaped_reader_t*)arg;
+	int n = sr->rd(sr->arg,buf,size);
+	if(n > 0)
+		upload_sched_throttle(n);
+	return n;
+}
+
+/*******************************************************************************
+*@ Description    :发送一次请求
+*@ Input          :<ss>上传会话
+					<method>请求方法
+					<query>url 的 query 部分（可为 NULL）
+					<rd>body 读取回调（无 body 传 NULL）
+					<arg>回调参数
+					<len>body 长度
+*@ Output         :
+*@ Return         :http 状态码 ； 失败：<0
+*@ attention      :
+*******************************************************************************/
+static int upload_request(upload_session_t* ss, const char* method, const char* query,
+								https_body_read_f rd, void* arg, int len)
+{
+	char url[1024];
+	char host[128];
+	char file_name[512];
+	int port;
+	shaped_reader_t sr = {rd,arg};
+
+	snprintf(url,sizeof(url),"%s%s",ss->url,query ? query : "");
+	if(amazon_make_headers(method,url,ss->filetype,len,ss->payload_hash,ss->headers,UPLOAD_HEADERS_SIZE) < 0)
+		return -1;
+
+	http_parse_url(url,host,&port,file_name);
+	ss->resp_head[0] = '\0';
+	ss->resp[0] = '\0';
+	return https_send_stream(host,port,ss->headers,rd ? shaped_body_read : NULL,&sr,len,
+								ss->resp_head,sizeof(ss->resp_head),ss->resp,sizeof(ss->resp));
+}
+
+/*在响应头中查找 ETag 字段*/
+static int parse_etag(const char* head, char* etag, int size)
+{
+	const char* p = head;
+	while(p && *p)
+	{
+		if(0 == strncasecmp(p,"ETag:",5))
+		{
+			int n = 0;
+			p += 5;
+			while(*p == ' ')
+				p++;
+			while(p[n] && p[n] != '\r' && p[n] != '\n' && n < size - 1)
+				n++;
+			memcpy(etag,p,n);
+			etag[n] = '\0';
+			return 0;
+		}
+		p = strchr(p,'\n');
+		if(p)
+			p++;
+	}
+	return -1;
+}
+
+/*在响应 xml 中查找 <tag>value</tag>*/
+static int parse_xml_value(const char* xml, const char* tag, char* value, int size)
+{
+	char begin[32];
+	char end[32];
+	const char* p;
+	const char* q;
+
+	snprintf(begin,sizeof(begin),"<%s>",tag);
+	snprintf(end,sizeof(end),"</%s>",tag);
+	p = strstr(xml,begin);
+	if(NULL == p)
+		return -1;
+	p += strlen(begin);
+	q = strstr(p,end);
+	if(NULL == q || q - p >= size)
+		return -1;
+	memcpy(value,p,q - p);
+	value[q - p] = '\0';
+	return 0;
+}
+
+/*上传整个对象（不分片），失败时重传*/
+static int upload_single(upload_session_t* ss, https_body_read_f rd, void* arg, void (*reset)(void*), int len)
+{
+	int retry;
+	for(retry = 0; retry <= UPLOAD_PART_RETRY; retry++)
+	{
+		int status;
+		if(retry > 0)
+			sleep(1 << (retry - 1));
+		reset(arg);
+		status = upload_request(ss,"PUT",NULL,rd,arg,len);
+		if(200 == status)
+			return 0;
+		ERROR_LOG("PUT %s failed(%d), retry %d\n",ss->url,status,retry);
+	}
+	return -1;
+}
+
+/*开始 multipart 上传，获取 UploadId*/
+static int upload_initiate(upload_session_t* ss)
+{
+	int status = upload_request(ss,"POST","?uploads",NULL,NULL,0);
+	if(200 != status || parse_xml_value(ss->resp,"UploadId",ss->upload_id,sizeof(ss->upload_id)) < 0 ||
+		aws_uri_encode(ss->upload_id,ss->upload_id_enc,sizeof(ss->upload_id_enc),0) < 0)
+	{
+		ERROR_LOG("initiate multipart upload failed(%d)!\n",status);
+		return -1;
+	}
+	DEBUG_LOG("UploadId = %s\n",ss->upload_id);
+	return 0;
+}
+
+/*上传一个分片：失败时只重传该分片（之前成功的分片不受影响）*/
+static int upload_part(upload_session_t* ss, https_body_read_f rd, void* arg, void (*reset)(void*), int len)
+{
+	char query[UPLOAD_ID_LEN*3 + 64];
+	int part_no = ss->part_num + 1;
+	int retry;
+
+	if(ss->part_num == ss->etag_cap)
+	{
+		void* etags = realloc(ss->etags,(ss->etag_cap + UPLOAD_ETAG_STEP) * UPLOAD_ETAG_LEN);
+		if(NULL == etags)
+		{
+			ERROR_LOG("realloc failed!\n");
+			return -1;
+		}
+		ss->etags = etags;
+		ss->etag_cap += UPLOAD_ETAG_STEP;
+	}
+
+	snprintf(query,sizeof(query),"?partNumber=%d&uploadId=%s",part_no,ss->upload_id_enc);
+	for(retry = 0; retry <= UPLOAD_PART_RETRY; retry++)
+	{
+		int status;
+		if(retry > 0)
+			sleep(1 << (retry - 1));
+		reset(arg);
+		status = upload_request(ss,"PUT",query,rd,arg,len);
+		if(200 == status && 0 == parse_etag(ss->resp_head,ss->etags[ss->part_num],UPLOAD_ETAG_LEN))
+		{
+			ss->part_num ++;
+			return 0;
+		}
+		ERROR_LOG("upload part %d failed(%d), retry %d\n",part_no,status,retry);
+	}
+	return -1;
+}
+
+/*完成 multipart 上传（提交所有分片的 ETag 列表）*/
+static int upload_complete(upload_session_t* ss)
+{
+	char query[UPLOAD_ID_LEN*3 + 16];
+	char hash[AWS_SHA256_HEX_LEN];
+	int size = ss->part_num * (UPLOAD_ETAG_LEN + 64) + 64;
+	char* xml = (char*)malloc(size);
+	mem_reader_t rd;
+	int len = 0;
+	int status;
+	int i;
+
+	if(NULL == xml)
+	{
+		ERROR_LOG("malloc failed!\n");
+		return -1;
+	}
+	len += snprintf(xml + len,size - len,"<CompleteMultipartUpload>");
+	for(i = 0; i < ss->part_num; i++)
+		len += snprintf(xml + len,size - len,"<Part><PartNumber>%d</PartNumber><ETag>%s</ETag></Part>",i + 1,ss->etags[i]);
+	len += snprintf(xml + len,size - len,"</CompleteMultipartUpload>");
+
+	rd.buf = xml;
+	rd.len = len;
+	rd.pos = 0;
+	snprintf(query,sizeof(query),"?uploadId=%s",ss->upload_id_enc);
+	aws_sha256_hex(xml,len,hash); //body 很小，直接签名
+	ss->payload_hash = hash;
+	status = upload_request(ss,"POST",query,mem_body_read,&rd,len);
+	ss->payload_hash = NULL;
+	free(xml);
+	if(200 != status || strstr(ss->resp,"<Error>"))
+	{
+		ERROR_LOG("complete multipart upload failed(%d)!\n",status);
+		return -1;
+	}
+	return 0;
+}
+
+/*放弃 multipart 上传（让服务端释放已上传的分片）*/
+static void upload_abort(upload_session_t* ss)
+{
+	char query[UPLOAD_ID_LEN*3 + 16];
+	if('\0' == ss->upload_id[0])
+		return;
+	snprintf(query,sizeof(query),"?uploadId=%s",ss->upload_id_enc);
+	upload_request(ss,"DELETE",query,NULL,NULL,0);
+}
+
+static void mem_reader_reset(void* arg)
+{
+	((mem_reader_t*)arg)->pos = 0;
+}
+
+static void file_reader_reset(void* arg)
+{
+	((file_reader_t*)arg)->offset = ((file_reader_t*)arg)->start;
+}
+
+/*
+从管道读满一个分片（或读到结束），hash 不为 NULL 时边读边计算分片的 SHA256
+分片缓存按需扩容（<part><cap>输入/输出），小文件不需要占用整个 UPLOAD_PART_SIZE
+*/
+static int fill_part(upload_stream_t* s, char** part, int* cap, char* hash)
+{
+	aws_payload_hash_t ph;
+	int len = 0;
+
+	if(hash)
+		aws_payload_hash_init(&ph);
+	while(len < UPLOAD_PART_SIZE)
+	{
+		int n;
+		if(len == *cap)
+		{
+			int new_cap = (*cap * 2 > UPLOAD_PART_SIZE) ? UPLOAD_PART_SIZE : *cap * 2;
+			char* p = (char*)realloc(*part,new_cap);
+			if(NULL == p)
+			{
+				ERROR_LOG("realloc(%d) failed!\n",new_cap);
+				return -1;
+			}
+			*part = p;
+			*cap = new_cap;
+		}
+		n = upload_stream_read(s,*part + len,*cap - len);
+		if(n < 0)
+			return -1;
+		if(0 == n)
+			break;
+		if(hash) //数据刚写入缓存还在 cache 中，不需要为签名再遍历一遍分片
+			aws_payload_hash_update(&ph,*part + len,n);
+		len += n;
+	}
+	if(hash)
+		aws_payload_hash_final(&ph,hash);
+	return len;
+}
+
+/*管道模式：分片缓存 + 按分片上传*/
+static int upload_from_stream(upload_session_t* ss, upload_stream_t* s)
+{
+	int cap = UPLOAD_PART_INIT_SIZE;
+	char* part = (char*)malloc(cap);
+	char part_hash[AWS_SHA256_HEX_LEN];
+	char* hash = UPLOAD_SIGN_PAYLOAD ? part_hash : NULL;
+	mem_reader_t rd;
+	int len;
+	int ret = -1;
+
+	if(NULL == part)
+	{
+		ERROR_LOG("malloc failed!\n");
+		return -1;
+	}
+
+	len = fill_part(s,&part,&cap,hash);
+	if(len <= 0)
+	{
+		ERROR_LOG("upload stream aborted or empty!\n");
+		goto END;
+	}
+
+	rd.buf = part;
+	rd.pos = 0;
+	ss->payload_hash = hash;
+	if(len < UPLOAD_PART_SIZE) //整个文件不超过一个分片：直接 PUT
+	{
+		rd.len = len;
+		ret = upload_single(ss,mem_body_read,&rd,mem_reader_reset,len);
+		goto END;
+	}
+	ss->payload_hash = NULL; //UploadId 请求没有 body
+
+	if(upload_initiate(ss) < 0)
+		goto END;
+	while(len > 0)
+	{
+		rd.buf = part; //分片缓存扩容后地址可能变化
+		rd.pos = 0;
+		rd.len = len;
+		ss->payload_hash = hash;
+		ret = upload_part(ss,mem_body_read,&rd,mem_reader_reset,len);
+		ss->payload_hash = NULL;
+		if(ret < 0)
+			goto END;
+		ret = -1;
+		len = fill_part(s,&part,&cap,hash);
+		if(len < 0)
+		{
+			ERROR_LOG("upload stream aborted!\n");
+			goto END;
+		}
+	}
+	ret = upload_complete(ss);
+
+END:
+	ss->payload_hash = NULL;
+	if(ret < 0)
+		upload_abort(ss);
+	free(part);
+	return ret;
+}
+
+/*文件模式：直接从文件按分片读取，不需要分片缓存（重传时重新 seek）*/
+static int upload_from_file(upload_session_t* ss, const char* file_name)
+{
+	file_reader_t rd;
+	unsigned long file_len = get_file_size(file_name);
+	unsigned int offset = 0;
+	int ret = -1;
+
+	if((unsigned long)-1 == file_len || 0 == file_len)
+	{
+		ERROR_LOG("get_file_size(%s) failed!\n",file_name);
+		return -1;
+	}
+	rd.fd = open(file_name,O_RDONLY);
+	if(rd.fd < 0)
+	{
+		ERROR_LOG("open %s failed!\n",file_name);
+		return -1;
+	}
+
+	if(file_len <= UPLOAD_PART_SIZE)
+	{
+		rd.start = 0;
+		ret = upload_single(ss,file_body_read,&rd,file_reader_reset,file_len);
+		close(rd.fd);
+		return ret;
+	}
+
+	if(upload_initiate(ss) < 0)
+		goto END;
+	while(offset < file_len)
+	{
+		int len = (file_len - offset > UPLOAD_PART_SIZE) ? UPLOAD_PART_SIZE : (int)(file_len - offset);
+		rd.start = offset;
+		if(upload_part(ss,file_body_read,&rd,file_reader_reset,len) < 0)
+			goto END;
+		offset += len;
+	}
+	ret = upload_complete(ss);
+
+END:
+	if(ret < 0)
+		upload_abort(ss);
+	close(rd.fd);
+	return ret;
+}
+
+int amazon_stream_upload(put_file_info_t* info)
+{
+	upload_session_t* ss = NULL;
+	char sub_dir[16] = {0};
+	char path[256] = {0};
+	int ret = -1;
+
+	if(NULL == info || (1 != info->mode && 3 != info->mode) || (3 == info->mode && NULL == info->stream))
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		goto END;
+	}
+
+	ss = (upload_session_t*)calloc(1,sizeof(upload_session_t));
+	if(NULL == ss)
+	{
+		ERROR_LOG("calloc failed!\n");
+		goto END;
+	}
+	ss->headers = (char*)malloc(UPLOAD_HEADERS_SIZE);
+	if(NULL == ss->headers)
+	{
+		ERROR_LOG("malloc failed!\n");
+		goto END;
+	}
+
+	amazon_get_dir_and_type(info->ts_flag,info->file_type,sub_dir,ss->filetype);
+	amazon_info_complet(path,ss->url,sub_dir,info->file_name);
+	DEBUG_LOG("stream upload %s --> %s\n",info->file_name,ss->url);
+
+	if(3 == info->mode)
+	{
+		ret = upload_from_stream(ss,info->stream);
+		if(0 == ret)
+		{
+			pthread_mutex_lock(&info->stream->mut);
+			if(info->stream->info_set)
+			{
+				info->ts_flag = info->stream->ts_flag;
+				info->file_tlen = info->stream->file_tlen;
+			}
+			pthread_mutex_unlock(&info->stream->mut);
+		}
+	}
+	else
+		ret = upload_from_file(ss,info->file_name);
+	DEBUG_LOG("stream upload %s %s, parts(%d)\n",info->file_name,ret < 0 ? "failed" : "success",ss->part_num);
+
+END:
+	if(info && 3 == info->mode && info->stream)
+	{
+		upload_stream_release(info->stream);
+		info->stream = NULL;
+	}
+	if(ss)
+	{
+		if(ss->headers) free(ss->headers);
+		if(ss->etags) free(ss->etags);
+		free(ss);
+	}
+	return ret;
+}
+
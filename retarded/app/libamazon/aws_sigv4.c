@@ -0,0 +1,332 @@
+/************************************************************************
+    > File Name: aws_sigv4.c
+    > Author:
+    > Mail:
+    > Blog:
+    > Created Time: 10,19,2026
+    > Brief: AWS Signature Version 4 签名
+    		 1.签名密钥按 日期/区域/服务 缓存, 一天只派生一次(4 次 HMAC), 每次签名只剩 1 次 HMAC。
+    		 2.规范请求(CanonicalRequest)边生成边送入 SHA256, 不需要拼接缓存。
+    		 3.body 哈希支持增量计算, 也可以用 UNSIGNED-PAYLOAD(https 下允许)完全省掉。
+ ***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+#include "aws_sigv4.h"
+
+#define AWS_SIGV4_MAX_HEADERS	16		// 参与签名的请求头最大个数
+#define AWS_SIGV4_MAX_PARAMS	16		// query 参数最大个数
+#define AWS_SIGV4_NAME_LEN		64		// 请求头名字最大长度
+#define AWS_SIGV4_VALUE_LEN		256		// 请求头值最大长度(规范化之后)
+
+/*
+ * 签名密钥缓存(设备只对接一个区域, 缓存一组即可)
+ */
+typedef struct _aws_key_cache_t
+{
+	int 			valid;
+	char 			date[12];
+	char 			region[32];
+	char 			service[16];
+	char 			secret[64];
+	unsigned char	key[32];
+}aws_key_cache_t;
+
+static pthread_mutex_t	key_cache_mut = PTHREAD_MUTEX_INITIALIZER;
+static aws_key_cache_t	key_cache;
+static unsigned int		key_derive_count = 0;
+
+static void to_hex(const unsigned char *in, int len, char *out)
+{
+	static const char digits[] = "0123456789abcdef";
+	int i;
+	for(i = 0; i < len; i++)
+	{
+		out[i * 2] = digits[in[i] >> 4];
+		out[i * 2 + 1] = digits[in[i] & 0x0f];
+	}
+	out[len * 2] = '\0';
+}
+
+static void hmac_sha256(const unsigned char *key, int key_len, const void *data, int len, unsigned char out[32])
+{
+	unsigned int out_len = 32;
+	HMAC(EVP_sha256(), key, key_len, (const unsigned char*)data, len, out, &out_len);
+}
+
+static void sha_str(SHA256_CTX *ctx, const char *s)
+{
+	SHA256_Update(ctx, s, strlen(s));
+}
+
+void aws_payload_hash_init(aws_payload_hash_t *h)
+{
+	SHA256_Init(&h->ctx);
+}
+
+void aws_payload_hash_update(aws_payload_hash_t *h, const void *data, int len)
+{
+	if(len > 0)
+		SHA256_Update(&h->ctx, data, len);
+}
+
+void aws_payload_hash_final(aws_payload_hash_t *h, char hex[AWS_SHA256_HEX_LEN])
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	SHA256_Final(md, &h->ctx);
+	to_hex(md, SHA256_DIGEST_LENGTH, hex);
+}
+
+void aws_sha256_hex(const void *data, int len, char hex[AWS_SHA256_HEX_LEN])
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	SHA256((const unsigned char*)data, len, md);
+	to_hex(md, SHA256_DIGEST_LENGTH, hex);
+}
+
+int aws_uri_encode(const char *in, char *out, int size, int keep_slash)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	int len = 0;
+
+	for(; *in; in++)
+	{
+		unsigned char ch = (unsigned char)*in;
+		if(isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~' || (keep_slash && ch == '/'))
+		{
+			if(len + 1 >= size)
+				return -1;
+			out[len++] = ch;
+		}
+		else
+		{
+			if(len + 3 >= size)
+				return -1;
+			out[len++] = '%';
+			out[len++] = digits[ch >> 4];
+			out[len++] = digits[ch & 0x0f];
+		}
+	}
+	out[len] = '\0';
+	return len;
+}
+
+int aws_sigv4_signing_key(const char *secret, const char *date, const char *region, const char *service, unsigned char key[32])
+{
+	char k_secret[80];
+	unsigned char k1[32];
+	unsigned char k2[32];
+	int len;
+
+	if(NULL == secret || NULL == date || NULL == region || NULL == service || NULL == key)
+		return -1;
+
+	pthread_mutex_lock(&key_cache_mut);
+	if(key_cache.valid && 0 == strcmp(key_cache.date, date) && 0 == strcmp(key_cache.region, region) &&
+		0 == strcmp(key_cache.service, service) && 0 == strcmp(key_cache.secret, secret))
+	{
+		memcpy(key, key_cache.key, 32);
+		pthread_mutex_unlock(&key_cache_mut);
+		return 0;
+	}
+	pthread_mutex_unlock(&key_cache_mut);
+
+	len = snprintf(k_secret, sizeof(k_secret), "AWS4%s", secret);
+	if(len < 0 || len >= (int)sizeof(k_secret))
+		return -1;
+	hmac_sha256((unsigned char*)k_secret, len, date, strlen(date), k1);
+	hmac_sha256(k1, 32, region, strlen(region), k2);
+	hmac_sha256(k2, 32, service, strlen(service), k1);
+	hmac_sha256(k1, 32, "aws4_request", strlen("aws4_request"), key);
+	memset(k_secret, 0, sizeof(k_secret));
+
+	pthread_mutex_lock(&key_cache_mut);
+	if(strlen(date) < sizeof(key_cache.date) && strlen(region) < sizeof(key_cache.region) &&
+		strlen(service) < sizeof(key_cache.service) && strlen(secret) < sizeof(key_cache.secret))
+	{
+		strcpy(key_cache.date, date);
+		strcpy(key_cache.region, region);
+		strcpy(key_cache.service, service);
+		strcpy(key_cache.secret, secret);
+		memcpy(key_cache.key, key, 32);
+		key_cache.valid = 1;
+	}
+	key_derive_count ++;
+	pthread_mutex_unlock(&key_cache_mut);
+	return 0;
+}
+
+unsigned int aws_sigv4_key_derive_count(void)
+{
+	return key_derive_count;
+}
+
+/*
+ * @Name 			- 请求头值规范化: 去掉首尾空白, 连续空白压缩成一个空格
+ */
+static void trim_value(const char *in, char *out, int size)
+{
+	int len = 0;
+	int space = 0;
+
+	while(*in == ' ' || *in == '\t')
+		in++;
+	for(; *in && len < size - 1; in++)
+	{
+		if(*in == ' ' || *in == '\t')
+		{
+			space = 1;
+			continue;
+		}
+		if(space && len < size - 2)
+			out[len++] = ' ';
+		space = 0;
+		out[len++] = *in;
+	}
+	out[len] = '\0';
+}
+
+/*
+ * @Name 			- 规范化的 query: 参数按名字(再按值)排序, 没有值的参数写成 "name="
+ */
+static int canonical_query(SHA256_CTX *ctx, const char *query)
+{
+	char buf[1024];
+	char *param[AWS_SIGV4_MAX_PARAMS];
+	int num = 0;
+	int i, j;
+	char *p;
+
+	if(NULL == query || '\0' == query[0])
+		return 0;
+	if(strlen(query) >= sizeof(buf))
+		return -1;
+	strcpy(buf, query);
+
+	for(p = strtok(buf, "&"); p; p = strtok(NULL, "&"))
+	{
+		if(num >= AWS_SIGV4_MAX_PARAMS)
+			return -1;
+		param[num++] = p;
+	}
+
+	// 插入排序(参数个数很少), 按 '=' 之前的名字比较, 名字相同再比较值
+	for(i = 1; i < num; i++)
+	{
+		char *cur = param[i];
+		for(j = i; j > 0; j--)
+		{
+			char *a = param[j - 1];
+			int la = strcspn(a, "=");
+			int lb = strcspn(cur, "=");
+			int cmp = strncmp(a, cur, la < lb ? la : lb);
+			if(0 == cmp)
+				cmp = (la != lb) ? la - lb : strcmp(a, cur);
+			if(cmp <= 0)
+				break;
+			param[j] = param[j - 1];
+		}
+		param[j] = cur;
+	}
+
+	for(i = 0; i < num; i++)
+	{
+		if(i > 0)
+			sha_str(ctx, "&");
+		sha_str(ctx, param[i]);
+		if(NULL == strchr(param[i], '='))
+			sha_str(ctx, "=");
+	}
+	return 0;
+}
+
+int aws_sigv4_sign(const aws_sigv4_req_t *req, char *auth, int size)
+{
+	char name[AWS_SIGV4_MAX_HEADERS][AWS_SIGV4_NAME_LEN];
+	int order[AWS_SIGV4_MAX_HEADERS];
+	char signed_headers[AWS_SIGV4_MAX_HEADERS * AWS_SIGV4_NAME_LEN];
+	char date[9];
+	char scope[128];
+	char creq_hex[AWS_SHA256_HEX_LEN];
+	char string_to_sign[256];
+	char sig_hex[AWS_SHA256_HEX_LEN];
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	unsigned char key[32];
+	SHA256_CTX ctx;
+	int i, j, len;
+
+	if(NULL == req || NULL == req->method || NULL == req->uri || NULL == req->payload_hash || NULL == req->amz_date ||
+		NULL == req->region || NULL == req->service || NULL == req->access_key || NULL == req->secret_key ||
+		req->header_num <= 0 || req->header_num > AWS_SIGV4_MAX_HEADERS || strlen(req->amz_date) < 8 || NULL == auth)
+	{
+		return -1;
+	}
+
+	/*---1、请求头名字转小写并排序----------------------------------------*/
+	for(i = 0; i < req->header_num; i++)
+	{
+		const char *n = req->headers[i].name;
+		for(j = 0; n[j] && j < AWS_SIGV4_NAME_LEN - 1; j++)
+			name[i][j] = tolower((unsigned char)n[j]);
+		name[i][j] = '\0';
+		for(j = i; j > 0 && strcmp(name[order[j - 1]], name[i]) > 0; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+	signed_headers[0] = '\0';
+	for(i = 0, len = 0; i < req->header_num; i++)
+		len += snprintf(signed_headers + len, sizeof(signed_headers) - len, "%s%s", i ? ";" : "", name[order[i]]);
+
+	/*---2、规范请求(CanonicalRequest)直接送入 SHA256----------------------*/
+	SHA256_Init(&ctx);
+	sha_str(&ctx, req->method);
+	sha_str(&ctx, "\n");
+	sha_str(&ctx, req->uri[0] ? req->uri : "/");
+	sha_str(&ctx, "\n");
+	if(canonical_query(&ctx, req->query) < 0)
+		return -1;
+	sha_str(&ctx, "\n");
+	for(i = 0; i < req->header_num; i++)
+	{
+		char value[AWS_SIGV4_VALUE_LEN];
+		trim_value(req->headers[order[i]].value ? req->headers[order[i]].value : "", value, sizeof(value));
+		sha_str(&ctx, name[order[i]]);
+		sha_str(&ctx, ":");
+		sha_str(&ctx, value);
+		sha_str(&ctx, "\n");
+	}
+	sha_str(&ctx, "\n");
+	sha_str(&ctx, signed_headers);
+	sha_str(&ctx, "\n");
+	sha_str(&ctx, req->payload_hash);
+	SHA256_Final(md, &ctx);
+	to_hex(md, SHA256_DIGEST_LENGTH, creq_hex);
+
+	/*---3、待签名字符串(StringToSign)-----------------------------------------*/
+	memcpy(date, req->amz_date, 8);
+	date[8] = '\0';
+	snprintf(scope, sizeof(scope), "%s/%s/%s/aws4_request", date, req->region, req->service);
+	len = snprintf(string_to_sign, sizeof(string_to_sign), "AWS4-HMAC-SHA256\n%s\n%s\n%s", req->amz_date, scope, creq_hex);
+	if(len < 0 || len >= (int)sizeof(string_to_sign))
+		return -1;
+
+	/*---4、签名(签名密钥按天缓存)---------------------------------------------*/
+	if(aws_sigv4_signing_key(req->secret_key, date, req->region, req->service, key) < 0)
+		return -1;
+	hmac_sha256(key, 32, string_to_sign, len, md);
+	to_hex(md, SHA256_DIGEST_LENGTH, sig_hex);
+
+	len = snprintf(auth, size, "AWS4-HMAC-SHA256 Credential=%s/%s, SignedHeaders=%s, Signature=%s",
+					req->access_key, scope, signed_headers, sig_hex);
+	if(len < 0 || len >= size)
+		return -1;
+	return 0;
+}
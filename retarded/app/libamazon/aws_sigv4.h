@@ -0,0 +1,88 @@
+/************************************************************************
+    > File Name: aws_sigv4.h
+    > Author:
+    > Mail:
+    > Blog:
+    > Created Time: 10,19,2026
+ ***********************************************************************/
+
+#ifndef __AWS_SIGV4__
+#define __AWS_SIGV4__
+
+#include <openssl/sha.h>
+
+#define AWS_SHA256_HEX_LEN		65				// 64 个十六进制字符 + '\0'
+#define AWS_UNSIGNED_PAYLOAD	"UNSIGNED-PAYLOAD"	// 不对 body 做哈希(只能用于 https)
+
+/*
+ * 参与签名的请求头
+ */
+typedef struct _aws_header_t
+{
+	const char*	name;		// 大小写不限, 签名时统一转小写
+	const char*	value;
+}aws_header_t;
+
+/*
+ * 一次请求的签名参数
+ */
+typedef struct _aws_sigv4_req_t
+{
+	const char*			method;			// PUT/POST/GET/DELETE
+	const char*			uri;			// url 的路径部分(已经过 URI 编码), 如 "/bucket/dev/a.ts"
+	const char*			query;			// url 的 query 部分(不含'?', 值已经过 URI 编码), 可为 NULL
+	const aws_header_t*	headers;		// 参与签名的请求头(需包含 host 和 x-amz-date)
+	int 				header_num;
+	const char*			payload_hash;	// body 的 SHA256(十六进制) 或 AWS_UNSIGNED_PAYLOAD
+	const char*			amz_date;		// x-amz-date, 如 "20150830T123600Z"
+	const char*			region;
+	const char*			service;		// "s3"
+	const char*			access_key;
+	const char*			secret_key;
+}aws_sigv4_req_t;
+
+/*
+ * body 的增量哈希: 数据到达一块算一块, 不需要对整个文件再读一遍
+ */
+typedef struct _aws_payload_hash_t
+{
+	SHA256_CTX	ctx;
+}aws_payload_hash_t;
+
+void aws_payload_hash_init(aws_payload_hash_t *h);
+void aws_payload_hash_update(aws_payload_hash_t *h, const void *data, int len);
+void aws_payload_hash_final(aws_payload_hash_t *h, char hex[AWS_SHA256_HEX_LEN]);
+
+/*
+ * @Name 			- 一次性计算 SHA256, 输出十六进制字符串
+ */
+void aws_sha256_hex(const void *data, int len, char hex[AWS_SHA256_HEX_LEN]);
+
+/*
+ * @Name 			- 按 AWS 规则做 URI 编码(A-Z a-z 0-9 - _ . ~ 之外的字符编码为 %XX)
+ * @Parame 	keep_slash - 1: '/' 不编码(用于路径)
+ * @return 			- 编码后的长度, 缓存不够返回 -1
+ */
+int aws_uri_encode(const char *in, char *out, int size, int keep_slash);
+
+/*
+ * @Name 			- 派生签名密钥 kSigning = HMAC(HMAC(HMAC(HMAC("AWS4"+secret, date), region), service), "aws4_request")
+ * 					  同一天/区域/服务/私钥的密钥只计算一次(缓存), 之后每次签名只需要一次 HMAC
+ * @Parame 	*date 	- "YYYYMMDD"
+ * @return 			- 成功返回 0, 失败返回 -1
+ */
+int aws_sigv4_signing_key(const char *secret, const char *date, const char *region, const char *service, unsigned char key[32]);
+
+/*
+ * @Name 			- 计算 SigV4 签名, 输出 Authorization 头的值
+ * 					  "AWS4-HMAC-SHA256 Credential=..., SignedHeaders=..., Signature=..."
+ * @return 			- 成功返回 0, 失败(参数错误/缓存太小)返回 -1
+ */
+int aws_sigv4_sign(const aws_sigv4_req_t *req, char *auth, int size);
+
+/*
+ * @Name 			- 签名密钥实际派生的次数(缓存命中时不增加), 调试用
+ */
+unsigned int aws_sigv4_key_derive_count(void);
+
+#endif
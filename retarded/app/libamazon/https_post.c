@@ -1,9 +1,9 @@
 /************************************************************************
-    > File Name: https_post.c 
+    > File Name: https_post.c
     > Author:
-    > Mail: 
-    > Blog: 
-    > Created Time: 
+    > Mail:
+    > Blog:
+    > Created Time:
  ***********************************************************************/
 
 #include <fcntl.h>
@@ -13,8 +13,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/tcp.h>
 #include "in.h"
 #include "my_inet.h"
 
@@ -23,10 +28,18 @@
 #include <openssl/rand.h>
 #include <openssl/crypto.h>
 
-//#include "https_post.h"
+#include "https_post.h"
+#include "json_stream.h"
+#include "metrics.h"
 
 
-#define HTTP_HEADERS_MAXLEN 	512 	// Headers 的最大长度
+#define HTTP_HEADERS_MAXLEN 		512 	// Headers 的最大长度
+#define HTTPS_POOL_SIZE				4		// keep-alive 连接池大小（所有主机共用）
+#define HTTPS_SESSION_CACHE_SIZE	4		// TLS 会话缓存（按 host:port，用于会话恢复）
+#define HTTPS_KEEPALIVE_IDLE		30		// 空闲连接最长保留时间（秒），超过则关闭
+#define HTTPS_IO_TIMEOUT			20		// socket 收发超时（秒）
+#define HTTPS_RBUF_SIZE				2048	// 每个连接的接收缓存
+#define HTTPS_WBUF_SIZE				2048	// 每个连接的发送缓存(小请求的头和 body 合并成一个 TLS 记录发出, 避免 Nagle 延时)
 
 /*
  * Headers 按需更改
@@ -36,6 +49,107 @@ const char *HttpsPostHeaders = 	"User-Agent: Mozilla/4.0 (compatible; MSIE 5.01;
 								"Accept: */*\r\n"
 								"Content-type: application/json\r\n";
 
+/*
+ * 一条 TLS 连接（可在多次请求之间复用）
+ */
+typedef struct _https_conn_t
+{
+	char 		host[128];
+	int 		port;
+	int 		sockfd;
+	SSL*		ssl;
+	int 		busy;					// 1: 正在被某个请求使用
+	int			reused;					// 1: 本次请求使用的是池中已有的连接
+	time_t 		last_used;
+	char 		rbuf[HTTPS_RBUF_SIZE];	// 接收缓存（响应头按行解析）
+	int 		rpos;
+	int 		rlen;
+	char 		wbuf[HTTPS_WBUF_SIZE];	// 发送缓存
+	int 		wlen;
+}https_conn_t;
+
+/*
+ * TLS 会话缓存（新建连接时用于会话恢复，省掉完整握手）
+ */
+typedef struct _https_session_t
+{
+	char 			host[128];
+	int 			port;
+	SSL_SESSION*	session;
+}https_session_t;
+
+static pthread_once_t 	ssl_once = PTHREAD_ONCE_INIT;
+static SSL_CTX*			g_ssl_ctx = NULL;			// 进程内共用的 SSL_CTX
+static pthread_mutex_t*	ssl_locks = NULL;			// openssl 1.0.x 多线程需要的锁
+static pthread_mutex_t	pool_mut = PTHREAD_MUTEX_INITIALIZER;
+static https_conn_t		conn_pool[HTTPS_POOL_SIZE];
+static https_session_t	session_cache[HTTPS_SESSION_CACHE_SIZE];
+static int				session_next = 0;			// 会话缓存满时轮流替换
+static https_stat_t		https_stat;				// 多个线程同时更新，用原子加
+
+static void ssl_locking_cb(int mode, int n, const char *file, int line)
+{
+	if(mode & CRYPTO_LOCK)
+		pthread_mutex_lock(&ssl_locks[n]);
+	else
+		pthread_mutex_unlock(&ssl_locks[n]);
+}
+
+static unsigned long ssl_thread_id_cb(void)
+{
+	return (unsigned long)pthread_self();
+}
+
+/*
+ * @Name 		- 	metrics 采集回调：连接复用统计
+ */
+static void https_collect(struct _json_writer_t *w)
+{
+	json_write_int(w, "handshakes", __atomic_load_n(&https_stat.handshakes, __ATOMIC_RELAXED));
+	json_write_int(w, "resumed", __atomic_load_n(&https_stat.resumed, __ATOMIC_RELAXED));
+	json_write_int(w, "reused", __atomic_load_n(&https_stat.reused, __ATOMIC_RELAXED));
+}
+
+/*
+ * @Name 		- 	openssl 全局初始化（只执行一次）
+ * 					库初始化 + 多线程锁 + 随机数种子 + 共用的 SSL_CTX
+ */
+static void ssl_global_init(void)
+{
+	int i;
+
+	SSL_library_init();
+	SSL_load_error_strings();
+
+	ssl_locks = (pthread_mutex_t*)malloc(CRYPTO_num_locks() * sizeof(pthread_mutex_t));
+	if(ssl_locks)
+	{
+		for(i = 0; i < CRYPTO_num_locks(); i++)
+			pthread_mutex_init(&ssl_locks[i], NULL);
+		CRYPTO_set_id_callback(ssl_thread_id_cb);
+		CRYPTO_set_locking_callback(ssl_locking_cb);
+	}
+
+    /*
+     * 经查阅, WIN32的系统下, 不能很有效的产生随机数, 此处增加随机数种子
+     */
+	RAND_poll();
+	while (RAND_status() == 0)
+	{
+		unsigned short rand_ret = rand() % 65536;
+		RAND_seed(&rand_ret, sizeof(rand_ret));
+	}
+
+	g_ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+	if(g_ssl_ctx)
+	{
+		SSL_CTX_set_options(g_ssl_ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+		SSL_CTX_set_session_cache_mode(g_ssl_ctx, SSL_SESS_CACHE_CLIENT);
+	}
+
+	metrics_register_collector("https", https_collect);
+}
+
 /*
  * @Name 			- 创建TCP连接, 并建立到连接
  * @Parame *server 	- 字符串, 要连接的服务器地址, 可以为域名, 也可以为IP地址
@@ -48,6 +162,8 @@ int client_connect_tcp(char *server,int port)
 	int sockfd;
 	struct hostent *host;
 	struct sockaddr_in cliaddr;
+	struct timeval tv = {HTTPS_IO_TIMEOUT, 0};
+	int nodelay = 1;
 
 	sockfd=socket(AF_INET,SOCK_STREAM,0);
 	if(sockfd < 0){
@@ -57,6 +173,7 @@ int client_connect_tcp(char *server,int port)
 
 	if(!(host=gethostbyname(server))){
 		printf("gethostbyname(%s) error!\n", server);
+		close(sockfd);
 		return -2;
 	}
 
@@ -68,190 +185,565 @@ int client_connect_tcp(char *server,int port)
 
 	if(connect(sockfd,(struct sockaddr *)&cliaddr,sizeof(struct sockaddr))<0){
 		perror("[-] error");
+		close(sockfd);
 		return -3;
 	}
 
+	// 连接复用后服务端随时可能断开, 收发都需要超时, 避免线程永久阻塞
+	setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	// 会话恢复时客户端的 Finished 后紧跟请求数据, 开启 Nagle 会被对端的延时 ACK 卡住约 40ms
+	// (小请求已由发送缓存合并成一个记录, 关闭 Nagle 不会产生额外的小包)
+	setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
 	return(sockfd);
 }
 
+
 /*
- * @Name 			- 封装post数据包括headers
- * @parame *host 	- 主机地址, 域名
- * @parame  port 	- 端口号
- * @parame 	page 	- url相对路径
- * @parame 	len 	- 数据内容的长度
- * @parame 	content - 数据内容
- * @parame 	data 	- 得到封装的数据结果
+ * @Name 		- 	创建SSL, 并且绑定sockfd到SSL
+ * 					此作用主要目的是通过SSL来操作sock
  *
- * @return 	int 	- 返回封装得到的数据长度
+ * @return 		- 	返回已完成初始化并绑定对应sockfd的SSL指针
+ * @attention 	- 	SSL_CTX 为进程内共用, 使用完成后只需 SSL_free
  */
-int post_pack(const char* headers,const char *host, int port, const char *page, int len, const char *content, char *data)
+SSL *ssl_init(int sockfd)
 {
-	int re_len;
-	
-	if(NULL == headers)//无 header ，按照默认的来
-		re_len = strlen(page) + strlen(host) + len + HTTP_HEADERS_MAXLEN;
-	else
-		re_len =  strlen(headers) + len + HTTP_HEADERS_MAXLEN;
-	
-	char *post = NULL;
-	post = malloc(re_len);
-	if(post == NULL)
+	SSL *ssl;
+
+	pthread_once(&ssl_once, ssl_global_init);
+	if (g_ssl_ctx == NULL){
+		return NULL;
+	}
+
+	ssl = SSL_new(g_ssl_ctx);
+	if (ssl == NULL){
+		return NULL;
+	}
+
+	/* 把socket和SSL关联 */
+	if (SSL_set_fd(ssl, sockfd) == 0){
+		SSL_free(ssl);
+		return NULL;
+	}
+
+	return ssl;
+}
+
+/*
+ * @Name 			- 查找/保存 host:port 对应的 TLS 会话 (调用者需持有 pool_mut)
+ */
+static https_session_t* session_find(const char *host, int port)
+{
+	int i;
+	for(i = 0; i < HTTPS_SESSION_CACHE_SIZE; i++)
 	{
-		printf("malloc failed !\n");
-		return -1;
+		if(session_cache[i].session && session_cache[i].port == port && 0 == strcmp(session_cache[i].host, host))
+			return &session_cache[i];
 	}
-	memset(post,0,re_len);
-	if(NULL == headers)
+	return NULL;
+}
+
+static void session_save(const char *host, int port, SSL *ssl)
+{
+	https_session_t *s;
+	SSL_SESSION *session = SSL_get1_session(ssl);
+	if(NULL == session)
+		return;
+
+	pthread_mutex_lock(&pool_mut);
+	s = session_find(host, port);
+	if(NULL == s)
 	{
-		snprintf(post,re_len, "POST %s HTTP/1.0\r\n", page);
-		snprintf(post,re_len, "%sHost: %s:%d\r\n",post, host, port);
-		//sprintf(post, "%s%s", post, headers);无该部分
-		snprintf(post,re_len,"%sContent-Length: %d\r\n\r\n", post, len);
-		int str_len = strlen(post);
-		memcpy(post + str_len,content,len);
-		//sprintf(post, "%s%s", post, content);该方式只能拷贝字符串，如果是非字符串数据会出问题 		
+		s = &session_cache[session_next];
+		session_next = (session_next + 1) % HTTPS_SESSION_CACHE_SIZE;
 	}
-	else //外部有传入的 headers
+	if(s->session)
+		SSL_SESSION_free(s->session);
+	snprintf(s->host, sizeof(s->host), "%s", host);
+	s->port = port;
+	s->session = session;
+	pthread_mutex_unlock(&pool_mut);
+}
+
+/*
+ * @Name 			- 关闭一条连接并清空池中的槽位
+ * @Parame 	keep 	- 1: 槽位继续由调用者占用(busy) ; 0: 释放槽位
+ */
+static void conn_reset(https_conn_t *c, int keep)
+{
+	if(c->ssl)
 	{
-		//sprintf(post, "POST %s HTTP/1.0\r\n", page);无该部分
-		//sprintf(post, "%sHost: %s:%d\r\n",post, host, port);无该部分
-		snprintf(post,re_len, "%s%s", post, headers);
-		//sprintf(post, "%sContent-Length: %d\r\n\r\n", post, len);无该部分
-		int str_len = strlen(post);
-		memcpy(post + str_len,content,len);
-		//sprintf(post, "%s%s", post, content); //该方式错误，当业务需要上传非字符串数据的时候, 会造成数据传输丢失或失败
+		SSL_shutdown(c->ssl);
+		SSL_free(c->ssl);
 	}
-	
+	if(c->sockfd > 0)
+		close(c->sockfd);
+
+	pthread_mutex_lock(&pool_mut);
+	memset(c, 0, sizeof(https_conn_t));
+	c->sockfd = -1;
+	c->busy = keep;
+	pthread_mutex_unlock(&pool_mut);
+}
 
-	re_len = strlen(post);
-	memset(data, 0, re_len+1);
-	memcpy(data, post, re_len);
+#define conn_close(c) 	conn_reset(c, 0)
 
-	free(post);
-	return re_len;
-}
+/*
+ * @Name 			- 空闲连接是否仍然可用
+ * 					  空闲时 socket 可读说明服务端已关闭(或发来了 close_notify), 不能再复用
+ */
+static int conn_is_alive(https_conn_t *c)
+{
+	fd_set rset;
+	struct timeval tv = {0, 0};
 
+	if(time(NULL) - c->last_used > HTTPS_KEEPALIVE_IDLE)
+		return 0;
+
+	FD_ZERO(&rset);
+	FD_SET(c->sockfd, &rset);
+	return (0 == select(c->sockfd + 1, &rset, NULL, NULL, &tv));
+}
 
 /*
- * @Name 		- 	初始化SSL, 并且绑定sockfd到SSL
- * 					此作用主要目的是通过SSL来操作sock
- * 					
- * @return 		- 	返回已完成初始化并绑定对应sockfd的SSL指针
+ * @Name 			- 从连接池取出一条到 host:port 的连接, 没有可复用的则新建(优先恢复 TLS 会话)
+ * @return 			- 连接指针, 失败返回 NULL (err 返回错误码 -2/-3)
  */
-SSL *ssl_init(int sockfd)
+static https_conn_t* conn_get(char *host, int port, int *err)
 {
-	int re = 0;
-	SSL *ssl;
-	SSL_CTX *ctx;
+	https_conn_t *c = NULL;
+	https_session_t *s;
+	int sockfd;
+	int i;
 
-	SSL_library_init();
-	SSL_load_error_strings();
-	ctx = SSL_CTX_new(SSLv23_client_method());
-	if (ctx == NULL){
-		return NULL;
+	pthread_once(&ssl_once, ssl_global_init);
+
+	// 1、复用空闲的 keep-alive 连接
+	for(;;)
+	{
+		https_conn_t *idle = NULL;
+		pthread_mutex_lock(&pool_mut);
+		for(i = 0; i < HTTPS_POOL_SIZE; i++)
+		{
+			if(conn_pool[i].ssl && !conn_pool[i].busy && conn_pool[i].port == port && 0 == strcmp(conn_pool[i].host, host))
+			{
+				idle = &conn_pool[i];
+				idle->busy = 1;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&pool_mut);
+		if(NULL == idle)
+			break;
+		if(conn_is_alive(idle))
+		{
+			idle->reused = 1;
+			__atomic_fetch_add(&https_stat.reused, 1, __ATOMIC_RELAXED);
+			return idle;
+		}
+		conn_close(idle);
 	}
 
-	ssl = SSL_new(ctx);
-	if (ssl == NULL){
+	// 2、新建连接: 占用一个空槽位, 池满则关闭最久未使用的空闲连接
+	pthread_mutex_lock(&pool_mut);
+	for(i = 0; i < HTTPS_POOL_SIZE; i++)
+	{
+		if(NULL == conn_pool[i].ssl && !conn_pool[i].busy)
+		{
+			c = &conn_pool[i];
+			break;
+		}
+		if(!conn_pool[i].busy && (NULL == c || conn_pool[i].last_used < c->last_used))
+			c = &conn_pool[i];
+	}
+	if(c)
+		c->busy = 1;
+	pthread_mutex_unlock(&pool_mut);
+	if(NULL == c)
+	{
+		*err = -2;		// 所有连接都在使用中
 		return NULL;
 	}
+	if(c->ssl)
+		conn_reset(c, 1);
 
-	/* 把socket和SSL关联 */
-	re = SSL_set_fd(ssl, sockfd);
-	if (re == 0){
-		SSL_free(ssl);
+	sockfd = client_connect_tcp(host, port);
+	if(sockfd < 0)
+	{
+		conn_close(c);
+		*err = -2;
+		return NULL;
+	}
+	c->sockfd = sockfd;
+	c->ssl = ssl_init(sockfd);
+	if(NULL == c->ssl)
+	{
+		conn_close(c);
+		*err = -3;
 		return NULL;
 	}
 
-    /*
-     * 经查阅, WIN32的系统下, 不能很有效的产生随机数, 此处增加随机数种子
-     */
-	RAND_poll();
-	while (RAND_status() == 0)
+	// 3、有缓存的会话则尝试恢复(服务端不接受时自动退回完整握手)
+	pthread_mutex_lock(&pool_mut);
+	s = session_find(host, port);
+	if(s)
+		SSL_set_session(c->ssl, s->session);
+	pthread_mutex_unlock(&pool_mut);
+
+	if(SSL_connect(c->ssl) != 1)
 	{
-		unsigned short rand_ret = rand() % 65536;
-		RAND_seed(&rand_ret, sizeof(rand_ret));
+		conn_close(c);
+		*err = -3;
+		return NULL;
 	}
-	
-	/*
-     * ctx使用完成, 进行释放
-     */
-	SSL_CTX_free(ctx);
-	
-	return ssl;
+	__atomic_fetch_add(&https_stat.handshakes, 1, __ATOMIC_RELAXED);
+	if(SSL_session_reused(c->ssl))
+		__atomic_fetch_add(&https_stat.resumed, 1, __ATOMIC_RELAXED);
+	else
+		session_save(host, port, c->ssl);
+
+	snprintf(c->host, sizeof(c->host), "%s", host);
+	c->port = port;
+	c->reused = 0;
+	c->rpos = c->rlen = 0;
+	c->wlen = 0;
+	return c;
 }
 
 /*
- * @Name 			- 通过SSL建立连接并发送数据
- * @Parame 	*ssl 	- SSL指针, 已经完成初始化并绑定了对应sock句柄的SSL指针
- * @Parame 	*data 	- 准备发送数据的指针地址
- * @Parame 	 size 	- 准备发送的数据长度
- *
- * @return 			- 返回发送完成的数据长度, 如果发送失败, 返回 -1
+ * @Name 			- 归还连接: 服务端允许 keep-alive 则放回池中, 否则关闭
  */
-int ssl_send(SSL *ssl, const char *data, int size)
+static void conn_put(https_conn_t *c, int keep_alive)
 {
-	int re = 0;
-	int count = 0;
-
-	re = SSL_connect(ssl);
-
-	if(re != 1){
-		return -1;
+	if(!keep_alive || c->rpos != c->rlen)	// 还有未读的数据说明响应没解析完整, 不能复用
+	{
+		conn_close(c);
+		return;
 	}
+	pthread_mutex_lock(&pool_mut);
+	c->last_used = time(NULL);
+	c->busy = 0;
+	pthread_mutex_unlock(&pool_mut);
+}
 
+/*
+ * @Name 			- 通过SSL发送数据(需要已经建立连接)
+ * @return 			- 返回发送完成的数据长度, 如果发送失败, 返回 <0
+ */
+static int ssl_write_all(SSL *ssl, const char *data, int size)
+{
+	int count = 0;
 	while(count < size)
 	{
-		re = SSL_write(ssl, data+count, size-count);
-		if(re == -1){
+		int re = SSL_write(ssl, data + count, size - count);
+		if(re <= 0){
 			return -2;
 		}
 		count += re;
 	}
-
 	return count;
 }
 
 /*
- * @Name 			- SSL接收数据, 需要已经建立连接
- * @Parame 	*ssl 	- SSL指针, 已经完成初始化并绑定了对应sock句柄的SSL指针
- * @Parame  *buff 	- 接收数据的缓冲区, 非空指针
- * @Parame 	 size 	- 准备接收的数据长度
- *
- * @return 			- 返回接收到的数据长度, 如果接收失败, 返回值 <0 
+ * @Name 			- 发出发送缓存中的数据(读响应之前必须调用)
  */
-int ssl_recv(SSL *ssl, char *buff, int size)
+static int conn_flush(https_conn_t *c)
 {
-	int i = 0; 				// 读取数据取换行数量, 即判断headers是否结束 
-	int re;
-	int len = 0;
-	char headers[HTTP_HEADERS_MAXLEN];
+	int len = c->wlen;
+	c->wlen = 0;
+	if(len > 0 && ssl_write_all(c->ssl, c->wbuf, len) < 0)
+		return -2;
+	return 0;
+}
 
-	if(ssl == NULL){
-		return -1;
+/*
+ * @Name 			- 写数据到连接: 小数据先放进发送缓存, 大数据直接发送
+ */
+static int conn_write(https_conn_t *c, const char *data, int size)
+{
+	if(c->wlen + size <= HTTPS_WBUF_SIZE)
+	{
+		memcpy(c->wbuf + c->wlen, data, size);
+		c->wlen += size;
+		return size;
+	}
+	if(conn_flush(c) < 0)
+		return -2;
+	if(size < HTTPS_WBUF_SIZE)
+		return conn_write(c, data, size);
+	return ssl_write_all(c->ssl, data, size);
+}
+
+/*
+ * @Name 			- 从连接读取数据(优先读接收缓存中的剩余数据)
+ */
+static int conn_read(https_conn_t *c, char *buf, int size)
+{
+	if(c->rpos < c->rlen)
+	{
+		int n = c->rlen - c->rpos;
+		if(n > size)
+			n = size;
+		memcpy(buf, c->rbuf + c->rpos, n);
+		c->rpos += n;
+		return n;
 	}
+	return SSL_read(c->ssl, buf, size);
+}
 
-	// Headers以换行结束, 此处判断头是否传输完成
-	while((len = SSL_read(ssl, headers, 1)) == 1)
+/*
+ * @Name 			- 读取一行(去掉结尾的\r\n), 行过长时截断
+ * @return 			- 行长度, 连接出错返回 -1
+ */
+static int conn_read_line(https_conn_t *c, char *line, int size)
+{
+	int len = 0;
+	for(;;)
 	{
-		if(i < 4){
-			if(headers[0] == '\r' || headers[0] == '\n'){
-				i++;
-				if(i>=4){
-					break;
-				}
-			}else{
-				i = 0;
+		char ch;
+		if(c->rpos == c->rlen)
+		{
+			c->rpos = 0;
+			c->rlen = SSL_read(c->ssl, c->rbuf, sizeof(c->rbuf));
+			if(c->rlen <= 0)
+			{
+				c->rlen = 0;
+				return -1;
 			}
 		}
-		//printf("%c", headers[0]);		// 打印Headers
+		ch = c->rbuf[c->rpos++];
+		if(ch == '\n')
+			break;
+		if(ch != '\r' && len < size - 1)
+			line[len++] = ch;
 	}
-
-	len = SSL_read(ssl, buff, size);
+	line[len] = '\0';
 	return len;
 }
 
+/*
+ * @Name 			- 读取 n 字节的 body, 放入 buff(超出 bsize 的部分丢弃)
+ */
+static int conn_read_body(https_conn_t *c, int n, char *buff, int bsize, int *blen)
+{
+	char tmp[256];
+	while(n > 0)
+	{
+		int want = n;
+		int re;
+		char *dst = tmp;
+		if(buff && *blen < bsize - 1)
+		{
+			dst = buff + *blen;
+			if(want > bsize - 1 - *blen)
+				want = bsize - 1 - *blen;
+		}
+		else if(want > (int)sizeof(tmp))
+			want = sizeof(tmp);
+		re = conn_read(c, dst, want);
+		if(re <= 0)
+			return -1;
+		if(dst != tmp)
+			*blen += re;
+		n -= re;
+	}
+	return 0;
+}
+
+/*
+ * @Name 			- 读取一个完整的 http 响应(按 Content-Length / chunked / 连接关闭 分帧)
+ * @Parame *head 	- 响应头输出(可为 NULL)
+ * @Parame *buff 	- 响应 body 输出(可为 NULL, 以'\0'结束)
+ * @Parame *blen 	- 返回 body 的长度
+ * @Parame *keep_alive - 返回连接能否继续复用
+ *
+ * @return 			- http 状态码, 失败返回 -1
+ */
+static int https_read_response(https_conn_t *c, char *head, int hsize, char *buff, int bsize, int *blen, int *keep_alive)
+{
+	char line[512];
+	int status = -1;
+	int minor = 0;
+	int content_len = -1;
+	int chunked = 0;
+	int hlen = 0;
+
+	*blen = 0;
+	*keep_alive = 0;
+	if(buff && bsize > 0)
+		buff[0] = '\0';
+
+	do{
+		// 1、状态行 + 响应头(跳过 100 Continue)
+		if(conn_read_line(c, line, sizeof(line)) < 0 || sscanf(line, "HTTP/1.%d %d", &minor, &status) != 2)
+			return -1;
+		*keep_alive = (minor >= 1);
+		content_len = -1;
+		chunked = 0;
+		hlen = 0;
+		for(;;)
+		{
+			int len = conn_read_line(c, line, sizeof(line));
+			if(len < 0)
+				return -1;
+			if(head && hlen + len + 2 < hsize)
+			{
+				memcpy(head + hlen, line, len);
+				memcpy(head + hlen + len, "\r\n", 2);
+				hlen += len + 2;
+				head[hlen] = '\0';
+			}
+			if(0 == len)
+				break;
+			if(0 == strncasecmp(line, "Content-Length:", 15))
+				content_len = atoi(line + 15);
+			else if(0 == strncasecmp(line, "Transfer-Encoding:", 18) && strstr(line + 18, "chunked"))
+				chunked = 1;
+			else if(0 == strncasecmp(line, "Connection:", 11))
+			{
+				if(strstr(line + 11, "close") || strstr(line + 11, "Close"))
+					*keep_alive = 0;
+				else if(strstr(line + 11, "eep-alive") || strstr(line + 11, "eep-Alive"))
+					*keep_alive = 1;
+			}
+		}
+	}while(status == 100);
+
+	// 2、body
+	if(status == 204 || status == 304)
+		return status;
+	if(chunked)
+	{
+		for(;;)
+		{
+			int size;
+			if(conn_read_line(c, line, sizeof(line)) < 0)
+				return -1;
+			size = strtol(line, NULL, 16);
+			if(size <= 0)
+				break;
+			if(conn_read_body(c, size, buff, bsize, blen) < 0 || conn_read_line(c, line, sizeof(line)) < 0)
+				return -1;
+		}
+		while(conn_read_line(c, line, sizeof(line)) > 0); // trailer
+	}
+	else if(content_len >= 0)
+	{
+		if(conn_read_body(c, content_len, buff, bsize, blen) < 0)
+			return -1;
+	}
+	else	// 没有长度信息: 读到服务端关闭连接为止
+	{
+		char tmp[256];
+		int re;
+		*keep_alive = 0;
+		while(buff && *blen < bsize - 1 && (re = conn_read(c, buff + *blen, bsize - 1 - *blen)) > 0)
+			*blen += re;
+		while((re = conn_read(c, tmp, sizeof(tmp))) > 0);
+	}
+	if(buff && bsize > 0)
+		buff[*blen] = '\0';
+	return status;
+}
+
+/*
+ * @Name 			- 发送请求头(确保以空行结束)
+ */
+static int conn_write_headers(https_conn_t *c, const char *headers)
+{
+	int len = strlen(headers);
+	if(conn_write(c, headers, len) < 0)
+		return -1;
+	if(len >= 4 && 0 == strcmp(headers + len - 4, "\r\n\r\n"))
+		return 0;
+	if(len >= 2 && 0 == strcmp(headers + len - 2, "\r\n"))
+		return conn_write(c, "\r\n", 2) < 0 ? -1 : 0;
+	return conn_write(c, "\r\n\r\n", 4) < 0 ? -1 : 0;
+}
+
+/*
+ * @Name 			- 生成默认的请求头(外部没有传入 headers 时使用)
+ */
+static void post_head_pack(const char *host, int port, const char *page, int len, char *head, int size)
+{
+	snprintf(head, size, "POST %s HTTP/1.1\r\n"
+						 "Host: %s:%d\r\n"
+						 "%s"
+						 "Connection: keep-alive\r\n"
+						 "Content-Length: %d\r\n\r\n",
+						 page, host, port, HttpsPostHeaders, len);
+}
+
+/*
+ * @Name 			- 在一条连接上完成一次请求(复用的连接失效时换新连接重发一次)
+ * @return 			- http 状态码, 失败返回 <0 (错误码同 https_post)
+ */
+static int https_request(char *host, int port, const char *headers, const char *data,
+							https_body_read_f body_read, void *arg, int body_len,
+							char *resp_head, int head_size, char *buff, int bsize, int *blen)
+{
+	int attempt;
+	int ret = -4;
+
+	for(attempt = 0; attempt < 2; attempt++)
+	{
+		int err = 0;
+		int keep_alive = 0;
+		int sent = 0;
+		int body_started = 0;
+		https_conn_t *c = conn_get(host, port, &err);
+		if(NULL == c)
+			return err;
+
+		// 1、请求头 + body
+		ret = -4;
+		if(conn_write_headers(c, headers) < 0)
+			goto FAIL;
+		if(data && body_len > 0)
+		{
+			body_started = 1;
+			if(conn_write(c, data, body_len) < 0)
+				goto FAIL;
+		}
+		while(body_read && sent < body_len)
+		{
+			char block[HTTPS_STREAM_BLOCK];
+			int want = body_len - sent;
+			int re;
+			if(want > HTTPS_STREAM_BLOCK)
+				want = HTTPS_STREAM_BLOCK;
+			body_started = 1;
+			re = body_read(arg, block, want);
+			if(re <= 0 || conn_write(c, block, re) < 0)
+				goto FAIL;
+			sent += re;
+		}
+
+		// 2、响应
+		if(conn_flush(c) < 0)
+			goto FAIL;
+		ret = https_read_response(c, resp_head, head_size, buff, bsize, blen, &keep_alive);
+		if(ret < 0)
+		{
+			ret = -5;
+			goto FAIL;
+		}
+		conn_put(c, keep_alive);
+		return ret;
+
+	FAIL:
+		{
+			int reused = c->reused;
+			conn_close(c);
+			// 复用的连接可能已被服务端关闭: 换新连接重试(流式 body 已开始读取则不能重发)
+			if(!reused || (body_read && body_started))
+				break;
+		}
+	}
+	return ret;
+}
+
 /*
  * @Name 			- HTTPS的POST提交
  * @Parame 	*host 	- 主机地址, 即域名
@@ -272,63 +764,44 @@ int ssl_recv(SSL *ssl, char *buff, int size)
  */
 int https_post(char *host, int port, char *url,char* headers, const char *data, int dsize, char *buff, int bsize)
 {
-	SSL *ssl;
-	int re = 0;
-	int sockfd;
-	int data_len = 0;
-	int ssize = dsize + HTTP_HEADERS_MAXLEN; 	// 欲发送的数据包大小
-
-	char *sdata = malloc(ssize);
-	if(sdata == NULL){
-		return -1;
-	}
-
-	// 1、建立TCP连接
-	sockfd = client_connect_tcp(host, port);
-	if(sockfd < 0){
-		free(sdata);
-		return -2;
-	}
-
-	// 2、SSL初始化, 关联Socket到SSL
-	ssl = ssl_init(sockfd);
-	if(ssl == NULL){
-		free(sdata);
-		close(sockfd);
-		return -3;
-	}
-
-	// 3、组合POST数据
-	data_len = post_pack(headers,host, port, url, dsize, data, sdata);
+	char head[HTTP_HEADERS_MAXLEN + 256];
+	int blen = 0;
+	int ret;
 
-	// 4、通过SSL发送数据
-	re = ssl_send(ssl, sdata, data_len);
-	if(re < 0){
-		free(sdata);
-		close(sockfd);
-		SSL_shutdown(ssl);
-		return -4;
-	}
-
-	// 5、取回数据
-	int r_len = 0;
-	r_len = ssl_recv(ssl, buff, bsize);
-	if(r_len < 0){
-		free(sdata);
-		close(sockfd);
-		SSL_shutdown(ssl);
-		return -5;
+	if(NULL == headers)//无 header ，按照默认的来
+	{
+		post_head_pack(host, port, url, dsize, head, sizeof(head));
+		headers = head;
 	}
 
-	// 6、关闭会话, 释放内存
-	free(sdata);
-	close(sockfd);
-	SSL_shutdown(ssl);
-	ERR_free_strings();
-
-	return r_len;
+	ret = https_request(host, port, headers, data, NULL, NULL, dsize, NULL, 0, buff, bsize, &blen);
+	if(ret < 0)
+		return ret;
+	return blen;
 }
 
-
-
-
+/*
+ * @Name 				- HTTPS 流式提交（body 通过回调分块读取，不需要整块数据在内存中）
+ * @Parame 	*host 		- 主机地址, 即域名
+ * @Parame 	 port 		- 端口号, 一般为443
+ * @Parame 	*headers 	- 完整的请求行 + 请求头(每行以\r\n结束, 不包含最后的空行, 需含 Content-Length)
+ * @Parame 	 body_read 	- body 数据读取回调(返回读到的字节数, 0:结束, <0:出错), 为 NULL 表示没有 body
+ * @Parame 	*arg 		- 回调参数
+ * @Parame 	 body_len 	- body 总长度(必须与 Content-Length 一致)
+ * @Parame 	*resp_head 	- 响应头输出缓存(可为 NULL)
+ * @Parame 	 head_size 	- resp_head 的大小
+ * @Parame 	*buff 		- 响应 body 输出缓存(可为 NULL)
+ * @Parame 	 bsize 		- buff 的大小
+ *
+ * @return 				- 	成功返回 http 状态码, 失败则返回值 <0
+ * 							-2 : 建立TCP连接失败
+ * 							-3 : SSL初始化或绑定sockfd到SSL失败
+ *							-4 : 提交失败(包括 body_read 出错)
+ *							-5 : 等待响应失败
+ */
+int https_send_stream(char *host, int port, const char *headers, https_body_read_f body_read, void *arg, int body_len,
+							char *resp_head, int head_size, char *buff, int bsize)
+{
+	int blen = 0;
+	return https_request(host, port, headers, NULL, body_read, arg, body_len, resp_head, head_size, buff, bsize, &blen);
+}
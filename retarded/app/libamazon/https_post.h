@@ -1,31 +1,63 @@
-/************************************************************************
-    > File Name: https_post.h
-    > Author:  
-    > Mail: 
-    > Blog:
-    > Created Time: 
- ***********************************************************************/
-
-#ifndef __HTTPS_POST__
-#define __HTTPS_POST__
-
-/*
- * @Name 			- HTTPS的POST提交
- * @Parame 	*host 	- 主机地址, 即域名
- * @Parame 	 port 	- 端口号, 一般为443
- * @Parame 	*url 	- url相对路径
- * @Parame 	*data 	- 要提交的数据内容, 不包括Headers
- * @Parame 	 dsize 	- 需要发送的数据包大小, 由外部调用传入, 不包含头
- * @Parame 	*buff 	- 数据缓存指针, 非空数组或提前malloc
- * @Parame 	 bsize 	- 需要读取的返回结果长度, 可以尽量给大, 直到读取结束
- *
- * @return 			- 	返回结果长度, 如果读取失败, 则返回值 <0
- * 						-1 : 为POST数据申请内存失败
- * 						-2 : 建立TCP连接失败
- * 						-3 : SSL初始化或绑定sockfd到SSL失败
- *						-4 : POST提交失败
- *						-5 : 等待响应失败
- */
-int https_post(char *host, int port, char *url,char* headers, const char *data, int dsize, char *buff, int bsize);
-
-#endif
+/************************************************************************
+    > File Name: https_post.h
+    > Author:  
+    > Mail: 
+    > Blog:
+    > Created Time: 
+ ***********************************************************************/
+
+#ifndef __HTTPS_POST__
+#define __HTTPS_POST__
+
+/*
+ * @Name 			- HTTPS的POST提交
+ * @Parame 	*host 	- 主机地址, 即域名
+ * @Parame 	 port 	- 端口号, 一般为443
+ * @Parame 	*url 	- url相对路径
+ * @Parame 	*headers- 完整的请求行 + 请求头(传NULL则使用默认的头), 连接会被放回连接池复用
+ * @Parame 	*data 	- 要提交的数据内容, 不包括Headers
+ * @Parame 	 dsize 	- 需要发送的数据包大小, 由外部调用传入, 不包含头
+ * @Parame 	*buff 	- 数据缓存指针, 非空数组或提前malloc
+ * @Parame 	 bsize 	- 需要读取的返回结果长度, 可以尽量给大, 直到读取结束
+ *
+ * @return 			- 	返回结果长度, 如果读取失败, 则返回值 <0
+ * 						-1 : 为POST数据申请内存失败
+ * 						-2 : 建立TCP连接失败
+ * 						-3 : SSL初始化或绑定sockfd到SSL失败
+ *						-4 : POST提交失败
+ *						-5 : 等待响应失败
+ */
+int https_post(char *host, int port, char *url,char* headers, const char *data, int dsize, char *buff, int bsize);
+
+
+#define HTTPS_STREAM_BLOCK 		(16*1024) 	// 流式提交时每次写入 SSL 的块大小
+
+/*
+ * body 数据读取回调: 从 arg 中读取最多 size 字节到 buf
+ * 返回读到的字节数, 0 表示数据已读完, <0 表示出错
+ */
+typedef int (*https_body_read_f)(void *arg, char *buf, int size);
+
+/*
+ * @Name 			- HTTPS 流式提交（body 通过回调分块读取）
+ * @Parame *headers - 完整的请求行 + 请求头(不包含最后的空行), 需含 Content-Length: body_len
+ * @Parame *resp_head/head_size - 响应头输出(可为 NULL), 用于获取 ETag 等字段
+ * @Parame *buff/bsize 			- 响应 body 输出(可为 NULL)
+ *
+ * @return 			- 成功返回 http 状态码, 失败返回值 <0 (错误码同 https_post)
+ */
+int https_send_stream(char *host, int port, const char *headers, https_body_read_f body_read, void *arg, int body_len,
+							char *resp_head, int head_size, char *buff, int bsize);
+
+
+/*
+ * 连接复用统计(metrics 快照中的 "https" 对象)
+ */
+typedef struct _https_stat_t
+{
+	unsigned int handshakes;	// TLS 握手次数(含会话恢复)
+	unsigned int resumed;		// 其中使用会话恢复(简化握手)的次数
+	unsigned int reused;		// 直接复用 keep-alive 连接(无握手)的请求次数
+}https_stat_t;
+
+#endif
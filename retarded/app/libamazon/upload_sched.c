@@ -0,0 +1,463 @@
+/***************************************************************************
+* @file: upload_sched.c
+* @author:
+* @date:  10,19,2026
+* @brief:  amazon 云上传调度（按优先级出队 + 按字节数准入 + 超时丢弃 + 多上传线程 + 限速）
+* @attention:
+	1.每个优先级一条 FIFO 链表，出队时从最高优先级开始找，生产者/上传线程都用条件变量唤醒，
+	  没有轮询。
+	2.节点占用的字节数：mode 2 为 file_buf_len，mode 3 为管道大小，mode 1（文件）不占内存。
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "typeport.h"
+#include "amazon_S3.h"
+#include "amazon_upload.h"
+#include "upload_sched.h"
+#include "metrics.h"
+
+#define UPLOAD_CLOCK_JUMP		3600		//节点等待时间超过截止时间这么多秒，认为是系统时间被校准（不是真的过期）
+
+/*每个优先级节点的最长等待时间（秒），过期则丢弃*/
+static const int upload_ttl[UPLOAD_PRIO_NUM] = {
+	120,		//UPLOAD_PRIO_JPG 	: 告警通知已经推送过了，缩略图太晚到达意义不大
+	600,		//UPLOAD_PRIO_CLIP
+	300,		//UPLOAD_PRIO_PREVIEW
+	600,		//UPLOAD_PRIO_M3U
+};
+
+static const char* upload_prio_name[UPLOAD_PRIO_NUM] = {"jpg","clip","preview","m3u8"};
+
+typedef struct _upload_node_t
+{
+	put_file_info_t			info;
+	int						prio;
+	int						bytes;			//占用的缓存字节数
+	time_t					enq_time;		//入队时间
+	struct _upload_node_t*	next;
+}upload_node_t;
+
+typedef struct _upload_class_t
+{
+	upload_node_t*	head;					//最旧
+	upload_node_t*	tail;					//最新
+	int				num;
+}upload_class_t;
+
+typedef struct _upload_sched_t
+{
+	int					inited;
+	pthread_mutex_t		mut;
+	pthread_cond_t		not_empty;			//有新的节点（或录像上传结束）：唤醒上传线程
+	pthread_cond_t		not_full;			//有节点出队/被丢弃：唤醒等待空间的生产者
+	upload_class_t		cls[UPLOAD_PRIO_NUM];
+	int					num;				//队列中的节点总数
+	unsigned int		bytes;				//队列中缓存的总字节数
+	int					clip_busy;			//正在上传的录像节点个数（录像要按顺序上传）
+	upload_drop_f		drop_cb;
+
+	/*---令牌桶限速----------------------*/
+	pthread_mutex_t		rate_mut;
+	int					rate;				//字节/秒，0：不限速
+	long long			tokens;				//可用的字节数（可以为负，表示欠账）
+	long long			last_ms;			//上次补充令牌的时间
+}upload_sched_t;
+
+static upload_sched_t g_sched;
+
+
+static long long now_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*节点占用的缓存字节数*/
+static int upload_node_bytes(const put_file_info_t *info)
+{
+	if(info->mode == 2)
+		return info->file_buf_len;
+	if(info->mode == 3)
+		return UPLOAD_PIPE_SIZE;
+	return 0;
+}
+
+/*丢弃一个文件：通知上层并释放 file_buf/stream（调用者不持有锁）*/
+static void upload_info_drop(put_file_info_t *info, int prio, const char *reason)
+{
+	ERROR_LOG("upload %s(%s,%d) dropped: %s\n",info->file_name,upload_prio_name[prio],upload_node_bytes(info),reason);
+	METRICS_INC(MET_C_UPLOAD_DROP);
+	if(g_sched.drop_cb)
+		g_sched.drop_cb(info,reason);
+	if(info->file_buf)
+	{
+		free(info->file_buf);
+		info->file_buf = NULL;
+	}
+	if(info->stream)
+	{
+		upload_stream_release(info->stream);
+		info->stream = NULL;
+	}
+}
+
+static void upload_node_drop(upload_node_t *node, const char *reason)
+{
+	upload_info_drop(&node->info,node->prio,reason);
+	free(node);
+}
+
+/*从 FIFO 中摘下最旧的节点（需持有锁）*/
+static upload_node_t* upload_class_take(int prio)
+{
+	upload_class_t *c = &g_sched.cls[prio];
+	upload_node_t *node = c->head;
+	if(NULL == node)
+		return NULL;
+	c->head = node->next;
+	if(NULL == c->head)
+		c->tail = NULL;
+	c->num --;
+	g_sched.num --;
+	g_sched.bytes -= node->bytes;
+	node->next = NULL;
+	return node;
+}
+
+/*
+ * 摘下所有已过期的节点（需持有锁），挂到 *dropped 链表上，由调用者在释放锁之后再释放资源
+ */
+static void upload_collect_expired(upload_node_t **dropped)
+{
+	time_t now = time(NULL);
+	int prio;
+
+	for(prio = 0; prio < UPLOAD_PRIO_NUM; prio++)
+	{
+		upload_class_t *c = &g_sched.cls[prio];
+		upload_node_t **pp = &c->head;
+		upload_node_t *prev = NULL;
+		while(*pp)
+		{
+			upload_node_t *node = *pp;
+			long wait = (long)(now - node->enq_time);
+			if(wait < 0 || wait > upload_ttl[prio] + UPLOAD_CLOCK_JUMP) //系统时间被校准，重新计时
+			{
+				node->enq_time = now;
+				wait = 0;
+			}
+			if(wait <= upload_ttl[prio])
+			{
+				prev = node;
+				pp = &node->next;
+				continue;
+			}
+			*pp = node->next;
+			if(c->tail == node)
+				c->tail = prev;
+			c->num --;
+			g_sched.num --;
+			g_sched.bytes -= node->bytes;
+			node->next = *dropped;
+			*dropped = node;
+		}
+	}
+}
+
+/*依次释放被丢弃的节点（调用者不持有锁）*/
+static void upload_drop_list(upload_node_t *list, const char *reason)
+{
+	while(list)
+	{
+		upload_node_t *next = list->next;
+		upload_node_drop(list,reason);
+		list = next;
+	}
+}
+
+/*队列是否还能放下 bytes 字节（队列为空时总是可以，避免超大文件永远进不了队列）*/
+static int upload_has_room(int bytes)
+{
+	return (0 == g_sched.bytes || g_sched.bytes + bytes <= UPLOAD_SCHED_MAX_BYTES);
+}
+
+/*当前可以出队的最高优先级（需持有锁），没有返回 -1*/
+static int upload_ready_prio(void)
+{
+	int prio;
+	for(prio = 0; prio < UPLOAD_PRIO_NUM; prio++)
+	{
+		if(0 == g_sched.cls[prio].num)
+			continue;
+		if(prio == UPLOAD_PRIO_CLIP && g_sched.clip_busy) //录像分段按顺序上传
+			continue;
+		return prio;
+	}
+	return -1;
+}
+
+
+int upload_sched_prio(const put_file_info_t *info)
+{
+	if(info->file_type == TYPE_JPG)
+		return UPLOAD_PRIO_JPG;
+	if(info->file_type == TYPE_M3U)
+		return UPLOAD_PRIO_M3U;
+	if(info->ts_flag == TS_FLAG_6S)
+		return UPLOAD_PRIO_PREVIEW;
+	return UPLOAD_PRIO_CLIP;
+}
+
+int upload_sched_init(upload_drop_f drop_cb)
+{
+	if(g_sched.inited)
+		return 0;
+
+	memset(&g_sched,0,sizeof(g_sched));
+	pthread_mutex_init(&g_sched.mut,NULL);
+	pthread_cond_init(&g_sched.not_empty,NULL);
+	pthread_cond_init(&g_sched.not_full,NULL);
+	pthread_mutex_init(&g_sched.rate_mut,NULL);
+	g_sched.drop_cb = drop_cb;
+	g_sched.rate = UPLOAD_SCHED_RATE;
+	g_sched.tokens = UPLOAD_SCHED_BURST;
+	g_sched.last_ms = now_ms();
+	g_sched.inited = 1;
+	return 0;
+}
+
+/*
+ * 入队
+ * wait_sec：放不下时等待上传线程取走节点的最长时间，0 表示不等待（直接挤掉同优先级最旧的节点）
+ */
+static int upload_sched_enqueue(put_file_info_t *info, int wait_sec)
+{
+	upload_node_t *node = NULL;
+	upload_node_t *dropped = NULL;		//过期的节点
+	upload_node_t *evicted = NULL;		//为新节点腾出空间而被挤掉的节点
+	struct timespec deadline;
+	struct timeval now;
+	int prio;
+	int ret = 0;
+
+	if(NULL == info)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+
+	node = g_sched.inited ? (upload_node_t*)calloc(1,sizeof(upload_node_t)) : NULL;
+	if(NULL == node)
+	{
+		upload_info_drop(info,upload_sched_prio(info),"upload sched not ready");
+		return -1;
+	}
+	memcpy(&node->info,info,sizeof(put_file_info_t));
+	node->prio = prio = upload_sched_prio(info);
+	node->bytes = upload_node_bytes(info);
+
+	gettimeofday(&now,NULL);
+	deadline.tv_sec = now.tv_sec + wait_sec;
+	deadline.tv_nsec = now.tv_usec * 1000;
+
+	pthread_mutex_lock(&g_sched.mut);
+	upload_collect_expired(&dropped);
+
+	/*---1、放不下：先挤掉更低优先级的节点（从最低优先级、最旧的开始）--------*/
+	while(!upload_has_room(node->bytes))
+	{
+		int p;
+		upload_node_t *victim = NULL;
+		for(p = UPLOAD_PRIO_NUM - 1; p > prio && NULL == victim; p--)
+			victim = upload_class_take(p);
+		if(NULL == victim)
+			break;
+		victim->next = evicted;
+		evicted = victim;
+	}
+
+	/*---2、仍放不下：等待上传线程取走节点（背压）------------------------------*/
+	while(wait_sec > 0 && !upload_has_room(node->bytes))
+	{
+		if(ETIMEDOUT == pthread_cond_timedwait(&g_sched.not_full,&g_sched.mut,&deadline))
+			break;
+	}
+
+	/*---3、超时（或不等待）后挤掉同优先级最旧的节点，只剩更高优先级的节点时拒绝新节点------*/
+	while(!upload_has_room(node->bytes))
+	{
+		upload_node_t *victim = upload_class_take(prio);
+		if(NULL == victim)
+			break;
+		victim->next = evicted;
+		evicted = victim;
+	}
+
+	if(upload_has_room(node->bytes))
+	{
+		upload_class_t *c = &g_sched.cls[prio];
+		node->enq_time = time(NULL);
+		if(c->tail)
+			c->tail->next = node;
+		else
+			c->head = node;
+		c->tail = node;
+		c->num ++;
+		g_sched.num ++;
+		g_sched.bytes += node->bytes;
+		pthread_cond_signal(&g_sched.not_empty);
+		METRICS_INC(MET_C_UPLOAD_PUSH);
+		node = NULL;
+	}
+	if(dropped || evicted)
+		pthread_cond_broadcast(&g_sched.not_full);
+	METRICS_GAUGE(MET_G_UPLOAD_KB, g_sched.bytes >> 10);
+	pthread_mutex_unlock(&g_sched.mut);
+
+	upload_drop_list(dropped,"expired");
+	upload_drop_list(evicted,"queue full");
+	if(node)
+	{
+		upload_node_drop(node,"queue full of higher priority files");
+		ret = -1;
+	}
+	return ret;
+}
+
+int upload_sched_push(put_file_info_t *info)
+{
+	return upload_sched_enqueue(info,UPLOAD_SCHED_WAIT_TIME);
+}
+
+int upload_sched_push_nowait(put_file_info_t *info)
+{
+	return upload_sched_enqueue(info,0);
+}
+
+int upload_sched_pop(put_file_info_t *info, int *prio)
+{
+	upload_node_t *node = NULL;
+	upload_node_t *dropped = NULL;
+
+	if(NULL == info || !g_sched.inited)
+	{
+		ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(&g_sched.mut);
+	for(;;)
+	{
+		int p;
+		upload_collect_expired(&dropped);
+		if(dropped)
+		{
+			pthread_cond_broadcast(&g_sched.not_full);
+			pthread_mutex_unlock(&g_sched.mut);
+			upload_drop_list(dropped,"expired");
+			dropped = NULL;
+			pthread_mutex_lock(&g_sched.mut);
+			continue;
+		}
+
+		p = upload_ready_prio();
+		if(p >= 0)
+		{
+			node = upload_class_take(p);
+			if(p == UPLOAD_PRIO_CLIP)
+				g_sched.clip_busy ++;
+			break;
+		}
+
+		/*没有可上传的节点：等待入队，队列不为空时定时醒来检查过期*/
+		if(0 == g_sched.num)
+			pthread_cond_wait(&g_sched.not_empty,&g_sched.mut);
+		else
+		{
+			struct timespec deadline;
+			struct timeval now;
+			gettimeofday(&now,NULL);
+			deadline.tv_sec = now.tv_sec + 1;
+			deadline.tv_nsec = now.tv_usec * 1000;
+			pthread_cond_timedwait(&g_sched.not_empty,&g_sched.mut,&deadline);
+		}
+	}
+	pthread_cond_broadcast(&g_sched.not_full);
+	METRICS_GAUGE(MET_G_UPLOAD_KB, g_sched.bytes >> 10);
+	pthread_mutex_unlock(&g_sched.mut);
+
+	if(METRICS_FLAGS())
+	{
+		long wait = (long)(time(NULL) - node->enq_time);
+		if(wait < 0)
+			wait = 0;
+		METRICS_HIST(MET_H_UPLOAD_WAIT_S, wait);
+		METRICS_TRACE(TRACE_UPLOAD_POP, node->prio, 0, wait, node->bytes);
+	}
+	memcpy(info,&node->info,sizeof(put_file_info_t));
+	if(prio)
+		*prio = node->prio;
+	free(node);
+	return 0;
+}
+
+void upload_sched_done(int prio)
+{
+	if(prio != UPLOAD_PRIO_CLIP)
+		return;
+
+	pthread_mutex_lock(&g_sched.mut);
+	if(g_sched.clip_busy > 0)
+		g_sched.clip_busy --;
+	pthread_cond_broadcast(&g_sched.not_empty); //下一个录像分段可以上传了
+	pthread_mutex_unlock(&g_sched.mut);
+}
+
+void upload_sched_set_rate(int rate)
+{
+	pthread_mutex_lock(&g_sched.rate_mut);
+	g_sched.rate = rate > 0 ? rate : 0;
+	pthread_mutex_unlock(&g_sched.rate_mut);
+}
+
+void upload_sched_throttle(int bytes)
+{
+	long long wait_ms = 0;
+
+	if(bytes <= 0 || !g_sched.inited)
+		return;
+
+	/*令牌按速率补充，最多攒 UPLOAD_SCHED_BURST；不够时先记账（令牌变负），在锁外睡眠补足的时间*/
+	pthread_mutex_lock(&g_sched.rate_mut);
+	if(g_sched.rate > 0)
+	{
+		long long now = now_ms();
+		long long elapsed = now - g_sched.last_ms;
+		if(elapsed < 0)
+			elapsed = 0;
+		g_sched.last_ms = now;
+		g_sched.tokens += elapsed * g_sched.rate / 1000;
+		if(g_sched.tokens > UPLOAD_SCHED_BURST)
+			g_sched.tokens = UPLOAD_SCHED_BURST;
+		g_sched.tokens -= bytes;
+		if(g_sched.tokens < 0)
+			wait_ms = (-g_sched.tokens) * 1000 / g_sched.rate;
+	}
+	pthread_mutex_unlock(&g_sched.rate_mut);
+
+	while(wait_ms > 0)
+	{
+		int ms = wait_ms > 1000 ? 1000 : (int)wait_ms;
+		usleep(ms * 1000);
+		wait_ms -= ms;
+	}
+}
+
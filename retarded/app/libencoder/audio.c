@@ -11,6 +11,7 @@
 #include <sys/un.h> 
 #include <fcntl.h>
 #include <pthread.h>
+#include <time.h>
 #include <errno.h>
 #include <signal.h>
 #include <arpa/inet.h>
@@ -37,6 +38,7 @@
 #include "shine/layer3.h"
 #include "comm_sys.h"
 #include "EasyAACEncoderAPI.h"
+#include "pcm_ring.h"
 #include "gpio_reg.h"
  
 
@@ -1431,14 +1433,15 @@ int play_tip(char* fn, PLAY_END_CALLBACK cbFunc, void* cbfPara)
 ***************************************************************************************/
 
 aac_config_t aac_config = {0};
-typedef struct _audFrm_t
-{
-	AUDIO_FRAME_S 	audFrm; 	//发送给AAC编码线程的原始音频数据帧信息
-	pthread_mutex_t audFrm_mut;
-	pthread_cond_t  audFrm_cnd;
 
-}audFrm_t;
-audFrm_t audFrm_flg = {0};
+/*---#AI -> AAC 编码线程的 PCM 环形缓存（见 pcm_ring.h）-------------------------------*/
+#define AAC_PTS_DELAY_MAX		(4)		//faac 编码延迟（帧）上限，用于输出帧与输入帧时间戳对齐
+
+static pcm_ring_t PCM_ring;
+
+/*faac 的输出比输入晚几帧，按顺序记录已送入编码器的帧的 PTS*/
+static unsigned long long AAC_pts_fifo[AAC_PTS_DELAY_MAX];
+static unsigned int AAC_pts_cnt = 0;
 
 InitParam easy_aac_handle = {0};
 
@@ -1540,8 +1543,8 @@ aac_config_t* AAC_encode_init(void)
 
 
 
-	pthread_mutex_init(&audFrm_flg.audFrm_mut, NULL);
-    pthread_cond_init(&audFrm_flg.audFrm_cnd, NULL);
+	pcm_ring_init(&PCM_ring, aac_config.SampleRate);
+	AAC_pts_cnt = 0;
 	
 	//创建AAC编码客户端线程（获取audio源数据并发送给AAC编码server线程）
 	pthread_t tid;
@@ -1657,10 +1660,9 @@ int AAC_encode(int * inputBuffer,
 *@ Input          :<pstFrm >音频帧结构体指针
 *@ Output         :
 *@ Return         :	成功 ： 0
-					失败： -1
-*@ attention      :
+					失败： -1（参数错误 / 环形缓存溢出丢帧）
+*@ attention      :PCM 数据拷贝进环形缓存，返回后即可释放 AI 帧
 *******************************************************************************/
-static unsigned int send_PCM_count = 0; //统计接收（发送）的PCM帧数（在一段时间内）
 int AAC_AENC_SendFrame( const AUDIO_FRAME_S *pstFrm)
 {
 	if(NULL == pstFrm)
@@ -1668,14 +1670,20 @@ int AAC_AENC_SendFrame( const AUDIO_FRAME_S *pstFrm)
 		ERROR_LOG("pstFrm is NULL!\n");
 		return -1;
 	}
-	
-	pthread_mutex_lock(&audFrm_flg.audFrm_mut);	
-		memcpy(&audFrm_flg.audFrm,pstFrm,sizeof(AUDIO_FRAME_S));
-		send_PCM_count++;	
-		pthread_cond_signal(&audFrm_flg.audFrm_cnd);
-	pthread_mutex_unlock(&audFrm_flg.audFrm_mut);
-	
-	return 0;
+
+	return pcm_ring_write(&PCM_ring,(const short*)pstFrm->pVirAddr[0],pstFrm->u32Len / 2,pstFrm->u64TimeStamp);
+}
+
+/*******************************************************************************
+*@ Description    :获取AI -> AAC 环形缓存的溢出统计
+*@ Input          :
+*@ Output         :<frames>丢弃的 AI 帧数 <samples>丢弃的样本数（可为 NULL）
+*@ Return         :0
+*@ attention      :
+*******************************************************************************/
+int AAC_AENC_getOverrun(unsigned int *frames, unsigned int *samples)
+{
+	return pcm_ring_get_overrun(&PCM_ring,frames,samples);
 }
 
 /*******************************************************************************
@@ -1684,12 +1692,9 @@ int AAC_AENC_SendFrame( const AUDIO_FRAME_S *pstFrm)
 *@ Output         :<pstStream>(输出)编码后AAC数据存放buf的首地址
 *@ Return         :成功： AAC编码帧的实际长度
 					失败：-1
-*@ attention      :
+*@ attention      :每次从环形缓存取 aac_config.InputSamples 个样本送给 faac，
+					faac 起始几帧只缓存不输出，此时继续取下一帧，直到有输出
 *******************************************************************************/
-int debug_count = 0;
-static unsigned int PCM_residue = 0; //PCM帧在 aac_config.PCMBuffer没能放下的部分数据大小
-static unsigned char PCM_residue_buf[PCM_FRAME_SIZE] = {0};//PCM帧在 aac_config.PCMBuffer没能放下的部分数据(备份)
-static unsigned int get_PCM_count = 0; //统计接收端编码一帧AAC数据收到的PCM帧数。
 int AAC_AENC_getFrame(AUDIO_STREAM_S *pstStream)
 {
 	if(NULL == pstStream)
@@ -1699,95 +1704,43 @@ int AAC_AENC_getFrame(AUDIO_STREAM_S *pstStream)
 	}
 	int ret = -1;
 	unsigned int out_len = 0;
-	AUDIO_FRAME_S audFrm_bak; //PCM帧描述信息(备份)
-	unsigned char PCM_buf[PCM_FRAME_SIZE] = {0};//PCM帧实际数据(备份)
-	unsigned int PCMBuffer_offset = 0;
-		
-AAC_OUT_LEN_IS_0:
-	
-	pthread_mutex_lock(&audFrm_flg.audFrm_mut);
-		pthread_cond_wait(&audFrm_flg.audFrm_cnd, &audFrm_flg.audFrm_mut);
-		
-		memcpy(&audFrm_bak,&audFrm_flg.audFrm,sizeof(AUDIO_FRAME_S)); //备份PCM帧描述信息
-		//memcpy(&PCM_buf,audFrm_flg.audFrm.pVirAddr[0],audFrm_flg.audFrm.u32Len); //备份PCM帧实际数据
-		get_PCM_count ++;
-		//进行AAC编码
-		debug_count ++;
-
-			//需要进行凑数据处理
-			if(PCM_residue > 0)//上次循环还有数据没放完，先放上次剩余的部分
-			{
-				memcpy(aac_config.PCMBuffer + PCMBuffer_offset,PCM_residue_buf,PCM_residue); 
-				PCMBuffer_offset += PCM_residue;
-				PCM_residue = 0;
-			}
-			
-			if(aac_config.PCMBuffer_size - PCMBuffer_offset > 0)//缓冲区原始PCM数据没满，凑数据
-			{
-			
-				if(aac_config.PCMBuffer_size - PCMBuffer_offset >= audFrm_flg.audFrm.u32Len)//能直接放入当前PCM帧
-				{
-					memcpy(aac_config.PCMBuffer + PCMBuffer_offset,audFrm_flg.audFrm.pVirAddr[0],audFrm_flg.audFrm.u32Len); 
-					PCMBuffer_offset += audFrm_flg.audFrm.u32Len;
-				}
-				else //原始PCM数据没凑满,但不能直接放入当前PCM帧
-				{
-					unsigned int PCMBuffer_residue = aac_config.PCMBuffer_size - PCMBuffer_offset;//剩余空间大小
-					memcpy(aac_config.PCMBuffer + PCMBuffer_offset,audFrm_flg.audFrm.pVirAddr[0],PCMBuffer_residue); //只放入一部分
-					PCMBuffer_offset += PCMBuffer_residue;
-					PCM_residue = audFrm_flg.audFrm.u32Len - PCMBuffer_residue;//PCM帧剩余的部分大小记录
-					memcpy(PCM_residue_buf,(unsigned char*)audFrm_flg.audFrm.pVirAddr[0] + PCMBuffer_residue,PCM_residue);//剩余部分进行数据备份
-				}
-				
-				
-			
-			}
-			//DEBUG_LOG("aac_config.PCMBuffer_size(%d) PCMBuffer_offset(%d)\n",aac_config.PCMBuffer_size,PCMBuffer_offset);
-			if(aac_config.PCMBuffer_size - PCMBuffer_offset == 0)//缓冲区原始PCM数据满,进行AAC编码
-			{
-				
-				unsigned int nInputSamples = (aac_config.PCMBuffer_size / (aac_config.PCMBitSize / 8));
-				//DEBUG_LOG("AAC_encode need PCM samples (%d) actual input PCM samples (%d)\n",aac_config.InputSamples,nInputSamples);
-				ret = AAC_encode((int *)aac_config.PCMBuffer,nInputSamples,aac_config.AACBuffer,aac_config.MaxOutputBytes);
-				if(ret < 0)
-				{
-					ERROR_LOG("AAC_encode failed !\n");
-					return -1;
-				}
-				out_len = ret;
-				//printf("send_PCM_count = %d  get_PCM_count = %d\n",send_PCM_count,get_PCM_count);
-				get_PCM_count = 0;
-				send_PCM_count = 0;//统计编码一帧AAC实际凑了多少帧pcm数据
-				
-			}
-			else if(aac_config.PCMBuffer_size - PCMBuffer_offset < 0)//凑数据越界了，异常！！！
-			{
-				ERROR_LOG("aac_config.PCMBuffer overflow!!\n");
-				return -1;
-			}
-			else //缓存没满，继续接受下一帧PCM数据
-			{
-				pthread_mutex_unlock(&audFrm_flg.audFrm_mut);
-				//DEBUG_LOG("Lack PCM data---waite the next input frame... \n");
-				goto AAC_OUT_LEN_IS_0;
-			}
-		
-		if(debug_count >= 10)
+	unsigned long long pts = 0;
+	unsigned int nInputSamples = aac_config.InputSamples;
+
+	while(0 == out_len)
+	{
+		if(pcm_ring_read(&PCM_ring,(short*)aac_config.PCMBuffer,nInputSamples,&pts) < 0)
 		{
-			//DEBUG_LOG("encode AAC frame size(%d) out_len(%d)\n",ret,out_len);
-			debug_count = 0;
+			return -1; //1s 内没有凑够一帧数据（AI 停止采集）
 		}
 
+		/*记录送入编码器的帧时间戳，输出帧对应最早送入的那一帧*/
+		if(AAC_pts_cnt >= AAC_PTS_DELAY_MAX)
+		{
+			ERROR_LOG("AAC encoder delay over %d frames!\n",AAC_PTS_DELAY_MAX);
+			memmove(AAC_pts_fifo,AAC_pts_fifo + 1,(AAC_PTS_DELAY_MAX - 1) * sizeof(AAC_pts_fifo[0]));
+			AAC_pts_cnt --;
+		}
+		AAC_pts_fifo[AAC_pts_cnt++] = pts;
 
-		//填充返回参数
-		pstStream->pStream = (unsigned char*)aac_config.AACBuffer;
-		pstStream->u32PhyAddr = 0;
-		pstStream->u32Len = out_len;
-//		printf("AAC out_len(%d)\n",out_len);
-		pstStream->u64TimeStamp = audFrm_bak.u64TimeStamp;
-		pstStream->u32Seq = 0;  //该变量如有问题后续修改
-	
-	pthread_mutex_unlock(&audFrm_flg.audFrm_mut);
+		ret = AAC_encode((int *)aac_config.PCMBuffer,nInputSamples,aac_config.AACBuffer,aac_config.MaxOutputBytes);
+		if(ret < 0)
+		{
+			ERROR_LOG("AAC_encode failed !\n");
+			return -1;
+		}
+		out_len = ret;
+	}
+
+	//填充返回参数
+	pstStream->pStream = (unsigned char*)aac_config.AACBuffer;
+	pstStream->u32PhyAddr = 0;
+	pstStream->u32Len = out_len;
+	pstStream->u64TimeStamp = AAC_pts_fifo[0];
+	pstStream->u32Seq = 0;  //该变量如有问题后续修改
+
+	AAC_pts_cnt --;
+	memmove(AAC_pts_fifo,AAC_pts_fifo + 1,AAC_pts_cnt * sizeof(AAC_pts_fifo[0]));
 
 		/*--DEBUG 将文件写到缓存buf----------------------------------------*/
 		#if switch_record_AAC
@@ -1817,7 +1770,7 @@ AAC_OUT_LEN_IS_0:
 		#endif
 		/*----------------------------------------------------------------*/
 
-	return ret;
+	return out_len;
 }
 
 
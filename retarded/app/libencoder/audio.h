@@ -125,8 +125,8 @@ typedef struct _aac_config_t
     unsigned int    PCMBitSize;         //音频采样精度（位宽）
     unsigned long   InputSamples;       //每次调用编码时所应接收的原始数据采样点个数（凑数据后的 FRAME_LEN*numChannels）
     unsigned long   MaxOutputBytes;     //每次调用编码时生成的AAC数据的最大长度
-    unsigned int    PCMBuffer_size;     //每次传给faac库（凑数据后）进行AAC编码的数据长度（每次调用并不是都返回AAC帧，只有凑足数据了才会进行AAC编码返回）
-    unsigned char*  PCMBuffer;          //pcm数据（用于faac库凑PCM样本数）
+    unsigned int    PCMBuffer_size;     //每次传给faac库进行AAC编码的数据长度（InputSamples 个样本，从PCM环形缓存取出）
+    unsigned char*  PCMBuffer;          //pcm数据（一帧编码输入）
     unsigned char*  AACBuffer;          //aac数据
 }aac_config_t;
 
@@ -145,8 +145,8 @@ aac_config_t* AAC_encode_init(void);
 *@ Input          :<pstFrm >音频帧结构体指针
 *@ Output         :
 *@ Return         :	成功 ： 0
-					失败： -1
-*@ attention      :
+					失败： -1（参数错误 / 环形缓存溢出丢帧）
+*@ attention      :PCM 数据拷贝进环形缓存，返回后即可释放 AI 帧
 *******************************************************************************/
 int AAC_AENC_SendFrame( const AUDIO_FRAME_S *pstFrm);
 
@@ -156,10 +156,19 @@ int AAC_AENC_SendFrame( const AUDIO_FRAME_S *pstFrm);
 *@ Output         :<pstStream>(输出)编码后AAC数据存放buf的首地址
 *@ Return         :成功： AAC编码帧的实际长度
 					失败：-1
-*@ attention      :
+*@ attention      :u64TimeStamp 由样本数推算（见 audio.c PCM 环形缓存说明）
 *******************************************************************************/
 int AAC_AENC_getFrame(AUDIO_STREAM_S *pstStream);
 
+/*******************************************************************************
+*@ Description    :获取AI -> AAC 环形缓存的溢出统计
+*@ Input          :
+*@ Output         :<frames>丢弃的 AI 帧数 <samples>丢弃的样本数（可为 NULL）
+*@ Return         :0
+*@ attention      :编码线程取数据太慢时 AI 帧会被丢弃，不会覆盖未编码的数据
+*******************************************************************************/
+int AAC_AENC_getOverrun(unsigned int *frames, unsigned int *samples);
+
 
 
 /*******************************************************************************
@@ -28,6 +28,9 @@
 #include "spm.h"
 #include "sdp.h"
 #include "surface_scaler.h"
+#include "luma_stat.h"
+#include "jpeg_cache.h"
+#include "metrics.h"
 #include "ziku.h"
 #include "watchdog.h"
 #include "audio.h"
@@ -91,6 +94,9 @@ typedef struct _tag_ENC_CHN_CONTEX
 {
     int state;
     int enc_level;
+    int rc_level; /*encoder_set_rate_ctrl设置的码率等级，和enc_level取较大者生效*/
+    int rc_fps_div; /*帧率除数，0和1都表示不降帧率*/
+    int rc_gop_sec; /*GOP时长（秒），0表示1秒*/
     pthread_mutex_t lock;
     ENC_STREAM_ATTR enc_attr;
     ENC_STREAM_PACK *curr_pack;
@@ -363,6 +369,70 @@ static void set_venc_rc_attr(VENC_CHN_ATTR_S *vencAttr, ENC_STREAM_ATTR *stream_
     }
 }
 
+/*
+    在set_venc_rc_attr的基础上叠加encoder_set_rate_ctrl的帧率/GOP设置
+    帧率 = framerate / rc_fps_div，GOP = 帧率 * rc_gop_sec
+ */
+static void set_venc_rc_override(VENC_CHN_ATTR_S *vencAttr, ENC_CHN_CONTEX *chn_ctx, ENC_STREAM_ATTR *stream_attr)
+{
+    int fps_div = chn_ctx->rc_fps_div > 1 ? chn_ctx->rc_fps_div : 1;
+    int gop_sec = chn_ctx->rc_gop_sec > 1 ? chn_ctx->rc_gop_sec : 1;
+    HI_U32 *gop = NULL;
+    HI_FR32 *dst_frmrate = NULL;
+
+    if (fps_div == 1 && gop_sec == 1)
+        return;
+
+    switch (vencAttr->stRcAttr.enRcMode) {
+        case VENC_RC_MODE_H264CBR:
+            gop = &vencAttr->stRcAttr.stAttrH264Cbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH264Cbr.fr32DstFrmRate;
+            break;
+        case VENC_RC_MODE_H264VBR:
+            gop = &vencAttr->stRcAttr.stAttrH264Vbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH264Vbr.fr32DstFrmRate;
+            break;
+        case VENC_RC_MODE_H264AVBR:
+            gop = &vencAttr->stRcAttr.stAttrH264AVbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH264AVbr.fr32DstFrmRate;
+            break;
+        case VENC_RC_MODE_H265CBR:
+            gop = &vencAttr->stRcAttr.stAttrH265Cbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH265Cbr.fr32DstFrmRate;
+            break;
+        case VENC_RC_MODE_H265VBR:
+            gop = &vencAttr->stRcAttr.stAttrH265Vbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH265Vbr.fr32DstFrmRate;
+            break;
+        case VENC_RC_MODE_H265AVBR:
+            gop = &vencAttr->stRcAttr.stAttrH265AVbr.u32Gop;
+            dst_frmrate = &vencAttr->stRcAttr.stAttrH265AVbr.fr32DstFrmRate;
+            break;
+        default:
+            return;
+    }
+
+    HI_U32 framerate = stream_attr->framerate / fps_div;
+    if (framerate < 1)
+        framerate = 1;
+    *dst_frmrate = framerate;
+    *gop = framerate * gop_sec;
+    if (vencAttr->stGopAttr.enGopMode == VENC_GOPMODE_SMARTP) {
+        /*长期参考帧间隔必须是u32Gop的整数倍*/
+        HI_U32 bg = vencAttr->stGopAttr.stSmartP.u32BgInterval;
+        vencAttr->stGopAttr.stSmartP.u32BgInterval = (bg + *gop - 1) / *gop * *gop;
+    }
+}
+
+/*按通道当前的拥塞等级和encoder_set_rate_ctrl的设置填写码率控制属性*/
+static void set_chn_rc_attr(VENC_CHN_ATTR_S *vencAttr, ENC_CHN_CONTEX *chn_ctx, ENC_STREAM_ATTR *stream_attr)
+{
+    int level = chn_ctx->enc_level > chn_ctx->rc_level ? chn_ctx->enc_level : chn_ctx->rc_level;
+
+    set_venc_rc_attr(vencAttr, stream_attr, level);
+    set_venc_rc_override(vencAttr, chn_ctx, stream_attr);
+}
+
 static void set_vencAttr(ENC_STREAM_ATTR *stream_attr, int enc_level,
                          int width, int height, VENC_CHN_ATTR_S *vencAttr)
 {
@@ -553,6 +623,13 @@ ENC_STREAM_PACK *pack = spm_alloc(head_len + frame_data_len);
     if (pack == NULL)
         return NULL;
 
+    if (METRICS_FLAGS()) {
+        HLE_U32 pts_ms = (HLE_U32) (stream->pstPack->u64PTS / 1000);
+        METRICS_INC(MET_C_VENC_FRAMES);
+        METRICS_HIST(MET_H_VENC_MS, (HLE_U32) (metrics_now_us() / 1000) - pts_ms);
+        METRICS_TRACE(TRACE_VENC_GET, encChn, frame_hdr->type, pts_ms, frame_data_len);
+    }
+
     pack->channel = ENC_GET_VI_CHN(encChn);
     pack->stream_index = ENC_GET_STREAN_INDEX(encChn);
 
@@ -591,6 +668,8 @@ static ENC_STREAM_PACK *audio_stream_to_pack(int encChn, AUDIO_STREAM_S *stream)
     ENC_STREAM_PACK *pack = spm_alloc(sizeof (head_buf) + stream->u32Len);
     if (pack == NULL)
         return NULL;
+    METRICS_INC(MET_C_AENC_FRAMES);
+    METRICS_TRACE(TRACE_AENC_GET, encChn, 0xFA, (HLE_U32) aframe_info->pts_msec, stream->u32Len);
     pack->channel = ENC_GET_VI_CHN(encChn);
     pack->stream_index = ENC_GET_STREAN_INDEX(encChn);
 
@@ -1166,6 +1245,10 @@ static OSD_BITMAP_ATTR osd_attrs[VI_PORT_NUM][VI_OSD_NUM] = {
         {0}
     }
 };
+/*time/rate OSD 的画布（上一次绘制的字符串 + BMP位图，只重画有变化的字符），由 osd_lock 保护*/
+static OSD_canvas_t osd_canvas[VI_PORT_NUM][STREAMS_PER_CHN][VI_OSD_NUM];
+/*time/rate OSD 当前是否反色显示（背景太亮/太暗时前景色取反），由 osd_lock 保护*/
+static HLE_U8 osd_reverse[VI_PORT_NUM][STREAMS_PER_CHN][VI_OSD_NUM];
 
 /*本系统使用的BMP位图中：一个bit位代表一个像素点，8个像素点算一个字节*/
 #if !(USE_VECTOR_FONT)
@@ -1401,93 +1484,6 @@ static int get_encoder_size(int encChn, int *width, int *height)
     return get_image_size(enc_ctx.encChn[encChn].enc_attr.img_size, width, height);
 }
 
-#if 0
-int needWdr = 0;
-
-static void stat_luma(HI_U8* pY, VIDEO_FRAME_INFO_S* vfi)
-{
-    int sum[1920 / 64][1088 / 64]; //1920/64=30, 1088/64=17
-    memset(sum, 0, sizeof (sum));
-    int x, y, sx, sy;
-    for (x = 0; x < vfi->stVFrame.u32Width; x++) {
-        for (y = 0; y < vfi->stVFrame.u32Height; y++) {
-            sx = x / 64;
-            sy = y / 64;
-            sum[sx][sy] += *pY++;
-        }
-    }
-
-    int lvl[256 / 16];
-    memset(lvl, 0, sizeof (lvl));
-    for (sx = 0; sx < 1920 / 64; sx++) {
-        for (sy = 0; sy < 1088 / 64; sy++) {
-            lvl[sum[sx][sy] / (16 * 64 * 64)]++;
-        }
-    }
-
-    if ((lvl[0] + lvl[1] + lvl[2]) > 200) {
-        needWdr++;
-        if (needWdr > 10) needWdr = 10;
-    }
-    else {
-        needWdr--;
-        if (needWdr < 0) needWdr = 0;
-    }
-
-    /*
-                    for (x = 0; x < 256 / 16; ++x) {
-                                    printf("%d ", lvl[x]);
-                    }
-                    printf("--needWdr=%d\n", needWdr);
-    //*/
-}
-#endif
-
-#if 0
-
-static int need_reverse_osd(OSD_BITMAP_ATTR *osd_attr, VIDEO_FRAME_INFO_S* vfi, int idx, HI_U8* pY)
-{
-    if (pY) {
-        //printf("----------------------\npY=%p\n", pY);
-        //printf("%d, %d, %d, %d, %d, %d, %d\n%d, %d, %d, %d\n", vfi->stVFrame.u32Width, vfi->stVFrame.u32Height, vfi->stVFrame.u32Field, vfi->stVFrame.enPixelFormat, 
-        //  vfi->stVFrame.enVideoFormat, vfi->stVFrame.enCompressMode, vfi->stVFrame.u32Stride[0], vfi->stVFrame.s16OffsetTop, 
-        //  vfi->stVFrame.s16OffsetBottom, vfi->stVFrame.s16OffsetLeft, vfi->stVFrame.s16OffsetRight);
-        int enc_w = 1920;
-        int enc_h = 1080;
-        //get_encoder_size(VPSS_CHN_ENC0, &enc_w, &enc_h);
-        //int osd_w = (osd_attr->width * enc_w / 480) & (~1);
-        //int osd_h = (osd_attr->height * enc_h / 270) & (~1);
-        int osd_w = (osd_attr->width * 4) & (~1);
-        int osd_h = (osd_attr->height * 4) & (~1);
-        int x = osd_attr->x * enc_w / REL_COORD_WIDTH;
-        int y = osd_attr->y * enc_h / REL_COORD_HEIGHT;
-        if (x + osd_w > enc_w) {
-            x = enc_w - osd_w;
-            if (x < 0) x = 0;
-        }
-        if (y + osd_h > enc_h) {
-            y = enc_h - osd_h;
-            if (y < 0) y = 0;
-        }
-        int vix, viy;
-        vix = (idx % (osd_attr->width / 8)) * 8 * 4;
-        viy = 0;
-        int i, j;
-        HI_U32 luma = 0;
-        for (i = 0; i < 8 * 4; i++) {
-            for (j = 0; j < 16 * 4; j++) {
-                HI_U8* p = pY + (y + viy + vfi->stVFrame.s16OffsetTop + j) * vfi->stVFrame.u32Stride[0] + (x + vix + vfi->stVFrame.s16OffsetLeft + i);
-                //printf("p=%p\n", p);
-                luma += *p;
-            }
-        }
-        if (luma > 160 * 16 * 4 * 8 * 4) return 1;
-    }
-
-    return 0;
-}
-#endif
-
 #define RGB24_TO_RGB15(c) (HLE_U16)((((((c)>>16)&0xFF)>>3)<<10) | (((((c)>>8)&0xff)>>3)<<5) | (((c)&0XFF)>>3))
 
 /*
@@ -1498,51 +1494,99 @@ static int need_reverse_osd(OSD_BITMAP_ATTR *osd_attr, VIDEO_FRAME_INFO_S* vfi,
 */
 static void draw_bmp(OSD_BITMAP_ATTR *osd_attr, HLE_U16 *bitmap)
 {
-    HLE_U32 i, j;
-    
     //OSD BMP数据的总字节数
     int matrix_len = (osd_attr->width / 8) * osd_attr->height;
     //OSD 数据
     HLE_U8 *matrix = osd_attr->raster;
     HLE_U16 fg_color = RGB24_TO_RGB15(osd_attr->fg_color) | 0x8000;//第15位置1（RGB15，0 ~ 14，第15位空余）
     HLE_U16 bg_color = RGB24_TO_RGB15(osd_attr->bg_color);
-#if 0
-    HLE_U16 rv_color = (~RGB24_TO_RGB15(osd_attr->fg_color)) | 0x8000;
-    VIDEO_FRAME_INFO_S vfi;
-    HI_S32 ret = -1;
-    ret = HI_MPI_VI_GetFrame(VI_PHY_CHN, &vfi, 10);
-    HI_U8* pY = NULL;
-    int msz = vfi.stVFrame.u32Stride[0] * vfi.stVFrame.u32Height;
-    if (HI_SUCCESS == ret) {
-        pY = (HI_U8*) HI_MPI_SYS_Mmap(vfi.stVFrame.u32PhyAddr[0], msz);
-        //stat_luma(pY, &vfi);
-    }
-#endif
-    /*将点阵（1个像素 1 bit）数据，映射成BMP位图（1个像素 2 byte RGB555）数据*/
-    for (i = 0; i < matrix_len; i++) 
-    {
-        //HLE_U16 clr = need_reverse_osd(osd_attr, &vfi, i, pY) ? rv_color : fg_color;
-        for (j = 0; j < 8; j++) //一次处理1字节
-        {
-            if (*matrix & (0x01 << (7 - j))) //从7 ~ 0位依次判断是否为1
-            {
-                *(bitmap++) = fg_color; //为 1 则BMP数据对应该字节使用前景色
-            }
-            else {
-                *(bitmap++) = bg_color; //为 0 则BMP数据对应该字节使用背景色
-            }
-        }
+    /*将点阵（1个像素 1 bit）数据，映射成BMP位图（1个像素 2 byte RGB555）数据，查表一次处理 1 字节（8 个像素）*/
+    zk_expand_bits(bitmap, matrix, matrix_len, fg_color, bg_color);
+}
 
-        matrix++;
-    }
-#if 0
-    if (pY) {
-        HI_MPI_SYS_Munmap(pY, msz);
+/*
+功能：把 time/rate OSD 的字符串画到该编码通道的画布上（只重画有变化的字符），调用前需持有 osd_lock
+参数：
+    @channel, stream_index, osd_index : OSD 所在的通道/码流/类型
+    @str : 要显示的字符串
+    @enc_w, enc_h : 编码图像的宽高
+    @osd_attr : （入/返）OSD参数信息，返回时宽高修正为画布的宽高
+    @org_sfc : （返）画布的BMP数据描述，数据归画布所有，不需要 destroy_surface
+返回：
+    >0 ：重画的字符个数
+    0  ：与上次相同，BMP位图没有变化
+    -1 ：失败
+*/
+#define RGB24_LUMA(c)       ((77 * (((c) >> 16) & 0xFF) + 150 * (((c) >> 8) & 0xFF) + 29 * ((c) & 0xFF)) >> 8)
+#define OSD_REVERSE_ON      48  //前景色与背景的亮度差小于该值时反色
+#define OSD_REVERSE_OFF     80  //反色后，原前景色与背景的亮度差大于该值才恢复（迟滞，避免来回闪烁）
+
+/*
+功能：按 OSD 所在区域的背景亮度（亮度统计模块，每秒更新一次）选择前景色：前景色与背景太接近时反色
+参数：
+    @channel, stream_index, osd_index : OSD 所在的通道/码流/类型
+    @enc_w, enc_h : 编码图像的宽高
+    @osd_attr : OSD参数信息
+返回：实际使用的前景色（RGB24），还没有统计结果或画布大小未知时为原前景色
+*/
+static HLE_U32 osd_contrast_color(int channel, int stream_index, int osd_index,
+                                  int enc_w, int enc_h, const OSD_BITMAP_ATTR *osd_attr)
+{
+    OSD_canvas_t *canvas = &osd_canvas[channel][stream_index][osd_index];
+    HLE_U8 *reverse = &osd_reverse[channel][stream_index][osd_index];
+    HLE_U32 fg = osd_attr->fg_color;
+    HLE_U32 rv = (fg & 0xFF000000) | (~fg & 0xFFFFFF);
+
+    //画布大小在第一次绘制后才知道
+    if (canvas->width <= 0 || canvas->height <= 0)
+        return fg;
+
+    //与 osd_region_attach 的位置修正一致
+    int x = osd_attr->x * enc_w / REL_COORD_WIDTH;
+    int y = osd_attr->y * enc_h / REL_COORD_HEIGHT;
+    if (x + canvas->width > enc_w) {
+        x = enc_w - canvas->width;
+        if (x < 0) x = 0;
     }
-    if (!ret) {
-        HI_MPI_VI_ReleaseFrame(VI_PHY_CHN, &vfi);
+    if (y + canvas->height > enc_h) {
+        y = enc_h - canvas->height;
+        if (y < 0) y = 0;
     }
-#endif
+
+    int bg = luma_stat_region_mean(x, y, canvas->width, canvas->height, enc_w, enc_h);
+    if (bg < 0)
+        return *reverse ? rv : fg;
+
+    int diff = abs(RGB24_LUMA(fg) - bg);
+    if (!*reverse && diff < OSD_REVERSE_ON && abs(RGB24_LUMA(rv) - bg) > diff)
+        *reverse = 1;
+    else if (*reverse && diff > OSD_REVERSE_OFF)
+        *reverse = 0;
+
+    return *reverse ? rv : fg;
+}
+
+static int draw_text_osd(int channel, int stream_index, int osd_index, HLE_U8 *str,
+                         int enc_w, int enc_h, OSD_BITMAP_ATTR *osd_attr, HLE_SURFACE *org_sfc)
+{
+    OSD_canvas_t *canvas = &osd_canvas[channel][stream_index][osd_index];
+    HLE_U32 fg_rgb = osd_contrast_color(channel, stream_index, osd_index, enc_w, enc_h, osd_attr);
+    HLE_U16 fg_color = RGB24_TO_RGB15(fg_rgb) | 0x8000;//第15位置1（RGB15，0 ~ 14，第15位空余）
+    HLE_U16 bg_color = RGB24_TO_RGB15(osd_attr->bg_color);
+
+    int ret = zk_canvas_render(canvas, str, enc_w, enc_h, fg_color, bg_color);
+    if (ret < 0)
+        return -1;
+
+    /*---矢量字库宽高不是固定的值，按画布修正--------------*/
+    osd_attr->raster = NULL;
+    osd_attr->width = canvas->width;
+    osd_attr->height = canvas->height;
+
+    org_sfc->u32Width = canvas->width;
+    org_sfc->u32Height = canvas->height;
+    org_sfc->u32PhyAddr = (HLE_U32) canvas->bmp;
+    return ret;
 }
 
 static int get_jpeg_encoder_size(int *width, int *height)
@@ -1706,6 +1750,27 @@ static int change_osd_position(int encChn, RGN_HANDLE osd_handle, int enc_w,
 }
 
 
+/*把 org_sfc 缩放到 osd_w x osd_h 后设置到区域上，大小相同时直接使用 org_sfc 的数据*/
+static int set_osd_surface(RGN_HANDLE osd_handle, int osd_w, int osd_h, HLE_SURFACE *org_sfc)
+{
+    if (org_sfc->u32Width == osd_w && org_sfc->u32Height == osd_h)
+        return set_osd_bitmap(osd_handle, osd_w, osd_h, (void *) org_sfc->u32PhyAddr);
+
+    HLE_SURFACE new_sfc;
+    new_sfc.u32Width = osd_w;
+    new_sfc.u32Height = osd_h;
+    char *new_bmp = create_surface(&new_sfc);
+    if (new_bmp == NULL) {
+        ERROR_LOG("malloc new_bmp failed!\n");
+        return HLE_RET_ENORESOURCE;
+    }
+    scale_surface(&new_sfc, org_sfc);
+
+    int ret = set_osd_bitmap(osd_handle, osd_w, osd_h, new_bmp);
+    destroy_surface(&new_sfc, new_bmp);
+    return ret;
+}
+
 /*
 功能：
     配置单个OSD区域，enc_w和enc_h为所在编码通道编码图像的宽高
@@ -1751,23 +1816,11 @@ static int config_single_osd(int encChn, int osd_index, int enc_w, int enc_h,
         if (create_osd_region(osd_handle, osd_w, osd_h) != HLE_RET_OK)
             return HLE_RET_ERROR;
 
-        HLE_SURFACE new_sfc;
-        new_sfc.u32Width = osd_w;
-        new_sfc.u32Height = osd_h;
-        char *new_bmp = create_surface(&new_sfc);
-        if (new_bmp == NULL) {
-            ERROR_LOG("malloc new_bmp failed!\n");
-            return HLE_RET_ENORESOURCE;
-        }
-        scale_surface(&new_sfc, org_sfc);
-
-        if (set_osd_bitmap(osd_handle, osd_w, osd_h, new_bmp) != HLE_RET_OK) {
-            destroy_surface(&new_sfc, new_bmp);
-            return HLE_RET_ERROR;
-        }
+        int ret = set_osd_surface(osd_handle, osd_w, osd_h, org_sfc);
+        if (ret != HLE_RET_OK)
+            return ret;
 
         osd_region_attach(encChn, osd_index, enc_w, enc_h, osd_w, osd_h, osd_attr);
-        destroy_surface(&new_sfc, new_bmp);
     }
     else if (rgn_attr.unAttr.stOverlay.stSize.u32Width != osd_w
          || rgn_attr.unAttr.stOverlay.stSize.u32Height != osd_h) {
@@ -1776,38 +1829,15 @@ static int config_single_osd(int encChn, int osd_index, int enc_w, int enc_h,
         if (create_osd_region(osd_handle, osd_w, osd_h) != HLE_RET_OK)
             return HLE_RET_ERROR;
 
-        HLE_SURFACE new_sfc;
-        new_sfc.u32Width = osd_w;
-        new_sfc.u32Height = osd_h;
-        char *new_bmp = create_surface(&new_sfc);
-        if (new_bmp == NULL) {
-            ERROR_LOG("malloc new_bmp failed!\n");
-            return HLE_RET_ENORESOURCE;
-        }
-        scale_surface(&new_sfc, org_sfc);
-
-        if (set_osd_bitmap(osd_handle, osd_w, osd_h, new_bmp) != HLE_RET_OK) {
-            destroy_surface(&new_sfc, new_bmp);
-            return HLE_RET_ERROR;
-        }
+        int ret = set_osd_surface(osd_handle, osd_w, osd_h, org_sfc);
+        if (ret != HLE_RET_OK)
+            return ret;
 
         osd_region_attach(encChn, osd_index, enc_w, enc_h, osd_w, osd_h, osd_attr);
-        destroy_surface(&new_sfc, new_bmp);
     }
     else {
-        HLE_SURFACE new_sfc;
-        new_sfc.u32Width = osd_w;
-        new_sfc.u32Height = osd_h;
-        char *new_bmp = create_surface(&new_sfc);
-        if (new_bmp == NULL) {
-            ERROR_LOG("malloc new_bmp failed!\n");
-            return HLE_RET_ENORESOURCE;
-        }
-        scale_surface(&new_sfc, org_sfc);
-
-        set_osd_bitmap(osd_handle, osd_w, osd_h, new_bmp);
+        set_osd_surface(osd_handle, osd_w, osd_h, org_sfc);
         change_osd_position(encChn, osd_handle, enc_w, enc_h, osd_w, osd_h, osd_attr);
-        destroy_surface(&new_sfc, new_bmp);
     }
 
     return HLE_RET_OK;
@@ -1885,7 +1915,6 @@ static void* time_osd_proc(void *arg)
     DEBUG_LOG("pid = %d\n", getpid());
     prctl(PR_SET_NAME, "hal_timeosd", 0, 0, 0);
 
-    char *org_bmp;
     HLE_SURFACE org_sfc;
         
     sleep(2);
@@ -1931,37 +1960,17 @@ static void* time_osd_proc(void *arg)
                 }
                     
 
-                OSD_matrix_info_t ret_info = {0};
-                if(str2matrix_vector(time_str, &ret_info,enc_w,enc_h) < 0)
+                /*一般只有秒位变化，只重画变化的字符；完全没变化则不更新区域*/
+                int ret = draw_text_osd(i, j, TIME_OSD_INDEX, time_str, enc_w, enc_h, osd_attr, &org_sfc);
+                if (ret < 0)
                 {
-                    ERROR_LOG("call str2matrix_vector error !\n");
+                    ERROR_LOG("draw_text_osd error !\n");
                     continue;
                 }
-                
-                /*修正宽高度参数，矢量字体宽高度不是固定的值，需要动态获取*/
-                osd_attr->raster = ret_info.matrix_data;
-                osd_attr->width = ret_info.width;
-                osd_attr->height = ret_info.height;
-               // DEBUG_LOG(" osd_attr->width(%d) osd_attr->height(%d)\n", osd_attr->width,osd_attr->height);
-
-                /*---创建新的 surface ，即BMP图片数据缓存空间------*/
-                org_sfc.u32Width = osd_attr->width;
-                org_sfc.u32Height = osd_attr->height;
-                
-                org_bmp = create_surface(&org_sfc);
-                if (org_bmp == NULL) 
-                {
-                    ERROR_LOG("create_surface org_bmp failed!\n");
-                    free(ret_info.matrix_data);
+                if (ret == 0)
                     continue;
-                }
-                
-                draw_bmp(osd_attr, (HLE_U16 *) org_bmp);
-                
-                config_single_osd(encChn, 0, enc_w, enc_h, osd_attr, &org_sfc);
-                
-                free(ret_info.matrix_data);
-                destroy_surface(&org_sfc, org_bmp);
+
+                config_single_osd(encChn, TIME_OSD_INDEX, enc_w, enc_h, osd_attr, &org_sfc);
             }
             
             pthread_mutex_unlock(osd_lock + i);
@@ -1987,7 +1996,6 @@ static void* rate_osd_proc(void *arg)
     DEBUG_LOG("pid = %d\n", getpid());
     prctl(PR_SET_NAME, "hal_rateosd", 0, 0, 0);
 
-    char *org_bmp;
     HLE_SURFACE org_sfc;
 
     sleep(2);
@@ -2025,35 +2033,17 @@ static void* rate_osd_proc(void *arg)
                 HLE_U8 frame_str[RATE_OSD_STR_LEN];
                 get_frame_str(i, j, (char *) frame_str);
                 
-                OSD_matrix_info_t ret_info = {0};
-                if(str2matrix_vector(frame_str, &ret_info,enc_w,enc_h) < 0)
+                /*码率没有变化时不更新区域*/
+                int ret = draw_text_osd(i, j, RATE_OSD_INDEX, frame_str, enc_w, enc_h, osd_attr, &org_sfc);
+                if (ret < 0)
                 {
-                    ERROR_LOG("call str2matrix_vector error !\n");
-                    continue;
-                } 
-                
-                /*修正宽高度参数，矢量字体宽高度不是固定的值，需要动态获取*/
-                osd_attr->raster = ret_info.matrix_data;
-                osd_attr->width = ret_info.width;
-                osd_attr->height = ret_info.height;
-
-                /*---创建新的 surface ，即BMP图片数据缓存空间------*/
-                org_sfc.u32Width = osd_attr->width;
-                org_sfc.u32Height = osd_attr->height;
-                org_bmp = create_surface(&org_sfc);
-                if (org_bmp == NULL) 
-                {
-                    ERROR_LOG("create_surface org_bmp failed!\n");
-                    free(ret_info.matrix_data);
+                    ERROR_LOG("draw_text_osd error !\n");
                     continue;
                 }
-                
-                draw_bmp(osd_attr, (HLE_U16 *) org_bmp);
+                if (ret == 0)
+                    continue;
 
                 config_single_osd(encChn, RATE_OSD_INDEX, enc_w, enc_h, osd_attr, &org_sfc);
-                
-                free(ret_info.matrix_data);
-                destroy_surface(&org_sfc, org_bmp);
             }
             pthread_mutex_unlock(osd_lock + i);
         }
@@ -2081,10 +2071,8 @@ static int config_osd_region(int channel, int osd_index, OSD_BITMAP_ATTR *osd_at
         return -1;
     }
 
-    char *org_bmp;
     HLE_SURFACE org_sfc;
     int i , enc_w , enc_h;
-    OSD_matrix_info_t  ret_info = {0};
     
     for (i = 0; i < STREAMS_PER_CHN; i++) 
     {
@@ -2100,62 +2088,26 @@ static int config_osd_region(int channel, int osd_index, OSD_BITMAP_ATTR *osd_at
             HLE_U8 time_str[TIME_OSD_STR_LEN];
             get_date_string((char *) time_str);
             
-            if(str2matrix_vector(time_str, &ret_info,enc_w,enc_h) < 0)
+            if(draw_text_osd(channel, i, osd_index, time_str, enc_w, enc_h, osd_attr, &org_sfc) < 0)
             {
-                ERROR_LOG("call str2matrix_vector failed!\n");
-                continue;
-            }
-            //DEBUG_LOG("time_str:%s  ret_info.width(%d) ret_info.height(%d)\n",time_str,ret_info.width,ret_info.height);
-            /*---矢量字库需要对宽高进行动态修正--------------*/
-            org_sfc.u32Width = ret_info.width;
-            org_sfc.u32Height = ret_info.height;
-            org_bmp = create_surface(&org_sfc);
-            if (org_bmp == NULL) 
-            {
-                ERROR_LOG("create_surface org_bmp failed!\n");
-                free(ret_info.matrix_data);
+                ERROR_LOG("call draw_text_osd failed!\n");
                 continue;
             }
-            osd_attr->raster = ret_info.matrix_data;
-            osd_attr->width =  org_sfc.u32Width;
-            osd_attr->height =  org_sfc.u32Height;
-            
-            draw_bmp(osd_attr, (HLE_U16 *) org_bmp);
-            
-
         }
         else if (osd_index == RATE_OSD_INDEX) 
         {
             HLE_U8 frame_str[RATE_OSD_STR_LEN];
             get_frame_str(channel, i, (char *) frame_str);
             
-            if(str2matrix_vector(frame_str, &ret_info,enc_w,enc_h) < 0)
+            if(draw_text_osd(channel, i, osd_index, frame_str, enc_w, enc_h, osd_attr, &org_sfc) < 0)
             {
-                ERROR_LOG("call str2matrix_vector failed!\n");
+                ERROR_LOG("call draw_text_osd failed!\n");
                 continue;
             }
-            
-            /*---矢量字库需要对宽高进行动态修正--------------*/
-            org_sfc.u32Width = ret_info.width;
-            org_sfc.u32Height = ret_info.height;
-            org_bmp = create_surface(&org_sfc);
-            if (org_bmp == NULL) 
-            {
-                ERROR_LOG("create_surface org_bmp failed!\n");
-                free(ret_info.matrix_data);
-                continue;
-            }
-            osd_attr->raster = ret_info.matrix_data;
-            osd_attr->width =  org_sfc.u32Width;
-            osd_attr->height =  org_sfc.u32Height;
-            draw_bmp(osd_attr, (HLE_U16 *) org_bmp);
-            
         }
 
+        /*参数（位置、颜色、使能）可能变了，不管位图有没有变化都重新配置区域*/
         config_single_osd(encChn, osd_index, enc_w, enc_h, osd_attr, &org_sfc);
-        
-        free(ret_info.matrix_data);
-        destroy_surface(&org_sfc, org_bmp);
     }
     
     return HLE_RET_OK;
@@ -2479,8 +2431,13 @@ static int __encoder_start(int channel, int stream_index,
         return HLE_RET_ERROR;
     }
 
+    ENC_CHN_CONTEX *chn_ctx = enc_ctx.encChn + encChn;
+    if (enc_level < chn_ctx->rc_level)
+        enc_level = chn_ctx->rc_level;
+
     VENC_CHN_ATTR_S vencAttr;
     set_vencAttr(stream_attr, enc_level, width, height, &vencAttr);
+    set_venc_rc_override(&vencAttr, chn_ctx, stream_attr);
 
     printf("\n create encChn = %d \n",encChn);
     ret = HI_MPI_VENC_CreateChn(encChn, &vencAttr);
@@ -2768,7 +2725,7 @@ int encoder_config(int channel, int stream_index, ENC_STREAM_ATTR *stream_attr)
     else
         set_h264_avbr_attr(&vencAttr, stream_attr, chn_ctx->enc_level);
 #endif
-    set_venc_rc_attr(&vencAttr, stream_attr, chn_ctx->enc_level);
+    set_chn_rc_attr(&vencAttr, chn_ctx, stream_attr);
     ret = HI_MPI_VENC_SetChnAttr(encChn, &vencAttr);
     if (ret != HI_SUCCESS) {
         pthread_mutex_unlock(osd_lock + channel);
@@ -2847,7 +2804,7 @@ int encoder_set_enc_level(int channel, int stream_index, int level)
         else
             set_h264_vbr_attr(&vencAttr, &chn_ctx->enc_attr, chn_ctx->enc_level);
 #endif
-        set_venc_rc_attr(&vencAttr, &chn_ctx->enc_attr, chn_ctx->enc_level);
+        set_chn_rc_attr(&vencAttr, chn_ctx, &chn_ctx->enc_attr);
         int ret = HI_MPI_VENC_SetChnAttr(encChn, &vencAttr);
         if (ret != HI_SUCCESS) {
             pthread_mutex_unlock(&chn_ctx->lock);
@@ -2862,6 +2819,48 @@ int encoder_set_enc_level(int channel, int stream_index, int level)
     return HLE_RET_OK;
 }
 
+int encoder_set_rate_ctrl(int channel, int stream_index, int level, int fps_div, int gop_sec)
+{
+    if (channel < 0 || channel >= VI_PORT_NUM || stream_index < 0
+        || stream_index >= STREAMS_PER_CHN || level < 0 || level >= MAX_BLOCK_LEVEL
+        || fps_div < 1 || gop_sec < 1) {
+        ERROR_LOG("invalid para!\n");
+        return HLE_RET_EINVAL;
+    }
+
+    int encChn = GET_ENC_CHN(channel, stream_index);
+    ENC_CHN_CONTEX *chn_ctx = enc_ctx.encChn + encChn;
+
+    pthread_mutex_lock(&chn_ctx->lock);
+    if (chn_ctx->rc_level == level && chn_ctx->rc_fps_div == fps_div && chn_ctx->rc_gop_sec == gop_sec) {
+        pthread_mutex_unlock(&chn_ctx->lock);
+        return HLE_RET_OK;
+    }
+    chn_ctx->rc_level = level;
+    chn_ctx->rc_fps_div = fps_div;
+    chn_ctx->rc_gop_sec = gop_sec;
+    if (chn_ctx->state != ENC_STATE_RUNING) {
+        //编码通道还没启动，encoder_start时生效
+        pthread_mutex_unlock(&chn_ctx->lock);
+        return HLE_RET_OK;
+    }
+
+    VENC_CHN_ATTR_S vencAttr;
+    HI_MPI_VENC_GetChnAttr(encChn, &vencAttr);
+    set_chn_rc_attr(&vencAttr, chn_ctx, &chn_ctx->enc_attr);
+    int ret = HI_MPI_VENC_SetChnAttr(encChn, &vencAttr);
+    if (ret != HI_SUCCESS) {
+        pthread_mutex_unlock(&chn_ctx->lock);
+        ERROR_LOG("HI_MPI_VENC_SetChnAttr (%d) fail: %#x\n", encChn, ret);
+        return HLE_RET_ERROR;
+    }
+
+    DEBUG_LOG("encoder_set_rate_ctrl chn[%d], index[%d], level[%d], fps_div[%d], gop_sec[%d] success\n",
+              channel, stream_index, level, fps_div, gop_sec);
+    pthread_mutex_unlock(&chn_ctx->lock);
+    return HLE_RET_OK;
+}
+
 int encoder_request_stream(int channel, int stream_index, int auto_rc)
 {
     if (channel < 0 || channel >= VI_PORT_NUM || stream_index < 0
@@ -2885,6 +2884,16 @@ ENC_STREAM_PACK *encoder_get_packet(int stream_id)
     return sdp_dequeue(stream_id);
 }
 
+ENC_STREAM_PACK *encoder_try_get_packet(int stream_id)
+{
+    return sdp_try_dequeue(stream_id);
+}
+
+int encoder_set_packet_notify(int stream_id, void (*notify)(void *arg), void *arg)
+{
+    return sdp_set_notify(stream_id, notify, arg);
+}
+
 int encoder_release_packet(ENC_STREAM_PACK *pack)
 {
     return spm_dec_pack_ref(pack);
@@ -3053,7 +3062,7 @@ int save_jpeg_to_file(char *data, int len)
 
 
 /*
-功能 ：请求一张JPEG图片
+功能 ：编码一张JPEG图片（配置并启动JPEG通道，取一帧后停止），由 jpeg_cache 调用
 参数 ：
     @channel ：通道号(VI物理通道，0)
     @size ：返回图像数据的大小
@@ -3062,7 +3071,7 @@ int save_jpeg_to_file(char *data, int len)
     成功 ：JPEG图像的数据指针
     失败：NULL
 */
-char *encoder_request_jpeg(int channel, int *size, int image_size)
+static char *encoder_encode_jpeg(int channel, int *size, int image_size)
 {
     if (channel < 0 || channel >= VI_PORT_NUM || size == NULL) 
     {
@@ -3220,6 +3229,26 @@ STOP_ENCODER_JPEG:
     return jpeg_data;
 }
 
+/*
+功能 ：请求一张JPEG图片（JPEG_CACHE_MAX_AGE_MS 内抓拍过的直接返回缓存，并发请求合并为一次编码）
+参数 ：
+    @channel ：通道号(VI物理通道，0)
+    @size ：返回图像数据的大小
+    @image_size : 要求抓拍的图像大小
+返回：
+    成功 ：JPEG图像的数据指针
+    失败：NULL
+*/
+char *encoder_request_jpeg(int channel, int *size, int image_size)
+{
+    return jpeg_cache_request(channel, image_size, JPEG_CACHE_MAX_AGE_MS, size, NULL);
+}
+
+char *encoder_request_jpeg_ex(int channel, int *size, int image_size, int max_age_ms, HLE_U64 *time_ms)
+{
+    return jpeg_cache_request(channel, image_size, max_age_ms, size, time_ms);
+}
+
 void encoder_free_jpeg(char *jpeg_data)
 {
     free(jpeg_data);
@@ -3278,6 +3307,7 @@ int hal_encoder_init(HLE_S32 pack_count)
         pthread_mutex_init(roi_lock + i, NULL);
     }
 
+    jpeg_cache_init(encoder_encode_jpeg);
     enc_ctx.running = 1;
     
    
@@ -3346,11 +3376,16 @@ void hal_encoder_exit(void)
 
         pthread_mutex_destroy(&jpeg_enc_lock);
 
+        for (j = 0; j < STREAMS_PER_CHN; j++) {
+            int k;
+            for (k = 0; k < VI_OSD_NUM; k++)
+                zk_canvas_release(&osd_canvas[i][j][k]);
+        }
         pthread_mutex_destroy(osd_lock + i);
         pthread_mutex_destroy(roi_lock + i);
     }
 
-    
+    jpeg_cache_exit();
 }
 
 
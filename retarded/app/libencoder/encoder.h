@@ -308,6 +308,21 @@ int encoder_resume(void);
 int encoder_force_iframe(int channel, int stream_index);
 
 #define MAX_BLOCK_LEVEL     6       /*拥塞等级*/
+
+/*
+    function:  encoder_set_rate_ctrl
+    description:  外部码率控制接口（实时流ABR），与码流队列的自动码率控制叠加，拥塞等级取两者较大者
+    args:
+        int channel[in]，通道号
+        int stream_index[in]，码流索引，0为主码流，1为第二码流，2为第三码流
+        int level[in]，拥塞等级[0, MAX_BLOCK_LEVEL)，码率 = 设置码率 * (MAX_BLOCK_LEVEL - level) / MAX_BLOCK_LEVEL
+        int fps_div[in]，帧率除数，帧率 = 设置帧率 / fps_div，1为不降帧率
+        int gop_sec[in]，GOP时长（秒）
+    return:
+        0, 成功
+        <0, 失败，返回值为错误码，具体见错误码定义
+ */
+int encoder_set_rate_ctrl(int channel, int stream_index, int level, int fps_div, int gop_sec);
 /*
     function:  encoder_request_stream
     description: 请求码流接口，请求成功后可通过stream_get_packet来获取码流包
@@ -358,6 +373,30 @@ int encoder_if_have_audio(int stream_id,char have_audio);
  */
 ENC_STREAM_PACK *encoder_get_packet(int stream_id);
 
+/*
+    function:  encoder_try_get_packet
+    description:  获取编码数据包接口（不阻塞），队列为空时立即返回
+    args:
+        int stream_id[in]，encoder_request_stream返回的码流编号
+    return:
+        non-NULL, 成功，返回ENC_STREAM_PACK指针
+        NULL, 队列为空或者失败
+ */
+ENC_STREAM_PACK *encoder_try_get_packet(int stream_id);
+
+/*
+    function:  encoder_set_packet_notify
+    description:  设置码流队列由空变为非空时的回调，用于一个线程事件驱动地服务多路码流
+    args:
+        int stream_id[in]，encoder_request_stream返回的码流编号
+        void (*notify)(void *arg)[in]，回调函数，在编码线程中调用，不能阻塞；NULL取消
+        void *arg[in]，回调参数
+    return:
+        0, 成功
+        <0, 失败
+ */
+int encoder_set_packet_notify(int stream_id, void (*notify)(void *arg), void *arg);
+
 
 
 /*
@@ -404,9 +443,26 @@ int encoder_config_jpeg(int channel, ENC_JPEG_ATTR *jpeg_attr);
     return:
         =NULL, 请求JPEG 失败
         !=NULL, 请求的JPEG数据的地址
+    attention:
+        JPEG_CACHE_MAX_AGE_MS（jpeg_cache.h）内抓拍过的直接返回缓存的拷贝，同时到达的请求只编码一次
  */
 char *encoder_request_jpeg(int channel, int *size, int image_size);
 
+/*
+    function:  encoder_request_jpeg_ex
+    description: 请求JPEG 数据接口，指定可接受的缓存时间
+    args:
+        int channel[in]，通道号
+        int *size[out]，获取的JPEG 数据的大小
+        int image_size[in]，分辨率，见 E_IMAGE_SIZE
+        int max_age_ms[in]，可接受的缓存图片的最长时间(ms)，0 表示重新抓拍（仍会合并到正在进行的抓拍）
+        HLE_U64 *time_ms[out]，抓拍时间（UTC 毫秒），可以为 NULL
+    return:
+        =NULL, 请求JPEG 失败
+        !=NULL, 请求的JPEG数据的地址，用 encoder_free_jpeg 释放
+ */
+char *encoder_request_jpeg_ex(int channel, int *size, int image_size, int max_age_ms, HLE_U64 *time_ms);
+
 /*
     function:  encoder_free_jpeg
     description: 释放JPEG 数据接口
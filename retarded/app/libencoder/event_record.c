@@ -0,0 +1,798 @@
+
+/*******************************************************************************
+*@ Description    :MD 告警录像（预录 + 连续切片）
+                    1.取帧线程：从码流分发队列取帧，拷贝到预录环形缓存，按 GOP 淘汰最旧的帧，
+                      保证缓存从关键帧开始且覆盖 EVENT_RECORD_PREROLL_MS。
+                    2.切片线程：告警时读指针 rd 指向预录窗口内的关键帧，之后依次把 rd 处的帧交给复用器；
+                      录像期间缓存不淘汰 rd 之后的帧，复用/上传慢时由环形缓存吸收，不影响取帧。
+                    3.到达切片时长后在第一个关键帧处切片：有新的告警就从该关键帧开始下一个切片，
+                      否则录像结束。
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*@ attention      :主机测试见 test/test_event_record.c
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "typeport.h"
+#include "encoder.h"
+#include "amazon_S3.h"
+#include "amazon_upload.h"
+#include "event_record.h"
+#include "fmp4_interface.h"
+#include "ts_interface.h"
+
+#define EVREC_FRAME_I       0xF8
+#define EVREC_FRAME_P       0xF9
+#define EVREC_FRAME_A       0xFA
+#define EVREC_FRAME(idx)    (&evrec_ctx.frame[(idx) & (EVENT_RECORD_FRAME_MAX - 1)])
+
+typedef struct _evrec_ctx_t
+{
+    /*---预录环形缓存（mut 保护索引，帧数据在 head 发布后只读）---*/
+    unsigned char*      pool;
+    unsigned int        pool_w;             //下一帧数据的写入偏移
+    evrec_frame_t       frame[EVENT_RECORD_FRAME_MAX];
+    unsigned int        head;               //下一帧的写入位置（帧计数）
+    unsigned int        tail;               //最早的一帧
+    unsigned int        rd;                 //录像中：下一个要写入切片的帧
+    unsigned long long  last_vpts;          //最新视频帧的 pts
+    unsigned int        seq;                //输入帧序号
+    unsigned int        drop_cnt;           //录像中缓存满被丢弃的帧数
+    int                 wait_key;           //丢过帧，等下一个关键帧再继续缓存
+    volatile int        recording;          //录像中
+    volatile int        trigger;            //未处理的告警
+    pthread_mutex_t     mut;
+    pthread_cond_t      cnd;
+
+    /*---当前切片（只在切片线程中访问）---*/
+    unsigned int        clip_no;            //本次录像的第几个切片
+    unsigned int        clip_first;         //切片第一帧在缓存中的位置
+    unsigned long long  clip_start;         //切片第一帧 pts
+    unsigned long long  clip_end;           //到达该 pts 后的第一个关键帧处切片
+    unsigned long long  clip_last;          //切片最后一个视频帧 pts
+    int                 clip_open;          //切片已打开
+    int                 more;               //当前切片录制期间又有告警
+    int                 cut_request;        //复用器缓存快满，尽快切片
+    const evrec_sink_t* sink;
+
+    /*---线程---*/
+    volatile int        running;
+    int                 stream_id;
+    pthread_t           input_tid;
+    pthread_t           clip_tid;
+}evrec_ctx_t;
+
+static evrec_ctx_t evrec_ctx = {0};
+
+
+/*******************************************************************************
+*@ Description    :初始化预录缓存
+*@ Input          :<sink>切片输出接口
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+static int evrec_init(const evrec_sink_t *sink)
+{
+    memset(&evrec_ctx, 0, sizeof(evrec_ctx));
+    evrec_ctx.pool = (unsigned char*)malloc(EVENT_RECORD_POOL_SIZE);
+    if(NULL == evrec_ctx.pool)
+    {
+        ERROR_LOG("malloc event record pool failed!\n");
+        return -1;
+    }
+    evrec_ctx.sink = sink;
+    evrec_ctx.stream_id = -1;
+    evrec_ctx.wait_key = 1;
+    pthread_mutex_init(&evrec_ctx.mut, NULL);
+    pthread_cond_init(&evrec_ctx.cnd, NULL);
+    return 0;
+}
+
+static void evrec_deinit(void)
+{
+    pthread_mutex_destroy(&evrec_ctx.mut);
+    pthread_cond_destroy(&evrec_ctx.cnd);
+    free(evrec_ctx.pool);
+    evrec_ctx.pool = NULL;
+}
+
+/*找 from（不含）之后的第一个关键帧，没有返回 head*/
+static unsigned int evrec_next_key(unsigned int from)
+{
+    unsigned int i;
+    for(i = from + 1; i != evrec_ctx.head; i++)
+    {
+        if(EVREC_FRAME_I == EVREC_FRAME(i)->type)
+            break;
+    }
+    return i;
+}
+
+/*******************************************************************************
+*@ Description    :淘汰最旧的一个 GOP（以及它前面不成 GOP 的帧）
+*@ Input          :<force>1：缓存空间不足，只有一个 GOP 时也淘汰
+*@ Output         :
+*@ Return         :淘汰了返回 1，不能淘汰返回 0
+*@ attention      :调用者持有 mut；录像中不淘汰 rd 及之后的帧
+*******************************************************************************/
+static int evrec_drop_gop(int force)
+{
+    if(evrec_ctx.tail == evrec_ctx.head)
+        return 0;
+
+    unsigned int next = evrec_next_key(evrec_ctx.tail);
+    if(next == evrec_ctx.head && !force)
+        return 0;
+    if(evrec_ctx.recording && (int)(next - evrec_ctx.rd) > 0)
+        return 0;
+
+    evrec_ctx.tail = next;
+    if(evrec_ctx.tail == evrec_ctx.head)
+    {
+        evrec_ctx.pool_w = 0;
+        evrec_ctx.wait_key = 1;  //缓存清空，从下一个关键帧重新开始
+    }
+    return 1;
+}
+
+/*******************************************************************************
+*@ Description    :在预录缓存中分配 len 字节（连续），空间不足时淘汰最旧的 GOP
+*@ Input          :<len>帧数据长度
+*@ Output         :
+*@ Return         :成功：偏移 ； 失败：-1
+*@ attention      :调用者持有 mut
+*******************************************************************************/
+static int evrec_alloc(unsigned int len)
+{
+    if(len >= EVENT_RECORD_POOL_SIZE)
+        return -1;
+
+    for(;;)
+    {
+        if(evrec_ctx.head - evrec_ctx.tail < EVENT_RECORD_FRAME_MAX)
+        {
+            if(evrec_ctx.tail == evrec_ctx.head)
+                return 0;
+
+            unsigned int oldest = EVREC_FRAME(evrec_ctx.tail)->off;
+            if(evrec_ctx.pool_w >= oldest) //空闲区：[pool_w, SIZE) + [0, oldest)
+            {
+                if(EVENT_RECORD_POOL_SIZE - evrec_ctx.pool_w >= len)
+                    return evrec_ctx.pool_w;
+                if(oldest > len)
+                    return 0;
+            }
+            else if(oldest - evrec_ctx.pool_w > len) //空闲区：[pool_w, oldest)
+            {
+                return evrec_ctx.pool_w;
+            }
+        }
+
+        if(!evrec_drop_gop(1))
+            return -1;
+    }
+}
+
+/*******************************************************************************
+*@ Description    :输入一帧（取帧线程）
+*@ Input          :<type>帧类型 <pts>毫秒时间戳 <data><len>帧数据
+*@ Output         :
+*@ Return         :成功：0 ； 缓存满丢弃：-1
+*@ attention      :
+*******************************************************************************/
+static int evrec_push(unsigned char type, unsigned long long pts, const unsigned char *data, unsigned int len)
+{
+    unsigned int seq = evrec_ctx.seq++;
+
+    pthread_mutex_lock(&evrec_ctx.mut);
+    if(evrec_ctx.wait_key)
+    {
+        if(EVREC_FRAME_I != type)
+        {
+            pthread_mutex_unlock(&evrec_ctx.mut);
+            return -1;
+        }
+        evrec_ctx.wait_key = 0;
+    }
+
+    int off = evrec_alloc(len);
+    if(off < 0)
+    {
+        /*录像中切片线程跟不上（或帧太大），丢到下一个关键帧*/
+        evrec_ctx.wait_key = 1;
+        evrec_ctx.drop_cnt ++;
+        pthread_mutex_unlock(&evrec_ctx.mut);
+        ERROR_LOG("event record pool full, drop frame seq(%u) total(%u)\n", seq, evrec_ctx.drop_cnt);
+        return -1;
+    }
+    if(evrec_ctx.wait_key && EVREC_FRAME_I != type)  //为这一帧腾空间时缓存被清空了
+    {
+        pthread_mutex_unlock(&evrec_ctx.mut);
+        return -1;
+    }
+    evrec_ctx.wait_key = 0;
+    pthread_mutex_unlock(&evrec_ctx.mut);
+
+    /*[off, off+len) 已从空闲区分配，切片线程在 head 更新前看不到这一帧，拷贝不用加锁*/
+    memcpy(evrec_ctx.pool + off, data, len);
+
+    pthread_mutex_lock(&evrec_ctx.mut);
+    evrec_frame_t *f = EVREC_FRAME(evrec_ctx.head);
+    f->type = type;
+    f->len = len;
+    f->off = off;
+    f->seq = seq;
+    f->pts = pts;
+    evrec_ctx.pool_w = off + len;
+    evrec_ctx.head ++;
+    if(EVREC_FRAME_A != type)
+        evrec_ctx.last_vpts = pts;
+
+    /*预录窗口：第二个 GOP 已经覆盖预录时长时淘汰第一个 GOP*/
+    for(;;)
+    {
+        unsigned int next = evrec_next_key(evrec_ctx.tail);
+        if(next == evrec_ctx.head || evrec_ctx.last_vpts - EVREC_FRAME(next)->pts < EVENT_RECORD_PREROLL_MS)
+            break;
+        if(!evrec_drop_gop(0))
+            break;
+    }
+    pthread_cond_signal(&evrec_ctx.cnd);
+    pthread_mutex_unlock(&evrec_ctx.mut);
+
+    return 0;
+}
+
+/*******************************************************************************
+*@ Description    :处理告警：空闲时从预录窗口内的关键帧开始录像，录像中则标记继续
+*@ Input          :
+*@ Output         :
+*@ Return         :已处理：0 ； 缓存中还没有关键帧（稍后再处理）：-1
+*@ attention      :调用者持有 mut（切片线程）
+*******************************************************************************/
+static int evrec_on_trigger(void)
+{
+    if(evrec_ctx.recording)
+    {
+        evrec_ctx.more = 1;
+        return 0;
+    }
+
+    /*最后一个早于“最新帧 - 预录时长”的关键帧；缓存不足预录时长时取最早的关键帧*/
+    unsigned int i, start = evrec_ctx.head;
+    for(i = evrec_ctx.tail; i != evrec_ctx.head; i++)
+    {
+        evrec_frame_t *f = EVREC_FRAME(i);
+        if(EVREC_FRAME_I != f->type)
+            continue;
+        if(start == evrec_ctx.head || evrec_ctx.last_vpts - f->pts >= EVENT_RECORD_PREROLL_MS)
+            start = i;
+        else
+            break;
+    }
+    if(start == evrec_ctx.head)
+        return -1;
+
+    evrec_ctx.recording = 1;
+    evrec_ctx.rd = start;
+    evrec_ctx.clip_no = 0;
+    evrec_ctx.clip_open = 0;
+    evrec_ctx.more = 0;
+    evrec_ctx.cut_request = 0;
+    evrec_ctx.clip_end = evrec_ctx.last_vpts + EVENT_RECORD_CLIP_MS;
+    DEBUG_LOG("event record start, preroll %llu ms\n", evrec_ctx.last_vpts - EVREC_FRAME(start)->pts);
+    return 0;
+}
+
+/*结束当前切片：切片首尾时长按视频帧计算*/
+static void evrec_close_clip(int last, int abort)
+{
+    int flag;
+    if(!evrec_ctx.clip_open)
+        return;
+
+    if(last)
+        flag = (1 == evrec_ctx.clip_no) ? TS_FLAG_ONE : TS_FLAG_END;
+    else
+        flag = (1 == evrec_ctx.clip_no) ? TS_FLAG_START : TS_FLAG_MID;
+    evrec_ctx.sink->close(evrec_ctx.sink->arg, flag,
+                          (unsigned int)(evrec_ctx.clip_last - evrec_ctx.clip_start), abort);
+    evrec_ctx.clip_open = 0;
+}
+
+static int evrec_open_clip(const evrec_frame_t *key, unsigned int idx)
+{
+    evrec_ctx.clip_no ++;
+    evrec_ctx.clip_first = idx;
+    evrec_ctx.clip_start = key->pts;
+    evrec_ctx.clip_last = key->pts;
+    evrec_ctx.cut_request = 0;
+    if(evrec_ctx.sink->open(evrec_ctx.sink->arg, key, evrec_ctx.pool + key->off) < 0)
+    {
+        ERROR_LOG("event record open clip(%u) failed!\n", evrec_ctx.clip_no);
+        return -1;
+    }
+    evrec_ctx.clip_open = 1;
+    return 0;
+}
+
+/*******************************************************************************
+*@ Description    :处理告警并把 rd 之后的帧写入切片（切片线程）
+*@ Input          :
+*@ Output         :
+*@ Return         :处理的帧数
+*@ attention      :复用器接口在锁外调用，rd 处的帧在 rd 前进之前不会被淘汰
+*******************************************************************************/
+static int evrec_pump(void)
+{
+    int n = 0;
+    evrec_frame_t f;
+
+    for(;;)
+    {
+        pthread_mutex_lock(&evrec_ctx.mut);
+        if(evrec_ctx.trigger)
+        {
+            __sync_lock_test_and_set(&evrec_ctx.trigger, 0);
+            if(evrec_on_trigger() < 0)
+                evrec_ctx.trigger = 1;  //还没有关键帧，下次再处理
+        }
+        if(!evrec_ctx.recording || evrec_ctx.rd == evrec_ctx.head)
+        {
+            pthread_mutex_unlock(&evrec_ctx.mut);
+            break;
+        }
+        if((int)(evrec_ctx.rd - evrec_ctx.tail) < 0)
+        {
+            /*不会发生：录像中 rd 之后的帧不会被淘汰*/
+            ERROR_LOG("event record rd(%u) behind tail(%u)!\n", evrec_ctx.rd, evrec_ctx.tail);
+            evrec_ctx.rd = evrec_ctx.tail;
+        }
+        unsigned int idx = evrec_ctx.rd;
+        f = *EVREC_FRAME(idx);
+        pthread_mutex_unlock(&evrec_ctx.mut);
+
+        int stop = 0;
+        if(EVREC_FRAME_I == f.type && evrec_ctx.clip_open && idx != evrec_ctx.clip_first
+           && (f.pts >= evrec_ctx.clip_end || evrec_ctx.cut_request))
+        {
+            /*在关键帧处切片：有新的告警（或只是缓存快满、录像时长还没到）就从该关键帧继续*/
+            int go_on = evrec_ctx.more || f.pts < evrec_ctx.clip_end;
+            evrec_close_clip(!go_on, 0);
+            if(go_on)
+            {
+                if(evrec_ctx.more)
+                    evrec_ctx.clip_end = f.pts + EVENT_RECORD_CLIP_MS;
+                evrec_ctx.more = 0;
+            }
+            else
+            {
+                stop = 1;
+            }
+        }
+
+        if(!stop && !evrec_ctx.clip_open && EVREC_FRAME_I == f.type)
+        {
+            evrec_open_clip(&f, idx);
+        }
+
+        if(!stop && evrec_ctx.clip_open)  //切片打开失败 / 写失败后丢到下一个关键帧
+        {
+            int ret = evrec_ctx.sink->write(evrec_ctx.sink->arg, &f, evrec_ctx.pool + f.off);
+            if(ret < 0)
+            {
+                ERROR_LOG("event record write clip(%u) failed, drop it!\n", evrec_ctx.clip_no);
+                evrec_close_clip(0, 1);
+                evrec_ctx.clip_no --;
+            }
+            else
+            {
+                if(ret > 0)
+                    evrec_ctx.cut_request = 1;
+                if(EVREC_FRAME_A != f.type)
+                    evrec_ctx.clip_last = f.pts;
+            }
+        }
+
+        pthread_mutex_lock(&evrec_ctx.mut);
+        if(stop)
+            evrec_ctx.recording = 0;
+        else
+            evrec_ctx.rd ++;
+        pthread_mutex_unlock(&evrec_ctx.mut);
+        n ++;
+        if(stop)
+        {
+            DEBUG_LOG("event record end, %u clips\n", evrec_ctx.clip_no);
+            continue;   //同一轮里可能已经有新的告警
+        }
+    }
+
+    return n;
+}
+
+/*录像结束：当前切片以 END/ONE 输出*/
+static void evrec_finish(void)
+{
+    evrec_close_clip(1, 0);
+    pthread_mutex_lock(&evrec_ctx.mut);
+    evrec_ctx.recording = 0;
+    pthread_mutex_unlock(&evrec_ctx.mut);
+}
+
+void event_record_trigger(void)
+{
+    pthread_mutex_lock(&evrec_ctx.mut);
+    evrec_ctx.trigger = 1;
+    pthread_cond_signal(&evrec_ctx.cnd);
+    pthread_mutex_unlock(&evrec_ctx.mut);
+}
+
+int event_record_busy(void)
+{
+    return evrec_ctx.trigger || evrec_ctx.recording;
+}
+
+
+/*---# 切片输出：fmp4 / TS 内存文件 + amazon 云上传---------------------------------------*/
+#define EVREC_V_FRAME_RATE      15      //与 fmp4_record 相同
+#define EVREC_A_FRAME_RATE      14
+#define EVREC_AUDIO_SAMPLE_RATE 16000
+
+/*
+切片通过上传管道（mode 3）流式上传：切片开始时就放入上传队列，录像期间把复用器已经输出的数据
+写入管道（不阻塞，放不下的留在切片缓存中），切片结束时补充切片标志/时长，剩余数据交给上传线程。
+*/
+static upload_stream_t *evrec_stream = NULL;
+static unsigned int evrec_sent = 0;     //切片缓存中已经写入管道的字节数
+
+static int evrec_upload_open(int file_type)
+{
+    put_file_info_t file_info;
+    upload_stream_t *s = upload_stream_create();
+
+    if(NULL == s)
+        return -1;
+
+    memset(&file_info, 0, sizeof(file_info));
+    file_info.mode = 3;
+    file_info.file_type = file_type;
+    file_info.ts_flag = TS_FLAG_START;      //切片结束时更新（上传目录和优先级与 START/MID/END 无关）
+    file_info.stream = s;
+    if(push_to_upload_file_queue_nowait(&file_info) < 0)
+    {
+        upload_stream_close(s, 0);          //上传模块已经释放了它持有的引用
+        return -1;
+    }
+    evrec_stream = s;
+    evrec_sent = 0;
+    return 0;
+}
+
+/*把 buf 中 [evrec_sent, len) 管道放得下的部分写入管道；上传已放弃返回 -1*/
+static int evrec_upload_feed(const char *buf, unsigned int len)
+{
+    int n;
+
+    if(len <= evrec_sent)
+        return 0;
+    n = upload_stream_try_write(evrec_stream, buf + evrec_sent, len - evrec_sent);
+    if(n < 0)
+        return -1;
+    evrec_sent += n;
+    return 0;
+}
+
+/*切片结束：buf（malloc 分配）中没有写入管道的部分交给上传线程，abort 时放弃上传*/
+static void evrec_upload_close(int ts_flag, unsigned int duration_ms, char *buf, unsigned int len, int abort)
+{
+    unsigned int left = len > evrec_sent ? len - evrec_sent : 0;
+
+    if(NULL == evrec_stream)
+    {
+        free(buf);
+        return;
+    }
+    if(abort)
+    {
+        upload_stream_close(evrec_stream, 0);
+        free(buf);
+    }
+    else
+    {
+        upload_stream_set_info(evrec_stream, ts_flag, (duration_ms + 500) / 1000);
+        if(left > 0)
+        {
+            /*只保留没写入管道的部分，切片缓存的其余内存马上还给系统*/
+            char *tail;
+            if(evrec_sent > 0)
+                memmove(buf, buf + evrec_sent, left);
+            tail = (char*)realloc(buf, left);
+            if(tail)
+                buf = tail;
+        }
+        upload_stream_close_buf(evrec_stream, left > 0 ? buf : NULL, left);
+        if(0 == left)
+            free(buf);
+    }
+    evrec_stream = NULL;
+}
+
+#if (EVENT_RECORD_FILE_TYPE == EVENT_RECORD_FMP4)
+static int evrec_fmp4_open(void *arg, const evrec_frame_t *key, const unsigned char *data)
+{
+    fmp4_out_info_t *info = (fmp4_out_info_t*)arg;
+
+    memset(info, 0, sizeof(*info));
+    info->recode_time = EVENT_RECORD_CLIP_MS / 1000;
+    info->buf_mode.buf_start = (unsigned char*)calloc(EVENT_RECORD_CLIP_BUF_SIZE, sizeof(char));
+    if(NULL == info->buf_mode.buf_start)
+    {
+        ERROR_LOG("calloc failed!\n");
+        return -1;
+    }
+    if(evrec_upload_open(TYPE_FMP4) < 0)
+    {
+        ERROR_LOG("event clip upload open failed!\n");
+        free(info->buf_mode.buf_start);
+        info->buf_mode.buf_start = NULL;
+        return -1;
+    }
+    info->buf_mode.buf_size = EVENT_RECORD_CLIP_BUF_SIZE;
+    info->buf_mode.w_offset = 0;
+    info->file_mode.file_name = NULL; //不采用 文件模式 liteos 的 ramfs 延时太大
+
+    if(Fmp4_encode_init(info, (void*)data, key->len, EVREC_V_FRAME_RATE, EVREC_A_FRAME_RATE, EVREC_AUDIO_SAMPLE_RATE) < 0)
+    {
+        ERROR_LOG("fmp4 encode init failed!\n");
+        Fmp4_encode_exit();
+        evrec_upload_close(0, 0, (char*)info->buf_mode.buf_start, 0, 1);
+        info->buf_mode.buf_start = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int evrec_fmp4_write(void *arg, const evrec_frame_t *frame, const unsigned char *data)
+{
+    fmp4_out_info_t *info = (fmp4_out_info_t*)arg;
+    int ret;
+
+    if(EVREC_FRAME_A == frame->type)
+        ret = Fmp4AEncode((void*)data, frame->len, EVREC_A_FRAME_RATE, frame->pts);
+    else
+        ret = Fmp4VEncode((void*)data, frame->len, EVREC_V_FRAME_RATE, frame->pts);
+    if(ret)
+        return -1;
+
+    /*fmp4 缓存模式只追加写（moof+mdat 写完整个分片后才拷贝到缓存），已输出的部分不会再修改*/
+    if(evrec_upload_feed((const char*)info->buf_mode.buf_start, info->buf_mode.w_offset) < 0)
+    {
+        ERROR_LOG("event clip upload aborted!\n");
+        return -1;
+    }
+    return (info->buf_mode.w_offset >= info->buf_mode.buf_size / 4 * 3) ? 1 : 0;
+}
+
+static void evrec_fmp4_close(void *arg, int ts_flag, unsigned int duration_ms, int abort)
+{
+    fmp4_out_info_t *info = (fmp4_out_info_t*)arg;
+
+    Fmp4_encode_exit();
+    if(!abort)
+        DEBUG_LOG("event clip flag(%d) %u ms %u bytes, %u streamed\n", ts_flag, duration_ms, info->buf_mode.w_offset, evrec_sent);
+    evrec_upload_close(ts_flag, duration_ms, (char*)info->buf_mode.buf_start, info->buf_mode.w_offset, abort);
+    info->buf_mode.buf_start = NULL;
+}
+
+static fmp4_out_info_t evrec_fmp4_info;
+static const evrec_sink_t evrec_sink = {evrec_fmp4_open, evrec_fmp4_write, evrec_fmp4_close, &evrec_fmp4_info};
+
+#else
+static unsigned int evrec_ts_bytes = 0;   //TS 复用器内部缓存已用的字节数
+
+static int evrec_ts_open(void *arg, const evrec_frame_t *key, const unsigned char *data)
+{
+    ts_recoder_init_t init_info;
+
+    memset(&init_info, 0, sizeof(init_info));
+    init_info.audio_config.ID = 0;
+    init_info.audio_config.profile = 1; // low
+    init_info.audio_config.sampling_frequency_index = 0x8; //16000HZ
+    init_info.audio_config.sample_rate = EVREC_AUDIO_SAMPLE_RATE;
+    init_info.audio_config.n_ch = 1;
+    init_info.video_config.frame_rate = EVREC_V_FRAME_RATE;
+    init_info.recode_time = EVENT_RECORD_CLIP_MS / 1000;
+    if(evrec_upload_open(TYPE_TS) < 0)
+    {
+        ERROR_LOG("event clip upload open failed!\n");
+        return -1;
+    }
+    if(TS_recoder_init(&init_info) < 0)
+    {
+        ERROR_LOG("TS encode init failed!\n");
+        evrec_upload_close(0, 0, NULL, 0, 1);
+        return -1;
+    }
+    evrec_ts_bytes = 0;
+    return 0;
+}
+
+static int evrec_ts_write(void *arg, const evrec_frame_t *frame, const unsigned char *data)
+{
+    int ret;
+
+    if(EVREC_FRAME_A == frame->type)
+        ret = TsAEncode((void*)data, frame->len);
+    else
+        ret = TsVEncode((void*)data, frame->len);
+    if(ret)
+        return -1;
+
+    evrec_ts_bytes += frame->len;
+    return (evrec_ts_bytes >= VIDEO_BUF_SIZE / 4 * 3) ? 1 : 0;
+}
+
+static void evrec_ts_close(void *arg, int ts_flag, unsigned int duration_ms, int abort)
+{
+    void *out_buf = NULL;
+    int out_len = 0;
+
+    if(!abort && TS_remux_video_audio(&out_buf, &out_len) < 0)
+    {
+        ERROR_LOG("TS_remux_video_audio failed!\n");
+        abort = 1;
+    }
+    TS_recoder_exit(abort ? -1 : 0);
+    /*TS 在切片结束时才整体复用出来，整个文件交给上传线程*/
+    evrec_upload_close(ts_flag, duration_ms, abort ? NULL : (char*)out_buf, abort ? 0 : out_len, abort);
+}
+
+static const evrec_sink_t evrec_sink = {evrec_ts_open, evrec_ts_write, evrec_ts_close, NULL};
+#endif
+
+/*取帧线程：不做任何耗时操作，保证不丢帧*/
+static void* event_record_input_thread(void *args)
+{
+    ENC_STREAM_PACK *pack = NULL;
+    FRAME_HDR *header = NULL;
+    unsigned int skip_len = 0;
+    unsigned long long pts = 0;
+
+    DEBUG_LOG("event record input thread start, stream_id(%#x)\n", evrec_ctx.stream_id);
+    while (evrec_ctx.running)
+    {
+        pack = encoder_get_packet(evrec_ctx.stream_id);
+        if (NULL == pack)
+        {
+            usleep(10*1000);
+            continue;
+        }
+
+        header = (FRAME_HDR *) pack->data;
+        if (header->type == EVREC_FRAME_I)
+        {
+            skip_len = sizeof(FRAME_HDR) + sizeof(IFRAME_INFO);
+            pts = ((IFRAME_INFO *)(pack->data + sizeof(FRAME_HDR)))->pts_msec;
+        }
+        else if (header->type == EVREC_FRAME_P)
+        {
+            skip_len = sizeof(FRAME_HDR) + sizeof(PFRAME_INFO);
+            pts = ((PFRAME_INFO *)(pack->data + sizeof(FRAME_HDR)))->pts_msec;
+        }
+        else if (header->type == EVREC_FRAME_A)
+        {
+            skip_len = sizeof(FRAME_HDR) + sizeof(AFRAME_INFO);
+            pts = ((AFRAME_INFO *)(pack->data + sizeof(FRAME_HDR)))->pts_msec;
+        }
+        else
+        {
+            ERROR_LOG("unknown frame type(%#x)!\n", header->type);
+            encoder_release_packet(pack);
+            continue;
+        }
+
+        evrec_push(header->type, pts, pack->data + skip_len, pack->length - skip_len);
+        encoder_release_packet(pack);
+    }
+
+    DEBUG_LOG("event record input thread exit\n");
+    return NULL;
+}
+
+/*切片线程：复用 + 上传（上传队列满时可能阻塞，期间的帧留在预录缓存中）*/
+static void* event_record_clip_thread(void *args)
+{
+    struct timespec ts;
+
+    while (evrec_ctx.running)
+    {
+        if(evrec_pump() > 0)
+            continue;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 1;
+        pthread_mutex_lock(&evrec_ctx.mut);
+        if(evrec_ctx.running && !evrec_ctx.trigger
+           && (!evrec_ctx.recording || evrec_ctx.rd == evrec_ctx.head))
+            pthread_cond_timedwait(&evrec_ctx.cnd, &evrec_ctx.mut, &ts);
+        pthread_mutex_unlock(&evrec_ctx.mut);
+    }
+
+    evrec_finish();
+    DEBUG_LOG("event record clip thread exit\n");
+    return NULL;
+}
+
+int event_record_start(int stream_index)
+{
+    if (evrec_ctx.running)
+    {
+        ERROR_LOG("event record already running!\n");
+        return HLE_RET_EBUSY;
+    }
+
+    if (evrec_init(&evrec_sink) < 0)
+        return HLE_RET_ENORESOURCE;
+
+    evrec_ctx.stream_id = encoder_request_stream(0, stream_index, 1);
+    if (evrec_ctx.stream_id < 0)
+    {
+        ERROR_LOG("encoder_request_stream failed!\n");
+        evrec_deinit();
+        return HLE_RET_ENORESOURCE;
+    }
+
+    evrec_ctx.running = 1;
+    if (pthread_create(&evrec_ctx.clip_tid, NULL, event_record_clip_thread, NULL) != 0)
+    {
+        ERROR_LOG("create event_record_clip_thread failed!\n");
+        goto ERR;
+    }
+    if (pthread_create(&evrec_ctx.input_tid, NULL, event_record_input_thread, NULL) != 0)
+    {
+        ERROR_LOG("create event_record_input_thread failed!\n");
+        evrec_ctx.running = 0;
+        pthread_mutex_lock(&evrec_ctx.mut);
+        pthread_cond_signal(&evrec_ctx.cnd);
+        pthread_mutex_unlock(&evrec_ctx.mut);
+        pthread_join(evrec_ctx.clip_tid, NULL);
+        goto ERR;
+    }
+
+    return HLE_RET_OK;
+
+ERR:
+    evrec_ctx.running = 0;
+    encoder_free_stream(evrec_ctx.stream_id);
+    evrec_deinit();
+    return HLE_RET_ERROR;
+}
+
+void event_record_stop(void)
+{
+    if (!evrec_ctx.running)
+        return;
+
+    evrec_ctx.running = 0;
+    /*释放队列会唤醒阻塞在 encoder_get_packet 中的线程（返回NULL）*/
+    encoder_free_stream(evrec_ctx.stream_id);
+    pthread_join(evrec_ctx.input_tid, NULL);
+
+    pthread_mutex_lock(&evrec_ctx.mut);
+    pthread_cond_signal(&evrec_ctx.cnd);
+    pthread_mutex_unlock(&evrec_ctx.mut);
+    pthread_join(evrec_ctx.clip_tid, NULL);
+
+    evrec_ctx.stream_id = -1;
+    evrec_deinit();
+}
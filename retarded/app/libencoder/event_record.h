@@ -0,0 +1,89 @@
+/***************************************************************************
+* @file:event_record.h
+* @author:
+* @date:  10,19,2026
+* @brief:  MD 告警录像：预录 + 连续切片，切片结果放入 amazon 云上传队列
+* @attention:录像线程一直从码流分发队列取帧，缓存最近 EVENT_RECORD_PREROLL_MS 的完整 GOP（预录）。
+             告警时从预录窗口内的关键帧开始输出，之后的实时帧直接接在后面；
+             录制期间又有告警时在关键帧处切成下一个切片（两个切片以同一个关键帧为界，不丢帧），
+             切片依次标记 TS_FLAG_START/MID/END（只有一个切片时为 TS_FLAG_ONE）。
+***************************************************************************/
+#ifndef _EVENT_RECORD_H
+#define _EVENT_RECORD_H
+
+#define EVENT_RECORD_STREAM_INDEX   0               //录像使用的码流（主码流）
+#define EVENT_RECORD_PREROLL_MS     6000            //预录时长(ms)
+#define EVENT_RECORD_CLIP_MS        15000           //切片时长(ms)：到达该时长后的第一个关键帧处切片
+#define EVENT_RECORD_POOL_SIZE      (1024*1024*2)   //预录环形缓存大小（码率过高时预录时长会缩短）
+#define EVENT_RECORD_FRAME_MAX      1024            //预录环形缓存最多缓存的帧数（2 的幂）
+#define EVENT_RECORD_CLIP_BUF_SIZE  (1024*512*5)    //单个切片的文件缓存大小，用到 3/4 时提前在下一个关键帧切片
+
+/*---# 切片文件类型---------*/
+#define EVENT_RECORD_TS             1
+#define EVENT_RECORD_FMP4           2
+#define EVENT_RECORD_FILE_TYPE      EVENT_RECORD_FMP4
+
+
+/*预录环形缓存中的一帧*/
+typedef struct _evrec_frame_t
+{
+    unsigned char       type;       //帧类型：0xF8-视频关键帧，0xF9-视频非关键帧，0xFA-音频帧
+    unsigned char       reserved[3];
+    unsigned int        len;        //帧数据长度（不含 FRAME_HDR 和帧描述信息）
+    unsigned int        off;        //帧数据在缓存中的偏移
+    unsigned int        seq;        //输入帧序号（连续递增，用于检查切片连续性）
+    unsigned long long  pts;        //毫秒级时间戳
+}evrec_frame_t;
+
+/*切片输出（复用器）接口，都在录像线程中调用*/
+typedef struct _evrec_sink_t
+{
+    /*开始一个切片，key 为切片的第一帧（关键帧），随后还会通过 write 写入该帧；成功返回 0*/
+    int  (*open)(void *arg, const evrec_frame_t *key, const unsigned char *data);
+    /*写入一帧；成功返回 0，缓存快满（希望在下一个关键帧切片）返回 1，失败返回 -1（丢弃该切片）*/
+    int  (*write)(void *arg, const evrec_frame_t *frame, const unsigned char *data);
+    /*结束切片：abort 为 1 时丢弃，否则以 ts_flag 标记后输出*/
+    void (*close)(void *arg, int ts_flag, unsigned int duration_ms, int abort);
+    void *arg;
+}evrec_sink_t;
+
+
+/*
+    function:  event_record_start
+    description:  启动告警录像（取帧线程 + 切片线程），开始缓存预录数据
+    args:
+        int stream_index[in]，码流索引，0为主码流
+    return:
+        0, 成功
+        <0, 失败
+ */
+int event_record_start(int stream_index);
+
+/*
+    function:  event_record_stop
+    description:  停止告警录像，正在录制的切片以 END/ONE 结束并输出
+    args:
+    return:
+ */
+void event_record_stop(void);
+
+/*
+    function:  event_record_trigger
+    description:  告警触发：空闲时开始一次录像（带预录），录像中则延长录像（录完当前切片后继续切下一个）
+    args:
+    return:
+ */
+void event_record_trigger(void);
+
+/*
+    function:  event_record_busy
+    description:  查询是否正在录像（或有未处理的告警）
+    return:
+        1, 录像中
+        0, 空闲
+ */
+int event_record_busy(void);
+
+
+#endif
+
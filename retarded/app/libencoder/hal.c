@@ -29,10 +29,13 @@
 #include "fmp4_encode.h"
 #include "itfEncoder.h"
 #include "amazon_S3.h"
+#include "amazon_upload.h"
 //#include "hls_main.h"
 #include "fmp4_interface.h"
 #include "ts_encode.h"
 #include "ts_interface.h"
+#include "event_record.h"
+#include "sd_record.h"
 
 
 
@@ -519,6 +522,33 @@ HLE_S32 MS_encoder_get_packet(HLE_S32 queue_id,HLE_S8 have_audio, void **pack_ad
 
 
 
+HLE_S32 MS_encoder_try_get_packet(HLE_S32 queue_id,HLE_S8 have_audio, void **pack_addr, void**frame_addr,HLE_S32* frame_length)
+{
+    if(NULL == pack_addr || NULL == frame_addr || NULL == frame_length)
+    {
+        ERROR_LOG("Illegal parameter!\n");
+        return HLE_RET_EINVAL;
+    }
+
+    ENC_STREAM_PACK *pack = NULL;
+    while(NULL != (pack = encoder_try_get_packet(queue_id)))
+    {
+        FRAME_HDR *header = (FRAME_HDR *) pack->data;
+        if( !(have_audio) && header->type == 0xFA)//不需要audio帧 ,则过滤
+        {
+            encoder_release_packet(pack);
+            continue;
+        }
+        break;
+    }
+
+    *pack_addr = pack;
+    *frame_addr = pack ? pack->data : NULL;
+    *frame_length = pack ? pack->length : 0;
+    return HLE_RET_OK;
+}
+
+
 /*
     media server 回调函数，编码帧（包）的引用计数减1
 */
@@ -566,6 +596,9 @@ int media_server_module_init(void)
     med_ser_init_info.encoder_get_packet = MS_encoder_get_packet;
     med_ser_init_info.encoder_release_packet = MS_encoder_release_packet;
     med_ser_init_info.encoder_free_stream = encoder_free_stream;
+    med_ser_init_info.encoder_try_get_packet = MS_encoder_try_get_packet;
+    med_ser_init_info.encoder_set_packet_notify = encoder_set_packet_notify;
+    med_ser_init_info.encoder_set_rate_ctrl = encoder_set_rate_ctrl;
    
     med_ser_init_info.encoder_force_iframe = encoder_force_iframe;
     med_ser_init_info.get_one_JPEG_frame = get_one_JPEG_frame;
@@ -639,34 +672,21 @@ int create_write_file(char*file_name,void* data,unsigned int data_len)
 
 }
 
-extern void fmp4_record_exit(fmp4_out_info_t *info);
-int record_mp4_done = 1; //标记文件录制是否结束 (0:没结束 1：结束)
-pthread_mutex_t MD_func_mut; //MD 告警 响应线程 锁 
-#define OUT_FILE_BUF_SIZE   TS_RECODER_BUF_SIZE //MD 告警录制文件缓存 buf
-#define MD_ALARM_RECORD_TIME  15    //MD告警录制时长
-#define MD_ALARM_PRERECORD_TIME  6  //MD告警预录制时长
-/*---# m3u索引文件类型---------*/
-#define M3U_TS_FILE     1
-#define M3U_FMP4_FILE   2
-#define M3U_INDEX_FILE_TYPE  M3U_FMP4_FILE
-static int need_more_record = 0; //1:有连续告警发生（在告警视频录制期间又发生了告警）;0:无
-pthread_mutex_t need_more_record_mut;
+int record_mp4_done = 1; //标记告警抓拍是否结束 (0:没结束 1：结束)
 /*******************************************************************************
-*@ Description    :  MD 告警响应函数（fmp4录像 + TS切片 + 推送amazon云）
+*@ Description    :  MD 告警抓拍（抓拍图片 + 推送amazon云）
 *@ Input          :
 *@ Output         :
 *@ Return         :
+*@ attention      :告警录像由 event_record 模块完成（预录 + 连续切片），这里只负责抓拍
 *******************************************************************************/
-void* MD_alarm_response_func(void* args) //文件模式 版本
+void* MD_alarm_response_func(void* args)
 {    
     printf("\n\n=======start MD_alarm_response_func==================================================================\n");
     pthread_detach(pthread_self());
     
-    void *  record_data  = NULL; //最终录制的文件数据buf
-    unsigned int  record_data_len = 0; //最终录制的文件数据buf长度 
-    fmp4_out_info_t out_mp4_info = {0};
     put_file_info_t file_info = {0};
-    int file_count = 0; //标记已经连续产生了几个15s的告警视频文件
+    upload_stream_t *stream = NULL;
     
     /*---#抓拍图片------------------------------------------------------------*/
     //该操作在执行的期间会占用MMZ 4M 大小的内存空间
@@ -678,206 +698,34 @@ void* MD_alarm_response_func(void* args) //文件模式 版本
         goto ERR;
     }
 
-    //将录制的文件放入到 amazom 云上传队列，云上传线程将自动进行传输
+    //将抓拍的图片通过上传管道放入到 amazom 云上传队列，云上传线程将自动进行传输
+    stream = upload_stream_create();
+    if (!stream)
+    {
+        encoder_free_jpeg(jpg);
+        goto ERR;
+    }
     memset(&file_info,0,sizeof(file_info));
-    file_info.mode = 2;
+    file_info.mode = 3;
     file_info.file_tlen = 0;
     file_info.file_type = TYPE_JPG;
     file_info.ts_flag = TS_FLAG_JPG;
     //file_info.file_name = ;
-    file_info.file_buf =  jpg;
-    file_info.file_buf_len = size;
+    file_info.stream = stream;
     //file_info.m3u8name = ;
     //file_info.datetime = ;
-    push_to_upload_file_queue(&file_info);
-    //create_write_file("MD_snap_01.jpg",jpg,size); //debug
-    //encoder_free_jpeg(jpg);//debug
-        
-
-    if(M3U_INDEX_FILE_TYPE == M3U_TS_FILE)
-    {
-        void* out_buf = NULL;
-        int out_len = 0;
-        /*---#录6s预录视频------------------------------------------------------------*/
-        if(ts_record(&out_buf,&out_len,MD_ALARM_PRERECORD_TIME) < 0)
-        {
-            ERROR_LOG("ts_record failed!\n");
-            goto ERR;
-        }
-        record_data = out_buf;
-        record_data_len = (int)out_len;  
-        /*---# 将录制的文件放入到 amazom 云上传队列，云上传线程将自动进行传输--------------*/
-        memset(&file_info,0,sizeof(file_info));
-        file_info.mode = 2;
-        file_info.file_tlen = MD_ALARM_PRERECORD_TIME;
-        file_info.file_type = TYPE_TS;
-        file_info.ts_flag = TS_FLAG_6S;
-        //file_info.file_name = ;
-        file_info.file_buf =  record_data;
-        file_info.file_buf_len = record_data_len;
-        //file_info.m3u8name = ;
-        //file_info.datetime = ;
-        push_to_upload_file_queue(&file_info);
-            
-        //create_write_file("/jffs0/MD_TS_6s_01.ts",record_data,record_data_len); //debug
-        //if(record_data) {free(record_data);record_data = NULL;} //debug
-        
-        /*---#录 15s 视频------------------------------------------------------------*/
-        while(need_more_record != 0)
-        {
-            pthread_mutex_lock(&need_more_record_mut);
-            need_more_record = 0;//清零操作必须放到 ts_record 之前，因录制15s视频期间发生新的告警，则会被再次置位。
-            pthread_mutex_unlock(&need_more_record_mut);
-            file_count ++;
-            
-            if(ts_record(&out_buf,&out_len,MD_ALARM_RECORD_TIME) < 0)
-            {
-                ERROR_LOG("ts_record failed!\n");
-                goto ERR;
-            }
-            record_data = out_buf;
-            record_data_len = (int)out_len;  
-      
-            /*---# 将录制的文件放入到 amazom 云上传队列，云上传线程将自动进行传输--------------*/
-            memset(&file_info,0,sizeof(file_info));
-            file_info.mode = 2;
-            file_info.file_tlen = MD_ALARM_RECORD_TIME;
-            file_info.file_type = TYPE_TS;
-            if(need_more_record)//有连续告警发生（还需继续录制下一个15s）
-            {
-                if(1 == file_count)//当前录制文件为第一个
-                    file_info.ts_flag = TS_FLAG_START;
-                else
-                    file_info.ts_flag = TS_FLAG_MID;
-            }
-            else//没有连续告警发生(不需要再录制下一个15s了)
-            {
-                if(1 == file_count)//当前录制文件为第一个
-                    file_info.ts_flag = TS_FLAG_ONE;
-                else
-                    file_info.ts_flag = TS_FLAG_END;
-            }
-            //file_info.file_name = ;
-            file_info.file_buf =  record_data;
-            file_info.file_buf_len = record_data_len;
-            //file_info.m3u8name = ;
-            //file_info.datetime = ;
-            push_to_upload_file_queue(&file_info);
-            //create_write_file("/jffs0/MD_TS_15s_01.ts",record_data,record_data_len); //debug
-            //if(record_data) {free(record_data);record_data = NULL;}//debug
-        }
-        
-
-    }
-    else //if(M3U_INDEX_FILE_TYPE == M3U_FMP4_FILE)
+    if (push_to_upload_file_queue_nowait(&file_info) < 0)
     {
-        #if 1
-        /*---#录6s预录视频------------------------------------------------------------*/
-        memset(&out_mp4_info,0,sizeof(out_mp4_info));
-        out_mp4_info.recode_time = MD_ALARM_PRERECORD_TIME;
-        /*---#配置 buf存储 模式-----*/
-        out_mp4_info.buf_mode.buf_start = (char*)calloc(OUT_FILE_BUF_SIZE/2,sizeof(char));
-        if(NULL == out_mp4_info.buf_mode.buf_start)
-        {
-            ERROR_LOG("calloc failed!\n");
-            goto ERR;
-        }
-        out_mp4_info.buf_mode.buf_size = OUT_FILE_BUF_SIZE/2;
-        out_mp4_info.buf_mode.w_offset = 0;
-        out_mp4_info.file_mode.file_name = NULL; //不采用 文件模式 liteos 的 ramfs 延时太大
-        if(NULL == fmp4_record(&out_mp4_info))
-        {
-            ERROR_LOG("call fmp4_record failed!\n");
-            fmp4_record_exit(&out_mp4_info);
-            goto ERR;
-        }
- 
-        
-        record_data = out_mp4_info.buf_mode.buf_start;
-        record_data_len = out_mp4_info.buf_mode.w_offset;
-		
-        //create_write_file("/jffs0/MD_fmp4_6s_01.mp4",record_data,record_data_len); //debug
-        //if(out_mp4_info.buf_mode.buf_start) fmp4_record_exit(&out_mp4_info);由 amazon 上传后释放
-        
-        /*将录制的文件放入到 amazom 云上传队列，云上传线程将自动进行传输--*/
-        memset(&file_info,0,sizeof(file_info));
-        file_info.mode = 2;
-        file_info.file_tlen = MD_ALARM_PRERECORD_TIME;
-        file_info.file_type = TYPE_FMP4;
-        file_info.ts_flag = TS_FLAG_6S;
-        //file_info.file_name = ;
-        file_info.file_buf =  record_data;
-        file_info.file_buf_len = record_data_len;
-        //file_info.m3u8name = ;
-        //file_info.datetime = ;
-        push_to_upload_file_queue(&file_info);
-        
-        /*---#录 15s 视频------------------------------------------------------------*/
-        while(need_more_record != 0)
-        {
-            pthread_mutex_lock(&need_more_record_mut);
-            need_more_record = 0;//清零操作必须放到 fmp4_record 之前，因录制15s视频期间发生新的告警，则会被再次置位。
-            pthread_mutex_unlock(&need_more_record_mut);
-            file_count ++;
-            
-            memset(&out_mp4_info,0,sizeof(out_mp4_info));
-            out_mp4_info.recode_time = MD_ALARM_RECORD_TIME;
-            /*---#配置 buf存储 模式-----*/
-            out_mp4_info.buf_mode.buf_start = (char*)calloc(OUT_FILE_BUF_SIZE,sizeof(char));
-            if(NULL == out_mp4_info.buf_mode.buf_start)
-            {
-                ERROR_LOG("calloc failed!\n");
-                goto ERR;
-            }
-            out_mp4_info.buf_mode.buf_size = OUT_FILE_BUF_SIZE;
-            out_mp4_info.buf_mode.w_offset = 0;
-            out_mp4_info.file_mode.file_name = NULL; //不采用 文件模式 liteos 的 ramfs 延时太大
-            if(NULL == fmp4_record(&out_mp4_info))
-            {
-                ERROR_LOG("call fmp4_record failed!\n");
-                fmp4_record_exit(&out_mp4_info);
-                goto ERR;
-            }
-              
-            record_data = out_mp4_info.buf_mode.buf_start;
-            record_data_len = out_mp4_info.buf_mode.w_offset;
-            //if(out_mp4_info.buf_mode.buf_start) fmp4_record_exit(&out_mp4_info);由 amazon 上传后释放
-            
-            /*将录制的文件放入到 amazom 云上传队列，云上传线程将自动进行传输--*/
-            memset(&file_info,0,sizeof(file_info));
-            file_info.mode = 2;
-            file_info.file_tlen = MD_ALARM_RECORD_TIME;
-            file_info.file_type = TYPE_FMP4;
-            if(need_more_record)//有连续告警发生（还需继续录制下一个15s）
-            {
-                if(1 == file_count)//当前录制文件为第一个
-                    file_info.ts_flag = TS_FLAG_START;
-                else
-                    file_info.ts_flag = TS_FLAG_MID;
-            }
-            else//没有连续告警发生(不需要再录制下一个15s了)
-            {
-                if(1 == file_count)//当前录制文件为第一个
-                    file_info.ts_flag = TS_FLAG_ONE;
-                else
-                    file_info.ts_flag = TS_FLAG_END;
-            }
-            //file_info.file_name = ;
-            file_info.file_buf =  record_data;
-            file_info.file_buf_len = record_data_len;
-            //file_info.m3u8name = ;
-            //file_info.datetime = ;
-            push_to_upload_file_queue(&file_info);
-            /*---# END------------------------------------------------------------*/
-        
-        }
-        
-        #endif
+        upload_stream_close(stream, 0);
+        encoder_free_jpeg(jpg);
+        goto ERR;
     }
+    //图片已经是完整的一块，直接交给上传线程（不阻塞告警处理线程）
+    upload_stream_close_buf(stream, jpg, size);
+    //create_write_file("MD_snap_01.jpg",jpg,size); //debug
+    //encoder_free_jpeg(jpg);//debug
     
 ERR:
-    if(record_data) {free(record_data);record_data = NULL;}
-    if(out_mp4_info.buf_mode.buf_start) fmp4_record_exit(&out_mp4_info);
     record_mp4_done = 1;//标记结束
     printf("=======END MD_alarm_response_func==================================================================\n");
     pthread_exit(NULL);
@@ -962,8 +810,6 @@ int app_main(int argc, char *argv[])
        start_amazon_upload_thread();
     #endif
     
-    pthread_mutex_init(&need_more_record_mut,NULL);
-    
     int i, snap;
     int id[STREAMS_PER_CHN];
     int fd[STREAMS_PER_CHN];
@@ -986,6 +832,18 @@ int app_main(int argc, char *argv[])
 
     }
 
+    /*MD 告警录像：一直缓存预录数据，告警时输出切片*/
+    if (HLE_RET_OK != event_record_start(EVENT_RECORD_STREAM_INDEX))
+    {
+        ERROR_LOG("event_record_start fail!\n");
+    }
+
+    /*SD 卡连续录像（没有插卡时不录）*/
+    if (HLE_RET_OK != sd_record_start(SD_REC_STREAM_INDEX))
+    {
+        ERROR_LOG("sd_record_start fail!\n");
+    }
+
     
 
 
@@ -1075,28 +933,22 @@ int app_main(int argc, char *argv[])
             motion_detect_get_state(&motion);
             if(motion)//有告警产生
             {
-                if(record_mp4_done)//上一次录像已经结束
+                if(!event_record_busy() && record_mp4_done)//新的一次告警（上一次录像和抓拍都已经结束）
                 {
                     record_mp4_done = 0;//标记开始
-                    pthread_mutex_lock(&need_more_record_mut);
-                    need_more_record = 1; 
-                    pthread_mutex_unlock(&need_more_record_mut);
-                    
-                    DEBUG_LOG("---Alarm---------------------------------------------------------!\n");
+                    MD_ZONE_STATE zone_state;
+                    memset(&zone_state, 0, sizeof(zone_state));
+                    motion_detect_get_zone_state(0, &zone_state);
+                    DEBUG_LOG("---Alarm--- zone mask %#x -------------------------------------------!\n", zone_state.alarm_mask);
                     pthread_t threadID;
                     HLE_S32 err = pthread_create(&threadID, NULL, &MD_alarm_response_func, NULL);
                     if (0 != err) 
                     {
-                        ERROR_LOG("create media_server_start failed!\n");
-                        continue;
+                        ERROR_LOG("create MD_alarm_response_func failed!\n");
+                        record_mp4_done = 1;
                     } 
                 }
-                else//上一次录像没结束
-                {
-                    pthread_mutex_lock(&need_more_record_mut);
-                    need_more_record = 1; 
-                    pthread_mutex_unlock(&need_more_record_mut);
-                }
+                event_record_trigger();//录像中则在当前切片结束后继续录下一个切片
             }
             
             
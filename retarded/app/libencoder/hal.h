@@ -265,6 +265,17 @@ extern "C"
 
     HLE_S32 MS_encoder_get_packet(HLE_S32 queue_id,HLE_S8 have_audio,void**pack_addr, void**frame_addr,HLE_S32* frame_length);
 
+    /*
+        function:  MS_encoder_try_get_packet
+        description:  MS_encoder_get_packet 的不阻塞版本，media server 的流发送线程用它轮询多路码流
+        args:
+            同 MS_encoder_get_packet
+        return:
+            HLE_RET_OK, 成功；队列里暂时没有帧时 *pack_addr 为 NULL
+            <0, 失败，返回值为错误码，具体见错误码定义
+     */
+    HLE_S32 MS_encoder_try_get_packet(HLE_S32 queue_id,HLE_S8 have_audio,void**pack_addr, void**frame_addr,HLE_S32* frame_length);
+
     /*
         function:  media_server_module_init
         description:  媒体服务程序初始化
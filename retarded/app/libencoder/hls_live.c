@@ -0,0 +1,207 @@
+
+/*******************************************************************************
+*@ Description    :设备端直播 HLS 发布
+                    从码流分发队列（sdp）取出音视频帧，直接交给 TS_live 切片模块，
+                    切片和 m3u8 均保存在固定大小的内存中（可选同时写文件），
+                    本地 HTTP 服务通过 TS_live_get_playlist / TS_live_read_segment 读取。
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*@ attention      :发布线程用 encoder_try_get_packet 取帧，队列为空时等待编码线程的通知（带超时），
+                    停止时先唤醒并等待线程退出，再释放码流队列，线程不会再访问已释放的队列。
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "typeport.h"
+#include "encoder.h"
+#include "hls_live.h"
+
+
+#define HLS_LIVE_WAIT_MS    100     //队列为空时等待通知的最长时间（兜底，正常由通知唤醒）
+
+typedef struct _hls_live_ctx_t
+{
+    int             running;        //发布线程运行标志（lock 保护）
+    int             stream_id;      //encoder_request_stream 返回的码流编号
+    pthread_t       thread_id;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;           //队列由空变为非空、停止时唤醒发布线程
+    int             pending;        //收到通知还没有取帧（lock 保护）
+}hls_live_ctx_t;
+
+static hls_live_ctx_t hls_live_ctx = {0, -1, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+
+
+/*编码线程的回调：队列由空变为非空*/
+static void hls_live_notify(void *arg)
+{
+    pthread_mutex_lock(&hls_live_ctx.lock);
+    hls_live_ctx.pending = 1;
+    pthread_cond_signal(&hls_live_ctx.cond);
+    pthread_mutex_unlock(&hls_live_ctx.lock);
+}
+
+/*取一帧，队列为空时等待通知；返回 NULL 时重新检查运行标志*/
+static ENC_STREAM_PACK *hls_live_get_packet(void)
+{
+    ENC_STREAM_PACK *pack = encoder_try_get_packet(hls_live_ctx.stream_id);
+    struct timespec ts;
+
+    if (pack)
+        return pack;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += HLS_LIVE_WAIT_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&hls_live_ctx.lock);
+    while (hls_live_ctx.running && !hls_live_ctx.pending)
+    {
+        if (pthread_cond_timedwait(&hls_live_ctx.cond, &hls_live_ctx.lock, &ts) != 0)
+            break;
+    }
+    hls_live_ctx.pending = 0;
+    pthread_mutex_unlock(&hls_live_ctx.lock);
+    return NULL;
+}
+
+
+static void* hls_live_thread(void *args)
+{
+    ENC_STREAM_PACK *pack = NULL;
+    FRAME_HDR *header = NULL;
+    unsigned int skip_len = 0;
+
+    DEBUG_LOG("hls live thread start, stream_id(%#x)\n", hls_live_ctx.stream_id);
+    while (hls_live_is_running())
+    {
+        pack = hls_live_get_packet();
+        if (NULL == pack)
+            continue;
+
+        header = (FRAME_HDR *) pack->data;
+        if (header->type == 0xF8)  //0xF8-视频关键帧
+        {
+            IFRAME_INFO *info = (IFRAME_INFO *)(pack->data + sizeof(FRAME_HDR));
+            skip_len = sizeof(FRAME_HDR) + sizeof(IFRAME_INFO);
+            TS_live_put_video(pack->data + skip_len, pack->length - skip_len, 1, info->pts_msec);
+        }
+        else if (header->type == 0xF9)  //0xF9-视频非关键帧
+        {
+            PFRAME_INFO *info = (PFRAME_INFO *)(pack->data + sizeof(FRAME_HDR));
+            skip_len = sizeof(FRAME_HDR) + sizeof(PFRAME_INFO);
+            TS_live_put_video(pack->data + skip_len, pack->length - skip_len, 0, info->pts_msec);
+        }
+        else if (header->type == 0xFA)  //0xFA-音频帧
+        {
+            AFRAME_INFO *info = (AFRAME_INFO *)(pack->data + sizeof(FRAME_HDR));
+            skip_len = sizeof(FRAME_HDR) + sizeof(AFRAME_INFO);
+            TS_live_put_audio(pack->data + skip_len, pack->length - skip_len, info->pts_msec);
+        }
+        else
+        {
+            ERROR_LOG("unknown frame type(%#x)!\n", header->type);
+        }
+
+        encoder_release_packet(pack);
+    }
+
+    DEBUG_LOG("hls live thread exit\n");
+    return NULL;
+}
+
+int hls_live_start(int stream_index, const char *out_dir)
+{
+    ts_live_init_t init_info;
+
+    if (hls_live_ctx.running)
+    {
+        ERROR_LOG("hls live already running!\n");
+        return HLE_RET_EBUSY;
+    }
+
+    memset(&init_info, 0, sizeof(init_info));
+    init_info.target_duration = HLS_LIVE_TARGET_DURATION;
+    init_info.window_size = HLS_LIVE_WINDOW_SIZE;
+    init_info.segment_buf_size = HLS_LIVE_SEGMENT_BUF_SIZE;
+    strncpy(init_info.name_prefix, HLS_LIVE_NAME_PREFIX, sizeof(init_info.name_prefix) - 1);
+    if (out_dir)
+        strncpy(init_info.out_dir, out_dir, sizeof(init_info.out_dir) - 1);
+    /*与 ts_record 相同的 AAC 配置*/
+    init_info.audio_config.ID = 0;
+    init_info.audio_config.profile = 1; // low
+    init_info.audio_config.sampling_frequency_index = 0x8; //16000HZ
+    init_info.audio_config.sample_rate = 16000;
+    init_info.audio_config.n_ch = 1;
+
+    if (TS_live_init(&init_info) < 0)
+    {
+        ERROR_LOG("TS_live_init failed!\n");
+        return HLE_RET_ERROR;
+    }
+
+    hls_live_ctx.stream_id = encoder_request_stream(0, stream_index, 0);
+    if (hls_live_ctx.stream_id < 0)
+    {
+        ERROR_LOG("encoder_request_stream failed!\n");
+        TS_live_exit();
+        return HLE_RET_ENORESOURCE;
+    }
+
+    hls_live_ctx.pending = 0;
+    hls_live_ctx.running = 1;
+    encoder_set_packet_notify(hls_live_ctx.stream_id, hls_live_notify, NULL);
+    if (pthread_create(&hls_live_ctx.thread_id, NULL, hls_live_thread, NULL) != 0)
+    {
+        ERROR_LOG("create hls_live_thread failed!\n");
+        hls_live_ctx.running = 0;
+        /*线程没有创建，取消通知后直接释放队列*/
+        encoder_set_packet_notify(hls_live_ctx.stream_id, NULL, NULL);
+        encoder_free_stream(hls_live_ctx.stream_id);
+        hls_live_ctx.stream_id = -1;
+        TS_live_exit();
+        return HLE_RET_ERROR;
+    }
+
+    return HLE_RET_OK;
+}
+
+void hls_live_stop(void)
+{
+    pthread_mutex_lock(&hls_live_ctx.lock);
+    if (!hls_live_ctx.running)
+    {
+        pthread_mutex_unlock(&hls_live_ctx.lock);
+        return;
+    }
+    hls_live_ctx.running = 0;
+    pthread_cond_signal(&hls_live_ctx.cond);
+    pthread_mutex_unlock(&hls_live_ctx.lock);
+
+    /*先等发布线程退出（它不会阻塞在队列上），再取消通知、释放队列*/
+    pthread_join(hls_live_ctx.thread_id, NULL);
+    encoder_set_packet_notify(hls_live_ctx.stream_id, NULL, NULL);
+    encoder_free_stream(hls_live_ctx.stream_id);
+    hls_live_ctx.stream_id = -1;
+
+    TS_live_exit();
+}
+
+int hls_live_is_running(void)
+{
+    int running;
+    pthread_mutex_lock(&hls_live_ctx.lock);
+    running = hls_live_ctx.running;
+    pthread_mutex_unlock(&hls_live_ctx.lock);
+    return running;
+}
+
@@ -0,0 +1,54 @@
+ 
+/***************************************************************************
+* @file:hls_live.h 
+* @author:   
+* @date:  10,19,2026
+* @brief:  设备端直播 HLS 发布：从码流分发队列取帧，实时切片，供本地 HTTP 服务读取
+* @attention:目前只是库：设备上没有 HTTP 服务读取分片，开机时不启动（启动后多占一个编码队列和
+             (HLS_LIVE_WINDOW_SIZE + 2) * HLS_LIVE_SEGMENT_BUF_SIZE 的内存）；
+             out_dir 只用于调试，不要指向 flash 分区（每 2 秒写一个分片）。
+             有 HTTP 服务后由它在第一个请求到来时 hls_live_start，没有请求一段时间后 hls_live_stop。
+***************************************************************************/
+#ifndef _HLS_LIVE_H
+#define _HLS_LIVE_H
+
+#include "ts_live_interface.h"
+
+#define HLS_LIVE_TARGET_DURATION    2               //目标分片时长(s)
+#define HLS_LIVE_WINDOW_SIZE        3               //m3u8 中保留的分片个数
+#define HLS_LIVE_SEGMENT_BUF_SIZE   (1024*512)      //单个分片缓存大小
+#define HLS_LIVE_NAME_PREFIX        "live"          //生成 live.m3u8 / live_<seq>.ts
+
+
+/*
+    function:  hls_live_start
+    description:  启动直播 HLS 发布线程
+    args:
+        int stream_index[in]，码流索引，0为主码流
+        const char *out_dir[in]，不为NULL时同时把分片和m3u8写到该目录，NULL则只保存在内存中
+    return:
+        0, 成功
+        <0, 失败
+ */
+int hls_live_start(int stream_index, const char *out_dir);
+
+/*
+    function:  hls_live_stop
+    description:  停止直播 HLS 发布线程并释放所有分片缓存
+    args:
+    return:
+ */
+void hls_live_stop(void);
+
+/*
+    function:  hls_live_is_running
+    description:  查询直播 HLS 发布线程是否在运行
+    return:
+        1, 运行中
+        0, 未运行
+ */
+int hls_live_is_running(void);
+
+
+#endif
+
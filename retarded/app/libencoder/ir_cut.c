@@ -17,6 +17,7 @@
 #include "gpio_reg.h"
 #include "typeport.h"
 #include "comm_sys.h"
+#include "luma_stat.h"
 
 
 
@@ -35,6 +36,12 @@ static ISP_DEV IspDev = 0;
 #define GAIN_MAX_COEF               (280)
 #define GAIN_MIN_COEF               (190)
 
+#define IR_LUMA_STALE_LOOPS         (125)   //亮度统计超过 125 次循环（5 s）没有更新则认为不可用
+#define IR_AUTO_WDR                 (0)     //按亮度统计自动开关宽动态（需要 sensor/MIPI 支持行 WDR，当前配置为 WDR_MODE_NONE）
+
+extern int hal_set_wdr(WDR_MODE_E wm);
+extern WDR_MODE_E hal_get_wdr(void);
+
 
 
 
@@ -263,12 +270,61 @@ HI_S32 ISP_IrSwitchToIr(ISP_DEV IspDev)
     return HI_SUCCESS;
 }
 
+/*******************************************************************************
+*@ Description    :取亮度统计模块的场景判决（白天/夜晚、是否逆光）
+*@ Input          :<last_seq> 上一次取到的统计序号
+					<stale> 统计序号连续没有变化的循环次数
+*@ Output         :<scene> 场景判决
+*@ Return         :1：统计结果可用  0：还没有统计结果或统计已停止（如 MD 线程退出）
+*@ attention      :统计在 MD 线程中每秒做一次，本线程 40ms 循环一次
+*******************************************************************************/
+static int ISP_IrLumaScene(luma_scene_t *scene, HLE_U32 *last_seq, int *stale)
+{
+	if (luma_stat_get_scene(scene) < 0)
+		return 0;
+
+	if (scene->seq != *last_seq)
+	{
+		*last_seq = scene->seq;
+		*stale = 0;
+	}
+	else if (*stale < IR_LUMA_STALE_LOOPS)
+	{
+		(*stale)++;
+	}
+
+	return *stale < IR_LUMA_STALE_LOOPS;
+}
+
+#if IR_AUTO_WDR
+/*******************************************************************************
+*@ Description    :按场景判决开关宽动态（只在正常模式下开启，夜视模式关闭）
+*@ Input          :<scene> 场景判决
+					<enIrStatus> 当前的红外状态
+*@ Output         :
+*@ Return         :
+*@ attention      :hal_set_wdr 会重启 VI 和 MD 线程，场景判决本身有 10 s 左右的迟滞
+*******************************************************************************/
+static void ISP_IrAutoWdr(const luma_scene_t *scene, ISP_IR_STATUS_E enIrStatus)
+{
+	WDR_MODE_E wm = (scene->wdr && ISP_IR_STATUS_NORMAL == enIrStatus) ? WDR_MODE_2To1_LINE : WDR_MODE_NONE;
+
+	if (wm != hal_get_wdr())
+	{
+		DEBUG_LOG("luma scene wdr %d, set wdr mode %d\n", scene->wdr, wm);
+		hal_set_wdr(wm);
+	}
+}
+#endif
+
 /*******************************************************************************
 *@ Description    :(正常/夜视) 模式自动切换线程函数
 *@ Input          :
 *@ Output         :
 *@ Return         :
-*@ attention      :
+*@ attention      :ISP 按 ISO 给出切换建议；正常 -> 夜视还要求亮度统计判定画面确实暗
+					（逆光、车灯等引起的增益跳变不切换），统计不可用时只按 ISP 的建议。
+					夜视 -> 正常只按 ISP 的建议（红外灯下画面亮度不能反映环境光）
 *******************************************************************************/
 HI_S32 ISP_IrAutoRun(ISP_DEV IspDev)
 {
@@ -284,6 +340,11 @@ HI_S32 ISP_IrAutoRun(ISP_DEV IspDev)
     stIrAttr.u32BGMin           = g_astIrAttr[IspDev].u32BGMin;
     stIrAttr.enIrStatus         = g_astIrAttr[IspDev].enIrStatus;
 
+    luma_scene_t stScene;
+    HLE_U32 u32LumaSeq = 0;
+    int s32LumaStale = IR_LUMA_STALE_LOOPS;
+    int s32Hold = 0; //ISP 建议切换但被亮度统计否决的次数
+
     while (HI_TRUE == g_astIrThread[IspDev].bThreadFlag)
     {
         /* run_interval: 40 ms */
@@ -297,8 +358,17 @@ HI_S32 ISP_IrAutoRun(ISP_DEV IspDev)
             return s32Ret;
         }
         
-        if (ISP_IR_SWITCH_TO_IR == stIrAttr.enIrSwitch) /* Normal to IR */
+        int bLumaValid = ISP_IrLumaScene(&stScene, &u32LumaSeq, &s32LumaStale);
+
+        if (ISP_IR_SWITCH_TO_IR == stIrAttr.enIrSwitch && bLumaValid && !stScene.night)
         {
+            /* ISO high but the picture is not dark: hold in normal mode */
+            if (0 == (s32Hold++ % 250))
+                printf("\n[Normal -> IR] hold, luma scene is day\n");
+        }
+        else if (ISP_IR_SWITCH_TO_IR == stIrAttr.enIrSwitch) /* Normal to IR */
+        {
+            s32Hold = 0;
             printf("\n[Normal -> IR]\n");
 
             s32Ret = ISP_IrSwitchToIr(IspDev);
@@ -325,6 +395,11 @@ HI_S32 ISP_IrAutoRun(ISP_DEV IspDev)
         }
         else
         {}
+
+#if IR_AUTO_WDR
+        if (bLumaValid)
+            ISP_IrAutoWdr(&stScene, stIrAttr.enIrStatus);
+#endif
     }
 
     return HI_SUCCESS;
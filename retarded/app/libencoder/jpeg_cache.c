@@ -0,0 +1,216 @@
+/***************************************************************************
+* @file:jpeg_cache.c
+* @author:
+* @date:  10,19,2026
+* @brief:  JPEG 抓拍服务：缓存 + 请求合并
+* @attention:每个通道、每种分辨率一个缓存项。编码期间不持有 jcache_ctx.mut，
+             同一个缓存项上后来的请求在条件变量上等待本次编码的结果（按 gen 判断编码已经结束）。
+             主机测试见 test/test_jpeg_cache.c
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "typeport.h"
+#include "hal_def.h"
+#include "encoder.h"
+#include "jpeg_cache.h"
+
+/*缓存项*/
+typedef struct _jcache_entry_t
+{
+    char *data;             //最近一次成功编码的图片
+    int size;
+    HLE_U32 capture_ms;     //抓拍时间（单调时钟，判断新鲜度）
+    HLE_U64 time_ms;        //抓拍时间（UTC）
+    int busy;               //正在编码
+    HLE_U32 gen;            //编码结束一次加 1
+    int ok;                 //最近一次编码是否成功
+}jcache_entry_t;
+
+typedef struct _jcache_ctx_t
+{
+    pthread_mutex_t mut;
+    pthread_cond_t cnd;
+    jpeg_encode_func encode;
+    jcache_entry_t entry[VI_PORT_NUM][IMAGE_SIZE_NR];
+    jpeg_cache_stat_t stat;
+    HLE_U64 total_encode_ms;
+    HLE_U32 encoded;        //成功编码的次数（计算平均耗时）
+}jcache_ctx_t;
+
+static jcache_ctx_t jcache_ctx = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+
+static HLE_U32 jcache_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (HLE_U32)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*拷贝一份给调用者（mut 已加锁）*/
+static char *jcache_copy(const jcache_entry_t *e, int *size, HLE_U64 *time_ms)
+{
+    char *data;
+
+    if (NULL == e->data)
+        return NULL;
+
+    data = (char *)malloc(e->size);
+    if (NULL == data)
+    {
+        ERROR_LOG("malloc %d fail!\n", e->size);
+        return NULL;
+    }
+    memcpy(data, e->data, e->size);
+    *size = e->size;
+    if (time_ms)
+        *time_ms = e->time_ms;
+    return data;
+}
+
+int jpeg_cache_init(jpeg_encode_func encode)
+{
+    if (NULL == encode)
+        return HLE_RET_EINVAL;
+
+    pthread_mutex_lock(&jcache_ctx.mut);
+    jcache_ctx.encode = encode;
+    memset(&jcache_ctx.stat, 0, sizeof (jcache_ctx.stat));
+    jcache_ctx.total_encode_ms = 0;
+    jcache_ctx.encoded = 0;
+    pthread_mutex_unlock(&jcache_ctx.mut);
+    return HLE_RET_OK;
+}
+
+void jpeg_cache_exit(void)
+{
+    int i, j;
+
+    pthread_mutex_lock(&jcache_ctx.mut);
+    for (i = 0; i < VI_PORT_NUM; i++)
+    {
+        for (j = 0; j < IMAGE_SIZE_NR; j++)
+        {
+            free(jcache_ctx.entry[i][j].data);
+            jcache_ctx.entry[i][j].data = NULL;
+        }
+    }
+    jcache_ctx.encode = NULL;
+    pthread_mutex_unlock(&jcache_ctx.mut);
+}
+
+/*
+ 功能：请求一张 JPEG
+ 注意：1.缓存的图片在 max_age_ms 以内：命中，直接拷贝
+       2.同一缓存项正在编码：等它结束，拷贝它的结果（合并）
+       3.否则本请求负责编码，结束后唤醒等待者
+*/
+char *jpeg_cache_request(int channel, int image_size, int max_age_ms, int *size, HLE_U64 *time_ms)
+{
+    jcache_entry_t *e;
+    jpeg_encode_func encode;
+    struct timeval tv;
+    HLE_U32 gen, t0, used;
+    char *data = NULL;
+    int len = 0;
+
+    if (channel < 0 || channel >= VI_PORT_NUM || image_size < 0 || image_size >= IMAGE_SIZE_NR
+        || NULL == size)
+    {
+        ERROR_LOG("invalid para!\n");
+        return NULL;
+    }
+
+    e = &jcache_ctx.entry[channel][image_size];
+    pthread_mutex_lock(&jcache_ctx.mut);
+    encode = jcache_ctx.encode;
+    if (NULL == encode)
+    {
+        pthread_mutex_unlock(&jcache_ctx.mut);
+        ERROR_LOG("jpeg cache not init!\n");
+        return NULL;
+    }
+    jcache_ctx.stat.requests++;
+
+    if (e->data && max_age_ms > 0 && jcache_now_ms() - e->capture_ms <= (HLE_U32)max_age_ms)
+    {
+        jcache_ctx.stat.hits++;
+        data = jcache_copy(e, size, time_ms);
+        pthread_mutex_unlock(&jcache_ctx.mut);
+        return data;
+    }
+
+    if (e->busy)
+    {
+        jcache_ctx.stat.merged++;
+        gen = e->gen;
+        while (e->gen == gen)
+            pthread_cond_wait(&jcache_ctx.cnd, &jcache_ctx.mut);
+        if (e->ok)
+            data = jcache_copy(e, size, time_ms);
+        pthread_mutex_unlock(&jcache_ctx.mut);
+        return data;
+    }
+
+    jcache_ctx.stat.misses++;
+    e->busy = 1;
+    pthread_mutex_unlock(&jcache_ctx.mut);
+
+    t0 = jcache_now_ms();
+    data = encode(channel, &len, image_size);
+    used = jcache_now_ms() - t0;
+
+    pthread_mutex_lock(&jcache_ctx.mut);
+    e->ok = (data != NULL && len > 0);
+    if (e->ok)
+    {
+        gettimeofday(&tv, NULL);
+        free(e->data);
+        e->data = data;
+        e->size = len;
+        e->capture_ms = jcache_now_ms();
+        e->time_ms = (HLE_U64)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+        jcache_ctx.total_encode_ms += used;
+        jcache_ctx.encoded++;
+        if (used > jcache_ctx.stat.max_encode_ms)
+            jcache_ctx.stat.max_encode_ms = used;
+        jcache_ctx.stat.avg_encode_ms = (HLE_U32)(jcache_ctx.total_encode_ms / jcache_ctx.encoded);
+        data = jcache_copy(e, size, time_ms);
+    }
+    else
+    {
+        free(data);
+        data = NULL;
+        jcache_ctx.stat.failures++;
+    }
+    e->busy = 0;
+    e->gen++;
+    pthread_cond_broadcast(&jcache_ctx.cnd);
+    pthread_mutex_unlock(&jcache_ctx.mut);
+
+    return data;
+}
+
+void jpeg_cache_get_stat(jpeg_cache_stat_t *stat, int clear)
+{
+    if (NULL == stat)
+        return;
+
+    pthread_mutex_lock(&jcache_ctx.mut);
+    *stat = jcache_ctx.stat;
+    if (clear)
+    {
+        memset(&jcache_ctx.stat, 0, sizeof (jcache_ctx.stat));
+        jcache_ctx.total_encode_ms = 0;
+        jcache_ctx.encoded = 0;
+    }
+    pthread_mutex_unlock(&jcache_ctx.mut);
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+* @file:jpeg_cache.h
+* @author:
+* @date:  10,19,2026
+* @brief:  JPEG 抓拍服务：按分辨率缓存最近一张抓拍，新鲜度窗口内直接返回，并发请求合并为一次编码
+* @attention:1.JPEG 通道每次抓拍都要重新配置、启动、等一帧再停止（几百毫秒），告警推送、APP 缩略图、
+               云端预览同时请求时，只有第一个请求真正编码，其他请求等待它的结果。
+             2.返回的图片是缓存的一份拷贝，调用者用 encoder_free_jpeg 释放（可以直接放入上传队列）。
+***************************************************************************/
+#ifndef _JPEG_CACHE_H
+#define _JPEG_CACHE_H
+
+#include "typeport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define JPEG_CACHE_MAX_AGE_MS   1000    //encoder_request_jpeg 使用的新鲜度窗口
+
+/*编码一张 JPEG（返回 malloc 的数据，失败返回 NULL），可能阻塞几百毫秒*/
+typedef char *(*jpeg_encode_func)(int channel, int *size, int image_size);
+
+/*抓拍统计*/
+typedef struct _jpeg_cache_stat_t
+{
+    HLE_U32 requests;       //请求次数
+    HLE_U32 hits;           //命中：新鲜度窗口内直接返回缓存
+    HLE_U32 merged;         //合并：等待正在进行的编码
+    HLE_U32 misses;         //未命中：发起一次编码
+    HLE_U32 failures;       //编码失败次数
+    HLE_U32 max_encode_ms;  //一次编码的最长耗时
+    HLE_U32 avg_encode_ms;  //编码的平均耗时
+}jpeg_cache_stat_t;
+
+
+/*
+    function:  jpeg_cache_init
+    description:  初始化抓拍服务
+    args:
+        jpeg_encode_func encode[in]，实际编码的函数（encoder.c 的 JPEG 通道）
+    return:
+        0, 成功
+        <0, 失败
+ */
+int jpeg_cache_init(jpeg_encode_func encode);
+
+/*
+    function:  jpeg_cache_exit
+    description:  释放缓存的图片（调用前所有请求都要已经返回）
+ */
+void jpeg_cache_exit(void);
+
+/*
+    function:  jpeg_cache_request
+    description:  请求一张 JPEG 图片
+    args:
+        int channel[in]，通道号
+        int image_size[in]，分辨率，见 E_IMAGE_SIZE
+        int max_age_ms[in]，可接受的缓存图片的最长时间，0 表示不使用缓存（仍会合并到正在进行的编码）
+        int *size[out]，图片大小
+        HLE_U64 *time_ms[out]，抓拍时间（UTC 毫秒），可以为 NULL
+    return:
+        non-NULL, 图片数据，用 encoder_free_jpeg 释放
+        NULL, 失败
+ */
+char *jpeg_cache_request(int channel, int image_size, int max_age_ms, int *size, HLE_U64 *time_ms);
+
+/*
+    function:  jpeg_cache_get_stat
+    description:  获取抓拍统计
+    args:
+        jpeg_cache_stat_t *stat[out]，统计
+        int clear[in]，1：读取后清零
+ */
+void jpeg_cache_get_stat(jpeg_cache_stat_t *stat, int clear);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
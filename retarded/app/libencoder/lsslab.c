@@ -146,15 +146,18 @@ int lsslab_free(LSSLAB_HANDLE hslab, void *obj)
 	return 0;
 }
 
-void lsslab_debug_info(LSSLAB_HANDLE hslab)
+int lsslab_get_usage(LSSLAB_HANDLE hslab, int *used, int *count)
 {
 	assert(hslab != NULL);
 
 	ls_slab *slab = (ls_slab *) hslab;
 
-	DEBUG_LOG("----------------lsslab_debug_info %p---------------\n", slab);
 	pthread_mutex_lock(&slab->lock);
-	DEBUG_LOG("total %d, used %d\n", slab->count, slab->used);
+	if (used)
+		*used = slab->used;
+	if (count)
+		*count = slab->count;
 	pthread_mutex_unlock(&slab->lock);
+	return 0;
 }
 
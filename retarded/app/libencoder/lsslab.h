@@ -49,5 +49,15 @@ void *lsslab_alloc(LSSLAB_HANDLE slab);
  * */
 int lsslab_free(LSSLAB_HANDLE slab, void *obj);
 
+/*
+ * function: int lsslab_get_usage(LSSLAB_HANDLE slab, int *used, int *count)
+ * description:
+ *		get the number of @used items and the total item @count of the specified @slab,
+ *		either pointer may be NULL
+ * return:
+ *		0, success
+ * */
+int lsslab_get_usage(LSSLAB_HANDLE slab, int *used, int *count);
+
 
 #endif
@@ -0,0 +1,390 @@
+/***************************************************************************
+* @file:luma_stat.c
+* @author:
+* @date:  10,19,2026
+* @brief:  Y 分量分块亮度统计和场景判决（WDR、IR-CUT、OSD 反色共用一次遍历的结果）
+* @attention:不依赖海思 SDK，可以在主机上用采集的图像做性能和正确性对比（test/test_luma_stat.c）
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "luma_stat.h"
+
+
+/*
+功能：一行中的一段像素求和（按 32 位字一次累加 4 个像素）
+参数：
+		@p：起始像素
+		@n：像素个数
+返回：像素值之和
+注意：每个字拆成两个 16 位通道（偶数字节和奇数字节）累加，一个通道每个字最多加 2 * 255，
+	  累加 128 个字（512 像素）后归并一次，不会溢出；首尾不对齐的部分逐字节处理
+*/
+static HLE_U32 luma_row_sum(const HLE_U8 *p, int n)
+{
+	HLE_U32 s = 0;
+
+	while (n > 0 && ((unsigned long)p & 3))
+	{
+		s += *p++;
+		n--;
+	}
+
+	const HLE_U32 *w = (const HLE_U32 *)p;
+	while (n >= 4)
+	{
+		int k = n >> 2;
+		if (k > 128)
+			k = 128;
+		n -= k << 2;
+
+		HLE_U32 acc = 0;
+		for (; k >= 2; k -= 2)
+		{
+			HLE_U32 a = w[0];
+			HLE_U32 b = w[1];
+			w += 2;
+			acc += (a & 0x00FF00FF) + ((a >> 8) & 0x00FF00FF);
+			acc += (b & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF);
+		}
+		if (k)
+		{
+			HLE_U32 a = *w++;
+			acc += (a & 0x00FF00FF) + ((a >> 8) & 0x00FF00FF);
+		}
+		s += (acc & 0xFFFF) + (acc >> 16);
+	}
+
+	p = (const HLE_U8 *)w;
+	while (n-- > 0)
+		s += *p++;
+
+	return s;
+}
+
+/*
+功能：采样行上的一段像素：求和、平方和，并累加直方图
+参数：
+		@p：起始像素
+		@n：像素个数
+		@hist：（入/返）直方图
+		@sum：（返）像素值之和
+		@sq：（返）平方和（一段不超过 65535 像素，不会溢出）
+注意：按字读入，一次取 4 个像素（ARMv5TE 没有 SIMD 指令，平方和直方图只能逐像素做）
+*/
+static void luma_row_full(const HLE_U8 *p, int n, HLE_U32 *hist, HLE_U32 *sum, HLE_U32 *sq)
+{
+	HLE_U32 s = 0;
+	HLE_U32 q = 0;
+	HLE_U32 v;
+
+	while (n > 0 && ((unsigned long)p & 3))
+	{
+		v = *p++;
+		hist[v]++;
+		s += v;
+		q += v * v;
+		n--;
+	}
+
+	const HLE_U32 *w = (const HLE_U32 *)p;
+	for (; n >= 4; n -= 4)
+	{
+		HLE_U32 x = *w++;
+		HLE_U32 v0 = x & 0xFF;
+		HLE_U32 v1 = (x >> 8) & 0xFF;
+		HLE_U32 v2 = (x >> 16) & 0xFF;
+		HLE_U32 v3 = x >> 24;
+
+		hist[v0]++;
+		hist[v1]++;
+		hist[v2]++;
+		hist[v3]++;
+		s += v0 + v1 + v2 + v3;
+		q += v0 * v0 + v1 * v1 + v2 * v2 + v3 * v3;
+	}
+
+	p = (const HLE_U8 *)w;
+	while (n-- > 0)
+	{
+		v = *p++;
+		hist[v]++;
+		s += v;
+		q += v * v;
+	}
+
+	*sum = s;
+	*sq = q;
+}
+
+int luma_stat_compute(const HLE_U8 *y, int width, int height, int stride,
+                      int tiles_x, int tiles_y, int hist_step, luma_stat_t *st)
+{
+	if (NULL == y || NULL == st || tiles_x < 1 || tiles_x > LUMA_TILE_MAX_X
+		|| tiles_y < 1 || tiles_y > LUMA_TILE_MAX_Y || width < tiles_x || height < tiles_y
+		|| width > 0xFFFF || height > 0xFFFF || stride < width || hist_step < 1)
+	{
+		ERROR_LOG("invalid param: %dx%d stride %d tiles %dx%d step %d\n",
+				  width, height, stride, tiles_x, tiles_y, hist_step);
+		return -1;
+	}
+
+	HLE_U16 xe[LUMA_TILE_MAX_X + 1];	//分块列边界
+	HLE_U32 sum[LUMA_TILE_MAX_X];		//当前分块行各分块的像素和（全部行）
+	HLE_U32 ssum[LUMA_TILE_MAX_X];		//采样行的像素和
+	HLE_U64 sq[LUMA_TILE_MAX_X];		//采样行的平方和
+	HLE_U64 total = 0;
+	int i, tx, ty, r;
+	int phase = 0;	//r % hist_step
+
+	for (i = 0; i <= tiles_x; i++)
+		xe[i] = i * width / tiles_x;
+
+	memset(st->hist, 0, sizeof (st->hist));
+	st->width = width;
+	st->height = height;
+	st->tiles_x = tiles_x;
+	st->tiles_y = tiles_y;
+
+	for (ty = 0; ty < tiles_y; ty++)
+	{
+		int y0 = ty * height / tiles_y;
+		int y1 = (ty + 1) * height / tiles_y;
+		int srows = 0;
+
+		memset(sum, 0, sizeof (sum));
+		memset(ssum, 0, sizeof (ssum));
+		memset(sq, 0, sizeof (sq));
+
+		/*按行遍历（与内存顺序一致），每行依次累加到各分块*/
+		for (r = y0; r < y1; r++)
+		{
+			const HLE_U8 *row = y + r * stride;
+
+			if (0 == phase)
+			{
+				for (tx = 0; tx < tiles_x; tx++)
+				{
+					HLE_U32 s, q;
+					luma_row_full(row + xe[tx], xe[tx + 1] - xe[tx], st->hist, &s, &q);
+					sum[tx] += s;
+					ssum[tx] += s;
+					sq[tx] += q;
+				}
+				srows++;
+			}
+			else
+			{
+				for (tx = 0; tx < tiles_x; tx++)
+					sum[tx] += luma_row_sum(row + xe[tx], xe[tx + 1] - xe[tx]);
+			}
+
+			if (++phase == hist_step)
+				phase = 0;
+		}
+
+		for (tx = 0; tx < tiles_x; tx++)
+		{
+			HLE_U32 w = xe[tx + 1] - xe[tx];
+			HLE_U32 n = w * (y1 - y0);
+			HLE_U32 ns = w * srows;
+
+			total += sum[tx];
+			st->tile_mean[ty][tx] = (sum[tx] + n / 2) / n;
+			if (ns)
+				st->tile_var[ty][tx] = (sq[tx] - (HLE_U64)ssum[tx] * ssum[tx] / ns) / ns;
+			else
+				st->tile_var[ty][tx] = 0;
+		}
+	}
+
+	/*整幅图像：均值用全部像素，方差用直方图（采样行）*/
+	HLE_U32 npix = width * height;
+	HLE_U64 hs = 0, hq = 0;
+	HLE_U32 hn = 0;
+	for (i = 0; i < LUMA_HIST_BINS; i++)
+	{
+		HLE_U32 c = st->hist[i];
+		hn += c;
+		hs += (HLE_U64)c * i;
+		hq += (HLE_U64)c * (i * i);
+	}
+	st->mean = (total + npix / 2) / npix;
+	st->samples = hn;
+	st->variance = hn ? (HLE_U32)((hq - hs * hs / hn) / hn) : 0;
+
+	return 0;
+}
+
+int luma_stat_hist_percent(const luma_stat_t *st, int lo, int hi)
+{
+	HLE_U32 c = 0;
+	int i;
+
+	if (lo < 0)
+		lo = 0;
+	if (hi > LUMA_HIST_BINS - 1)
+		hi = LUMA_HIST_BINS - 1;
+	if (0 == st->samples)
+		return 0;
+
+	for (i = lo; i <= hi; i++)
+		c += st->hist[i];
+
+	return (HLE_U64)c * 100 / st->samples;
+}
+
+void luma_scene_update(luma_scene_t *sc, const luma_stat_t *st)
+{
+	/*---白天/夜晚：门限之间不计数，连续 LUMA_NIGHT_HYST 次才切换---*/
+	if (st->mean < LUMA_NIGHT_MEAN)
+	{
+		if (sc->night_count < LUMA_NIGHT_HYST)
+			sc->night_count++;
+	}
+	else if (st->mean > LUMA_DAY_MEAN)
+	{
+		if (sc->night_count > 0)
+			sc->night_count--;
+	}
+	if (sc->night_count >= LUMA_NIGHT_HYST)
+		sc->night = 1;
+	else if (sc->night_count <= 0)
+		sc->night = 0;
+
+	/*---逆光：暗部和接近饱和的亮部同时占一定比例，且分布分散---*/
+	int backlit = luma_stat_hist_percent(st, 0, LUMA_WDR_DARK - 1) >= LUMA_WDR_DARK_PCT
+			&& luma_stat_hist_percent(st, LUMA_WDR_BRIGHT, LUMA_HIST_BINS - 1) >= LUMA_WDR_BRIGHT_PCT
+			&& st->variance >= LUMA_WDR_VAR;
+	if (backlit)
+	{
+		if (sc->wdr_count < LUMA_WDR_HYST)
+			sc->wdr_count++;
+	}
+	else if (sc->wdr_count > 0)
+	{
+		sc->wdr_count--;
+	}
+	if (sc->wdr_count >= LUMA_WDR_HYST)
+		sc->wdr = 1;
+	else if (sc->wdr_count <= 0)
+		sc->wdr = 0;
+
+	sc->seq = st->seq;
+}
+
+
+/*---最近一次的统计结果：luma_stat_feed 在送帧的线程中写，其他线程读---*/
+static pthread_mutex_t luma_lock = PTHREAD_MUTEX_INITIALIZER;
+static luma_stat_t luma_last;		//最近一次的结果（luma_lock 保护）
+static luma_scene_t luma_scene;		//场景判决（luma_lock 保护）
+static luma_stat_t luma_work;		//统计缓冲，只在送帧的线程中使用
+static int luma_frame_count;
+
+int luma_stat_due(void)
+{
+	if (++luma_frame_count < LUMA_STAT_INTERVAL)
+		return 0;
+
+	luma_frame_count = 0;
+	return 1;
+}
+
+int luma_stat_feed(const HLE_U8 *y, int width, int height, int stride)
+{
+	int tiles_x = (width < LUMA_TILES_X) ? width : LUMA_TILES_X;
+	int tiles_y = (height < LUMA_TILES_Y) ? height : LUMA_TILES_Y;
+
+	//在锁外统计，锁内只拷贝结果
+	if (luma_stat_compute(y, width, height, stride, tiles_x, tiles_y, LUMA_HIST_STEP, &luma_work) < 0)
+		return -1;
+
+	pthread_mutex_lock(&luma_lock);
+	luma_work.seq = luma_last.seq + 1;
+	if (0 == luma_work.seq)
+		luma_work.seq = 1;
+	memcpy(&luma_last, &luma_work, sizeof (luma_last));
+	luma_scene_update(&luma_scene, &luma_last);
+	pthread_mutex_unlock(&luma_lock);
+
+	return 0;
+}
+
+int luma_stat_get(luma_stat_t *st)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&luma_lock);
+	if (luma_last.seq)
+	{
+		memcpy(st, &luma_last, sizeof (*st));
+		ret = 0;
+	}
+	pthread_mutex_unlock(&luma_lock);
+
+	return ret;
+}
+
+int luma_stat_get_scene(luma_scene_t *sc)
+{
+	pthread_mutex_lock(&luma_lock);
+	*sc = luma_scene;
+	pthread_mutex_unlock(&luma_lock);
+
+	return sc->seq ? 0 : -1;
+}
+
+int luma_stat_region_mean(int x, int y, int w, int h, int coord_w, int coord_h)
+{
+	if (w <= 0 || h <= 0 || coord_w <= 0 || coord_h <= 0)
+		return -1;
+
+	pthread_mutex_lock(&luma_lock);
+	const luma_stat_t *st = &luma_last;
+	if (0 == st->seq)
+	{
+		pthread_mutex_unlock(&luma_lock);
+		return -1;
+	}
+
+	/*换算到统计图像的像素坐标*/
+	int x0 = (HLE_S64)x * st->width / coord_w;
+	int x1 = (HLE_S64)(x + w) * st->width / coord_w;
+	int y0 = (HLE_S64)y * st->height / coord_h;
+	int y1 = (HLE_S64)(y + h) * st->height / coord_h;
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > st->width) x1 = st->width;
+	if (y1 > st->height) y1 = st->height;
+	if (x1 <= x0) x1 = x0 + 1;
+	if (y1 <= y0) y1 = y0 + 1;
+
+	HLE_U64 acc = 0;
+	HLE_U32 area = 0;
+	int tx, ty;
+	for (ty = 0; ty < st->tiles_y; ty++)
+	{
+		int ty0 = ty * st->height / st->tiles_y;
+		int ty1 = (ty + 1) * st->height / st->tiles_y;
+		int oy = ((ty1 < y1) ? ty1 : y1) - ((ty0 > y0) ? ty0 : y0);
+		if (oy <= 0)
+			continue;
+
+		for (tx = 0; tx < st->tiles_x; tx++)
+		{
+			int tx0 = tx * st->width / st->tiles_x;
+			int tx1 = (tx + 1) * st->width / st->tiles_x;
+			int ox = ((tx1 < x1) ? tx1 : x1) - ((tx0 > x0) ? tx0 : x0);
+			if (ox <= 0)
+				continue;
+
+			acc += (HLE_U32)(ox * oy) * st->tile_mean[ty][tx];
+			area += ox * oy;
+		}
+	}
+	pthread_mutex_unlock(&luma_lock);
+
+	return area ? (int)((acc + area / 2) / area) : -1;
+}
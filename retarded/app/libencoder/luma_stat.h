@@ -0,0 +1,156 @@
+/***************************************************************************
+* @file:luma_stat.h
+* @author:
+* @date:  10,19,2026
+* @brief:  Y 分量分块亮度统计（分块均值/方差 + 直方图）和场景判决（白天/夜晚、是否需要宽动态）
+* @attention:一次遍历得到全部统计量，WDR、IR-CUT 和 OSD 反色都使用同一份统计结果。
+             统计在 MD 线程中每 LUMA_STAT_INTERVAL 帧做一次（输入为 MD 通道 480x272 的 Y 分量），
+             其他线程通过 luma_stat_get/luma_stat_get_scene/luma_stat_region_mean 取最近一次的结果。
+***************************************************************************/
+#ifndef _LUMA_STAT_H
+#define _LUMA_STAT_H
+
+#include "typeport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LUMA_TILE_MAX_X     32      //最多分块列数
+#define LUMA_TILE_MAX_Y     32      //最多分块行数
+#define LUMA_TILES_X        16      //默认分块列数（480/16 = 30 像素）
+#define LUMA_TILES_Y        9       //默认分块行数（272/9 ≈ 30 像素）
+#define LUMA_HIST_BINS      256
+#define LUMA_HIST_STEP      2       //直方图和方差隔行采样，均值使用全部像素
+#define LUMA_STAT_INTERVAL  5       //每 N 帧统计一次（MD 通道 5fps，即每秒一次）
+
+/*一次统计的结果*/
+typedef struct _luma_stat_t
+{
+    HLE_U16 width;                  //统计的图像宽高
+    HLE_U16 height;
+    HLE_U8  tiles_x;                //分块列数、行数
+    HLE_U8  tiles_y;
+    HLE_U8  mean;                   //整幅图像的平均亮度
+    HLE_U8  reserved;
+    HLE_U32 variance;               //整幅图像的亮度方差（采样行）
+    HLE_U32 samples;                //直方图的像素数
+    HLE_U32 seq;                    //统计序号，每统计一次加 1
+    HLE_U32 hist[LUMA_HIST_BINS];   //亮度直方图（采样行）
+    HLE_U8  tile_mean[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X];    //各分块的平均亮度
+    HLE_U16 tile_var[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X];     //各分块的亮度方差（采样行）
+}luma_stat_t;
+
+/*场景判决（带迟滞：亮度门限之间有间隔，且要连续多次满足才改变状态）*/
+typedef struct _luma_scene_t
+{
+    HLE_S32 night;          //1：画面暗（夜晚），0：白天
+    HLE_S32 night_count;    //[0, LUMA_NIGHT_HYST]
+    HLE_S32 wdr;            //1：逆光/大动态范围场景，建议开启宽动态
+    HLE_S32 wdr_count;      //[0, LUMA_WDR_HYST]
+    HLE_U32 seq;            //对应的统计序号，0 表示还没有统计结果
+}luma_scene_t;
+
+#define LUMA_NIGHT_MEAN     40      //平均亮度低于该值计为暗
+#define LUMA_DAY_MEAN       80      //平均亮度高于该值计为亮，两者之间保持计数不变
+#define LUMA_NIGHT_HYST     5       //连续 N 次统计（约 N 秒）才切换白天/夜晚
+#define LUMA_WDR_DARK       48      //暗像素亮度上限
+#define LUMA_WDR_BRIGHT     224     //亮像素（接近饱和）亮度下限
+#define LUMA_WDR_DARK_PCT   25      //暗像素占比 >= 25%
+#define LUMA_WDR_BRIGHT_PCT 5       //并且亮像素占比 >= 5%
+#define LUMA_WDR_VAR        3600    //并且方差 >= 60^2（双峰分布）才认为是逆光场景
+#define LUMA_WDR_HYST       10      //连续 N 次统计才改变宽动态建议
+
+
+/*
+    function:  luma_stat_compute
+    description:  一次遍历 Y 分量，得到分块均值、分块方差、直方图和整幅图像的均值/方差
+    args:
+        const HLE_U8 *y[in]，左上角像素地址
+        int width[in] int height[in]，图像宽高（任意值，不需要对齐）
+        int stride[in]，行跨度（字节）
+        int tiles_x[in] int tiles_y[in]，分块列数、行数 [1, LUMA_TILE_MAX_X/Y]，分块边界为 i * width / tiles_x
+        int hist_step[in]，直方图和方差的采样行间隔（1 为逐行）
+        luma_stat_t *st[out]，统计结果（seq 不修改）
+    return:
+        0, 成功
+        <0, 失败
+    attention:
+        均值按 32 位字一次累加 4 个像素；直方图和方差所在的采样行逐字节处理
+ */
+int luma_stat_compute(const HLE_U8 *y, int width, int height, int stride,
+                      int tiles_x, int tiles_y, int hist_step, luma_stat_t *st);
+
+/*
+    function:  luma_stat_hist_percent
+    description:  亮度在 [lo, hi] 之间的像素占比
+    return:
+        百分比 [0, 100]
+ */
+int luma_stat_hist_percent(const luma_stat_t *st, int lo, int hi);
+
+/*
+    function:  luma_scene_update
+    description:  用一次统计结果更新场景判决
+ */
+void luma_scene_update(luma_scene_t *sc, const luma_stat_t *st);
+
+/*
+    function:  luma_stat_due
+    description:  帧计数，每 LUMA_STAT_INTERVAL 帧返回一次 1（只在送统计的线程中调用）
+    return:
+        1, 本帧需要统计
+        0, 跳过
+ */
+int luma_stat_due(void);
+
+/*
+    function:  luma_stat_feed
+    description:  统计一帧 Y 分量（默认分块数和采样间隔），保存为最近一次的结果并更新场景判决
+    args:
+        const HLE_U8 *y[in]，左上角像素地址
+        int width[in] int height[in] int stride[in]，图像宽高和行跨度
+    return:
+        0, 成功
+        <0, 失败
+ */
+int luma_stat_feed(const HLE_U8 *y, int width, int height, int stride);
+
+/*
+    function:  luma_stat_get
+    description:  取最近一次的统计结果
+    return:
+        0, 成功
+        <0, 还没有统计结果
+ */
+int luma_stat_get(luma_stat_t *st);
+
+/*
+    function:  luma_stat_get_scene
+    description:  取最近一次的场景判决
+    return:
+        0, 成功
+        <0, 还没有统计结果
+ */
+int luma_stat_get_scene(luma_scene_t *sc);
+
+/*
+    function:  luma_stat_region_mean
+    description:  最近一次统计中某个矩形区域的平均亮度（按与区域相交的分块的面积加权）
+    args:
+        int x[in] int y[in] int w[in] int h[in]，区域（坐标系大小为 coord_w x coord_h，如编码图像大小或相对坐标系）
+        int coord_w[in] int coord_h[in]，坐标系大小
+    return:
+        >=0, 平均亮度 [0, 255]
+        <0, 还没有统计结果或参数错误
+ */
+int luma_stat_region_mean(int x, int y, int w, int h, int coord_w, int coord_h);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,762 @@
+/***************************************************************************
+* @file:md_engine.c
+* @author:
+* @date:  10,19,2026
+* @brief:  软件移动侦测引擎：4x4 宏块 SAD（背景法）+ 区域掩码 + 4-连通区域标记 + 多检测区域统计
+* @attention:不依赖海思 SDK，可以在主机上用采集的 YUV 序列做回归和误报统计（test/test_md_engine.c）
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "md_engine.h"
+
+
+/*一行中连续的运动宏块*/
+typedef struct _md_run_t
+{
+	HLE_U16 start;		//起始宏块列
+	HLE_U16 end;		//结束宏块列（不含）
+	HLE_U16 row;		//宏块行
+	HLE_U16 reserved;
+}md_run_t;
+
+struct _md_engine_t
+{
+	int width;			//参与检测的宽高（宏块对齐）
+	int height;
+	int bw;				//宏块列数、行数
+	int bh;
+	int words;			//位图每行的 32 位字数
+	int has_bg;			//是否已经有背景
+	HLE_U16 sad_thr;
+	HLE_U32 init_area_thr;
+	HLE_U32 area_step;
+
+	HLE_U8 *bg;			//背景（width * height，行跨度为 width）
+	HLE_U32 *sad_acc;	//当前宏块行各宏块的 SAD 累加值（两个 16 位通道）
+	HLE_U32 *mask;		//检测区域位图
+	HLE_U32 *motion;	//运动宏块位图
+
+	int max_runs;
+	md_run_t *runs;
+	HLE_S32 *parent;	//并查集；标记完成后复用为临时区域到输出区域的下标映射
+	HLE_S32 *slot;		//各行程所属的临时区域下标
+	md_blob_t *tmp;		//临时区域（过滤前）
+
+	const md_zone_map_t *zones;	//检测区域位图
+};
+
+/*检测区域：每个区域一个宏块位图，格式与运动位图相同*/
+struct _md_zone_map_t
+{
+	int bw;
+	int bh;
+	int words;
+	HLE_U32 used;						//已设置的区域掩码
+	HLE_U32 min_area[MD_ZONE_MAX];		//最小目标面积（像素）
+	HLE_U32 area[MD_ZONE_MAX];			//区域面积（像素）
+	HLE_U32 *plane[MD_ZONE_MAX];
+};
+
+
+md_engine_t *md_engine_create(int width, int height)
+{
+	md_engine_t *eng;
+	int bw = width / MD_BLOCK_SIZE;
+	int bh = height / MD_BLOCK_SIZE;
+
+	if (bw <= 0 || bh <= 0 || bw > 0xFFFF / MD_BLOCK_SIZE || bh > 0xFFFF / MD_BLOCK_SIZE)
+	{
+		ERROR_LOG("illegal size %dx%d\n", width, height);
+		return NULL;
+	}
+
+	eng = (md_engine_t *)calloc(1, sizeof(md_engine_t));
+	if (NULL == eng)
+	{
+		ERROR_LOG("calloc fail!\n");
+		return NULL;
+	}
+
+	eng->bw = bw;
+	eng->bh = bh;
+	eng->width = bw * MD_BLOCK_SIZE;
+	eng->height = bh * MD_BLOCK_SIZE;
+	eng->words = (bw + 31) >> 5;
+	eng->max_runs = bh * ((bw + 1) / 2);	//每行最多 (bw+1)/2 个行程
+	eng->sad_thr = 200;
+	eng->init_area_thr = MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+	eng->area_step = MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+
+	eng->bg = (HLE_U8 *)malloc(eng->width * eng->height);
+	eng->sad_acc = (HLE_U32 *)malloc(bw * sizeof(HLE_U32));
+	eng->mask = (HLE_U32 *)malloc(eng->words * bh * sizeof(HLE_U32));
+	eng->motion = (HLE_U32 *)calloc(eng->words * bh, sizeof(HLE_U32));
+	eng->runs = (md_run_t *)malloc(eng->max_runs * sizeof(md_run_t));
+	eng->parent = (HLE_S32 *)malloc(eng->max_runs * sizeof(HLE_S32));
+	eng->slot = (HLE_S32 *)malloc(eng->max_runs * sizeof(HLE_S32));
+	eng->tmp = (md_blob_t *)malloc(eng->max_runs * sizeof(md_blob_t));
+	if (!eng->bg || !eng->sad_acc || !eng->mask || !eng->motion
+		|| !eng->runs || !eng->parent || !eng->slot || !eng->tmp)
+	{
+		ERROR_LOG("malloc fail!\n");
+		md_engine_destroy(eng);
+		return NULL;
+	}
+
+	md_engine_set_mask(eng, NULL);
+	return eng;
+}
+
+void md_engine_destroy(md_engine_t *eng)
+{
+	if (NULL == eng)
+		return;
+
+	free(eng->bg);
+	free(eng->sad_acc);
+	free(eng->mask);
+	free(eng->motion);
+	free(eng->runs);
+	free(eng->parent);
+	free(eng->slot);
+	free(eng->tmp);
+	free(eng);
+}
+
+void md_engine_set_sad_thr(md_engine_t *eng, HLE_U16 sad_thr)
+{
+	eng->sad_thr = sad_thr;
+}
+
+void md_engine_set_area_thr(md_engine_t *eng, HLE_U32 init_thr, HLE_U32 step)
+{
+	eng->init_area_thr = init_thr;
+	eng->area_step = step ? step : MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+}
+
+int md_engine_set_mask(md_engine_t *eng, const HLE_U8 *mask)
+{
+	int bx, by;
+
+	if (NULL == eng)
+		return -1;
+
+	memset(eng->mask, 0, eng->words * eng->bh * sizeof(HLE_U32));
+	for (by = 0; by < eng->bh; by++)
+	{
+		HLE_U32 *row = eng->mask + by * eng->words;
+		for (bx = 0; bx < eng->bw; bx++)
+		{
+			if (NULL == mask || mask[by * eng->bw + bx])
+				row[bx >> 5] |= 0x80000000U >> (bx & 31);
+		}
+	}
+
+	return 0;
+}
+
+int md_engine_blocks_w(const md_engine_t *eng)
+{
+	return eng->bw;
+}
+
+int md_engine_blocks_h(const md_engine_t *eng)
+{
+	return eng->bh;
+}
+
+void md_engine_reset(md_engine_t *eng)
+{
+	eng->has_bg = 0;
+}
+
+const HLE_U32 *md_engine_motion_map(const md_engine_t *eng, int *words_per_row)
+{
+	if (words_per_row)
+		*words_per_row = eng->words;
+	return eng->motion;
+}
+
+
+/*
+功能：一个 32 位字中 4 个像素差的绝对值，按两个 16 位通道求和
+参数：
+		@c：当前帧 4 个像素
+		@b：背景 4 个像素
+返回：低 16 位和高 16 位各是两个像素差的绝对值之和（最大 510）
+注意：偶数/奇数字节分别放在 16 位通道中，每个通道先加 0x100 再相减不会向相邻通道借位，
+	  结果的 bit8 为 1 表示 c >= b，否则对低 8 位取补得到绝对值
+*/
+static inline HLE_U32 md_absdiff_lanes(HLE_U32 c, HLE_U32 b)
+{
+	HLE_U32 d0 = ((c & 0x00FF00FF) | 0x01000100) - (b & 0x00FF00FF);
+	HLE_U32 d1 = (((c >> 8) & 0x00FF00FF) | 0x01000100) - ((b >> 8) & 0x00FF00FF);
+	HLE_U32 n0 = (~d0 >> 8) & 0x00010001;	//c < b 的通道为 1
+	HLE_U32 n1 = (~d1 >> 8) & 0x00010001;
+
+	d0 = ((d0 & 0x00FF00FF) ^ ((n0 << 8) - n0)) + n0;
+	d1 = ((d1 & 0x00FF00FF) ^ ((n1 << 8) - n1)) + n1;
+	return d0 + d1;
+}
+
+//4 个像素分别求平均（向下取整），即 0.5*当前帧 + 0.5*背景
+static inline HLE_U32 md_avg4(HLE_U32 c, HLE_U32 b)
+{
+	return (c & b) + (((c ^ b) & 0xFEFEFEFE) >> 1);
+}
+
+//一行宏块的 SAD 阈值化，与掩码相与后写入运动位图
+static void md_threshold_row(md_engine_t *eng, int by)
+{
+	HLE_U32 *row = eng->motion + by * eng->words;
+	const HLE_U32 *mask = eng->mask + by * eng->words;
+	const HLE_U32 *acc = eng->sad_acc;
+	HLE_U32 thr = eng->sad_thr;
+	int bx, wi;
+
+	for (wi = 0; wi < eng->words; wi++)
+	{
+		HLE_U32 bits = 0;
+		int end = (wi + 1) << 5;
+
+		if (end > eng->bw)
+			end = eng->bw;
+		for (bx = wi << 5; bx < end; bx++)
+		{
+			HLE_U32 sad = (acc[bx] & 0xFFFF) + (acc[bx] >> 16);
+			if (sad >= thr)
+				bits |= 0x80000000U >> (bx & 31);
+		}
+		row[wi] = bits & mask[wi];
+	}
+}
+
+/*SAD + 背景更新：每次处理一个 32 位字（4 个像素，正好是一个宏块的一行）*/
+static void md_sad_swar(md_engine_t *eng, const HLE_U8 *y, int stride)
+{
+	HLE_U32 *bg = (HLE_U32 *)eng->bg;
+	HLE_U32 *acc = eng->sad_acc;
+	int bw = eng->bw;
+	int bx, by, r;
+
+	for (by = 0; by < eng->bh; by++)
+	{
+		memset(acc, 0, bw * sizeof(HLE_U32));
+		for (r = 0; r < MD_BLOCK_SIZE; r++)
+		{
+			const HLE_U32 *cur = (const HLE_U32 *)(y + (by * MD_BLOCK_SIZE + r) * stride);
+			for (bx = 0; bx < bw; bx++)
+			{
+				HLE_U32 c = cur[bx];
+				HLE_U32 b = bg[bx];
+				acc[bx] += md_absdiff_lanes(c, b);
+				bg[bx] = md_avg4(c, b);
+			}
+			bg += bw;
+		}
+		md_threshold_row(eng, by);
+	}
+}
+
+/*逐像素实现：输入地址或跨度不是 4 字节对齐时使用，结果与 md_sad_swar 相同*/
+static void md_sad_c(md_engine_t *eng, const HLE_U8 *y, int stride)
+{
+	HLE_U8 *bg = eng->bg;
+	HLE_U32 *acc = eng->sad_acc;
+	int x, by, r;
+
+	for (by = 0; by < eng->bh; by++)
+	{
+		memset(acc, 0, eng->bw * sizeof(HLE_U32));
+		for (r = 0; r < MD_BLOCK_SIZE; r++)
+		{
+			const HLE_U8 *cur = y + (by * MD_BLOCK_SIZE + r) * stride;
+			for (x = 0; x < eng->width; x++)
+			{
+				int d = cur[x] - bg[x];
+				acc[x / MD_BLOCK_SIZE] += (d < 0) ? -d : d;
+				bg[x] = (cur[x] + bg[x]) >> 1;
+			}
+			bg += eng->width;
+		}
+		md_threshold_row(eng, by);
+	}
+}
+
+static inline int md_popcount(HLE_U32 v)
+{
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+//区域 zone 在第 row 行宏块 [start, end) 中的宏块数：按字取出行程范围的掩码与区域位图相与
+static int md_zone_count(const md_zone_map_t *map, int zone, int row, int start, int end)
+{
+	const HLE_U32 *plane = map->plane[zone] + row * map->words;
+	int wi, n = 0;
+
+	for (wi = start >> 5; wi <= (end - 1) >> 5; wi++)
+	{
+		int lo = start - (wi << 5);
+		int hi = end - (wi << 5);
+		HLE_U32 m = (lo > 0) ? (0xFFFFFFFFU >> lo) : 0xFFFFFFFFU;
+		if (hi < 32)
+			m &= ~(0xFFFFFFFFU >> hi);
+		n += md_popcount(plane[wi] & m);
+	}
+	return n;
+}
+
+static inline HLE_S32 md_find(HLE_S32 *parent, HLE_S32 i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];	//路径减半
+		i = parent[i];
+	}
+	return i;
+}
+
+//合并两个集合，以下标小的行程为根（区域按光栅顺序输出）
+static inline void md_union(HLE_S32 *parent, HLE_S32 a, HLE_S32 b)
+{
+	a = md_find(parent, a);
+	b = md_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+/*
+功能：对运动位图做 4-连通区域标记，统计各区域面积和外接矩形，按面积阈值过滤后输出
+返回：输出的区域个数
+注意：每行先用 CLZ 从位图中提取行程（全 0 的字直接跳过），再与上一行重叠的行程合并
+*/
+static int md_label(md_engine_t *eng, md_result_t *res)
+{
+	md_run_t *runs = eng->runs;
+	HLE_S32 *parent = eng->parent;
+	int nruns = 0;
+	int prev_begin = 0;
+	int by, wi, i, j, nb;
+	HLE_U32 thr;
+
+	for (by = 0; by < eng->bh; by++)
+	{
+		const HLE_U32 *row = eng->motion + by * eng->words;
+		int cur_begin = nruns;
+
+		for (wi = 0; wi < eng->words; wi++)
+		{
+			HLE_U32 w = row[wi];
+			while (w)
+			{
+				int s = __builtin_clz(w);
+				HLE_U32 inv = ~(w << s);
+				int len = inv ? __builtin_clz(inv) : 32;
+				int start = (wi << 5) + s;
+
+				if (nruns > cur_begin && runs[nruns - 1].end == start)
+				{
+					runs[nruns - 1].end = start + len;	//跨字的行程
+				}
+				else
+				{
+					runs[nruns].start = start;
+					runs[nruns].end = start + len;
+					runs[nruns].row = by;
+					parent[nruns] = nruns;
+					nruns++;
+				}
+				w = (s + len >= 32) ? 0 : (w & (0xFFFFFFFFU >> (s + len)));
+			}
+		}
+
+		//与上一行的行程合并（两行的行程都按列有序）
+		i = prev_begin;
+		j = cur_begin;
+		while (i < cur_begin && j < nruns)
+		{
+			if (runs[i].end > runs[j].start && runs[j].end > runs[i].start)
+				md_union(parent, i, j);
+			if (runs[i].end < runs[j].end)
+				i++;
+			else
+				j++;
+		}
+		prev_begin = cur_begin;
+	}
+
+	//统计：根是集合中下标最小的行程，一定先于其他成员遇到
+	nb = 0;
+	for (i = 0; i < nruns; i++)
+	{
+		HLE_S32 r = md_find(parent, i);
+		md_blob_t *b;
+		HLE_U16 left = runs[i].start * MD_BLOCK_SIZE;
+		HLE_U16 right = runs[i].end * MD_BLOCK_SIZE - 1;
+		HLE_U16 top = runs[i].row * MD_BLOCK_SIZE;
+
+		if (r == i)
+		{
+			eng->slot[i] = nb;
+			b = &eng->tmp[nb++];
+			b->area = 0;
+			b->left = left;
+			b->right = right;
+			b->top = top;
+		}
+		else
+		{
+			eng->slot[i] = eng->slot[r];
+			b = &eng->tmp[eng->slot[i]];
+			if (left < b->left)
+				b->left = left;
+			if (right > b->right)
+				b->right = right;
+		}
+		b->bottom = top + MD_BLOCK_SIZE - 1;
+		b->area += (runs[i].end - runs[i].start) * MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+	}
+
+	//面积阈值：区域太多时按步长增大（与 IVE CCL 一致）
+	thr = eng->init_area_thr;
+	for (;;)
+	{
+		int n = 0;
+		for (i = 0; i < nb; i++)
+		{
+			if (eng->tmp[i].area >= thr)
+				n++;
+		}
+		if (n <= MD_MAX_BLOBS)
+			break;
+		thr += eng->area_step;
+	}
+
+	res->area_thr = thr;
+	res->motion_area = 0;
+	res->blob_num = 0;
+	memset(res->zone_area, 0, sizeof(res->zone_area));
+	for (i = 0; i < nb; i++)
+	{
+		if (eng->tmp[i].area >= thr)
+		{
+			parent[i] = res->blob_num;
+			res->blob[res->blob_num] = eng->tmp[i];
+			res->blob[res->blob_num].zones = 0;
+			res->blob_num++;
+			res->motion_area += eng->tmp[i].area;
+		}
+		else
+		{
+			parent[i] = -1;
+		}
+	}
+
+	//各行程与区域位图相与，统计落在区域内的面积
+	if (eng->zones && eng->zones->used)
+	{
+		const md_zone_map_t *map = eng->zones;
+		for (i = 0; i < nruns; i++)
+		{
+			HLE_S32 o = parent[eng->slot[i]];
+			md_blob_t *b;
+			int z;
+
+			if (o < 0)
+				continue;
+			b = &res->blob[o];
+			for (z = 0; z < MD_ZONE_MAX; z++)
+			{
+				int n;
+				if (!(map->used & (1U << z)) || b->area < map->min_area[z])
+					continue;
+				n = md_zone_count(map, z, runs[i].row, runs[i].start, runs[i].end);
+				if (n)
+				{
+					res->zone_area[z] += n * MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+					b->zones |= 1U << z;
+				}
+			}
+		}
+	}
+
+	return res->blob_num;
+}
+
+int md_engine_process(md_engine_t *eng, const HLE_U8 *y, int stride, md_result_t *result)
+{
+	if (NULL == eng || NULL == y || NULL == result || stride < eng->width)
+	{
+		ERROR_LOG("illegal parameter!\n");
+		return -1;
+	}
+
+	if (!eng->has_bg)
+	{
+		int r;
+		for (r = 0; r < eng->height; r++)
+			memcpy(eng->bg + r * eng->width, y + r * stride, eng->width);
+		memset(eng->motion, 0, eng->words * eng->bh * sizeof(HLE_U32));
+		eng->has_bg = 1;
+		result->area_thr = eng->init_area_thr;
+		result->motion_area = 0;
+		result->blob_num = 0;
+		memset(result->zone_area, 0, sizeof(result->zone_area));
+		return 0;
+	}
+
+	if (0 == ((unsigned long)y & 3) && 0 == (stride & 3))
+		md_sad_swar(eng, y, stride);
+	else
+		md_sad_c(eng, y, stride);
+
+	return md_label(eng, result);
+}
+
+int md_engine_set_zones(md_engine_t *eng, const md_zone_map_t *map)
+{
+	if (NULL == eng)
+		return -1;
+	if (map && (map->bw != eng->bw || map->bh != eng->bh))
+	{
+		ERROR_LOG("zone map %dx%d != engine %dx%d\n", map->bw, map->bh, eng->bw, eng->bh);
+		return -1;
+	}
+
+	eng->zones = map;
+	return 0;
+}
+
+md_zone_map_t *md_zone_create(int bw, int bh)
+{
+	md_zone_map_t *map;
+	int z;
+
+	if (bw <= 0 || bh <= 0)
+		return NULL;
+
+	map = (md_zone_map_t *)calloc(1, sizeof(md_zone_map_t));
+	if (NULL == map)
+	{
+		ERROR_LOG("calloc fail!\n");
+		return NULL;
+	}
+
+	map->bw = bw;
+	map->bh = bh;
+	map->words = (bw + 31) >> 5;
+	for (z = 0; z < MD_ZONE_MAX; z++)
+	{
+		map->plane[z] = (HLE_U32 *)calloc(map->words * bh, sizeof(HLE_U32));
+		if (NULL == map->plane[z])
+		{
+			ERROR_LOG("calloc fail!\n");
+			md_zone_destroy(map);
+			return NULL;
+		}
+	}
+
+	return map;
+}
+
+void md_zone_destroy(md_zone_map_t *map)
+{
+	int z;
+
+	if (NULL == map)
+		return;
+	for (z = 0; z < MD_ZONE_MAX; z++)
+		free(map->plane[z]);
+	free(map);
+}
+
+int md_zone_set(md_zone_map_t *map, int zone, const HLE_U8 *mask, HLE_U32 min_area)
+{
+	HLE_U32 *plane;
+	int bx, by, n = 0;
+
+	if (NULL == map || zone < 0 || zone >= MD_ZONE_MAX)
+		return -1;
+
+	plane = map->plane[zone];
+	memset(plane, 0, map->words * map->bh * sizeof(HLE_U32));
+	if (NULL == mask)
+	{
+		map->used &= ~(1U << zone);
+		map->area[zone] = 0;
+		return 0;
+	}
+
+	for (by = 0; by < map->bh; by++)
+	{
+		for (bx = 0; bx < map->bw; bx++)
+		{
+			if (mask[by * map->bw + bx])
+			{
+				plane[by * map->words + (bx >> 5)] |= 0x80000000U >> (bx & 31);
+				n++;
+			}
+		}
+	}
+
+	map->used |= 1U << zone;
+	map->area[zone] = n * MD_BLOCK_SIZE * MD_BLOCK_SIZE;
+	map->min_area[zone] = min_area;
+	return 0;
+}
+
+HLE_U32 md_zone_area(const md_zone_map_t *map, int zone)
+{
+	if (NULL == map || zone < 0 || zone >= MD_ZONE_MAX)
+		return 0;
+	return map->area[zone];
+}
+
+HLE_U32 md_zone_used(const md_zone_map_t *map)
+{
+	return map ? map->used : 0;
+}
+
+int md_zone_union_mask(const md_zone_map_t *map, HLE_U8 *mask)
+{
+	int bx, by, z, n = 0;
+
+	for (by = 0; by < map->bh; by++)
+	{
+		for (bx = 0; bx < map->bw; bx++)
+		{
+			HLE_U32 bit = 0x80000000U >> (bx & 31);
+			HLE_U8 in = 0;
+			for (z = 0; z < MD_ZONE_MAX; z++)
+			{
+				if ((map->used & (1U << z)) && (map->plane[z][by * map->words + (bx >> 5)] & bit))
+					in = 1;
+			}
+			mask[by * map->bw + bx] = in;
+			n += in;
+		}
+	}
+
+	return n;
+}
+
+void md_zone_assign(const md_zone_map_t *map, md_result_t *res)
+{
+	int i, z;
+
+	memset(res->zone_area, 0, sizeof(res->zone_area));
+	for (i = 0; i < res->blob_num; i++)
+	{
+		md_blob_t *b = &res->blob[i];
+		int x0 = b->left / MD_BLOCK_SIZE;
+		int x1 = b->right / MD_BLOCK_SIZE + 1;
+		int y0 = b->top / MD_BLOCK_SIZE;
+		int y1 = b->bottom / MD_BLOCK_SIZE + 1;
+		int total, by;
+
+		b->zones = 0;
+		if (x1 > map->bw)
+			x1 = map->bw;
+		if (y1 > map->bh)
+			y1 = map->bh;
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+		total = (x1 - x0) * (y1 - y0);
+
+		for (z = 0; z < MD_ZONE_MAX; z++)
+		{
+			int n = 0;
+			if (!(map->used & (1U << z)) || b->area < map->min_area[z])
+				continue;
+			for (by = y0; by < y1; by++)
+				n += md_zone_count(map, z, by, x0, x1);
+			if (n)
+			{
+				res->zone_area[z] += (HLE_U32)((HLE_U64)b->area * n / total);
+				b->zones |= 1U << z;
+			}
+		}
+	}
+}
+
+int md_polygon_mask(int bw, int bh, const HLE_S32 *xy, int n, HLE_U8 *mask)
+{
+	HLE_S32 xs[64];
+	int bx, by, i, k, cnt = 0;
+
+	if (NULL == xy || NULL == mask || n < 3 || n > 64)
+		return -1;
+
+	for (by = 0; by < bh; by++)
+	{
+		HLE_S32 cy = by * MD_BLOCK_SIZE + MD_BLOCK_SIZE / 2;	//宏块中心
+		int nx = 0;
+
+		//扫描线与各条边的交点
+		for (i = 0; i < n; i++)
+		{
+			HLE_S32 x0 = xy[2 * i], y0 = xy[2 * i + 1];
+			HLE_S32 x1 = xy[2 * ((i + 1) % n)], y1 = xy[2 * ((i + 1) % n) + 1];
+			if ((y0 <= cy) != (y1 <= cy))
+			{
+				HLE_S32 x = x0 + (cy - y0) * (x1 - x0) / (y1 - y0);
+				for (k = nx++; k > 0 && xs[k - 1] > x; k--)	//插入排序
+					xs[k] = xs[k - 1];
+				xs[k] = x;
+			}
+		}
+
+		for (bx = 0; bx < bw; bx++)
+		{
+			HLE_S32 cx = bx * MD_BLOCK_SIZE + MD_BLOCK_SIZE / 2;
+			HLE_U8 in = 0;
+			for (k = 0; k + 1 < nx; k += 2)
+			{
+				if (cx >= xs[k] && cx < xs[k + 1])
+				{
+					in = 1;
+					break;
+				}
+			}
+			mask[by * bw + bx] = in;
+			cnt += in;
+		}
+	}
+
+	return cnt;
+}
+
+int md_alarm_update(md_alarm_t *st, HLE_U32 area, HLE_U32 total_area, int level)
+{
+	static const HLE_S32 sensitive_level[MD_LEVEL_NUM] = MD_SENSITIVE_LEVEL_TABLE;
+	HLE_S32 lvl;
+
+	if (level < 0)
+		level = 0;
+	else if (level >= MD_LEVEL_NUM)
+		level = MD_LEVEL_NUM - 1;
+
+	lvl = total_area ? (HLE_S32)((HLE_U64)area * 100 / total_area) : 0;	//将百分比小数转换成整数
+	if (lvl >= sensitive_level[level])	//检测结果连续大于阈值的次数统计
+	{
+		if (st->count < 25)
+			st->count++;
+	}
+	else if (st->count)
+	{
+		st->count--;
+	}
+
+	if (st->count >= 2)
+		st->alarm = 1;
+	else if (st->count == 0)
+		st->alarm = 0;
+
+	return st->alarm;
+}
@@ -0,0 +1,241 @@
+/***************************************************************************
+* @file:md_engine.h
+* @author:
+* @date:  10,19,2026
+* @brief:  软件移动侦测引擎（不依赖海思 IVE/IVS，输入为 Y 分量）
+* @attention:算法与 IVS MD 的配置一致：背景法，4x4 宏块 SAD，阈值化，4-连通区域标记。
+             检测区域（zone）是宏块位图，运动区域按行程与区域位图相与统计落在各区域内的面积。
+             背景按 “0.5*当前帧 + 0.5*背景” 更新（对应 stAddCtrl 32768/32768）。
+             SAD 和背景更新按 32 位字一次处理 4 个像素（ARMv5TE 没有 SIMD 指令），
+             连通区域按运动宏块位图的行程（run）做并查集，结果面积和坐标都是像素单位。
+             同一个引擎对象只能在一个线程中使用。
+***************************************************************************/
+#ifndef _MD_ENGINE_H
+#define _MD_ENGINE_H
+
+#include "typeport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define MD_BLOCK_SIZE       4       //宏块大小（4x4，对应 IVE_SAD_MODE_MB_4X4）
+#define MD_MAX_BLOBS        254     //最多输出的连通区域个数（与 IVE_CCBLOB_S 一致）
+#define MD_LEVEL_NUM        5       //灵敏度等级数，0 最灵敏
+#define MD_ZONE_MAX         8       //最多检测区域数
+
+/*各灵敏度等级：运动面积占检测区域面积的百分比阈值*/
+#define MD_SENSITIVE_LEVEL_TABLE    {5, 10, 20, 35, 50}
+/*各灵敏度等级：宏块 SAD 阈值（16 个像素差的绝对值之和）*/
+#define MD_SAD_THRES_TABLE          {100, 150, 200, 200, 200}
+
+/*连通区域（像素坐标，right/bottom 包含在区域内）*/
+typedef struct _md_blob_t
+{
+    HLE_U32 area;           //运动宏块面积（像素）
+    HLE_U16 left;
+    HLE_U16 right;
+    HLE_U16 top;
+    HLE_U16 bottom;
+    HLE_U32 zones;          //计入了哪些检测区域（bit i 对应区域 i）
+}md_blob_t;
+
+/*一帧的检测结果*/
+typedef struct _md_result_t
+{
+    HLE_U32     area_thr;       //本帧实际使用的区域面积阈值（区域太多时会自动增大）
+    HLE_U32     motion_area;    //输出的各连通区域面积之和（像素）
+    HLE_S32     blob_num;       //连通区域个数
+    HLE_U32     zone_area[MD_ZONE_MAX]; //落在各检测区域内的运动面积（像素，只统计不小于区域最小目标面积的连通区域）
+    md_blob_t   blob[MD_MAX_BLOBS];
+}md_result_t;
+
+/*告警判决状态（连续多帧超过阈值才告警，连续多帧低于阈值才解除）*/
+typedef struct _md_alarm_t
+{
+    HLE_S32 count;
+    HLE_S32 alarm;
+}md_alarm_t;
+
+typedef struct _md_engine_t md_engine_t;
+typedef struct _md_zone_map_t md_zone_map_t;
+
+
+/*
+    function:  md_engine_create
+    description:  创建软件移动侦测引擎
+    args:
+        int width[in]，检测图像宽（向下按宏块对齐，多余的像素不参与检测）
+        int height[in]，检测图像高（同上）
+    return:
+        引擎对象，失败返回 NULL
+ */
+md_engine_t *md_engine_create(int width, int height);
+
+/*
+    function:  md_engine_destroy
+    description:  销毁引擎
+ */
+void md_engine_destroy(md_engine_t *eng);
+
+/*
+    function:  md_engine_set_sad_thr
+    description:  设置宏块 SAD 阈值（宏块 SAD 大于等于阈值时认为该宏块运动）
+ */
+void md_engine_set_sad_thr(md_engine_t *eng, HLE_U16 sad_thr);
+
+/*
+    function:  md_engine_set_area_thr
+    description:  设置连通区域的初始面积阈值和增长步长（像素），对应 IVE_CCL_CTRL_S
+        的 u16InitAreaThr/u16Step：小于阈值的区域丢弃，区域个数超过 MD_MAX_BLOBS 时阈值按步长增大
+ */
+void md_engine_set_area_thr(md_engine_t *eng, HLE_U32 init_thr, HLE_U32 step);
+
+/*
+    function:  md_engine_set_mask
+    description:  设置检测区域掩码
+    args:
+        const HLE_U8 *mask[in]，宏块掩码，每个宏块一个字节（非 0 为检测），
+                                按行排列，共 md_engine_blocks_w() * md_engine_blocks_h() 个；NULL 为全部检测
+    return:
+        0, 成功
+        <0, 失败
+ */
+int md_engine_set_mask(md_engine_t *eng, const HLE_U8 *mask);
+
+//宏块列数、行数
+int md_engine_blocks_w(const md_engine_t *eng);
+int md_engine_blocks_h(const md_engine_t *eng);
+
+/*
+    function:  md_engine_reset
+    description:  丢弃背景，下一帧重新作为背景
+ */
+void md_engine_reset(md_engine_t *eng);
+
+/*
+    function:  md_engine_process
+    description:  输入一帧 Y 分量，与背景比较得到运动区域，并更新背景
+    args:
+        const HLE_U8 *y[in]，检测区域左上角像素地址
+        int stride[in]，行跨度（字节）
+        md_result_t *result[out]，检测结果
+    return:
+        >=0, 连通区域个数（第一帧只建立背景，返回 0）
+        <0, 失败
+    attention:
+        y 按 4 字节对齐且 stride 为 4 的倍数时使用按字并行的实现，否则逐像素处理（结果相同）
+ */
+int md_engine_process(md_engine_t *eng, const HLE_U8 *y, int stride, md_result_t *result);
+
+/*
+    function:  md_engine_motion_map
+    description:  取最近一帧的运动宏块位图（已经和掩码相与）
+    args:
+        int *words_per_row[out]，每行宏块占用的 32 位字数；每个字的最高位对应最左边的宏块
+    return:
+        位图首地址，共 words_per_row * md_engine_blocks_h() 个字
+ */
+const HLE_U32 *md_engine_motion_map(const md_engine_t *eng, int *words_per_row);
+
+/*
+    function:  md_engine_set_zones
+    description:  关联检测区域位图，之后 md_engine_process 按连通区域的行程精确统计各区域的运动面积
+    args:
+        const md_zone_map_t *map[in]，区域位图（宏块数必须与引擎相同），NULL 为取消
+    return:
+        0, 成功
+        <0, 失败
+    attention:
+        引擎只保存指针，map 在取消关联前不能销毁，修改 map 要和 md_engine_process 在同一个线程
+ */
+int md_engine_set_zones(md_engine_t *eng, const md_zone_map_t *map);
+
+/*
+    function:  md_zone_create
+    description:  创建检测区域位图
+    args:
+        int bw[in]，宏块列数
+        int bh[in]，宏块行数
+    return:
+        区域位图，失败返回 NULL
+ */
+md_zone_map_t *md_zone_create(int bw, int bh);
+
+void md_zone_destroy(md_zone_map_t *map);
+
+/*
+    function:  md_zone_set
+    description:  设置（或删除）一个检测区域
+    args:
+        int zone[in]，区域编号 [0, MD_ZONE_MAX)
+        const HLE_U8 *mask[in]，宏块掩码（格式同 md_engine_set_mask），NULL 为删除该区域
+        HLE_U32 min_area[in]，最小目标面积（像素），面积更小的连通区域不计入该区域
+    return:
+        0, 成功
+        <0, 失败
+ */
+int md_zone_set(md_zone_map_t *map, int zone, const HLE_U8 *mask, HLE_U32 min_area);
+
+//区域面积（像素），未设置的区域为 0
+HLE_U32 md_zone_area(const md_zone_map_t *map, int zone);
+
+//已设置的区域掩码（bit i 对应区域 i）
+HLE_U32 md_zone_used(const md_zone_map_t *map);
+
+/*
+    function:  md_zone_union_mask
+    description:  所有区域的并集，用作引擎的检测掩码（区域外的宏块不需要检测）
+    args:
+        HLE_U8 *mask[out]，宏块掩码，bw * bh 个字节
+    return:
+        并集的宏块数
+ */
+int md_zone_union_mask(const md_zone_map_t *map, HLE_U8 *mask);
+
+/*
+    function:  md_zone_assign
+    description:  按外接矩形把连通区域分配到检测区域（用于没有行程信息的结果，如 IVE）：
+        外接矩形与区域位图相与，连通区域面积按矩形内属于该区域的宏块比例计入
+    args:
+        md_result_t *res[in/out]，检测结果，填写 zone_area 和各 blob 的 zones
+ */
+void md_zone_assign(const md_zone_map_t *map, md_result_t *res);
+
+/*
+    function:  md_polygon_mask
+    description:  多边形转换为宏块掩码：宏块中心在多边形内（奇偶规则）的置 1，其余置 0
+    args:
+        int bw[in] int bh[in]，宏块列数、行数
+        const HLE_S32 *xy[in]，顶点像素坐标 x0,y0,x1,y1,...
+        int n[in]，顶点数（>= 3）
+        HLE_U8 *mask[out]，宏块掩码，bw * bh 个字节
+    return:
+        >=0, 置 1 的宏块数
+        <0, 失败
+ */
+int md_polygon_mask(int bw, int bh, const HLE_S32 *xy, int n, HLE_U8 *mask);
+
+/*
+    function:  md_alarm_update
+    description:  告警判决（各后端共用）：运动面积百分比达到灵敏度等级的阈值时计数加 1（最多 25），
+        否则减 1；计数 >= 2 时告警，减到 0 时解除
+    args:
+        md_alarm_t *st[in/out]，判决状态
+        HLE_U32 area[in]，运动面积
+        HLE_U32 total_area[in]，检测区域面积（与 area 同一单位）
+        int level[in]，灵敏度等级 [0, MD_LEVEL_NUM)
+    return:
+        1, 告警
+        0, 无告警
+ */
+int md_alarm_update(md_alarm_t *st, HLE_U32 area, HLE_U32 total_area, int level);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,488 @@
+/***************************************************************************
+* @file: metrics.c
+* @author:
+* @date:  10,19,2026
+* @brief:  统一的运行统计和逐帧事件跟踪
+* @attention:
+	1.ARM926 单核、没有 ldrex/strex，原子读改写要关中断（__sync 系列是库函数调用），所以计数器
+	  不用原子加：每个任务按任务 ID 写自己的分片，分片内是普通的读-加-写（用 relaxed 的
+	  __atomic_load_n/__atomic_store_n，在 ARM 上就是 ldr/str）。两个任务落在同一个分片并且
+	  在读-加-写中间被抢占时会丢失一次计数，统计用途可以接受。
+	2.跟踪环的写位置用 __sync_fetch_and_add 分配（多个任务同时写），记录按 4 个字写入。
+	3.主机测试见 test/test_metrics.c
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "typeport.h"
+#include "json_stream.h"
+#include "metrics.h"
+#include "mpi_sys.h"
+
+#define MET_LOAD(x)			__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define MET_STORE(x, v)		__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+/*直方图（一个分片）*/
+typedef struct _metrics_hist_t
+{
+	HLE_U32 count;
+	HLE_U32 sum_lo;				//总和（64 位，分两个字保存，避免 64 位的原子访问）
+	HLE_U32 sum_hi;
+	HLE_U32 max;
+	HLE_U32 bucket[METRICS_HIST_BUCKETS];
+}metrics_hist_t;
+
+/*一个分片（按 32 字节对齐，不同任务的分片不共用 cache line）*/
+typedef struct _metrics_shard_t
+{
+	HLE_U32 counter[MET_C_NUM];
+	metrics_hist_t hist[MET_H_NUM];
+}__attribute__((aligned(32))) metrics_shard_t;
+
+typedef struct _metrics_gauge_t
+{
+	HLE_S32 cur;
+	HLE_S32 peak;
+}metrics_gauge_t;
+
+typedef struct _metrics_collector_t
+{
+	const char *name;
+	metrics_collect_f fn;
+}metrics_collector_t;
+
+typedef struct _metrics_ctx_t
+{
+	metrics_shard_t shard[METRICS_SHARDS];
+	metrics_gauge_t gauge[MET_G_NUM];
+
+	metrics_trace_rec_t *trace;			//跟踪环，第一次打开跟踪时分配
+	HLE_U32 trace_pos;					//下一条记录的序号
+
+	pthread_mutex_t lock;				//flags 的修改、跟踪环的分配、采集回调表
+	metrics_collector_t collector[METRICS_COLLECTOR_MAX];
+}metrics_ctx_t;
+
+HLE_U32 g_metrics_flags = METRICS_F_ON;	//计数器默认打开，跟踪默认关闭
+
+static metrics_ctx_t metrics_ctx = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char *metrics_counter_name[] =
+{
+	"venc_frames", "aenc_frames", "spm_alloc_fail", "spm_wait", "sdp_drop", "sdp_slab_fail",
+	"ts_aframes", "ts_vframes", "fmp4_aframes", "fmp4_vframes",
+	"net_frames", "net_bytes", "net_write_err", "net_discard",
+	"upload_push", "upload_drop"
+};
+
+static const char *metrics_gauge_name[] =
+{
+	"spm_packs", "spm_kb", "sdp_vframes", "net_ring", "upload_kb"
+};
+
+static const char *metrics_hist_name[] =
+{
+	"venc_ms", "net_ms", "upload_wait_s"
+};
+
+static const char *metrics_trace_name[] =
+{
+	"-", "venc_get", "aenc_get", "sdp_drop", "net_send", "net_discard", "mux_ts", "mux_fmp4", "upload_pop"
+};
+
+/*名字表与枚举的个数必须一致*/
+typedef char metrics_counter_name_check[(sizeof (metrics_counter_name) / sizeof (metrics_counter_name[0]) == MET_C_NUM) ? 1 : -1];
+typedef char metrics_gauge_name_check[(sizeof (metrics_gauge_name) / sizeof (metrics_gauge_name[0]) == MET_G_NUM) ? 1 : -1];
+typedef char metrics_hist_name_check[(sizeof (metrics_hist_name) / sizeof (metrics_hist_name[0]) == MET_H_NUM) ? 1 : -1];
+typedef char metrics_trace_rec_check[(sizeof (metrics_trace_rec_t) == 16) ? 1 : -1];
+
+
+/*当前任务的分片*/
+static inline metrics_shard_t *metrics_shard(void)
+{
+	unsigned long id = (unsigned long)pthread_self();
+
+	//LiteOS 的 pthread_t 是任务 ID（小整数），Linux 上是线程栈附近的地址
+	id ^= (id >> 12) ^ (id >> 20);
+	return &metrics_ctx.shard[id & (METRICS_SHARDS - 1)];
+}
+
+void metrics_counter_add(int id, HLE_U32 n)
+{
+	HLE_U32 *c;
+
+	if ((unsigned int)id >= MET_C_NUM)
+		return;
+	c = &metrics_shard()->counter[id];
+	MET_STORE(*c, MET_LOAD(*c) + n);
+}
+
+void metrics_gauge_set(int id, HLE_S32 val)
+{
+	metrics_gauge_t *g;
+
+	if ((unsigned int)id >= MET_G_NUM)
+		return;
+	g = &metrics_ctx.gauge[id];
+	MET_STORE(g->cur, val);
+	if (val > MET_LOAD(g->peak))
+		MET_STORE(g->peak, val);
+}
+
+/*值所在的桶：0 -> 0，[2^(i-1), 2^i) -> i*/
+static inline int metrics_bucket(HLE_U32 val)
+{
+	int i;
+
+	if (val == 0)
+		return 0;
+	i = 32 - __builtin_clz(val);
+	return (i < METRICS_HIST_BUCKETS) ? i : METRICS_HIST_BUCKETS - 1;
+}
+
+void metrics_hist_add(int id, HLE_U32 val)
+{
+	metrics_hist_t *h;
+	HLE_U32 lo;
+	int b = metrics_bucket(val);
+
+	if ((unsigned int)id >= MET_H_NUM)
+		return;
+	h = &metrics_shard()->hist[id];
+	MET_STORE(h->count, MET_LOAD(h->count) + 1);
+	lo = MET_LOAD(h->sum_lo) + val;
+	if (lo < val)
+		MET_STORE(h->sum_hi, MET_LOAD(h->sum_hi) + 1);
+	MET_STORE(h->sum_lo, lo);
+	if (val > MET_LOAD(h->max))
+		MET_STORE(h->max, val);
+	MET_STORE(h->bucket[b], MET_LOAD(h->bucket[b]) + 1);
+}
+
+HLE_U64 metrics_now_us(void)
+{
+	HLE_U64 pts = 0;
+
+	HI_MPI_SYS_GetCurPts(&pts);
+	return pts;
+}
+
+void metrics_trace(int event, int stream, int type, HLE_U32 arg1, HLE_U32 arg2)
+{
+	metrics_trace_rec_t *ring = __atomic_load_n(&metrics_ctx.trace, __ATOMIC_ACQUIRE);
+	HLE_U32 *rec;
+
+	if (ring == NULL)
+		return;
+	rec = (HLE_U32 *)&ring[__sync_fetch_and_add(&metrics_ctx.trace_pos, 1) & (METRICS_TRACE_NUM - 1)];
+	MET_STORE(rec[0], (HLE_U32)metrics_now_us());
+	MET_STORE(rec[1], (HLE_U32)(event & 0xFFFF) | ((HLE_U32)(stream & 0xFF) << 16) | ((HLE_U32)(type & 0xFF) << 24));
+	MET_STORE(rec[2], arg1);
+	MET_STORE(rec[3], arg2);
+}
+
+int metrics_set_flags(HLE_U32 flags)
+{
+	int ret = HLE_RET_OK;
+
+	pthread_mutex_lock(&metrics_ctx.lock);
+	if ((flags & METRICS_F_TRACE) && metrics_ctx.trace == NULL)
+	{
+		metrics_trace_rec_t *ring = (metrics_trace_rec_t *)calloc(METRICS_TRACE_NUM, sizeof (metrics_trace_rec_t));
+		if (ring == NULL)
+		{
+			ERROR_LOG("malloc trace ring failed!\n");
+			flags &= ~METRICS_F_TRACE;
+			ret = HLE_RET_ENORESOURCE;
+		}
+		else
+			__atomic_store_n(&metrics_ctx.trace, ring, __ATOMIC_RELEASE);
+	}
+	MET_STORE(g_metrics_flags, flags & (METRICS_F_ON | METRICS_F_TRACE));
+	pthread_mutex_unlock(&metrics_ctx.lock);
+	return ret;
+}
+
+void metrics_clear(void)
+{
+	int s, i, b;
+
+	for (s = 0; s < METRICS_SHARDS; s++)
+	{
+		metrics_shard_t *sh = &metrics_ctx.shard[s];
+		for (i = 0; i < MET_C_NUM; i++)
+			MET_STORE(sh->counter[i], 0);
+		for (i = 0; i < MET_H_NUM; i++)
+		{
+			metrics_hist_t *h = &sh->hist[i];
+			MET_STORE(h->count, 0);
+			MET_STORE(h->sum_lo, 0);
+			MET_STORE(h->sum_hi, 0);
+			MET_STORE(h->max, 0);
+			for (b = 0; b < METRICS_HIST_BUCKETS; b++)
+				MET_STORE(h->bucket[b], 0);
+		}
+	}
+	for (i = 0; i < MET_G_NUM; i++)
+		MET_STORE(metrics_ctx.gauge[i].peak, MET_LOAD(metrics_ctx.gauge[i].cur));
+}
+
+int metrics_register_collector(const char *name, metrics_collect_f fn)
+{
+	int i, slot = -1;
+
+	if (name == NULL)
+		return HLE_RET_EINVAL;
+
+	pthread_mutex_lock(&metrics_ctx.lock);
+	for (i = 0; i < METRICS_COLLECTOR_MAX; i++)
+	{
+		metrics_collector_t *c = &metrics_ctx.collector[i];
+		if (c->name && strcmp(c->name, name) == 0)
+		{
+			slot = i;
+			break;
+		}
+		if (c->name == NULL && slot < 0)
+			slot = i;
+	}
+	if (slot < 0)
+	{
+		pthread_mutex_unlock(&metrics_ctx.lock);
+		ERROR_LOG("too many metrics collectors, %s not registered!\n", name);
+		return HLE_RET_ENORESOURCE;
+	}
+	metrics_ctx.collector[slot].name = fn ? name : NULL;
+	metrics_ctx.collector[slot].fn = fn;
+	pthread_mutex_unlock(&metrics_ctx.lock);
+	return HLE_RET_OK;
+}
+
+/*汇总所有分片的一个计数器*/
+static HLE_U32 metrics_counter_sum(int id)
+{
+	HLE_U32 sum = 0;
+	int s;
+
+	for (s = 0; s < METRICS_SHARDS; s++)
+		sum += MET_LOAD(metrics_ctx.shard[s].counter[id]);
+	return sum;
+}
+
+/*汇总所有分片的一个直方图*/
+static void metrics_hist_sum(int id, metrics_hist_t *out, HLE_U64 *sum)
+{
+	int s, b;
+
+	memset(out, 0, sizeof (*out));
+	*sum = 0;
+	for (s = 0; s < METRICS_SHARDS; s++)
+	{
+		metrics_hist_t *h = &metrics_ctx.shard[s].hist[id];
+		HLE_U32 max = MET_LOAD(h->max);
+
+		out->count += MET_LOAD(h->count);
+		*sum += ((HLE_U64)MET_LOAD(h->sum_hi) << 32) | MET_LOAD(h->sum_lo);
+		if (max > out->max)
+			out->max = max;
+		for (b = 0; b < METRICS_HIST_BUCKETS; b++)
+			out->bucket[b] += MET_LOAD(h->bucket[b]);
+	}
+}
+
+/*分位数的估计值：所在桶的上界（不超过最大值）*/
+static HLE_U32 metrics_hist_percentile(const metrics_hist_t *h, int percent)
+{
+	HLE_U32 target, seen = 0;
+	int b;
+
+	if (h->count == 0)
+		return 0;
+	target = (HLE_U32)(((HLE_U64)h->count * percent + 99) / 100);
+	for (b = 0; b < METRICS_HIST_BUCKETS; b++)
+	{
+		seen += h->bucket[b];
+		if (seen >= target)
+			break;
+	}
+	if (b == 0)
+		return 0;
+	if (b >= METRICS_HIST_BUCKETS - 1 || ((1u << b) - 1) > h->max)
+		return h->max;
+	return (1u << b) - 1;
+}
+
+int metrics_snapshot(char *buf, int size)
+{
+	json_writer_t w;
+	int i, b;
+
+	json_write_init(&w, buf, size);
+	json_write_obj_begin(&w, NULL);
+	json_write_int(&w, "flags", (int)MET_LOAD(g_metrics_flags));
+	json_write_u64(&w, "now_ms", metrics_now_us() / 1000);
+
+	json_write_obj_begin(&w, "counters");
+	for (i = 0; i < MET_C_NUM; i++)
+		json_write_u64(&w, metrics_counter_name[i], metrics_counter_sum(i));
+	json_write_obj_end(&w);
+
+	json_write_obj_begin(&w, "gauges");
+	for (i = 0; i < MET_G_NUM; i++)
+	{
+		json_write_obj_begin(&w, metrics_gauge_name[i]);
+		json_write_int(&w, "cur", MET_LOAD(metrics_ctx.gauge[i].cur));
+		json_write_int(&w, "max", MET_LOAD(metrics_ctx.gauge[i].peak));
+		json_write_obj_end(&w);
+	}
+	json_write_obj_end(&w);
+
+	json_write_obj_begin(&w, "hists");
+	for (i = 0; i < MET_H_NUM; i++)
+	{
+		metrics_hist_t h;
+		HLE_U64 sum;
+
+		metrics_hist_sum(i, &h, &sum);
+		json_write_obj_begin(&w, metrics_hist_name[i]);
+		json_write_u64(&w, "count", h.count);
+		json_write_u64(&w, "avg", h.count ? sum / h.count : 0);
+		json_write_u64(&w, "p50", metrics_hist_percentile(&h, 50));
+		json_write_u64(&w, "p90", metrics_hist_percentile(&h, 90));
+		json_write_u64(&w, "p99", metrics_hist_percentile(&h, 99));
+		json_write_u64(&w, "max", h.max);
+		json_write_arr_begin(&w, "buckets");
+		for (b = 0; b < METRICS_HIST_BUCKETS; b++)
+			json_write_u64(&w, NULL, h.bucket[b]);
+		json_write_arr_end(&w);
+		json_write_obj_end(&w);
+	}
+	json_write_obj_end(&w);
+
+	json_write_obj_begin(&w, "trace");
+	json_write_u64(&w, "pos", metrics_trace_pos());
+	json_write_int(&w, "size", METRICS_TRACE_NUM);
+	json_write_obj_end(&w);
+
+	pthread_mutex_lock(&metrics_ctx.lock);
+	for (i = 0; i < METRICS_COLLECTOR_MAX; i++)
+	{
+		metrics_collector_t *c = &metrics_ctx.collector[i];
+		if (c->fn == NULL)
+			continue;
+		json_write_obj_begin(&w, c->name);
+		c->fn(&w);
+		json_write_obj_end(&w);
+	}
+	pthread_mutex_unlock(&metrics_ctx.lock);
+
+	json_write_obj_end(&w);
+	return json_write_finish(&w);
+}
+
+HLE_U32 metrics_trace_pos(void)
+{
+	return MET_LOAD(metrics_ctx.trace_pos);
+}
+
+int metrics_trace_read(HLE_U32 *cursor, metrics_trace_rec_t *out, int max)
+{
+	metrics_trace_rec_t *ring = __atomic_load_n(&metrics_ctx.trace, __ATOMIC_ACQUIRE);
+	HLE_U32 pos = metrics_trace_pos();
+	int i, j, n;
+
+	if (ring == NULL || cursor == NULL || out == NULL || max <= 0)
+		return 0;
+	if ((HLE_S32)(pos - *cursor) < 0)			//序号比写位置还新（清零或调用者传错）
+		*cursor = pos;
+	if (pos - *cursor > METRICS_TRACE_NUM)
+		*cursor = pos - METRICS_TRACE_NUM;
+	n = (int)(pos - *cursor);
+	if (n > max)
+		n = max;
+	for (i = 0; i < n; i++)
+	{
+		HLE_U32 *src = (HLE_U32 *)&ring[(*cursor + i) & (METRICS_TRACE_NUM - 1)];
+		HLE_U32 *dst = (HLE_U32 *)&out[i];
+		for (j = 0; j < 4; j++)
+			dst[j] = MET_LOAD(src[j]);
+	}
+	*cursor += n;
+	return n;
+}
+
+/*shell：输出最近 num 条跟踪记录*/
+static void metrics_trace_dump(int num)
+{
+	metrics_trace_rec_t rec[32];
+	HLE_U32 cursor, pos = metrics_trace_pos();
+	int i, n;
+
+	if (__atomic_load_n(&metrics_ctx.trace, __ATOMIC_ACQUIRE) == NULL)
+	{
+		printf("trace ring not allocated, run \"metrics trace on\" first\n");
+		return;
+	}
+	if ((HLE_U32)num > pos)
+		num = (int)pos;
+	cursor = pos - num;
+	printf("%10s %-12s %6s %4s %10s %10s\n", "ts_us", "event", "stream", "type", "arg1", "arg2");
+	while (num > 0 && (n = metrics_trace_read(&cursor, rec, num < 32 ? num : 32)) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			const char *name = (rec[i].event < sizeof (metrics_trace_name) / sizeof (metrics_trace_name[0]))
+								? metrics_trace_name[rec[i].event] : "?";
+			printf("%10u %-12s %6u %4x %10u %10u\n", rec[i].ts_us, name, rec[i].stream, rec[i].type,
+				   rec[i].arg1, rec[i].arg2);
+		}
+		num -= n;
+	}
+}
+
+int metrics_shell(int argc, char *argv[])
+{
+	HLE_U32 flags = MET_LOAD(g_metrics_flags);
+	const char *cmd = (argc > 0) ? argv[0] : "show";
+
+	if (strcmp(cmd, "show") == 0)
+	{
+		char *buf = (char *)malloc(METRICS_JSON_MAX);
+		if (buf == NULL)
+			return HLE_RET_ENORESOURCE;
+		if (metrics_snapshot(buf, METRICS_JSON_MAX) < 0)
+			printf("metrics snapshot too large!\n");
+		else
+			printf("%s\n", buf);
+		free(buf);
+	}
+	else if (strcmp(cmd, "on") == 0)
+		metrics_set_flags(flags | METRICS_F_ON);
+	else if (strcmp(cmd, "off") == 0)
+		metrics_set_flags(flags & ~METRICS_F_ON);
+	else if (strcmp(cmd, "clear") == 0)
+		metrics_clear();
+	else if (strcmp(cmd, "trace") == 0 && argc > 1)
+	{
+		if (strcmp(argv[1], "on") == 0)
+			return metrics_set_flags(flags | METRICS_F_TRACE);
+		if (strcmp(argv[1], "off") == 0)
+			return metrics_set_flags(flags & ~METRICS_F_TRACE);
+		if (strcmp(argv[1], "dump") == 0)
+		{
+			int num = (argc > 2) ? atoi(argv[2]) : 64;
+			if (num <= 0 || num > METRICS_TRACE_NUM)
+				num = METRICS_TRACE_NUM;
+			metrics_trace_dump(num);
+		}
+	}
+	else
+	{
+		printf("usage: metrics [show | on | off | clear | trace on | trace off | trace dump [n]]\n");
+		return HLE_RET_EINVAL;
+	}
+	return HLE_RET_OK;
+}
@@ -19,15 +19,16 @@
 
 #include "hal_def.h"
 #include "motion_detect.h"
+#include "md_engine.h"
+#include "luma_stat.h"
 
 #include "hi_sns_ctrl.h"
 
 
 #define GET_MOTION_CHN_ID(chn)  (chn)
 
-/* (0-4),0 is most sensitive */
-static HLE_S32 sensitive_level[5] = {5, 10, 20, 35, 50};
-static HLE_U16 md_thres[5] = {100, 150, 200, 200, 200};
+/* (0-4),0 is most sensitive，面积百分比阈值见 md_alarm_update */
+static HLE_U16 md_thres[MD_LEVEL_NUM] = MD_SAD_THRES_TABLE;
 HLE_S32 motion_detect_val = 0; //MD告警触发 标志变量
 //MD检测区域
 typedef struct _detection_region_t
@@ -50,64 +51,81 @@ typedef struct
 	HLE_S32 motion_chn_ison;
 	HLE_S32 usr_config_level; //灵敏度
 	//HLE_RECT usr_motion_rect[MAX_MD_AREA_NUM];
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 	IVE_SRC_IMAGE_S img[2];
 	IVE_DST_MEM_INFO_S blob; //检测结果（目标图像）
+#else
+	md_engine_t *engine; //软件检测引擎
+#endif
 	MD_CHN chn;
-	int dirty; //标志：是否需要重新配置灵敏度阈值
-	int count; //检测结果统计
+	int dirty; //标志：是否需要重新配置灵敏度阈值和检测区域
+	md_result_t result; //检测结果
 	detection_region_t region;
+
+	/*---检测区域：zone_num/zone_cfg 由配置接口修改（md_zone_lock 保护），其余只在 MD 线程中使用---*/
+	int zone_num; //配置的区域数，0：整幅图像为一个区域
+	MD_ZONE_ATTR zone_cfg[MD_ZONE_NUM];
+	md_zone_map_t *zones; //各区域的宏块位图
+	HLE_U8 zone_level[MD_ZONE_NUM]; //各区域的灵敏度（生成位图时从 zone_cfg 取出）
+	md_alarm_t zone_alarm[MD_ZONE_NUM]; //各区域的告警判决
+	MD_ZONE_STATE zone_state; //各区域状态（md_zone_lock 保护）
 } MOTION_CONTEX;
 MOTION_CONTEX mdCtx[VI_PORT_NUM];
 
 static SIZE_S mdSize;
+static SIZE_S vdaSize; //MD 图像大小，区域坐标按该大小从相对坐标系换算
+static pthread_mutex_t md_zone_lock = PTHREAD_MUTEX_INITIALIZER;
 detection_region_t  detect_region = {0}; //手动假设需要检测的区域，后期由手机端下发
-int motion_detect_data_proc(MOTION_CONTEX* ctx)
+
+/*
+功能：检测结果分析，各检测区域的运动面积连续超过该区域的灵敏度阈值时告警，任一区域告警即置位告警标志
+参数：
+		@ctx：通道上下文
+		@res：检测结果（IVE 或软件引擎），zone_area 已经统计好
+返回：HLE_RET_OK
+*/
+int motion_detect_data_proc(MOTION_CONTEX* ctx, const md_result_t *res)
 {
 	if (0 == ctx->motion_chn_ison) return HLE_RET_OK;
 
-	HLE_U32 i;
-	IVE_CCBLOB_S* blob = (IVE_CCBLOB_S*) ctx->blob.pu8VirAddr;
-	HLE_U32 area = 0;
-	
-	//printf("\n---into parse result ....----\n");
-	for (i = 1; i < blob->u8RegionNum; ++i) 
-	{
-		//可对划定的区域进行过滤，不属于区域内的检测结果过滤掉
-		//if(blob->astRegion[i].u16Top )
-		area += blob->astRegion[i].u32Area; 
-		/*
-		printf("u32Area(%d) u16Top(%d) u16Bottom(%d) u16Left(%d) u16Right(%d)\n",blob->astRegion[i].u32Area,blob->astRegion[i].u16Top,
-			blob->astRegion[i].u16Bottom,blob->astRegion[i].u16Left,blob->astRegion[i].u16Right);
-		*/
-		//printf("{%u;;[%d].%u }\n", area,i, blob->astRegion[i].u32Area);
-		
-	}
-	
-	HLE_S32 lvl = area * 100 / detect_region.total_area;//将百分比小数转换成整数
-	
-	//printf("*sensitive_level(%d) actual_lvl(%d), count area = %d\n ",sensitive_level[ctx->usr_config_level], lvl,area);
-	if (lvl >= sensitive_level[ctx->usr_config_level]) //检测结果连续大于阈值的次数统计
-	{
-		if (ctx->count < 25) ctx->count++;
-		//motion_detect_val |= (1 << ctx->chn);
-		//printf("level(%d) > sensitive_level, motion_detect_val = %d\n",sensitive_level[ctx->usr_config_level],motion_detect_val);
-		//printf("1111lvl=%d, count=%d\n ", lvl, ctx->count);
+	HLE_U32 used = md_zone_used(ctx->zones);
+	HLE_U32 alarm_mask = 0;
+	int z;
 
-	} 
-	else 
+	/*
+	for (i = 0; i < res->blob_num; ++i)
+		printf("u32Area(%d) u16Top(%d) u16Bottom(%d) u16Left(%d) u16Right(%d)\n",res->blob[i].area,res->blob[i].top,
+			res->blob[i].bottom,res->blob[i].left,res->blob[i].right);
+	*/
+
+	pthread_mutex_lock(&md_zone_lock);
+	for (z = 0; z < MD_ZONE_NUM; z++)
 	{
-		if (ctx->count) ctx->count--;
-		//motion_detect_val &= ~(1  << ctx->chn);
-		//printf("lvl(%d) < sensitive_level, result count=%d\n ", lvl, ctx->count);
+		HLE_U32 total = md_zone_area(ctx->zones, z);
+		if (!(used & (1U << z)) || 0 == total)
+		{
+			ctx->zone_state.percent[z] = 0;
+			continue;
+		}
+
+		ctx->zone_state.percent[z] = (HLE_U64)res->zone_area[z] * 100 / total;
+		if (md_alarm_update(&ctx->zone_alarm[z], res->zone_area[z], total, ctx->zone_level[z]))
+		{
+			if (!(ctx->zone_state.alarm_mask & (1U << z)))
+				ctx->zone_state.hits[z]++;
+			alarm_mask |= 1U << z;
+		}
 	}
+	ctx->zone_state.alarm_mask = alarm_mask;
+	pthread_mutex_unlock(&md_zone_lock);
 
 	/***MD告警触发     结果判断******************/
-	if (ctx->count >= 2) //3 
+	if (alarm_mask)
 	{
 		motion_detect_val |= (1 << ctx->chn);//触发成功：标志位置位
-		DEBUG_LOG("MD alarm !!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
-	} 
-	else if (ctx->count == 0) 
+		DEBUG_LOG("MD alarm, zone mask %#x !!!!!!!!!!!!!!!!!!!!!!!!!!!\n", alarm_mask);
+	}
+	else
 	{
 		motion_detect_val &= ~(1 << ctx->chn);//结束触发：标志位清零
 	}
@@ -159,9 +177,127 @@ static void deal_with_timeout(int count)
 	|	|________________|
 	|		bottom
 */
+/*
+功能：区域顶点从相对坐标系换算到检测图像，生成宏块掩码
+参数：
+		@zone：区域属性
+		@bw，bh：宏块列数、行数
+		@mask：输出宏块掩码（bw * bh 字节）
+返回：区域内的宏块数，失败返回 -1
+*/
+static int motion_detect_zone_mask(const MD_ZONE_ATTR *zone, int bw, int bh, HLE_U8 *mask)
+{
+	HLE_S32 xy[2 * MD_ZONE_POINT_MAX];
+	int i, n = zone->point_num;
+
+	if (n < 2 || n > MD_ZONE_POINT_MAX)
+	{
+		ERROR_LOG("illegal point_num %d\n", n);
+		return -1;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		xy[2 * i] = zone->point[i].x * vdaSize.u32Width / REL_COORD_WIDTH - detect_region.u16Left;
+		xy[2 * i + 1] = zone->point[i].y * vdaSize.u32Height / REL_COORD_HEIGHT - detect_region.u16Top;
+	}
+
+	if (2 == n) //矩形：左上角、右下角转换为四个顶点
+	{
+		HLE_S32 x0 = xy[0], y0 = xy[1], x1 = xy[2], y1 = xy[3];
+		xy[2] = x1; xy[3] = y0;
+		xy[4] = x1; xy[5] = y1;
+		xy[6] = x0; xy[7] = y1;
+		n = 4;
+	}
+
+	return md_polygon_mask(bw, bh, xy, n, mask);
+}
+
+/*
+功能：按区域配置重新生成各区域的宏块位图（在 MD 线程中调用）
+注意：没有配置区域时整幅图像为区域 0，灵敏度为 MOTION_DETECT_ATTR 的 level；
+	  软件后端只检测各区域的并集
+*/
+static void motion_detect_apply_zones(MOTION_CONTEX *ctx)
+{
+	MD_ZONE_ATTR cfg[MD_ZONE_NUM];
+	int bw = detect_region.u32Width / MD_BLOCK_SIZE;
+	int bh = detect_region.u32Height / MD_BLOCK_SIZE;
+	int num, z;
+	HLE_U8 *mask;
+
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_SOFT)
+	bw = md_engine_blocks_w(ctx->engine);
+	bh = md_engine_blocks_h(ctx->engine);
+#endif
+	mask = (HLE_U8 *)malloc(bw * bh);
+	if (NULL == mask)
+	{
+		ERROR_LOG("malloc fail!\n");
+		return;
+	}
+
+	pthread_mutex_lock(&md_zone_lock);
+	num = ctx->zone_num;
+	memcpy(cfg, ctx->zone_cfg, sizeof(cfg));
+	pthread_mutex_unlock(&md_zone_lock);
+
+	memset(ctx->zone_alarm, 0, sizeof(ctx->zone_alarm));
+	for (z = 0; z < MD_ZONE_NUM; z++)
+		md_zone_set(ctx->zones, z, NULL, 0);
+
+	if (0 == num)
+	{
+		memset(mask, 1, bw * bh);
+		md_zone_set(ctx->zones, 0, mask, 0);
+		ctx->zone_level[0] = ctx->usr_config_level;
+	}
+	else
+	{
+		for (z = 0; z < num; z++)
+		{
+			HLE_U32 min_area = (HLE_U64)cfg[z].min_size * detect_region.total_area / 10000;
+			if (!cfg[z].enable)
+				continue;
+			if (motion_detect_zone_mask(&cfg[z], bw, bh, mask) <= 0)
+			{
+				ERROR_LOG("zone %d is empty\n", z);
+				continue;
+			}
+			md_zone_set(ctx->zones, z, mask, min_area);
+			ctx->zone_level[z] = (cfg[z].level < MD_LEVEL_NUM) ? cfg[z].level : MD_LEVEL_NUM - 1;
+		}
+	}
+
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_SOFT)
+	md_zone_union_mask(ctx->zones, mask);
+	md_engine_set_mask(ctx->engine, mask);
+#endif
+	free(mask);
+}
+
+//各区域中最灵敏的等级，用来设置宏块 SAD 阈值
+static int motion_detect_sad_level(MOTION_CONTEX *ctx)
+{
+	HLE_U32 used = md_zone_used(ctx->zones);
+	int z, level = ctx->usr_config_level;
+
+	if (used)
+	{
+		level = MD_LEVEL_NUM - 1;
+		for (z = 0; z < MD_ZONE_NUM; z++)
+		{
+			if ((used & (1U << z)) && ctx->zone_level[z] < level)
+				level = ctx->zone_level[z];
+		}
+	}
+	return level;
+}
+
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 static int ive_dma_image(VIDEO_FRAME_INFO_S *frm, IVE_DST_IMAGE_S *img, int instant);
 
-#if 1
 int cut_yuv_region(VIDEO_FRAME_INFO_S*src_frame,detection_region_t* region,IVE_DST_IMAGE_S*dst_frame)
 {
 	if(NULL == src_frame || NULL == region || NULL == dst_frame)
@@ -237,7 +373,6 @@ int cut_yuv_region(VIDEO_FRAME_INFO_S*src_frame,detection_region_t* region,IVE_D
 	
 }
 
-#endif
 
 /*
 功能：使用 DMA 直接拷贝帧数据到 img （只需要Y分量）
@@ -291,46 +426,187 @@ static int ive_dma_image(VIDEO_FRAME_INFO_S *frm, IVE_DST_IMAGE_S *img, int inst
 	return HLE_RET_OK;
 }
 
+//IVE 检测结果转换为通用格式（与原来一致，从第 1 个区域开始统计）
+static void ive_blob_to_result(const IVE_CCBLOB_S *blob, md_result_t *res)
+{
+	HLE_U32 i;
+
+	res->area_thr = blob->u16CurAreaThr;
+	res->motion_area = 0;
+	res->blob_num = 0;
+	for (i = 1; i < blob->u8RegionNum; ++i)
+	{
+		md_blob_t *b = &res->blob[res->blob_num++];
+		b->area = blob->astRegion[i].u32Area;
+		b->left = blob->astRegion[i].u16Left;
+		b->right = blob->astRegion[i].u16Right;
+		b->top = blob->astRegion[i].u16Top;
+		b->bottom = blob->astRegion[i].u16Bottom;
+		res->motion_area += b->area;
+	}
+}
+
+//重新配置灵敏度阈值
+static void motion_detect_set_level(MOTION_CONTEX *ctx)
+{
+	MD_ATTR_S attr;
+	HLE_S32 ret;
+
+	ret = HI_IVS_MD_GetChnAttr(ctx->chn, &attr);
+	if (HI_SUCCESS == ret) 
+	{
+		attr.u16SadThr = md_thres[motion_detect_sad_level(ctx)];
+		ret = HI_IVS_MD_SetChnAttr(ctx->chn, &attr);
+		if (HI_SUCCESS != ret) 
+		{
+			ERROR_LOG("HI_IVS_MD_SetChnAttr fail: %#x\n", ret);
+		}
+	} 
+	else 
+	{
+		ERROR_LOG("HI_IVS_MD_GetChnAttr fail: %#x\n", ret);
+	}
+}
+
+/*
+功能：IVE 后端处理一帧：拷贝检测区域到 MMZ，由 IVS MD 与上一帧比较
+参数：
+		@ctx：通道上下文
+		@frm：VPSS 帧
+		@first：是否还没有参考帧（成功拷贝第一帧后清零）
+		@idx：当前帧使用的 img 下标
+		@sad：SAD 输出（不使用）
+返回：HLE_RET_OK：得到了检测结果；其他：没有结果
+*/
+static int motion_detect_frame(MOTION_CONTEX *ctx, VIDEO_FRAME_INFO_S *frm, int *first, int *idx, IVE_DST_IMAGE_S *sad)
+{
+	HLE_S32 ret;
+
+	if (*first) //第一次循环（此时 idx = 0），拷贝数据作为源图像
+	{
+		ret = cut_yuv_region(frm, &detect_region, &ctx->img[1 - *idx]);
+		if (HLE_RET_OK != ret)
+		{
+			ERROR_LOG("call cut_yuv_region error!\n");
+			return HLE_RET_ERROR;
+		}
+		*first = 0;
+		return HLE_RET_ERROR;
+	}
+
+	//不是第一次循环，则可进行MD侦测（此时已经有了参考帧）
+	ret = cut_yuv_region(frm, &detect_region, &ctx->img[*idx]);
+	if (HLE_RET_OK != ret)
+	{
+		ERROR_LOG("call cut_yuv_region error!\n");
+		return HLE_RET_ERROR;
+	}
+
+	ret = HI_IVS_MD_Process(ctx->chn, &ctx->img[*idx], &ctx->img[1 - *idx], sad, &ctx->blob); //算法把当前帧和上一帧进行比较
+	if (HI_SUCCESS != ret)
+	{
+		ERROR_LOG("HI_IVS_MD_Process failed ret(%#x)!\n",ret);
+		return HLE_RET_ERROR;
+	}
+
+	ive_blob_to_result((IVE_CCBLOB_S*) ctx->blob.pu8VirAddr, &ctx->result);
+	md_zone_assign(ctx->zones, &ctx->result); //IVE 只有外接矩形，按矩形分配到各区域
+	*idx = 1 - *idx;//1,0,1,0,....循环遍历ctx->img[2]数组
+	return HLE_RET_OK;
+}
+
+#else
+
+//重新配置灵敏度阈值
+static void motion_detect_set_level(MOTION_CONTEX *ctx)
+{
+	md_engine_set_sad_thr(ctx->engine, md_thres[motion_detect_sad_level(ctx)]);
+}
+
+/*
+功能：软件后端处理一帧：直接在映射的 Y 分量上检测（不拷贝检测区域），背景在引擎内部维护
+参数：
+		@ctx：通道上下文
+		@frm：VPSS 帧
+返回：HLE_RET_OK：得到了检测结果；其他：失败
+*/
+static int motion_detect_frame(MOTION_CONTEX *ctx, VIDEO_FRAME_INFO_S *frm)
+{
+	HLE_U32 stride = frm->stVFrame.u32Stride[0];
+	HLE_U32 y_size = stride * frm->stVFrame.u32Height; //只取Y分量
+	HLE_U32 width = md_engine_blocks_w(ctx->engine) * MD_BLOCK_SIZE;
+	HLE_U32 height = md_engine_blocks_h(ctx->engine) * MD_BLOCK_SIZE;
+	int ret;
+
+	if (detect_region.u16Left + width > frm->stVFrame.u32Width
+		|| detect_region.u16Top + height > frm->stVFrame.u32Height)
+	{
+		ERROR_LOG("detect region out of frame(%dx%d)!\n", frm->stVFrame.u32Width, frm->stVFrame.u32Height);
+		return HLE_RET_ERROR;
+	}
+
+	/*----源图像数据进行内存映射--因源的虚拟地址为空---------------*/
+	HLE_U8 *y = (HLE_U8 *) HI_MPI_SYS_Mmap(frm->stVFrame.u32PhyAddr[0], y_size);
+	if (NULL == y)
+	{
+		ERROR_LOG("HI_MPI_SYS_Mmap failed !\n");
+		return HLE_RET_ERROR;
+	}
+
+	//第一帧只建立背景，结果为空
+	ret = md_engine_process(ctx->engine, y + detect_region.u16Top * stride + detect_region.u16Left, stride, &ctx->result);
+	HI_MPI_SYS_Munmap(y, y_size);
+
+	return (ret < 0) ? HLE_RET_ERROR : HLE_RET_OK;
+}
+#endif
+
+/*
+功能：亮度统计（WDR、IR-CUT、OSD 反色使用），MD 通道的帧每 LUMA_STAT_INTERVAL 帧统计一次
+参数：
+		@frm：VPSS 帧（整幅图像，不受检测区域限制）
+*/
+static void motion_detect_luma_stat(VIDEO_FRAME_INFO_S *frm)
+{
+	HLE_U32 stride = frm->stVFrame.u32Stride[0];
+	HLE_U32 y_size = stride * frm->stVFrame.u32Height; //只取Y分量
+
+	HLE_U8 *y = (HLE_U8 *) HI_MPI_SYS_Mmap(frm->stVFrame.u32PhyAddr[0], y_size);
+	if (NULL == y)
+	{
+		ERROR_LOG("HI_MPI_SYS_Mmap failed !\n");
+		return;
+	}
+
+	luma_stat_feed(y, frm->stVFrame.u32Width, frm->stVFrame.u32Height, stride);
+	HI_MPI_SYS_Munmap(y, y_size);
+}
+
 void *motion_detect_proc(void *arg)
 {
-	pthread_detach(pthread_self());
-	
 	DEBUG_LOG("pid = %d\n", getpid());
 	prctl(PR_SET_NAME, "hal_md", 0, 0, 0);
 
 	MOTION_CONTEX* ctx = (MOTION_CONTEX*) arg;
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 	int first = 1;
 	int idx = 0;
 	IVE_DST_IMAGE_S sad;
 
 	memset(&sad, 0, sizeof (sad));
+#endif
 
 
 	while (vda_md_proc_flag) 
 	{
 		HLE_S32 ret;
-		//pthread_mutex_lock(&ctx->lock);
 		
 		/*---需要重新配置 灵敏度阈值------------*/
 		if (ctx->dirty) 
 		{
 			ctx->dirty = 0;
-			ctx->count = 0;
-			MD_ATTR_S attr;
-			ret = HI_IVS_MD_GetChnAttr(ctx->chn, &attr);
-			if (HI_SUCCESS == ret) 
-			{
-				attr.u16SadThr = md_thres[ctx->usr_config_level];
-				ret = HI_IVS_MD_SetChnAttr(ctx->chn, &attr);
-				if (HI_SUCCESS != ret) 
-				{
-					ERROR_LOG("HI_IVS_MD_SetChnAttr fail: %#x\n", ret);
-				}
-			} 
-			else 
-			{
-				ERROR_LOG("HI_IVS_MD_GetChnAttr fail: %#x\n", ret);
-			}
+			motion_detect_apply_zones(ctx);
+			motion_detect_set_level(ctx);
 		}
 
 		/*---获取一帧帧数据------------*/
@@ -338,27 +614,17 @@ void *motion_detect_proc(void *arg)
 		ret = HI_MPI_VPSS_GetChnFrame(VPSS_GRP_ID, VPSS_CHN_MD, &frm, 0);
 		if (HI_ERR_VPSS_BUF_EMPTY == ret) 
 		{
-			//pthread_mutex_unlock(&ctx->lock);
 			usleep(10 * 1000);
 			continue;
 		} 
 		else if (HI_SUCCESS != ret) 
 		{
-			//pthread_mutex_unlock(&ctx->lock);
 			ERROR_LOG("HI_MPI_VPSS_GetChnFrame fail: %#x\n", ret);
 			continue;
 		}
 		//长宽打印 480*272
 		//DEBUG_LOG("MD===== HI_MPI_VPSS_GetChnFrame : width:%d  height:%d\n",frm.stVFrame.u32Width,frm.stVFrame.u32Height);
 
-		/*
-		for(int i = 0; i<3 ; i++)
-		{
-			DEBUG_LOG("u32PhyAddr[] = %x pVirAddr[] = %x u32Stride[] = %d\n",frm.stVFrame.u32PhyAddr[i],frm.stVFrame.pVirAddr[i],frm.stVFrame.u32Stride[i]);
-		}
-		DEBUG_LOG("Top(%d) bottom(%d) left(%d) right(%d)\n",frm.stVFrame.s16OffsetTop,frm.stVFrame.s16OffsetBottom,frm.stVFrame.s16OffsetLeft,frm.stVFrame.s16OffsetRight);
-		*/
-		
 		/*-----保存Y分量数据--------------------------*/
 		#if 0
 		static int  write_times = 1;
@@ -383,52 +649,29 @@ void *motion_detect_proc(void *arg)
 		}
 		#endif
 		/*-----------------------------------*/
-		
 
-		if (!first) //不是第一次循环，则可进行MD侦测（此时已经有了参考帧）
-		{
-			ret = cut_yuv_region(&frm, &detect_region, &ctx->img[idx]);
-			if (HLE_RET_OK == ret) 
-			{
-				ret = HI_IVS_MD_Process(ctx->chn, &ctx->img[idx], &ctx->img[1 - idx], &sad, &ctx->blob); //算法把当前帧和上一帧进行比较
-				if (HI_SUCCESS == ret) 
-				{
-					//结果分析
-					//DEBUG_LOG("into motion_detect_data_proc\n");
-					motion_detect_data_proc(ctx);
-					idx = 1 - idx;//1,0,1,0,....循环遍历ctx->img[2]数组
-				}
-				else
-					ERROR_LOG("HI_IVS_MD_Process failed ret(%#x)!\n",ret);
-			}
-			else
-				ERROR_LOG("call cut_yuv_region error!\n");
-		} 
-		else  //第一次循环（此时 idx = 0），拷贝数据作为源图像
-		{	
-			ret = cut_yuv_region(&frm, &detect_region, &ctx->img[1 - idx]);
-			if(ret == HLE_RET_OK)
-			{
-				first = 0;
-			}
-			else
-				ERROR_LOG("call cut_yuv_region error!\n");
-	
-		}
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
+		ret = motion_detect_frame(ctx, &frm, &first, &idx, &sad);
+#else
+		ret = motion_detect_frame(ctx, &frm);
+#endif
+		if (HLE_RET_OK == ret)
+			motion_detect_data_proc(ctx, &ctx->result);
+
+		if (luma_stat_due())
+			motion_detect_luma_stat(&frm);
 
-ERR:
 		ret = HI_MPI_VPSS_ReleaseChnFrame(VPSS_GRP_ID, VPSS_CHN_MD, &frm);
 		if (HI_SUCCESS != ret) 
 		{
 			ERROR_LOG("HI_MPI_VPSS_ReleaseChnFrame fail: %#x\n", ret);
 		}
-
-		//pthread_mutex_unlock(&ctx->lock);
 	}
 
 	pthread_exit(0) ;
 }
 
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 static int motion_detect_stop(MD_CHN mdChn)
 {
 	HLE_S32 ret;
@@ -441,6 +684,7 @@ static int motion_detect_stop(MD_CHN mdChn)
 
 	return HLE_RET_OK;
 }
+#endif
 
 #if 0
 
@@ -474,13 +718,24 @@ void motion_detect_exit(void)
 
 	HLE_S32 chn;
 	for (chn = 0; chn < VI_PORT_NUM; chn++) {
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 		motion_detect_stop(GET_MOTION_CHN_ID(chn));
+#else
+		md_engine_destroy(mdCtx[chn].engine);
+		mdCtx[chn].engine = NULL;
+#endif
+		md_zone_destroy(mdCtx[chn].zones);
+		mdCtx[chn].zones = NULL;
 		//pthread_mutex_destroy(&mdCtx[chn].lock);
 	}
 
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
 	HI_IVS_MD_Exit();
+#endif
 }
 
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
+
 
 /*******************************************************************************
 *@ Description    :初始化 img 的空间，（按照 width height 申请MMZ内存）
@@ -509,6 +764,7 @@ static int ive_create_image(IVE_IMAGE_S* img, HLE_U16 width, HLE_U16 height)
 
 	return HLE_RET_OK;
 }
+#endif
 
 void get_vda_size(SIZE_S *size);
 int motion_detect_arg_init(void);
@@ -519,15 +775,9 @@ int motion_detect_init(void)
 	if (HLE_RET_OK != motion_detect_arg_init())
 		return HLE_RET_ERROR;
 
-	HLE_S32 ret;
-	ret = HI_IVS_MD_Init();
-	if (HI_SUCCESS != ret) 
-	{
-		ERROR_LOG("HI_IVS_MD_Init fail: %#x\n", ret);
-	}
-
 	//获取要检测的图像大小信息
 	get_vda_size(&mdSize);//默认值
+	vdaSize = mdSize;
 	
 	
 	/*----手动配置MD侦测区域，后期应为客户端下发区间信息-----------------*/
@@ -545,6 +795,14 @@ int motion_detect_init(void)
 	mdSize.u32Height = detect_region.u32Height; //图像高，必须为宏块高的整数倍，范围：[64, 1080]
 	mdSize.u32Width = detect_region.u32Width;	//图像宽，必须为宏块宽的整数倍，范围：[64, 1920]
 	
+	HLE_S32 chn;
+#if (MOTION_DETECT_BACKEND == MOTION_DETECT_IVE)
+	HLE_S32 ret;
+	ret = HI_IVS_MD_Init();
+	if (HI_SUCCESS != ret) 
+	{
+		ERROR_LOG("HI_IVS_MD_Init fail: %#x\n", ret);
+	}
 
 	MD_ATTR_S mdAttr;
 	mdAttr.enAlgMode = MD_ALG_MODE_BG; //MD 算法模式:背景法
@@ -559,7 +817,6 @@ int motion_detect_init(void)
 	mdAttr.stCclCtrl.u16Step = 1 << (2 + mdAttr.enSadMode); //面积阈值增长步长。取值范围：[1,65535]
 	mdAttr.stCclCtrl.u16InitAreaThr = mdAttr.stCclCtrl.u16Step * mdAttr.stCclCtrl.u16Step;//初始面积阈值。取值范围：[0, 65535]
 
-	HLE_S32 chn;
 	for (chn = 0; chn < VI_PORT_NUM; chn++) 
 	{
 		MD_CHN mdChn = GET_MOTION_CHN_ID(chn);
@@ -582,6 +839,11 @@ int motion_detect_init(void)
 			return HLE_RET_ERROR;
 		}
 
+		mdCtx[chn].zones = md_zone_create(mdSize.u32Width / MD_BLOCK_SIZE, mdSize.u32Height / MD_BLOCK_SIZE);
+		if (NULL == mdCtx[chn].zones) {
+			return HLE_RET_ERROR;
+		}
+
 		//目标图像内存申请(用户态分配 MMZ 内存)
 		mdCtx[chn].blob.u32Size = sizeof (IVE_CCBLOB_S);
 		ret = HI_MPI_SYS_MmzAlloc(&mdCtx[chn].blob.u32PhyAddr, (void**) &mdCtx[chn].blob.pu8VirAddr, NULL, HI_NULL, mdCtx[chn].blob.u32Size);
@@ -606,6 +868,23 @@ int motion_detect_init(void)
 
 		//pthread_mutex_init(&mdCtx[chn].lock, NULL);
 	}
+#else
+	/*----软件引擎：直接在 VPSS 帧上检测，不需要 MMZ 拷贝，宽高不需要 16 对齐-----*/
+	for (chn = 0; chn < VI_PORT_NUM; chn++) 
+	{
+		mdCtx[chn].chn = GET_MOTION_CHN_ID(chn);
+		mdCtx[chn].engine = md_engine_create(width, height);
+		if (NULL == mdCtx[chn].engine) {
+			ERROR_LOG("md_engine_create(%d, %d) fail\n", width, height);
+			return HLE_RET_ERROR;
+		}
+		mdCtx[chn].zones = md_zone_create(md_engine_blocks_w(mdCtx[chn].engine), md_engine_blocks_h(mdCtx[chn].engine));
+		if (NULL == mdCtx[chn].zones) {
+			return HLE_RET_ERROR;
+		}
+		md_engine_set_zones(mdCtx[chn].engine, mdCtx[chn].zones);
+	}
+#endif
 
 	if (0 == vda_md_proc_flag) 
 	{
@@ -653,10 +932,139 @@ int motion_detect_get_state(int *state)
 	return HLE_RET_OK;
 }
 
+int motion_detect_set_zones(int chn, const MD_ZONE_ATTR *zones, int num)
+{
+	int i;
+
+	if ((0 != chn) || (num < 0) || (num > MD_ZONE_NUM) || (num > 0 && NULL == zones)) 
+	{
+		ERROR_LOG("para error.");
+		return HLE_RET_EINVAL;
+	}
+	for (i = 0; i < num; i++)
+	{
+		if (zones[i].point_num < 2 || zones[i].point_num > MD_ZONE_POINT_MAX || zones[i].level >= MD_LEVEL_NUM)
+		{
+			ERROR_LOG("zone %d: point_num %d level %d error.\n", i, zones[i].point_num, zones[i].level);
+			return HLE_RET_EINVAL;
+		}
+	}
+
+	pthread_mutex_lock(&md_zone_lock);
+	memset(mdCtx[chn].zone_cfg, 0, sizeof(mdCtx[chn].zone_cfg));
+	if (num)
+		memcpy(mdCtx[chn].zone_cfg, zones, num * sizeof(MD_ZONE_ATTR));
+	mdCtx[chn].zone_num = num;
+	memset(&mdCtx[chn].zone_state, 0, sizeof(mdCtx[chn].zone_state)); //区域编号的含义变了，计数清零
+	pthread_mutex_unlock(&md_zone_lock);
+	DEBUG_LOG("motion detect zones %d\n", num);
+	mdCtx[chn].dirty = 1;
+
+	return HLE_RET_OK;
+}
+
+int motion_detect_get_zones(int chn, MD_ZONE_ATTR *zones, int *num)
+{
+	if ((0 != chn) || (NULL == zones) || (NULL == num)) 
+	{
+		ERROR_LOG("para error.");
+		return HLE_RET_EINVAL;
+	}
+
+	pthread_mutex_lock(&md_zone_lock);
+	memcpy(zones, mdCtx[chn].zone_cfg, sizeof(mdCtx[chn].zone_cfg));
+	*num = mdCtx[chn].zone_num;
+	pthread_mutex_unlock(&md_zone_lock);
+
+	return HLE_RET_OK;
+}
+
+int motion_detect_get_zone_state(int chn, MD_ZONE_STATE *state)
+{
+	if ((0 != chn) || (NULL == state)) 
+	{
+		ERROR_LOG("para error.");
+		return HLE_RET_EINVAL;
+	}
+
+	pthread_mutex_lock(&md_zone_lock);
+	*state = mdCtx[chn].zone_state;
+	pthread_mutex_unlock(&md_zone_lock);
+
+	return HLE_RET_OK;
+}
+
 
 #define MOTION_TETECT_CONFIG "/jffs0/motion_detect"
 MOTION_DETECT_ATTR g_motion_detect_artr;
 
+/*
+检测区域配置（接在 Enable/Level 之后）：
+Zones=N
+Zone=enable,level,min_size,point_num,x0,y0,x1,y1,...	（N 行）
+*/
+static int motion_detect_write_zones(FILE *fp)
+{
+	MD_ZONE_ATTR zones[MD_ZONE_NUM];
+	int num, i, j;
+
+	motion_detect_get_zones(0, zones, &num);
+	if (fprintf(fp, "Zones=%d\n", num) < 0)
+		return -1;
+	for (i = 0; i < num; i++)
+	{
+		fprintf(fp, "Zone=%d,%d,%d,%d", zones[i].enable, zones[i].level, zones[i].min_size, zones[i].point_num);
+		for (j = 0; j < zones[i].point_num; j++)
+			fprintf(fp, ",%d,%d", zones[i].point[j].x, zones[i].point[j].y);
+		if (fprintf(fp, "\n") < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+//读取检测区域配置，没有区域配置（旧的配置文件）时为整幅图像
+static void motion_detect_read_zones(FILE *fp)
+{
+	MD_ZONE_ATTR zones[MD_ZONE_NUM];
+	int num = 0, i, j;
+
+	memset(zones, 0, sizeof(zones));
+	if (1 != fscanf(fp, "Zones=%d\n", &num) || num < 0 || num > MD_ZONE_NUM)
+		num = 0;
+	for (i = 0; i < num; i++)
+	{
+		int enable, level, min_size, point_num, x, y;
+		if (4 != fscanf(fp, "Zone=%d,%d,%d,%d", &enable, &level, &min_size, &point_num)
+			|| point_num < 2 || point_num > MD_ZONE_POINT_MAX)
+		{
+			ERROR_LOG("bad zone %d in %s\n", i, MOTION_TETECT_CONFIG);
+			num = 0;
+			break;
+		}
+		zones[i].enable = enable;
+		zones[i].level = level;
+		zones[i].min_size = min_size;
+		zones[i].point_num = point_num;
+		for (j = 0; j < point_num; j++)
+		{
+			if (2 != fscanf(fp, ",%d,%d", &x, &y))
+				break;
+			zones[i].point[j].x = x;
+			zones[i].point[j].y = y;
+		}
+		if (j != point_num)
+		{
+			ERROR_LOG("bad zone %d in %s\n", i, MOTION_TETECT_CONFIG);
+			num = 0;
+			break;
+		}
+		fscanf(fp, "\n");
+	}
+
+	motion_detect_set_zones(0, zones, num);
+}
+
 /*
 初始化 MD 的参数配置（MD配置文件读取及写入）
 */
@@ -714,7 +1122,7 @@ int motion_detect_arg_init(void)
 		//fscanf(index_fp, "Rec_right=%u\n", &g_motion_detect_artr.rect[0].right);
 		//fscanf(index_fp, "Rec_top=%u\n", &g_motion_detect_artr.rect[0].top);
 		//fscanf(index_fp, "Rec_bottom=%u\n", &g_motion_detect_artr.rect[0].bottom);
-
+		motion_detect_read_zones(index_fp);
 
 		fclose(index_fp);
 	}
@@ -739,7 +1147,7 @@ int motion_detect_write_cfg(void)
 		g_motion_detect_artr.rect[0].right,
 		g_motion_detect_artr.rect[0].top,
 		g_motion_detect_artr.rect[0].bottom*/);
-	if (ret < 0) {
+	if (ret < 0 || motion_detect_write_zones(index_fp) < 0) {
 		ERROR_LOG("motion_detect fprintf fail: %d\n", ret);
 		fclose(index_fp);
 		return -1;
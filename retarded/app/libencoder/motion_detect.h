@@ -11,6 +11,11 @@ extern "C"
 
 #define MAX_MD_AREA_NUM     4
 
+/*---# 移动侦测后端---------*/
+#define MOTION_DETECT_IVE       1   //海思 IVS MD（IVE 硬件加速）
+#define MOTION_DETECT_SOFT      2   //软件引擎（md_engine.c），不依赖 IVE
+#define MOTION_DETECT_BACKEND   MOTION_DETECT_IVE
+
 //移动侦测属性
 
 typedef struct
@@ -21,6 +26,36 @@ typedef struct
     //HLE_RECT rect[MAX_MD_AREA_NUM];  /*REL_COORD_WIDTH坐标系*/
 } MOTION_DETECT_ATTR;
 
+#define MD_ZONE_NUM         MAX_MD_AREA_NUM     //最多检测区域数
+#define MD_ZONE_POINT_MAX   8                   //多边形最多顶点数
+
+//检测区域顶点，x, y 坐标为相对REL_COORD_WIDTH X REL_COORD_HEIGHT坐标系大小
+typedef struct
+{
+    HLE_U16 x;
+    HLE_U16 y;
+} MD_POINT;
+
+//移动侦测区域
+typedef struct
+{
+    HLE_U8 enable; //1--enable, 0--disable（如树木、马路等不需要告警的区域）
+    HLE_U8 level; //[0, 4], 0 is most sensitive，运动面积占本区域面积的百分比阈值
+    HLE_U8 point_num; //2：矩形（point[0] 左上角，point[1] 右下角）；3 ~ MD_ZONE_POINT_MAX：多边形
+    HLE_U8 reserved1;
+    HLE_U16 min_size; //最小目标面积，整幅图像面积的万分比，更小的运动目标不计入本区域；0 不过滤
+    HLE_U16 reserved2;
+    MD_POINT point[MD_ZONE_POINT_MAX];
+} MD_ZONE_ATTR;
+
+//各检测区域的状态
+typedef struct
+{
+    HLE_U32 alarm_mask; //当前处于告警状态的区域，bit i 对应区域 i
+    HLE_U32 hits[MD_ZONE_NUM]; //各区域的告警次数（从无告警变为告警时加 1）
+    HLE_U8 percent[MD_ZONE_NUM]; //最近一帧各区域内的运动面积百分比
+} MD_ZONE_STATE;
+
 
 /*
     function:  motion_detect_config
@@ -45,6 +80,40 @@ int motion_detect_config(int chn, MOTION_DETECT_ATTR *attr);
         <0, 失败，返回值为错误码，具体见错误码定义
  */
 int motion_detect_get_state(int *state);
+
+/*
+    function:  motion_detect_set_zones
+    description:  配置检测区域，各区域单独判断告警，任一区域告警时该通道告警（调用 motion_detect_write_cfg 保存）
+    args:
+        int channel[in]，视频输入通道号
+        const MD_ZONE_ATTR *zones[in]，区域属性
+        int num[in]，区域数 [0, MD_ZONE_NUM]，0 表示整幅图像为一个区域（灵敏度使用 MOTION_DETECT_ATTR 的 level）
+    return:
+        0, 成功
+        <0, 失败，返回值为错误码，具体见错误码定义
+ */
+int motion_detect_set_zones(int chn, const MD_ZONE_ATTR *zones, int num);
+
+/*
+    function:  motion_detect_get_zones
+    description:  获取检测区域配置
+    args:
+        MD_ZONE_ATTR *zones[out]，至少 MD_ZONE_NUM 个
+        int *num[out]，区域数
+ */
+int motion_detect_get_zones(int chn, MD_ZONE_ATTR *zones, int *num);
+
+/*
+    function:  motion_detect_get_zone_state
+    description:  获取各检测区域的告警状态和告警次数
+    args:
+        int channel[in]，视频输入通道号
+        MD_ZONE_STATE *state[out]，区域状态（没有配置区域时只有区域 0，即整幅图像）
+    return:
+        0, 成功
+        <0, 失败，返回值为错误码，具体见错误码定义
+ */
+int motion_detect_get_zone_state(int chn, MD_ZONE_STATE *state);
 int motion_detect_write_cfg(void);
 int motion_detect_init(void);
 void motion_detect_exit(void);
@@ -0,0 +1,142 @@
+/***************************************************************************
+* @file:pcm_ring.c
+* @author:
+* @date:  10,19,2026
+* @brief:  AI -> AAC 编码线程的 PCM 环形缓存（单生产者/单消费者，按样本计数，带时间戳锚点）
+* @attention:不依赖海思 SDK，可以在主机上用 ThreadSanitizer 检查（test/test_pcm_ring.c）
+***************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "typeport.h"
+#include "pcm_ring.h"
+
+
+int pcm_ring_init(pcm_ring_t *ring, unsigned int sample_rate)
+{
+	if(NULL == ring || 0 == sample_rate)
+	{
+		ERROR_LOG("illegal parameter!\n");
+		return -1;
+	}
+
+	memset(ring, 0, sizeof(*ring));
+	ring->sample_rate = sample_rate;
+	ring->need_mark = 1;
+	pthread_mutex_init(&ring->mut, NULL);
+	pthread_cond_init(&ring->cnd, NULL);
+
+	return 0;
+}
+
+int pcm_ring_write(pcm_ring_t *ring, const short *data, unsigned int samples, unsigned long long pts)
+{
+	unsigned int head = ring->head;
+	unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if(PCM_RING_SAMPLES - (head - tail) < samples)
+	{
+		/*统计可能被其他线程读取（pcm_ring_get_overrun）*/
+		unsigned int cnt = __atomic_add_fetch(&ring->overrun_cnt, 1, __ATOMIC_RELAXED);
+		unsigned int total = __atomic_add_fetch(&ring->overrun_samples, samples, __ATOMIC_RELAXED);
+		ring->need_mark = 1;	//丢了数据，下一段要重新对时
+		if(1 == cnt || 0 == cnt % 50)
+		{
+			ERROR_LOG("PCM ring overrun! drop %u samples, total %u frames %u samples\n",
+					  samples,cnt,total);
+		}
+		return -1;
+	}
+
+	if(ring->need_mark)
+	{
+		unsigned int mark_head = ring->mark_head;
+		if(mark_head - __atomic_load_n(&ring->mark_tail, __ATOMIC_ACQUIRE) < PCM_RING_MARK_NUM)
+		{
+			ring->mark[mark_head & (PCM_RING_MARK_NUM - 1)].pos = head;
+			ring->mark[mark_head & (PCM_RING_MARK_NUM - 1)].pts = pts;
+			__atomic_store_n(&ring->mark_head, mark_head + 1, __ATOMIC_RELEASE);
+			ring->need_mark = 0;
+		}
+		//锚点环满（消费者长时间不取）时下一帧再记录
+	}
+
+	unsigned int off = head & (PCM_RING_SAMPLES - 1);
+	unsigned int first = PCM_RING_SAMPLES - off;
+	if(first > samples)
+		first = samples;
+	memcpy(ring->buf + off, data, first * sizeof(short));
+	memcpy(ring->buf, data + first, (samples - first) * sizeof(short));
+	__atomic_store_n(&ring->head, head + samples, __ATOMIC_RELEASE);
+
+	/*只用于唤醒等待的消费者，数据本身不在锁内*/
+	pthread_mutex_lock(&ring->mut);
+	pthread_cond_signal(&ring->cnd);
+	pthread_mutex_unlock(&ring->mut);
+
+	return 0;
+}
+
+int pcm_ring_read(pcm_ring_t *ring, short *out, unsigned int samples, unsigned long long *pts)
+{
+	unsigned int tail = ring->tail;
+	unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if(head - tail < samples)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += PCM_RING_WAIT_MS / 1000;
+		ts.tv_nsec += (PCM_RING_WAIT_MS % 1000) * 1000000L;
+		if(ts.tv_nsec >= 1000000000L)
+		{
+			ts.tv_sec ++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&ring->mut);
+		while((head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) - tail < samples)
+		{
+			if(ETIMEDOUT == pthread_cond_timedwait(&ring->cnd, &ring->mut, &ts))
+				break;
+		}
+		pthread_mutex_unlock(&ring->mut);
+		if(head - tail < samples)
+			return -1;
+	}
+
+	/*取出位置不晚于帧首样本的最新锚点*/
+	unsigned int mark_head = __atomic_load_n(&ring->mark_head, __ATOMIC_ACQUIRE);
+	while(ring->mark_tail != mark_head)
+	{
+		pcm_mark_t *mark = &ring->mark[ring->mark_tail & (PCM_RING_MARK_NUM - 1)];
+		if((int)(mark->pos - tail) > 0)
+			break;
+		ring->cur_mark = *mark;
+		__atomic_store_n(&ring->mark_tail, ring->mark_tail + 1, __ATOMIC_RELEASE);
+	}
+	*pts = ring->cur_mark.pts +
+		   (unsigned long long)(tail - ring->cur_mark.pos) * 1000000ULL / ring->sample_rate;
+
+	unsigned int off = tail & (PCM_RING_SAMPLES - 1);
+	unsigned int first = PCM_RING_SAMPLES - off;
+	if(first > samples)
+		first = samples;
+	memcpy(out, ring->buf + off, first * sizeof(short));
+	memcpy(out + first, ring->buf, (samples - first) * sizeof(short));
+	__atomic_store_n(&ring->tail, tail + samples, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int pcm_ring_get_overrun(pcm_ring_t *ring, unsigned int *frames, unsigned int *samples)
+{
+	if(frames)
+		*frames = __atomic_load_n(&ring->overrun_cnt, __ATOMIC_RELAXED);
+	if(samples)
+		*samples = __atomic_load_n(&ring->overrun_samples, __ATOMIC_RELAXED);
+	return 0;
+}
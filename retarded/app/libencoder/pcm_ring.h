@@ -0,0 +1,109 @@
+/***************************************************************************
+* @file:pcm_ring.h
+* @author:
+* @date:  10,19,2026
+* @brief:  AI -> AAC 编码线程的 PCM 环形缓存（单生产者/单消费者，按样本计数，带时间戳锚点）
+* @attention:单生产者（AI 采集线程）/单消费者（AAC 编码线程）：
+	1.生产者只写 head，消费者只写 tail，数据读写不加锁；锁和条件变量只用于消费者等待数据。
+	2.缓存满时丢弃新到的 PCM（不覆盖未编码的数据），记录溢出次数并打印。
+	3.时间戳由样本数推算：每次丢数据（或第一帧）后记录一个锚点（样本位置 + AI 帧时间戳），
+	  读出帧的 PTS = 锚点时间戳 + (帧首样本位置 - 锚点位置) / 采样率。
+	不依赖海思 SDK，主机测试见 test/test_pcm_ring.c。
+***************************************************************************/
+#ifndef _PCM_RING_H
+#define _PCM_RING_H
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PCM_RING_SAMPLES    (8192)  //环形缓存的样本数（2 的幂，16K 采样约 512ms）
+#define PCM_RING_MARK_NUM   (16)    //时间戳锚点环的容量（2 的幂）
+#define PCM_RING_WAIT_MS    (1000)  //消费者等待一帧数据的超时
+
+typedef struct _pcm_mark_t
+{
+	unsigned int		pos;		//锚点的样本位置
+	unsigned long long	pts;		//锚点样本的时间戳（us，来自 AI 帧）
+}pcm_mark_t;
+
+typedef struct _pcm_ring_t
+{
+	short				buf[PCM_RING_SAMPLES];
+	unsigned int		head;			//已写入的样本总数（生产者写）
+	unsigned int		tail;			//已取出的样本总数（消费者写）
+	unsigned int		sample_rate;	//采样率，用于推算时间戳
+
+	pcm_mark_t			mark[PCM_RING_MARK_NUM];
+	unsigned int		mark_head;		//生产者写
+	unsigned int		mark_tail;		//消费者写
+	pcm_mark_t			cur_mark;		//消费者当前使用的锚点
+	int					need_mark;		//生产者：下一帧需要记录锚点（第一帧 / 丢过数据）
+
+	unsigned int		overrun_cnt;	//溢出（丢弃）的 AI 帧数（生产者写）
+	unsigned int		overrun_samples;//溢出丢弃的样本数（生产者写）
+
+	pthread_mutex_t		mut;
+	pthread_cond_t		cnd;
+}pcm_ring_t;
+
+
+/*
+    function:  pcm_ring_init
+    description:  初始化环形缓存（清空数据和统计）
+    args:
+        pcm_ring_t *ring[in]
+        unsigned int sample_rate[in]，采样率（Hz）
+    return:
+        0, 成功
+        <0, 参数错误
+ */
+int pcm_ring_init(pcm_ring_t *ring, unsigned int sample_rate);
+
+/*
+    function:  pcm_ring_write
+    description:  把一段 PCM 样本写入环形缓存（生产者），空间不足时整段丢弃
+    args:
+        pcm_ring_t *ring[in]
+        const short *data[in] unsigned int samples[in]，PCM 样本和样本数
+        unsigned long long pts[in]，第一个样本的时间戳（us）
+    return:
+        0, 成功
+        <0, 缓存空间不足（整段丢弃）
+ */
+int pcm_ring_write(pcm_ring_t *ring, const short *data, unsigned int samples, unsigned long long pts);
+
+/*
+    function:  pcm_ring_read
+    description:  从环形缓存取出一帧样本（消费者），数据不足时最多等待 PCM_RING_WAIT_MS
+    args:
+        pcm_ring_t *ring[in]
+        short *out[out] unsigned int samples[in]，输出缓存和样本数
+        unsigned long long *pts[out]，第一个样本的时间戳（us）
+    return:
+        0, 成功
+        <0, 等待超时
+ */
+int pcm_ring_read(pcm_ring_t *ring, short *out, unsigned int samples, unsigned long long *pts);
+
+/*
+    function:  pcm_ring_get_overrun
+    description:  获取溢出统计（任何线程都可以调用）
+    args:
+        pcm_ring_t *ring[in]
+        unsigned int *frames[out]，丢弃的帧数（可为 NULL）
+        unsigned int *samples[out]，丢弃的样本数（可为 NULL）
+    return:
+        0, 成功
+ */
+int pcm_ring_get_overrun(pcm_ring_t *ring, unsigned int *frames, unsigned int *samples);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,324 @@
+/***************************************************************************
+* @file:sd_diskio.c
+* @author:
+* @date:  10,19,2026
+* @brief:  FatFs 底层磁盘接口：0 号物理驱动器对应 SD 卡块设备（主机测试时为镜像文件）
+* @attention:1.LiteOS 上 open() 不能打开块设备节点（VFS 没有 BCH 块转字符驱动），
+               用 open_blockdriver + los_part_find 找到分区，按扇区 los_part_read/los_part_write；
+               主机上按字节偏移 lseek64 + read/write 访问镜像文件。
+             2.多线程访问由 disk_lock 串行化。
+             3.GET_BLOCK_SIZE 返回 4MB（SD 卡的分配单元 AU），f_mkfs 按它对齐数据区。
+             4.FatFs 的符号已改名（ffrename.h），这里的 disk_xxx 不会替换 LiteOS 内核 FAT 的同名函数。
+***************************************************************************/
+#define _LARGEFILE64_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/*LiteOS 的头文件放在 ff.h 之前，不受 ffrename.h 的宏影响*/
+#ifdef __LITEOS__
+#include "fs/fs.h"
+#include "disk.h"
+#endif
+
+#include "ff.h"
+#include "diskio.h"
+#include "sd_record.h"
+
+#define SD_SECTOR_SIZE      512
+#define SD_ERASE_BLOCK      8192        //擦除块（扇区数），4MB
+
+static int sd_ready;                    //设备已关联
+static DWORD sd_sectors;                //设备扇区数
+static pthread_mutex_t disk_lock = PTHREAD_MUTEX_INITIALIZER;
+static sd_disk_stat_t disk_stat;
+
+/*---#块设备访问（disk_lock 内调用）------------------------------------------------*/
+#ifdef __LITEOS__
+static struct inode *sd_inode;
+static int sd_part = -1;                //系统分区号（los_part_xxx 使用）
+
+static int sd_dev_open(const char *path, int sync, DWORD *sectors)
+{
+    struct inode *inode = NULL;
+    los_part *part;
+    int ret;
+
+    ret = open_blockdriver(path, 0, &inode);
+    if (ret != 0)
+    {
+        ERROR_LOG("open_blockdriver %s fail: %d\n", path, ret);
+        return HLE_RET_ENOTINIT;
+    }
+
+    part = los_part_find(inode);
+    if (NULL == part)
+    {
+        ERROR_LOG("%s: no partition!\n", path);
+        close_blockdriver(inode);
+        return HLE_RET_ENOTINIT;
+    }
+
+    /*写卡总是同步的（没有页缓存），sync 只用于主机测试*/
+    sd_inode = inode;
+    sd_part = part->part_id;
+    *sectors = part->sector_count;
+    return HLE_RET_OK;
+}
+
+static void sd_dev_close(void)
+{
+    close_blockdriver(sd_inode);
+    sd_inode = NULL;
+    sd_part = -1;
+}
+
+static int sd_dev_read(DWORD sector, BYTE *buff, UINT count)
+{
+    return los_part_read(sd_part, buff, sector, count);
+}
+
+static int sd_dev_write(DWORD sector, const BYTE *buff, UINT count)
+{
+    return los_part_write(sd_part, (void *)buff, sector, count);
+}
+
+static int sd_dev_sync(void)
+{
+    return los_part_ioctl(sd_part, DISK_CTRL_SYNC, NULL);
+}
+#else
+static int sd_fd = -1;
+
+static int sd_dev_open(const char *path, int sync, DWORD *sectors)
+{
+    int flags = O_RDWR;
+
+#ifdef O_DSYNC
+    if (sync)
+        flags |= O_DSYNC;
+#endif
+    int fd = open(path, flags);
+    if (fd < 0)
+    {
+        ERROR_LOG("open %s fail!\n", path);
+        return HLE_RET_ENOTINIT;
+    }
+
+    off64_t size = lseek64(fd, 0, SEEK_END);
+    if (size < 0)
+    {
+        close(fd);
+        return HLE_RET_ERROR;
+    }
+
+    sd_fd = fd;
+    *sectors = (DWORD)(size / SD_SECTOR_SIZE);
+    return HLE_RET_OK;
+}
+
+static void sd_dev_close(void)
+{
+    close(sd_fd);
+    sd_fd = -1;
+}
+
+static int sd_dev_read(DWORD sector, BYTE *buff, UINT count)
+{
+    size_t len = (size_t)count * SD_SECTOR_SIZE;
+
+    if (lseek64(sd_fd, (off64_t)sector * SD_SECTOR_SIZE, SEEK_SET) < 0
+        || read(sd_fd, buff, len) != (ssize_t)len)
+        return -1;
+    return 0;
+}
+
+static int sd_dev_write(DWORD sector, const BYTE *buff, UINT count)
+{
+    size_t len = (size_t)count * SD_SECTOR_SIZE;
+
+    if (lseek64(sd_fd, (off64_t)sector * SD_SECTOR_SIZE, SEEK_SET) < 0
+        || write(sd_fd, buff, len) != (ssize_t)len)
+        return -1;
+    return 0;
+}
+
+static int sd_dev_sync(void)
+{
+    return fsync(sd_fd);
+}
+#endif
+
+int sd_disk_attach(const char *path, int sync)
+{
+    DWORD sectors = 0;
+    int ret;
+
+    sd_disk_detach();
+
+    pthread_mutex_lock(&disk_lock);
+    ret = sd_dev_open(path, sync, &sectors);
+    if (HLE_RET_OK == ret && sectors < 128)
+    {
+        ERROR_LOG("%s: invalid size %u sectors\n", path, (unsigned int)sectors);
+        sd_dev_close();
+        ret = HLE_RET_ERROR;
+    }
+    if (HLE_RET_OK == ret)
+    {
+        sd_ready = 1;
+        sd_sectors = sectors;
+        memset(&disk_stat, 0, sizeof (disk_stat));
+    }
+    pthread_mutex_unlock(&disk_lock);
+
+    if (HLE_RET_OK == ret)
+        DEBUG_LOG("%s: %u sectors\n", path, (unsigned int)sectors);
+    return ret;
+}
+
+void sd_disk_detach(void)
+{
+    pthread_mutex_lock(&disk_lock);
+    if (sd_ready)
+    {
+        sd_dev_close();
+        sd_ready = 0;
+    }
+    pthread_mutex_unlock(&disk_lock);
+}
+
+void sd_disk_get_stat(sd_disk_stat_t *stat, int clear)
+{
+    pthread_mutex_lock(&disk_lock);
+    *stat = disk_stat;
+    if (clear)
+        memset(&disk_stat, 0, sizeof (disk_stat));
+    pthread_mutex_unlock(&disk_lock);
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (0 == pdrv && sd_ready) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+
+    if (pdrv != 0 || 0 == count)
+        return RES_PARERR;
+
+    pthread_mutex_lock(&disk_lock);
+    if (!sd_ready)
+        res = RES_NOTRDY;
+    else if (sector + count > sd_sectors || sector + count < sector)
+        res = RES_PARERR;
+    else if (sd_dev_read(sector, buff, count) != 0)
+        res = RES_ERROR;
+    else
+    {
+        disk_stat.reads++;
+        disk_stat.read_sectors += count;
+    }
+    pthread_mutex_unlock(&disk_lock);
+
+    if (res != RES_OK)
+        ERROR_LOG("read sector %u count %u fail: %d\n", (unsigned int)sector, count, res);
+    return res;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+    struct timeval tv1, tv2;
+
+    if (pdrv != 0 || 0 == count)
+        return RES_PARERR;
+
+    pthread_mutex_lock(&disk_lock);
+    gettimeofday(&tv1, NULL);
+    if (!sd_ready)
+        res = RES_NOTRDY;
+    else if (sector + count > sd_sectors || sector + count < sector)
+        res = RES_PARERR;
+    else if (sd_dev_write(sector, buff, count) != 0)
+        res = RES_ERROR;
+    else
+    {
+        gettimeofday(&tv2, NULL);
+        HLE_U32 used = (tv2.tv_sec - tv1.tv_sec) * 1000000 + tv2.tv_usec - tv1.tv_usec;
+        if (used > disk_stat.max_write_us)
+            disk_stat.max_write_us = used;
+        disk_stat.writes++;
+        disk_stat.write_sectors += count;
+    }
+    pthread_mutex_unlock(&disk_lock);
+
+    if (res != RES_OK)
+        ERROR_LOG("write sector %u count %u fail: %d\n", (unsigned int)sector, count, res);
+    return res;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    DRESULT res = RES_OK;
+
+    if (pdrv != 0)
+        return RES_PARERR;
+
+    pthread_mutex_lock(&disk_lock);
+    if (!sd_ready)
+    {
+        res = RES_NOTRDY;
+    }
+    else
+    {
+        switch (cmd)
+        {
+            case CTRL_SYNC:
+                if (sd_dev_sync() != 0)
+                    res = RES_ERROR;
+                break;
+            case GET_SECTOR_COUNT:
+                *(DWORD *)buff = sd_sectors;
+                break;
+            case GET_SECTOR_SIZE:
+                *(WORD *)buff = SD_SECTOR_SIZE;
+                break;
+            case GET_BLOCK_SIZE:
+                *(DWORD *)buff = SD_ERASE_BLOCK;
+                break;
+            default:
+                res = RES_PARERR;
+                break;
+        }
+    }
+    pthread_mutex_unlock(&disk_lock);
+
+    return res;
+}
+
+/*FatFs 文件时间戳（本地时间）*/
+DWORD get_fattime(void)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+
+    localtime_r(&now, &tm);
+    if (tm.tm_year < 80)
+        return (DWORD)(0 << 25 | 1 << 21 | 1 << 16);
+
+    return (DWORD)(tm.tm_year - 80) << 25 | (DWORD)(tm.tm_mon + 1) << 21 | (DWORD)tm.tm_mday << 16
+           | (DWORD)tm.tm_hour << 11 | (DWORD)tm.tm_min << 5 | (DWORD)(tm.tm_sec / 2);
+}
+
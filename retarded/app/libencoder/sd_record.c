@@ -0,0 +1,1175 @@
+/***************************************************************************
+* @file:sd_record.c
+* @author:
+* @date:  10,19,2026
+* @brief:  SD 卡连续录像：预分配切片 + 双缓存整块写卡 + 环形覆盖 + 时间索引
+* @attention:1.切片文件和 INDEX.DAT 建立后，用 fast seek 的链接表确认各文件是一段连续的簇，
+               记下起始扇区；录像时数据和索引槽都用 disk_write 直接写到这些扇区，
+               不经过 f_write，FAT 表、目录项和 FSINFO 都不再改写。
+             2.每条记录前有 sd_rec_hdr_t，记录头中的切片序号与索引槽不一致的是覆盖剩下的旧数据，
+               读取时以索引槽的有效长度和记录头的序号双重判断，掉电后最多丢失最近 SD_REC_INDEX_FLUSH 块。
+             3.只支持一个送帧线程（sd_rec_put 不可并发调用）。
+             4.主机测试：在镜像文件上运行 FatFs，测试持续写入的吞吐、写卡/送帧的最长耗时、
+               查找/读取的正确性以及重新挂载后的恢复，并和每帧 f_write 的写法对比（test/test_sd_record.c）
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "typeport.h"
+#include "sd_record.h"
+#include "encoder.h"
+
+#define SDREC_SECTOR        512
+#define SDREC_SLOT_SECTORS  (SD_REC_SLOT_SIZE / SDREC_SECTOR)
+#define SDREC_INDEX_PATH    SD_REC_DIR "/INDEX.DAT"
+#define SDREC_MKFS_WORK     (32*1024)
+#define SDREC_FRAME_I       0xF8
+
+/*双缓存中的一块*/
+typedef struct _sdrec_buf_t
+{
+    HLE_U8 *data;
+    HLE_U32 len;            //写入长度：块大小，或 0（只写索引槽）
+    HLE_U32 seg;            //所属切片
+    HLE_U32 seq;            //切片序号
+    HLE_U32 off;            //在切片中的偏移
+    int slot_valid;         //写完数据后写索引槽
+    int ready;              //已提交，等待写线程写卡
+    sd_rec_slot_t *slot;    //索引槽快照
+}sdrec_buf_t;
+
+/*切片概要（和卡上索引槽的头部一致，查找和读取时不用读卡）*/
+typedef struct _sdrec_sum_t
+{
+    HLE_U32 seq;
+    HLE_U32 start;
+    HLE_U32 end;
+    HLE_U32 used;           //已经写到卡上的有效长度
+}sdrec_sum_t;
+
+typedef struct _sdrec_ctx_t
+{
+    FATFS fs;
+    int opened;
+    int own_disk;           //设备由 sd_rec_open 关联
+    HLE_U32 seg_num;
+    HLE_U32 seg_size;
+    HLE_U32 chunk;
+    DWORD *seg_lba;         //各切片的起始扇区
+    DWORD index_lba;        //INDEX.DAT 的起始扇区
+    sdrec_sum_t *sum;
+
+    /*送帧（mut 保护）*/
+    sdrec_buf_t buf[2];
+    int active;             //正在填充的缓存
+    HLE_U32 fill;
+    HLE_U32 buf_off;        //正在填充的缓存在切片中的偏移
+    HLE_U32 cur_seg;
+    HLE_U32 cur_seq;
+    int seg_open;           //当前切片已经开始写入
+    int need_key;
+    int flush_count;        //距上次写索引槽的块数
+    sd_rec_slot_t *slot;    //当前切片的索引槽
+
+    /*写线程*/
+    int wr;                 //下一个要写卡的缓存
+    int running;
+    int error;
+    pthread_t tid;
+    pthread_mutex_t mut;
+    pthread_cond_t cnd;
+
+    sd_rec_status_t stat;
+}sdrec_ctx_t;
+
+static sdrec_ctx_t sdrec_ctx;
+static int sdrec_put_wait_ms = SD_REC_PUT_WAIT_MS;
+
+
+static HLE_U32 sdrec_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (HLE_U32)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static DWORD sdrec_slot_lba(HLE_U32 seg)
+{
+    return sdrec_ctx.index_lba + seg * SDREC_SLOT_SECTORS;
+}
+
+/*
+ 功能：取文件的起始扇区
+ 参数：fp 已打开且分配了空间的文件
+ 返回：0 成功，<0 文件不是一段连续的簇
+*/
+static int sdrec_file_lba(FIL *fp, DWORD *lba)
+{
+    DWORD tbl[4];
+    FRESULT res;
+
+    if (0 == f_size(fp))
+        return HLE_RET_ERROR;
+
+    /*只有一段时链接表为 {4, 簇数, 起始簇, 0}，多段时返回 FR_NOT_ENOUGH_CORE*/
+    tbl[0] = sizeof (tbl) / sizeof (tbl[0]);
+    fp->cltbl = tbl;
+    res = f_lseek(fp, CREATE_LINKMAP);
+    fp->cltbl = NULL;
+    if (res != FR_OK || tbl[1] < (f_size(fp) + sdrec_ctx.fs.csize * SDREC_SECTOR - 1) / (sdrec_ctx.fs.csize * SDREC_SECTOR))
+        return HLE_RET_ERROR;
+
+    *lba = sdrec_ctx.fs.database + (tbl[2] - 2) * sdrec_ctx.fs.csize;
+    return HLE_RET_OK;
+}
+
+static void sdrec_seg_path(char *path, int size, HLE_U32 seg)
+{
+    snprintf(path, size, "%s/R%04u.DAT", SD_REC_DIR, seg);
+}
+
+/*建立（或检查已有的）切片文件，一次分配连续簇*/
+static int sdrec_seg_create(HLE_U32 seg, HLE_U32 seg_size)
+{
+    FIL fp;
+    FRESULT res;
+    char path[32];
+    int ret = HLE_RET_ERROR;
+
+    sdrec_seg_path(path, sizeof (path), seg);
+    res = f_open(&fp, path, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK)
+    {
+        ERROR_LOG("f_open %s fail: %d\n", path, res);
+        return HLE_RET_EIO;
+    }
+
+    if (0 == f_size(&fp))
+        res = f_expand(&fp, seg_size, 1);
+    if (FR_OK == res && f_size(&fp) == seg_size)
+        ret = sdrec_file_lba(&fp, &sdrec_ctx.seg_lba[seg]);
+    f_close(&fp);
+
+    if (ret < 0)
+    {
+        DEBUG_LOG("%s: no contiguous space (%d)\n", path, res);
+        f_unlink(path);
+    }
+    return ret;
+}
+
+static int sdrec_alloc_seg(HLE_U32 n)
+{
+    sdrec_ctx.seg_lba = (DWORD *)calloc(n, sizeof (DWORD));
+    sdrec_ctx.sum = (sdrec_sum_t *)calloc(n, sizeof (sdrec_sum_t));
+    if (NULL == sdrec_ctx.seg_lba || NULL == sdrec_ctx.sum)
+    {
+        ERROR_LOG("calloc fail!\n");
+        return HLE_RET_ENORESOURCE;
+    }
+    return HLE_RET_OK;
+}
+
+/*
+ 功能：确定切片布局：卡上已有 INDEX.DAT 时检查已有的切片，否则按剩余空间建立切片和索引文件
+ 参数：seg_size 新建切片的大小
+ 返回：0 成功，<0 失败
+ 注意：索引文件最后建立，它存在就表示切片已经全部建好
+*/
+static int sdrec_layout(HLE_U32 seg_size)
+{
+    FIL fp;
+    FRESULT res;
+    FATFS *fsp;
+    DWORD nclst;
+    HLE_U32 cluster = sdrec_ctx.fs.csize * SDREC_SECTOR;
+    HLE_U32 i, n, size;
+    HLE_U64 free_bytes;
+    char path[32];
+    int ret;
+
+    res = f_mkdir(SD_REC_DIR);
+    if (res != FR_OK && res != FR_EXIST)
+    {
+        ERROR_LOG("f_mkdir %s fail: %d\n", SD_REC_DIR, res);
+        return HLE_RET_EIO;
+    }
+
+    res = f_open(&fp, SDREC_INDEX_PATH, FA_READ);
+    if (FR_OK == res)
+    {
+        n = f_size(&fp) / SD_REC_SLOT_SIZE;
+        ret = sdrec_file_lba(&fp, &sdrec_ctx.index_lba);
+        f_close(&fp);
+        if (ret < 0 || n < 2 || n > SD_REC_SEG_MAX)
+        {
+            ERROR_LOG("%s broken, need format!\n", SDREC_INDEX_PATH);
+            return HLE_RET_ERROR;
+        }
+        if (sdrec_alloc_seg(n) < 0)
+            return HLE_RET_ENORESOURCE;
+
+        seg_size = 0;
+        for (i = 0; i < n; i++)
+        {
+            sdrec_seg_path(path, sizeof (path), i);
+            res = f_open(&fp, path, FA_READ);
+            if (res != FR_OK)
+            {
+                ERROR_LOG("f_open %s fail: %d\n", path, res);
+                return HLE_RET_ERROR;
+            }
+            size = f_size(&fp);
+            ret = sdrec_file_lba(&fp, &sdrec_ctx.seg_lba[i]);
+            f_close(&fp);
+            if (ret < 0 || (seg_size && size != seg_size) || size < 4 * sdrec_ctx.chunk)
+            {
+                ERROR_LOG("%s broken, need format!\n", path);
+                return HLE_RET_ERROR;
+            }
+            seg_size = size;
+        }
+
+        sdrec_ctx.seg_num = n;
+        sdrec_ctx.seg_size = seg_size / sdrec_ctx.chunk * sdrec_ctx.chunk;
+        return HLE_RET_OK;
+    }
+    if (res != FR_NO_FILE)
+    {
+        ERROR_LOG("f_open %s fail: %d\n", SDREC_INDEX_PATH, res);
+        return HLE_RET_EIO;
+    }
+
+    /*新卡：切片大小按块大小向下对齐，切片数由剩余空间决定*/
+    seg_size = seg_size / sdrec_ctx.chunk * sdrec_ctx.chunk;
+    if (seg_size < 4 * sdrec_ctx.chunk)
+    {
+        ERROR_LOG("segment size %u too small!\n", seg_size);
+        return HLE_RET_EINVAL;
+    }
+
+    res = f_getfree("", &nclst, &fsp);
+    if (res != FR_OK)
+    {
+        ERROR_LOG("f_getfree fail: %d\n", res);
+        return HLE_RET_EIO;
+    }
+    free_bytes = (HLE_U64)nclst * cluster;
+    n = 0;
+    if (free_bytes > SD_REC_RESERVE)
+        n = (free_bytes - SD_REC_RESERVE) / (seg_size + SD_REC_SLOT_SIZE);
+    if (n > SD_REC_SEG_MAX)
+        n = SD_REC_SEG_MAX;
+    if (n < 2)
+    {
+        ERROR_LOG("no space for segments, free %llu\n", free_bytes);
+        return HLE_RET_ENORESOURCE;
+    }
+    if (sdrec_alloc_seg(n) < 0)
+        return HLE_RET_ENORESOURCE;
+
+    DEBUG_LOG("create %u segments of %u bytes\n", n, seg_size);
+    for (i = 0; i < n; i++)
+    {
+        if (sdrec_seg_create(i, seg_size) < 0)
+            break;
+    }
+    if (i < 2)
+        return HLE_RET_ENORESOURCE;
+    n = i;
+
+    res = f_open(&fp, SDREC_INDEX_PATH, FA_CREATE_ALWAYS | FA_READ | FA_WRITE);
+    if (res != FR_OK)
+    {
+        ERROR_LOG("f_open %s fail: %d\n", SDREC_INDEX_PATH, res);
+        return HLE_RET_EIO;
+    }
+    res = f_expand(&fp, (FSIZE_t)n * SD_REC_SLOT_SIZE, 1);
+    ret = (FR_OK == res) ? sdrec_file_lba(&fp, &sdrec_ctx.index_lba) : HLE_RET_ERROR;
+    if (FR_OK == res)
+        res = f_close(&fp);
+    else
+        f_close(&fp);
+    if (ret < 0 || res != FR_OK)
+    {
+        ERROR_LOG("create %s fail: %d\n", SDREC_INDEX_PATH, res);
+        f_unlink(SDREC_INDEX_PATH);
+        return HLE_RET_EIO;
+    }
+
+    /*索引槽清零（缓存还没有使用，借用第一块）*/
+    memset(sdrec_ctx.buf[0].data, 0, sdrec_ctx.chunk);
+    for (i = 0; i < n * SDREC_SLOT_SECTORS; i += size)
+    {
+        size = sdrec_ctx.chunk / SDREC_SECTOR;
+        if (size > n * SDREC_SLOT_SECTORS - i)
+            size = n * SDREC_SLOT_SECTORS - i;
+        if (disk_write(0, sdrec_ctx.buf[0].data, sdrec_ctx.index_lba + i, size) != RES_OK)
+            return HLE_RET_EIO;
+    }
+
+    sdrec_ctx.seg_num = n;
+    sdrec_ctx.seg_size = seg_size;
+    return HLE_RET_OK;
+}
+
+/*读各索引槽的头部，恢复切片概要和当前切片*/
+static int sdrec_load(void)
+{
+    sd_rec_slot_t *slot = sdrec_ctx.slot;
+    HLE_U32 i, max = 0, cur = sdrec_ctx.seg_num - 1;
+
+    for (i = 0; i < sdrec_ctx.seg_num; i++)
+    {
+        if (disk_read(0, (BYTE *)slot, sdrec_slot_lba(i), 1) != RES_OK)
+            return HLE_RET_EIO;
+        if (slot->magic != SD_REC_SLOT_MAGIC || 0 == slot->seq)
+            continue;
+
+        sdrec_ctx.sum[i].seq = slot->seq;
+        sdrec_ctx.sum[i].start = slot->start;
+        sdrec_ctx.sum[i].end = slot->end;
+        sdrec_ctx.sum[i].used = slot->used < sdrec_ctx.seg_size ? slot->used : sdrec_ctx.seg_size;
+        if (slot->seq > max)
+        {
+            max = slot->seq;
+            cur = i;
+        }
+    }
+
+    sdrec_ctx.cur_seg = cur;
+    sdrec_ctx.cur_seq = max;
+    return HLE_RET_OK;
+}
+
+/*
+ 功能：等待缓存 idx 被写线程写完（mut 已加锁）
+ 参数：wait_ms 最长等待时间，<0 一直等待
+ 返回：0 缓存空闲，<0 超时或写卡出错
+*/
+static int sdrec_wait_buf(int idx, int wait_ms)
+{
+    struct timespec ts;
+    HLE_U32 t0, used;
+
+    if (!sdrec_ctx.buf[idx].ready)
+        return sdrec_ctx.error ? HLE_RET_EIO : HLE_RET_OK;
+
+    t0 = sdrec_now_ms();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += wait_ms / 1000;
+    ts.tv_nsec += (wait_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    while (sdrec_ctx.buf[idx].ready && !sdrec_ctx.error)
+    {
+        if (wait_ms < 0)
+            pthread_cond_wait(&sdrec_ctx.cnd, &sdrec_ctx.mut);
+        else if (pthread_cond_timedwait(&sdrec_ctx.cnd, &sdrec_ctx.mut, &ts) == ETIMEDOUT)
+            break;
+    }
+
+    used = sdrec_now_ms() - t0;
+    if (used > sdrec_ctx.stat.max_wait_ms)
+        sdrec_ctx.stat.max_wait_ms = used;
+
+    if (sdrec_ctx.error)
+        return HLE_RET_EIO;
+    return sdrec_ctx.buf[idx].ready ? HLE_RET_EBUSY : HLE_RET_OK;
+}
+
+/*
+ 功能：把正在填充的缓存交给写线程，切换到另一块（mut 已加锁，另一块必须已经空闲）
+ 参数：flush 1：同时写索引槽
+*/
+static void sdrec_submit(int flush)
+{
+    sdrec_buf_t *b = &sdrec_ctx.buf[sdrec_ctx.active];
+
+    if (sdrec_ctx.fill > 0 && sdrec_ctx.fill < sdrec_ctx.chunk)
+        memset(b->data + sdrec_ctx.fill, 0, sdrec_ctx.chunk - sdrec_ctx.fill);
+
+    b->len = sdrec_ctx.fill ? sdrec_ctx.chunk : 0;
+    b->seg = sdrec_ctx.cur_seg;
+    b->seq = sdrec_ctx.cur_seq;
+    b->off = sdrec_ctx.buf_off;
+
+    /*切片的第一块立即写索引槽，之后每 SD_REC_INDEX_FLUSH 块写一次*/
+    if (++sdrec_ctx.flush_count >= SD_REC_INDEX_FLUSH || 0 == b->off)
+        flush = 1;
+    b->slot_valid = flush;
+    if (flush)
+    {
+        memcpy(b->slot, sdrec_ctx.slot, sizeof (sd_rec_slot_t));
+        sdrec_ctx.flush_count = 0;
+    }
+
+    b->ready = 1;
+    pthread_cond_broadcast(&sdrec_ctx.cnd);
+
+    sdrec_ctx.buf_off += b->len;
+    sdrec_ctx.fill = 0;
+    sdrec_ctx.active ^= 1;
+}
+
+/*拷贝到缓存，缓存满时提交（跨越多块的记录等待写线程，不能中途放弃）*/
+static int sdrec_copy(const void *src, HLE_U32 len)
+{
+    const HLE_U8 *p = (const HLE_U8 *)src;
+    HLE_U32 n;
+
+    while (len > 0)
+    {
+        n = sdrec_ctx.chunk - sdrec_ctx.fill;
+        if (n > len)
+            n = len;
+        memcpy(sdrec_ctx.buf[sdrec_ctx.active].data + sdrec_ctx.fill, p, n);
+        sdrec_ctx.fill += n;
+        p += n;
+        len -= n;
+
+        if (sdrec_ctx.fill == sdrec_ctx.chunk)
+        {
+            if (sdrec_wait_buf(sdrec_ctx.active ^ 1, -1) < 0)
+                return HLE_RET_EIO;
+            sdrec_submit(0);
+        }
+    }
+
+    return HLE_RET_OK;
+}
+
+/*结束当前切片：剩余数据补齐成一块写卡，并写索引槽*/
+static int sdrec_finish_seg(int wait_ms)
+{
+    int ret;
+
+    if (!sdrec_ctx.seg_open)
+        return HLE_RET_OK;
+
+    ret = sdrec_wait_buf(sdrec_ctx.active ^ 1, wait_ms);
+    if (ret < 0)
+        return ret;
+
+    sdrec_submit(1);
+    sdrec_ctx.seg_open = 0;
+    return HLE_RET_OK;
+}
+
+/*覆盖最旧的切片（先更新概要，读取方不会再读到其中的旧数据）*/
+static void sdrec_new_seg(HLE_U32 sec)
+{
+    sd_rec_slot_t *slot = sdrec_ctx.slot;
+    sdrec_sum_t *sum;
+
+    sdrec_ctx.cur_seg = (sdrec_ctx.cur_seg + 1) % sdrec_ctx.seg_num;
+    sdrec_ctx.cur_seq++;
+    sdrec_ctx.buf_off = 0;
+    sdrec_ctx.fill = 0;
+    sdrec_ctx.flush_count = 0;
+    sdrec_ctx.seg_open = 1;
+
+    memset(slot, 0, sizeof (sd_rec_slot_t));
+    slot->magic = SD_REC_SLOT_MAGIC;
+    slot->seq = sdrec_ctx.cur_seq;
+    slot->start = sec;
+    slot->end = sec;
+    slot->interval = 1;
+
+    sum = &sdrec_ctx.sum[sdrec_ctx.cur_seg];
+    sum->seq = sdrec_ctx.cur_seq;
+    sum->start = sec;
+    sum->end = sec;
+    sum->used = 0;
+}
+
+/*关键帧时间索引，至多每 interval 秒一条；满了以后隔一条删一条，间隔加倍*/
+static void sdrec_add_entry(HLE_U32 sec, HLE_U32 offset)
+{
+    sd_rec_slot_t *slot = sdrec_ctx.slot;
+    int i;
+
+    if (slot->count > 0 && sec < slot->entry[slot->count - 1].time + slot->interval)
+        return;
+
+    if (slot->count >= SD_REC_INDEX_MAX)
+    {
+        for (i = 0; i < SD_REC_INDEX_MAX / 2; i++)
+            slot->entry[i] = slot->entry[i * 2];
+        slot->count = SD_REC_INDEX_MAX / 2;
+        slot->interval *= 2;
+        if (sec < slot->entry[slot->count - 1].time + slot->interval)
+            return;
+    }
+
+    slot->entry[slot->count].time = sec;
+    slot->entry[slot->count].offset = offset;
+    slot->count++;
+}
+
+/*写一块数据（以及索引槽），返回写索引槽的次数，<0 失败*/
+static int sdrec_write_buf(sdrec_buf_t *b)
+{
+    sd_rec_slot_t *slot = b->slot;
+
+    if (b->len > 0 && disk_write(0, b->data, sdrec_ctx.seg_lba[b->seg] + b->off / SDREC_SECTOR,
+                                 b->len / SDREC_SECTOR) != RES_OK)
+        return HLE_RET_EIO;
+
+    if (!b->slot_valid)
+        return 0;
+
+    /*快照中可能有还在下一块中的记录的索引，去掉*/
+    slot->used = b->off + b->len;
+    while (slot->count > 0 && slot->entry[slot->count - 1].offset + sizeof (sd_rec_hdr_t) > slot->used)
+        slot->count--;
+
+    if (disk_write(0, (const BYTE *)slot, sdrec_slot_lba(b->seg), SDREC_SLOT_SECTORS) != RES_OK)
+        return HLE_RET_EIO;
+    return 1;
+}
+
+/*写线程：按提交顺序交替写两块缓存*/
+static void *sdrec_write_thread(void *args)
+{
+    sdrec_buf_t *b;
+    HLE_U32 t0, used;
+    int err, ret = 0;
+
+    DEBUG_LOG("sd record write thread start\n");
+    while (1)
+    {
+        pthread_mutex_lock(&sdrec_ctx.mut);
+        b = &sdrec_ctx.buf[sdrec_ctx.wr];
+        while (!b->ready && sdrec_ctx.running)
+            pthread_cond_wait(&sdrec_ctx.cnd, &sdrec_ctx.mut);
+        if (!b->ready)
+        {
+            pthread_mutex_unlock(&sdrec_ctx.mut);
+            break;
+        }
+        err = sdrec_ctx.error;
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+
+        t0 = sdrec_now_ms();
+        if (!err)
+            ret = sdrec_write_buf(b);
+        used = sdrec_now_ms() - t0;
+
+        pthread_mutex_lock(&sdrec_ctx.mut);
+        if (!err && ret < 0)
+        {
+            ERROR_LOG("write segment %u offset %u fail, stop recording!\n", b->seg, b->off);
+            sdrec_ctx.error = 1;
+            sdrec_ctx.stat.state = -1;
+        }
+        else if (!err)
+        {
+            if (b->len > 0)
+            {
+                sdrec_ctx.stat.chunks++;
+                sdrec_ctx.stat.bytes += b->len;
+            }
+            sdrec_ctx.stat.index_writes += ret;
+            if (used > sdrec_ctx.stat.max_write_ms)
+                sdrec_ctx.stat.max_write_ms = used;
+            if (sdrec_ctx.sum[b->seg].seq == b->seq)
+                sdrec_ctx.sum[b->seg].used = b->off + b->len;
+        }
+        b->ready = 0;
+        pthread_cond_broadcast(&sdrec_ctx.cnd);
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+
+        sdrec_ctx.wr ^= 1;
+    }
+
+    DEBUG_LOG("sd record write thread exit\n");
+    return NULL;
+}
+
+static void sdrec_free(void)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        free(sdrec_ctx.buf[i].data);
+        free(sdrec_ctx.buf[i].slot);
+        sdrec_ctx.buf[i].data = NULL;
+        sdrec_ctx.buf[i].slot = NULL;
+    }
+    free(sdrec_ctx.slot);
+    free(sdrec_ctx.seg_lba);
+    free(sdrec_ctx.sum);
+    sdrec_ctx.slot = NULL;
+    sdrec_ctx.seg_lba = NULL;
+    sdrec_ctx.sum = NULL;
+}
+
+/*在已关联的设备上建立 FAT 文件系统（卷未挂载）*/
+static FRESULT sdrec_mkfs(void)
+{
+    FRESULT res;
+    void *work = malloc(SDREC_MKFS_WORK);
+
+    if (NULL == work)
+        return FR_NOT_ENOUGH_CORE;
+    res = f_mkfs("", FM_ANY | FM_SFD, 0, work, SDREC_MKFS_WORK);
+    free(work);
+    return res;
+}
+
+int sd_rec_format(const char *dev)
+{
+    FRESULT res;
+
+    if (sdrec_ctx.opened)
+    {
+        ERROR_LOG("sd record opened, close first!\n");
+        return HLE_RET_EBUSY;
+    }
+
+    if (dev != NULL && sd_disk_attach(dev, 0) < 0)
+        return HLE_RET_ENOTINIT;
+
+    DEBUG_LOG("format sd card...\n");
+    res = sdrec_mkfs();
+    if (dev != NULL)
+        sd_disk_detach();
+    if (res != FR_OK)
+    {
+        ERROR_LOG("format sd card fail: %d\n", res);
+        return (FR_NOT_ENOUGH_CORE == res) ? HLE_RET_ENORESOURCE : HLE_RET_EIO;
+    }
+    return HLE_RET_OK;
+}
+
+int sd_rec_open(const char *dev, HLE_U32 seg_size, int format)
+{
+    FRESULT res;
+    HLE_U32 cluster;
+    int i, ret = HLE_RET_ERROR;
+
+    if (sdrec_ctx.opened)
+    {
+        ERROR_LOG("sd record already opened!\n");
+        return HLE_RET_EBUSY;
+    }
+
+    memset(&sdrec_ctx, 0, sizeof (sdrec_ctx));
+    pthread_mutex_init(&sdrec_ctx.mut, NULL);
+    pthread_cond_init(&sdrec_ctx.cnd, NULL);
+
+    /*dev 为 NULL 时使用已经 sd_disk_attach 的设备*/
+    if (dev != NULL)
+    {
+        if (sd_disk_attach(dev, 0) < 0)
+            return HLE_RET_ENOTINIT;
+        sdrec_ctx.own_disk = 1;
+    }
+
+    res = f_mount(&sdrec_ctx.fs, "", 1);
+    if (FR_NO_FILESYSTEM == res && format)
+    {
+        DEBUG_LOG("no FAT volume, format...\n");
+        res = sdrec_mkfs();
+        if (FR_OK == res)
+            res = f_mount(&sdrec_ctx.fs, "", 1);
+    }
+    if (FR_NO_FILESYSTEM == res)
+    {
+        /*exFAT（64GB 以上 SDXC 卡的出厂格式）或未格式化的卡，不自动格式化，等用户命令*/
+        ERROR_LOG("no FAT volume on sd card, need format!\n");
+        ret = HLE_RET_ENOTSUPPORTED;
+        goto ERR;
+    }
+    if (res != FR_OK)
+    {
+        ERROR_LOG("mount sd card fail: %d\n", res);
+        ret = HLE_RET_ENOTINIT;
+        goto ERR;
+    }
+
+    /*一次写入的块为簇大小的整数倍，保证每次写都从簇边界开始*/
+    cluster = sdrec_ctx.fs.csize * SDREC_SECTOR;
+    sdrec_ctx.chunk = (SD_REC_CHUNK_SIZE + cluster - 1) / cluster * cluster;
+    for (i = 0; i < 2; i++)
+    {
+        sdrec_ctx.buf[i].data = (HLE_U8 *)malloc(sdrec_ctx.chunk);
+        sdrec_ctx.buf[i].slot = (sd_rec_slot_t *)malloc(sizeof (sd_rec_slot_t));
+        if (NULL == sdrec_ctx.buf[i].data || NULL == sdrec_ctx.buf[i].slot)
+            break;
+    }
+    sdrec_ctx.slot = (sd_rec_slot_t *)malloc(sizeof (sd_rec_slot_t));
+    if (i < 2 || NULL == sdrec_ctx.slot)
+    {
+        ERROR_LOG("malloc fail!\n");
+        ret = HLE_RET_ENORESOURCE;
+        goto ERR;
+    }
+
+    ret = sdrec_layout(seg_size);
+    if (ret < 0)
+        goto ERR;
+    ret = sdrec_load();
+    if (ret < 0)
+        goto ERR;
+
+    sdrec_ctx.need_key = 1;
+    sdrec_ctx.stat.state = 1;
+    sdrec_ctx.stat.seg_num = sdrec_ctx.seg_num;
+    sdrec_ctx.stat.seg_size = sdrec_ctx.seg_size;
+    sdrec_ctx.stat.chunk_size = sdrec_ctx.chunk;
+    sdrec_ctx.running = 1;
+    if (pthread_create(&sdrec_ctx.tid, NULL, sdrec_write_thread, NULL) != 0)
+    {
+        ERROR_LOG("create sdrec_write_thread failed!\n");
+        sdrec_ctx.running = 0;
+        ret = HLE_RET_ENORESOURCE;
+        goto ERR;
+    }
+
+    sdrec_ctx.opened = 1;
+    DEBUG_LOG("sd record: %u segments x %u bytes, chunk %u, cluster %u, last seq %u\n",
+              sdrec_ctx.seg_num, sdrec_ctx.seg_size, sdrec_ctx.chunk, cluster, sdrec_ctx.cur_seq);
+    return HLE_RET_OK;
+
+ERR:
+    f_mount(NULL, "", 0);
+    sdrec_free();
+    if (sdrec_ctx.own_disk)
+        sd_disk_detach();
+    pthread_mutex_destroy(&sdrec_ctx.mut);
+    pthread_cond_destroy(&sdrec_ctx.cnd);
+    return ret;
+}
+
+void sd_rec_close(void)
+{
+    if (!sdrec_ctx.opened)
+        return;
+
+    pthread_mutex_lock(&sdrec_ctx.mut);
+    if (!sdrec_ctx.error)
+        sdrec_finish_seg(-1);
+    sdrec_ctx.running = 0;
+    pthread_cond_broadcast(&sdrec_ctx.cnd);
+    pthread_mutex_unlock(&sdrec_ctx.mut);
+    pthread_join(sdrec_ctx.tid, NULL);
+
+    disk_ioctl(0, CTRL_SYNC, NULL);
+    f_mount(NULL, "", 0);
+    sdrec_free();
+    if (sdrec_ctx.own_disk)
+        sd_disk_detach();
+
+    pthread_mutex_destroy(&sdrec_ctx.mut);
+    pthread_cond_destroy(&sdrec_ctx.cnd);
+    sdrec_ctx.opened = 0;
+    sdrec_ctx.stat.state = 0;
+}
+
+int sd_rec_put(const void *data, int len, int key, HLE_U64 time_ms)
+{
+    sd_rec_hdr_t hdr;
+    HLE_U32 rec, pos, sec = (HLE_U32)(time_ms / 1000);
+    int ret;
+
+    if (NULL == data || len <= 0)
+        return HLE_RET_EINVAL;
+
+    rec = sizeof (hdr) + len;
+    pthread_mutex_lock(&sdrec_ctx.mut);
+    if (!sdrec_ctx.running || sdrec_ctx.error)
+    {
+        ret = sdrec_ctx.error ? HLE_RET_EIO : HLE_RET_ENOTINIT;
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+        return ret;
+    }
+    if (rec > sdrec_ctx.seg_size / 4)
+    {
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+        ERROR_LOG("frame too large: %d\n", len);
+        return HLE_RET_EINVAL;
+    }
+    if (sdrec_ctx.need_key && !key)
+        goto DROP;
+
+    /*关键帧处切换切片：切片快满或时间倒退；放不下时任何帧都要切换*/
+    if (sdrec_ctx.seg_open)
+    {
+        pos = sdrec_ctx.buf_off + sdrec_ctx.fill;
+        if ((key && (pos >= sdrec_ctx.seg_size - sdrec_ctx.seg_size / 16 || sec < sdrec_ctx.slot->end))
+            || pos + rec > sdrec_ctx.seg_size)
+        {
+            if (sdrec_finish_seg(sdrec_put_wait_ms) < 0)
+                goto DROP;
+        }
+    }
+    if (!sdrec_ctx.seg_open)
+        sdrec_new_seg(sec);
+
+    /*本条记录要用到另一块缓存时，先确认它已经写完；卡忙时丢帧，不阻塞取帧线程*/
+    if (sdrec_ctx.fill + rec >= sdrec_ctx.chunk
+        && sdrec_wait_buf(sdrec_ctx.active ^ 1, sdrec_put_wait_ms) < 0)
+        goto DROP;
+
+    if (key)
+    {
+        sdrec_add_entry(sec, sdrec_ctx.buf_off + sdrec_ctx.fill);
+        sdrec_ctx.need_key = 0;
+    }
+    sdrec_ctx.slot->end = sec;
+    sdrec_ctx.sum[sdrec_ctx.cur_seg].end = sec;
+
+    hdr.seq = sdrec_ctx.cur_seq;
+    hdr.len = (HLE_U32)len | (key ? SD_REC_KEY_FLAG : 0);
+    hdr.time_ms = time_ms;
+    ret = sdrec_copy(&hdr, sizeof (hdr));
+    if (HLE_RET_OK == ret)
+        ret = sdrec_copy(data, len);
+    pthread_mutex_unlock(&sdrec_ctx.mut);
+    return ret;
+
+DROP:
+    sdrec_ctx.stat.dropped++;
+    sdrec_ctx.need_key = 1;
+    ret = sdrec_ctx.error ? HLE_RET_EIO : HLE_RET_EBUSY;
+    pthread_mutex_unlock(&sdrec_ctx.mut);
+    return ret;
+}
+
+/*从切片中读任意偏移和长度（首尾不足一个扇区的部分经过扇区缓存）*/
+static int sdrec_read_bytes(HLE_U32 seg, HLE_U32 off, void *buf, HLE_U32 len)
+{
+    BYTE sector[SDREC_SECTOR];
+    HLE_U8 *p = (HLE_U8 *)buf;
+    DWORD lba = sdrec_ctx.seg_lba[seg] + off / SDREC_SECTOR;
+    HLE_U32 skip = off % SDREC_SECTOR, n;
+
+    if (skip)
+    {
+        if (disk_read(0, sector, lba++, 1) != RES_OK)
+            return HLE_RET_EIO;
+        n = SDREC_SECTOR - skip;
+        if (n > len)
+            n = len;
+        memcpy(p, sector + skip, n);
+        p += n;
+        len -= n;
+    }
+    if (len >= SDREC_SECTOR)
+    {
+        n = len / SDREC_SECTOR;
+        if (disk_read(0, p, lba, n) != RES_OK)
+            return HLE_RET_EIO;
+        lba += n;
+        p += n * SDREC_SECTOR;
+        len -= n * SDREC_SECTOR;
+    }
+    if (len)
+    {
+        if (disk_read(0, sector, lba, 1) != RES_OK)
+            return HLE_RET_EIO;
+        memcpy(p, sector, len);
+    }
+
+    return HLE_RET_OK;
+}
+
+int sd_rec_find(HLE_U32 time, sd_rec_pos_t *pos)
+{
+    sd_rec_slot_t *slot;
+    sdrec_sum_t *s;
+    HLE_U32 i, seq, used;
+    int best = -1, oldest = -1, newest = -1, lo, hi, mid;
+
+    if (NULL == pos)
+        return HLE_RET_EINVAL;
+
+    pthread_mutex_lock(&sdrec_ctx.mut);
+    if (!sdrec_ctx.opened)
+    {
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+        return HLE_RET_ENOTINIT;
+    }
+
+    /*起始时间不晚于 time 的切片中序号最大的（时钟被往回调过时取最近录的）*/
+    for (i = 0; i < sdrec_ctx.seg_num; i++)
+    {
+        s = &sdrec_ctx.sum[i];
+        if (0 == s->seq || 0 == s->used)
+            continue;
+        if (oldest < 0 || s->seq < sdrec_ctx.sum[oldest].seq)
+            oldest = i;
+        if (newest < 0 || s->seq > sdrec_ctx.sum[newest].seq)
+            newest = i;
+        if (s->start <= time && (best < 0 || s->seq > sdrec_ctx.sum[best].seq))
+            best = i;
+    }
+    if (oldest < 0 || time > sdrec_ctx.sum[newest].end)
+    {
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+        return HLE_RET_ERROR;
+    }
+    if (best < 0)
+        best = oldest;
+    seq = sdrec_ctx.sum[best].seq;
+    used = sdrec_ctx.sum[best].used;
+    pthread_mutex_unlock(&sdrec_ctx.mut);
+
+    pos->seg = best;
+    pos->seq = seq;
+    pos->offset = 0;
+
+    slot = (sd_rec_slot_t *)malloc(sizeof (sd_rec_slot_t));
+    if (NULL == slot)
+        return HLE_RET_ENORESOURCE;
+    if (disk_read(0, (BYTE *)slot, sdrec_slot_lba(best), SDREC_SLOT_SECTORS) != RES_OK)
+    {
+        free(slot);
+        return HLE_RET_EIO;
+    }
+
+    /*最后一个时间不晚于 time 的索引（索引槽还没有写到卡上时从切片开头读）*/
+    if (SD_REC_SLOT_MAGIC == slot->magic && seq == slot->seq && slot->count <= SD_REC_INDEX_MAX)
+    {
+        lo = 0;
+        hi = slot->count - 1;
+        while (lo <= hi)
+        {
+            mid = (lo + hi) / 2;
+            if (slot->entry[mid].time <= time)
+                lo = mid + 1;
+            else
+                hi = mid - 1;
+        }
+        if (hi >= 0 && slot->entry[hi].offset < used)
+            pos->offset = slot->entry[hi].offset;
+    }
+
+    free(slot);
+    return HLE_RET_OK;
+}
+
+int sd_rec_read(sd_rec_pos_t *pos, void *buf, int size, HLE_U64 *time_ms, int *key)
+{
+    sd_rec_hdr_t hdr;
+    HLE_U32 i, used, len;
+    int cur, next, valid;
+
+    if (NULL == pos || NULL == buf || size <= 0)
+        return HLE_RET_EINVAL;
+
+    while (1)
+    {
+        pthread_mutex_lock(&sdrec_ctx.mut);
+        if (!sdrec_ctx.opened || pos->seg >= sdrec_ctx.seg_num)
+        {
+            pthread_mutex_unlock(&sdrec_ctx.mut);
+            return HLE_RET_EINVAL;
+        }
+        if (sdrec_ctx.sum[pos->seg].seq != pos->seq)
+        {
+            pthread_mutex_unlock(&sdrec_ctx.mut);
+            return HLE_RET_ERROR;
+        }
+        used = sdrec_ctx.sum[pos->seg].used;
+        cur = (pos->seq == sdrec_ctx.cur_seq);
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+
+        if (pos->offset + sizeof (hdr) <= used)
+        {
+            if (sdrec_read_bytes(pos->seg, pos->offset, &hdr, sizeof (hdr)) < 0)
+                return HLE_RET_EIO;
+
+            len = hdr.len & SD_REC_LEN_MASK;
+            if (hdr.seq == pos->seq && pos->offset + sizeof (hdr) + len <= used)
+            {
+                if (len > (HLE_U32)size)
+                    return HLE_RET_EINVAL;
+                if (sdrec_read_bytes(pos->seg, pos->offset + sizeof (hdr), buf, len) < 0)
+                    return HLE_RET_EIO;
+
+                /*读的过程中切片被覆盖*/
+                pthread_mutex_lock(&sdrec_ctx.mut);
+                valid = (sdrec_ctx.sum[pos->seg].seq == pos->seq);
+                pthread_mutex_unlock(&sdrec_ctx.mut);
+                if (!valid)
+                    return HLE_RET_ERROR;
+
+                pos->offset += sizeof (hdr) + len;
+                if (time_ms)
+                    *time_ms = hdr.time_ms;
+                if (key)
+                    *key = (hdr.len & SD_REC_KEY_FLAG) ? 1 : 0;
+                return len;
+            }
+        }
+
+        /*正在写的切片：后面的数据还没有写到卡上*/
+        if (cur)
+            return 0;
+
+        /*本切片读完，转到下一个序号的切片*/
+        pthread_mutex_lock(&sdrec_ctx.mut);
+        next = -1;
+        for (i = 0; i < sdrec_ctx.seg_num; i++)
+        {
+            if (sdrec_ctx.sum[i].seq > pos->seq && sdrec_ctx.sum[i].used > 0
+                && (next < 0 || sdrec_ctx.sum[i].seq < sdrec_ctx.sum[next].seq))
+                next = i;
+        }
+        if (next >= 0)
+        {
+            pos->seg = next;
+            pos->seq = sdrec_ctx.sum[next].seq;
+            pos->offset = 0;
+        }
+        pthread_mutex_unlock(&sdrec_ctx.mut);
+        if (next < 0)
+            return 0;
+    }
+}
+
+void sd_rec_get_status(sd_rec_status_t *status)
+{
+    HLE_U32 i, oldest = 0, newest = 0;
+
+    if (NULL == status)
+        return;
+
+    pthread_mutex_lock(&sdrec_ctx.mut);
+    *status = sdrec_ctx.stat;
+    status->cur_seg = sdrec_ctx.cur_seg;
+    status->cur_seq = sdrec_ctx.cur_seq;
+    status->oldest = 0;
+    status->newest = 0;
+    for (i = 0; sdrec_ctx.opened && i < sdrec_ctx.seg_num; i++)
+    {
+        if (0 == sdrec_ctx.sum[i].seq || 0 == sdrec_ctx.sum[i].used)
+            continue;
+        if (0 == oldest || sdrec_ctx.sum[i].seq < oldest)
+        {
+            oldest = sdrec_ctx.sum[i].seq;
+            status->oldest = sdrec_ctx.sum[i].start;
+        }
+        if (sdrec_ctx.sum[i].seq > newest)
+        {
+            newest = sdrec_ctx.sum[i].seq;
+            status->newest = sdrec_ctx.sum[i].end;
+        }
+    }
+    pthread_mutex_unlock(&sdrec_ctx.mut);
+}
+
+
+static int sdrec_stream_id = -1;
+static int sdrec_input_running;
+static pthread_t sdrec_input_tid;
+
+/*取帧线程：整包（含帧头）写入，时间使用系统 UTC 时间*/
+static void* sd_record_input_thread(void *args)
+{
+    ENC_STREAM_PACK *pack = NULL;
+    FRAME_HDR *header = NULL;
+    struct timeval tv;
+    int ret;
+
+    DEBUG_LOG("sd record input thread start, stream_id(%#x)\n", sdrec_stream_id);
+    while (sdrec_input_running)
+    {
+        pack = encoder_get_packet(sdrec_stream_id);
+        if (NULL == pack)
+        {
+            usleep(10*1000);
+            continue;
+        }
+
+        header = (FRAME_HDR *) pack->data;
+        gettimeofday(&tv, NULL);
+        ret = sd_rec_put(pack->data, pack->length, header->type == SDREC_FRAME_I,
+                         (HLE_U64)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+        encoder_release_packet(pack);
+        if (HLE_RET_EIO == ret)
+        {
+            ERROR_LOG("sd card write error, stop recording!\n");
+            break;
+        }
+    }
+
+    DEBUG_LOG("sd record input thread exit\n");
+    return NULL;
+}
+
+int sd_record_start(int stream_index)
+{
+    int ret;
+
+    if (sdrec_input_running)
+    {
+        ERROR_LOG("sd record already running!\n");
+        return HLE_RET_EBUSY;
+    }
+
+    /*开机时不格式化：卡上的数据（包括 exFAT 的卡）只在用户命令 sd_record_format 时清除*/
+    ret = sd_rec_open(SD_REC_DEV_PATH, SD_REC_SEG_SIZE, 0);
+    if (ret < 0)
+        return ret;
+
+    sdrec_stream_id = encoder_request_stream(0, stream_index, 1);
+    if (sdrec_stream_id < 0)
+    {
+        ERROR_LOG("encoder_request_stream failed!\n");
+        sd_rec_close();
+        return HLE_RET_ENORESOURCE;
+    }
+
+    sdrec_input_running = 1;
+    if (pthread_create(&sdrec_input_tid, NULL, sd_record_input_thread, NULL) != 0)
+    {
+        ERROR_LOG("create sd_record_input_thread failed!\n");
+        sdrec_input_running = 0;
+        encoder_free_stream(sdrec_stream_id);
+        sd_rec_close();
+        return HLE_RET_ENORESOURCE;
+    }
+
+    return HLE_RET_OK;
+}
+
+void sd_record_stop(void)
+{
+    if (!sdrec_input_running)
+        return;
+
+    sdrec_input_running = 0;
+    pthread_join(sdrec_input_tid, NULL);
+    encoder_free_stream(sdrec_stream_id);
+    sd_rec_close();
+}
+
+int sd_record_format(int stream_index)
+{
+    int ret;
+
+    sd_record_stop();
+    ret = sd_rec_format(SD_REC_DEV_PATH);
+    if (ret < 0)
+        return ret;
+
+    return sd_record_start(stream_index);
+}
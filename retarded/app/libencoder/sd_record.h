@@ -0,0 +1,233 @@
+/***************************************************************************
+* @file:sd_record.h
+* @author:
+* @date:  10,19,2026
+* @brief:  SD 卡连续录像：FatFs 上预分配的定长切片文件组成环形缓冲，带时间索引
+* @attention:1.卡上建立 REC 目录，SD_REC_SEG_MAX 个以内的切片文件 R0000.DAT... 在建立时用 f_expand
+               一次分配成连续簇，之后循环覆盖最旧的切片，录像过程中不再修改 FAT 和目录项。
+             2.帧数据先拷贝到双缓存，写线程每次把一整块（簇大小的整数倍）直接写到切片所在的扇区，
+               取帧线程不等待 SD 卡（卡忙时最多等 SD_REC_PUT_WAIT_MS，之后丢帧直到下一个关键帧）。
+             3.INDEX.DAT 为每个切片保存一个 SD_REC_SLOT_SIZE 的索引槽：切片序号、起止时间、有效长度和
+               关键帧的时间索引（至多每秒一条，满了以后间隔加倍），按时间查找时只需要读一个索引槽。
+             4.只支持 FAT12/16/32（FF_FS_EXFAT 为 0），64GB 以上的 SDXC 卡出厂为 exFAT，开机时不录像，
+               由用户命令（CMD_SET_SD_FORMAT）调用 sd_record_format 格式化成 FAT32 后开始录像；
+               任何情况下都不会自动格式化。
+***************************************************************************/
+#ifndef _SD_RECORD_H
+#define _SD_RECORD_H
+
+#include "typeport.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SD_REC_DEV_PATH         "/dev/mmcblk0p0"    //SD 卡块设备
+#define SD_REC_DIR              "/REC"
+#define SD_REC_STREAM_INDEX     0                   //录像使用的码流（主码流）
+#define SD_REC_SEG_SIZE         (64*1024*1024)      //切片文件大小（按块大小向下对齐）
+#define SD_REC_SEG_MAX          4096                //最多切片数
+#define SD_REC_CHUNK_SIZE       (256*1024)          //一次写入的块大小（按簇大小向上对齐），双缓存共 2 块
+#define SD_REC_RESERVE          (16*1024*1024)      //建立切片时卡上保留的空闲空间
+#define SD_REC_INDEX_FLUSH      8                   //每写 N 块更新一次索引槽（掉电时最多丢失 N 块）
+#define SD_REC_PUT_WAIT_MS      20                  //双缓存都在写卡时，送帧最多等待的时间
+#define SD_REC_SLOT_SIZE        4096                //每个切片的索引槽大小（扇区对齐）
+#define SD_REC_INDEX_MAX        ((SD_REC_SLOT_SIZE - 32) / 8)   //每个切片最多的时间索引条数
+
+/*切片中每帧前面的记录头*/
+typedef struct _sd_rec_hdr_t
+{
+    HLE_U32 seq;            //切片序号，与索引槽不一致的是以前覆盖剩下的旧数据
+    HLE_U32 len;            //帧长度，bit31 为关键帧标志
+    HLE_U64 time_ms;        //帧时间（UTC 毫秒）
+}sd_rec_hdr_t;
+
+#define SD_REC_KEY_FLAG         0x80000000
+#define SD_REC_LEN_MASK         0x7FFFFFFF
+
+/*时间索引：关键帧时间和它在切片中的偏移*/
+typedef struct _sd_rec_entry_t
+{
+    HLE_U32 time;           //UTC 秒
+    HLE_U32 offset;         //记录头在切片中的偏移
+}sd_rec_entry_t;
+
+/*索引槽（INDEX.DAT 中第 i 个对应切片 i）*/
+typedef struct _sd_rec_slot_t
+{
+    HLE_U32 magic;          //SD_REC_SLOT_MAGIC
+    HLE_U32 seq;            //切片序号（从 1 开始递增），0 为未使用
+    HLE_U32 start;          //第一帧时间（UTC 秒）
+    HLE_U32 end;            //最后一帧时间（UTC 秒）
+    HLE_U32 used;           //已写入卡的有效长度
+    HLE_U16 count;          //时间索引条数
+    HLE_U16 interval;       //时间索引的最小间隔（秒）
+    HLE_U32 reserved[2];
+    sd_rec_entry_t entry[SD_REC_INDEX_MAX];
+}sd_rec_slot_t;
+
+#define SD_REC_SLOT_MAGIC       0x58444E49  //"INDX"
+
+/*读取位置*/
+typedef struct _sd_rec_pos_t
+{
+    HLE_U32 seg;            //切片编号
+    HLE_U32 seq;            //切片序号（切片被覆盖后读取失败）
+    HLE_U32 offset;         //下一条记录头在切片中的偏移
+}sd_rec_pos_t;
+
+/*录像状态*/
+typedef struct _sd_rec_status_t
+{
+    HLE_S32 state;          //0：未启动，1：录像中，-1：写卡出错（已停止写入）
+    HLE_U32 seg_num;        //切片数
+    HLE_U32 seg_size;       //切片大小
+    HLE_U32 chunk_size;     //块大小
+    HLE_U32 cur_seg;        //当前切片编号
+    HLE_U32 cur_seq;        //当前切片序号
+    HLE_U32 oldest;         //卡上最早的录像时间（UTC 秒）
+    HLE_U32 newest;         //卡上最新的录像时间（UTC 秒）
+    HLE_U64 bytes;          //写入卡的数据量
+    HLE_U32 chunks;         //写入的块数
+    HLE_U32 index_writes;   //写索引槽的次数
+    HLE_U32 dropped;        //丢弃的帧数
+    HLE_U32 max_write_ms;   //写一块的最长耗时
+    HLE_U32 max_wait_ms;    //送帧等待缓存的最长时间
+}sd_rec_status_t;
+
+/*块设备统计（FatFs diskio 的实现，sd_diskio.c）*/
+typedef struct _sd_disk_stat_t
+{
+    HLE_U32 reads;          //读操作次数
+    HLE_U32 writes;         //写操作次数
+    HLE_U64 read_sectors;
+    HLE_U64 write_sectors;
+    HLE_U32 max_write_us;   //单次写操作的最长耗时
+}sd_disk_stat_t;
+
+
+/*
+    function:  sd_disk_attach
+    description:  把块设备（或主机上的镜像文件）关联到 FatFs 的 0 号物理驱动器
+    args:
+        const char *path[in]，设备路径
+        int sync[in]，1：每次写都同步到设备（O_DSYNC，主机测试时模拟真实写卡耗时）
+    return:
+        0, 成功
+        <0, 失败
+ */
+int sd_disk_attach(const char *path, int sync);
+void sd_disk_detach(void);
+void sd_disk_get_stat(sd_disk_stat_t *stat, int clear);
+
+/*
+    function:  sd_rec_open
+    description:  挂载 SD 卡，建立（或检查）切片文件和索引，启动写线程
+    args:
+        const char *dev[in]，块设备路径
+        HLE_U32 seg_size[in]，新建切片时的切片大小；已有切片时使用已有的大小
+        int format[in]，1：卡上没有 FAT 文件系统时格式化（只用于主机测试的空白镜像）
+    return:
+        0, 成功
+        HLE_RET_ENOTSUPPORTED, 卡上没有 FAT 文件系统（format 为 0 时）
+        <0, 失败
+    attention:
+        新卡第一次建立切片需要扫描 FAT，切片数多时耗时较长（秒级）
+ */
+int sd_rec_open(const char *dev, HLE_U32 seg_size, int format);
+
+/*
+    function:  sd_rec_format
+    description:  在 SD 卡上建立 FAT 文件系统（卡上原有的数据全部丢失）
+    args:
+        const char *dev[in]，块设备路径；NULL 时使用已经 sd_disk_attach 的设备
+    return:
+        0, 成功
+        HLE_RET_EBUSY, 录像已打开（先 sd_rec_close）
+        <0, 失败
+ */
+int sd_rec_format(const char *dev);
+
+/*
+    function:  sd_rec_close
+    description:  写出缓存中剩余的数据和索引，停止写线程并卸载 SD 卡
+ */
+void sd_rec_close(void);
+
+/*
+    function:  sd_rec_put
+    description:  写入一帧（拷贝到双缓存后返回）
+    args:
+        const void *data[in]，帧数据
+        int len[in]，帧长度
+        int key[in]，是否关键帧（时间索引只指向关键帧，切片在关键帧处切换）
+        HLE_U64 time_ms[in]，帧时间（UTC 毫秒）
+    return:
+        0, 成功
+        HLE_RET_EBUSY, 缓存满被丢弃（之后的非关键帧都会丢弃，直到下一个关键帧）
+        <0, 其他错误
+ */
+int sd_rec_put(const void *data, int len, int key, HLE_U64 time_ms);
+
+/*
+    function:  sd_rec_find
+    description:  按时间查找：返回不晚于该时间的最近一个关键帧的位置
+    args:
+        HLE_U32 time[in]，UTC 秒；早于最早的录像时返回最早的位置
+        sd_rec_pos_t *pos[out]，读取位置
+    return:
+        0, 成功
+        <0, 没有该时间的录像
+ */
+int sd_rec_find(HLE_U32 time, sd_rec_pos_t *pos);
+
+/*
+    function:  sd_rec_read
+    description:  从读取位置读一帧，并把位置移到下一帧（切片读完时自动转到下一个序号的切片）
+    args:
+        sd_rec_pos_t *pos[in/out]，读取位置
+        void *buf[out] int size[in]，帧数据缓存
+        HLE_U64 *time_ms[out]，帧时间，可以为 NULL
+        int *key[out]，是否关键帧，可以为 NULL
+    return:
+        >0, 帧长度
+        0, 已经读到最新写入卡的数据
+        <0, 失败（切片已被覆盖、缓存太小等）
+ */
+int sd_rec_read(sd_rec_pos_t *pos, void *buf, int size, HLE_U64 *time_ms, int *key);
+
+void sd_rec_get_status(sd_rec_status_t *status);
+
+/*
+    function:  sd_record_start
+    description:  启动 SD 卡连续录像（挂载 SD 卡 + 取帧线程），开机时调用
+    args:
+        int stream_index[in]，码流索引，0为主码流
+    return:
+        0, 成功
+        HLE_RET_ENOTSUPPORTED, 卡上没有 FAT 文件系统（不格式化，等用户命令 sd_record_format）
+        <0, 失败（没有插卡等）
+ */
+int sd_record_start(int stream_index);
+void sd_record_stop(void);
+
+/*
+    function:  sd_record_format
+    description:  用户命令：停止录像，格式化 SD 卡，重新开始录像
+    args:
+        int stream_index[in]，码流索引，0为主码流
+    return:
+        0, 成功
+        <0, 失败
+    attention:
+        卡上原有的数据全部丢失；耗时为秒级（建立切片时扫描 FAT），不要在命令接收线程里直接调用
+ */
+int sd_record_format(int stream_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
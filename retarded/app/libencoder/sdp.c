@@ -8,6 +8,8 @@
 #include "spm.h"
 #include "lsslab.h"
 #include "encoder.h"
+#include "json_stream.h"
+#include "metrics.h"
 
 typedef struct __tag_STREAM_QUEUE_NODE {
 	struct __tag_STREAM_QUEUE_NODE *next;
@@ -25,6 +27,8 @@ typedef struct {
 	pthread_cond_t cond;
 	STREAM_QUEUE_NODE *head;
 	STREAM_QUEUE_NODE *tail;
+	void (*notify)(void *arg); /*队列由空变为非空时回调（sdp_set_notify设置），用于事件驱动的取包*/
+	void *notify_arg;
 } STREAM_QUEUE;
 
 #define MAX_QUEUED_VFRAME   50      /*队列中帧数超过该值开始丢帧*/
@@ -46,6 +50,7 @@ typedef struct {
 
 static LSSLAB_HANDLE slb_hdl;
 static STREAM_DISPATCHER stream_dps[ENC_STREAM_NUM];
+static int slb_fail_logged; /*节点分配失败已经打印过（分配成功后清零），避免每帧打印*/
 
 
 #define ENC_GET_VI_CHN(enc_chn)         ((enc_chn)/STREAMS_PER_CHN)
@@ -180,6 +185,8 @@ int sdp_request_queue(int enc_chn, int auto_rc)
 				queue->block_level = -1;
 			queue->drop_frame = 0;
 			queue->down_count = 0;
+			queue->notify = NULL;
+			queue->notify_arg = NULL;
 			psdp->count++;
 			if (psdp->count == 1) 
 			{
@@ -252,6 +259,8 @@ int sdp_free_queue(int queue_id)
 	queue->active = 0;
 	queue->count = 0;
 	queue->vframe_count = 0;
+	queue->notify = NULL;
+	queue->notify_arg = NULL;
 	pthread_mutex_unlock(&queue->lock);
 	pthread_cond_signal(&queue->cond); //防止调用sdp_dequeue的线程一直阻塞无法退出
 
@@ -302,8 +311,11 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack)
 		{
 			if (queue->vframe_count > MAX_QUEUED_VFRAME) 
 			{
-				ERROR_LOG("enc_chn[%d] queue[%d], drop to iframe\n", enc_chn, i);
+				if (!queue->drop_frame) //只在进入丢帧状态时打印，丢帧数见 metrics 的 sdp_drop
+					ERROR_LOG("enc_chn[%d] queue[%d], drop to iframe\n", enc_chn, i);
 				queue->drop_frame = 1;
+				METRICS_INC(MET_C_SDP_DROP);
+				METRICS_TRACE(TRACE_SDP_DROP, enc_chn, ((FRAME_HDR *) pack->data)->type, i, queue->vframe_count);
 				pthread_mutex_unlock(&queue->lock);
 				continue;
 
@@ -318,6 +330,8 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack)
 				} 
 				else 
 				{
+					METRICS_INC(MET_C_SDP_DROP);
+					METRICS_TRACE(TRACE_SDP_DROP, enc_chn, fh->type, i, queue->vframe_count);
 					pthread_mutex_unlock(&queue->lock);
 					continue;
 				}
@@ -326,12 +340,18 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack)
 			STREAM_QUEUE_NODE *node = (STREAM_QUEUE_NODE *) lsslab_alloc(slb_hdl);
 			if (node == NULL) 
 			{
-				ERROR_LOG("lsslab_alloc failed!\n");
+				if (!slb_fail_logged)
+					ERROR_LOG("lsslab_alloc failed!\n");
+				slb_fail_logged = 1;
+				METRICS_INC(MET_C_SDP_SLAB_FAIL);
 				pthread_mutex_unlock(&queue->lock);
 				continue;
 			}
+			slb_fail_logged = 0;
 
 			int trigger = 0;
+			void (*notify)(void *arg) = NULL;
+			void *notify_arg = NULL;
 			/*add to stream queue tail*/
 			spm_inc_pack_ref(pack);
 			node->pack = pack;
@@ -351,10 +371,17 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack)
 			if (fh->type == 0xF8 || fh->type == 0xF9)
 				queue->vframe_count++;
 			queue->count++;
+			METRICS_GAUGE(MET_G_SDP_VFRAMES, queue->vframe_count);
+			if (trigger) {
+				notify = queue->notify;
+				notify_arg = queue->notify_arg;
+			}
 
 			pthread_mutex_unlock(&queue->lock);
 			if (trigger) /*trigger a signal if inner list was empty before add this node*/
 				pthread_cond_signal(&queue->cond);
+			if (notify)
+				notify(notify_arg);
 
 			if (queue->block_level != -1) //queue->block_level等于-1表示该队列不参与拥塞控制
 			{
@@ -406,16 +433,7 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack)
 	return 0;
 }
 
-/*
-	function:  spm_dequeue
-	description:  从分发队列取出码流包接口
-	args:
-		int queue_id[in], 码流分发队列ID
-	return:
-		non-NULL  success  指向所取出的码流包的指针
-		NULL    fail
- */
-ENC_STREAM_PACK *sdp_dequeue(int queue_id)
+static ENC_STREAM_PACK *__sdp_dequeue(int queue_id, int wait)
 {
 	if (slb_hdl == NULL)
 		return NULL;
@@ -432,7 +450,7 @@ ENC_STREAM_PACK *sdp_dequeue(int queue_id)
 	pthread_mutex_lock(&queue->lock);
 	while (queue->head == NULL) 
 	{
-		if (queue->active == 0) 
+		if (queue->active == 0 || !wait) 
 		{
 			pthread_mutex_unlock(&queue->lock);
 			return NULL;
@@ -456,6 +474,101 @@ ENC_STREAM_PACK *sdp_dequeue(int queue_id)
 	return pack;
 }
 
+/*
+	function:  spm_dequeue
+	description:  从分发队列取出码流包接口
+	args:
+		int queue_id[in], 码流分发队列ID
+	return:
+		non-NULL  success  指向所取出的码流包的指针
+		NULL    fail
+ */
+ENC_STREAM_PACK *sdp_dequeue(int queue_id)
+{
+	return __sdp_dequeue(queue_id, 1);
+}
+
+/*
+	function:  sdp_try_dequeue
+	description:  从分发队列取出码流包接口（不阻塞）
+	args:
+		int queue_id[in], 码流分发队列ID
+	return:
+		non-NULL  success  指向所取出的码流包的指针
+		NULL    队列为空或者失败
+ */
+ENC_STREAM_PACK *sdp_try_dequeue(int queue_id)
+{
+	return __sdp_dequeue(queue_id, 0);
+}
+
+/*
+	function:  sdp_set_notify
+	description:  设置队列由空变为非空时的回调，配合sdp_try_dequeue实现一个线程服务多个队列
+	args:
+		int queue_id[in], 码流分发队列ID
+		void (*notify)(void *arg)[in], 回调函数，NULL取消；在编码线程中调用，不能阻塞
+		void *arg[in], 回调参数
+	return:
+		0  success
+		<0  fail
+ */
+int sdp_set_notify(int queue_id, void (*notify)(void *arg), void *arg)
+{
+	if (slb_hdl == NULL)
+		return -1;
+
+	int enc_chn = queue_id >> 16;
+	int queue_index = queue_id & 0xFFFF;
+	if (enc_chn < 0 || enc_chn >= ENC_STREAM_NUM)
+		return HLE_RET_EINVAL;
+	if (queue_index < 0 || queue_index >= QUEUES_PER_STREAM)
+		return HLE_RET_EINVAL;
+
+	STREAM_QUEUE *queue = stream_dps[enc_chn].stream_queues + queue_index;
+	pthread_mutex_lock(&queue->lock);
+	if (!queue->active) {
+		pthread_mutex_unlock(&queue->lock);
+		return -1;
+	}
+	queue->notify = notify;
+	queue->notify_arg = arg;
+	pthread_mutex_unlock(&queue->lock);
+	return 0;
+}
+
+/*metrics 快照：活动的分发队列和节点使用情况（原 sdp_debug_info）*/
+static void sdp_collect(struct _json_writer_t *w)
+{
+	int i, j, used = 0, count = 0;
+
+	if (slb_hdl == NULL)
+		return;
+	lsslab_get_usage(slb_hdl, &used, &count);
+	json_write_int(w, "slab_used", used);
+	json_write_int(w, "slab_count", count);
+	json_write_arr_begin(w, "queues");
+	for (i = 0; i < ENC_STREAM_NUM; i++) {
+		STREAM_DISPATCHER *psdp = stream_dps + i;
+		for (j = 0; j < QUEUES_PER_STREAM; j++) {
+			STREAM_QUEUE *queue = psdp->stream_queues + j;
+			pthread_mutex_lock(&queue->lock);
+			if (queue->active) {
+				json_write_obj_begin(w, NULL);
+				json_write_int(w, "stream", i);
+				json_write_int(w, "queue", j);
+				json_write_int(w, "count", queue->count);
+				json_write_int(w, "vframes", queue->vframe_count);
+				json_write_int(w, "block_level", queue->block_level);
+				json_write_int(w, "drop", queue->drop_frame);
+				json_write_obj_end(w);
+			}
+			pthread_mutex_unlock(&queue->lock);
+		}
+	}
+	json_write_arr_end(w);
+}
+
 /*
 	function:  sdp_init
 	description:  SPD模块初始化接口
@@ -491,8 +604,11 @@ int sdp_init(int pack_count)
 			pthread_cond_init(&psdp->stream_queues[j].cond, NULL);
 			psdp->stream_queues[j].head = NULL;
 			psdp->stream_queues[j].tail = NULL;
+			psdp->stream_queues[j].notify = NULL;
+			psdp->stream_queues[j].notify_arg = NULL;
 		}
 	}
+	metrics_register_collector("sdp", sdp_collect);
 
 	return 0;
 }
@@ -502,6 +618,8 @@ void sdp_exit(void)
 	if (slb_hdl == NULL)
 		return;
 
+	metrics_register_collector("sdp", NULL); /*先注销，快照不再访问将要销毁的队列锁*/
+
 	int i;
 	for (i = 0; i < ENC_STREAM_NUM; i++) {
 		int j;
@@ -516,34 +634,5 @@ void sdp_exit(void)
 	slb_hdl = NULL;
 }
 
-void lsslab_debug_info(LSSLAB_HANDLE hslab);
-void spm_debug_info(void);
-
-void sdp_debug_info(void)
-{
-	if (slb_hdl == NULL)
-		return;
-
-	int i;
-	DEBUG_LOG("--------------------active queues-------------------\n");
-	for (i = 0; i < ENC_STREAM_NUM; i++) {
-		STREAM_DISPATCHER *psdp = stream_dps + i;
-
-		int j;
-		for (j = 0; j < QUEUES_PER_STREAM; j++) {
-			pthread_mutex_lock(&psdp->stream_queues[j].lock);
-			if (psdp->stream_queues[j].active) {
-				DEBUG_LOG("stream %d, queue %d, count %d, vframe count %d, block_level %d, down_count %d\n",
-					i, j, psdp->stream_queues[j].count, psdp->stream_queues[j].vframe_count,
-					psdp->stream_queues[j].block_level, psdp->stream_queues[j].down_count);
-			}
-			pthread_mutex_unlock(&psdp->stream_queues[j].lock);
-		}
-	}
-
-
-	lsslab_debug_info(slb_hdl);
-	spm_debug_info();
-}
 
 
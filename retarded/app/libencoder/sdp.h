@@ -57,6 +57,30 @@ int sdp_enqueue(int enc_chn, ENC_STREAM_PACK *pack);
  */
 ENC_STREAM_PACK *sdp_dequeue(int queue_id);
 
+/*
+    function:  sdp_try_dequeue
+    description:  从分发队列取出码流包接口（不阻塞）
+    args:
+        int queue_id[in], 码流分发队列ID
+    return:
+        non-NULL  success  指向所取出的码流包的指针
+        NULL    队列为空或者失败
+ */
+ENC_STREAM_PACK *sdp_try_dequeue(int queue_id);
+
+/*
+    function:  sdp_set_notify
+    description:  设置队列由空变为非空时的回调（在编码线程中调用，不能阻塞）
+    args:
+        int queue_id[in], 码流分发队列ID
+        void (*notify)(void *arg)[in], 回调函数，NULL取消
+        void *arg[in], 回调参数
+    return:
+        0  success
+        <0  fail
+ */
+int sdp_set_notify(int queue_id, void (*notify)(void *arg), void *arg);
+
 /*
     function:  sdp_init
     description:  SPD模块初始化接口
@@ -4,6 +4,8 @@
 #include <pthread.h>
 
 #include "spm.h"
+#include "json_stream.h"
+#include "metrics.h"
 
 typedef struct __tag_STREAM_LIST_NODE {
  	unsigned int ref_count;
@@ -46,18 +48,21 @@ ENC_STREAM_PACK *spm_alloc(unsigned int length)
 	
 	if (node == NULL) {
 		ERROR_LOG("malloc pack failed, length = %d\n", length);
+		METRICS_INC(MET_C_SPM_ALLOC_FAIL);
 		return NULL;
 	}
 
 	pthread_mutex_lock(&spm_ctx.free_lock);
 	while (spm_ctx.count == spm_ctx.max) {
 		FATAR_LOG("SPM no free packet left, wait for free signal\n");
+		METRICS_INC(MET_C_SPM_WAIT);
 		pthread_cond_wait(&spm_ctx.free_cond, &spm_ctx.free_lock);
 	}
 
-	//printf("spm_ctx.count++ !\n");
 	spm_ctx.count++;
 	spm_ctx.used_mem += length;
+	METRICS_GAUGE(MET_G_SPM_PACKS, spm_ctx.count);
+	METRICS_GAUGE(MET_G_SPM_KB, spm_ctx.used_mem >> 10);
 	pthread_mutex_unlock(&spm_ctx.free_lock);
 
 	node->pack.data = (HLE_U8 *) node + sizeof (STREAM_LIST_NODE);
@@ -117,7 +122,6 @@ int spm_pack_print_ref(ENC_STREAM_PACK *pack)
 		0  success
 		-1  fail
  */
-int debug_i = 0;
 int spm_dec_pack_ref(ENC_STREAM_PACK *pack)
 {
 	if (pack == NULL)
@@ -126,9 +130,6 @@ int spm_dec_pack_ref(ENC_STREAM_PACK *pack)
 		return -1;
 
 	STREAM_LIST_NODE *node = CONTANER_OF(pack, STREAM_LIST_NODE, pack);
-	//debug*********
-	//printf("spm_ctx.count = %d  spm_ctx.max = %d ref_count = %d \n",spm_ctx.count,spm_ctx.max,node->ref_count);
-	//**************
 
 	if (__sync_sub_and_fetch(&node->ref_count, 1) <= 0) 
 	{
@@ -138,33 +139,32 @@ int spm_dec_pack_ref(ENC_STREAM_PACK *pack)
 		//if (spm_ctx.count == spm_ctx.max) /*trigger a signal if free list was empty before add this node*/
 		if (spm_ctx.count >= spm_ctx.max)
 			trigger = 1;
-		//debug
-		debug_i++;
-		if(40 == debug_i)
-		{
-			printf("pm_ctx.count--! spm_ctx.count = %d\n",spm_ctx.count);
-			debug_i = 0;
-		}
-		
-		
+
 		spm_ctx.count--;
 		spm_ctx.used_mem -= node->length;
+		METRICS_GAUGE(MET_G_SPM_PACKS, spm_ctx.count);
+		METRICS_GAUGE(MET_G_SPM_KB, spm_ctx.used_mem >> 10);
 		pthread_mutex_unlock(&spm_ctx.free_lock);
 
 		free(node);
 
-
 		if (trigger)
-		{
-			printf("pthread_cond_signal !\n");
 			pthread_cond_signal(&spm_ctx.free_cond);
-		}
-
 	}
 
 	return 0;
 }
 
+/*metrics 快照：码流包使用情况（原 spm_debug_info）*/
+static void spm_collect(struct _json_writer_t *w)
+{
+	pthread_mutex_lock(&spm_ctx.free_lock);
+	json_write_int(w, "max", spm_ctx.max);
+	json_write_int(w, "count", spm_ctx.count);
+	json_write_u64(w, "used_mem", spm_ctx.used_mem);
+	pthread_mutex_unlock(&spm_ctx.free_lock);
+}
+
 /*
 	function:  spm_init
 	description:  码流包管理模块初始化接口
@@ -190,6 +190,7 @@ int spm_init(int pack_count)
 	spm_ctx.used_mem = 0;
 	pthread_mutex_init(&spm_ctx.free_lock, NULL);
 	pthread_cond_init(&spm_ctx.free_cond, NULL);
+	metrics_register_collector("spm", spm_collect);
 
 	return 0;
 }
@@ -214,18 +215,12 @@ void spm_exit(void)
 	}
 	pthread_mutex_unlock(&spm_ctx.free_lock);
 
+	metrics_register_collector("spm", NULL);
 	pthread_cond_destroy(&spm_ctx.free_cond);
 	pthread_mutex_destroy(&spm_ctx.free_lock);
 	spm_ctx.max = 0;
 }
 
-void spm_debug_info(void)
-{
-	DEBUG_LOG("--------------------spm_debug_info-------------------\n");
-	pthread_mutex_lock(&spm_ctx.free_lock);
-	DEBUG_LOG("max %d, count %d, used_mem %u\n", spm_ctx.max, spm_ctx.count, spm_ctx.used_mem);
-	pthread_mutex_unlock(&spm_ctx.free_lock);
-}
 
 //test
 #if 0
@@ -27,145 +27,391 @@ void destroy_surface(HLE_SURFACE *sfc, void *addr)
 	free(addr);
 }
 
-//双线性插值，在OSD这种场景下不比邻近插值好多少(ALPHA很难处理)，而且耗CPU很厉害
-#if 0
-#define __A(v) (((v) >> 15) & 0x1)
-#define __R(v) (((v) >> 10) & 0x1F)
-#define __G(v) (((v) >> 5) & 0x1F)
-#define __B(v) ((v) & 0x1F)
-#define __ARGB(a, r, g, b) ((((a)&0x1)<<15)|(((r)&0x1F)<<10)|(((g)&0x1F)<<5)|((b)&0x1F))
-
-static int bilineer_scale(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
-	HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+/*
+缩放全部使用整数运算（ARM926EJ-S 没有浮点单元和除法指令，原来每个像素的浮点乘法都是软件模拟）：
+1.坐标用 16.16 定点数按步长累加，每次缩放先算好每一列的源坐标和权重表，逐行复用。
+2.双线性插值可分离：先水平插值（每个源行只算一次，缓存两行），再垂直插值，权重 5 bit（0 ~ 32）。
+3.RGB555 展开成 "G 在 21 ~ 25 位，R 在 10 ~ 14 位，B 在 0 ~ 4 位" 的 32 位数，乘 5 bit 权重后三个分量
+  各占 10 bit 互不进位，一次乘法同时算三个分量；alpha（1 bit）单独按权重求和，过半为 1。
+4.缩小到一半以下时双线性会丢像素（闪烁、笔画断裂），改用均值（box）滤波：每个目标像素取它覆盖的源像素平均值。
+每种算法另有逐分量计算的参考实现（sfc_ref_xxx），只用于测试核对，结果与快速实现逐位一致。
+*/
+#define SFC_FRAC_BITS		5
+#define SFC_ONE				(1 << SFC_FRAC_BITS)
+#define SFC_SPREAD_MASK		0x03E07C1FU
+#define SFC_SPREAD_ROUND	0x02004010U		//三个分量各加 16（0.5）再右移 5 位，四舍五入
+
+#define SFC_SPREAD(p)		(((HLE_U32)(p) & 0x7C1F) | (((HLE_U32)(p) & 0x03E0) << 16))
+#define SFC_PACK(v)			((HLE_U16)(((v) & 0x7C1F) | (((v) >> 16) & 0x03E0)))
+#define SFC_ALPHA(p)		(((p) >> 15) & 0x1)
+
+/*每一列（行）的源坐标和权重*/
+typedef struct _sfc_axis_t
 {
-	if (src_bmp == NULL || dst_bmp == NULL)
-		return -1;
+	int		i0;		//左（上）侧源像素
+	int		i1;		//右（下）侧源像素
+	int		f;		//右（下）侧源像素的权重（0 ~ SFC_ONE）
+}sfc_axis_t;
 
-	if (src_w == dst_w && src_h == dst_h) {
-		memcpy(dst_bmp, src_bmp, src_w * src_h * 2);
-		return 0;
+/*
+功能：按像素中心对齐计算 dst_len 个目标坐标对应的源坐标和双线性权重
+*/
+static void sfc_axis_bilinear(sfc_axis_t *axis, int dst_len, int src_len)
+{
+	HLE_U32 step = ((HLE_U32)src_len << 16) / dst_len;
+	int pos = (int)(step >> 1) - 0x8000;	//(x + 0.5) * step - 0.5
+	int x;
+
+	for (x = 0; x < dst_len; x++, pos += step)
+	{
+		int p = (pos < 0) ? 0 : pos;
+		axis[x].i0 = p >> 16;
+		axis[x].f = (p >> (16 - SFC_FRAC_BITS)) & (SFC_ONE - 1);
+		if (axis[x].i0 >= src_len - 1)
+		{
+			axis[x].i0 = src_len - 1;
+			axis[x].f = 0;
+		}
+		axis[x].i1 = (axis[x].f != 0) ? axis[x].i0 + 1 : axis[x].i0;
 	}
+}
 
-	float w_scale = (float) ((1.0 * src_w) / dst_w);
-	float h_scale = (float) ((1.0 * src_h) / dst_h);
+/*
+功能：计算 dst_len 个目标像素覆盖的源像素区间 [i0, i1)，至少一个像素
+*/
+static void sfc_axis_box(sfc_axis_t *axis, int dst_len, int src_len)
+{
+	int x;
 
-	int x, y;
-	for (y = 0; y < dst_h; y++) //列
+	for (x = 0; x < dst_len; x++)
 	{
-		float src_fy = y * h_scale;
-		if (src_fy <= 1e-8)
-			src_fy = 0;
-		if (src_fy > src_h - 2)
-			src_fy = src_h - 2;
+		axis[x].i0 = x * src_len / dst_len;
+		axis[x].i1 = (x + 1) * src_len / dst_len;
+		if (axis[x].i1 <= axis[x].i0)
+			axis[x].i1 = axis[x].i0 + 1;
+		axis[x].f = 0;
+	}
+}
+
+/*---# 最邻近插值 -------------------------------------------------------------------*/
+static int sfc_scale_nearest(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	const HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	int *xi = (int *) malloc(dst_w * sizeof(int));
+	if (xi == NULL)
+		return -1;
+
+	HLE_U32 step_x = (src_w << 16) / dst_w;
+	HLE_U32 step_y = (src_h << 16) / dst_h;
+	HLE_U32 pos = 0;
+	int x, y;
 
-		int j = (int) src_fy;
-		float v = src_fy - j;
+	for (x = 0; x < dst_w; x++, pos += step_x)
+		xi[x] = pos >> 16;
 
-		for (x = 0; x < dst_w; x++) //行
+	int last_sy = -1;
+	HLE_U16 *dst = dst_bmp;
+	for (y = 0, pos = 0; y < dst_h; y++, pos += step_y, dst += dst_w)
+	{
+		int sy = pos >> 16;
+		if (sy == last_sy)	//和上一行用的同一个源行，直接复制
 		{
-			float src_fx = x * w_scale;
-			if (src_fx <= 1e-8)
-				src_fx = 0;
-			if (src_fx > src_w - 2)
-				src_fx = src_w - 2;
-
-			int i = (int) src_fx;
-			float u = src_fx - i;
-
-			int v11 = *(src_bmp + src_w * j + i);
-			int v12 = *(src_bmp + src_w * (j + 1) + i);
-			int v21 = *(src_bmp + src_w * j + i + 1);
-			int v22 = *(src_bmp + src_w * (j + 1) + i + 1);
-
-			//f(i+u,j+v) = (1-u)(1-v)f(i,j) + (1-u)vf(i,j+1) + u(1-v)f(i+1,j) + uvf(i+1,j+1)
-			int r = (int) ((1 - u)*(1 - v) * __R(v11) + (1 - u) * v * __R(v12)
-				+ u * (1 - v) * __R(v21) + u * v * __R(v22));
-			if (r > 0x1F)
-				r = 0x1F;
-			int g = (int) ((1 - u)*(1 - v) * __G(v11) + (1 - u) * v * __G(v12)
-				+ u * (1 - v) * __G(v21) + u * v * __G(v22));
-			if (g > 0x1F)
-				g = 0x1F;
-
-			int b = (int) ((1 - u)*(1 - v) * __B(v11) + (1 - u) * v * __B(v12)
-				+ u * (1 - v) * __B(v21) + u * v * __B(v22));
-			if (b > 0x1F)
-				b = 0x1F;
-
-			float alpha = (1 - u)*(1 - v) * __A(v11) + (1 - u) * v * __A(v12)
-				+ u * (1 - v) * __A(v21) + u * v * __A(v22);
-			int a = (alpha >= 0.5) ? 1 : 0;
-
-			*(dst_bmp + dst_w * y + x) = __ARGB(a, r, g, b);
+			memcpy(dst, dst - dst_w, dst_w * sizeof(HLE_U16));
+			continue;
 		}
+		last_sy = sy;
+
+		const HLE_U16 *src = src_bmp + src_w * sy;
+		for (x = 0; x < dst_w; x++)
+			dst[x] = src[xi[x]];
 	}
 
+	free(xi);
 	return 0;
 }
-#undef __A
-#undef __R
-#undef __G
-#undef __B
-#undef __ARGB
-#endif
 
-#if 1
+/*---# 双线性插值（可分离，定点）------------------------------------------------------*/
 
-static int lineer_scale(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
-	HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+/*水平插值一个源行：输出展开格式的 RGB 和 alpha 权重（0 ~ SFC_ONE）*/
+static void sfc_hrow_bilinear(HLE_U32 *out, HLE_U8 *out_a, const HLE_U16 *src,
+	const sfc_axis_t *axis, int dst_w)
 {
-	if (src_bmp == NULL || dst_bmp == NULL)
-		return -1;
+	int x;
 
-	if (src_w == dst_w && src_h == dst_h) {
-		memcpy(dst_bmp, src_bmp, src_w * src_h * 2);
-		return 0;
+	for (x = 0; x < dst_w; x++)
+	{
+		HLE_U16 p0 = src[axis[x].i0];
+		HLE_U16 p1 = src[axis[x].i1];
+		HLE_U32 f = axis[x].f;
+
+		HLE_U32 v = SFC_SPREAD(p0) * (SFC_ONE - f) + SFC_SPREAD(p1) * f;
+		out[x] = ((v + SFC_SPREAD_ROUND) >> SFC_FRAC_BITS) & SFC_SPREAD_MASK;
+		out_a[x] = SFC_ALPHA(p0) * (SFC_ONE - f) + SFC_ALPHA(p1) * f;
 	}
+}
+
+static int sfc_scale_bilinear(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	const HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	/*一次分配：列表、行表、两行水平插值结果（HLE_U32 在前保证对齐）*/
+	char *mem = (char *) malloc(2 * dst_w * sizeof(HLE_U32) + (dst_w + dst_h) * sizeof(sfc_axis_t)
+		+ 2 * dst_w * sizeof(HLE_U8));
+	if (mem == NULL)
+		return -1;
 
-	float w_scale = (float) ((1.0 * src_w) / dst_w);
-	float h_scale = (float) ((1.0 * src_h) / dst_h);
+	HLE_U32 *row[2];
+	HLE_U8 *row_a[2];
+	row[0] = (HLE_U32 *) mem;
+	row[1] = row[0] + dst_w;
+	sfc_axis_t *ax = (sfc_axis_t *)(row[1] + dst_w);
+	sfc_axis_t *ay = ax + dst_w;
+	row_a[0] = (HLE_U8 *)(ay + dst_h);
+	row_a[1] = row_a[0] + dst_w;
 
+	sfc_axis_bilinear(ax, dst_w, src_w);
+	sfc_axis_bilinear(ay, dst_h, src_h);
+
+	int row_y[2] = {-1, -1};	//row[0]/row[1] 中缓存的源行
+	HLE_U16 *dst = dst_bmp;
 	int x, y;
-	for (y = 0; y < dst_h; y++) //列
+
+	for (y = 0; y < dst_h; y++, dst += dst_w)
 	{
-		int src_y = (int) (y * h_scale);
-		if (src_y > src_h - 1) {
-			DEBUG_LOG("IMPOSSIBLE src_y %d!\n", src_y);
-			src_y = src_h - 1;
+		int y0 = ay[y].i0;
+		int y1 = ay[y].i1;
+
+		/*放大时相邻目标行大多用同一对源行，下移一行时复用原来的下一行*/
+		if (row_y[0] != y0)
+		{
+			if (row_y[1] == y0)
+			{
+				HLE_U32 *t = row[0]; row[0] = row[1]; row[1] = t;
+				HLE_U8 *ta = row_a[0]; row_a[0] = row_a[1]; row_a[1] = ta;
+				row_y[0] = y0;
+				row_y[1] = -1;
+			}
+			else
+			{
+				sfc_hrow_bilinear(row[0], row_a[0], src_bmp + src_w * y0, ax, dst_w);
+				row_y[0] = y0;
+			}
 		}
 
-		for (x = 0; x < dst_w; x++) //行
+		HLE_U32 fy = ay[y].f;
+		if (fy == 0)
 		{
-			int src_x = (int) (x * w_scale);
+			const HLE_U32 *h0 = row[0];
+			const HLE_U8 *a0 = row_a[0];
+			for (x = 0; x < dst_w; x++)
+				dst[x] = SFC_PACK(h0[x]) | ((a0[x] * 2 >= SFC_ONE) ? 0x8000 : 0);
+			continue;
+		}
 
-			if (src_x > src_w - 1) {
-				DEBUG_LOG("IMPOSSIBLE src_x %d!\n", src_x);
-				src_x = src_w - 1;
+		if (row_y[1] != y1)
+		{
+			sfc_hrow_bilinear(row[1], row_a[1], src_bmp + src_w * y1, ax, dst_w);
+			row_y[1] = y1;
+		}
+
+		const HLE_U32 *h0 = row[0];
+		const HLE_U32 *h1 = row[1];
+		const HLE_U8 *a0 = row_a[0];
+		const HLE_U8 *a1 = row_a[1];
+		HLE_U32 gy = SFC_ONE - fy;
+		for (x = 0; x < dst_w; x++)
+		{
+			HLE_U32 v = h0[x] * gy + h1[x] * fy;
+			v = ((v + SFC_SPREAD_ROUND) >> SFC_FRAC_BITS) & SFC_SPREAD_MASK;
+			HLE_U32 a = a0[x] * gy + a1[x] * fy;
+			dst[x] = SFC_PACK(v) | ((a * 2 >= SFC_ONE * SFC_ONE) ? 0x8000 : 0);
+		}
+	}
+
+	free(mem);
+	return 0;
+}
+
+/*---# 均值（box）缩小 ---------------------------------------------------------------*/
+
+/*除以 n 并四舍五入：UMULL 乘倒数代替除法，n < 4096 时结果与除法完全一致*/
+#define SFC_BOX_PACKED_MAX				32
+#define SFC_RECIP(n)					((HLE_U32)((0xFFFFFFFFULL + 2 * (n)) / (2 * (n))))	//ceil(2^32 / 2n)
+#define SFC_DIV_ROUND(sum, n, recip)	((HLE_U32)(((HLE_U64)(2 * (sum) + (n)) * (recip)) >> 32))
+
+static int sfc_scale_box(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	const HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	/*累加器：逐分量时每个目标列 4 个分量（B/R/G/A），打包时每个源列 2 个（展开格式的 RGB + alpha 个数）*/
+	HLE_U32 acc_len = (4 * dst_w > 2 * src_w) ? 4 * dst_w : 2 * src_w;
+	char *mem = (char *) malloc(acc_len * sizeof(HLE_U32) + (dst_w + dst_h) * sizeof(sfc_axis_t));
+	if (mem == NULL)
+		return -1;
+
+	HLE_U32 *acc = (HLE_U32 *) mem;
+	sfc_axis_t *ax = (sfc_axis_t *)(acc + acc_len);
+	sfc_axis_t *ay = ax + dst_w;
+
+	sfc_axis_box(ax, dst_w, src_w);
+	sfc_axis_box(ay, dst_h, src_h);
+
+	/*每个目标像素最多覆盖 32 个源像素时，RGB 展开后直接相加（每个分量 10 bit 不进位），倒数查表*/
+	HLE_U32 nx_max = 0, ny_max = 0;
+	HLE_U32 recip[SFC_BOX_PACKED_MAX + 1];
+	int x, y, sy, sx;
+	for (x = 0; x < dst_w; x++)
+		if (ax[x].i1 - ax[x].i0 > nx_max)
+			nx_max = ax[x].i1 - ax[x].i0;
+	for (y = 0; y < dst_h; y++)
+		if (ay[y].i1 - ay[y].i0 > ny_max)
+			ny_max = ay[y].i1 - ay[y].i0;
+	int packed = (nx_max * ny_max <= SFC_BOX_PACKED_MAX);
+	if (packed)
+	{
+		for (x = 1; x <= SFC_BOX_PACKED_MAX; x++)
+			recip[x] = SFC_RECIP(x);
+	}
+
+	HLE_U16 *dst = dst_bmp;
+	for (y = 0; y < dst_h; y++, dst += dst_w)
+	{
+		HLE_U32 ny = ay[y].i1 - ay[y].i0;
+
+		if (packed)
+		{
+			/*可分离：先把覆盖的源行逐列纵向相加，再对每个目标列横向相加*/
+			HLE_U32 *col = acc;
+			HLE_U32 *col_a = acc + src_w;
+			const HLE_U16 *src = src_bmp + src_w * ay[y].i0;
+			for (sx = 0; sx < src_w; sx++)
+			{
+				col[sx] = SFC_SPREAD(src[sx]);
+				col_a[sx] = SFC_ALPHA(src[sx]);
+			}
+			for (sy = ay[y].i0 + 1; sy < ay[y].i1; sy++)
+			{
+				src += src_w;
+				for (sx = 0; sx < src_w; sx++)
+				{
+					col[sx] += SFC_SPREAD(src[sx]);
+					col_a[sx] += SFC_ALPHA(src[sx]);
+				}
 			}
 
-			*(dst_bmp + dst_w * y + x) = *(src_bmp + src_w * src_y + src_x);
+			for (x = 0; x < dst_w; x++)
+			{
+				HLE_U32 v = 0, al = 0;
+				for (sx = ax[x].i0; sx < ax[x].i1; sx++)
+				{
+					v += col[sx];
+					al += col_a[sx];
+				}
+
+				HLE_U32 n = (ax[x].i1 - ax[x].i0) * ny;
+				HLE_U32 r = recip[n];
+				HLE_U32 b = SFC_DIV_ROUND(v & 0x3FF, n, r);
+				HLE_U32 rr = SFC_DIV_ROUND((v >> 10) & 0x3FF, n, r);
+				HLE_U32 g = SFC_DIV_ROUND(v >> 21, n, r);
+				dst[x] = (HLE_U16)((rr << 10) | (g << 5) | b | ((al * 2 >= n) ? 0x8000 : 0));
+			}
+			continue;
+		}
+
+		/*覆盖的源像素太多：逐分量累加，直接做除法（缩小 5 倍以上才会走到这里）*/
+		memset(acc, 0, 4 * dst_w * sizeof(HLE_U32));
+		for (sy = ay[y].i0; sy < ay[y].i1; sy++)
+		{
+			const HLE_U16 *src = src_bmp + src_w * sy;
+			HLE_U32 *a = acc;
+			for (x = 0; x < dst_w; x++, a += 4)
+			{
+				HLE_U32 rb = 0, g = 0, al = 0;
+				for (sx = ax[x].i0; sx < ax[x].i1; sx++)
+				{
+					HLE_U16 p = src[sx];
+					rb += p & 0x7C1F;		//R、B 分量在 16 位里相隔 5 位，最多累加 32 个像素不会进位
+					g += p & 0x03E0;
+					al += p & 0x8000;
+				}
+				a[0] += rb & 0x3FF;
+				a[1] += rb >> 10;
+				a[2] += g >> 5;
+				a[3] += al >> 15;
+			}
+		}
+
+		HLE_U32 *a = acc;
+		for (x = 0; x < dst_w; x++, a += 4)
+		{
+			HLE_U32 n = (ax[x].i1 - ax[x].i0) * ny;
+			HLE_U32 b = (2 * a[0] + n) / (2 * n);
+			HLE_U32 r = (2 * a[1] + n) / (2 * n);
+			HLE_U32 g = (2 * a[2] + n) / (2 * n);
+			dst[x] = (HLE_U16)((r << 10) | (g << 5) | b | ((a[3] * 2 >= n) ? 0x8000 : 0));
 		}
 	}
 
+	free(mem);
 	return 0;
 }
-#endif
+
+/*
+box 缩小中 R、B 打包累加的前提是每列水平覆盖不超过 32 个源像素，否则分量会进位，
+超过时改用双线性（缩小 32 倍以上的 OSD 没有实际意义，只为保证结果正确）
+*/
+static int sfc_box_safe(HLE_U32 dst_w, HLE_U32 src_w)
+{
+	return (src_w + dst_w - 1) / dst_w <= 32;
+}
+
 
 //surface缩放操作，把src缩放到dst
 
-int scale_surface(HLE_SURFACE *dst, HLE_SURFACE *src)
+int scale_surface_mode(HLE_SURFACE *dst, HLE_SURFACE *src, sfc_scale_mode_e mode)
 {
-	return lineer_scale((HLE_U16 *) dst->u32PhyAddr, dst->u32Width, dst->u32Height,
-		(HLE_U16 *) src->u32PhyAddr, src->u32Width, src->u32Height);
+	HLE_U16 *dst_bmp = (HLE_U16 *) dst->u32PhyAddr;
+	HLE_U16 *src_bmp = (HLE_U16 *) src->u32PhyAddr;
+	HLE_U32 dst_w = dst->u32Width, dst_h = dst->u32Height;
+	HLE_U32 src_w = src->u32Width, src_h = src->u32Height;
+
+	if (src_bmp == NULL || dst_bmp == NULL || dst_w == 0 || dst_h == 0 || src_w == 0 || src_h == 0
+		|| dst_w > 0x7FFF || dst_h > 0x7FFF || src_w > 0x7FFF || src_h > 0x7FFF)
+		return -1;
 
-	//return bilineer_scale((HLE_U16 *)dst->u32PhyAddr, dst->u32Width, dst->u32Height,
-	//    (HLE_U16 *)src->u32PhyAddr, src->u32Width, src->u32Height);
+	if (src_w == dst_w && src_h == dst_h) {
+		memcpy(dst_bmp, src_bmp, src_w * src_h * 2);
+		return 0;
+	}
+
+	if (mode == SFC_SCALE_AUTO)
+	{
+		//缩小到一半以下用均值，否则用双线性
+		if (dst_w * 2 <= src_w || dst_h * 2 <= src_h)
+			mode = SFC_SCALE_BOX;
+		else
+			mode = SFC_SCALE_BILINEAR;
+	}
+
+	if (mode == SFC_SCALE_BOX && !sfc_box_safe(dst_w, src_w))
+		mode = SFC_SCALE_BILINEAR;
+
+	switch (mode)
+	{
+	case SFC_SCALE_NEAREST:
+		return sfc_scale_nearest(dst_bmp, dst_w, dst_h, src_bmp, src_w, src_h);
+	case SFC_SCALE_BOX:
+		return sfc_scale_box(dst_bmp, dst_w, dst_h, src_bmp, src_w, src_h);
+	case SFC_SCALE_BILINEAR:
+	default:
+		return sfc_scale_bilinear(dst_bmp, dst_w, dst_h, src_bmp, src_w, src_h);
+	}
+}
+
+int scale_surface(HLE_SURFACE *dst, HLE_SURFACE *src)
+{
+	return scale_surface_mode(dst, src, SFC_SCALE_AUTO);
 }
 
 int scaler_init()
 {
 	return HLE_RET_OK;
 }
-
-
-
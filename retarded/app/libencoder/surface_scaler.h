@@ -25,9 +25,21 @@ void *create_surface(HLE_SURFACE *sfc);
 void destroy_surface(HLE_SURFACE *sfc, void *addr);
 
 
-//surface缩放操作，把src缩放到dst
+/*缩放算法*/
+typedef enum
+{
+    SFC_SCALE_AUTO = 0,     //缩小到一半以下用均值（box），其他用双线性
+    SFC_SCALE_NEAREST,      //最邻近插值
+    SFC_SCALE_BILINEAR,     //双线性插值
+    SFC_SCALE_BOX           //均值缩小（放大时等同于最邻近）
+} sfc_scale_mode_e;
+
+//surface缩放操作，把src缩放到dst（SFC_SCALE_AUTO）
 int scale_surface(HLE_SURFACE *dst, HLE_SURFACE *src);
 
+//按指定算法把src缩放到dst，像素格式为 ARGB1555，只使用整数运算
+int scale_surface_mode(HLE_SURFACE *dst, HLE_SURFACE *src, sfc_scale_mode_e mode);
+
 
 int scaler_init(void);
 
@@ -20,6 +20,7 @@
 #include "encoder.h"
 #include "ts_interface.h"
 #include "ts_encode.h"
+#include "metrics.h"
 
 
  
@@ -158,45 +159,23 @@ int ts_record(void **out_buf,int* out_len,int recode_time)
     memcpy(&tmp_time,&start_record_time,sizeof(start_record_time));
     printf("seconds:%ld  microseconds:%ld\n",start_record_time.tv_sec,start_record_time.tv_usec);
     int cucle_num = 0;
-    unsigned int A_count = 0;
-    unsigned int V_count = 0;
     
     IFRAME_INFO * start_info = (IFRAME_INFO*)(pack->data + sizeof(FRAME_HDR));
     unsigned long long int start_time = start_info->pts_msec;
     unsigned long long int cur_time = start_time;
     printf("start_time = (%llu) cur_time = (%llu)\n",start_time,cur_time);
-     struct timeval audio_time_start = {0};
-     struct timeval video_time_start = {0};
-     struct timeval audio_time_current = {0};
-     struct timeval video_time_current = {0};
-     gettimeofday(&audio_time_start,NULL);
-     gettimeofday(&video_time_start,NULL);
    // while(tmp_time.tv_sec - start_record_time.tv_sec < VIDEO_RECORD_TIME)
    while(1)//录制的时长用视频帧的帧头时间来进行计时比较准确
    {
-        //找到IDR帧，开始录制
-         gettimeofday(&audio_time_current,NULL);
-        if(audio_time_current.tv_sec - audio_time_start.tv_sec >=1)//1s 打印一次
-        {
-            printf("count Aframe = %d\n",A_count);
-            memcpy(&audio_time_start,&audio_time_current,sizeof(struct timeval));
-            A_count = 0;
-        }
-         gettimeofday(&video_time_current,NULL);
-        if(video_time_current.tv_sec - video_time_start.tv_sec >=1)//1s 打印一次
-        {
-            printf("count Vframe = %d\n",V_count);
-            memcpy(&video_time_start,&video_time_current,sizeof(struct timeval));
-            V_count = 0;
-        }
-        
+        //找到IDR帧，开始录制（音视频帧数见 metrics 的 ts_aframes/ts_vframes）
          if (header->type == 0xFA)//0xFA-音频帧
         {
-            A_count ++;
+            METRICS_INC(MET_C_TS_AFRAMES);
             #if 1
                 skip_len = sizeof (FRAME_HDR) + sizeof (AFRAME_INFO);
                 frame_len = pack->length - skip_len; 
                 AFRAME_INFO * A_info = (AFRAME_INFO*)(pack->data + sizeof(FRAME_HDR));
+                METRICS_TRACE(TRACE_MUX_TS, 0, 0xFA, (HLE_U32)A_info->pts_msec, frame_len);
                 // printf("Audio pts : %lld\n",A_info->pts_msec);
                     
                 if(TsAEncode((unsigned char*)pack->data + skip_len,frame_len/* A_FRAME_RATE,A_info->pts_msec*/))
@@ -210,12 +189,13 @@ int ts_record(void **out_buf,int* out_len,int recode_time)
         }
         else if(header->type == 0xF8)   //0xF8-视频关键帧 
         {
-            V_count ++;
+            METRICS_INC(MET_C_TS_VFRAMES);
             // printf("I frame ========\n");
             skip_len = sizeof (FRAME_HDR) + sizeof (IFRAME_INFO);
             frame_len = pack->length - skip_len;    
             IFRAME_INFO * V_info = (IFRAME_INFO*)(pack->data + sizeof(FRAME_HDR));
             cur_time = V_info->pts_msec;
+            METRICS_TRACE(TRACE_MUX_TS, 0, header->type, (HLE_U32)cur_time, frame_len);
             if(TsVEncode((unsigned char*)pack->data + skip_len,frame_len/*V_FRAME_RATE,V_info->pts_msec*/))
             {
                 ERROR_LOG("TsVEncode failed !\n");
@@ -225,12 +205,13 @@ int ts_record(void **out_buf,int* out_len,int recode_time)
         }
         else if(header->type == 0xF9)//0xF9-视频非关键帧
         {
-            V_count ++;
+            METRICS_INC(MET_C_TS_VFRAMES);
             // printf("P frame\n");
             skip_len = sizeof (FRAME_HDR) + sizeof (PFRAME_INFO);
             frame_len = pack->length - skip_len;    
             PFRAME_INFO * V_info = (PFRAME_INFO*)(pack->data + sizeof(FRAME_HDR));
             cur_time = V_info->pts_msec;
+            METRICS_TRACE(TRACE_MUX_TS, 0, header->type, (HLE_U32)cur_time, frame_len);
             if(TsVEncode((unsigned char*)pack->data + skip_len,frame_len/*V_FRAME_RATE,V_info->pts_msec*/))
             {
                 ERROR_LOG("Fmp4VEncode failed !\n");
@@ -5,6 +5,8 @@
 #include <unistd.h>
 #include <stdio.h>
 
+#include <pthread.h>
+
 #include "ziku.h"
 #include "ziku_array_vector.h"
 #include "hal.h"
@@ -305,7 +307,7 @@ int zk_init()
             struct CHARACTER_INFO tmp_info = {0};
             char*  character = "#";
             offset = cur_zks->head.ASCII_offset[(unsigned char)*character];
-            memcpy(&tmp_info,cur_zks->buf + offset - sizeof(struct ZK_HEAD_VECTOR),sizeof(struct ZK_HEAD_VECTOR));
+            memcpy(&tmp_info,cur_zks->buf + offset - sizeof(struct ZK_HEAD_VECTOR),sizeof(struct CHARACTER_INFO));
 
             lattice->width = tmp_info.width;
             lattice->height = tmp_info.height;
@@ -321,7 +323,7 @@ int zk_init()
         struct CHARACTER_INFO tmp_info = {0};
         char*  character = "#";
         unsigned int offset = cur_zks->head.ASCII_offset[(unsigned char)*character];
-        memcpy(&tmp_info,cur_zks->buf + offset - sizeof(struct ZK_HEAD_VECTOR),sizeof(struct ZK_HEAD_VECTOR));
+        memcpy(&tmp_info,cur_zks->buf + offset - sizeof(struct ZK_HEAD_VECTOR),sizeof(struct CHARACTER_INFO));
 
         lattice->width = tmp_info.width;
         lattice->height = tmp_info.height;
@@ -390,6 +392,19 @@ int  get_matrix_width(const HLE_U8 *str,video_resolution resolution,HLE_U32* wid
 }
 
 
+/*按编码图像的宽高选择字库，不支持的分辨率返回 -1*/
+static int zk_get_resolution(int enc_w, int enc_h)
+{
+	if(enc_w == 1920 && enc_h == 1080)	
+		return RESOLUTION_1920x1080;
+	else if(enc_w == 960 && enc_h == 544)
+		return RESOLUTION_960x544;
+	else if(enc_w == 480 && enc_h == 272)
+		return RESOLUTION_480x272;
+
+	return -1;
+}
+
 /* 
 功能：
     将字符串信息转换成OSD图的点阵数据 
@@ -411,21 +426,15 @@ int str2matrix_vector(HLE_U8 *str, OSD_matrix_info_t* ret_info,int enc_w ,int en
 		return -1;
 	}
 
-	char resolution = -1;
-	if(enc_w == 1920 && enc_h == 1080)	
-		resolution = RESOLUTION_1920x1080;
-	else if(enc_w == 960 && enc_h == 544)
-		resolution = RESOLUTION_960x544;
-	else if(enc_w == 480 && enc_h == 272)
-		resolution = RESOLUTION_480x272;
-	else
+	int resolution = zk_get_resolution(enc_w, enc_h);
+	if(resolution < 0)
 	{
 		ERROR_LOG("Unsupported resolution!\n");
 		return -1;
 	}
 		
 	
-    int matrix_width,matrix_height;//字符串OSD点阵数据（宽度+高度）像素点个数（bit位数）
+    HLE_U32 matrix_width,matrix_height;//字符串OSD点阵数据（宽度+高度）像素点个数（bit位数）
     
     int ret = get_matrix_width(str ,resolution, &matrix_width , &matrix_height);
     if(ret < 0)
@@ -489,6 +498,297 @@ int str2matrix_vector(HLE_U8 *str, OSD_matrix_info_t* ret_info,int enc_w ,int en
 
 
 
+/*---# 字形缓存 + 增量绘制 ------------------------------------------------------------------
+每个字库按（前景色，背景色）缓存一份展开成 RGB1555 的字形（每个字符 bpl*8 x height 像素，第一次用到时展开），
+时间 OSD 每秒只有秒位（偶尔分钟位）变化，画布只重画变化的字符，每个字符只是逐行 memcpy。
+*/
+#define ZK_ATLAS_SLOTS      2   //每个字库缓存的颜色组数（时间 OSD + 码率 OSD）
+
+/*按颜色展开好的字形缓存，下标为字符编码（不支持的字符和'#'共用一个字形）*/
+typedef struct _zk_atlas_t
+{
+    HLE_U16         fg_color;
+    HLE_U16         bg_color;
+    unsigned int    last_use;       //最近使用的时间（zk_atlas_tick），用于替换
+    int             height;         //字形高度（像素点个数），所有字形按数字的高度对齐
+    HLE_U8          bpl[256];       //字形宽度（字节数，像素点个数为 bpl*8），0 表示缓存无效
+    HLE_U8          rows[256];      //字形点阵的行数（不超过 height）
+    HLE_U8          ready[256];     //字形是否已经展开
+    HLE_U32         off[256];       //字形在 pixels 中的偏移（像素点个数）
+    const HLE_U8*   bits[256];      //字形点阵
+    HLE_U16*        pixels;
+}zk_atlas_t;
+
+static zk_atlas_t zk_atlas[ARRAY_COUNT(zks_vector)][ZK_ATLAS_SLOTS];
+static unsigned int zk_atlas_tick;
+static pthread_mutex_t zk_atlas_mut = PTHREAD_MUTEX_INITIALIZER;  //保护 zk_atlas，画布在持锁时绘制
+
+/*4 个点阵位（高位在前）对应的像素掩码，展开时 像素 = bg ^ ((fg ^ bg) & 掩码)*/
+#define ZK_NIBBLE_MASK(n)   { ((n)&8)?0xFFFF:0, ((n)&4)?0xFFFF:0, ((n)&2)?0xFFFF:0, ((n)&1)?0xFFFF:0 }
+static const HLE_U16 zk_nibble_mask[16][4] = {
+    ZK_NIBBLE_MASK(0),  ZK_NIBBLE_MASK(1),  ZK_NIBBLE_MASK(2),  ZK_NIBBLE_MASK(3),
+    ZK_NIBBLE_MASK(4),  ZK_NIBBLE_MASK(5),  ZK_NIBBLE_MASK(6),  ZK_NIBBLE_MASK(7),
+    ZK_NIBBLE_MASK(8),  ZK_NIBBLE_MASK(9),  ZK_NIBBLE_MASK(10), ZK_NIBBLE_MASK(11),
+    ZK_NIBBLE_MASK(12), ZK_NIBBLE_MASK(13), ZK_NIBBLE_MASK(14), ZK_NIBBLE_MASK(15)
+};
+#undef ZK_NIBBLE_MASK
+
+
+void zk_expand_bits(HLE_U16 *dst, const HLE_U8 *bits, int bytes, HLE_U16 fg_color, HLE_U16 bg_color)
+{
+    HLE_U16 tmp[4];
+    HLE_U64 bg4, diff4, mask, pix;
+
+    tmp[0] = tmp[1] = tmp[2] = tmp[3] = bg_color;
+    memcpy(&bg4, tmp, sizeof(bg4));
+    tmp[0] = tmp[1] = tmp[2] = tmp[3] = fg_color ^ bg_color;
+    memcpy(&diff4, tmp, sizeof(diff4));
+
+    /*一个字节 = 8 个像素 = 两次 64 位查表，memcpy 由编译器展开成普通的装载/存储*/
+    while (bytes-- > 0)
+    {
+        HLE_U8 b = *bits++;
+
+        memcpy(&mask, zk_nibble_mask[b >> 4], sizeof(mask));
+        pix = bg4 ^ (diff4 & mask);
+        memcpy(dst, &pix, sizeof(pix));
+
+        memcpy(&mask, zk_nibble_mask[b & 0x0F], sizeof(mask));
+        pix = bg4 ^ (diff4 & mask);
+        memcpy(dst + 4, &pix, sizeof(pix));
+
+        dst += 8;
+    }
+}
+
+/*
+功能：按颜色建立字库的字形缓存（已持有 zk_atlas_mut），字形在第一次使用时才展开
+返回：
+    成功：0
+    失败：-1
+*/
+static int zk_atlas_build(zk_atlas_t *atlas, video_resolution resolution, HLE_U16 fg_color, HLE_U16 bg_color)
+{
+    GLYPH_LATTICE ltc[256];
+    HLE_U32 total = 0;
+    int c, k;
+
+    for (c = 0; c < 256; c++)
+    {
+        HLE_U8 ch = (HLE_U8)c;
+        if (zk_get_lattice_vector(&ch, resolution, &ltc[c]) < 0 || ltc[c].bpl <= 0 || ltc[c].bpl > 0xFF)
+        {
+            ERROR_LOG("bad glyph 0x%02x in font %d!\n", c, resolution);
+            atlas->bpl[0] = 0;
+            return -1;
+        }
+    }
+
+    /*字形高度以数字为准：w480 字库的'j''y'比其他字符多一行，多出的行裁掉，保持原来 OSD 的高度*/
+    atlas->height = ltc['0'].height;
+
+    /*相同的字形（不支持的字符都用'#'代替）共用一块缓存*/
+    for (c = 0; c < 256; c++)
+    {
+        for (k = 0; k < c; k++)
+        {
+            if (ltc[k].bits == ltc[c].bits)
+                break;
+        }
+        atlas->bpl[c] = ltc[c].bpl;
+        atlas->rows[c] = (ltc[c].height < atlas->height) ? ltc[c].height : atlas->height;
+        atlas->bits[c] = (const HLE_U8 *)ltc[c].bits;
+        atlas->ready[c] = 0;
+        if (k < c)
+            atlas->off[c] = atlas->off[k];
+        else
+        {
+            atlas->off[c] = total;
+            total += ltc[c].bpl * 8 * atlas->height;
+        }
+    }
+
+    /*1080P 字库全部展开约 350KB，只有用到的字形才会写入（实际占用物理内存）*/
+    HLE_U16 *pixels = (HLE_U16 *)realloc(atlas->pixels, total * sizeof(HLE_U16));
+    if (NULL == pixels)
+    {
+        ERROR_LOG("malloc glyph atlas (%u pixels) failed!\n", total);
+        atlas->bpl[0] = 0;
+        return -1;
+    }
+    atlas->pixels = pixels;
+    atlas->fg_color = fg_color;
+    atlas->bg_color = bg_color;
+    DEBUG_LOG("font %d glyph atlas fg(%#x) bg(%#x): %u pixels, height %d\n",
+              resolution, fg_color, bg_color, total, atlas->height);
+    return 0;
+}
+
+/*取字符 ch 展开好的字形，没有展开则先展开（已持有 zk_atlas_mut）*/
+static const HLE_U16 *zk_atlas_glyph(zk_atlas_t *atlas, HLE_U8 ch)
+{
+    HLE_U16 *dst = atlas->pixels + atlas->off[ch];
+    if (atlas->ready[ch])
+        return dst;
+
+    /*字形低于缓存高度的部分用背景色填充*/
+    int cell_w = atlas->bpl[ch] * 8;
+    const HLE_U8 *bits = atlas->bits[ch];
+    HLE_U16 *row = dst;
+    int j, k;
+    for (j = 0; j < atlas->height; j++)
+    {
+        if (j < atlas->rows[ch])
+        {
+            zk_expand_bits(row, bits, atlas->bpl[ch], atlas->fg_color, atlas->bg_color);
+            bits += atlas->bpl[ch];
+        }
+        else
+        {
+            for (k = 0; k < cell_w; k++)
+                row[k] = atlas->bg_color;
+        }
+        row += cell_w;
+    }
+
+    atlas->ready[ch] = 1;
+    return dst;
+}
+
+/*取字库对应颜色的字形缓存，没有则替换最久没用的一组（已持有 zk_atlas_mut）*/
+static zk_atlas_t *zk_atlas_get(video_resolution resolution, HLE_U16 fg_color, HLE_U16 bg_color)
+{
+    zk_atlas_t *slots = zk_atlas[resolution - RESOLUTION_1920x1080];
+    zk_atlas_t *victim = &slots[0];
+    int i;
+
+    zk_atlas_tick++;
+    for (i = 0; i < ZK_ATLAS_SLOTS; i++)
+    {
+        if (slots[i].bpl[0] != 0 && slots[i].fg_color == fg_color && slots[i].bg_color == bg_color)
+        {
+            slots[i].last_use = zk_atlas_tick;
+            return &slots[i];
+        }
+        if (slots[i].bpl[0] == 0 || slots[i].last_use < victim->last_use)
+            victim = &slots[i];
+    }
+
+    if (zk_atlas_build(victim, resolution, fg_color, bg_color) < 0)
+        return NULL;
+
+    victim->last_use = zk_atlas_tick;
+    return victim;
+}
+
+/*把缓存中的字形拷贝到画布的 x 列*/
+static void zk_canvas_put(OSD_canvas_t *canvas, zk_atlas_t *atlas, HLE_U8 ch, int x)
+{
+    int cell_w = atlas->bpl[ch] * 8;
+    const HLE_U16 *src = zk_atlas_glyph(atlas, ch);
+    HLE_U16 *dst = canvas->bmp + x;
+    int j;
+
+    for (j = 0; j < atlas->height; j++)
+    {
+        memcpy(dst, src, cell_w * sizeof(HLE_U16));
+        src += cell_w;
+        dst += canvas->width;
+    }
+}
+
+
+int zk_canvas_render(OSD_canvas_t *canvas, const HLE_U8 *str, int enc_w, int enc_h,
+                     HLE_U16 fg_color, HLE_U16 bg_color)
+{
+    if (NULL == canvas || NULL == str)
+    {
+        ERROR_LOG("Illegal parameter !\n");
+        return -1;
+    }
+
+    int resolution = zk_get_resolution(enc_w, enc_h);
+    if (resolution < 0)
+    {
+        ERROR_LOG("Unsupported resolution!\n");
+        return -1;
+    }
+
+    int len = strlen((const char *)str);
+    if (len <= 0 || len >= OSD_CANVAS_STR_MAX)
+    {
+        ERROR_LOG("bad OSD string length %d!\n", len);
+        return -1;
+    }
+
+    pthread_mutex_lock(&zk_atlas_mut);
+    zk_atlas_t *atlas = zk_atlas_get(resolution, fg_color, bg_color);
+    if (NULL == atlas)
+    {
+        pthread_mutex_unlock(&zk_atlas_mut);
+        return -1;
+    }
+
+    /*新字符串的排版（矢量字库每个字符宽度不同）*/
+    HLE_U16 cell_x[OSD_CANVAS_STR_MAX];
+    int width = 0;
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        cell_x[i] = width;
+        width += atlas->bpl[str[i]] * 8;
+    }
+
+    int full = (canvas->bmp == NULL || canvas->resolution != resolution
+                || canvas->fg_color != fg_color || canvas->bg_color != bg_color
+                || canvas->width != width || canvas->height != atlas->height);
+    if (full && (canvas->bmp == NULL || canvas->width * canvas->height != width * atlas->height))
+    {
+        HLE_U16 *bmp = (HLE_U16 *)realloc(canvas->bmp, width * atlas->height * sizeof(HLE_U16));
+        if (NULL == bmp)
+        {
+            pthread_mutex_unlock(&zk_atlas_mut);
+            ERROR_LOG("malloc OSD canvas failed !\n");
+            zk_canvas_release(canvas);
+            return -1;
+        }
+        canvas->bmp = bmp;
+    }
+    canvas->resolution = resolution;
+    canvas->fg_color = fg_color;
+    canvas->bg_color = bg_color;
+    canvas->width = width;
+    canvas->height = atlas->height;
+
+    /*整体重画，或者只重画内容/位置有变化的字符（字符宽度变了，后面的字符位置会跟着变）*/
+    int drawn = 0;
+    for (i = 0; i < len; i++)
+    {
+        if (full || i >= canvas->len || canvas->str[i] != str[i] || canvas->cell_x[i] != cell_x[i])
+        {
+            zk_canvas_put(canvas, atlas, str[i], cell_x[i]);
+            drawn++;
+        }
+    }
+    pthread_mutex_unlock(&zk_atlas_mut);
+
+    memcpy(canvas->str, str, len + 1);
+    memcpy(canvas->cell_x, cell_x, len * sizeof(HLE_U16));
+    canvas->len = len;
+
+    return drawn;
+}
+
+void zk_canvas_release(OSD_canvas_t *canvas)
+{
+    if (NULL == canvas)
+        return;
+
+    free(canvas->bmp);
+    memset(canvas, 0, sizeof(*canvas));
+}
+
+
 #if 0
 
 /* 测试用函数,用在让串口打印出点阵, str 参数要和str2matrix()函数的str 一致 */
@@ -574,8 +874,3 @@ int main(int argc, char *argv[])
 }
 
 #endif
-
-
-
-
-
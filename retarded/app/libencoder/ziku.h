@@ -93,6 +93,62 @@ int str2matrix_vector(HLE_U8 *str, OSD_matrix_info_t* ret_info,int enc_w ,int en
 int  get_matrix_width(const HLE_U8 *str,video_resolution resolution,HLE_U32* width,HLE_U32* height);
 
 
+/*---# OSD 画布（RGB1555 位图，增量绘制）------------------------------------------------------*/
+#define OSD_CANVAS_STR_MAX  64      //画布字符串的最大长度（包括"\0"）
+
+/*OSD 字符串画布：保存上一次绘制的字符串和位图，再次绘制时只重画有变化的字符*/
+typedef struct _OSD_canvas_t
+{
+    video_resolution    resolution; //当前位图所用的字库
+    HLE_U16             fg_color;   //前景色（RGB1555）
+    HLE_U16             bg_color;   //背景色（RGB1555）
+    int                 width;      //位图宽度（像素点个数，8 的倍数）
+    int                 height;     //位图高度（像素点个数）
+    int                 len;        //字符个数
+    HLE_U8              str[OSD_CANVAS_STR_MAX];
+    HLE_U16             cell_x[OSD_CANVAS_STR_MAX]; //每个字符在位图中的起始列
+    HLE_U16*            bmp;        //位图数据（width * height 个像素）
+}OSD_canvas_t;
+
+/*
+ * function: void zk_expand_bits(HLE_U16 *dst, const HLE_U8 *bits, int bytes, HLE_U16 fg_color, HLE_U16 bg_color)
+ * description:
+ *              将点阵数据（1个像素 1 bit，高位在前）展开成 RGB1555 像素，查表一次处理 8 个像素
+ * arguments:
+ *              dst, 输出像素（bytes * 8 个），需要 2 字节对齐
+ *              bits, 点阵数据
+ *              bytes, 点阵数据字节数
+ *              fg_color, bg_color, bit 为 1/0 时的颜色
+ * return:		void
+ * */
+void zk_expand_bits(HLE_U16 *dst, const HLE_U8 *bits, int bytes, HLE_U16 fg_color, HLE_U16 bg_color);
+
+/*
+ * function: int zk_canvas_render(OSD_canvas_t *canvas, const HLE_U8 *str, int enc_w, int enc_h, HLE_U16 fg_color, HLE_U16 bg_color)
+ * description:
+ *              把字符串绘制到画布上：字形从按分辨率和颜色预先展开好的字形缓存中拷贝，
+ *              分辨率、颜色或总宽度变化时整体重画，否则只重画内容或位置有变化的字符
+ * arguments:
+ *              canvas, 画布（第一次使用前清零）
+ *              str, 需要绘制的字符串
+ *              enc_w, enc_h, 编码图像的宽高（用于选择字库）
+ *              fg_color, bg_color, 前景色/背景色（RGB1555）
+ * return:
+ *              >0, 重画的字符个数
+ *              0, 与上一次完全相同，位图没有变化
+ *              -1, fail
+ * */
+int zk_canvas_render(OSD_canvas_t *canvas, const HLE_U8 *str, int enc_w, int enc_h,
+                     HLE_U16 fg_color, HLE_U16 bg_color);
+
+/*
+ * function: void zk_canvas_release(OSD_canvas_t *canvas)
+ * description:
+ *              释放画布位图，之后可以重新使用
+ * */
+void zk_canvas_release(OSD_canvas_t *canvas);
+
+
 #endif /*HAL_ZIKU_H*/
 
 
@@ -0,0 +1,368 @@
+/***************************************************************************
+* @file:pcm_resample.c
+* @author:
+* @date:  10,19,2026
+* @brief:  定点多相 PCM 重采样
+*			原理：先插 L-1 个零（上采样 L 倍），低通滤波，再每 M 个取 1 个（下采样）。
+*			多相实现只计算需要输出的点：输出 n 对应上采样域的位置 n*M = pos*L + phase，
+*			只用到原型滤波器中 phase, phase+L, phase+2L ... 这 PCM_RESAMPLE_TAPS 个系数。
+* @attention:系数在初始化时用 Kaiser 窗 sinc 生成（浮点，只算一次），运行时全部为 Q15 定点乘累加
+***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pcm_resample.h"
+#include "ts_print.h"
+
+#define RS_Q				15
+#define RS_HISTORY			(PCM_RESAMPLE_TAPS - 1)		//滤波历史样本数
+#define RS_KAISER_BETA		7.0							//阻带衰减约 70dB
+#define RS_CUTOFF			0.90						//截止频率（相对于较低采样率的奈奎斯特频率）
+
+struct _pcm_resample_t
+{
+	int					in_rate;
+	int					out_rate;
+	int					channels;
+	int					up;				//L
+	int					down;			//M
+	int					step_int;		//M / L ：每输出一个样本，输入位置前进的整数部分
+	int					step_frac;		//M % L ：小数部分（以 1/L 为单位）
+	int					pos;			//当前输出对应的最新输入样本在 work 中的下标
+	int					phase;			//当前相位 0 ~ L-1
+	short*				coef;			//[L][PCM_RESAMPLE_TAPS]，每个相位内按时间正序存放（与输入窗口同向）
+	short				work[PCM_RESAMPLE_MAX_CHANNELS][RS_HISTORY + PCM_RESAMPLE_CHUNK];	//各声道：历史 + 本次输入
+	pcm_resample_stat_t	stat;
+};
+
+
+static int gcd(int a,int b)
+{
+	while(b)
+	{
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*---#第一类零阶修正贝塞尔函数（级数展开），Kaiser 窗用---------------------------*/
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	double half = x / 2.0;
+	int k;
+
+	for(k = 1; k < 32; k++)
+	{
+		term *= (half / k) * (half / k);
+		sum += term;
+		if(term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+/*******************************************************************************
+*@ Description    :生成多相系数表
+*@ Input          :<rs>重采样句柄（up/down 已设置）
+*@ Output         :rs->coef
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :原型滤波器长度 N = L * TAPS，每个相位单独归一化到直流增益 1（Q15 = 32768），
+					保证恒定输入输出恒定，不会出现周期性的纹波
+*******************************************************************************/
+static int build_coef(pcm_resample_t*rs)
+{
+	int L = rs->up;
+	int N = L * PCM_RESAMPLE_TAPS;
+	double fc = 0.5 * RS_CUTOFF / (rs->up > rs->down ? rs->up : rs->down);	//上采样域中的归一化截止频率
+	double center = (N - 1) / 2.0;
+	double i0_beta = bessel_i0(RS_KAISER_BETA);
+	double* h = NULL;
+	int p,j;
+
+	rs->coef = (short*)malloc(N * sizeof(short));
+	h = (double*)malloc(PCM_RESAMPLE_TAPS * sizeof(double));
+	if(NULL == rs->coef || NULL == h)
+	{
+		TS_ERROR_LOG("malloc coef failed! phases(%d)\n",L);
+		free(h);
+		return -1;
+	}
+
+	for(p = 0; p < L; p++)
+	{
+		double sum = 0.0;
+		int isum = 0;
+		int max_idx = 0;
+		short* c = rs->coef + p * PCM_RESAMPLE_TAPS;
+
+		for(j = 0; j < PCM_RESAMPLE_TAPS; j++)
+		{
+			double t = j * L + p - center;
+			double r = t / center;
+			double w = (r <= 1.0 && r >= -1.0) ? bessel_i0(RS_KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+			double s = (t == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+			h[j] = s * w;
+			sum += h[j];
+		}
+
+		/*窗口按时间正序：第 k 个系数对应 x[pos - TAPS + 1 + k]，即原型中的 h[(TAPS-1-k)*L + p]*/
+		for(j = 0; j < PCM_RESAMPLE_TAPS; j++)
+		{
+			double v = h[PCM_RESAMPLE_TAPS - 1 - j] / sum * (1 << RS_Q);
+			int iv = (int)(v >= 0 ? v + 0.5 : v - 0.5);
+			if(iv > 32767) iv = 32767;
+			if(iv < -32768) iv = -32768;
+			c[j] = (short)iv;
+			isum += iv;
+			if(abs(iv) > abs(c[max_idx]))
+				max_idx = j;
+		}
+
+		/*量化误差补到最大的系数上，直流增益严格为 1*/
+		isum = c[max_idx] + (1 << RS_Q) - isum;
+		c[max_idx] = (short)(isum > 32767 ? 32767 : isum);
+	}
+
+	free(h);
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :创建重采样句柄
+*@ Input          :<in_rate>输入采样率
+					<out_rate>输出采样率
+					<channels>声道数（1 ~ PCM_RESAMPLE_MAX_CHANNELS）
+*@ Output         :
+*@ Return         :成功：句柄 ； 失败：NULL
+*@ attention      :比例约分后 L 超过 PCM_RESAMPLE_MAX_PHASES 时失败（如 44100 -> 44101 这种比例）
+*******************************************************************************/
+pcm_resample_t* pcm_resample_create(int in_rate,int out_rate,int channels)
+{
+	pcm_resample_t* rs = NULL;
+	int g;
+
+	if(in_rate <= 0 || out_rate <= 0 || channels <= 0 || channels > PCM_RESAMPLE_MAX_CHANNELS)
+	{
+		TS_ERROR_LOG("param illegal! in_rate(%d) out_rate(%d) channels(%d)\n",in_rate,out_rate,channels);
+		return NULL;
+	}
+
+	g = gcd(in_rate,out_rate);
+	if(out_rate / g > PCM_RESAMPLE_MAX_PHASES)
+	{
+		TS_ERROR_LOG("ratio %d/%d too complex! phases(%d)\n",out_rate,in_rate,out_rate / g);
+		return NULL;
+	}
+
+	rs = (pcm_resample_t*)calloc(1,sizeof(pcm_resample_t));
+	if(NULL == rs)
+	{
+		TS_ERROR_LOG("calloc failed!\n");
+		return NULL;
+	}
+
+	rs->in_rate = in_rate;
+	rs->out_rate = out_rate;
+	rs->channels = channels;
+	rs->up = out_rate / g;
+	rs->down = in_rate / g;
+	rs->step_int = rs->down / rs->up;
+	rs->step_frac = rs->down % rs->up;
+
+	if(build_coef(rs) < 0)
+	{
+		free(rs);
+		return NULL;
+	}
+
+	rs->stat.in_rate = in_rate;
+	rs->stat.out_rate = out_rate;
+	rs->stat.up = rs->up;
+	rs->stat.down = rs->down;
+	pcm_resample_reset(rs);
+
+	return rs;
+}
+
+/*******************************************************************************
+*@ Description    :输入 in_samples 个样本（每声道）时最多可能输出的样本数（每声道）
+*@ Input          :
+*@ Output         :
+*@ Return         :样本数
+*@ attention      :用于调用者分配输出 buf
+*******************************************************************************/
+int pcm_resample_max_output(pcm_resample_t*rs,int in_samples)
+{
+	if(NULL == rs)
+		return 0;
+	return (int)(((long long)in_samples * rs->up + rs->down - 1) / rs->down) + 1;
+}
+
+void pcm_resample_reset(pcm_resample_t*rs)
+{
+	if(NULL == rs)
+		return;
+	memset(rs->work,0,sizeof(rs->work));
+	rs->pos = RS_HISTORY;
+	rs->phase = 0;
+}
+
+/*---#一个输出点的乘累加------------------------------------------------------*/
+/*ARMv5TE 及以上：系数两个一组按 32bit 读取，用 SMLABB/SMLABT（16x16+32 单周期乘累加）
+  样本用 LDRSH 逐个读取，窗口起点可以是奇数地址，不要求对齐*/
+#if defined(__ARM_ARCH_5TE__) || defined(__ARM_ARCH_5TEJ__) || defined(__ARM_ARCH_6__) \
+	|| defined(__ARM_ARCH_6J__) || defined(__ARM_ARCH_6K__) || defined(__ARM_ARCH_6Z__) \
+	|| defined(__ARM_ARCH_6ZK__) || defined(__ARM_ARCH_7A__)
+static inline int dot_product(const short*x,const short*c)
+{
+	const int* c2 = (const int*)c;
+	int acc = 1 << (RS_Q - 1);		//四舍五入
+	int k;
+
+	for(k = 0; k < PCM_RESAMPLE_TAPS; k += 4)
+	{
+		int x0 = x[0],x1 = x[1],x2 = x[2],x3 = x[3];
+		int c01 = c2[0],c23 = c2[1];
+		__asm__ ("smlabb %0, %1, %2, %0" : "+r"(acc) : "r"(x0), "r"(c01));
+		__asm__ ("smlabt %0, %1, %2, %0" : "+r"(acc) : "r"(x1), "r"(c01));
+		__asm__ ("smlabb %0, %1, %2, %0" : "+r"(acc) : "r"(x2), "r"(c23));
+		__asm__ ("smlabt %0, %1, %2, %0" : "+r"(acc) : "r"(x3), "r"(c23));
+		x += 4;
+		c2 += 2;
+	}
+	return acc;
+}
+#else
+static inline int dot_product(const short*x,const short*c)
+{
+	int acc = 1 << (RS_Q - 1);
+	int k;
+
+	for(k = 0; k < PCM_RESAMPLE_TAPS; k += 4)
+	{
+		acc += x[k] * c[k] + x[k + 1] * c[k + 1] + x[k + 2] * c[k + 2] + x[k + 3] * c[k + 3];
+	}
+	return acc;
+}
+#endif
+
+/*******************************************************************************
+*@ Description    :重采样
+*@ Input          :<rs>句柄
+					<in>交织的 16bit PCM
+					<in_samples>输入样本数（每声道）
+					<out_max_samples>输出 buf 能容纳的样本数（每声道）
+*@ Output         :<out>交织的 16bit PCM
+*@ Return         :成功：输出样本数（每声道） ； 失败：-1
+*@ attention      :out 空间不足时返回 -1 且不消耗输入（调用者用 pcm_resample_max_output 分配）
+*******************************************************************************/
+int pcm_resample_process(pcm_resample_t*rs,const short*in,int in_samples,short*out,int out_max_samples)
+{
+	int ch_num;
+	int out_cnt = 0;
+
+	if(NULL == rs || (NULL == in && in_samples > 0) || NULL == out || in_samples < 0)
+	{
+		TS_ERROR_LOG("param illegal!\n");
+		return -1;
+	}
+	if(out_max_samples < pcm_resample_max_output(rs,in_samples))
+	{
+		TS_ERROR_LOG("out buf too small! need(%d) have(%d)\n",pcm_resample_max_output(rs,in_samples),out_max_samples);
+		return -1;
+	}
+
+	ch_num = rs->channels;
+	while(in_samples > 0)
+	{
+		int n = in_samples > PCM_RESAMPLE_CHUNK ? PCM_RESAMPLE_CHUNK : in_samples;
+		int end = RS_HISTORY + n;
+		int i,ch;
+		int pos = 0,phase = 0,cnt = 0;
+
+		/*解交织到各声道的工作区（历史数据之后）*/
+		if(1 == ch_num)
+		{
+			memcpy(&rs->work[0][RS_HISTORY],in,n * sizeof(short));
+		}
+		else
+		{
+			for(i = 0; i < n; i++)
+			{
+				rs->work[0][RS_HISTORY + i] = in[2 * i];
+				rs->work[1][RS_HISTORY + i] = in[2 * i + 1];
+			}
+		}
+
+		for(ch = 0; ch < ch_num; ch++)
+		{
+			const short* w = rs->work[ch];
+			short* op = out + out_cnt * ch_num + ch;
+
+			pos = rs->pos;
+			phase = rs->phase;
+			cnt = 0;
+			while(pos < end)
+			{
+				int acc = dot_product(w + pos - RS_HISTORY,rs->coef + phase * PCM_RESAMPLE_TAPS) >> RS_Q;
+				if(acc > 32767)
+				{
+					acc = 32767;
+					rs->stat.clipped++;
+				}
+				else if(acc < -32768)
+				{
+					acc = -32768;
+					rs->stat.clipped++;
+				}
+				*op = (short)acc;
+				op += ch_num;
+				cnt++;
+
+				pos += rs->step_int;
+				phase += rs->step_frac;
+				if(phase >= rs->up)
+				{
+					phase -= rs->up;
+					pos++;
+				}
+			}
+
+			/*保留最后 RS_HISTORY 个样本作为下一块的历史*/
+			memmove(rs->work[ch],rs->work[ch] + n,RS_HISTORY * sizeof(short));
+		}
+
+		/*每个声道走过的输出点数相同，最后一个声道的 pos/phase 即为新状态*/
+		out_cnt += cnt;
+		rs->pos = pos - n;
+		rs->phase = phase;
+
+		in += n * ch_num;
+		in_samples -= n;
+		rs->stat.in_samples += n;
+	}
+
+	rs->stat.out_samples += out_cnt;
+	return out_cnt;
+}
+
+void pcm_resample_get_stat(pcm_resample_t*rs,pcm_resample_stat_t*stat)
+{
+	if(NULL == rs || NULL == stat)
+		return;
+	memcpy(stat,&rs->stat,sizeof(pcm_resample_stat_t));
+}
+
+void pcm_resample_destroy(pcm_resample_t*rs)
+{
+	if(NULL == rs)
+		return;
+	free(rs->coef);
+	free(rs);
+}
+
@@ -64,3 +64,9 @@ void ts_global_variable_reset(void);
 
 
 
+
+/*---# TS 层打包函数（ts.c 实现，供 ts_live.c 等模块复用）---------------------*/
+void pack_data(char* ts_buf, int* frame_count, int* cc, long long  pts, long long dts,
+					int es_id, int pid, char* data, int frame_size, int pcr_pid);
+int TS_put_pat(char* buf, int* pat_cc);
+int TS_put_pmt(char* buf, ts_media_stats_t* status, int* pmt_cc, int pcr_pid);
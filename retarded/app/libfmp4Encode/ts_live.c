@@ -0,0 +1,543 @@
+
+/***************************************************************************
+* @file: ts_live.c
+* @author:
+* @date:  10,19,2026
+* @brief:  直播 HLS 切片：H264 + AAC 帧到达即打包进当前 TS 分片，
+*			关键帧处按目标时长切片，内存中只保留固定个数的分片（滑动窗口），
+*			每次切片后重新生成 m3u8。
+* @attention:与 ts.c（TS_recoder_xxx）不同，本模块不缓存整段音视频帧再二次混合，
+*			分片缓存在初始化时一次性分配，运行期间内存占用固定。
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ts.h"
+#include "ts_live_interface.h"
+#include "ts_print.h"
+
+#define PID_PMT				0x0100
+#define VIDEO_stream_PID	2		//与 ts.c 保持一致：PID = PID_PMT + n_tracks - track
+#define VIDEO_INDEX			0
+#define AUDIO_INDEX			1
+
+#define TS_PACKET_SIZE		188
+#define ADTS_HEADER_LEN		7
+#define MAX_AUDIO_FRAME_LEN	2048	//单帧 AAC 最大长度（加 ADTS 头前）
+
+#define SEGMENT_SLOT_NUM	(TS_LIVE_MAX_WINDOW + 1 + TS_LIVE_GRACE_SEGMENTS)
+
+typedef enum
+{
+	SLOT_FREE = 0,		//未使用
+	SLOT_WRITING,		//正在写入（不可读）
+	SLOT_READY			//已完成（可读）
+}slot_state_e;
+
+/*---#一个 TS 分片的缓存描述------------------------------------------------------------*/
+typedef struct _ts_live_segment_t
+{
+	slot_state_e	state;
+	unsigned int	seq;			//分片序号（对应 m3u8 的 media sequence）
+	char*			buf;			//分片数据（预分配）
+	int				len;			//已写入的数据长度
+	int				duration_ms;	//分片时长（切片时计算）
+}ts_live_segment_t;
+
+typedef struct _ts_live_ctx_t
+{
+	int					init_done;
+	ts_live_init_t		config;
+	pthread_mutex_t		lock;			//保护 slot 状态与 m3u8，写分片数据本身不加锁
+
+	ts_live_segment_t	slot[SEGMENT_SLOT_NUM];
+	int					slot_num;
+	ts_live_segment_t*	cur;			//当前正在写的分片
+	unsigned int		next_seq;
+	unsigned long long	seg_start_pts;	//当前分片首个关键帧的时间戳（ms）
+	int					wait_idr;		//1：丢弃数据直到下一个关键帧（刚启动或分片缓存溢出）
+	int					max_duration_ms;//出现过的最大分片时长，用于 EXT-X-TARGETDURATION
+
+	ts_media_stats_t	stats;			//只用到 codec 字段，生成 PMT
+	int					pat_cc;
+	int					pmt_cc;
+	int					cc[2];			//音视频各自的 continuity counter，跨分片连续
+
+	char				adts_frame[ADTS_HEADER_LEN + MAX_AUDIO_FRAME_LEN];
+	char				m3u8[TS_LIVE_M3U8_BUF_SIZE];
+	int					m3u8_len;
+
+	unsigned int		drop_frames;	//因分片缓存不足丢弃的帧数
+}ts_live_ctx_t;
+
+static ts_live_ctx_t live_ctx = {0};
+
+
+/*******************************************************************************
+*@ Description    :计算一帧数据打包成 TS 后最多需要的字节数
+*@ attention      :首包：4字节TS头 + 8字节自适应域(PCR) + 最多19字节PES头，
+					后续每包至少 184 字节负载，多留一包余量
+*******************************************************************************/
+static int ts_live_packed_size(int frame_len)
+{
+	return (frame_len / 184 + 3) * TS_PACKET_SIZE;
+}
+
+static void ts_live_segment_path(char*path,int path_size,unsigned int seq)
+{
+	snprintf(path,path_size,"%s/%s_%u.ts",live_ctx.config.out_dir,live_ctx.config.name_prefix,seq);
+}
+
+/*******************************************************************************
+*@ Description    :把分片/m3u8写到输出目录（m3u8 先写临时文件再 rename，保证读者看到的总是完整文件）
+*@ Return         :成功：0 失败：-1
+*******************************************************************************/
+static int ts_live_write_file(const char*path,const char*data,int len,int atomic)
+{
+	char tmp_path[128] = {0};
+	const char* w_path = path;
+	FILE* fp = NULL;
+
+	if(atomic)
+	{
+		snprintf(tmp_path,sizeof(tmp_path),"%s.tmp",path);
+		w_path = tmp_path;
+	}
+
+	fp = fopen(w_path,"wb");
+	if(NULL == fp)
+	{
+		TS_ERROR_LOG("fopen %s failed!\n",w_path);
+		return -1;
+	}
+	if(fwrite(data,1,len,fp) != (size_t)len)
+	{
+		TS_ERROR_LOG("fwrite %s failed!\n",w_path);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	if(atomic && rename(tmp_path,path) < 0)
+	{
+		TS_ERROR_LOG("rename %s failed!\n",tmp_path);
+		return -1;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :按分片序号从小到大生成 m3u8（只取最新的 window_size 个已完成分片）
+*@ attention      :调用者需持有 live_ctx.lock
+*******************************************************************************/
+static void ts_live_build_playlist(void)
+{
+	ts_live_segment_t*	list[SEGMENT_SLOT_NUM];
+	int 				n = 0;
+	int 				i,j;
+	int 				ci = 0;
+	int 				out_size = sizeof(live_ctx.m3u8);
+	char*				out = live_ctx.m3u8;
+	int 				target = live_ctx.config.target_duration;
+
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		if(live_ctx.slot[i].state != SLOT_READY)
+			continue;
+		//插入排序（最多十来个元素）
+		for(j = n ; j > 0 && list[j-1]->seq > live_ctx.slot[i].seq ; j--)
+			list[j] = list[j-1];
+		list[j] = &live_ctx.slot[i];
+		n++;
+	}
+
+	i = 0;
+	if(n > live_ctx.config.window_size)
+		i = n - live_ctx.config.window_size;
+
+	if((live_ctx.max_duration_ms + 999)/1000 > target)
+		target = (live_ctx.max_duration_ms + 999)/1000;
+
+	ci += snprintf(out + ci, out_size - ci, "#EXTM3U\n");
+	ci += snprintf(out + ci, out_size - ci, "#EXT-X-VERSION:3\n");
+	ci += snprintf(out + ci, out_size - ci, "#EXT-X-TARGETDURATION:%d\n",target);
+	ci += snprintf(out + ci, out_size - ci, "#EXT-X-MEDIA-SEQUENCE:%u\n",n > 0 ? list[i]->seq : 0);
+	for( ; i < n && ci < out_size ; i++)
+	{
+		ci += snprintf(out + ci, out_size - ci, "#EXTINF:%d.%03d,\n",list[i]->duration_ms/1000,list[i]->duration_ms%1000);
+		ci += snprintf(out + ci, out_size - ci, "%s_%u.ts\n",live_ctx.config.name_prefix,list[i]->seq);
+	}
+
+	if(ci >= out_size)
+	{
+		TS_ERROR_LOG("m3u8 buf overflow!\n");
+		ci = out_size - 1;
+	}
+	live_ctx.m3u8_len = ci;
+}
+
+/*******************************************************************************
+*@ Description    :开始一个新分片：优先使用空闲 slot，否则回收序号最小的已完成分片
+*@ Return         :成功：0 失败：-1
+*******************************************************************************/
+static int ts_live_open_segment(unsigned long long pts_msec)
+{
+	ts_live_segment_t* seg = NULL;
+	unsigned int old_seq = 0;
+	int recycle = 0;
+	int i;
+
+	pthread_mutex_lock(&live_ctx.lock);
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		if(live_ctx.slot[i].state == SLOT_FREE)
+		{
+			seg = &live_ctx.slot[i];
+			break;
+		}
+		if(live_ctx.slot[i].state == SLOT_READY && (NULL == seg || live_ctx.slot[i].seq < seg->seq))
+			seg = &live_ctx.slot[i];
+	}
+	if(NULL == seg)
+	{
+		pthread_mutex_unlock(&live_ctx.lock);
+		TS_ERROR_LOG("no segment slot available!\n");
+		return -1;
+	}
+	if(seg->state == SLOT_READY)
+	{
+		recycle = 1;
+		old_seq = seg->seq;
+	}
+	seg->state = SLOT_WRITING;
+	seg->seq = live_ctx.next_seq++;
+	seg->len = 0;
+	seg->duration_ms = 0;
+	pthread_mutex_unlock(&live_ctx.lock);
+
+	if(recycle && live_ctx.config.out_dir[0])
+	{
+		char path[128] = {0};
+		ts_live_segment_path(path,sizeof(path),old_seq);
+		unlink(path);
+	}
+
+	live_ctx.cur = seg;
+	live_ctx.seg_start_pts = pts_msec;
+
+	/*---#每个分片都以 PAT + PMT 开头，保证可以单独解码----------------------------*/
+	seg->len += TS_put_pat(seg->buf + seg->len,&live_ctx.pat_cc);
+	seg->len += TS_put_pmt(seg->buf + seg->len,&live_ctx.stats,&live_ctx.pmt_cc,VIDEO_stream_PID);
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :结束当前分片，加入滑动窗口并重新生成 m3u8
+*@ Input          :<end_pts_msec>下一个分片的起始时间戳（即本分片结束时间）
+*******************************************************************************/
+static void ts_live_close_segment(unsigned long long end_pts_msec)
+{
+	ts_live_segment_t* seg = live_ctx.cur;
+	if(NULL == seg)
+		return;
+
+	seg->duration_ms = (int)(end_pts_msec - live_ctx.seg_start_pts);
+	if(seg->duration_ms <= 0) //时间戳异常时按目标时长处理
+		seg->duration_ms = live_ctx.config.target_duration * 1000;
+	if(seg->duration_ms > live_ctx.max_duration_ms)
+		live_ctx.max_duration_ms = seg->duration_ms;
+
+	if(live_ctx.config.out_dir[0])
+	{
+		char path[128] = {0};
+		ts_live_segment_path(path,sizeof(path),seg->seq);
+		ts_live_write_file(path,seg->buf,seg->len,0);
+	}
+
+	pthread_mutex_lock(&live_ctx.lock);
+	seg->state = SLOT_READY;
+	ts_live_build_playlist();
+	if(live_ctx.config.out_dir[0])
+	{
+		char path[128] = {0};
+		snprintf(path,sizeof(path),"%s/%s.m3u8",live_ctx.config.out_dir,live_ctx.config.name_prefix);
+		ts_live_write_file(path,live_ctx.m3u8,live_ctx.m3u8_len,1);
+	}
+	pthread_mutex_unlock(&live_ctx.lock);
+
+	TS_DEBUG_LOG("segment %u closed, len(%d) duration(%d ms)\n",seg->seq,seg->len,seg->duration_ms);
+	live_ctx.cur = NULL;
+}
+
+/*******************************************************************************
+*@ Description    :把一帧数据打包写入当前分片
+*@ Return         :成功：0  分片空间不足：-1
+*******************************************************************************/
+static int ts_live_put_frame(int track,char*data,int len,unsigned long long pts_msec)
+{
+	ts_live_segment_t* seg = live_ctx.cur;
+	int fc = 0;
+	long long pts = (long long)pts_msec * 90;	//ms --> 90KHz
+
+	if(seg->len + ts_live_packed_size(len) > live_ctx.config.segment_buf_size)
+		return -1;
+
+	pack_data(seg->buf + seg->len, &fc, &live_ctx.cc[track], pts, pts,
+				track == VIDEO_INDEX ? 0xE0 : 0xC0, PID_PMT + live_ctx.stats.n_tracks - track,
+				data, len, track == VIDEO_INDEX ? 1 : 0);
+	seg->len += fc * TS_PACKET_SIZE;
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :直播切片初始化函数
+*@ Input          :<config>切片配置
+*@ Output         :
+*@ Return         :成功：0 失败：-1
+*@ attention      :分片缓存在此一次性分配
+*******************************************************************************/
+int TS_live_init(ts_live_init_t *config)
+{
+	int i;
+
+	if(NULL == config || config->target_duration <= 0 || config->segment_buf_size < TS_PACKET_SIZE * 4 ||
+	   config->window_size <= 0 || config->window_size > TS_LIVE_MAX_WINDOW)
+	{
+		TS_ERROR_LOG("Illegal parameter!\n");
+		return -1;
+	}
+	if(live_ctx.init_done)
+	{
+		TS_ERROR_LOG("TS live already init!\n");
+		return -1;
+	}
+
+	memset(&live_ctx,0,sizeof(live_ctx));
+	memcpy(&live_ctx.config,config,sizeof(ts_live_init_t));
+	if(0 == live_ctx.config.name_prefix[0])
+		strcpy(live_ctx.config.name_prefix,"live");
+
+	live_ctx.slot_num = config->window_size + 1 + TS_LIVE_GRACE_SEGMENTS;
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		live_ctx.slot[i].buf = (char*)malloc(config->segment_buf_size);
+		if(NULL == live_ctx.slot[i].buf)
+		{
+			TS_ERROR_LOG("malloc segment buf failed! size(%d)\n",config->segment_buf_size);
+			goto ERR;
+		}
+		live_ctx.slot[i].state = SLOT_FREE;
+	}
+
+	live_ctx.stats.n_tracks = 2;
+	live_ctx.stats.track[VIDEO_INDEX].codec = H264_VIDEO;
+	live_ctx.stats.track[AUDIO_INDEX].codec = AAC_AUDIO;
+	live_ctx.wait_idr = 1;
+	live_ctx.cur = NULL;
+
+	pthread_mutex_init(&live_ctx.lock,NULL);
+	pthread_mutex_lock(&live_ctx.lock);
+	ts_live_build_playlist(); //空列表，避免启动阶段读到空数据
+	pthread_mutex_unlock(&live_ctx.lock);
+	live_ctx.init_done = 1;
+	return 0;
+
+ERR:
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		if(live_ctx.slot[i].buf) free(live_ctx.slot[i].buf);
+	}
+	memset(&live_ctx,0,sizeof(live_ctx));
+	return -1;
+}
+
+/*******************************************************************************
+*@ Description    :放入一帧 H264 视频帧（带起始码，关键帧包含 SPS/PPS）
+*@ Input          :<is_key_frame>1:关键帧 0：非关键帧
+					<pts_msec>毫秒时间戳
+*@ Return         :成功：0 ；失败：-1
+*@ attention      :关键帧到达且当前分片时长已达到目标时长时切片
+*******************************************************************************/
+int TS_live_put_video(void*frame,int frame_len,int is_key_frame,unsigned long long pts_msec)
+{
+	if(!live_ctx.init_done || NULL == frame || frame_len <= 0)
+		return -1;
+
+	if(is_key_frame)
+	{
+		if(live_ctx.cur && (live_ctx.wait_idr ||
+		   pts_msec - live_ctx.seg_start_pts >= (unsigned long long)live_ctx.config.target_duration * 1000))
+		{
+			ts_live_close_segment(pts_msec);
+		}
+		if(NULL == live_ctx.cur)
+		{
+			if(ts_live_open_segment(pts_msec) < 0)
+				return -1;
+		}
+		live_ctx.wait_idr = 0;
+	}
+	else if(live_ctx.wait_idr || NULL == live_ctx.cur)
+	{
+		live_ctx.drop_frames++;
+		return 0;
+	}
+
+	if(ts_live_put_frame(VIDEO_INDEX,(char*)frame,frame_len,pts_msec) < 0)
+	{
+		//分片缓存不够：丢到下一个关键帧，并在那里提前切片
+		TS_ERROR_LOG("segment %u buf full(%d), drop to next IDR!\n",live_ctx.cur->seq,live_ctx.cur->len);
+		live_ctx.wait_idr = 1;
+		live_ctx.drop_frames++;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :放入一帧 AAC 音频帧（不带 ADTS 头）
+*@ Return         :成功：0 ；失败：-1
+*******************************************************************************/
+int TS_live_put_audio(void*frame,int frame_len,unsigned long long pts_msec)
+{
+	ts_audio_init_t* ac = &live_ctx.config.audio_config;
+	unsigned char* h = (unsigned char*)live_ctx.adts_frame;
+	int len = frame_len + ADTS_HEADER_LEN;
+
+	if(!live_ctx.init_done || NULL == frame || frame_len <= 0)
+		return -1;
+	if(live_ctx.wait_idr || NULL == live_ctx.cur) //分片从视频关键帧开始，之前的音频丢弃
+		return 0;
+	if(frame_len > MAX_AUDIO_FRAME_LEN)
+	{
+		TS_ERROR_LOG("audio frame too large(%d)!\n",frame_len);
+		return -1;
+	}
+
+	/*---#ADTS 头（无CRC，7字节）------------------------------------------------------------*/
+	h[0] = 0xFF;
+	h[1] = 0xF0 | ((ac->ID & 0x01) << 3) | 0x01;
+	h[2] = ((ac->profile & 0x03) << 6) | ((ac->sampling_frequency_index & 0x0F) << 2) | ((ac->n_ch >> 2) & 0x01);
+	h[3] = ((ac->n_ch & 0x03) << 6) | ((len >> 11) & 0x03);
+	h[4] = (len >> 3) & 0xFF;
+	h[5] = ((len & 0x07) << 5) | 0x1F;
+	h[6] = 0xFC;
+	memcpy(live_ctx.adts_frame + ADTS_HEADER_LEN,frame,frame_len);
+
+	if(ts_live_put_frame(AUDIO_INDEX,live_ctx.adts_frame,len,pts_msec) < 0)
+		live_ctx.drop_frames++;
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :获取当前 m3u8 内容
+*@ Output         :<out_buf>m3u8 文本（以'\0'结尾）
+*@ Return         :成功：m3u8 长度 ；失败：-1
+*******************************************************************************/
+int TS_live_get_playlist(char*out_buf,int out_buf_size)
+{
+	int len;
+
+	if(!live_ctx.init_done || NULL == out_buf)
+		return -1;
+
+	pthread_mutex_lock(&live_ctx.lock);
+	len = live_ctx.m3u8_len;
+	if(len >= out_buf_size)
+	{
+		pthread_mutex_unlock(&live_ctx.lock);
+		return -1;
+	}
+	memcpy(out_buf,live_ctx.m3u8,len);
+	out_buf[len] = '\0';
+	pthread_mutex_unlock(&live_ctx.lock);
+	return len;
+}
+
+/*******************************************************************************
+*@ Description    :获取已完成分片的大小
+*@ Return         :成功：分片大小 ；分片不存在（未完成或已被回收）：-1
+*******************************************************************************/
+int TS_live_get_segment_size(unsigned int seq)
+{
+	int i;
+	int len = -1;
+
+	if(!live_ctx.init_done)
+		return -1;
+
+	pthread_mutex_lock(&live_ctx.lock);
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		if(live_ctx.slot[i].state == SLOT_READY && live_ctx.slot[i].seq == seq)
+		{
+			len = live_ctx.slot[i].len;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&live_ctx.lock);
+	return len;
+}
+
+/*******************************************************************************
+*@ Description    :读取已完成分片的一段数据（HTTP 服务按块发送，无需额外缓存整个分片）
+*@ Input          :<seq>分片序号
+					<read_size>最多读取的长度
+					<offset>相对分片开始位置的偏移
+*@ Output         :<out_buf>
+*@ Return         :成功：实际读取的长度（0 表示已读完） ；分片不存在：-1
+*******************************************************************************/
+int TS_live_read_segment(unsigned int seq,char*out_buf,int read_size,int offset)
+{
+	int i;
+	int ret = -1;
+
+	if(!live_ctx.init_done || NULL == out_buf || read_size < 0 || offset < 0)
+		return -1;
+
+	pthread_mutex_lock(&live_ctx.lock);
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		ts_live_segment_t* seg = &live_ctx.slot[i];
+		if(seg->state == SLOT_READY && seg->seq == seq)
+		{
+			ret = 0;
+			if(offset < seg->len)
+			{
+				ret = seg->len - offset;
+				if(ret > read_size)
+					ret = read_size;
+				memcpy(out_buf,seg->buf + offset,ret);
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&live_ctx.lock);
+	return ret;
+}
+
+/*******************************************************************************
+*@ Description    :直播切片退出，释放所有分片缓存
+*******************************************************************************/
+void TS_live_exit(void)
+{
+	int i;
+
+	if(!live_ctx.init_done)
+		return;
+
+	pthread_mutex_lock(&live_ctx.lock);
+	live_ctx.init_done = 0;
+	pthread_mutex_unlock(&live_ctx.lock);
+
+	TS_DEBUG_LOG("TS live exit, drop_frames(%u)\n",live_ctx.drop_frames);
+	for(i = 0 ; i < live_ctx.slot_num ; i++)
+	{
+		if(live_ctx.slot[i].buf) free(live_ctx.slot[i].buf);
+	}
+	pthread_mutex_destroy(&live_ctx.lock);
+	memset(&live_ctx,0,sizeof(live_ctx));
+}
+
@@ -0,0 +1,1106 @@
+/***************************************************************************
+* @file: json_stream.c
+* @author:
+* @date:  10,19,2026
+* @brief:  不分配内存的 JSON 读写（接口说明见 json_stream.h）
+* @attention:
+	1.读取器是一个按需取词的状态机，每个词在 json_next 里就完成语法检查（字符串转义、数字格式、
+	  逗号冒号、括号配对、层数），出错后一直返回 JSON_TOK_ERROR，rd->p 停在出错的位置。
+	2.数字转 int、生成器输出整数都不使用浮点（ARM926 没有 FPU），只有 cJSON 兼容层
+	  为了与 cJSON 的数值一致才用 strtod / sprintf("%f")。
+	3.主机上与 cJSON 对比的单元测试、模糊测试和性能测试见 test/test_json_stream.c
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+
+#include "json_stream.h"
+
+/*读取器状态*/
+#define JS_VALUE			0		//等待一个值
+#define JS_VALUE_FIRST		1		//'[' 之后：值或 ']'
+#define JS_KEY				2		//',' 之后：键
+#define JS_KEY_FIRST		3		//'{' 之后：键或 '}'
+#define JS_NEXT				4		//值之后：',' 或结束符号
+#define JS_DONE				5
+#define JS_ERROR			6
+
+#define JS_IN_ARRAY(rd)		(((rd)->arr_mask >> ((rd)->depth - 1)) & 1)
+#define JS_IS_DIGIT(c)		((c) >= '0' && (c) <= '9')
+
+
+static const char *json_skip_ws(const char *p, const char *end)
+{
+	while (p < end && (' ' == *p || '\t' == *p || '\n' == *p || '\r' == *p))
+		p++;
+	return p;
+}
+
+/*4 位十六进制，失败返回 -1*/
+static int json_hex4(const char *p)
+{
+	int i, v = 0;
+
+	for (i = 0; i < 4; i++)
+	{
+		char c = p[i];
+		v <<= 4;
+		if (c >= '0' && c <= '9')
+			v |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			v |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			v |= c - 'A' + 10;
+		else
+			return -1;
+	}
+	return v;
+}
+
+static int json_fail(json_reader_t *rd, json_token_t *tok)
+{
+	rd->state = JS_ERROR;
+	tok->type = JSON_TOK_ERROR;
+	tok->str = NULL;
+	tok->len = 0;
+	return JSON_TOK_ERROR;
+}
+
+/*
+	功能：扫描字符串（rd->p 指向左引号），检查转义
+	参数：
+	返回：成功 0，rd->p 移到右引号之后；失败 -1
+	注意：不转义，tok 指向原文
+*/
+static int json_scan_string(json_reader_t *rd, json_token_t *tok)
+{
+	const char *p = rd->p + 1;
+	const char *end = rd->end;
+
+	tok->str = p;
+	while (p < end)
+	{
+		unsigned char c = (unsigned char)*p;
+		if ('"' == c)
+		{
+			tok->len = p - tok->str;
+			rd->p = p + 1;
+			return 0;
+		}
+		if (c < 0x20)
+			return -1;
+		if ('\\' == c)
+		{
+			if (++p >= end)
+				return -1;
+			switch (*p)
+			{
+				case '"': case '\\': case '/':
+				case 'b': case 'f': case 'n': case 'r': case 't':
+					break;
+				case 'u':
+					if (end - p < 5 || json_hex4(p + 1) < 0)
+						return -1;
+					p += 4;
+					break;
+				default:
+					return -1;
+			}
+		}
+		p++;
+	}
+
+	rd->p = p;
+	return -1;
+}
+
+/*扫描数字，格式按 RFC 8259*/
+static int json_scan_number(json_reader_t *rd, json_token_t *tok)
+{
+	const char *p = rd->p;
+	const char *end = rd->end;
+
+	tok->str = p;
+	if ('-' == *p)
+		p++;
+	if (p >= end || !JS_IS_DIGIT(*p))
+		goto fail;
+	if ('0' == *p)
+		p++;
+	else
+		while (p < end && JS_IS_DIGIT(*p))
+			p++;
+
+	if (p < end && '.' == *p)
+	{
+		p++;
+		if (p >= end || !JS_IS_DIGIT(*p))
+			goto fail;
+		while (p < end && JS_IS_DIGIT(*p))
+			p++;
+	}
+	if (p < end && ('e' == *p || 'E' == *p))
+	{
+		p++;
+		if (p < end && ('+' == *p || '-' == *p))
+			p++;
+		if (p >= end || !JS_IS_DIGIT(*p))
+			goto fail;
+		while (p < end && JS_IS_DIGIT(*p))
+			p++;
+	}
+
+	tok->len = p - tok->str;
+	rd->p = p;
+	return 0;
+
+fail:
+	rd->p = p;
+	return -1;
+}
+
+static int json_literal(json_reader_t *rd, json_token_t *tok, const char *word, int len, int type)
+{
+	if (rd->end - rd->p < len || memcmp(rd->p, word, len))
+		return json_fail(rd, tok);
+
+	tok->str = rd->p;
+	tok->len = len;
+	tok->type = type;
+	rd->p += len;
+	rd->state = JS_NEXT;
+	return type;
+}
+
+/*对象/数组结束*/
+static int json_close(json_reader_t *rd, json_token_t *tok, int type)
+{
+	rd->depth--;
+	rd->p++;
+	rd->state = JS_NEXT;
+	tok->depth = rd->depth;
+	tok->type = type;
+	return type;
+}
+
+static int json_value(json_reader_t *rd, json_token_t *tok, int c)
+{
+	switch (c)
+	{
+		case '{':
+		case '[':
+			if (rd->depth >= JSON_DEPTH_MAX)
+				return json_fail(rd, tok);
+			if ('[' == c)
+				rd->arr_mask |= 1u << rd->depth;
+			else
+				rd->arr_mask &= ~(1u << rd->depth);
+			rd->depth++;
+			rd->p++;
+			rd->state = ('{' == c) ? JS_KEY_FIRST : JS_VALUE_FIRST;
+			tok->type = ('{' == c) ? JSON_TOK_OBJ_BEGIN : JSON_TOK_ARR_BEGIN;
+			return tok->type;
+
+		case '"':
+			if (json_scan_string(rd, tok) < 0)
+				return json_fail(rd, tok);
+			rd->state = JS_NEXT;
+			tok->type = JSON_TOK_STRING;
+			return JSON_TOK_STRING;
+
+		case 't':
+			return json_literal(rd, tok, "true", 4, JSON_TOK_TRUE);
+		case 'f':
+			return json_literal(rd, tok, "false", 5, JSON_TOK_FALSE);
+		case 'n':
+			return json_literal(rd, tok, "null", 4, JSON_TOK_NULL);
+
+		default:
+			if (('-' == c || JS_IS_DIGIT(c)) && 0 == json_scan_number(rd, tok))
+			{
+				rd->state = JS_NEXT;
+				tok->type = JSON_TOK_NUMBER;
+				return JSON_TOK_NUMBER;
+			}
+			return json_fail(rd, tok);
+	}
+}
+
+void json_reader_init(json_reader_t *rd, const char *text, int len)
+{
+	if (NULL == text)
+		text = "";
+	if (len < 0)
+		len = strlen(text);
+
+	rd->start = text;
+	rd->p = text;
+	rd->end = text + len;
+	rd->arr_mask = 0;
+	rd->depth = 0;
+	rd->state = JS_VALUE;
+}
+
+/*
+	功能：取下一个词
+	参数：
+	返回：json_tok_e
+	注意：顶层值之后只允许空白（或 '\0'），其他字符按格式错误处理
+*/
+int json_next(json_reader_t *rd, json_token_t *tok)
+{
+	int c;
+
+	for (;;)
+	{
+		rd->p = json_skip_ws(rd->p, rd->end);
+		c = (rd->p < rd->end) ? (unsigned char)*rd->p : 0;
+		tok->depth = rd->depth;
+		tok->str = NULL;
+		tok->len = 0;
+
+		switch (rd->state)
+		{
+			case JS_DONE:
+				tok->type = JSON_TOK_END;
+				return JSON_TOK_END;
+
+			case JS_NEXT:
+				if (0 == rd->depth)
+				{
+					if (c != 0)
+						return json_fail(rd, tok);
+					rd->state = JS_DONE;
+					tok->type = JSON_TOK_END;
+					return JSON_TOK_END;
+				}
+				if (',' == c)
+				{
+					rd->p++;
+					rd->state = JS_IN_ARRAY(rd) ? JS_VALUE : JS_KEY;
+					continue;
+				}
+				if ('}' == c && !JS_IN_ARRAY(rd))
+					return json_close(rd, tok, JSON_TOK_OBJ_END);
+				if (']' == c && JS_IN_ARRAY(rd))
+					return json_close(rd, tok, JSON_TOK_ARR_END);
+				return json_fail(rd, tok);
+
+			case JS_KEY_FIRST:
+				if ('}' == c)
+					return json_close(rd, tok, JSON_TOK_OBJ_END);
+				/* fall through */
+			case JS_KEY:
+				if (c != '"' || json_scan_string(rd, tok) < 0)
+					return json_fail(rd, tok);
+				rd->p = json_skip_ws(rd->p, rd->end);
+				if (rd->p >= rd->end || *rd->p != ':')
+					return json_fail(rd, tok);
+				rd->p++;
+				rd->state = JS_VALUE;
+				tok->type = JSON_TOK_KEY;
+				return JSON_TOK_KEY;
+
+			case JS_VALUE_FIRST:
+				if (']' == c)
+					return json_close(rd, tok, JSON_TOK_ARR_END);
+				/* fall through */
+			case JS_VALUE:
+				return json_value(rd, tok, c);
+
+			default:
+				return json_fail(rd, tok);
+		}
+	}
+}
+
+/*跳过已经取到开始符号的对象/数组的剩余部分*/
+static int json_skip_open(json_reader_t *rd, int depth)
+{
+	json_token_t tok;
+	int t;
+
+	for (;;)
+	{
+		t = json_next(rd, &tok);
+		if (t <= JSON_TOK_END)
+			return -1;
+		if ((JSON_TOK_OBJ_END == t || JSON_TOK_ARR_END == t) && tok.depth == depth)
+			return 0;
+	}
+}
+
+int json_skip(json_reader_t *rd)
+{
+	json_token_t tok;
+	int t = json_next(rd, &tok);
+
+	if (JSON_TOK_OBJ_BEGIN == t || JSON_TOK_ARR_BEGIN == t)
+		return json_skip_open(rd, tok.depth);
+	if (t >= JSON_TOK_STRING)
+		return 0;
+	return -1;
+}
+
+int json_reader_pos(const json_reader_t *rd)
+{
+	return rd->p - rd->start;
+}
+
+/*
+	功能：数字词转 int
+	参数：
+	返回：成功 0
+	注意：只保留 19 位有效数字，超出 int 范围时饱和，小数部分截去（与 (int) 强制转换一致）
+*/
+int json_tok_int(const json_token_t *tok, int *val)
+{
+	const char *p = tok->str;
+	const char *end = tok->str + tok->len;
+	HLE_U64 m = 0;
+	int neg = 0, digits = 0, frac = 0, exp = 0, eneg = 0, dropped = 0;
+
+	if (NULL == p || tok->len <= 0)
+		return -1;
+	if ('-' == *p)
+	{
+		neg = 1;
+		p++;
+	}
+
+	/*有效数字放进 m，小数位数记在 frac*/
+	for (; p < end && JS_IS_DIGIT(*p); p++)
+	{
+		if (digits < 19)
+		{
+			m = m * 10 + (*p - '0');
+			if (m)
+				digits++;
+		}
+		else
+		{
+			dropped++;		//超出 19 位的整数位只计入指数
+		}
+	}
+	if (p < end && '.' == *p)
+	{
+		for (p++; p < end && JS_IS_DIGIT(*p); p++)
+		{
+			if (digits < 19)
+			{
+				m = m * 10 + (*p - '0');
+				if (m)
+					digits++;
+				frac++;
+			}
+		}
+	}
+	if (p < end && ('e' == *p || 'E' == *p))
+	{
+		p++;
+		if (p < end && ('+' == *p || '-' == *p))
+			eneg = ('-' == *p++);
+		for (; p < end && JS_IS_DIGIT(*p); p++)
+			if (exp < 10000)
+				exp = exp * 10 + (*p - '0');
+	}
+	if (p != end)
+		return -1;
+
+	exp = (eneg ? -exp : exp) - frac + dropped;
+	while (exp > 0 && m && m <= (HLE_U64)INT_MAX + 1)
+	{
+		m *= 10;
+		exp--;
+	}
+	while (exp < 0 && m)
+	{
+		m /= 10;
+		exp++;
+	}
+
+	if (neg)
+		*val = (m > (HLE_U64)INT_MAX + 1) ? INT_MIN : (int)(0 - m);
+	else
+		*val = (m > (HLE_U64)INT_MAX) ? INT_MAX : (int)m;
+	return 0;
+}
+
+/*码点写成 UTF-8，空间不够返回 -1*/
+static int json_put_utf8(char *dst, int n, int size, HLE_U32 cp)
+{
+	if (cp < 0x80)
+	{
+		if (n + 1 >= size)
+			return -1;
+		dst[n++] = (char)cp;
+	}
+	else if (cp < 0x800)
+	{
+		if (n + 2 >= size)
+			return -1;
+		dst[n++] = (char)(0xC0 | (cp >> 6));
+		dst[n++] = (char)(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000)
+	{
+		if (n + 3 >= size)
+			return -1;
+		dst[n++] = (char)(0xE0 | (cp >> 12));
+		dst[n++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		dst[n++] = (char)(0x80 | (cp & 0x3F));
+	}
+	else
+	{
+		if (n + 4 >= size)
+			return -1;
+		dst[n++] = (char)(0xF0 | (cp >> 18));
+		dst[n++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		dst[n++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		dst[n++] = (char)(0x80 | (cp & 0x3F));
+	}
+	return n;
+}
+
+int json_tok_string(const json_token_t *tok, char *dst, int size)
+{
+	const char *s = tok->str;
+	const char *e = tok->str + tok->len;
+	int n = 0, cp, lo;
+
+	if (NULL == dst || size <= 0 || (NULL == s && tok->len))
+		return -1;
+
+	/*没有转义时直接拷贝*/
+	if (tok->len == 0 || NULL == memchr(s, '\\', tok->len))
+	{
+		if (tok->len >= size)
+			goto fail;
+		memcpy(dst, s, tok->len);
+		dst[tok->len] = '\0';
+		return tok->len;
+	}
+
+	while (s < e)
+	{
+		char c = *s++;
+		if (c != '\\')
+		{
+			if (n + 1 >= size)
+				goto fail;
+			dst[n++] = c;
+			continue;
+		}
+		if (s >= e)
+			goto fail;
+
+		switch (c = *s++)
+		{
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case '"': case '\\': case '/': break;
+			case 'u':
+				if (e - s < 4 || (cp = json_hex4(s)) < 0)
+					goto fail;
+				s += 4;
+				/*与 cJSON 相同：\u0000、单独的低代理丢弃；高代理后面不是 \u 时丢弃，是 \u 但不是低代理时两个都丢弃*/
+				if (0 == cp || (cp >= 0xDC00 && cp <= 0xDFFF))
+					continue;
+				if (cp >= 0xD800 && cp <= 0xDBFF)
+				{
+					if (e - s < 6 || s[0] != '\\' || s[1] != 'u')
+						continue;
+					lo = json_hex4(s + 2);
+					s += 6;
+					if (lo < 0xDC00 || lo > 0xDFFF)
+						continue;
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+				}
+				n = json_put_utf8(dst, n, size, cp);
+				if (n < 0)
+					goto fail;
+				continue;
+			default:
+				goto fail;
+		}
+		if (n + 1 >= size)
+			goto fail;
+		dst[n++] = c;
+	}
+
+	dst[n] = '\0';
+	return n;
+
+fail:
+	dst[0] = '\0';
+	return -1;
+}
+
+/*---字段表绑定-----------------------------*/
+static int json_bind_object(json_reader_t *rd, const json_field_t *fields, char *base);
+
+static int json_field_find(const json_field_t *fields, const json_token_t *tok)
+{
+	int i;
+
+	for (i = 0; fields[i].key && i < JSON_TABLE_MAX; i++)
+	{
+		if (0 == strncmp(fields[i].key, tok->str, tok->len) && '\0' == fields[i].key[tok->len])
+			return i;
+	}
+	return -1;
+}
+
+/*
+	功能：取一个值写入字段
+	参数：
+	返回：1 已写入；0 值为 null；HLE_RET_EINVAL 类型不符（值已经跳过）；HLE_RET_ERROR 格式错误
+	注意：
+*/
+static int json_bind_value(json_reader_t *rd, const json_field_t *f, char *base)
+{
+	json_token_t tok;
+	int t = json_next(rd, &tok);
+	int ret;
+
+	if (JSON_TOK_NULL == t)
+		return 0;
+
+	switch (f->type)
+	{
+		case JSON_T_INT:
+			if (JSON_TOK_NUMBER == t)
+				return (0 == json_tok_int(&tok, (int *)(base + f->offset))) ? 1 : HLE_RET_EINVAL;
+			break;
+		case JSON_T_BOOL:
+			if (JSON_TOK_TRUE == t || JSON_TOK_FALSE == t)
+			{
+				*(int *)(base + f->offset) = (JSON_TOK_TRUE == t);
+				return 1;
+			}
+			if (JSON_TOK_NUMBER == t)
+			{
+				int v = 0;
+				json_tok_int(&tok, &v);
+				*(int *)(base + f->offset) = (v != 0);
+				return 1;
+			}
+			break;
+		case JSON_T_STRING:
+			if (JSON_TOK_STRING == t)
+				return (json_tok_string(&tok, base + f->offset, f->size) >= 0) ? 1 : HLE_RET_EINVAL;
+			break;
+		case JSON_T_OBJECT:
+			if (JSON_TOK_OBJ_BEGIN == t)
+			{
+				ret = json_bind_object(rd, f->sub, base);
+				return (ret < 0) ? ret : 1;
+			}
+			break;
+		default:
+			break;
+	}
+
+	/*类型不符：跳过这个值*/
+	if (JSON_TOK_OBJ_BEGIN == t || JSON_TOK_ARR_BEGIN == t)
+		return (json_skip_open(rd, tok.depth) < 0) ? HLE_RET_ERROR : HLE_RET_EINVAL;
+	if (t < JSON_TOK_STRING)
+		return HLE_RET_ERROR;
+	return HLE_RET_EINVAL;
+}
+
+/*已经取到 '{'，绑定到 '}' 为止*/
+static int json_bind_object(json_reader_t *rd, const json_field_t *fields, char *base)
+{
+	json_token_t tok;
+	HLE_U32 found = 0;
+	int t, i, r, ret = HLE_RET_OK;
+
+	while (JSON_TOK_KEY == (t = json_next(rd, &tok)))
+	{
+		i = json_field_find(fields, &tok);
+		if (i < 0)
+		{
+			if (json_skip(rd) < 0)
+				return HLE_RET_ERROR;
+			continue;
+		}
+
+		r = json_bind_value(rd, &fields[i], base);
+		if (HLE_RET_ERROR == r)
+			return r;
+		if (r < 0)
+			ret = r;
+		else if (r > 0)
+			found |= 1u << i;
+	}
+	if (t != JSON_TOK_OBJ_END)
+		return HLE_RET_ERROR;
+
+	for (i = 0; fields[i].key && i < JSON_TABLE_MAX; i++)
+	{
+		if ((fields[i].flags & JSON_F_REQUIRED) && !(found & (1u << i)))
+			ret = HLE_RET_EINVAL;
+	}
+	return ret;
+}
+
+int json_parse(const char *text, int len, const json_field_t *fields, void *base, int *err_pos)
+{
+	json_reader_t rd;
+	json_token_t tok;
+	int ret;
+
+	if (NULL == text || NULL == fields || NULL == base)
+		return HLE_RET_EINVAL;
+
+	json_reader_init(&rd, text, len);
+	if (json_next(&rd, &tok) != JSON_TOK_OBJ_BEGIN)
+		ret = HLE_RET_ERROR;
+	else
+		ret = json_bind_object(&rd, fields, (char *)base);
+
+	if (ret != HLE_RET_ERROR && json_next(&rd, &tok) != JSON_TOK_END)
+		ret = HLE_RET_ERROR;
+
+	if (ret < 0 && err_pos)
+		*err_pos = json_reader_pos(&rd);
+	return ret;
+}
+
+/*---生成器-----------------------------*/
+static void json_put(json_writer_t *w, const char *s, int n)
+{
+	if (w->error)
+		return;
+	if (w->len + n >= w->size)
+	{
+		w->error = 1;
+		return;
+	}
+	memcpy(w->buf + w->len, s, n);
+	w->len += n;
+}
+
+static void json_put_c(json_writer_t *w, char c)
+{
+	if (w->error)
+		return;
+	if (w->len + 1 >= w->size)
+	{
+		w->error = 1;
+		return;
+	}
+	w->buf[w->len++] = c;
+}
+
+/*带引号和转义的字符串*/
+static void json_put_str(json_writer_t *w, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *run;
+	char esc[6];
+	int n;
+
+	json_put_c(w, '"');
+	while (*s)
+	{
+		/*不需要转义的一段整体拷贝*/
+		run = s;
+		while (*s && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20)
+			s++;
+		if (s > run)
+			json_put(w, run, s - run);
+		if (!*s)
+			break;
+
+		esc[0] = '\\';
+		n = 2;
+		switch (*s)
+		{
+			case '"':  esc[1] = '"'; break;
+			case '\\': esc[1] = '\\'; break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default:
+				esc[1] = 'u';
+				esc[2] = '0';
+				esc[3] = '0';
+				esc[4] = hex[((unsigned char)*s >> 4) & 0xF];
+				esc[5] = hex[(unsigned char)*s & 0xF];
+				n = 6;
+				break;
+		}
+		json_put(w, esc, n);
+		s++;
+	}
+	json_put_c(w, '"');
+}
+
+/*成员之间的逗号和键*/
+static void json_put_key(json_writer_t *w, const char *key)
+{
+	if (w->depth > 0)
+	{
+		HLE_U32 bit = 1u << (w->depth - 1);
+		if (w->more & bit)
+			json_put_c(w, ',');
+		w->more |= bit;
+	}
+	if (key)
+	{
+		json_put_str(w, key);
+		json_put_c(w, ':');
+	}
+}
+
+static void json_open(json_writer_t *w, const char *key, char c)
+{
+	json_put_key(w, key);
+	json_put_c(w, c);
+	if (w->depth >= JSON_DEPTH_MAX)
+	{
+		w->error = 1;
+		return;
+	}
+	w->more &= ~(1u << w->depth);
+	w->depth++;
+}
+
+static void json_close_w(json_writer_t *w, char c)
+{
+	if (w->depth <= 0)
+	{
+		w->error = 1;
+		return;
+	}
+	w->depth--;
+	json_put_c(w, c);
+}
+
+void json_write_init(json_writer_t *w, char *buf, int size)
+{
+	w->buf = buf;
+	w->size = (buf != NULL && size > 0) ? size : 0;
+	w->len = 0;
+	w->depth = 0;
+	w->more = 0;
+	w->error = (0 == w->size);
+}
+
+void json_write_obj_begin(json_writer_t *w, const char *key)
+{
+	json_open(w, key, '{');
+}
+
+void json_write_obj_end(json_writer_t *w)
+{
+	json_close_w(w, '}');
+}
+
+void json_write_arr_begin(json_writer_t *w, const char *key)
+{
+	json_open(w, key, '[');
+}
+
+void json_write_arr_end(json_writer_t *w)
+{
+	json_close_w(w, ']');
+}
+
+void json_write_string(json_writer_t *w, const char *key, const char *val)
+{
+	json_put_key(w, key);
+	json_put_str(w, val ? val : "");
+}
+
+void json_write_int(json_writer_t *w, const char *key, int val)
+{
+	char tmp[12];
+	int i = sizeof (tmp);
+	unsigned int u = (val < 0) ? 0u - (unsigned int)val : (unsigned int)val;
+
+	do
+	{
+		tmp[--i] = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (val < 0)
+		tmp[--i] = '-';
+
+	json_put_key(w, key);
+	json_put(w, tmp + i, sizeof (tmp) - i);
+}
+
+void json_write_u64(json_writer_t *w, const char *key, HLE_U64 val)
+{
+	char tmp[20];
+	int i = sizeof (tmp);
+
+	do
+	{
+		tmp[--i] = '0' + (char)(val % 10);
+		val /= 10;
+	} while (val);
+
+	json_put_key(w, key);
+	json_put(w, tmp + i, sizeof (tmp) - i);
+}
+
+void json_write_bool(json_writer_t *w, const char *key, int val)
+{
+	json_put_key(w, key);
+	if (val)
+		json_put(w, "true", 4);
+	else
+		json_put(w, "false", 5);
+}
+
+void json_write_null(json_writer_t *w, const char *key)
+{
+	json_put_key(w, key);
+	json_put(w, "null", 4);
+}
+
+int json_write_finish(json_writer_t *w)
+{
+	if (w->error || w->depth != 0)
+	{
+		if (w->size > 0)
+			w->buf[(w->len < w->size) ? w->len : w->size - 1] = '\0';
+		return -1;
+	}
+	w->buf[w->len] = '\0';
+	return w->len;
+}
+
+/*---cJSON 兼容层-----------------------------*/
+static cJSON *json_pool_node(json_cjson_pool_t *pool)
+{
+	cJSON *node;
+
+	if (pool->used >= pool->num)
+		return NULL;
+	node = &pool->nodes[pool->used++];
+	memset(node, 0, sizeof (*node));
+	return node;
+}
+
+static char *json_pool_string(json_cjson_pool_t *pool, const json_token_t *tok)
+{
+	char *dst = pool->strbuf + pool->strused;
+	int n = json_tok_string(tok, dst, pool->strsize - pool->strused);
+
+	if (n < 0)
+		return NULL;
+	pool->strused += n + 1;
+	return dst;
+}
+
+/*数值与 cJSON 的 parse_number 一致：valuedouble 为完整的数值，valueint 为整数部分*/
+static void json_pool_number(cJSON *node, const json_token_t *tok)
+{
+	char tmp[64];
+	int i, simple = (tok->len <= 9);
+
+	json_tok_int(tok, &node->valueint);
+	for (i = 0; simple && i < tok->len; i++)
+	{
+		if ('.' == tok->str[i] || 'e' == tok->str[i] || 'E' == tok->str[i])
+			simple = 0;
+	}
+	if (simple)
+	{
+		node->valuedouble = node->valueint;
+		return;
+	}
+
+	i = (tok->len < (int)sizeof (tmp)) ? tok->len : (int)sizeof (tmp) - 1;
+	memcpy(tmp, tok->str, i);
+	tmp[i] = '\0';
+	node->valuedouble = strtod(tmp, NULL);
+}
+
+/*
+	功能：在节点池中建立 cJSON 树
+	参数：
+	返回：根节点，失败 NULL
+	注意：父节点和最后一个子节点按层保存，不用递归
+*/
+cJSON *json_cjson_parse(const char *text, json_cjson_pool_t *pool)
+{
+	json_reader_t rd;
+	json_token_t tok;
+	cJSON *parent[JSON_DEPTH_MAX];
+	cJSON *last[JSON_DEPTH_MAX];
+	cJSON *root = NULL, *node;
+	char *key = NULL;
+	int t, d = 0;
+
+	if (NULL == text || NULL == pool || NULL == pool->nodes || NULL == pool->strbuf)
+		return NULL;
+
+	pool->used = 0;
+	pool->strused = 0;
+	json_reader_init(&rd, text, -1);
+	while ((t = json_next(&rd, &tok)) > JSON_TOK_END)
+	{
+		if (JSON_TOK_KEY == t)
+		{
+			if (NULL == (key = json_pool_string(pool, &tok)))
+				return NULL;
+			continue;
+		}
+		if (JSON_TOK_OBJ_END == t || JSON_TOK_ARR_END == t)
+		{
+			d--;
+			continue;
+		}
+
+		if (NULL == (node = json_pool_node(pool)))
+			return NULL;
+		node->string = key;
+		key = NULL;
+
+		switch (t)
+		{
+			case JSON_TOK_OBJ_BEGIN:
+				node->type = cJSON_Object;
+				break;
+			case JSON_TOK_ARR_BEGIN:
+				node->type = cJSON_Array;
+				break;
+			case JSON_TOK_STRING:
+				node->type = cJSON_String;
+				if (NULL == (node->valuestring = json_pool_string(pool, &tok)))
+					return NULL;
+				break;
+			case JSON_TOK_NUMBER:
+				node->type = cJSON_Number;
+				json_pool_number(node, &tok);
+				break;
+			case JSON_TOK_TRUE:
+				node->type = cJSON_True;
+				node->valueint = 1;
+				break;
+			case JSON_TOK_FALSE:
+				node->type = cJSON_False;
+				break;
+			default:
+				node->type = cJSON_NULL;
+				break;
+		}
+
+		if (0 == d)
+		{
+			root = node;
+		}
+		else
+		{
+			if (last[d - 1])
+			{
+				last[d - 1]->next = node;
+				node->prev = last[d - 1];
+			}
+			else
+			{
+				parent[d - 1]->child = node;
+			}
+			last[d - 1] = node;
+		}
+
+		if (JSON_TOK_OBJ_BEGIN == t || JSON_TOK_ARR_BEGIN == t)
+		{
+			parent[d] = node;
+			last[d] = NULL;
+			d++;
+		}
+	}
+
+	return (JSON_TOK_END == t) ? root : NULL;
+}
+
+/*数字格式与 cJSON 的 print_number 相同（仓库里的 cJSON 按 sizeof(int)/sizeof(double) 截断，这里不截断）*/
+static void json_put_number(json_writer_t *w, const cJSON *item)
+{
+	char tmp[64];
+	double d = item->valuedouble;
+	int n;
+
+	if (isnan(d) || isinf(d))
+	{
+		json_put(w, "null", 4);		//cJSON 会输出 inf/nan（不是合法的 JSON）
+		return;
+	}
+	if (fabs(((double)item->valueint) - d) <= DBL_EPSILON && d <= INT_MAX && d >= INT_MIN)
+		n = snprintf(tmp, sizeof (tmp), "%d", item->valueint);
+	else if (fabs(floor(d) - d) <= DBL_EPSILON && fabs(d) < 1.0e60)
+		n = snprintf(tmp, sizeof (tmp), "%.0f", d);
+	else if (fabs(d) < 1.0e-6 || fabs(d) > 1.0e9)
+		n = snprintf(tmp, sizeof (tmp), "%e", d);
+	else
+		n = snprintf(tmp, sizeof (tmp), "%f", d);
+
+	json_put(w, tmp, (n < (int)sizeof (tmp)) ? n : (int)sizeof (tmp) - 1);
+}
+
+static void json_cjson_put(json_writer_t *w, const cJSON *item, const char *key)
+{
+	const cJSON *c;
+
+	switch (item->type & 255)
+	{
+		case cJSON_False:
+			json_write_bool(w, key, 0);
+			break;
+		case cJSON_True:
+			json_write_bool(w, key, 1);
+			break;
+		case cJSON_NULL:
+			json_write_null(w, key);
+			break;
+		case cJSON_Number:
+			json_put_key(w, key);
+			json_put_number(w, item);
+			break;
+		case cJSON_String:
+			json_write_string(w, key, item->valuestring);
+			break;
+		case cJSON_Array:
+		case cJSON_Object:
+			json_open(w, key, (cJSON_Array == (item->type & 255)) ? '[' : '{');
+			for (c = item->child; c && !w->error; c = c->next)
+			{
+				if (cJSON_Array == (item->type & 255))
+					json_cjson_put(w, c, NULL);
+				else
+					json_cjson_put(w, c, c->string ? c->string : "");
+			}
+			json_close_w(w, (cJSON_Array == (item->type & 255)) ? ']' : '}');
+			break;
+		default:
+			w->error = 1;
+			break;
+	}
+}
+
+int json_cjson_print(cJSON *item, char *buf, int size)
+{
+	json_writer_t w;
+
+	if (NULL == item)
+		return -1;
+
+	json_write_init(&w, buf, size);
+	json_cjson_put(&w, item, NULL);
+	return json_write_finish(&w);
+}
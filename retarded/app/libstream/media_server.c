@@ -25,7 +25,6 @@
 #include "sntp.h"
 #include "unistd.h"
 #include "pwd.h"
-#include "PPCS_API.h"
 
 
 
@@ -61,7 +60,7 @@ static HLE_S32 media_server_exit(void)
 {
 	/*结束p2p medai server其他线程*/
 	
-	PPCS_DeInitialize();
+	p2p_deinit();
 	return HLE_RET_OK ;
 }
 
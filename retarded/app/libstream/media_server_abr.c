@@ -0,0 +1,190 @@
+/*********************************************************************************
+  *FileName: media_server_abr.c
+  *Create Date: 2026/10/19
+  *Description: 实时流自适应码率（ABR）控制器。
+  *Others:
+  *	 1.吞吐：每 ABR_SAMPLE_INTERVAL 用"写入字节数 - 发送缓存增量"得到这段时间真正发出去的字节数。
+  *	   只有发送缓存一直有积压时采样才代表链路能力（平滑更新），否则只是发送速率，只允许吞吐估计上升（并缓慢衰减）。
+  *	 2.时延：发送缓存字节数 / 吞吐估计。
+  *	 3.降档：时延超过 ABR_DELAY_HIGH，直接降到码率不超过吞吐 85% 的档位（码率未知时降一档）。
+  *	 4.升档：时延持续低于 ABR_DELAY_LOW，若上一档码率明显低于吞吐估计则 1 秒后升档，否则等 hold_ms 后试探升一档；
+  *	   试探升档后 10 秒内又降档说明带宽不够，试探间隔加倍，10 秒内没有降档说明带宽确实变大，间隔恢复最小值
+  *	   （和 sdp 调整拥塞等级时 down_thres 的处理相同）。
+  *History:
+**********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "media_server_abr.h"
+
+
+/*
+ * 档位表：画质从高到低。主码流只有编码器默认参数一档（SD 录像和事件录像也用主码流，见 ABR_RECORD_STREAM），
+ * 降档直接切子码流，子码流先降码率，最后两档降帧率、拉长 GOP
+ * （CBR 下码率由拥塞等级决定，降帧率是让每帧分到更多比特，拉长 GOP 减少 I 帧开销）
+ */
+static const abr_rung_t abr_ladder[] =
+{
+	{0, 0, 1, 1},
+	{1, 0, 1, 1},
+	{1, 1, 1, 1},
+	{1, 2, 1, 1},
+	{1, 3, 1, 1},
+	{1, 4, 2, 2},
+	{1, 5, 3, 2},
+};
+#define ABR_RUNG_NUM	((HLE_S32)(sizeof(abr_ladder) / sizeof(abr_ladder[0])))
+
+
+const abr_rung_t *abr_get_rung(HLE_S32 rung)
+{
+	if(rung < 0 || rung >= ABR_RUNG_NUM)
+		return NULL;
+	return &abr_ladder[rung];
+}
+
+HLE_S32 abr_rung_num(void)
+{
+	return ABR_RUNG_NUM;
+}
+
+HLE_S32 abr_first_rung(HLE_S32 stream)
+{
+	HLE_S32 i;
+
+	for(i = 0; i < ABR_RUNG_NUM; i++)
+	{
+		if(abr_ladder[i].stream == stream)
+			return i;
+	}
+	return -1;
+}
+
+HLE_U32 abr_rung_kbps(HLE_S32 rung, const HLE_U32 *base_kbps)
+{
+	const abr_rung_t *r = abr_get_rung(rung);
+	if(NULL == r || NULL == base_kbps)
+		return 0;
+	return base_kbps[r->stream] * (ABR_ENC_LEVEL_NUM - r->level) / ABR_ENC_LEVEL_NUM;
+}
+
+void abr_session_init(abr_session_t *abr, HLE_S32 stream, HLE_U32 now_ms, HLE_U32 sent)
+{
+	memset(abr, 0, sizeof(abr_session_t));
+	abr->top = abr_first_rung(stream);
+	if(abr->top < 0)
+		abr->top = 0;
+	abr->rung = abr->top;
+	abr->last_ms = now_ms;
+	abr->last_sent = sent;
+	abr->hold_ms = ABR_UP_HOLD_MIN;
+	abr->down_ms = now_ms - ABR_DOWN_HOLD;
+}
+
+HLE_S32 abr_session_due(const abr_session_t *abr, HLE_U32 now_ms)
+{
+	return (now_ms - abr->last_ms) >= ABR_SAMPLE_INTERVAL;
+}
+
+/*更新吞吐和时延估计*/
+static void abr_estimate(abr_session_t *abr, HLE_U32 dt, HLE_U32 sent, HLE_U32 wsize)
+{
+	HLE_S32 drained = (HLE_S32)(sent - abr->last_sent) + (HLE_S32)abr->last_wsize - (HLE_S32)wsize;
+	if(drained < 0)
+		drained = 0;
+	HLE_U32 sample = (HLE_U32)((HLE_U64)drained * 8 / dt); //字节/毫秒 * 8 = kbps
+	HLE_S32 backlog = abr->last_wsize >= ABR_BACKLOG_BYTES && wsize >= ABR_BACKLOG_BYTES;
+
+	if(0 == abr->tput_kbps)
+		abr->tput_kbps = sample;
+	else if(backlog)
+		abr->tput_kbps = (abr->tput_kbps * 3 + sample) / 4;
+	else if(sample > abr->tput_kbps)
+		abr->tput_kbps = sample;
+	else
+		abr->tput_kbps -= abr->tput_kbps / 64; //长时间没有积压，旧的估计逐渐失效
+
+	if(abr->tput_kbps > 0)
+		abr->delay_ms = (HLE_U32)((HLE_U64)wsize * 8 / abr->tput_kbps);
+	else
+		abr->delay_ms = wsize > 0 ? ABR_DELAY_HIGH + 1 : 0;
+
+	abr->last_sent = sent;
+	abr->last_wsize = wsize;
+}
+
+HLE_S32 abr_session_update(abr_session_t *abr, HLE_U32 now_ms, HLE_U32 sent, HLE_U32 wsize, const HLE_U32 *base_kbps)
+{
+	HLE_U32 dt = now_ms - abr->last_ms;
+	if(dt < ABR_SAMPLE_INTERVAL)
+		return abr->rung;
+	abr->last_ms = now_ms;
+	abr_estimate(abr, dt, sent, wsize);
+
+	if(abr->up_probe && now_ms - abr->up_ms >= ABR_UP_FAIL_WINDOW)
+	{
+		//升档后稳定了，是网络本身带宽变大，试探间隔恢复最小值
+		abr->up_probe = 0;
+		abr->hold_ms = ABR_UP_HOLD_MIN;
+	}
+
+	if(abr->delay_ms > ABR_DELAY_HIGH)
+	{
+		abr->stable_ms = 0;
+		if(abr->rung >= ABR_RUNG_NUM - 1 || now_ms - abr->down_ms < ABR_DOWN_HOLD)
+			return abr->rung;
+
+		HLE_U32 target = abr->tput_kbps * ABR_DOWN_PCT / 100;
+		HLE_S32 next = abr->rung + 1;
+		while(next < ABR_RUNG_NUM - 1 && abr_rung_kbps(next, base_kbps) > target)
+			next++;
+
+		if(abr->up_probe && now_ms - abr->up_ms < ABR_UP_FAIL_WINDOW)
+		{
+			//试探升档失败
+			abr->hold_ms *= 2;
+			if(abr->hold_ms > ABR_UP_HOLD_MAX)
+				abr->hold_ms = ABR_UP_HOLD_MAX;
+		}
+		abr->up_probe = 0;
+		abr->down_ms = now_ms;
+		DEBUG_LOG("abr down: rung %d -> %d, tput %u kbps, delay %u ms\n", abr->rung, next, abr->tput_kbps, abr->delay_ms);
+		abr->rung = next;
+	}
+	else if(abr->delay_ms < ABR_DELAY_LOW && abr->rung > abr->top)
+	{
+		abr->stable_ms += dt;
+		HLE_U32 up_kbps = abr_rung_kbps(abr->rung - 1, base_kbps);
+		if((up_kbps > 0 && up_kbps <= abr->tput_kbps * ABR_UP_PCT / 100 && abr->stable_ms >= ABR_DOWN_HOLD)
+			|| abr->stable_ms >= abr->hold_ms)
+		{
+			DEBUG_LOG("abr up: rung %d -> %d, tput %u kbps, delay %u ms\n", abr->rung, abr->rung - 1, abr->tput_kbps, abr->delay_ms);
+			abr->rung --;
+			abr->stable_ms = 0;
+			abr->up_probe = 1;
+			abr->up_ms = now_ms;
+		}
+	}
+	else
+	{
+		abr->stable_ms = 0;
+	}
+	return abr->rung;
+}
+
+HLE_S32 abr_group_rung(HLE_S32 *rungs, HLE_S32 num)
+{
+	HLE_S32 i, j;
+
+	if(num <= 0)
+		return -1;
+	for(i = 1; i < num; i++) //观看者很少，插入排序
+	{
+		HLE_S32 r = rungs[i];
+		for(j = i; j > 0 && rungs[j - 1] > r; j--)
+			rungs[j] = rungs[j - 1];
+		rungs[j] = r;
+	}
+	return rungs[(num - 1) / 2];
+}
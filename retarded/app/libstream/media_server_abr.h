@@ -0,0 +1,129 @@
+/*********************************************************************************
+  *FileName: media_server_abr.h
+  *Create Date: 2026/10/19
+  *Description: 实时流自适应码率（ABR）控制器。按会话估计链路吞吐和发送缓存排队时延，
+  *			 在码率档位表（主/子码流 + 编码拥塞等级 + 帧率 + GOP）中选择档位。
+  *Others:  1.本模块只做决策，不依赖传输层和编码模块，由会话反应器的流线程调用。
+  *		 2.同一路码流的多个观看者共用编码器，编码参数取各观看者档位的中位数（同 sdp 的拥塞等级计算）。
+  *		 3.主机上的带宽轨迹回放模拟器见 test/test_abr.c。
+  *		 4.ABR 只调整子码流的编码参数。主码流同时给 SD 录像和事件录像用，它只有一个档位（编码器默认参数），
+  *		   链路跟不上时直接切到子码流，不会因为一个观看者的网络差而降低录像的码率。
+  *		   代价是主码流观看者没有中间档位：从主码流满码率直接降到子码流（分辨率也降低）。
+  *History:
+**********************************************************************************/
+#ifndef MEDIA_SERVER_ABR_H
+#define MEDIA_SERVER_ABR_H
+
+#include "typeport.h"
+
+#define ABR_ENC_LEVEL_NUM		6			//编码拥塞等级数（与编码模块 MAX_BLOCK_LEVEL 相同）
+#define ABR_STREAM_NUM			2			//码流数：0 主码流，1 子码流
+#define ABR_RECORD_STREAM		0			//录像使用的码流（主码流），ABR 不改变它的编码参数
+#define ABR_SAMPLE_INTERVAL		200			//采样周期（毫秒）
+#define ABR_BACKLOG_BYTES		(8*1024)	//发送缓存超过该值认为链路已跑满，吞吐采样才反映链路能力
+#define ABR_DELAY_HIGH			400			//排队时延超过该值降档（毫秒）
+#define ABR_DELAY_LOW			100			//排队时延低于该值才考虑升档（毫秒）
+#define ABR_DOWN_PCT			85			//降档目标：档位码率不超过吞吐估计的 85%
+#define ABR_UP_PCT				70			//快速升档：上一档码率不超过吞吐估计的 70%
+#define ABR_DOWN_HOLD			1000		//两次降档的最小间隔（降档前进入缓存的数据还需要时间发完）
+#define ABR_UP_HOLD_MIN			4000		//吞吐估计不足以判断时，时延持续低于 ABR_DELAY_LOW 这么久才试探升档
+#define ABR_UP_HOLD_MAX			64000		//试探升档间隔的上限
+#define ABR_UP_FAIL_WINDOW		10000		//升档后这段时间内又降档，认为试探失败，试探间隔加倍
+
+/*
+ * 码率档位
+ */
+typedef struct _abr_rung_t
+{
+	HLE_U8 stream;				//码流下标：0 主码流，1 子码流
+	HLE_U8 level;				//编码拥塞等级，码率 = 设置码率 * (ABR_ENC_LEVEL_NUM - level) / ABR_ENC_LEVEL_NUM
+	HLE_U8 fps_div;				//帧率除数（主码流档位固定为 1）
+	HLE_U8 gop_sec;				//GOP 时长（秒）（主码流档位固定为 1）
+}abr_rung_t;
+
+/*
+ * 会话的 ABR 状态
+ */
+typedef struct _abr_session_t
+{
+	HLE_S32 rung;				//当前档位（档位表下标，越小画质越好）
+	HLE_S32 top;				//最高档位（客户端请求的码流的第一档）
+	HLE_U32 last_ms;			//上次采样时间
+	HLE_U32 last_sent;			//上次采样时累计写入传输层的字节数
+	HLE_U32 last_wsize;			//上次采样时发送缓存中的字节数
+	HLE_U32 tput_kbps;			//吞吐估计
+	HLE_U32 delay_ms;			//排队时延估计
+	HLE_U32 hold_ms;			//试探升档间隔
+	HLE_U32 stable_ms;			//时延持续低于 ABR_DELAY_LOW 的时长
+	HLE_U32 down_ms;			//上次降档时间
+	HLE_U32 up_ms;				//上次升档时间
+	HLE_S8  up_probe;			//上次升档还在观察期内
+}abr_session_t;
+
+
+/*******************************************************************************
+*@ Description    :档位表
+*@ Input          :<rung>档位
+*@ Output         :
+*@ Return         :档位描述，rung 越界返回 NULL
+*@ attention      :
+*******************************************************************************/
+const abr_rung_t *abr_get_rung(HLE_S32 rung);
+HLE_S32 abr_rung_num(void);
+
+/*******************************************************************************
+*@ Description    :码流的第一档（该码流画质最好的档位）
+*@ Input          :<stream>码流下标
+*@ Output         :
+*@ Return         :档位；stream 非法返回 -1
+*@ attention      :
+*******************************************************************************/
+HLE_S32 abr_first_rung(HLE_S32 stream);
+
+/*******************************************************************************
+*@ Description    :估计档位的码率
+*@ Input          :<rung>档位
+					<base_kbps>各码流在拥塞等级 0、不降帧率时的码率（实测），0 表示未知
+*@ Output         :
+*@ Return         :码率（kbps），未知返回 0
+*@ attention      :
+*******************************************************************************/
+HLE_U32 abr_rung_kbps(HLE_S32 rung, const HLE_U32 *base_kbps);
+
+/*******************************************************************************
+*@ Description    :初始化会话的 ABR 状态
+*@ Input          :<stream>客户端请求的码流（最高只升到该码流的第一档）
+					<now_ms><sent>当前时间和累计写入字节数
+*@ Output         :<abr>
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void abr_session_init(abr_session_t *abr, HLE_S32 stream, HLE_U32 now_ms, HLE_U32 sent);
+
+/*距离上次采样是否已经超过 ABR_SAMPLE_INTERVAL（调用者据此决定是否去查询发送缓存）*/
+HLE_S32 abr_session_due(const abr_session_t *abr, HLE_U32 now_ms);
+
+/*******************************************************************************
+*@ Description    :输入一次采样，更新吞吐/时延估计并决定档位
+*@ Input          :<now_ms>当前时间（毫秒）
+					<sent>累计写入传输层的字节数（允许回绕）
+					<wsize>发送缓存中还没发出去的字节数
+					<base_kbps>同 abr_rung_kbps
+*@ Output         :<abr>
+*@ Return         :新的档位（可能和原来相同）
+*@ attention      :距上次采样不足 ABR_SAMPLE_INTERVAL 时不更新，直接返回当前档位
+*******************************************************************************/
+HLE_S32 abr_session_update(abr_session_t *abr, HLE_U32 now_ms, HLE_U32 sent, HLE_U32 wsize, const HLE_U32 *base_kbps);
+
+/*******************************************************************************
+*@ Description    :同一码流多个观看者共用编码器时的编码档位（中位数）
+*@ Input          :<rungs><num>各观看者的档位（同一码流）
+*@ Output         :<rungs>会被排序
+*@ Return         :编码档位；num 为 0 返回 -1
+*@ attention      :
+*******************************************************************************/
+HLE_S32 abr_group_rung(HLE_S32 *rungs, HLE_S32 num);
+
+
+#endif
+
@@ -16,6 +16,7 @@ struct HTTP_RES_HEADER//保持相应头信息
     int status_code;//HTTP/1.1 '200' OK
     char content_type[128];//Content-Type: application/gzip
     long content_length;//Content-Length: 11683079
+    int chunked;//Transfer-Encoding: chunked
 };
 
 typedef struct _updateInfo_t
@@ -82,6 +83,8 @@ struct HTTP_RES_HEADER parse_header(const char *response)
 {
     /*获取响应头的信息*/
     struct HTTP_RES_HEADER resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.content_length = -1;//没有 Content-Length 时为 -1
 
     char *pos = strstr(response, "HTTP/");
     if (pos)//获取返回代码
@@ -95,6 +98,12 @@ struct HTTP_RES_HEADER parse_header(const char *response)
     if (pos)//获取返回文档长度
         sscanf(pos, "%*s %ld", &resp.content_length);
 
+    char encoding[32] = {0};
+    pos = strstr(response, "Transfer-Encoding:");
+    if (pos)//分块传输时 body 没有 Content-Length
+        sscanf(pos, "%*s %31s", encoding);
+    resp.chunked = (0 == strcmp(encoding, "chunked"));
+
     return resp;
 }
 
@@ -375,6 +384,251 @@ char * http_dowload_file(int argc, char *argv[])
 }
 
 
+/*****************************************************************
+*函数名 ：     http_get_stream
+*功能描述 ：HTTP GET，响应的 body 边接收边交给回调（不落地成文件，用于流式升级）
+*参数 ：   url:下载地址
+*        on_data:body 数据回调，返回 <0 时中断下载
+*        arg:回调参数
+*返回值 ：     成功：0（body 完整接收）
+*          失败：-1
+*****************************************************************/
+#define HTTP_STREAM_BUF_SIZE    8192
+#define HTTP_STREAM_TIMEOUT     10      //接收超时（秒）
+
+/*Transfer-Encoding: chunked 的解码状态*/
+enum
+{
+    HTTP_CHUNK_SIZE,        //块大小（十六进制）
+    HTTP_CHUNK_EXT,         //块扩展，到行尾为止
+    HTTP_CHUNK_DATA,        //块数据
+    HTTP_CHUNK_DATA_END,    //块数据后的 CRLF
+    HTTP_CHUNK_TRAILER,     //大小为 0 的块之后的尾部字段，空行结束
+    HTTP_CHUNK_DONE
+};
+
+typedef struct _http_chunk_t
+{
+    int state;
+    long size;              //块大小；HTTP_CHUNK_DATA 时为块中剩余的字节数
+    int digits;             //块大小已解析的位数
+    int line_len;           //尾部字段当前行的长度
+}http_chunk_t;
+
+/*解码一段接收到的数据，块数据交给回调；返回 1：body 结束，0：需要更多数据，
+  -1：回调中断，-2：格式错误*/
+static int http_chunk_feed(http_chunk_t *chunk, const char *data, int len,
+                           int (*on_data)(void *arg, const void *data, int len), void *arg)
+{
+    int i = 0;
+
+    while (i < len && chunk->state != HTTP_CHUNK_DONE)
+    {
+        char c = data[i];
+        switch (chunk->state)
+        {
+            case HTTP_CHUNK_SIZE:
+                if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+                {
+                    if (chunk->digits >= 7)//块大小不超过 256MB
+                        return -2;
+                    chunk->size = chunk->size * 16 + ((c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10);
+                    chunk->digits++;
+                    i++;
+                }
+                else if (0 == chunk->digits)
+                    return -2;
+                else
+                    chunk->state = HTTP_CHUNK_EXT;
+                break;
+
+            case HTTP_CHUNK_EXT:
+                if ('\n' == data[i++])
+                {
+                    chunk->state = chunk->size ? HTTP_CHUNK_DATA : HTTP_CHUNK_TRAILER;
+                    chunk->line_len = 0;
+                }
+                break;
+
+            case HTTP_CHUNK_DATA:
+            {
+                int n = (len - i < chunk->size) ? len - i : (int)chunk->size;
+                if (on_data(arg, data + i, n) < 0)
+                    return -1;
+                i += n;
+                chunk->size -= n;
+                if (0 == chunk->size)
+                    chunk->state = HTTP_CHUNK_DATA_END;
+                break;
+            }
+
+            case HTTP_CHUNK_DATA_END:
+                i++;
+                if ('\n' == c)
+                {
+                    chunk->state = HTTP_CHUNK_SIZE;
+                    chunk->size = 0;
+                    chunk->digits = 0;
+                }
+                else if (c != '\r')
+                    return -2;
+                break;
+
+            case HTTP_CHUNK_TRAILER:
+                i++;
+                if ('\n' == c)
+                {
+                    if (0 == chunk->line_len)
+                        chunk->state = HTTP_CHUNK_DONE;
+                    chunk->line_len = 0;
+                }
+                else if (c != '\r')
+                    chunk->line_len++;
+                break;
+        }
+    }
+
+    return (HTTP_CHUNK_DONE == chunk->state) ? 1 : 0;
+}
+
+int http_get_stream(const char *url, int (*on_data)(void *arg, const void *data, int len), void *arg)
+{
+    char host[64] = {0};//远程主机地址
+    char ip_addr[16] = {0};//远程主机IP地址
+    int port = 80;//远程主机端口, http默认80端口
+    char file_name[256] = {0};
+    char header[2048] = {0};
+    int ret = -1;
+
+    if (NULL == url || NULL == on_data || strlen(url) >= 1024)
+        return -1;
+
+    parse_url(url, host, &port, file_name);
+    get_ip_addr(host, ip_addr);
+    if (strlen(ip_addr) == 0)
+    {
+        printf("<http> Error: could not get IP address of %s\n", host);
+        return -1;
+    }
+
+    int client_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (client_socket < 0)
+    {
+        printf("<http> Create a network socket failed: %d\n", client_socket);
+        return -1;
+    }
+    struct timeval tv = {HTTP_STREAM_TIMEOUT, 0};
+    setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(ip_addr);
+    addr.sin_port = htons(port);
+    if (connect(client_socket, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        printf("<http> Connecting to %s:%d failed!\n", ip_addr, port);
+        close(client_socket);
+        return -1;
+    }
+
+    const char *path = strstr(url, "://");//请求行使用 URL 中的路径部分
+    path = strchr(path ? path + 3 : url, '/');
+    snprintf(header, sizeof(header),
+            "GET %s HTTP/1.1\r\n"
+            "Host: %s\r\n"
+            "Connection: close\r\n"
+            "\r\n", path ? path : "/", host);
+    if (write(client_socket, header, strlen(header)) != (int)strlen(header))
+    {
+        printf("<http> send request failed! errno(%d)\n", errno);
+        close(client_socket);
+        return -1;
+    }
+
+    char *buf = (char *) malloc(HTTP_STREAM_BUF_SIZE + 1);
+    if (NULL == buf)
+    {
+        close(client_socket);
+        return -1;
+    }
+
+    /*1.响应头：读到空行为止，空行之后已经读到的部分属于 body*/
+    int length = 0;
+    char *body = NULL;
+    while (NULL == body && length < HTTP_STREAM_BUF_SIZE)
+    {
+        int len = read(client_socket, buf + length, HTTP_STREAM_BUF_SIZE - length);
+        if (len <= 0)
+            break;
+        length += len;
+        buf[length] = '\0';
+        body = strstr(buf, "\r\n\r\n");
+    }
+    if (NULL == body)
+    {
+        printf("<http> bad response header!\n");
+        goto out;
+    }
+    body += 4;
+
+    char save = *body;//只在响应头中查找字段
+    *body = '\0';
+    struct HTTP_RES_HEADER resp = parse_header(buf);
+    *body = save;
+    if (resp.status_code != 200)
+    {
+        printf("<http> GET %s, remote host returns: %d\n", url, resp.status_code);
+        goto out;
+    }
+
+    long received = length - (body - buf);
+    if (resp.chunked)
+    {
+        /*2.body：分块传输，块大小行不交给回调，收到大小为 0 的块和尾部字段后结束*/
+        http_chunk_t chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        int done = http_chunk_feed(&chunk, body, received, on_data, arg);
+        while (0 == done)
+        {
+            int len = read(client_socket, buf, HTTP_STREAM_BUF_SIZE);
+            if (len <= 0)
+                break;
+            done = http_chunk_feed(&chunk, buf, len, on_data, arg);
+        }
+        if (done > 0)
+            ret = 0;
+        else if (-2 == done)
+            printf("<http> bad chunked body!\n");
+        else if (0 == done)
+            printf("<http> chunked body incomplete\n");
+        goto out;
+    }
+
+    /*2.body：按 Content-Length 接收（没有时收到连接关闭）*/
+    if (received > 0 && on_data(arg, body, received) < 0)
+        goto out;
+    while (resp.content_length < 0 || received < resp.content_length)
+    {
+        int len = read(client_socket, buf, HTTP_STREAM_BUF_SIZE);
+        if (len <= 0)
+            break;
+        received += len;
+        if (on_data(arg, buf, len) < 0)
+            goto out;
+    }
+    if (resp.content_length < 0 || received == resp.content_length)
+        ret = 0;
+    else
+        printf("<http> body incomplete %ld/%ld bytes\n", received, resp.content_length);
+
+out:
+    free(buf);
+    close(client_socket);
+    return ret;
+}
+
+
 /*****************************************************************
 *函数名 ：     http_post
 *功能描述 ：http发送post请求
@@ -27,13 +27,14 @@
 #include <arpa/inet.h> 
 #include <time.h>
 
-#include "PPCS_API.h"
 #include "PPCS_Error.h"
 #include "PPCS_Type.h"
 #include "media_server_p2p.h"
 #include "media_server_interface.h"
 #include "media_server_signal_def.h"
 #include "media_server_signal_parse.h"
+#include "p2p_transport.h"
+#include "media_server_reactor.h"
 
 
 
@@ -65,6 +66,9 @@ const HLE_S8 LogFileName[] = "./ListenTester.log";
 
 volatile HLE_S8 P2P_status;			//P2Pmedia server的状态
 
+static const p2p_transport_t *g_transport = NULL;	//当前使用的传输层
+static const HLE_S8 *g_transport_param = NULL;		//传输层 init 参数
+
 
 //// liteOS TCP packet Send to Device: 
 ////#define WAKEUP_CODE {0x98,0x3b,0x16,0xf8,0xf3,0x9c}
@@ -294,24 +298,6 @@ void showErrorInfo(HLE_S32 ret)
 	}
 }
 
-void showNetwork(st_PPCS_NetInfo NetInfo)
-{
-	st_info("-------------- NetInfo: -------------------\n");
-	st_info("Internet Reachable     : %s\n", (NetInfo.bFlagInternet == 1) ? "YES":"NO");
-	st_info("P2P Server IP resolved : %s\n", (NetInfo.bFlagHostResolved == 1) ? "YES":"NO");
-	st_info("P2P Server Hello Ack   : %s\n", (NetInfo.bFlagServerHello == 1) ? "YES":"NO");
-	switch(NetInfo.NAT_Type)
-	{
-	case 0: st_info("Local NAT Type         : Unknow\n"); break;
-	case 1: st_info("Local NAT Type         : IP-Restricted Cone\n"); break;
-	case 2: st_info("Local NAT Type         : Port-Restricted Cone\n"); break;
-	case 3: st_info("Local NAT Type         : Symmetric\n"); break;
-	}
-	st_info("My Wan IP : %s\n", NetInfo.MyWanIP);
-	st_info("My Lan IP : %s\n", NetInfo.MyLanIP);
-	st_info("-------------------------------------------\n");
-}
-
 HLE_S32 iPN_StringEnc(const HLE_S8 *keystr, const HLE_S8 *src, HLE_S8 *dest, HLE_U32 maxsize)
 {
 	HLE_S32 Key[17] = {0};
@@ -389,7 +375,7 @@ void *Thread_LoginStatus_Check(void *arg)
 		}	
 		DEBUG_LOG("PPCS_LoginStatus_Check....\n");
 		
-		if (ERROR_PPCS_SUCCESSFUL == PPCS_LoginStatus_Check(&LoginStatus))
+		if (ERROR_PPCS_SUCCESSFUL == g_transport->login_status(&LoginStatus))
 		{
 			if (1 == LoginStatus) 
 			{
@@ -456,11 +442,11 @@ void *ThreadWrite(void *arg)
 	ULONG TotalSize = 0;
 	UINT32 WriteSize = 0;
 	UINT32 tick = getTickCount();
-	while (ERROR_PPCS_SUCCESSFUL == (Check_ret = PPCS_Check_Buffer(gSessionID, Channel, &WriteSize, NULL)))
+	while (ERROR_PPCS_SUCCESSFUL == (Check_ret = p2p_check_buffer(gSessionID, Channel, &WriteSize)))
 	{
 		if ((WriteSize < 256*1024) && (TotalSize < TOTAL_WRITE_SIZE))
 		{
-			ret = PPCS_Write(gSessionID, Channel, (CHAR*)Buffer, TEST_WRITE_SIZE);
+			ret = p2p_send(gSessionID, Channel, Buffer, TEST_WRITE_SIZE);
 			if (0 > ret)
 			{
 				if (ERROR_PPCS_SESSION_CLOSED_TIMEOUT == ret)
@@ -517,7 +503,7 @@ void *ThreadRead(void *arg)
 	{
 		UCHAR zz = 0;
 		INT32 ReadSize = 1;
-		INT32 ret = PPCS_Read(gSessionID, Channel, (HLE_S8 *)&zz, &ReadSize, timeout_ms);
+		INT32 ret = p2p_recv(gSessionID, Channel, &zz, &ReadSize, timeout_ms);
 		//st_info("PPCS_Read ret=%d, CH=%d, ReadSize=%d Byte, TotalSize=%lu Byte, zz=%d\n", ret, Channel, ReadSize, TotalSize, zz);
 		
 		if ((ret < 0) && (ret != ERROR_PPCS_TIME_OUT))
@@ -635,7 +621,7 @@ HLE_S32 ft_Test(void)
 	HLE_U32 tick = getTickCount();
 	while (!feof(fp))
 	{				
-		ret = PPCS_Check_Buffer(gSessionID, CH_DATA, &wsize, NULL);
+		ret = p2p_check_buffer(gSessionID, CH_DATA, &wsize);
 		if (0 > ret)
 		{
 			st_info("PPCS_Check_Buffer ret=%d %s\n", ret, getP2PErrorCodeInfo(ret));
@@ -661,7 +647,7 @@ HLE_S32 ft_Test(void)
 			continue;
 		}
 		
-		ret = PPCS_Write(gSessionID, CH_DATA, buf, DataSize);
+		ret = p2p_send(gSessionID, CH_DATA, buf, DataSize);
 		if (0 > ret)
 		{
 			if (ERROR_PPCS_SESSION_CLOSED_TIMEOUT == ret)
@@ -685,7 +671,7 @@ HLE_S32 ft_Test(void)
 			setbuf(stdout, NULL);
 		}	
 	}
-	while (ERROR_PPCS_SUCCESSFUL == PPCS_Check_Buffer(gSessionID, CH_DATA, &wsize, NULL))
+	while (ERROR_PPCS_SUCCESSFUL == p2p_check_buffer(gSessionID, CH_DATA, &wsize))
 	{
 		//st_info("gSessionID=%d, CH=%d, wsize=%d\n", gSessionID, CH_DATA, wsize);
 		//setbuf(stdout, NULL);
@@ -716,7 +702,7 @@ HLE_S32 pkt_Test(void)
 		HLE_S8 PktBuf[1024];
 		memset(PktBuf, (UCHAR)(i % 100), sizeof(PktBuf));// data: 0~99
 		
-		HLE_S32 ret = PPCS_PktSend(gSessionID, CH_DATA, PktBuf, sizeof(PktBuf));
+		HLE_S32 ret = p2p_send(gSessionID, CH_DATA, PktBuf, sizeof(PktBuf));
 		
 		DEBUG_LOG("PPCS_PktSend: ret=%d, session=%d, channel=%d, data=%d..., size=%lu\n", ret, gSessionID, CH_DATA, PktBuf[0], sizeof(PktBuf));
 		
@@ -800,9 +786,9 @@ HLE_S32 Call_P2P_Listen(const HLE_S8 *Did, const HLE_S8 *APILicense)
 
 	st_Time_Info TimeBegin, TimeEnd;
 
-	DEBUG_LOG("PPCS_Listen('%s', 600, 0, 1, '%s')...\n", _DID_, APILicense);
+	DEBUG_LOG("%s listen('%s', 600, '%s')...\n", g_transport->name, Did, APILicense);
 	my_GetCurrentTime(&TimeBegin);	
-	gSessionID = PPCS_Listen(Did, 600, 0, 1, APILicense);//10分钟超时
+	gSessionID = g_transport->listen(Did, 600, APILicense);//10分钟超时
 	my_GetCurrentTime(&TimeEnd);
 	
 	if (gSessionID < 0)
@@ -814,13 +800,14 @@ HLE_S32 Call_P2P_Listen(const HLE_S8 *Did, const HLE_S8 *APILicense)
 	}
 	// Success!! gSessionID>=0
 	HLE_S32 ret = -1;
-	st_PPCS_Session Sinfo;	
-	if (ERROR_PPCS_SUCCESSFUL == (ret = PPCS_Check(gSessionID, &Sinfo)))//检查通过，有客户端成功接入。
+	struct sockaddr_in RemoteAddr;
+	HLE_S32 Mode = 0;
+	if (ERROR_PPCS_SUCCESSFUL == (ret = g_transport->check(gSessionID, &RemoteAddr, &Mode)))//检查通过，有客户端成功接入。
 	{
 		DEBUG_LOG("RemoteAddr=%s:%d, Mode=%s, Time=%d.%03d (Sec)\n", 
-				inet_ntoa(Sinfo.RemoteAddr.sin_addr), 
-				ntohs(Sinfo.RemoteAddr.sin_port), 
-				(Sinfo.bMode == 0)? "P2P":"RLY",
+				inet_ntoa(RemoteAddr.sin_addr), 
+				ntohs(RemoteAddr.sin_port), 
+				(Mode == 0)? "P2P":"RLY",
 				ST_TIME_USED/1000,
 				ST_TIME_USED%1000);
 		return gSessionID;
@@ -828,7 +815,7 @@ HLE_S32 Call_P2P_Listen(const HLE_S8 *Did, const HLE_S8 *APILicense)
 	else // connect success, but remote session closed
 	{
 		DEBUG_LOG("RemoteAddr=Unknown (remote closed), Mode=Unknown, Time=%d.%03d (Sec)\n", ST_TIME_USED/1000, ST_TIME_USED%1000);
-		PPCS_Close(gSessionID);
+		p2p_close(gSessionID);
 		DEBUG_LOG("--PPCS_Close(%d).\n", gSessionID);
 		return ret;
 	}
@@ -851,6 +838,12 @@ HLE_S32 p2p_init(p2p_handle_t *P2P_handle )
 		return -1;
 	}
 	
+	if(NULL == g_transport)
+	{
+		g_transport = (P2P_TRANSPORT_TCP == P2P_TRANSPORT_DEFAULT) ? &g_p2p_transport_tcp :
+					  (P2P_TRANSPORT_UDP == P2P_TRANSPORT_DEFAULT) ? &g_p2p_transport_udp : &g_p2p_transport_ppcs;
+	}
+	
 	//初始化p2p连接参数句柄
 	memset(P2P_handle,0,sizeof(p2p_handle_t));
 	P2P_handle->Did = (HLE_S8*)_DID_;
@@ -865,7 +858,7 @@ HLE_S32 p2p_init(p2p_handle_t *P2P_handle )
 
 	P2P_handle->InitString = (HLE_S8*)INITSTRING;
 #ifdef P2P_SUPORT_WAKEUP
-	P2P_handle->WakeupKey = (HLE_S8*)WAKEUPKEY;
+	P2P_handle->WakeupKey = g_transport->support_wakeup ? (HLE_S8*)WAKEUPKEY : NULL; //TCP/UDP 传输没有唤醒服务器
 	//memcpy(P2P_handle->IP[0],&g_WakeUpServerIP[0],sizeof(g_WakeUpServerIP));
 	strcpy((HLE_S8*)&P2P_handle->IP[0],SERVER_IP1);
 	strcpy((HLE_S8*)&P2P_handle->IP[1],SERVER_IP2);
@@ -880,13 +873,6 @@ HLE_S32 p2p_init(p2p_handle_t *P2P_handle )
 	P2P_status = wakeup;
 	
 	
-	// 1. get P2P API Version
-	UINT32 APIVersion = PPCS_GetAPIVersion();
-	st_info("P2P API Version: %d.%d.%d.%d\n",
-							(APIVersion & 0xFF000000)>>24, 
-							(APIVersion & 0x00FF0000)>>16, 
-							(APIVersion & 0x0000FF00)>>8, 
-							(APIVersion & 0x000000FF)>>0);
 	//参数合法性检查
 #ifdef P2P_SUPORT_WAKEUP
 	HLE_S32 useless_ip = 0;  //无效的ip数
@@ -971,11 +957,17 @@ HLE_S32 p2p_init(p2p_handle_t *P2P_handle )
 #endif
 
 	// 2. P2P Initialize
-	INT32 ret = PPCS_Initialize((HLE_S8 *)P2P_handle->InitString);
-	DEBUG_LOG("PPCS_Initialize done! ret=%d\n", ret);
+	INT32 ret = g_transport->init(g_transport == &g_p2p_transport_ppcs ? P2P_handle->InitString : g_transport_param);
 	if (ERROR_PPCS_SUCCESSFUL != ret && ERROR_PPCS_ALREADY_INITIALIZED != ret)
 	{
-		ERROR_LOG("PPCS_Initialize failed!! ret=%d: %s\n", ret, getP2PErrorCodeInfo(ret));
+		ERROR_LOG("%s init failed!! ret=%d: %s\n", g_transport->name, ret, getP2PErrorCodeInfo(ret));
+		return -1;
+	}
+
+	//会话反应器（信令线程 + 流线程）
+	if(reactor_start(P2P_handle) < 0)
+	{
+		ERROR_LOG("reactor_start failed!\n");
 		return -1;
 	}
 
@@ -1001,14 +993,12 @@ HLE_S32 p2p_conect(p2p_handle_t *P2P_handle)
 	}
 	
 	// 3. Network Detect
-	st_PPCS_NetInfo NetInfo;
-	HLE_S32 ret = PPCS_NetworkDetect(&NetInfo, 0);
+	HLE_S32 ret = g_transport->net_detect ? g_transport->net_detect() : 0;
 	if (0 > ret) 
 	{
 		st_info("PPCS_NetworkDetect failed: ret=%d\n", ret);
 		return -1;
 	}
-	showNetwork(NetInfo);
 
 
 #ifdef P2P_SUPORT_WAKEUP
@@ -1021,7 +1011,7 @@ HLE_S32 p2p_conect(p2p_handle_t *P2P_handle)
 		if (0 > iPN_StringEnc(WAKEUPKEY, _DID_, CMD, sizeof(CMD))) 
 		{
 			st_info("StringEncode failed.\n");
-			ret = PPCS_DeInitialize();
+			ret = g_transport->deinit();
 			DEBUG_LOG("PPCS_DeInitialize() done!\n");
 			return -1;
 		}
@@ -1122,7 +1112,7 @@ HLE_S32 P2P_wait_for_wakeup(p2p_handle_t *P2P_handle)
 
 	if(NULL == P2P_handle->WakeupKey)
 	{
-		return WAKEUP_ERR;
+		return NOT_SUPPORT_WAKEUP;
 	}
 	
 	if(P2P_handle->skt < 0) 
@@ -1217,7 +1207,7 @@ HLE_S32 P2P_wait_for_wakeup(p2p_handle_t *P2P_handle)
 						if (0 >= size_R) 
 						{
 							ERROR_LOG("\nTCP read failed(%d)\n", size_R);
-							if (ERROR_PPCS_SUCCESSFUL == PPCS_LoginStatus_Check(&LoginStatus))
+							if (ERROR_PPCS_SUCCESSFUL == g_transport->login_status(&LoginStatus))
 							{
 							
 								if (1 == LoginStatus) 
@@ -1227,7 +1217,7 @@ HLE_S32 P2P_wait_for_wakeup(p2p_handle_t *P2P_handle)
 								else 
 								{
 									P2P_status = offline;
-									PPCS_ForceClose(P2P_handle->SessionID);
+									g_transport->force_close(P2P_handle->SessionID);
 									st_info("No Server Response!!!\n");
 									
 									return SERVERS_OFFLINE;
@@ -1286,7 +1276,7 @@ HLE_S32 p2p_listen(p2p_handle_t *P2P_handle)
 {
 	if( P2P_status != sleeping)
 	{
-		if (0 == gThread_bRunning) 
+		if (0 == gThread_bRunning && g_transport->login_status) 
 		{
 			//DEBUG_LOG("into CreateThread_LoginStatus_Check\n");
 			CreateThread_LoginStatus_Check();
@@ -1312,6 +1302,7 @@ HLE_S32 p2p_listen(p2p_handle_t *P2P_handle)
 		else
 		{
 			ERROR_LOG("too many client connect!\n ");
+			mSleep(100); //TCP/UDP 传输不走休眠流程，会话满时这里避免空转
 			return -1;
 		}
 	
@@ -1326,7 +1317,8 @@ HLE_S32 p2p_listen(p2p_handle_t *P2P_handle)
 
 /***********************************************************************************************
 *函数名 ：	   P2P_client_task_create
-*功能描述 ：创建专门的task线程去和客户端交互，针对接入的客户端。
+*功能描述 ：把接入的客户端交给会话反应器（media_server_reactor.c），由固定的信令线程和流线程服务，
+*			不再为每个客户端创建线程。
 *参数 ： 	   P2P_handle
 *返回值 ：	
 *		成功： 0
@@ -1335,156 +1327,88 @@ HLE_S32 p2p_listen(p2p_handle_t *P2P_handle)
 ***********************************************************************************************/
 HLE_S32 P2P_client_task_create(p2p_handle_t *P2P_handle)
 {
-
-	pthread_t taskid;
-	
-	HLE_S32 ret = pthread_create(&taskid,NULL,P2P_client_task_func,(void*)P2P_handle);  
-    if(ret != 0)  
-    {  
-        ERROR_LOG("Create pthread error!\n");  
-    	return -1;  
-    }
-	
-	
-	return 0;
-}
-
-/***********************************************************************************************
-*函数名 ：	   P2P_client_task_func
-*功能描述 ：task线程的线程响应函数。
-*参数 ： 	   P2P_handle
-*返回值 ：void*	
-*	
-*	
-***********************************************************************************************/
-void * P2P_client_task_func(void*P2P_handle)
-{
-	pthread_detach(pthread_self());
-	
 	if(NULL == P2P_handle)
 	{
 		ERROR_LOG("illegal argument!!\n");
-		return NULL;
+		return -1;
 	}
-	DEBUG_LOG("Thread create: %s :[tid:%lu]\n", __FUNCTION__, pthread_self());
-
-	p2p_handle_t *Session_handle = P2P_handle;
-	
-	pthread_mutex_lock(&Session_handle->lock);
-	Session_handle->Session_num ++;
-	pthread_mutex_unlock(&Session_handle->lock);
 	
-	//对当前客户端的SessionID进行备份,并加入状态数组。
-	HLE_S32 SessionID = Session_handle->SessionID;	
-	HLE_S32 index = add_one_session_to_arr(SessionID);
-	if(index < 0)
-	{
-		ERROR_LOG("too many client connected !\n");
-		pthread_exit(NULL);
-	}
+	return reactor_add_session(P2P_handle->SessionID);
+}
 
-	session_status_t status;
-	memset(&status,0,sizeof(session_status_t));
-	get_session_status(SessionID,&status);
-	status.Session_status = ONLINE;
-	set_session_status(SessionID,&status);
-	
-	cmd_header_t cmd_header;
-	HLE_S32 ReadSize;
-	
-	st_PPCS_Session Sinfo;
-	memset(&Sinfo,0,sizeof(st_PPCS_Session));
-	
-	while(ONLINE == is_session_online(SessionID) )//客户端没退出
+/***********************************************************************************************
+*函数名 ：	   p2p_transport_select / p2p_transport_get
+*功能描述 ：选择/获取传输层，p2p_init 之前选择，之后不能再切换。
+***********************************************************************************************/
+HLE_S32 p2p_transport_select(HLE_S32 type, const HLE_S8 *param)
+{
+	switch(type)
 	{
-		memset(&Sinfo,0,sizeof(st_PPCS_Session));
-		memset(&cmd_header,0,sizeof(cmd_header_t));
-		//读取信令头
-		ReadSize = sizeof(cmd_header_t);
-	
-		//PPCS_Read 每次返回后，ReadSize 会被填入实际读到的字节数。
-		HLE_S32 ret = PPCS_Read(SessionID, CH_CMD, (CHAR*)&cmd_header, &ReadSize, 2000);
-		if(ret < 0)//读取出错
-		{
-			if (ERROR_PPCS_TIME_OUT == ret) 
-			{
-				//DEBUG_LOG("Read CMD Header timeout !!\n");
-				usleep(50*1000);
-				continue;
-			}	
-			else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) //远程会话关闭（客户端退出）
-			{
-			
-				ERROR_LOG("Remote site call close!!\n");
-				break;
-				
-			}
-			else //都默认为客户端已经退出
-			{
-				ERROR_LOG("PPCS_Read: Channel=%d, ret=%d\n", CH_CMD, ret);
-				//usleep(1000*500);
-				break;
-			}
-				
-
-		}
-		else if(ReadSize != sizeof(cmd_header_t))
-		{
-			ERROR_LOG("PPCS_Read CMD header error!\n");
-			continue;
-		}
-
-		DEBUG_LOG("PPCS_Read CMD Header success! SessionID(%d) read(%d)bytes!\n",SessionID,ReadSize);
-		DEBUG_LOG("cmd_header.command = %#x\n",cmd_header.command);
-		
-		//信令头读取成功！对信令进行解析
-		med_ser_cmd_parse(SessionID,&cmd_header,ReadSize);
-		usleep(100*1000);
-	
-
+		case P2P_TRANSPORT_PPCS:	g_transport = &g_p2p_transport_ppcs;	break;
+		case P2P_TRANSPORT_TCP:		g_transport = &g_p2p_transport_tcp;		break;
+		case P2P_TRANSPORT_UDP:		g_transport = &g_p2p_transport_udp;		break;
+		default:
+			ERROR_LOG("illegal transport type(%d)!\n", type);
+			return -1;
 	}
+	g_transport_param = param;
+	DEBUG_LOG("p2p transport: %s\n", g_transport->name);
+	return 0;
+}
 
-	mSleep(50);
-	
-	
-	del_one_session_from_arr(SessionID);
-	PPCS_Close(SessionID);
-
-	pthread_mutex_lock(&Session_handle->lock);
-	Session_handle->Session_num --;
-	if(Session_handle->Session_num < 0)
-		Session_handle->Session_num = 0;
-	
-	pthread_mutex_unlock(&Session_handle->lock);
-	
-	DEBUG_LOG("--PPCS_Close(%d)\n", SessionID);
-		
-	pthread_exit(0);
-
-	return NULL;
+const p2p_transport_t *p2p_transport_get(const HLE_S8 **param)
+{
+	if(param)
+		*param = g_transport_param;
+	return g_transport;
 }
 
 //recv
-HLE_S32 p2p_recv(void *handle,void*buf,HLE_S32 length)
+HLE_S32 p2p_recv(HLE_S32 SessionID, HLE_U8 Channel, void *buf, HLE_S32 *length, HLE_U32 timeout_ms)
 {
-
-	return 0;
+	return g_transport->read(SessionID, Channel, buf, length, timeout_ms);
 }
 
 //send
-HLE_S32 p2p_send(void *handle,const void*data,HLE_S32 length)
+HLE_S32 p2p_send(HLE_S32 SessionID, HLE_U8 Channel, const void *data, HLE_S32 length)
 {
-	return 0;
+	return g_transport->write(SessionID, Channel, data, length);
 }
 
-//close
-HLE_S32 p2p_close(void *handle)
+//sendv
+HLE_S32 p2p_sendv(HLE_S32 SessionID, HLE_U8 Channel, const struct iovec *iov, HLE_S32 iovcnt)
 {
-	return 0;
-}
-
-
+	HLE_S32 i, ret, total = 0;
 
+	if(g_transport->writev)
+		return g_transport->writev(SessionID, Channel, iov, iovcnt);
+	for(i = 0; i < iovcnt; i++)
+	{
+		ret = g_transport->write(SessionID, Channel, iov[i].iov_base, iov[i].iov_len);
+		if(ret < 0)
+			return ret;
+		total += ret;
+	}
+	return total;
+}
 
+//check buffer
+HLE_S32 p2p_check_buffer(HLE_S32 SessionID, HLE_U8 Channel, HLE_U32 *wsize)
+{
+	return g_transport->check_buffer(SessionID, Channel, wsize);
+}
 
+//close
+HLE_S32 p2p_close(HLE_S32 SessionID)
+{
+	return g_transport->close(SessionID);
+}
 
+//deinit
+HLE_S32 p2p_deinit(void)
+{
+	if(NULL == g_transport)
+		return 0;
+	reactor_stop();
+	return g_transport->deinit();
+}
@@ -14,6 +14,7 @@
 
 #include "typeport.h"
 #include "in.h"
+#include "p2p_transport.h"
 
 
 
@@ -28,7 +29,9 @@
 #define SIZE_INITSTRING 	256	// InitString Size
 #define SIZE_WAKEUP_KEY 	17	// WakeUp Key Size
 
-#define MAX_CLIENT_NUM 		10  //最大能同时接入的客户端数量
+#ifndef MAX_CLIENT_NUM
+#define MAX_CLIENT_NUM 		10  //最大能同时接入的客户端数量（主机压测时可以在编译参数中加大）
+#endif
 #define P2P_TSK_PRIO        4	//P2P线程的创建优先级（LiteOS下）
 //#define P2P_SUPORT_WAKEUP     //放在makefile中定义了
 
@@ -107,19 +110,28 @@ HLE_S32 P2P_wait_for_wakeup(p2p_handle_t *P2P_handle);
 //listen
 HLE_S32 p2p_listen(p2p_handle_t *P2P_handle);
 
-//客户端任务入口函数（每个客户端接入。都会创建一个线程，专程处理该客户端的业务）。
+//把接入的客户端（P2P_handle->SessionID）交给会话反应器处理
 HLE_S32 P2P_client_task_create(p2p_handle_t *P2P_handle);
 
-void * P2P_client_task_func(void*P2P_handle);
+/*以下收发接口转调当前传输层（p2p_transport.h），返回值和错误码与 PPCS_Read/PPCS_Write 一致*/
+
+//recv：读满 *length 字节返回 0，超时返回 ERROR_PPCS_TIME_OUT，*length 返回实际读到的字节数
+HLE_S32 p2p_recv(HLE_S32 SessionID, HLE_U8 Channel, void *buf, HLE_S32 *length, HLE_U32 timeout_ms);
 
-//recv
-HLE_S32 p2p_recv(void *handle,void*buf,HLE_S32 length);
+//send：成功返回写入的字节数
+HLE_S32 p2p_send(HLE_S32 SessionID, HLE_U8 Channel, const void *data, HLE_S32 length);
 
-//send
-HLE_S32 p2p_send(void *handle,const void*data,HLE_S32 length);
+//sendv：iov 中的数据按顺序连续发送，传输层不支持聚合写时逐段 send，成功返回写入的总字节数
+HLE_S32 p2p_sendv(HLE_S32 SessionID, HLE_U8 Channel, const struct iovec *iov, HLE_S32 iovcnt);
+
+//查询通道中还没发送出去的字节数
+HLE_S32 p2p_check_buffer(HLE_S32 SessionID, HLE_U8 Channel, HLE_U32 *wsize);
 
 //close
-HLE_S32 p2p_close(void *handle); 
+HLE_S32 p2p_close(HLE_S32 SessionID); 
+
+//反初始化传输层
+HLE_S32 p2p_deinit(void);
 
 const HLE_S8 *getP2PErrorCodeInfo(HLE_S32 err);
 void st_info(const HLE_S8 *format, ...);
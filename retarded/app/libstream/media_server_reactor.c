@@ -0,0 +1,886 @@
+/*********************************************************************************
+  *FileName: media_server_reactor.c
+  *Create Date: 2026/10/19
+  *Description: P2P 会话反应器，取代原来每个客户端一个信令线程、每路实时流一个发送线程的模型。
+  *Others:
+  *	 1.信令线程：用传输层 poll 同时等待所有会话的 CH_CMD，不阻塞地收信令头和信令体（每个会话各自的缓存），
+  *	   整条信令收齐后交给 med_ser_cmd_parse，命令处理函数不再从传输层读数据。
+  *	   会话下线（对端关闭、logout、发送连续失败）也由该线程统一清理，保证 p2p_close 只调用一次。
+  *	 2.流线程：每路码流一个广播组，组里只向编码模块申请一个队列（不管有多少个观看者），
+  *	   队列由空变为非空时编码线程回调通知，流线程把帧取进组的环形缓存，各会话用自己的游标
+  *	   从环里按顺序发送（多帧合成一次 p2p_sendv，直接引用编码包，不拷贝），
+  *	   所有观看者都发过（或丢弃）的帧才归还编码模块。没有帧时休眠等待通知。
+  *	 3.ABR（media_server_abr.c）：流线程每 ABR_SAMPLE_INTERVAL 给每个会话采样一次发送缓存，
+  *	   会话档位在主/子码流间变化时切换广播组，子码流广播组的编码参数取观看者档位的中位数，通过 encoder_set_rate_ctrl 设置；
+  *	   主码流（ABR_RECORD_STREAM）录像也在用，编码参数不随观看者变化，观看者的链路跟不上时切到子码流。
+  *	 4.会话表和 SessionStatus 共用下标，会话 ID 到下标的查找由 SessionStatus 的哈希索引完成。
+  *History:
+**********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "PPCS_Error.h"
+#include "media_server_interface.h"
+#include "media_server_signal_def.h"
+#include "media_server_signal_parse.h"
+#include "media_server_p2p.h"
+#include "media_server_reactor.h"
+#include "media_server_abr.h"
+#include "metrics.h"
+
+
+extern med_ser_init_info_t g_med_ser_envir;
+extern unsigned long getTickCount(void);
+
+/*
+ * 实时流状态（流线程使用，live_lock 保护）
+ */
+typedef struct _reactor_living_t
+{
+	HLE_S32 used;
+	HLE_S32 group;					//所在广播组（g_reactor.group 下标）
+	HLE_U32 cursor;					//下一个要发送的帧在广播组中的序号
+	HLE_U32 videoType;
+	HLE_U32 openAudio;
+	HLE_S8  first_is_iframe;		//初次进入码流发送状态需要等到I帧
+	HLE_S8  discard_flag;			//丢帧标记（发送缓存超过阈值，丢到下一个I帧）
+	HLE_S8  write_err_count;		//连续发送失败次数
+	HLE_U32 sent_bytes;				//累计写入传输层的字节数（ABR 吞吐估计）
+	abr_session_t abr;
+}reactor_living_t;
+
+/*
+ * 广播组缓存的一帧（持有编码包的一个引用）
+ */
+typedef struct _reactor_frame_t
+{
+	void *pack_addr;
+	void *frame_addr;
+	HLE_S32 length;
+	HLE_U8 type;					//FRAME_HDR.type
+}reactor_frame_t;
+
+/*
+ * 广播组：同一路码流的所有观看者共用一个编码队列和一个帧环（live_lock 保护）
+ */
+typedef struct _reactor_group_t
+{
+	HLE_S32 queue_id;				//encoder_request_stream 返回的码流队列，-1：没有观看者
+	HLE_S32 viewers;				//观看者数量
+	HLE_U32 head;					//下一个写入环的帧序号
+	HLE_U32 tail;					//环中最旧的帧序号（head - tail 为环中帧数）
+	HLE_S32 rung;					//编码器当前的 ABR 档位，-1：没有设置过（编码器默认参数）
+	HLE_U32 rate_bytes;				//码率统计窗口内取到的字节数
+	HLE_U32 rate_ms;				//码率统计窗口的起始时间
+	reactor_frame_t ring[REACTOR_GROUP_RING];
+}reactor_group_t;
+
+/*
+ * 会话（下标与 SessionStatus 相同）
+ */
+typedef struct _reactor_session_t
+{
+	HLE_S32 used;					//sess_lock 保护
+	HLE_S32 SessionID;
+	HLE_U32 cmd_buf[REACTOR_CMD_MAX / 4];	//正在接收的信令：信令头 + 信令体（只有信令线程访问）
+	HLE_S32 cmd_len;				//已收到的字节数
+	reactor_living_t living;
+}reactor_session_t;
+
+typedef struct _reactor_t
+{
+	HLE_S32 running;				//reactor_stop 置 0，两个线程不加锁读取（原子访问）
+	p2p_handle_t *handle;
+	pthread_t cmd_tid;
+	pthread_t stream_tid;
+
+	pthread_mutex_t sess_lock;		//会话的添加/删除
+	pthread_cond_t sess_cond;		//没有会话时信令线程在这里等待
+	pthread_mutex_t live_lock;		//实时流状态，流线程发送一轮期间持有
+	pthread_mutex_t ev_lock;		//编码队列通知（编码线程回调，只做置位，不能和发送抢锁）
+	pthread_cond_t ev_cond;
+	HLE_S32 ev_pending;
+
+	reactor_group_t group[REACTOR_GROUP_NUM];	//下标即 encoder_request_stream 的 stream_index
+	HLE_U32 base_kbps[REACTOR_GROUP_NUM];		//各码流在拥塞等级 0 时的码率（实测换算，ABR 用）
+	reactor_session_t session[MAX_CLIENT_NUM];
+}reactor_t;
+
+static reactor_t g_reactor =
+{
+	.running = 0,
+	.sess_lock = PTHREAD_MUTEX_INITIALIZER,
+	.sess_cond = PTHREAD_COND_INITIALIZER,
+	.live_lock = PTHREAD_MUTEX_INITIALIZER,
+	.ev_lock = PTHREAD_MUTEX_INITIALIZER,
+	.ev_cond = PTHREAD_COND_INITIALIZER,
+	.group = {{.queue_id = -1, .rung = -1}, {.queue_id = -1, .rung = -1}},
+};
+
+
+static inline HLE_S32 reactor_running(void)
+{
+	return __atomic_load_n(&g_reactor.running, __ATOMIC_RELAXED);
+}
+
+
+/*---# 会话状态辅助 ------------------------------------------------------------*/
+static void reactor_set_offline(HLE_S32 SessionID)
+{
+	session_status_t status;
+	memset(&status,0,sizeof(status));
+	if(get_session_status(SessionID,&status) < 0)
+		return;
+	status.stream_status = CLOSE;
+	status.Session_status = OFFLINE;
+	set_session_status(SessionID,&status);
+}
+
+static void reactor_set_stream(HLE_S32 SessionID, HLE_S8 stream_status, HLE_S8 current_stream)
+{
+	session_status_t status;
+	memset(&status,0,sizeof(status));
+	if(get_session_status(SessionID,&status) < 0)
+		return;
+	status.stream_status = stream_status;
+	status.current_stream = current_stream;
+	set_session_status(SessionID,&status);
+}
+
+static void reactor_wakeup_cmd(void)
+{
+	const p2p_transport_t *transport = p2p_transport_get(NULL);
+	if(transport && transport->wakeup)
+		transport->wakeup();
+}
+
+
+/*---# 流线程 ------------------------------------------------------------*/
+
+/*编码线程回调：某个会话的码流队列由空变为非空*/
+static void reactor_stream_notify(void *arg)
+{
+	pthread_mutex_lock(&g_reactor.ev_lock);
+	g_reactor.ev_pending = 1;
+	pthread_cond_signal(&g_reactor.ev_cond);
+	pthread_mutex_unlock(&g_reactor.ev_lock);
+}
+
+/*把环中序号小于 seq 的帧归还编码模块，调用者持有 live_lock*/
+static void reactor_group_release(reactor_group_t *group, HLE_U32 seq)
+{
+	while((HLE_S32)(seq - group->tail) > 0)
+	{
+		reactor_frame_t *frame = &group->ring[group->tail % REACTOR_GROUP_RING];
+		g_med_ser_envir.encoder_release_packet(frame->pack_addr);
+		frame->pack_addr = NULL;
+		group->tail ++;
+	}
+}
+
+/*从编码队列取帧放入环，直到队列取空或环满，返回取到的帧数，调用者持有 live_lock*/
+static HLE_S32 reactor_group_fill(reactor_group_t *group)
+{
+	HLE_S32 got = 0;
+
+	while(group->head - group->tail < REACTOR_GROUP_RING)
+	{
+		reactor_frame_t *frame = &group->ring[group->head % REACTOR_GROUP_RING];
+		if(g_med_ser_envir.encoder_try_get_packet(group->queue_id, 1, &frame->pack_addr,
+												  &frame->frame_addr, &frame->length) < 0 || NULL == frame->pack_addr)
+		{
+			frame->pack_addr = NULL;
+			break;
+		}
+		frame->type = ((FRAME_HDR *)frame->frame_addr)->type;
+		group->rate_bytes += frame->length;
+		group->head ++;
+		got ++;
+	}
+	if(got)
+		METRICS_GAUGE(MET_G_NET_RING, group->head - group->tail);
+	return got;
+}
+
+/*归还所有观看者都已经发过的帧，调用者持有 live_lock*/
+static void reactor_group_trim(HLE_S32 index)
+{
+	reactor_group_t *group = &g_reactor.group[index];
+	HLE_U32 min = group->head;
+	HLE_S32 i;
+
+	for(i = 0; i < MAX_CLIENT_NUM; i++)
+	{
+		reactor_living_t *living = &g_reactor.session[i].living;
+		if(living->used && living->group == index && (HLE_S32)(living->cursor - min) < 0)
+			min = living->cursor;
+	}
+	reactor_group_release(group, min);
+}
+
+/*离开广播组，最后一个观看者离开时释放编码队列，调用者持有 live_lock*/
+static void reactor_living_free(reactor_living_t *living)
+{
+	if(!living->used)
+		return;
+	living->used = 0;
+
+	reactor_group_t *group = &g_reactor.group[living->group];
+	group->viewers --;
+	if(group->viewers > 0)
+	{
+		reactor_group_trim(living->group);
+		return;
+	}
+	g_med_ser_envir.encoder_set_packet_notify(group->queue_id, NULL, NULL);
+	reactor_group_release(group, group->head);
+	g_med_ser_envir.encoder_free_stream(group->queue_id);
+	if(group->rung >= 0 && g_med_ser_envir.encoder_set_rate_ctrl) //没有观看者了，编码参数恢复默认（录像等也在用这路码流）
+		g_med_ser_envir.encoder_set_rate_ctrl(0, living->group, 0, 1, 1);
+	group->rung = -1;
+	DEBUG_LOG("stream group(%d) queue(%d) freed\n", living->group, group->queue_id);
+	group->queue_id = -1;
+	group->viewers = 0;
+}
+
+/*连续发送失败太多次，断定客户端已经断开，交给信令线程清理会话*/
+static void reactor_living_write_err(reactor_session_t *sess, HLE_S32 ret, HLE_S32 frames)
+{
+	reactor_living_t *living = &sess->living;
+
+	if (ERROR_PPCS_SESSION_CLOSED_TIMEOUT == ret)
+	{
+		ERROR_LOG("PPCS_Write  CH=%d, ret=%d, Session Closed TimeOUT!!\n", CH_STREAM, ret);
+	}
+	else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret)//远程会话关闭（客户端退出）
+	{
+		ERROR_LOG("PPCS_Write CH=%d, ret=%d, Session Remote Close!!\n", CH_STREAM, ret);
+	}
+	else
+	{
+		ERROR_LOG("PPCS_Write CH=%d, ret=%d  [%s]\n", CH_STREAM,ret, getP2PErrorCodeInfo(ret));
+	}
+
+	living->write_err_count += frames;
+	if(living->write_err_count >= MAX_WRITE_ERR_NUM)
+	{
+		ERROR_LOG("SessionID(%d) write failed %d times, offline!\n",sess->SessionID,living->write_err_count);
+		reactor_living_free(living);
+		reactor_set_offline(sess->SessionID);
+		reactor_wakeup_cmd();
+	}
+}
+
+/*帧的时间戳（毫秒，VENC u64PTS/1000 的低 32 位）*/
+static HLE_U32 reactor_frame_pts(const reactor_frame_t *frame)
+{
+	const HLE_U8 *info = (const HLE_U8 *)frame->frame_addr + sizeof(FRAME_HDR);
+
+	if(0xF8 == frame->type)
+		return (HLE_U32)((const IFRAME_INFO *)info)->pts_msec;
+	if(0xF9 == frame->type)
+		return (HLE_U32)((const PFRAME_INFO *)info)->pts_msec;
+	return (HLE_U32)((const AFRAME_INFO *)info)->pts_msec;
+}
+
+/*一次 p2p_sendv 成功后的统计：帧数、字节数、视频帧从编码到写入传输层的时延、逐帧跟踪*/
+static void reactor_living_metrics(HLE_S32 group, reactor_frame_t **sent, HLE_S32 num, HLE_S32 bytes)
+{
+	HLE_U32 now_ms = (HLE_U32)(metrics_now_us() / 1000);
+	HLE_S32 i;
+
+	METRICS_ADD(MET_C_NET_FRAMES, num);
+	METRICS_ADD(MET_C_NET_BYTES, bytes);
+	for(i = 0; i < num; i++)
+	{
+		HLE_U32 pts = reactor_frame_pts(sent[i]);
+		if(0xFA != sent[i]->type)
+			METRICS_HIST(MET_H_NET_MS, now_ms - pts);
+		METRICS_TRACE(TRACE_NET_SEND, group, sent[i]->type, pts, sent[i]->length);
+	}
+}
+
+/*******************************************************************************
+*@ Description    :把广播组中 cursor 之后的帧发给会话（原 cmd_open_living 循环体）
+*@ Input          :<sess>会话
+*@ Output         :
+*@ Return         :
+*@ attention      :调用者持有 live_lock；最多 REACTOR_SENDV_MAX 帧合成一次 p2p_sendv，
+					I 帧等待、音频过滤、拥塞丢帧仍然按会话各自判断
+*******************************************************************************/
+static void reactor_living_send(reactor_session_t *sess)
+{
+	reactor_living_t *living = &sess->living;
+	reactor_group_t *group = &g_reactor.group[living->group];
+	struct iovec iov[REACTOR_SENDV_MAX];
+	reactor_frame_t *sent[REACTOR_SENDV_MAX];
+	HLE_S32 ret, num;
+
+	while(living->used && living->cursor != group->head)
+	{
+		HLE_U32 wsize = 0;  //写缓存通道里边已经缓存的数据大小
+		ret = p2p_check_buffer(sess->SessionID, CH_STREAM, &wsize);
+		if (ret < 0)
+		{
+			ERROR_LOG("PPCS_Check_Buffer ret=%d %s\n", ret, getP2PErrorCodeInfo(ret));
+			living->cursor = group->head;
+			return;
+		}
+
+		//注意此处丢弃帧要按gop丢弃
+		if (wsize > LIVING_DISCARD_THRESHOLD) //超过阈值，全部丢弃，不再继续发送
+		{
+			if(0 == living->discard_flag)
+				ERROR_LOG("SessionID(%d) PPCS_Write buffer data = %d KB discard ALL frame\n",sess->SessionID,wsize/1024);
+			living->discard_flag = 1;
+			METRICS_ADD(MET_C_NET_DISCARD, group->head - living->cursor);
+			METRICS_TRACE(TRACE_NET_DISCARD, living->group, 0, group->head - living->cursor, wsize);
+			living->cursor = group->head;
+			return;
+		}
+
+		num = 0;
+		while(living->cursor != group->head && num < REACTOR_SENDV_MAX)
+		{
+			reactor_frame_t *frame = &group->ring[living->cursor % REACTOR_GROUP_RING];
+			living->cursor ++;
+
+			if(0xFA == frame->type && !living->openAudio) //不需要audio帧 ,则过滤
+				continue;
+			/*---# 寻找视频关键帧------------------------------------------------------------*/
+			if(0 == living->first_is_iframe)
+			{
+				if(frame->type != 0xF8)
+					continue;
+				living->first_is_iframe = 1; //找到视频关键帧,进入传输模式
+				DEBUG_LOG("SessionID(%d) I frame finded!\n",sess->SessionID);
+			}
+			if(1 == living->discard_flag)//退出丢帧模式时，保证第一帧是I帧
+			{
+				if(frame->type != 0xF8)
+					continue;
+				living->discard_flag = 0;
+				ERROR_LOG("SessionID(%d) END of discard ALL frame\n",sess->SessionID);
+			}
+			iov[num].iov_base = frame->frame_addr;
+			iov[num].iov_len = frame->length;
+			sent[num] = frame;
+			num ++;
+		}
+		if(0 == num)
+			continue;
+
+		ret = p2p_sendv(sess->SessionID, CH_STREAM, iov, num);
+		if (ret >= 0)
+		{
+			living->write_err_count = 0;
+			living->sent_bytes += ret;
+			if(METRICS_FLAGS())
+				reactor_living_metrics(living->group, sent, num, ret);
+		}
+		else
+		{
+			METRICS_INC(MET_C_NET_WRITE_ERR);
+			reactor_living_write_err(sess, ret, num);
+		}
+	}
+}
+
+/*******************************************************************************
+*@ Description    :加入广播组（该码流的第一个观看者申请编码队列）
+*@ Input          :<living>实时流状态（videoType/openAudio/abr 由调用者设置）
+					<stream_index>码流下标
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :调用者持有 live_lock
+*******************************************************************************/
+static HLE_S32 reactor_living_join(reactor_living_t *living, HLE_S32 stream_index)
+{
+	reactor_group_t *group = &g_reactor.group[stream_index];
+
+	if(group->queue_id < 0) //该码流的第一个观看者，向编码模块申请队列
+	{
+		//由 ABR 控制码率时该队列不参与 sdp 的自动码率控制（队列被流线程及时取空，它的拥塞等级本来也反映不了链路）
+		HLE_S32 auto_rc = (REACTOR_ABR_ENABLE && g_med_ser_envir.encoder_set_rate_ctrl) ? 0 : 1;
+		HLE_S32 queue_id = g_med_ser_envir.encoder_request_stream(0,stream_index,auto_rc);//里边自带强制 I 帧
+		if(queue_id < 0)
+		{
+			ERROR_LOG("encoder_request_stream failed !\n");
+			return -1;
+		}
+		DEBUG_LOG("------encoder_request_stream stream_id(%d) stream_index(%d)------\n",queue_id,stream_index);
+		group->queue_id = queue_id;
+		group->viewers = 0;
+		group->head = group->tail = 0;
+		group->rate_bytes = 0;
+		group->rate_ms = getTickCount();
+		g_med_ser_envir.encoder_set_packet_notify(queue_id, reactor_stream_notify, NULL);
+	}
+	else if(g_med_ser_envir.encoder_force_iframe) //加入已有的组，新观看者需要尽快等到 I 帧
+	{
+		g_med_ser_envir.encoder_force_iframe(0, stream_index);
+	}
+
+	living->group = stream_index;
+	living->cursor = group->head;
+	living->first_is_iframe = 0;
+	living->discard_flag = 0;
+	living->write_err_count = 0;
+	living->used = 1;
+	group->viewers ++;
+	return 0;
+}
+
+#if REACTOR_ABR_ENABLE
+/*ABR 档位换到另一路码流：切换广播组，失败时留在原来的码流，调用者持有 live_lock*/
+static void reactor_living_switch(reactor_session_t *sess, HLE_S32 old_rung)
+{
+	reactor_living_t *living = &sess->living;
+	HLE_S32 old_index = living->group;
+	HLE_S32 stream_index = abr_get_rung(living->abr.rung)->stream;
+
+	reactor_living_free(living);
+	if(reactor_living_join(living, stream_index) < 0)
+	{
+		ERROR_LOG("SessionID(%d) abr switch to stream(%d) failed!\n", sess->SessionID, stream_index);
+		living->abr.rung = old_rung;
+		if(reactor_living_join(living, old_index) < 0)
+		{
+			reactor_set_offline(sess->SessionID);
+			reactor_wakeup_cmd();
+			return;
+		}
+	}
+	living->videoType = (0 == living->group) ? MAIN_STREAM : LOWER_STREAM;
+	reactor_set_stream(sess->SessionID, OPEN, living->videoType);
+	DEBUG_LOG("SessionID(%d) abr switch to stream(%d)\n", sess->SessionID, living->group);
+}
+
+/*给会话采样发送缓存，档位换了码流时切换广播组；返回是否采样，调用者持有 live_lock*/
+static HLE_S32 reactor_living_abr(reactor_session_t *sess, HLE_U32 now)
+{
+	reactor_living_t *living = &sess->living;
+	HLE_U32 wsize = 0;
+
+	if(!abr_session_due(&living->abr, now))
+		return 0;
+	if(p2p_check_buffer(sess->SessionID, CH_STREAM, &wsize) < 0)
+		return 0;
+
+	HLE_S32 old = living->abr.rung;
+	HLE_S32 rung = abr_session_update(&living->abr, now, living->sent_bytes, wsize, g_reactor.base_kbps);
+	if(rung != old && abr_get_rung(rung)->stream != living->group)
+		reactor_living_switch(sess, old);
+	return 1;
+}
+
+/*******************************************************************************
+*@ Description    :统计广播组的码率，并按观看者的档位设置编码参数
+*@ Input          :<index>广播组下标
+					<now>当前时间（毫秒）
+*@ Output         :
+*@ Return         :
+*@ attention      :调用者持有 live_lock
+*******************************************************************************/
+static void reactor_group_rate(HLE_S32 index, HLE_U32 now)
+{
+	reactor_group_t *group = &g_reactor.group[index];
+	HLE_S32 rungs[MAX_CLIENT_NUM];
+	HLE_S32 i, num = 0;
+
+	/*实测码率换算到拥塞等级 0，ABR 用它估计各档位的码率*/
+	HLE_U32 dt = now - group->rate_ms;
+	if(dt >= REACTOR_RATE_WINDOW)
+	{
+		const abr_rung_t *r = abr_get_rung(group->rung);
+		HLE_U32 level = r ? r->level : 0;
+		HLE_U32 kbps = (HLE_U32)((HLE_U64)group->rate_bytes * 8 / dt);
+		if(kbps > 0)
+			g_reactor.base_kbps[index] = kbps * ABR_ENC_LEVEL_NUM / (ABR_ENC_LEVEL_NUM - level);
+		group->rate_bytes = 0;
+		group->rate_ms = now;
+	}
+
+	//录像用的码流不降码率（见 media_server_abr.h）
+	if(NULL == g_med_ser_envir.encoder_set_rate_ctrl || ABR_RECORD_STREAM == index)
+		return;
+	for(i = 0; i < MAX_CLIENT_NUM; i++)
+	{
+		reactor_living_t *living = &g_reactor.session[i].living;
+		if(living->used && living->group == index && abr_get_rung(living->abr.rung)->stream == index)
+			rungs[num++] = living->abr.rung;
+	}
+	HLE_S32 rung = abr_group_rung(rungs, num);
+	if(rung < 0 || rung == group->rung)
+		return;
+
+	const abr_rung_t *r = abr_get_rung(rung);
+	if(HLE_RET_OK != g_med_ser_envir.encoder_set_rate_ctrl(0, index, r->level, r->fps_div, r->gop_sec))
+		return;
+	DEBUG_LOG("stream group(%d) abr rung %d -> %d\n", index, group->rung, rung);
+	group->rung = rung;
+	group->rate_bytes = 0; //换档后重新统计码率
+	group->rate_ms = now;
+}
+#endif
+
+static void *reactor_stream_thread(void *args)
+{
+	HLE_S32 i, got;
+
+	DEBUG_LOG("Thread create: %s\n", __FUNCTION__);
+	while(reactor_running())
+	{
+		pthread_mutex_lock(&g_reactor.ev_lock);
+		while(!g_reactor.ev_pending && reactor_running())
+			pthread_cond_wait(&g_reactor.ev_cond, &g_reactor.ev_lock);
+		g_reactor.ev_pending = 0;
+		pthread_mutex_unlock(&g_reactor.ev_lock);
+
+		/*每一轮：各组取帧进环，各会话把环里的新帧发完，再归还所有人都发过的帧；直到所有队列都取空*/
+		pthread_mutex_lock(&g_reactor.live_lock);
+		do
+		{
+			got = 0;
+			for(i = 0; i < REACTOR_GROUP_NUM; i++)
+			{
+				if(g_reactor.group[i].viewers > 0)
+					got += reactor_group_fill(&g_reactor.group[i]);
+			}
+			for(i = 0; i < MAX_CLIENT_NUM; i++)
+			{
+				if(g_reactor.session[i].living.used)
+					reactor_living_send(&g_reactor.session[i]);
+			}
+			for(i = 0; i < REACTOR_GROUP_NUM; i++)
+			{
+				if(g_reactor.group[i].viewers > 0)
+					reactor_group_trim(i);
+			}
+		}while(got > 0 && reactor_running());
+
+#if REACTOR_ABR_ENABLE
+		HLE_U32 now = getTickCount();
+		HLE_S32 sampled = 0;
+		for(i = 0; i < MAX_CLIENT_NUM; i++)
+		{
+			if(g_reactor.session[i].living.used)
+				sampled += reactor_living_abr(&g_reactor.session[i], now);
+		}
+		for(i = 0; i < REACTOR_GROUP_NUM && sampled > 0; i++)
+		{
+			if(g_reactor.group[i].viewers > 0)
+				reactor_group_rate(i, now);
+		}
+#endif
+		pthread_mutex_unlock(&g_reactor.live_lock);
+	}
+	DEBUG_LOG("Thread exit: %s\n", __FUNCTION__);
+	return NULL;
+}
+
+HLE_S32 reactor_open_living(HLE_S32 SessionID, HLE_U32 videoType, HLE_U32 openAudio)
+{
+	session_status_t status;
+	HLE_S32 stream_index;
+
+	DEBUG_LOG("videoType(%d)  openAudio(%d)!\n",videoType,openAudio);
+	//目前只有 MAIN_STREAM 和 LOWER_STREAM 两道流
+	if(MAIN_STREAM == videoType)
+	{
+		stream_index = 0;
+	}
+	else if(LOWER_STREAM == videoType)
+	{
+		stream_index = 1;
+	}
+	else
+	{
+		ERROR_LOG("stream resolution(%u) not support ! \n",videoType);
+		return -1;
+	}
+	if(NULL == g_med_ser_envir.encoder_try_get_packet || NULL == g_med_ser_envir.encoder_set_packet_notify)
+	{
+		ERROR_LOG("encoder_try_get_packet/encoder_set_packet_notify not registered!\n");
+		return -1;
+	}
+
+	memset(&status,0,sizeof(status));
+	HLE_S32 index = get_session_status(SessionID,&status);
+	if(index < 0)
+	{
+		ERROR_LOG("get_session_status failed !\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(&g_reactor.live_lock);
+	reactor_living_t *living = &g_reactor.session[index].living;
+	reactor_living_free(living); //重复打开时切换码流
+
+	memset(living,0,sizeof(reactor_living_t));
+	living->videoType = videoType;
+	living->openAudio = openAudio;
+	abr_session_init(&living->abr, stream_index, getTickCount(), 0);
+	if(reactor_living_join(living, stream_index) < 0)
+	{
+		pthread_mutex_unlock(&g_reactor.live_lock);
+		reactor_set_stream(SessionID, CLOSE, status.current_stream);
+		return -1;
+	}
+	pthread_mutex_unlock(&g_reactor.live_lock);
+
+	reactor_set_stream(SessionID, OPEN, videoType);
+	reactor_stream_notify(NULL); //设置通知之前入队的帧不会再触发通知
+	DEBUG_LOG("SessionID(%d): real time stream(%d) transmission start!\n",SessionID ,videoType);
+	return 0;
+}
+
+void reactor_close_living(HLE_S32 SessionID)
+{
+	session_status_t status;
+	memset(&status,0,sizeof(status));
+	HLE_S32 index = get_session_status(SessionID,&status);
+	if(index < 0)
+		return;
+
+	pthread_mutex_lock(&g_reactor.live_lock);
+	if(g_reactor.session[index].living.used)
+		DEBUG_LOG("SessionID(%d): real time stream(%d) closed !\n",SessionID,g_reactor.session[index].living.videoType);
+	reactor_living_free(&g_reactor.session[index].living);
+	pthread_mutex_unlock(&g_reactor.live_lock);
+
+	reactor_set_stream(SessionID, CLOSE, status.current_stream);
+}
+
+
+/*---# 信令线程 ------------------------------------------------------------*/
+
+/*******************************************************************************
+*@ Description    :会话的信令通道可读，不阻塞地接收信令头和信令体，整条信令收齐后分发
+*@ Input          :<sess>会话
+*@ Output         :
+*@ Return         :
+*@ attention      :信令体没收齐时保留在会话的缓存中，下次可读时接着收，不等待
+*******************************************************************************/
+static void reactor_cmd_recv(reactor_session_t *sess)
+{
+	cmd_header_t *header = (cmd_header_t *)sess->cmd_buf;
+	HLE_S32 want, ReadSize, ret;
+
+	for(;;)
+	{
+		want = sizeof(cmd_header_t);
+		if(sess->cmd_len >= want)
+			want += header->length;
+		if(sess->cmd_len == want)
+			break;
+
+		ReadSize = want - sess->cmd_len;
+		ret = p2p_recv(sess->SessionID, CH_CMD, (HLE_U8 *)sess->cmd_buf + sess->cmd_len, &ReadSize, 0);
+		if(ret < 0 && ERROR_PPCS_TIME_OUT != ret)
+		{
+			if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) //远程会话关闭（客户端退出）
+				ERROR_LOG("Remote site call close!! SessionID(%d)\n", sess->SessionID);
+			else //都默认为客户端已经退出
+				ERROR_LOG("PPCS_Read: SessionID(%d) Channel=%d, ret=%d\n", sess->SessionID, CH_CMD, ret);
+			reactor_set_offline(sess->SessionID);
+			return;
+		}
+		if(ReadSize <= 0) //暂时没有更多数据
+			return;
+		sess->cmd_len += ReadSize;
+
+		if(sess->cmd_len != (HLE_S32)sizeof(cmd_header_t))
+			continue;
+		if(header->head != HLE_MAGIC) //丢弃非法的信令头（不等它的信令体）
+		{
+			ERROR_LOG("cmd header is illegal! SessionID(%d)\n", sess->SessionID);
+			sess->cmd_len = 0;
+			return;
+		}
+		if(header->length < 0 || header->length > (HLE_S32)(REACTOR_CMD_MAX - sizeof(cmd_header_t)))
+		{
+			//无法再找到下一条信令的开头，断开
+			ERROR_LOG("SessionID(%d) cmd(%#x) bad body length: %d\n", sess->SessionID, header->command, header->length);
+			reactor_set_offline(sess->SessionID);
+			return;
+		}
+	}
+
+	sess->cmd_len = 0;
+	DEBUG_LOG("PPCS_Read CMD success! SessionID(%d) cmd_header.command = %#x, length(%d)\n",
+			  sess->SessionID, header->command, header->length);
+	//信令读取成功！对信令进行解析
+	med_ser_cmd_parse(sess->SessionID, header, want);
+}
+
+/*关闭并删除会话（只在信令线程调用）*/
+static void reactor_session_remove(reactor_session_t *sess)
+{
+	HLE_S32 SessionID = sess->SessionID;
+
+	reactor_close_living(SessionID);
+
+	/*先清会话表再删 SessionStatus：SessionStatus 的下标释放后 listen 线程就可能把它分给新会话*/
+	pthread_mutex_lock(&g_reactor.sess_lock);
+	sess->used = 0;
+	pthread_mutex_unlock(&g_reactor.sess_lock);
+	del_one_session_from_arr(SessionID);
+	p2p_close(SessionID);
+
+	if(g_reactor.handle)
+	{
+		pthread_mutex_lock(&g_reactor.handle->lock);
+		g_reactor.handle->Session_num --;
+		if(g_reactor.handle->Session_num < 0)
+			g_reactor.handle->Session_num = 0;
+		pthread_mutex_unlock(&g_reactor.handle->lock);
+	}
+	DEBUG_LOG("--PPCS_Close(%d)\n", SessionID);
+}
+
+static void *reactor_cmd_thread(void *args)
+{
+	HLE_S32 ids[MAX_CLIENT_NUM];
+	HLE_S32 slots[MAX_CLIENT_NUM];
+	HLE_S8 readable[MAX_CLIENT_NUM];
+	HLE_S32 i, num;
+	const p2p_transport_t *transport = p2p_transport_get(NULL);
+
+	DEBUG_LOG("Thread create: %s\n", __FUNCTION__);
+	while(reactor_running())
+	{
+		pthread_mutex_lock(&g_reactor.sess_lock);
+		do
+		{
+			num = 0;
+			for(i = 0; i < MAX_CLIENT_NUM; i++)
+			{
+				if(!g_reactor.session[i].used)
+					continue;
+				ids[num] = g_reactor.session[i].SessionID;
+				slots[num] = i;
+				num++;
+			}
+			if(0 == num && reactor_running()) //没有会话，等 reactor_add_session 唤醒
+				pthread_cond_wait(&g_reactor.sess_cond, &g_reactor.sess_lock);
+		}while(0 == num && reactor_running());
+		pthread_mutex_unlock(&g_reactor.sess_lock);
+		if(0 == num)
+			break;
+
+		if(transport->poll(ids, num, CH_CMD, readable, REACTOR_POLL_TIMEOUT) > 0)
+		{
+			for(i = 0; i < num; i++)
+			{
+				if(readable[i])
+					reactor_cmd_recv(&g_reactor.session[slots[i]]);
+			}
+		}
+
+		for(i = 0; i < num; i++)
+		{
+			if(OFFLINE == is_session_online(ids[i]))
+				reactor_session_remove(&g_reactor.session[slots[i]]);
+		}
+	}
+
+	for(i = 0; i < MAX_CLIENT_NUM; i++)
+	{
+		if(g_reactor.session[i].used)
+			reactor_session_remove(&g_reactor.session[i]);
+	}
+	DEBUG_LOG("Thread exit: %s\n", __FUNCTION__);
+	return NULL;
+}
+
+HLE_S32 reactor_add_session(HLE_S32 SessionID)
+{
+	//加入状态数组。
+	HLE_S32 index = add_one_session_to_arr(SessionID);
+	if(index < 0)
+	{
+		ERROR_LOG("too many client connected !\n");
+		p2p_close(SessionID);
+		return -1;
+	}
+
+	session_status_t status;
+	memset(&status,0,sizeof(session_status_t));
+	get_session_status(SessionID,&status);
+	status.Session_status = ONLINE;
+	set_session_status(SessionID,&status);
+
+	if(g_reactor.handle)
+	{
+		pthread_mutex_lock(&g_reactor.handle->lock);
+		g_reactor.handle->Session_num ++;
+		pthread_mutex_unlock(&g_reactor.handle->lock);
+	}
+
+	pthread_mutex_lock(&g_reactor.sess_lock);
+	reactor_session_t *sess = &g_reactor.session[index];
+	sess->SessionID = SessionID;
+	sess->cmd_len = 0;
+	sess->used = 1;
+	pthread_cond_signal(&g_reactor.sess_cond);
+	pthread_mutex_unlock(&g_reactor.sess_lock);
+
+	reactor_wakeup_cmd(); //信令线程可能正在 poll 旧的会话列表
+	DEBUG_LOG("reactor add SessionID(%d) index(%d)\n", SessionID, index);
+	return 0;
+}
+
+HLE_S32 reactor_start(p2p_handle_t *handle)
+{
+	HLE_S32 ret;
+	const p2p_transport_t *transport = p2p_transport_get(NULL);
+
+	g_reactor.handle = handle;
+	if(g_reactor.running)
+		return 0;
+	if(NULL == transport || NULL == transport->poll)
+	{
+		ERROR_LOG("transport not support poll!\n");
+		return -1;
+	}
+
+	g_reactor.running = 1;
+	g_reactor.ev_pending = 0;
+	ret = pthread_create(&g_reactor.cmd_tid, NULL, reactor_cmd_thread, NULL);
+	if(0 != ret)
+	{
+		ERROR_LOG("pthread_create reactor_cmd_thread failed!\n");
+		g_reactor.running = 0;
+		return -1;
+	}
+	ret = pthread_create(&g_reactor.stream_tid, NULL, reactor_stream_thread, NULL);
+	if(0 != ret)
+	{
+		ERROR_LOG("pthread_create reactor_stream_thread failed!\n");
+		reactor_stop();
+		return -1;
+	}
+	return 0;
+}
+
+void reactor_stop(void)
+{
+	if(!g_reactor.running)
+		return;
+	__atomic_store_n(&g_reactor.running, 0, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&g_reactor.sess_lock);
+	pthread_cond_signal(&g_reactor.sess_cond);
+	pthread_mutex_unlock(&g_reactor.sess_lock);
+	reactor_wakeup_cmd();
+	pthread_join(g_reactor.cmd_tid, NULL); //退出前会关闭所有会话（包括实时流）
+
+	reactor_stream_notify(NULL);
+	if(g_reactor.stream_tid)
+		pthread_join(g_reactor.stream_tid, NULL);
+	g_reactor.stream_tid = 0;
+}
+
@@ -0,0 +1,79 @@
+/*********************************************************************************
+  *FileName: media_server_reactor.h
+  *Create Date: 2026/10/19
+  *Description: P2P 会话反应器。固定两个线程服务所有客户端：
+  *			 信令线程通过传输层 poll 等待所有会话的信令通道，流线程等待编码队列通知后发送实时流，
+  *			 同一路码流的所有观看者共用一个编码队列（广播组），按各会话的 ABR 档位调整编码参数或切换码流。
+  *Others:
+  *History:
+**********************************************************************************/
+#ifndef MEDIA_SERVER_REACTOR_H
+#define MEDIA_SERVER_REACTOR_H
+
+#include "typeport.h"
+#include "media_server_p2p.h"
+
+#define REACTOR_POLL_TIMEOUT		1000	//信令线程单次 poll 的最长等待（毫秒），只是兜底，新会话/下线都会主动唤醒
+#define REACTOR_CMD_MAX				1024	//一条信令（信令头 + 信令体）的最大长度，超过时断开会话
+#define MAX_WRITE_ERR_NUM			30		//(15+25)*1 ,连续发送编码帧失败的最大容忍限度，超出后认为客户端异常断线
+#define LIVING_DISCARD_THRESHOLD	(128*1024)	//发送缓存超过该值开始丢帧（按 GOP 丢，恢复时从 I 帧开始）
+#define REACTOR_GROUP_NUM			2		//广播组数量：MAIN_STREAM / LOWER_STREAM 各一个
+#define REACTOR_GROUP_RING			64		//广播组帧环的容量（帧数），环满时暂停从编码队列取帧
+#define REACTOR_SENDV_MAX			16		//一次 p2p_sendv 最多合并的帧数
+#define REACTOR_RATE_WINDOW			1000	//广播组码率统计窗口（毫秒）
+
+#ifndef REACTOR_ABR_ENABLE
+#define REACTOR_ABR_ENABLE			1		//实时流 ABR（media_server_abr.h），0：只按发送缓存丢帧
+#endif
+
+
+/*******************************************************************************
+*@ Description    :启动反应器（信令线程 + 流线程），重复调用只更新 handle
+*@ Input          :<handle>P2P 句柄，会话数 Session_num 由反应器维护
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :在传输层 init 之后调用
+*******************************************************************************/
+HLE_S32 reactor_start(p2p_handle_t *handle);
+
+/*******************************************************************************
+*@ Description    :停止反应器，关闭所有会话
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void reactor_stop(void);
+
+/*******************************************************************************
+*@ Description    :把 listen 得到的新会话交给反应器
+*@ Input          :<SessionID>会话ID
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1（会话已被关闭）
+*@ attention      :
+*******************************************************************************/
+HLE_S32 reactor_add_session(HLE_S32 SessionID);
+
+/*******************************************************************************
+*@ Description    :打开会话的实时流（已打开时切换到新的码流）
+*@ Input          :<SessionID>会话ID
+					<videoType>MAIN_STREAM / LOWER_STREAM
+					<openAudio>是否需要音频帧
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+HLE_S32 reactor_open_living(HLE_S32 SessionID, HLE_U32 videoType, HLE_U32 openAudio);
+
+/*******************************************************************************
+*@ Description    :关闭会话的实时流（不关闭会话）
+*@ Input          :<SessionID>会话ID
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+void reactor_close_living(HLE_S32 SessionID);
+
+
+#endif
+
@@ -8,7 +8,9 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
 
 
 #include "media_server_signal_def.h"
@@ -17,13 +19,16 @@
 #include "media_server_signal_parse.h"
 
 #include "media_server_p2p.h"
+#include "media_server_reactor.h"
 
-#include "PPCS_API.h"
 #include "PPCS_Error.h"
 #include "PPCS_Type.h"
 #include "opt.h"
 #include "timezone.h"
 #include "ctrl.h"
+#include "metrics.h"
+#include "parameter.h"
+#include "sd_record.h"
 
 
 
@@ -33,17 +38,85 @@ extern med_ser_init_info_t g_med_ser_envir;
 extern void cmd_wpa_connect(int argc, char *argv[]);
 extern void cmd_wpa_disconnect(int argc, char *argv[]);
 
+/*
+把收齐的信令（信令头 + 信令体，反应器已经接收完整）拷贝到请求结构，信令体长度必须和结构一致
+*/
+static HLE_S32 cmd_get_request(const cmd_header_t *cmd, void *request, HLE_S32 size)
+{
+	if(cmd->length != size - (HLE_S32)sizeof(cmd_header_t))
+	{
+		ERROR_LOG("cmd(%#x) body length error! length(%d) expect(%d)\n",
+				  cmd->command, cmd->length, size - (HLE_S32)sizeof(cmd_header_t));
+		return HLE_RET_EINVAL;
+	}
+	memcpy(request, cmd, size);
+	return HLE_RET_OK;
+}
 
 
 //会话状态数组，描述每个会话的状态信息
 static session_status_t SessionStatus[MAX_CLIENT_NUM] = {0};
 
-//实时视频流线程创建时传入的参数结构体
-typedef struct _open_living_args_t
+/*会话 ID -> SessionStatus 下标的哈希索引（线性探测），每发一帧都要查会话状态，不能再遍历数组*/
+#define SESSION_HASH_SIZE	128		//2 的幂，至少是 MAX_CLIENT_NUM 的 2 倍
+#if SESSION_HASH_SIZE < 2*MAX_CLIENT_NUM
+#error "SESSION_HASH_SIZE too small for MAX_CLIENT_NUM"
+#endif
+static HLE_S16 SessionIndex[SESSION_HASH_SIZE] = {0};	//SessionStatus 下标 + 1，0 表示空
+static pthread_mutex_t SessionLock = PTHREAD_MUTEX_INITIALIZER;
+
+static HLE_U32 session_hash(HLE_S32 SessionID)
 {
-	S_GET_LIVING_OPEN_REQUEST cmd_data;
-	HLE_S32 SessionID;
-}open_living_args_t;
+	return (((HLE_U32)SessionID * 2654435761U) >> 16) & (SESSION_HASH_SIZE - 1);
+}
+
+/*
+查找会话在哈希索引中的位置
+返回：
+	找到：索引位置
+	没找到：-1
+注意：调用者持有 SessionLock
+*/
+static HLE_S32 session_index_find(HLE_S32 SessionID)
+{
+	HLE_U32 h = session_hash(SessionID);
+	HLE_S32 n;
+	for(n = 0;n < SESSION_HASH_SIZE;n++)
+	{
+		HLE_S32 v = SessionIndex[h];
+		if(0 == v)
+			return -1;
+		if(SessionID == SessionStatus[v - 1].SessionID)
+			return h;
+		h = (h + 1) & (SESSION_HASH_SIZE - 1);
+	}
+	return -1;
+}
+
+/*
+从哈希索引删除一项，后面同一探测链上的项往前挪，保证查找不会提前碰到空位
+注意：调用者持有 SessionLock，且被删的会话还在 SessionStatus 中
+*/
+static void session_index_remove(HLE_S32 pos)
+{
+	HLE_U32 i = pos;
+	HLE_U32 j = pos;
+
+	SessionIndex[i] = 0;
+	while(1)
+	{
+		j = (j + 1) & (SESSION_HASH_SIZE - 1);
+		if(0 == SessionIndex[j])
+			break;
+		HLE_U32 k = session_hash(SessionStatus[SessionIndex[j] - 1].SessionID);
+		//k 落在 (i, j] 之间（环形）说明该项不需要挪动
+		if((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		SessionIndex[i] = SessionIndex[j];
+		SessionIndex[j] = 0;
+		i = j;
+	}
+}
 
 /*
 添加一个会话到会话状态数组
@@ -54,18 +127,36 @@ typedef struct _open_living_args_t
 
 HLE_S32 add_one_session_to_arr(HLE_S32 SessionID)
 {
-	HLE_S8 i;
+	HLE_S32 i;
+
+	pthread_mutex_lock(&SessionLock);
+	HLE_S32 pos = session_index_find(SessionID);
+	if(pos >= 0) //同一个会话 ID 重复添加，复用原来的节点
+	{
+		i = SessionIndex[pos] - 1;
+		pthread_mutex_unlock(&SessionLock);
+		return i;
+	}
+	
 	//查找状态数组的空闲元素下标，填入会话ID，初始化状态。
 	for(i = 0;i<MAX_CLIENT_NUM;i++)
 	{
 		if(0 == SessionStatus[i].node_is_used)
 		{
+			memset(&SessionStatus[i],0,sizeof(session_status_t));
 			SessionStatus[i].SessionID = SessionID;
 			SessionStatus[i].node_is_used = 1;
+
+			HLE_U32 h = session_hash(SessionID);
+			while(0 != SessionIndex[h])
+				h = (h + 1) & (SESSION_HASH_SIZE - 1);
+			SessionIndex[h] = i + 1;
 			
+			pthread_mutex_unlock(&SessionLock);
 			return i;
 		}
 	}
+	pthread_mutex_unlock(&SessionLock);
 	DEBUG_LOG("SessionStatus array is full!\n");
 	return HLE_RET_ENORESOURCE;
 	
@@ -79,17 +170,14 @@ HLE_S32 add_one_session_to_arr(HLE_S32 SessionID)
 */
 HLE_S32 is_session_online(HLE_S32 SessionID)
 {
-	HLE_S8 i;
-
-	for(i = 0;i<MAX_CLIENT_NUM;i++)
-	{
-		if(SessionID == SessionStatus[i].SessionID)
-		{
-			if(ONLINE == SessionStatus[i].Session_status)
-			return ONLINE;
-		}
-	}
-	return OFFLINE;
+	HLE_S32 online = OFFLINE;
+
+	pthread_mutex_lock(&SessionLock);
+	HLE_S32 pos = session_index_find(SessionID);
+	if(pos >= 0 && ONLINE == SessionStatus[SessionIndex[pos] - 1].Session_status)
+		online = ONLINE;
+	pthread_mutex_unlock(&SessionLock);
+	return online;
 }
 
 
@@ -107,15 +195,17 @@ HLE_S32 get_session_status(HLE_S32 SessionID,session_status_t* status)
 {
 	if(NULL == status)
 		return HLE_RET_EINVAL;
-	HLE_S8 i;
-	for(i = 0;i<MAX_CLIENT_NUM;i++)
+
+	pthread_mutex_lock(&SessionLock);
+	HLE_S32 pos = session_index_find(SessionID);
+	if(pos >= 0)
 	{
-		if(SessionID == SessionStatus[i].SessionID)
-		{
-			memcpy(status,&SessionStatus[i],sizeof(session_status_t));
-			return i;
-		}
+		HLE_S32 i = SessionIndex[pos] - 1;
+		memcpy(status,&SessionStatus[i],sizeof(session_status_t));
+		pthread_mutex_unlock(&SessionLock);
+		return i;
 	}
+	pthread_mutex_unlock(&SessionLock);
 	
 	DEBUG_LOG("[Get session] SessionStatus array not have a item named %d !\n",SessionID);
 	return HLE_RET_ERROR;
@@ -139,15 +229,19 @@ HLE_S32 set_session_status(HLE_S32 SessionID,session_status_t* status)
 {
 	if(NULL == status)
 		return HLE_RET_EINVAL;
-	HLE_S8 i;
-	for(i = 0;i<MAX_CLIENT_NUM;i++)
+
+	pthread_mutex_lock(&SessionLock);
+	HLE_S32 pos = session_index_find(SessionID);
+	if(pos >= 0)
 	{
-		if(SessionID == SessionStatus[i].SessionID)
-		{
-			memcpy(&SessionStatus[i],status,sizeof(session_status_t));
-			return i;
-		}
+		HLE_S32 i = SessionIndex[pos] - 1;
+		memcpy(&SessionStatus[i],status,sizeof(session_status_t));
+		SessionStatus[i].SessionID = SessionID; //索引按会话 ID 建立，不允许通过 set 修改
+		SessionStatus[i].node_is_used = 1;
+		pthread_mutex_unlock(&SessionLock);
+		return i;
 	}
+	pthread_mutex_unlock(&SessionLock);
 	
 	DEBUG_LOG("[Set session] SessionStatus array not have a item named %d !\n",SessionID);
 	return HLE_RET_ERROR;
@@ -164,18 +258,19 @@ HLE_S32 set_session_status(HLE_S32 SessionID,session_status_t* status)
 */
 HLE_S32 del_one_session_from_arr(HLE_S32 SessionID)
 {
-
-	HLE_S8 i;
+	pthread_mutex_lock(&SessionLock);
 	//找到该会话在会话数组中的下标位置，将该下标的数组元素清0
-	for(i = 0;i<MAX_CLIENT_NUM;i++)
+	HLE_S32 pos = session_index_find(SessionID);
+	if(pos >= 0)
 	{
-		if(SessionID == SessionStatus[i].SessionID)
-		{
-			ERROR_LOG("Delete one session , SessionID(%d)\n",SessionID);
-			memset(&SessionStatus[i],0,sizeof(session_status_t));
-			return i;
-		}
+		HLE_S32 i = SessionIndex[pos] - 1;
+		session_index_remove(pos);
+		memset(&SessionStatus[i],0,sizeof(session_status_t));
+		pthread_mutex_unlock(&SessionLock);
+		ERROR_LOG("Delete one session , SessionID(%d)\n",SessionID);
+		return i;
 	}
+	pthread_mutex_unlock(&SessionLock);
 	DEBUG_LOG("[Del session] SessionStatus array not have a item named %d !\n",SessionID);
 	return HLE_RET_ERROR;
 }
@@ -235,351 +330,99 @@ HLE_S32 cmd_alarm_update(HLE_S32 SessionID)
 }
 
 
-//打开实时流传输
-#define MAX_WRITE_ERR_NUM  30  //(15+25)*1 ,连续发送编码帧失败的最大容忍限度，超出后认为客户端异常断线
-void* cmd_open_living(void* args)
-{
-	if(NULL == args)
-		return NULL;
-	
-	 pthread_detach(pthread_self());
-
-	 //参数数据备份
-	 open_living_args_t  stream_args;
-	 memset(&stream_args,0,sizeof(open_living_args_t));
-	 memcpy(&stream_args,args,sizeof(open_living_args_t));
-
-	 DEBUG_LOG("videoType(%d)  openAudio(%d)!\n",stream_args.cmd_data.videoType,stream_args.cmd_data.openAudio);
-	
-	int queue_id; //申请一道码流（id号）
-	//解析 cmd_body，回传对应码流,目前只有 MAIN_STREAM 和 LOWER_STREAM 两道流
-	if(MAIN_STREAM == stream_args.cmd_data.videoType ||LOWER_STREAM == stream_args.cmd_data.videoType)
-	{
-		st_PPCS_Session Sinfo;
-		int ret;
-		
-		DEBUG_LOG("SessionID(%d): real time stream(%d) transmission start!\n",stream_args.SessionID ,stream_args.cmd_data.videoType);	
-
-		
-		/*---#改变会话状态信息------------------------------------------------------------*/
-		session_status_t  status;
-		memset(&status,0,sizeof(status));
-		int index = get_session_status(stream_args.SessionID,&status);
-		if(index < 0)
-		{
-			ERROR_LOG("get_session_status failed !\n");
-			pthread_exit(NULL) ;
-		}
-		status.current_stream = stream_args.cmd_data.videoType;
-		status.stream_status = OPEN;		
-		index = set_session_status(stream_args.SessionID ,&status);
-		if(index < 0)
-		{
-			ERROR_LOG("change_session_status failed !\n");
-			pthread_exit(NULL) ;
-		}
-
-		/*---请求码流------------------------------------------------------*/
-		int stream_index;
-		if(MAIN_STREAM == stream_args.cmd_data.videoType)
-		{
-			stream_index = 0;
-		}			
-		else
-		{
-			stream_index = 1;
-		}
-			
-		DEBUG_LOG("stream_index = %d\n",stream_index);
-		queue_id = g_med_ser_envir.encoder_request_stream(0,stream_index,1);//里边自带强制 I 帧
-		if(queue_id < 0)
-		{
-			ERROR_LOG("encoder_request_stream failed !\n");
-			pthread_exit(NULL) ;
-			
-		}
-		DEBUG_LOG("------encoder_request_stream stream_id(%d) stream_index(%d)------\n",queue_id,stream_index);
-		/*---强制I帧------------------------------------------------------*/
-		int first_is_iframe = 0;//初次进入码流发送状态需要强制I帧
-		//g_med_ser_envir.encoder_force_iframe(0,stream_index);
-		HLE_S8 write_err_count = 0;
-		
-		/*---开始获取数据包并发送-----------------------------------------*/		
-		while(OPEN == status.stream_status)//如若客户端退出，自然 stream_status会是0,所以这里不再判断客户端是否在线。
-		{
-			void* pack_addr = NULL;
-			void* frame_addr = NULL;
-			HLE_S32 length = 0;
-			int skip_len = 0;
-			
-
-			memset(&status,0,sizeof(status));
-			get_session_status(stream_args.SessionID,&status);
-			
-			g_med_ser_envir.encoder_get_packet(queue_id,\
-											   stream_args.cmd_data.openAudio,\
-											   &pack_addr,\
-											   &frame_addr,&length);
-			FRAME_HDR *header = (FRAME_HDR *) frame_addr;
-	
-			/*---# 寻找视频关键帧------------------------------------------------------------*/
-			if(0 == first_is_iframe)
-			{
-				if(header->type == 0xF8)//找到视频关键帧,进入传输模式
-				{
-					first_is_iframe = 1;
-					DEBUG_LOG("I frame finded!\n");
-				}
-				else
-				{
-					DEBUG_LOG("find I frame ......pack_addr(%#x)\n",pack_addr);  
-					g_med_ser_envir.encoder_release_packet(pack_addr);
-					continue;
-				}	
-			}
-
-			/*---#FRAME_HDR + IFRAME_INFO/PFRAME_INFO + DATA的格式传输，不需要跳过这些头------------*/
-			unsigned int H264_data_len = 0;
-            if (header->type == 0xF8)//视频关键帧 
-			{
-                skip_len = sizeof (FRAME_HDR) + sizeof (IFRAME_INFO);
-				IFRAME_INFO* info = (IFRAME_INFO*)((char*)frame_addr+sizeof(FRAME_HDR));
-				H264_data_len = info->length;
-            }
-            else if (header->type == 0xF9)//视频非关键帧
-			{
-                skip_len = sizeof (FRAME_HDR) + sizeof (PFRAME_INFO);
-				PFRAME_INFO* info = (PFRAME_INFO*)((char*)frame_addr+sizeof(FRAME_HDR));
-				H264_data_len = info->length;
-            }	
-		
-			#if 0  //debug
-				int m = 0;
-				char* H264_data = (char*)frame_addr + skip_len;
-				printf("H264_data: ");
-				for(m = 0;m<20;m++)
-				{
-					printf("%#x ",H264_data[m]);
-				}
-				printf("\n");
-			#endif
-			
-			//进入传输状态
-			if(1 == first_is_iframe)
-			{
-				unsigned int wsize = 0;  //PPCS_Write 写缓存通道里边已经缓存的数据大小
-				ret = PPCS_Check_Buffer(stream_args.SessionID, CH_STREAM, &wsize, NULL);
-				if (ret < 0)
-				{
-					ERROR_LOG("PPCS_Check_Buffer ret=%d %s\n", ret, getP2PErrorCodeInfo(ret));
-					g_med_ser_envir.encoder_release_packet(pack_addr);
-					continue;
-				}
-				
-
-//				if (wsize > 128*1024 && header->type == 0xF9) //超过阈值，开始丢弃P帧
-//				{
-//					
-//					DEBUG_LOG("PPCS_Write buffer data = %d KB discard P frame\n",wsize/1024);
-//					g_med_ser_envir.encoder_release_packet(pack_addr);
-//					continue;
-//				}
-
-				//注意此处丢弃帧要按gop丢弃
-				static int discard_flag = 0; //丢帧标记
-				if (wsize > 128*1024) //超过256K阈值，全部丢弃，不再继续发送
-				{
-					discard_flag = 1;
-					ERROR_LOG("PPCS_Write buffer data = %d KB discard ALL frame\n",wsize/1024);
-					g_med_ser_envir.encoder_release_packet(pack_addr);
-					continue;
-				}
-				else //发送 buf 小于阈值，退出丢帧模式
-				{
-					if(1 == discard_flag)//退出丢帧模式时，保证第一帧是I帧
-					{
-						if(header->type == 0xF8)
-						{
-							discard_flag = 0;
-							ERROR_LOG("END of discard ALL frame\n");
-						}
-						else
-						{
-							ERROR_LOG("wsize <=  critical value,discard P frame!\n");
-							g_med_ser_envir.encoder_release_packet(pack_addr);
-							continue;
-						}
-						
-					}
-
-				}
-
-				
-				ret = PPCS_Write(stream_args.SessionID,CH_STREAM,(CHAR*)frame_addr,length);
-				if (ret < 0)//发送失败
-				{
-					
-					if (ERROR_PPCS_SESSION_CLOSED_TIMEOUT == ret)
-					{
-						ERROR_LOG("PPCS_Write  CH=%d, ret=%d, Session Closed TimeOUT!!\n", CH_STREAM, ret);
-					}				
-					else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret)//远程会话关闭（客户端退出）
-					{
-						ERROR_LOG("PPCS_Write CH=%d, ret=%d, Session Remote Close!!\n", CH_STREAM, ret);
-					}				
-					else 
-					{
-						ERROR_LOG("PPCS_Write CH=%d, ret=%d  [%s]\n", CH_STREAM,ret, getP2PErrorCodeInfo(ret));
-					}	
-
-					g_med_ser_envir.encoder_release_packet(pack_addr);
-					
-					write_err_count ++;
-					if(write_err_count >= MAX_WRITE_ERR_NUM)
-					{
-						/*-----多次发送失败就断定为断开连接-------------*/
-						write_err_count = 0;
-						printf("write_err_count ++\n");
-						memset(&status,0,sizeof(status));
-						get_session_status(stream_args.SessionID,&status);
-						status.stream_status = CLOSE;
-						status.Session_status = OFFLINE;
-						set_session_status(stream_args.SessionID,&status);
-						break;
-					}
-					else
-					{
-						ERROR_LOG("PPCS_Write failed !\n");
-						continue;
-					}
-							
-				}
-				else
-				{
-					DEBUG_LOG("PPCS_Write success length(%d) (%d)KB! wsize (%d)KB\n",length,length/1024,wsize/1024);
-					write_err_count = 0;
-					g_med_ser_envir.encoder_release_packet(pack_addr);	
-					DEBUG_LOG("after encoder_release_packet!\n");
-				}
-			}
-			
-		}
-		
-	}
-	else
-	{
-		ERROR_LOG("stream resolution(%u) not support ! \n",stream_args.cmd_data.videoType);
-	}
-	
-ERR:
-	DEBUG_LOG("SessionID(%d): real time stream(%d) closed !\n",stream_args.SessionID,stream_args.cmd_data.videoType);
-	g_med_ser_envir.encoder_free_stream(queue_id);
-	pthread_exit(NULL);
-	return NULL;
-}
-
 /*
 关闭实时流传输
 注意：不要关闭了SessionID，SessionID只能由收到“退出登陆请求命令”接口关闭
 */
 HLE_S32 cmd_set_living_close(HLE_S32 SessionID)
 {
-	session_status_t  status;
-	memset(&status,0,sizeof(status));
-
-	int index = get_session_status(SessionID,&status);
-	if(index < 0)
-	{
-		ERROR_LOG("get_session_status failed !\n");
-	}
-	
-	status.stream_status = CLOSE;
-	
-	index = set_session_status(SessionID,&status);
-	if(index < 0)
-	{
-		ERROR_LOG("change_session_status failed !\n");
-	}
+	reactor_close_living(SessionID);
 	
 	DEBUG_LOG("cmd_set_living_close sucess!\n");
 	return HLE_RET_OK;
 }
 
-//重启命令
+//重启：参数修改是延迟写入的（见 parameter.h），重启前先写入 flash
 extern void cmd_reset(void);
+static void sys_reboot(void)
+{
+	if(sys_param_flush() < 0)
+		ERROR_LOG("sys_param_flush failed!\n");
+	cmd_reset();
+}
+
+//重启命令
 HLE_S32 cmd_set_reboot(HLE_S32 SessionID)
 {
 	DEBUG_LOG("cmd_set_reboot sucess!\n");
-	cmd_reset();
+	sys_reboot();
 	return HLE_RET_OK;
 }
 
 //升级命令
 #include <sys/types.h>
 #include <pwd.h>
+#include "system_upgrade.h"
+
+//升级线程：边下载边写 flash，成功后重启进入新系统
+static void *update_thread(void *args)
+{
+	char *url = (char *)args;
+	upgrade_status_e ret = upgrade_from_url(url);
+	free(url);
+	if(UP_OK != ret)
+	{
+		ERROR_LOG("upgrade failed, ret(%d)\n",ret);
+		return NULL;
+	}
+	DEBUG_LOG("upgrade success, reboot...\n");
+	sys_reboot();
+	return NULL;
+}
 
-HLE_S32 cmd_set_update(HLE_S32 SessionID,HLE_S32 readsize)
+HLE_S32 cmd_set_update(HLE_S32 SessionID,const cmd_header_t *cmd)
 {
 
 	char * url = NULL;
 
 	S_SET_UPDATE_REQUEST cmd_body;
-	//接收信令的 body 部分,注意cmd_body 的 DEF_CMD_HEADER 部分在之前已经接收过了，这里需要跳过该部分
-	//所以，这里的 cmd_body.DEF_CMD_HEADER 是空的，不要使用。
+	//信令体可以比结构短（URL 只发送有效部分），不足的部分为 0
 	memset(&cmd_body,0,sizeof(S_SET_UPDATE_REQUEST));
-	HLE_S32 ReadSize = readsize;
-	
-	
-	printf("cmd body ReadSize = %d\n",ReadSize);
-	//注意：PPCS_Read 的返回值成功为0 ，实际读到的字节数会返回在传进去的变量ReadSize中。
-	HLE_S32 ret = PPCS_Read(SessionID, CH_CMD, (CHAR*)&cmd_body + sizeof(cmd_header_t) , &ReadSize, 2000);
-	if(ret < 0)//读取出错
-	{
-		if (ERROR_PPCS_TIME_OUT == ret) 
-		{
-			ERROR_LOG("PPCS_Read timeout !!\n");					
-		}	
-		else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) 
-		{
-			ERROR_LOG("Remote site call close!!\n");
-		}
-		else 
-		{
-			ERROR_LOG("PPCS_Read: Channel=%d, ret=%d\n", CH_CMD, ret);
-		}
-		return HLE_RET_ERROR;
-	}
-		
-	//body长度数据校验
-	if(ReadSize  != readsize)
+	if(cmd->length <= 0 || cmd->length > (HLE_S32)(sizeof(S_SET_UPDATE_REQUEST) - sizeof(cmd_header_t)))
 	{
-		ERROR_LOG("check cmd body length error! ret(%d)\n",ret);
+		ERROR_LOG("check cmd body length error! length(%d)\n",cmd->length);
 		return HLE_RET_ERROR;
 	}
+	memcpy(&cmd_body,cmd,sizeof(cmd_header_t) + cmd->length);
 
 	/*
-		解析 出URL 对升级包的版本号等进行校验,待定。。。。。
+		升级包的版本、签名、SHA256 由升级包头校验（system_upgrade.c），
+		下载和写 flash 需要几十秒，放到单独的线程，不阻塞信令线程
 	*/
+	cmd_body.URL[sizeof(cmd_body.URL) - 1] = '\0';
 	url = (char*)&cmd_body.URL;
-
-
-	#if 0 //liteos 不支持 curl库中调用的函数：geteuid 、 getpwuid_r
-	//url = "http://soft1.xzstatic.com/KMSpico_Install_DownZa.Cn.rar";
-	if(NULL != url)
+	if(0 == url[0])
 	{
-		printf("url : %s\n",url);
-		url_download_file(url);
-
+		ERROR_LOG("cmd_set_update url empty!\n");
+		return HLE_RET_ERROR;
 	}
-		
-	#endif
+	if(upgrade_is_running())
+	{
+		ERROR_LOG("upgrade is running!\n");
+		return HLE_RET_ERROR;
+	}
+	DEBUG_LOG("packageVersion(%.16s) url : %s\n",cmd_body.packageVersion,url);
 
-	/*
-		对升级包再进行防错校验，待定。。。。。。
-		写Flash 等  
-	*/
+	char *url_dup = strdup(url);
+	pthread_t tid;
+	if(NULL == url_dup || pthread_create(&tid, NULL, update_thread, url_dup) != 0)
+	{
+		ERROR_LOG("create update_thread failed!\n");
+		free(url_dup);
+		return HLE_RET_ERROR;
+	}
+	pthread_detach(tid);
 
-	
 	DEBUG_LOG("cmd_set_update sucess!\n");
 	return HLE_RET_OK;
 }
@@ -591,65 +434,165 @@ HLE_S32 cmd_set_restore(HLE_S32 SessionID)
 	return HLE_RET_OK;
 }
 
+/*---# 格式化 SD 卡 ------------------------------------------------------------*/
+static HLE_S32 sd_formatting;		//格式化线程正在执行（sd_format_lock 保护）
+static pthread_mutex_t sd_format_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//格式化线程：停止录像、格式化、重新开始录像，耗时为秒级
+static void *sd_format_thread(void *args)
+{
+	HLE_S32 ret = sd_record_format(SD_REC_STREAM_INDEX);
+	if(ret < 0)
+		ERROR_LOG("sd_record_format failed, ret(%d)\n",ret);
+	else
+		DEBUG_LOG("sd_record_format success!\n");
+
+	pthread_mutex_lock(&sd_format_lock);
+	sd_formatting = 0;
+	pthread_mutex_unlock(&sd_format_lock);
+	return NULL;
+}
 
 /*******************************************************************************
-*@ Description    :设置网络连接
-*@ Input          :
+*@ Description    :格式化 SD 卡
+*@ Input          :<SessionID> P2P会话ID
+					<cmd>整条信令（信令头 + 信令体）
 *@ Output         :
-*@ Return         :
-*@ attention      :
+*@ Return         :成功：HLE_RET_OK ； 失败：错误码
+*@ attention      :卡上的数据全部丢失，只由用户命令触发（开机时不会自动格式化，见 sd_record.h）；
+					格式化在单独的线程中执行，开始后就回复，不等格式化完成
 *******************************************************************************/
-HLE_S32 cmd_set_connect_net(HLE_S32 SessionID,cmd_header_t cmd_header)
+HLE_S32 cmd_set_sd_format(HLE_S32 SessionID,const cmd_header_t *cmd)
 {
-	S_SET_CONT_NET_INFO_REQUEST cmd_body;
-	memset(&cmd_body,0,sizeof(S_SET_CONT_NET_INFO_REQUEST));
-	memcpy(&cmd_body,&cmd_header,sizeof(cmd_header_t));
+	S_SET_SD_FORMAT_REQUEST cmd_body;
+	S_SET_SD_FORMAT_ECHO echo;
+	HLE_S32 ret = HLE_RET_ERROR;
+	pthread_t tid;
 
-	HLE_S32 ReadSize = cmd_header.length; 
-	if(ReadSize != sizeof(S_SET_CONT_NET_INFO_REQUEST) - sizeof(cmd_header_t))
+	if(cmd_get_request(cmd,&cmd_body,sizeof(S_SET_SD_FORMAT_REQUEST)) >= 0)
 	{
-		ERROR_LOG("cmd_header.length is error !\n");
-		return -1;
+		if(0x55555555 != cmd_body.headFlag1 || 0xaaaaaaaa != cmd_body.headFlag2)
+		{
+			ERROR_LOG("sd format flag error! (%#x %#x)\n",cmd_body.headFlag1,cmd_body.headFlag2);
+		}
+		else
+		{
+			pthread_mutex_lock(&sd_format_lock);
+			if(sd_formatting)
+			{
+				ERROR_LOG("sd card is formatting!\n");
+			}
+			else if(pthread_create(&tid,NULL,sd_format_thread,NULL) != 0)
+			{
+				ERROR_LOG("create sd_format_thread failed!\n");
+			}
+			else
+			{
+				pthread_detach(tid);
+				sd_formatting = 1;
+				ret = HLE_RET_OK;
+			}
+			pthread_mutex_unlock(&sd_format_lock);
+		}
 	}
 
-	//注意：PPCS_Read 的返回值成功为0 ，实际读到的字节数会返回在传进去的变量ReadSize中。
-	HLE_S32 ret = PPCS_Read(SessionID, CH_CMD, (CHAR*)&cmd_body + sizeof(cmd_header_t) , &ReadSize, 2000);
-	if(ret < 0)//读取出错
+	memset(&echo,0,sizeof(S_SET_SD_FORMAT_ECHO));
+	echo.header.head = HLE_MAGIC;
+	echo.header.length = sizeof(S_SET_SD_FORMAT_ECHO) - sizeof(cmd_header_t);
+	echo.header.type = 2;
+	echo.header.command = CMD_SET_SD_FORMAT;
+	echo.echo = (HLE_RET_OK == ret) ? 0 : -1;
+	if(p2p_send(SessionID, CH_CMD, &echo, sizeof(S_SET_SD_FORMAT_ECHO)) < 0)
+		ERROR_LOG("p2p_send sd format echo failed!\n");
+	return ret;
+}
+
+
+/*---# 无线网络切换 ------------------------------------------------------------*/
+/*
+断开/连接需要等待几秒，放到单独的线程，不阻塞信令线程；
+执行期间收到的请求只保留最新的一个，执行完当前的再处理
+*/
+static pthread_mutex_t wifi_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wifi_cond = PTHREAD_COND_INITIALIZER;
+static Net_parameter_t wifi_pending;		//等待执行的请求
+static HLE_S32 wifi_has_pending;
+static HLE_S32 wifi_thread_started;
+
+static void *wifi_connect_thread(void *args)
+{
+	Net_parameter_t net;
+
+	for(;;)
 	{
-		if (ERROR_PPCS_TIME_OUT == ret) 
-		{
-			ERROR_LOG("PPCS_Read timeout !!\n");
-		}	
-		else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) 
+		pthread_mutex_lock(&wifi_lock);
+		while(!wifi_has_pending)
+			pthread_cond_wait(&wifi_cond,&wifi_lock);
+		net = wifi_pending;
+		wifi_has_pending = 0;
+		pthread_mutex_unlock(&wifi_lock);
+
+		net.ssid[sizeof(net.ssid) - 1] = '\0';
+		net.password[sizeof(net.password) - 1] = '\0';
+		DEBUG_LOG("wifi connect: ssid(%s)\n",net.ssid);
+
+		cmd_wpa_disconnect(0,NULL);
+		usleep(100*1000);
+		/*"wpa2"参数后续有需要再改进*/
+		char* argv1[4] = {"0",net.ssid,"wpa2",net.password};
+		cmd_wpa_connect(4,argv1);
+		sleep(2);
+	}
+	return NULL;
+}
+
+static HLE_S32 wifi_connect_request(const Net_parameter_t *net)
+{
+	HLE_S32 ret = HLE_RET_OK;
+	pthread_t tid;
+
+	pthread_mutex_lock(&wifi_lock);
+	if(!wifi_thread_started)
+	{
+		if(pthread_create(&tid,NULL,wifi_connect_thread,NULL) != 0)
 		{
-			ERROR_LOG("Remote site call close!!\n");
+			ERROR_LOG("create wifi_connect_thread failed!\n");
+			ret = HLE_RET_ENORESOURCE;
 		}
-		else 
+		else
 		{
-			ERROR_LOG("PPCS_Read: Channel=%d, ret=%d\n", CH_CMD, ret);
+			pthread_detach(tid);
+			wifi_thread_started = 1;
 		}
-		return -1;
 	}
-
-	//body长度数据校验
-	if(ReadSize  != cmd_header.length)
+	if(HLE_RET_OK == ret)
 	{
-		ERROR_LOG("check cmd body length error! ret(%d)\n",ret);
-		return -1;
+		wifi_pending = *net;
+		wifi_has_pending = 1;
+		pthread_cond_signal(&wifi_cond);
 	}
+	pthread_mutex_unlock(&wifi_lock);
+	return ret;
+}
+
+/*******************************************************************************
+*@ Description    :设置网络连接
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+HLE_S32 cmd_set_connect_net(HLE_S32 SessionID,const cmd_header_t *cmd)
+{
+	S_SET_CONT_NET_INFO_REQUEST cmd_body;
+	if(cmd_get_request(cmd,&cmd_body,sizeof(S_SET_CONT_NET_INFO_REQUEST)) < 0)
+		return -1;
 
 	if(0 == cmd_body.flag)//无线部分
 	{
-		/*切换连接无线网络，并保存参数*/
-		cmd_wpa_disconnect(0,NULL);
-
-	    usleep(100*1000);
-	    int argc1 = 4;
-		/*"wpa2"参数后续有需要再改进*/
-	    char* argv1[4] = {"0",cmd_body.net_parameter.ssid,"wpa2",cmd_body.net_parameter.password};/*{"0", "hle666","wpa2","lanhe666"}*/
-	    cmd_wpa_connect(argc1,argv1);
-		
-		sleep(2);
+		/*切换连接无线网络（断开/连接需要等待，交给 Wi-Fi 线程）*/
+		if(wifi_connect_request(&cmd_body.net_parameter) < 0)
+			return -1;
 	}
 	else //有线部分
 	{
@@ -688,9 +631,14 @@ HLE_S32 cmd_request_login(HLE_S32 SessionID)
 // 退出登陆请求命令
 HLE_S32 cmd_request_logout(HLE_S32 SessionID)
 {
-
-	del_one_session_from_arr(SessionID);
-	PPCS_Close(SessionID);
+	//只标记下线，由信令线程统一关闭实时流、删除会话并 p2p_close（这里直接关会重复关闭）
+	session_status_t  status;
+	memset(&status,0,sizeof(status));
+	if(get_session_status(SessionID,&status) >= 0)
+	{
+		status.Session_status = OFFLINE;
+		set_session_status(SessionID,&status);
+	}
 		
 	DEBUG_LOG("cmd_request_logout sucess!\n");
 	return HLE_RET_OK;
@@ -721,36 +669,14 @@ HLE_S32 cmd_set_meg_push_level(HLE_S32 SessionID)
 }
 
 //设置时区(校时)命令
-HLE_S32 cmd_set_time_zone(HLE_S32 SessionID)
+HLE_S32 cmd_set_time_zone(HLE_S32 SessionID,const cmd_header_t *cmd)
 {
 	
 	S_SET_TIME_ZONE_REQUEST data_buf;
-	HLE_S32  BufSize = sizeof(S_SET_TIME_ZONE_REQUEST);
-
-	HLE_S32 ret = PPCS_Read(SessionID, CH_CMD, (CHAR*)&data_buf, &BufSize, 2000);
-	if(ret < 0)//读取出错
-	{
-		if (ERROR_PPCS_TIME_OUT == ret) 
-		{
-			ERROR_LOG("PPCS_Read timeout!!\n");
-			
-		}	
-		else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) 
-		{
-			ERROR_LOG("Remote site call close!!\n");
-			
-		}
-		else 
-		{
-			ERROR_LOG("PPCS_Read unknow error!ret=%d\n", ret);
-			
-			
-		}
+	if(cmd_get_request(cmd,&data_buf,sizeof(S_SET_TIME_ZONE_REQUEST)) < 0)
 		return HLE_RET_ERROR;
 
-	}
-	
-	DEBUG_LOG("Read TimeZone data success! BufSize(%d) ReadSize(%d)\n",BufSize,ret);
+	DEBUG_LOG("Read TimeZone data success! tzindex(%d) daylight(%d)\n",data_buf.tzindex,data_buf.daylight);
 
 	
 	time_t settime, difftime;		//time_t实际上就是一个long int型
@@ -808,74 +734,108 @@ HLE_S32 cmd_get_support_stream(HLE_S32 SessionID)
 
 
 /*******************************************************************************
-*@ Description    :打开实时流传输
+*@ Description    :获取运行统计
 *@ Input          :<SessionID> P2P会话ID
-					<cmd_header>命令头信息
 *@ Output         :
-*@ Return         :成功：0 ； 失败：-1
-*@ attention      :
+*@ Return         :成功：0 ； 失败：<0
+*@ attention      :回应为命令头 + JSON 文本（见 S_GET_METRICS_REQUEST 的说明）
 *******************************************************************************/
-int cmd_get_living_open(HLE_S32 SessionID,cmd_header_t cmd_header)
+HLE_S32 cmd_get_metrics(HLE_S32 SessionID)
 {
+	char *buf = (char *)malloc(sizeof(cmd_header_t) + METRICS_JSON_MAX);
+	if(NULL == buf)
+	{
+		ERROR_LOG("malloc failed!\n");
+		return HLE_RET_ENORESOURCE;
+	}
 
-	static open_living_args_t open_living_args; //必须为 static，否则传入到线程cmd_open_living会出现异常
-	S_GET_LIVING_OPEN_REQUEST cmd_body;
-		
-	//注意cmd_body 的 DEF_CMD_HEADER 部分在之前已经接收过了，这里需要跳过该部分
-	memset(&cmd_body,0,sizeof(S_GET_LIVING_OPEN_REQUEST));
-	memcpy(&cmd_body,&cmd_header,sizeof(cmd_header_t));
-	
-	HLE_S32 ReadSize = cmd_header.length; 
-	if(ReadSize != sizeof(S_GET_LIVING_OPEN_REQUEST) - sizeof(cmd_header_t))
+	HLE_S32 len = metrics_snapshot(buf + sizeof(cmd_header_t), METRICS_JSON_MAX);
+	if(len < 0)
 	{
-		ERROR_LOG("cmd_header.length is error !\n");
-		return -1;
+		ERROR_LOG("metrics snapshot too large!\n");
+		free(buf);
+		return HLE_RET_ERROR;
 	}
 
-	//注意：PPCS_Read 的返回值成功为0 ，实际读到的字节数会返回在传进去的变量ReadSize中。
-	HLE_S32 ret = PPCS_Read(SessionID, CH_CMD, (CHAR*)&cmd_body + sizeof(cmd_header_t) , &ReadSize, 2000);
-	if(ret < 0)//读取出错
+	cmd_header_t *header = (cmd_header_t *)buf;
+	header->head = HLE_MAGIC;
+	header->length = len;
+	header->type = 2;
+	header->command = CMD_GET_METRICS;
+	HLE_S32 ret = p2p_send(SessionID, CH_CMD, buf, sizeof(cmd_header_t) + len);
+	free(buf);
+	if(ret < 0)
 	{
-		if (ERROR_PPCS_TIME_OUT == ret) 
-		{
-			ERROR_LOG("PPCS_Read timeout !!\n");
-		}	
-		else if (ERROR_PPCS_SESSION_CLOSED_REMOTE == ret) 
-		{
-			ERROR_LOG("Remote site call close!!\n");
-		}
-		else 
-		{
-			ERROR_LOG("PPCS_Read: Channel=%d, ret=%d\n", CH_CMD, ret);
-		}
-		return -1;
+		ERROR_LOG("p2p_send ret=%d %s\n", ret, getP2PErrorCodeInfo(ret));
+		return HLE_RET_EIO;
 	}
+	return HLE_RET_OK;
+}
 
-	//body长度数据校验
-	if(ReadSize  != cmd_header.length)
+/*******************************************************************************
+*@ Description    :获取逐帧跟踪记录
+*@ Input          :<SessionID> P2P会话ID
+*@ Output         :
+*@ Return         :成功：0 ； 失败：<0
+*@ attention      :发送期间暂停跟踪（记录不会被覆盖，条数与命令头中的长度一致），发送完恢复
+*******************************************************************************/
+HLE_S32 cmd_get_trace(HLE_S32 SessionID)
+{
+	metrics_trace_rec_t rec[64];
+	cmd_header_t header;
+	HLE_U32 tracing = METRICS_FLAGS() & METRICS_F_TRACE;
+	HLE_U32 pos, cursor, num;
+	HLE_S32 n, ret;
+
+	if(tracing)
+		metrics_set_flags(METRICS_FLAGS() & ~METRICS_F_TRACE);
+	pos = metrics_trace_pos();
+	num = (pos < METRICS_TRACE_NUM) ? pos : METRICS_TRACE_NUM;
+	cursor = pos - num;
+
+	header.head = HLE_MAGIC;
+	header.length = num * sizeof(metrics_trace_rec_t);
+	header.type = 2;
+	header.command = CMD_GET_TRACE;
+	ret = p2p_send(SessionID, CH_CMD, &header, sizeof(header));
+	while(ret >= 0 && (n = metrics_trace_read(&cursor, rec, sizeof(rec) / sizeof(rec[0]))) > 0)
+		ret = p2p_send(SessionID, CH_CMD, rec, n * sizeof(metrics_trace_rec_t));
+
+	if(tracing)
+		metrics_set_flags(METRICS_FLAGS() | METRICS_F_TRACE);
+	if(ret < 0)
 	{
-		ERROR_LOG("check cmd body length error! ret(%d)\n",ret);
-		return -1;
+		ERROR_LOG("p2p_send ret=%d %s\n", ret, getP2PErrorCodeInfo(ret));
+		return HLE_RET_EIO;
 	}
+	return HLE_RET_OK;
+}
 
-	DEBUG_LOG("cmd_body.videoType(%d) cmd_body.openAudio(%u)\n",cmd_body.videoType,cmd_body.openAudio);
-	
-	//创建线程专门负责传流
-	memset(&open_living_args,0,sizeof(open_living_args));
-	memcpy(&open_living_args.cmd_data,&cmd_body,sizeof(S_GET_LIVING_OPEN_REQUEST));
-	open_living_args.SessionID = SessionID;
+/*******************************************************************************
+*@ Description    :打开实时流传输
+*@ Input          :<SessionID> P2P会话ID
+					<cmd>整条信令（信令头 + 信令体）
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+int cmd_get_living_open(HLE_S32 SessionID,const cmd_header_t *cmd)
+{
 
-	DEBUG_LOG("open_living_args.cmd_data.openAudio(%d) open_living_args.cmd_data.videoType(%d)\n",
-				open_living_args.cmd_data.openAudio,open_living_args.cmd_data.videoType);
+	S_GET_LIVING_OPEN_REQUEST cmd_body;
+	HLE_S32 ret;
+	if(cmd_get_request(cmd,&cmd_body,sizeof(S_GET_LIVING_OPEN_REQUEST)) < 0)
+		return -1;
+
+	DEBUG_LOG("cmd_body.videoType(%d) cmd_body.openAudio(%u)\n",cmd_body.videoType,cmd_body.openAudio);
 	
-	pthread_t living_threadID;
-	ret = pthread_create(&living_threadID, NULL, &cmd_open_living, &open_living_args);
-	if (0 != ret) 
+	//交给流发送线程，不再为每路实时流创建线程
+	ret = reactor_open_living(SessionID,cmd_body.videoType,cmd_body.openAudio);
+	if(ret < 0)
 	{
-		ERROR_LOG("pthread_create cmd_open_living failed!\n");
+		ERROR_LOG("reactor_open_living failed!\n");
 		return -1;
 	}
-	DEBUG_LOG("pthread_create cmd_open_living success,tid(%d)\n",living_threadID);
 
 	return 0;
 	
@@ -889,10 +849,12 @@ int cmd_get_living_open(HLE_S32 SessionID,cmd_header_t cmd_header)
 extern unsigned char* hisi_wlan_get_macaddr(void);
 /*******************************************************************************
 *@ Description    :命令解析函数
-*@ Input          :
+*@ Input          :<SessionID>会话ID
+					<data>整条信令：信令头 + 信令体
+					<length>信令总长度
 *@ Output         :
 *@ Return         :成功：HLE_RET_OK ； 失败：错误码
-*@ attention      :
+*@ attention      :在反应器的信令线程中调用，处理函数不能读传输层，也不能长时间等待（耗时的操作放到单独的线程）
 *******************************************************************************/
 HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 {
@@ -916,8 +878,8 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 		return HLE_RET_ERROR;
 	}
 
-	/*数据长度校验,此时只接收到“命令头”部分*/
-	if(sizeof(cmd_header_t) != length)
+	/*数据长度校验：反应器已经收齐信令头和信令体*/
+	if((HLE_S32)sizeof(cmd_header_t) + cmd_header.length != length)
 	{
 		ERROR_LOG("package data length error!\n");
 		return HLE_RET_ERROR;
@@ -931,7 +893,7 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 	switch(cmd_header.command)
 	{
 		case CMD_SET_CONT_NET_INFO:		//NET连接设置
-			cmd_set_connect_net(SessionID,cmd_header);
+			cmd_set_connect_net(SessionID,data);
 			break;
 
 		case CMD_GET_NET_STATUS:		//获取NET连接状态
@@ -964,7 +926,7 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 			break;
 		
 		case CMD_GET_LIVING_OPEN:		//打开实时流传输
-			cmd_get_living_open(SessionID,cmd_header);
+			cmd_get_living_open(SessionID,data);
 			break;
 				
 		case CMD_SET_LIVING_CLOSE:		//关闭实时流传输
@@ -976,7 +938,7 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 			break;
 		
 		case CMD_SET_UPDATE:			//升级命令
-			cmd_set_update(SessionID,cmd_header.length);
+			cmd_set_update(SessionID,data);
 			break;
 
 		case CMD_SET_RESTORE:			//恢复出厂设置
@@ -984,7 +946,11 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 			break;
 
 		case CMD_SET_TIME_ZONE:			//设置时区(校时)命令
-			cmd_set_time_zone(SessionID);
+			cmd_set_time_zone(SessionID,data);
+			break;
+
+		case CMD_SET_SD_FORMAT:			//格式化 SD 卡
+			cmd_set_sd_format(SessionID,data);
 			break;
 
 		case CMD_SET_LIGHT:				//设置LED灯参数
@@ -1005,6 +971,14 @@ HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID,cmd_header_t *data,HLE_S32 length)
 		case CMD_SET_MEG_PUSH_LEVEL:	//设置消息推送时间间隔
 			cmd_set_meg_push_level(SessionID);
 			break;
+
+		case CMD_GET_METRICS:			//获取运行统计
+			cmd_get_metrics(SessionID);
+			break;
+
+		case CMD_GET_TRACE:				//获取逐帧跟踪记录
+			cmd_get_trace(SessionID);
+			break;
 		
 		default:
 			DEBUG_LOG("illegal command!\n");
@@ -43,16 +43,19 @@ HLE_S32 cmd_read_dev_info(HLE_S32 SessionID);				//读设备信息
 HLE_S32 cmd_set_dev_para(HLE_S32 SessionID);  				//设置设备系统参数	
 HLE_S32 cmd_read_dev_para(HLE_S32 SessionID); 				//读取设备系统参数	
 HLE_S32 cmd_alarm_update(HLE_S32 SessionID); 				//报警通知
-HLE_S32 cmd_get_living_open(HLE_S32 SessionID,cmd_header_t cmd_header); 	//打开实时流传输
+HLE_S32 cmd_get_living_open(HLE_S32 SessionID,const cmd_header_t *cmd); 	//打开实时流传输
 HLE_S32 cmd_set_living_close(HLE_S32 SessionID); 				//关闭实时流传输
 HLE_S32 cmd_set_reboot(HLE_S32 SessionID); 					//重启命令
-HLE_S32 cmd_set_update(HLE_S32 SessionID,HLE_S32 readsize); 					//升级命令
-HLE_S32 cmd_set_connect_net(HLE_S32 SessionID,cmd_header_t cmd_header); 			//设置net连接	
+HLE_S32 cmd_set_update(HLE_S32 SessionID,const cmd_header_t *cmd); 					//升级命令
+HLE_S32 cmd_set_connect_net(HLE_S32 SessionID,const cmd_header_t *cmd); 			//设置net连接	
 HLE_S32 cmd_get_net_status(HLE_S32 SessionID); 				//获取net连接状态
 HLE_S32 cmd_request_login(HLE_S32 SessionID); 				// 登陆请求命令
 HLE_S32 cmd_request_logout(HLE_S32 SessionID); 				// 退出登陆请求命令
 HLE_S32 cmd_set_audio_vol(HLE_S32 SessionID); 				//设置AUdio音量参数
-HLE_S32 cmd_set_time_zone(HLE_S32 SessionID);				//时区设置（校时）
+HLE_S32 cmd_set_time_zone(HLE_S32 SessionID,const cmd_header_t *cmd);				//时区设置（校时）
+HLE_S32 cmd_set_sd_format(HLE_S32 SessionID,const cmd_header_t *cmd);				//格式化 SD 卡
+HLE_S32 cmd_get_metrics(HLE_S32 SessionID);				//获取运行统计
+HLE_S32 cmd_get_trace(HLE_S32 SessionID);					//获取逐帧跟踪记录
 
 HLE_S32 add_one_session_to_arr(HLE_S32 SessionID);	//添加一个会话到会话状态数组
 HLE_S32 get_session_status(HLE_S32 SessionID,session_status_t* status);
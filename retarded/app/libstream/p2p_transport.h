@@ -0,0 +1,110 @@
+/*********************************************************************************
+  *FileName: p2p_transport.h
+  *Create Date: 2026/10/19
+  *Description: P2P media server 的传输层抽象。信令/实时流只通过这里的接口收发，
+  *			 底层可以是尚云 PPCS，也可以是普通的 TCP/UDP（用于在 Linux 主机上联调和压测）。
+  *Others:  1.错误码沿用 PPCS_Error.h 的定义，上层对超时/远端关闭的判断不需要区分底层。
+  *		 2.收发语义和 PPCS_Read/PPCS_Write 一致：按通道区分的字节流，不保留消息边界。
+  *History:
+**********************************************************************************/
+#ifndef P2P_TRANSPORT_H
+#define P2P_TRANSPORT_H
+
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#include "typeport.h"
+#include "PPCS_Error.h"
+
+#define P2P_TRANSPORT_CH_NUM		8				//每个会话的通道数（与 PPCS 相同）
+#define P2P_SOCK_DEFAULT_PORT		32108			//TCP/UDP 传输默认的监听端口
+#define P2P_SOCK_MAX_SESSION		64				//TCP/UDP 传输同时存在的最大会话数
+#define P2P_SOCK_CH_BUF_SIZE		(64*1024)		//TCP/UDP 传输每个通道的接收缓存
+#define P2P_SOCK_SEND_TIMEOUT		3000			//TCP/UDP 传输发送超时（毫秒），超时视为会话断开
+#define P2P_UDP_MTU					1400			//UDP 传输每个数据报的最大负载
+#define P2P_PPCS_POLL_INTERVAL		10				//PPCS 没有可等待的句柄，poll 按这个间隔（毫秒）查询接收缓存
+
+typedef enum _p2p_transport_type_e
+{
+	P2P_TRANSPORT_PPCS = 0,		//尚云 PPCS（设备默认）
+	P2P_TRANSPORT_TCP,			//TCP，一个会话一条连接，通道复用在连接上
+	P2P_TRANSPORT_UDP,			//UDP，无重传，只适合局域网/回环压测
+	P2P_TRANSPORT_NUM
+}p2p_transport_type_e;
+
+#ifndef P2P_TRANSPORT_DEFAULT
+#define P2P_TRANSPORT_DEFAULT		P2P_TRANSPORT_PPCS
+#endif
+
+/*
+ * 传输层接口（所有返回值 < 0 时为 ERROR_PPCS_XXX 错误码）
+ */
+typedef struct _p2p_transport_t
+{
+	const HLE_S8 *name;
+	HLE_S32 support_wakeup;		//是否支持唤醒服务器（休眠/唤醒流程只对 PPCS 有意义）
+
+	/*初始化，param: PPCS 为 InitString，TCP/UDP 为监听地址 "ip:port"（NULL 用默认值）*/
+	HLE_S32 (*init)(const HLE_S8 *param);
+	HLE_S32 (*deinit)(void);
+
+	/*网络侦测（可为 NULL）*/
+	HLE_S32 (*net_detect)(void);
+
+	/*查询是否已登录 P2P 服务器（可为 NULL），status: 1 已登录，0 未登录*/
+	HLE_S32 (*login_status)(HLE_S8 *status);
+
+	/*等待客户端接入，成功返回 >= 0 的会话 ID*/
+	HLE_S32 (*listen)(const HLE_S8 *did, HLE_U32 timeout_sec, const HLE_S8 *license);
+
+	/*查询会话的对端地址，mode: 0 直连，1 转发*/
+	HLE_S32 (*check)(HLE_S32 session, struct sockaddr_in *remote, HLE_S32 *mode);
+
+	/*读取 *size 字节，返回 0 表示读满；超时返回 ERROR_PPCS_TIME_OUT，*size 为已读到的字节数*/
+	HLE_S32 (*read)(HLE_S32 session, HLE_U8 ch, void *buf, HLE_S32 *size, HLE_U32 timeout_ms);
+
+	/*写数据，成功返回写入（缓存）的字节数*/
+	HLE_S32 (*write)(HLE_S32 session, HLE_U8 ch, const void *buf, HLE_S32 size);
+
+	/*聚合写，iov 中的数据按顺序连续写入通道，成功返回写入的总字节数；可为 NULL（p2p_sendv 逐段 write）*/
+	HLE_S32 (*writev)(HLE_S32 session, HLE_U8 ch, const struct iovec *iov, HLE_S32 iovcnt);
+
+	/*查询通道里还没发出去的字节数*/
+	HLE_S32 (*check_buffer)(HLE_S32 session, HLE_U8 ch, HLE_U32 *wsize);
+
+	/*等待多个会话的 ch 通道可读（有数据或会话已断开），readable[i] 置 1 表示 session[i] 可读，
+	  返回可读的会话数，超时返回 0；wakeup 可以让正在等待的 poll 提前返回 0*/
+	HLE_S32 (*poll)(const HLE_S32 *session, HLE_S32 num, HLE_U8 ch, HLE_S8 *readable, HLE_U32 timeout_ms);
+	void (*wakeup)(void);
+
+	HLE_S32 (*close)(HLE_S32 session);
+	HLE_S32 (*force_close)(HLE_S32 session);
+}p2p_transport_t;
+
+extern const p2p_transport_t g_p2p_transport_ppcs;
+extern const p2p_transport_t g_p2p_transport_tcp;
+extern const p2p_transport_t g_p2p_transport_udp;
+
+
+/*******************************************************************************
+*@ Description    :选择传输层（必须在 p2p_init 之前调用，不调用则使用 P2P_TRANSPORT_DEFAULT）
+*@ Input          :<type>p2p_transport_type_e
+					<param>传给 init 的参数，NULL 使用默认值（PPCS 时忽略，使用 INITSTRING）
+*@ Output         :
+*@ Return         :成功：0 ； 失败：-1
+*@ attention      :
+*******************************************************************************/
+HLE_S32 p2p_transport_select(HLE_S32 type, const HLE_S8 *param);
+
+/*******************************************************************************
+*@ Description    :获取当前使用的传输层
+*@ Input          :
+*@ Output         :<param>select 时传入的参数（可为 NULL）
+*@ Return         :传输层接口
+*@ attention      :
+*******************************************************************************/
+const p2p_transport_t *p2p_transport_get(const HLE_S8 **param);
+
+
+#endif
+
@@ -0,0 +1,184 @@
+/*********************************************************************************
+  *FileName: p2p_transport_ppcs.c
+  *Create Date: 2026/10/19
+  *Description: 传输层的尚云 PPCS 实现，直接转调 PPCS_XXX 接口。
+  *Others:
+  *History:
+**********************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "PPCS_API.h"
+#include "PPCS_Error.h"
+#include "PPCS_Type.h"
+#include "media_server_p2p.h"
+#include "p2p_transport.h"
+
+
+static volatile HLE_S32 g_ppcs_wakeup = 0;		//ppcs_wakeup 置位，ppcs_poll 看到后提前返回
+
+
+static void ppcs_show_network(st_PPCS_NetInfo *NetInfo)
+{
+	st_info("-------------- NetInfo: -------------------\n");
+	st_info("Internet Reachable     : %s\n", (NetInfo->bFlagInternet == 1) ? "YES":"NO");
+	st_info("P2P Server IP resolved : %s\n", (NetInfo->bFlagHostResolved == 1) ? "YES":"NO");
+	st_info("P2P Server Hello Ack   : %s\n", (NetInfo->bFlagServerHello == 1) ? "YES":"NO");
+	switch(NetInfo->NAT_Type)
+	{
+	case 0: st_info("Local NAT Type         : Unknow\n"); break;
+	case 1: st_info("Local NAT Type         : IP-Restricted Cone\n"); break;
+	case 2: st_info("Local NAT Type         : Port-Restricted Cone\n"); break;
+	case 3: st_info("Local NAT Type         : Symmetric\n"); break;
+	}
+	st_info("My Wan IP : %s\n", NetInfo->MyWanIP);
+	st_info("My Lan IP : %s\n", NetInfo->MyLanIP);
+	st_info("-------------------------------------------\n");
+}
+
+static HLE_S32 ppcs_init(const HLE_S8 *param)
+{
+	UINT32 APIVersion = PPCS_GetAPIVersion();
+	st_info("P2P API Version: %d.%d.%d.%d\n",
+							(APIVersion & 0xFF000000)>>24,
+							(APIVersion & 0x00FF0000)>>16,
+							(APIVersion & 0x0000FF00)>>8,
+							(APIVersion & 0x000000FF)>>0);
+
+	INT32 ret = PPCS_Initialize((CHAR *)param);
+	DEBUG_LOG("PPCS_Initialize done! ret=%d\n", ret);
+	if(ERROR_PPCS_ALREADY_INITIALIZED == ret)
+		return ERROR_PPCS_SUCCESSFUL;
+	return ret;
+}
+
+static HLE_S32 ppcs_deinit(void)
+{
+	return PPCS_DeInitialize();
+}
+
+static HLE_S32 ppcs_net_detect(void)
+{
+	st_PPCS_NetInfo NetInfo;
+	memset(&NetInfo, 0, sizeof(NetInfo));
+	HLE_S32 ret = PPCS_NetworkDetect(&NetInfo, 0);
+	if(ret < 0)
+		return ret;
+	ppcs_show_network(&NetInfo);
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 ppcs_login_status(HLE_S8 *status)
+{
+	return PPCS_LoginStatus_Check((CHAR *)status);
+}
+
+static HLE_S32 ppcs_listen(const HLE_S8 *did, HLE_U32 timeout_sec, const HLE_S8 *license)
+{
+	return PPCS_Listen(did, timeout_sec, 0, 1, license);
+}
+
+static HLE_S32 ppcs_check(HLE_S32 session, struct sockaddr_in *remote, HLE_S32 *mode)
+{
+	st_PPCS_Session Sinfo;
+	memset(&Sinfo, 0, sizeof(Sinfo));
+	HLE_S32 ret = PPCS_Check(session, &Sinfo);
+	if(ret < 0)
+		return ret;
+	if(remote)
+		memcpy(remote, &Sinfo.RemoteAddr, sizeof(struct sockaddr_in));
+	if(mode)
+		*mode = Sinfo.bMode;
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 ppcs_read(HLE_S32 session, HLE_U8 ch, void *buf, HLE_S32 *size, HLE_U32 timeout_ms)
+{
+	return PPCS_Read(session, ch, (CHAR *)buf, size, timeout_ms);
+}
+
+static HLE_S32 ppcs_write(HLE_S32 session, HLE_U8 ch, const void *buf, HLE_S32 size)
+{
+	return PPCS_Write(session, ch, (CHAR *)buf, size);
+}
+
+static HLE_S32 ppcs_check_buffer(HLE_S32 session, HLE_U8 ch, HLE_U32 *wsize)
+{
+	return PPCS_Check_Buffer(session, ch, (UINT32 *)wsize, NULL);
+}
+
+/*******************************************************************************
+*@ Description    :等待多个会话的通道可读
+*@ attention      :PPCS 没有可以 select 的句柄，只能用 PPCS_Check_Buffer 查询接收缓存，
+					没有数据时按 P2P_PPCS_POLL_INTERVAL 间隔重新查询
+*******************************************************************************/
+static HLE_S32 ppcs_poll(const HLE_S32 *session, HLE_S32 num, HLE_U8 ch, HLE_S8 *readable, HLE_U32 timeout_ms)
+{
+	struct timeval start, now;
+	HLE_S32 i, ready;
+
+	gettimeofday(&start, NULL);
+	while(1)
+	{
+		ready = 0;
+		for(i = 0; i < num; i++)
+		{
+			UINT32 wsize = 0, rsize = 0;
+			HLE_S32 ret = PPCS_Check_Buffer(session[i], ch, &wsize, &rsize);
+			readable[i] = (ret < 0 || rsize > 0); //会话出错也算可读，由 read 取回错误码
+			ready += readable[i];
+		}
+		if(ready > 0)
+			return ready;
+		if(g_ppcs_wakeup)
+		{
+			g_ppcs_wakeup = 0;
+			return 0;
+		}
+
+		gettimeofday(&now, NULL);
+		HLE_U32 used = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+		if(used >= timeout_ms)
+			return 0;
+		usleep(P2P_PPCS_POLL_INTERVAL * 1000);
+	}
+}
+
+static void ppcs_wakeup(void)
+{
+	g_ppcs_wakeup = 1;
+}
+
+static HLE_S32 ppcs_close(HLE_S32 session)
+{
+	return PPCS_Close(session);
+}
+
+static HLE_S32 ppcs_force_close(HLE_S32 session)
+{
+	return PPCS_ForceClose(session);
+}
+
+const p2p_transport_t g_p2p_transport_ppcs =
+{
+	.name			= "ppcs",
+	.support_wakeup	= 1,
+	.init			= ppcs_init,
+	.deinit			= ppcs_deinit,
+	.net_detect		= ppcs_net_detect,
+	.login_status	= ppcs_login_status,
+	.listen			= ppcs_listen,
+	.check			= ppcs_check,
+	.read			= ppcs_read,
+	.write			= ppcs_write,
+	.writev			= NULL,			//SDK 没有聚合写，PPCS_Write 本身只是拷贝进通道缓存
+	.check_buffer	= ppcs_check_buffer,
+	.poll			= ppcs_poll,
+	.wakeup			= ppcs_wakeup,
+	.close			= ppcs_close,
+	.force_close	= ppcs_force_close,
+};
+
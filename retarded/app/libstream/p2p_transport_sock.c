@@ -0,0 +1,952 @@
+/*********************************************************************************
+  *FileName: p2p_transport_sock.c
+  *Create Date: 2026/10/19
+  *Description: 传输层的 TCP/UDP 实现，用来替代尚云 PPCS 在局域网/Linux 主机上跑通信令和实时流，
+  *			 方便用大量模拟客户端做压测。
+  *Others:
+  *	 1.TCP：一个会话一条连接，数据帧格式 [通道号 1B][长度 3B 大端][数据]，多个通道复用在同一条连接上。
+  *	 2.UDP：客户端先发 HELLO，设备用一个 connect 到客户端地址的新 socket（绑定同一端口）建立会话并回 HELLO。
+  *		   数据报格式 [通道号 1B][标志 1B][序号 2B 大端][数据 <= P2P_UDP_MTU]，没有重传，丢包只计数。
+  *	 3.接收端按通道解复用到各自的环形缓存，读某个通道时顺带把其他通道的数据分发出去。
+  *	 4.一次 write 的数据在连接上是连续的（加写锁），发送超时视为会话断开。
+  *	   writev 把多段数据合并进同一个 TCP 数据帧 / UDP 数据报，一次系统调用发出。
+  *	 5.poll 用 select 等待所有会话的 socket，外加一个 connect 到自己的回环 UDP socket 用于 wakeup。
+  *History:
+**********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "p2p_transport.h"
+
+#define SOCK_TCP_HDR_LEN		4
+#define SOCK_UDP_HDR_LEN		4
+#define SOCK_RX_BUF_SIZE		(P2P_UDP_MTU + SOCK_UDP_HDR_LEN)
+#define SOCK_SNDBUF_FULL		(256*1024)	//socket 不可写时 check_buffer 报告的待发字节数
+#define SOCK_IOV_MAX			32			//writev 每次系统调用最多携带的数据分段（另加一个包头）
+
+#define SOCK_UDP_DATA			0		//数据
+#define SOCK_UDP_HELLO			1		//建立会话（客户端发起，设备回应）
+#define SOCK_UDP_BYE			2		//关闭会话
+
+/*
+ * 通道接收缓存（环形）
+ */
+typedef struct _sock_chan_t
+{
+	HLE_U8 *buf;			//第一次收到该通道的数据时才分配
+	HLE_U32 head;
+	HLE_U32 len;
+}sock_chan_t;
+
+typedef struct _sock_session_t
+{
+	HLE_S32 used;
+	HLE_S32 id;						//会话ID = 序号 * P2P_SOCK_MAX_SESSION + 下标，避免下标复用后被旧 ID 误操作
+	HLE_S32 fd;
+	HLE_S32 err;					//< 0：会话已断开的原因
+	struct sockaddr_in remote;
+	pthread_mutex_t rlock;			//读（解复用）
+	pthread_mutex_t wlock;			//写（保证一次 write 的数据连续）
+
+	sock_chan_t ch[P2P_TRANSPORT_CH_NUM];
+	HLE_U8  rx[SOCK_RX_BUF_SIZE];	//socket 接收暂存
+	HLE_S32 rx_pos;
+	HLE_S32 rx_len;
+
+	/*TCP 解帧状态*/
+	HLE_U8  hdr[SOCK_TCP_HDR_LEN];
+	HLE_S32 hdr_len;
+	HLE_S32 frame_left;
+
+	/*UDP 序号*/
+	HLE_U16 tx_seq;
+	HLE_U16 rx_seq;
+	HLE_U32 rx_lost;
+}sock_session_t;
+
+typedef struct _sock_transport_t
+{
+	HLE_S32 udp;					//0：TCP  1：UDP
+	HLE_S32 listen_fd;
+	HLE_S32 wake_fd;				//wakeup 用的回环 UDP socket（connect 到自己）
+	struct sockaddr_in local;
+	HLE_U32 serial;
+	pthread_mutex_t lock;			//会话表
+	sock_session_t session[P2P_SOCK_MAX_SESSION];
+}sock_transport_t;
+
+static sock_transport_t g_sock = {.listen_fd = -1, .wake_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+static pthread_once_t g_sock_once = PTHREAD_ONCE_INIT;
+
+static void sock_once_init(void)
+{
+	HLE_S32 i;
+	for(i = 0; i < P2P_SOCK_MAX_SESSION; i++)
+	{
+		pthread_mutex_init(&g_sock.session[i].rlock, NULL);
+		pthread_mutex_init(&g_sock.session[i].wlock, NULL);
+		g_sock.session[i].fd = -1;
+	}
+}
+
+static HLE_U32 sock_tick_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*******************************************************************************
+*@ Description    :会话 ID 转换为会话结构（不加锁，调用者拿到 rlock/wlock 后要再检查一次 id）
+*******************************************************************************/
+static sock_session_t *sock_find(HLE_S32 session)
+{
+	if(session < 0)
+		return NULL;
+	sock_session_t *s = &g_sock.session[session % P2P_SOCK_MAX_SESSION];
+	if(!s->used || s->id != session)
+		return NULL;
+	return s;
+}
+
+/*---# 通道环形缓存 ------------------------------------------------------------*/
+static HLE_S32 chan_push(sock_chan_t *c, const HLE_U8 *data, HLE_S32 len)
+{
+	if(NULL == c->buf)
+	{
+		c->buf = (HLE_U8 *)malloc(P2P_SOCK_CH_BUF_SIZE);
+		if(NULL == c->buf)
+			return -1;
+		c->head = 0;
+		c->len = 0;
+	}
+	if(len > (HLE_S32)(P2P_SOCK_CH_BUF_SIZE - c->len))
+		return -1;
+
+	HLE_U32 tail = (c->head + c->len) % P2P_SOCK_CH_BUF_SIZE;
+	HLE_U32 first = P2P_SOCK_CH_BUF_SIZE - tail;
+	if(first > (HLE_U32)len)
+		first = len;
+	memcpy(c->buf + tail, data, first);
+	memcpy(c->buf, data + first, len - first);
+	c->len += len;
+	return 0;
+}
+
+static HLE_S32 chan_pop(sock_chan_t *c, HLE_U8 *out, HLE_S32 len)
+{
+	if(NULL == c->buf || 0 == c->len || len <= 0)
+		return 0;
+	if(len > (HLE_S32)c->len)
+		len = c->len;
+
+	HLE_U32 first = P2P_SOCK_CH_BUF_SIZE - c->head;
+	if(first > (HLE_U32)len)
+		first = len;
+	memcpy(out, c->buf + c->head, first);
+	memcpy(out + first, c->buf, len - first);
+	c->head = (c->head + len) % P2P_SOCK_CH_BUF_SIZE;
+	c->len -= len;
+	return len;
+}
+
+/*******************************************************************************
+*@ Description    :等待 fd 可读
+*@ Return         :可读：1 ； 超时：0 ； 出错：-1
+*******************************************************************************/
+static HLE_S32 sock_wait_readable(HLE_S32 fd, HLE_U32 timeout_ms)
+{
+	fd_set rfds;
+	struct timeval tv;
+	HLE_S32 ret;
+
+	do
+	{
+		FD_ZERO(&rfds);
+		FD_SET(fd, &rfds);
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+		ret = select(fd + 1, &rfds, NULL, NULL, &tv);
+	}while(ret < 0 && EINTR == errno);
+
+	return ret;
+}
+
+/*err 在收（rlock）和发（wlock）两边都会置位，check_buffer 等不加锁读取，都用原子访问*/
+static inline HLE_S32 sock_err(sock_session_t *s)
+{
+	return __atomic_load_n(&s->err, __ATOMIC_RELAXED);
+}
+
+static void sock_set_broken(sock_session_t *s, HLE_S32 err)
+{
+	HLE_S32 ok = 0;
+	__atomic_compare_exchange_n(&s->err, &ok, err, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED); //只保留第一次断开的原因
+}
+
+/*******************************************************************************
+*@ Description    :解析暂存区里的数据，分发到各通道
+*@ Return         :成功：0 ； 通道缓存溢出：-1
+*@ attention      :调用者持有 rlock
+*******************************************************************************/
+static HLE_S32 sock_tcp_dispatch(sock_session_t *s)
+{
+	while(s->rx_pos < s->rx_len)
+	{
+		HLE_S32 avail = s->rx_len - s->rx_pos;
+		if(s->hdr_len < SOCK_TCP_HDR_LEN)
+		{
+			HLE_S32 n = SOCK_TCP_HDR_LEN - s->hdr_len;
+			if(n > avail)
+				n = avail;
+			memcpy(s->hdr + s->hdr_len, s->rx + s->rx_pos, n);
+			s->hdr_len += n;
+			s->rx_pos += n;
+			if(s->hdr_len == SOCK_TCP_HDR_LEN)
+			{
+				s->frame_left = (s->hdr[1] << 16) | (s->hdr[2] << 8) | s->hdr[3];
+				if(s->hdr[0] >= P2P_TRANSPORT_CH_NUM)
+					return -1;
+				if(0 == s->frame_left)
+					s->hdr_len = 0;
+			}
+			continue;
+		}
+
+		HLE_S32 n = s->frame_left < avail ? s->frame_left : avail;
+		if(chan_push(&s->ch[s->hdr[0]], s->rx + s->rx_pos, n) < 0)
+			return -1;
+		s->rx_pos += n;
+		s->frame_left -= n;
+		if(0 == s->frame_left)
+			s->hdr_len = 0;
+	}
+	return 0;
+}
+
+static HLE_S32 sock_udp_send(sock_session_t *s, HLE_U8 ch, HLE_U8 flag, const void *data, HLE_S32 len);
+
+static HLE_S32 sock_udp_dispatch(sock_session_t *s)
+{
+	HLE_S32 len = s->rx_len;
+	s->rx_pos = s->rx_len;
+	if(len < SOCK_UDP_HDR_LEN || s->rx[0] >= P2P_TRANSPORT_CH_NUM)
+		return 0;
+
+	HLE_U8 flag = s->rx[1];
+	HLE_U16 seq = (s->rx[2] << 8) | s->rx[3];
+	if(SOCK_UDP_HELLO == flag) //客户端没收到回应，重发的 HELLO
+	{
+		sock_udp_send(s, 0, SOCK_UDP_HELLO, NULL, 0);
+		return 0;
+	}
+	if(SOCK_UDP_BYE == flag)
+	{
+		sock_set_broken(s, ERROR_PPCS_SESSION_CLOSED_REMOTE);
+		return 0;
+	}
+	if(seq != s->rx_seq)
+		s->rx_lost += (HLE_U16)(seq - s->rx_seq);
+	s->rx_seq = seq + 1;
+	return chan_push(&s->ch[s->rx[0]], s->rx + SOCK_UDP_HDR_LEN, len - SOCK_UDP_HDR_LEN);
+}
+
+/*******************************************************************************
+*@ Description    :从 socket 收一次数据并分发到各通道
+*@ Return         :收到数据：1 ； 超时：0 ； 会话断开：< 0 的错误码
+*@ attention      :调用者持有 rlock
+*******************************************************************************/
+static HLE_S32 sock_pump(sock_session_t *s, HLE_U32 timeout_ms)
+{
+	HLE_S32 ret = sock_wait_readable(s->fd, timeout_ms);
+	if(0 == ret)
+		return 0;
+	if(ret < 0)
+	{
+		sock_set_broken(s, ERROR_PPCS_SESSION_CLOSED_REMOTE);
+		return sock_err(s);
+	}
+
+	//UDP 的数据报至少带 4 字节头，收到 0 字节说明 socket 已被 shutdown
+	HLE_S32 n = recv(s->fd, s->rx, sizeof(s->rx), 0);
+	if(n < 0 && (EINTR == errno || EAGAIN == errno || (ECONNREFUSED == errno && g_sock.udp)))
+		return 0;
+	if(n <= 0)
+	{
+		sock_set_broken(s, ERROR_PPCS_SESSION_CLOSED_REMOTE);
+		return sock_err(s);
+	}
+	s->rx_pos = 0;
+	s->rx_len = n;
+
+	ret = g_sock.udp ? sock_udp_dispatch(s) : sock_tcp_dispatch(s);
+	if(ret < 0)
+	{
+		ERROR_LOG("session(%d) channel buffer overflow!\n", s->id);
+		sock_set_broken(s, ERROR_PPCS_SESSION_CLOSED_INSUFFICIENT_MEMORY);
+		shutdown(s->fd, SHUT_RDWR);
+		return sock_err(s);
+	}
+	return 1;
+}
+
+/*******************************************************************************
+*@ Description    :阻塞发送（socket 设置了发送超时），全部发完才返回
+*@ Return         :成功：0 ； 失败：-1
+*******************************************************************************/
+static HLE_S32 sock_send_all(HLE_S32 fd, struct iovec *iov, HLE_S32 iovcnt)
+{
+	while(iovcnt > 0)
+	{
+		ssize_t n = writev(fd, iov, iovcnt);
+		if(n < 0)
+		{
+			if(EINTR == errno)
+				continue;
+			return -1;
+		}
+		while(iovcnt > 0 && (size_t)n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if(iovcnt > 0)
+		{
+			iov->iov_base = (HLE_U8 *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+/*发送一个数据报，data 由 iov[1..cnt] 组成，iov[0] 留给包头*/
+static HLE_S32 sock_udp_sendv(sock_session_t *s, HLE_U8 ch, HLE_U8 flag, struct iovec *iov, HLE_S32 cnt)
+{
+	HLE_U8 hdr[SOCK_UDP_HDR_LEN];
+
+	hdr[0] = ch;
+	hdr[1] = flag;
+	hdr[2] = s->tx_seq >> 8;
+	hdr[3] = s->tx_seq & 0xFF;
+	if(SOCK_UDP_DATA == flag)
+		s->tx_seq ++;
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(hdr);
+	return sock_send_all(s->fd, iov, cnt + 1);
+}
+
+static HLE_S32 sock_udp_send(sock_session_t *s, HLE_U8 ch, HLE_U8 flag, const void *data, HLE_S32 len)
+{
+	struct iovec iov[2];
+
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+	return sock_udp_sendv(s, ch, flag, iov, len > 0 ? 1 : 0);
+}
+
+/*******************************************************************************
+*@ Description    :从 src 的 (*idx, *off) 位置起取最多 max 字节，只记录地址不拷贝数据
+*@ Input          :<src><cnt>源 iov
+					<max>本次最多取的字节数
+*@ Output         :<idx><off>取完后的位置
+					<dst><dst_cnt>取到的分段（最多 SOCK_IOV_MAX 段）
+*@ Return         :取到的字节数
+*******************************************************************************/
+static HLE_S32 sock_iov_take(const struct iovec *src, HLE_S32 cnt, HLE_S32 *idx, size_t *off,
+							 struct iovec *dst, HLE_S32 *dst_cnt, HLE_S32 max)
+{
+	HLE_S32 got = 0;
+
+	*dst_cnt = 0;
+	while(*idx < cnt && got < max && *dst_cnt < SOCK_IOV_MAX)
+	{
+		size_t n = src[*idx].iov_len - *off;
+		if(n > (size_t)(max - got))
+			n = max - got;
+		if(n > 0)
+		{
+			dst[*dst_cnt].iov_base = (HLE_U8 *)src[*idx].iov_base + *off;
+			dst[*dst_cnt].iov_len = n;
+			(*dst_cnt) ++;
+			got += n;
+			*off += n;
+		}
+		if(*off >= src[*idx].iov_len)
+		{
+			(*idx) ++;
+			*off = 0;
+		}
+	}
+	return got;
+}
+
+static void sock_set_opt(HLE_S32 fd)
+{
+	struct timeval tv;
+	tv.tv_sec = P2P_SOCK_SEND_TIMEOUT / 1000;
+	tv.tv_usec = (P2P_SOCK_SEND_TIMEOUT % 1000) * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	if(!g_sock.udp)
+	{
+		HLE_S32 on = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+}
+
+/*******************************************************************************
+*@ Description    :分配一个会话
+*@ Return         :成功：会话ID ； 失败：ERROR_PPCS_MAX_SESSION
+*******************************************************************************/
+static HLE_S32 sock_session_new(HLE_S32 fd, const struct sockaddr_in *remote)
+{
+	HLE_S32 i;
+
+	pthread_mutex_lock(&g_sock.lock);
+	for(i = 0; i < P2P_SOCK_MAX_SESSION; i++)
+	{
+		sock_session_t *s = &g_sock.session[i];
+		if(s->used)
+			continue;
+
+		g_sock.serial = (g_sock.serial + 1) % (0x7FFFFFFF / P2P_SOCK_MAX_SESSION);
+		s->id = g_sock.serial * P2P_SOCK_MAX_SESSION + i;
+		s->fd = fd;
+		s->err = 0;
+		s->remote = *remote;
+		s->rx_pos = s->rx_len = 0;
+		s->hdr_len = 0;
+		s->frame_left = 0;
+		s->tx_seq = s->rx_seq = 0;
+		s->rx_lost = 0;
+		s->used = 1;
+		pthread_mutex_unlock(&g_sock.lock);
+		return s->id;
+	}
+	pthread_mutex_unlock(&g_sock.lock);
+	return ERROR_PPCS_MAX_SESSION;
+}
+
+/*******************************************************************************
+*@ Description    :创建 wakeup 用的回环 UDP socket（bind 127.0.0.1 后 connect 到自己）
+*@ Return         :成功：fd ； 失败：-1（poll 只能等到超时才能发现新会话）
+*******************************************************************************/
+static HLE_S32 sock_wake_open(void)
+{
+	struct sockaddr_in addr;
+	socklen_t alen = sizeof(addr);
+
+	HLE_S32 fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		getsockname(fd, (struct sockaddr *)&addr, &alen) < 0 ||
+		connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		ERROR_LOG("wakeup socket failed! errno=%d\n", errno);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*---# 传输层接口 ------------------------------------------------------------*/
+static HLE_S32 sock_init(HLE_S32 udp, const HLE_S8 *param)
+{
+	HLE_S8 ip[32] = "0.0.0.0";
+	HLE_S32 port = P2P_SOCK_DEFAULT_PORT;
+	HLE_S32 on = 1;
+
+	pthread_once(&g_sock_once, sock_once_init);
+	if(g_sock.listen_fd >= 0)
+		return ERROR_PPCS_ALREADY_INITIALIZED;
+
+	if(param && param[0])
+	{
+		const HLE_S8 *colon = strchr(param, ':');
+		if(colon)
+		{
+			if(colon != param && colon - param < (HLE_S32)sizeof(ip))
+			{
+				memcpy(ip, param, colon - param);
+				ip[colon - param] = '\0';
+			}
+			port = atoi(colon + 1);
+		}
+		else if(strlen(param) < sizeof(ip))
+		{
+			strcpy(ip, param);
+		}
+	}
+
+	memset(&g_sock.local, 0, sizeof(g_sock.local));
+	g_sock.local.sin_family = AF_INET;
+	g_sock.local.sin_port = htons(port);
+	g_sock.local.sin_addr.s_addr = inet_addr(ip);
+
+	HLE_S32 fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+	if(fd < 0)
+	{
+		ERROR_LOG("socket failed! errno=%d\n", errno);
+		return ERROR_PPCS_UDP_PORT_BIND_FAILED;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if(bind(fd, (struct sockaddr *)&g_sock.local, sizeof(g_sock.local)) < 0 || (!udp && listen(fd, 16) < 0))
+	{
+		ERROR_LOG("bind %s:%d failed! errno=%d\n", ip, port, errno);
+		close(fd);
+		return ERROR_PPCS_UDP_PORT_BIND_FAILED;
+	}
+	if(0 == port) //端口由系统分配，记下来给客户端用
+	{
+		socklen_t alen = sizeof(g_sock.local);
+		getsockname(fd, (struct sockaddr *)&g_sock.local, &alen);
+	}
+
+	g_sock.udp = udp;
+	g_sock.listen_fd = fd;
+	g_sock.wake_fd = sock_wake_open();
+	DEBUG_LOG("p2p %s transport listen on %s:%d\n", udp ? "udp" : "tcp", ip, ntohs(g_sock.local.sin_port));
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 sock_tcp_init(const HLE_S8 *param)
+{
+	return sock_init(0, param);
+}
+
+static HLE_S32 sock_udp_init(const HLE_S8 *param)
+{
+	return sock_init(1, param);
+}
+
+static HLE_S32 sock_close(HLE_S32 session);
+
+static HLE_S32 sock_deinit(void)
+{
+	HLE_S32 i;
+
+	if(g_sock.listen_fd < 0)
+		return ERROR_PPCS_NOT_INITIALIZED;
+	for(i = 0; i < P2P_SOCK_MAX_SESSION; i++)
+	{
+		if(g_sock.session[i].used)
+			sock_close(g_sock.session[i].id);
+	}
+	close(g_sock.listen_fd);
+	g_sock.listen_fd = -1;
+	if(g_sock.wake_fd >= 0)
+		close(g_sock.wake_fd);
+	g_sock.wake_fd = -1;
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 sock_tcp_accept(void)
+{
+	struct sockaddr_in remote;
+	socklen_t alen = sizeof(remote);
+
+	HLE_S32 fd = accept(g_sock.listen_fd, (struct sockaddr *)&remote, &alen);
+	if(fd < 0)
+		return ERROR_PPCS_TIME_OUT;
+	sock_set_opt(fd);
+
+	HLE_S32 id = sock_session_new(fd, &remote);
+	if(id < 0)
+		close(fd);
+	return id;
+}
+
+static HLE_S32 sock_udp_accept(void)
+{
+	struct sockaddr_in remote;
+	socklen_t alen = sizeof(remote);
+	HLE_U8 hello[SOCK_RX_BUF_SIZE];
+	HLE_S32 on = 1;
+
+	HLE_S32 n = recvfrom(g_sock.listen_fd, hello, sizeof(hello), 0, (struct sockaddr *)&remote, &alen);
+	if(n < SOCK_UDP_HDR_LEN || SOCK_UDP_HELLO != hello[1])
+		return ERROR_PPCS_TIME_OUT; //不是建立会话的包（比如会话建立前的残留数据），丢弃
+
+	/*同一端口再绑定一个 socket 并 connect 到客户端，之后该客户端的数据报都由这个 socket 接收*/
+	HLE_S32 fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd < 0)
+		return ERROR_PPCS_TIME_OUT;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if(bind(fd, (struct sockaddr *)&g_sock.local, sizeof(g_sock.local)) < 0 ||
+		connect(fd, (struct sockaddr *)&remote, sizeof(remote)) < 0)
+	{
+		ERROR_LOG("udp session socket failed! errno=%d\n", errno);
+		close(fd);
+		return ERROR_PPCS_TIME_OUT;
+	}
+	sock_set_opt(fd);
+
+	HLE_S32 id = sock_session_new(fd, &remote);
+	if(id < 0)
+	{
+		close(fd);
+		return id;
+	}
+	sock_udp_send(sock_find(id), 0, SOCK_UDP_HELLO, NULL, 0);
+	return id;
+}
+
+static HLE_S32 sock_listen(const HLE_S8 *did, HLE_U32 timeout_sec, const HLE_S8 *license)
+{
+	HLE_U32 start = sock_tick_ms();
+	HLE_U32 timeout_ms = timeout_sec * 1000;
+
+	if(g_sock.listen_fd < 0)
+		return ERROR_PPCS_NOT_INITIALIZED;
+
+	while(1)
+	{
+		HLE_U32 used = sock_tick_ms() - start;
+		if(used >= timeout_ms)
+			return ERROR_PPCS_TIME_OUT;
+
+		HLE_S32 ret = sock_wait_readable(g_sock.listen_fd, timeout_ms - used);
+		if(ret < 0)
+			return ERROR_PPCS_USER_LISTEN_BREAK;
+		if(0 == ret)
+			return ERROR_PPCS_TIME_OUT;
+
+		ret = g_sock.udp ? sock_udp_accept() : sock_tcp_accept();
+		if(ret != ERROR_PPCS_TIME_OUT)
+			return ret;
+	}
+}
+
+static HLE_S32 sock_check(HLE_S32 session, struct sockaddr_in *remote, HLE_S32 *mode)
+{
+	sock_session_t *s = sock_find(session);
+	if(NULL == s)
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+	if(sock_err(s) < 0)
+		return sock_err(s);
+	if(remote)
+		*remote = s->remote;
+	if(mode)
+		*mode = 0;
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 sock_read(HLE_S32 session, HLE_U8 ch, void *buf, HLE_S32 *size, HLE_U32 timeout_ms)
+{
+	if(NULL == buf || NULL == size || *size < 0 || ch >= P2P_TRANSPORT_CH_NUM)
+		return ERROR_PPCS_INVALID_PARAMETER;
+
+	sock_session_t *s = sock_find(session);
+	if(NULL == s)
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+
+	pthread_mutex_lock(&s->rlock);
+	if(!s->used || s->id != session)
+	{
+		pthread_mutex_unlock(&s->rlock);
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+	}
+
+	HLE_S32 want = *size;
+	HLE_S32 got = 0;
+	HLE_S32 pumped = 0;
+	HLE_S32 ret;
+	HLE_U32 start = sock_tick_ms();
+	while(1)
+	{
+		got += chan_pop(&s->ch[ch], (HLE_U8 *)buf + got, want - got);
+		if(got == want)
+		{
+			ret = ERROR_PPCS_SUCCESSFUL;
+			break;
+		}
+		if(sock_err(s) < 0)
+		{
+			ret = sock_err(s);
+			break;
+		}
+		HLE_U32 used = sock_tick_ms() - start;
+		if(used >= timeout_ms && pumped) //timeout_ms 为 0 时也要把 socket 里已有的数据收一次
+		{
+			ret = ERROR_PPCS_TIME_OUT;
+			break;
+		}
+		sock_pump(s, used >= timeout_ms ? 0 : timeout_ms - used);
+		pumped = 1;
+	}
+	pthread_mutex_unlock(&s->rlock);
+
+	*size = got;
+	return ret;
+}
+
+static HLE_S32 sock_writev(HLE_S32 session, HLE_U8 ch, const struct iovec *iov, HLE_S32 iovcnt)
+{
+	if(NULL == iov || iovcnt < 0 || ch >= P2P_TRANSPORT_CH_NUM)
+		return ERROR_PPCS_INVALID_PARAMETER;
+
+	sock_session_t *s = sock_find(session);
+	if(NULL == s)
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+
+	pthread_mutex_lock(&s->wlock);
+	if(!s->used || s->id != session)
+	{
+		pthread_mutex_unlock(&s->wlock);
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+	}
+	if(sock_err(s) < 0)
+	{
+		pthread_mutex_unlock(&s->wlock);
+		return sock_err(s);
+	}
+
+	/*多段数据合并进同一个 TCP 数据帧 / UDP 数据报，一次系统调用发出，不拷贝*/
+	struct iovec out[SOCK_IOV_MAX + 1];
+	HLE_S32 idx = 0;
+	size_t off = 0;
+	HLE_S32 total = 0;
+	HLE_S32 ret = 0;
+	while(0 == ret)
+	{
+		HLE_S32 cnt = 0;
+		HLE_S32 n = sock_iov_take(iov, iovcnt, &idx, &off, out + 1, &cnt, g_sock.udp ? P2P_UDP_MTU : 0xFFFFFF);
+		if(0 == n)
+			break;
+		if(g_sock.udp)
+		{
+			ret = sock_udp_sendv(s, ch, SOCK_UDP_DATA, out, cnt);
+		}
+		else
+		{
+			HLE_U8 hdr[SOCK_TCP_HDR_LEN];
+			hdr[0] = ch;
+			hdr[1] = (n >> 16) & 0xFF;
+			hdr[2] = (n >> 8) & 0xFF;
+			hdr[3] = n & 0xFF;
+			out[0].iov_base = hdr;
+			out[0].iov_len = sizeof(hdr);
+			ret = sock_send_all(s->fd, out, cnt + 1);
+		}
+		total += n;
+	}
+
+	if(ret < 0)
+	{
+		//帧已经发出去一部分，连接上的数据不再完整，只能断开
+		sock_set_broken(s, (EAGAIN == errno || EWOULDBLOCK == errno) ? ERROR_PPCS_SESSION_CLOSED_TIMEOUT : ERROR_PPCS_SESSION_CLOSED_REMOTE);
+		shutdown(s->fd, SHUT_RDWR);
+		ret = sock_err(s);
+	}
+	else
+	{
+		ret = total;
+	}
+	pthread_mutex_unlock(&s->wlock);
+	return ret;
+}
+
+static HLE_S32 sock_write(HLE_S32 session, HLE_U8 ch, const void *buf, HLE_S32 size)
+{
+	struct iovec iov;
+
+	if(NULL == buf || size < 0)
+		return ERROR_PPCS_INVALID_PARAMETER;
+	iov.iov_base = (void *)buf;
+	iov.iov_len = size;
+	return sock_writev(session, ch, &iov, 1);
+}
+
+static HLE_S32 sock_check_buffer(HLE_S32 session, HLE_U8 ch, HLE_U32 *wsize)
+{
+	sock_session_t *s = sock_find(session);
+	if(NULL == s)
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+	if(sock_err(s) < 0)
+		return sock_err(s);
+	if(wsize)
+	{
+		HLE_S32 pending = 0;
+#ifdef TIOCOUTQ
+		//内核发送队列里还没被对端确认的字节数（整条连接，不区分通道）
+		if(!g_sock.udp && ioctl(s->fd, TIOCOUTQ, &pending) < 0)
+			pending = 0;
+#endif
+		if(!g_sock.udp)
+		{
+			//发送缓存已满时再写会阻塞（最长 P2P_SOCK_SEND_TIMEOUT），报告为拥塞让上层先丢帧
+			fd_set wfds;
+			struct timeval tv = {0, 0};
+			FD_ZERO(&wfds);
+			FD_SET(s->fd, &wfds);
+			if(select(s->fd + 1, NULL, &wfds, NULL, &tv) == 0 && pending < SOCK_SNDBUF_FULL)
+				pending = SOCK_SNDBUF_FULL;
+		}
+		*wsize = pending;
+	}
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+static HLE_S32 sock_poll(const HLE_S32 *session, HLE_S32 num, HLE_U8 ch, HLE_S8 *readable, HLE_U32 timeout_ms)
+{
+	fd_set rfds;
+	struct timeval tv;
+	HLE_S32 i, ret;
+	HLE_S32 ready = 0;
+	HLE_S32 maxfd = -1;
+
+	if(NULL == session || NULL == readable || num < 0 || ch >= P2P_TRANSPORT_CH_NUM)
+		return ERROR_PPCS_INVALID_PARAMETER;
+
+	/*通道缓存里已经有数据（或会话已断开）的直接算可读，其余的等 socket*/
+	FD_ZERO(&rfds);
+	for(i = 0; i < num; i++)
+	{
+		sock_session_t *s = sock_find(session[i]);
+		readable[i] = 1;
+		if(NULL == s)
+			continue;
+		pthread_mutex_lock(&s->rlock);
+		if(s->used && s->id == session[i] && 0 == sock_err(s) && 0 == s->ch[ch].len && s->fd >= 0)
+		{
+			readable[i] = 0;
+			FD_SET(s->fd, &rfds);
+			if(s->fd > maxfd)
+				maxfd = s->fd;
+		}
+		pthread_mutex_unlock(&s->rlock);
+		ready += readable[i];
+	}
+	if(ready > 0)
+		return ready;
+
+	if(g_sock.wake_fd >= 0)
+	{
+		FD_SET(g_sock.wake_fd, &rfds);
+		if(g_sock.wake_fd > maxfd)
+			maxfd = g_sock.wake_fd;
+	}
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	ret = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+	if(ret <= 0)
+		return 0;
+
+	if(g_sock.wake_fd >= 0 && FD_ISSET(g_sock.wake_fd, &rfds))
+	{
+		HLE_U8 drain[16];
+		while(recv(g_sock.wake_fd, drain, sizeof(drain), MSG_DONTWAIT) > 0);
+	}
+	for(i = 0; i < num; i++)
+	{
+		sock_session_t *s = sock_find(session[i]);
+		if(s && s->fd >= 0 && FD_ISSET(s->fd, &rfds))
+		{
+			readable[i] = 1;
+			ready++;
+		}
+	}
+	return ready;
+}
+
+static void sock_wakeup(void)
+{
+	if(g_sock.wake_fd >= 0)
+		send(g_sock.wake_fd, "w", 1, MSG_DONTWAIT);
+}
+
+static HLE_S32 sock_close(HLE_S32 session)
+{
+	HLE_S32 i;
+	sock_session_t *s = sock_find(session);
+	if(NULL == s)
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+
+	//先 shutdown 唤醒阻塞在读写上的线程，再拿锁释放资源
+	if(g_sock.udp)
+		sock_udp_send(s, 0, SOCK_UDP_BYE, NULL, 0);
+	shutdown(s->fd, SHUT_RDWR);
+	pthread_mutex_lock(&s->rlock);
+	pthread_mutex_lock(&s->wlock);
+	pthread_mutex_lock(&g_sock.lock);
+	if(!s->used || s->id != session)
+	{
+		pthread_mutex_unlock(&g_sock.lock);
+		pthread_mutex_unlock(&s->wlock);
+		pthread_mutex_unlock(&s->rlock);
+		return ERROR_PPCS_INVALID_SESSION_HANDLE;
+	}
+	if(s->rx_lost)
+		ERROR_LOG("udp session(%d) lost %u datagrams!\n", session, s->rx_lost);
+	close(s->fd);
+	s->fd = -1;
+	for(i = 0; i < P2P_TRANSPORT_CH_NUM; i++)
+	{
+		free(s->ch[i].buf);
+		s->ch[i].buf = NULL;
+		s->ch[i].len = 0;
+	}
+	s->used = 0;
+	pthread_mutex_unlock(&g_sock.lock);
+	pthread_mutex_unlock(&s->wlock);
+	pthread_mutex_unlock(&s->rlock);
+	return ERROR_PPCS_SUCCESSFUL;
+}
+
+const p2p_transport_t g_p2p_transport_tcp =
+{
+	.name			= "tcp",
+	.support_wakeup	= 0,
+	.init			= sock_tcp_init,
+	.deinit			= sock_deinit,
+	.net_detect		= NULL,
+	.login_status	= NULL,
+	.listen			= sock_listen,
+	.check			= sock_check,
+	.read			= sock_read,
+	.write			= sock_write,
+	.writev			= sock_writev,
+	.check_buffer	= sock_check_buffer,
+	.poll			= sock_poll,
+	.wakeup			= sock_wakeup,
+	.close			= sock_close,
+	.force_close	= sock_close,
+};
+
+const p2p_transport_t g_p2p_transport_udp =
+{
+	.name			= "udp",
+	.support_wakeup	= 0,
+	.init			= sock_udp_init,
+	.deinit			= sock_deinit,
+	.net_detect		= NULL,
+	.login_status	= NULL,
+	.listen			= sock_listen,
+	.check			= sock_check,
+	.read			= sock_read,
+	.write			= sock_write,
+	.writev			= sock_writev,
+	.check_buffer	= sock_check_buffer,
+	.poll			= sock_poll,
+	.wakeup			= sock_wakeup,
+	.close			= sock_close,
+	.force_close	= sock_close,
+};
+
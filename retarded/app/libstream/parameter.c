@@ -1,27 +1,537 @@
- 
 /***************************************************************************
-* @file:parameter.c 
-* @author:   
+* @file:parameter.c
+* @author:
 * @date:  7,9,2019
-* @brief:  
+* @brief:
 * @attention:参数文件保存+提取+解析相关函数
+			参数以“分区记录”的日志形式保存在 jffs0 上（见 parameter.h），两个日志文件 A/B 交替整理。
 ***************************************************************************/
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <errno.h>
 
 
 
 
 #include "parameter.h"
 
-#define SYS_PARAM_FILE		"/jffs0/sys_param.config"
+#ifndef PARAM_DIR
+#define PARAM_DIR			"/jffs0"	//参数文件所在目录（主机测试时改到临时目录）
+#endif
+#define SYS_PARAM_FILE		PARAM_DIR "/sys_param.config"	//旧格式（整个结构体），只在升级后第一次启动时迁移
+#define PARAM_LOG_FILE_A	PARAM_DIR "/sys_param.log0"
+#define PARAM_LOG_FILE_B	PARAM_DIR "/sys_param.log1"
+#define PARAM_LOG_MAGIC		0x504C4F47	//"PLOG"
+#define PARAM_REC_MAGIC		0x5052		//"PR"
+#define PARAM_LOG_MAX_SIZE	(16*1024)	//日志超过该大小时整理到另一个文件
+#define PARAM_COMMIT_DELAY	2000		//最后一次修改后等待这么久再写（合并连续的修改，如拖动滑块）（毫秒）
+#define PARAM_COMMIT_MAX	10000		//有修改没写入时最多等待这么久（毫秒）
+
+/*日志文件头，整理时最后写入，文件头无效的日志文件不会被使用*/
+typedef struct _param_log_head_t
+{
+	HLE_U32 magic;				//PARAM_LOG_MAGIC
+	HLE_U32 generation;			//整理次数，两个文件都有效时使用 generation 大的
+	HLE_U32 reserved;
+	HLE_U32 crc;				//文件头（crc 填 0）的 CRC32
+}param_log_head_t;
+
+/*参数记录：记录头 + length 字节的分区数据，追加写入日志文件*/
+typedef struct _param_record_t
+{
+	HLE_U16 magic;				//PARAM_REC_MAGIC
+	HLE_U8  key;				//参数分区，参考 E_PARAM_KEY
+	HLE_U8  reserved;
+	HLE_U16 length;				//分区数据长度（固件升级后结构体变长/变短时按较短的拷贝）
+	HLE_U16 reserved2;
+	HLE_U32 version;			//记录版本号，全局递增，同一分区以版本号最大的记录为准
+	HLE_U32 crc;				//记录头（crc 填 0）+ 分区数据的 CRC32
+}param_record_t;
+
+typedef enum
+{
+	PARAM_KEY_NET = 0,
+	PARAM_KEY_P2P,
+	PARAM_KEY_MD,
+	PARAM_KEY_ACODEC,
+	PARAM_KEY_VCODEC,
+	PARAM_KEY_LIGHT,
+	PARAM_KEY_NUM
+}E_PARAM_KEY;
+
+/*各参数分区在 system_parameter_t 中的位置*/
+static const struct
+{
+	HLE_U16 offset;
+	HLE_U16 size;
+}g_param_keys[PARAM_KEY_NUM] =
+{
+	{offsetof(system_parameter_t, Net_param),    sizeof(Net_parameter_t)},
+	{offsetof(system_parameter_t, P2P_param),    sizeof(P2P_parameter_t)},
+	{offsetof(system_parameter_t, MD_param),     sizeof(MD_parameter_t)},
+	{offsetof(system_parameter_t, Acodec_param), sizeof(Acodec_parameter_t)},
+	{offsetof(system_parameter_t, Vcodec_param), sizeof(Vcodec_parameter_t)},
+	{offsetof(system_parameter_t, Light_param),  sizeof(Light_parameter_t)},
+};
+
+static const char *g_param_log_files[2] = {PARAM_LOG_FILE_A, PARAM_LOG_FILE_B};
+
 /*---# 系统参数缓存结构 ------------------------------------------------------------*/
-static system_parameter_t 	g_sys_param;  
-pthread_mutex_t 			g_sys_param_lock;//g_sys_param的读写锁
+static system_parameter_t 	g_sys_param;  	//写者的工作副本
+pthread_mutex_t 			g_sys_param_lock;//g_sys_param的写锁（读者使用快照，不需要加锁）
+
+/*读快照：双缓冲 + 引用计数。读者引用当前快照，写者只改写没有读者引用的另一份，改完后切换*/
+static system_parameter_t 	g_sys_snap[2];
+static volatile HLE_S32 	g_sys_snap_cur = 0;
+static volatile HLE_S32 	g_sys_snap_ref[2] = {0, 0};
+
+/*日志状态和提交线程*/
+static struct
+{
+	pthread_mutex_t io_lock;	//日志文件的写锁（提交线程 / sys_param_flush）
+	pthread_cond_t 	cond;		//有新修改 / 退出
+	pthread_t 		tid;
+	HLE_S32 		running;
+	HLE_U32 		dirty;		//有修改还没写入日志的分区（位图，g_sys_param_lock 保护）
+	long long 		first_ms;	//第一次未写入的修改时间
+	long long 		last_ms;	//最后一次修改时间
+	HLE_S32 		active;		//当前追加写入的日志文件下标，-1：还没有有效的日志
+	HLE_U32 		generation;	//当前日志的 generation
+	HLE_U32 		log_size;	//当前日志的有效长度
+	HLE_U32 		version;	//最后一条记录的版本号
+	HLE_S32 		need_compact;//日志尾部有损坏（掉电/写失败），下次提交时整理到另一个文件
+}g_param_log =
+{
+	.active = -1,
+};
+
+
+static long long param_now_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*CRC32（多项式 0xEDB88320），参数记录都很小，逐位计算即可*/
+static HLE_U32 param_crc32(HLE_U32 crc, const void *data, HLE_U32 len)
+{
+	const HLE_U8 *p = (const HLE_U8 *)data;
+	HLE_S32 i;
+
+	crc = ~crc;
+	while(len--)
+	{
+		crc ^= *p++;
+		for(i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+static HLE_U32 param_head_crc(const param_log_head_t *head)
+{
+	param_log_head_t tmp = *head;
+	tmp.crc = 0;
+	return param_crc32(0, &tmp, sizeof(tmp));
+}
+
+static HLE_U32 param_record_crc(const param_record_t *rec, const void *data)
+{
+	param_record_t tmp = *rec;
+	tmp.crc = 0;
+	return param_crc32(param_crc32(0, &tmp, sizeof(tmp)), data, rec->length);
+}
+
+static HLE_S32 param_write_all(int fd, const void *buf, HLE_U32 len)
+{
+	const HLE_U8 *p = (const HLE_U8 *)buf;
+	while(len > 0)
+	{
+		int ret = write(fd, p, len);
+		if(ret <= 0)
+			return -1;
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :把参数分区编码成记录追加到 buf
+*@ Input          :<param>参数
+					<keys>要写的分区（位图）
+					<buf>记录缓存，大小至少 PARAM_KEY_NUM * (sizeof(param_record_t) + sizeof(system_parameter_t))
+*@ Output         :
+*@ Return         :写入 buf 的字节数
+*@ attention      :调用者持有 io_lock（分配版本号）
+*******************************************************************************/
+static HLE_U32 param_encode_records(const system_parameter_t *param, HLE_U32 keys, HLE_U8 *buf)
+{
+	HLE_U32 len = 0;
+	HLE_S32 key;
+
+	for(key = 0; key < PARAM_KEY_NUM; key++)
+	{
+		if(!(keys & (1 << key)) || 0 == g_param_keys[key].size)
+			continue;
+		param_record_t rec;
+		const HLE_U8 *data = (const HLE_U8 *)param + g_param_keys[key].offset;
+		memset(&rec, 0, sizeof(rec));
+		rec.magic = PARAM_REC_MAGIC;
+		rec.key = key;
+		rec.length = g_param_keys[key].size;
+		rec.version = ++g_param_log.version;
+		rec.crc = param_record_crc(&rec, data);
+		memcpy(buf + len, &rec, sizeof(rec));
+		memcpy(buf + len + sizeof(rec), data, rec.length);
+		len += sizeof(rec) + rec.length;
+	}
+	return len;
+}
+
+/*******************************************************************************
+*@ Description    :读取日志文件，把记录依次应用到 param
+*@ Input          :<index>日志文件下标
+*@ Output         :<param>参数（只覆盖日志中有记录的分区）
+					<head>文件头
+					<valid_len>有效数据的长度（遇到损坏的记录停止）
+					<file_len>文件长度
+*@ Return         :文件头有效：0；否则：-1
+*@ attention      :
+*******************************************************************************/
+static HLE_S32 param_log_load(HLE_S32 index, system_parameter_t *param, param_log_head_t *head, HLE_U32 *valid_len, HLE_U32 *file_len)
+{
+	struct stat st;
+	const char *path = g_param_log_files[index];
+
+	if(stat(path, &st) < 0 || st.st_size < (off_t)sizeof(param_log_head_t))
+		return -1;
+
+	HLE_U8 *buf = (HLE_U8 *)malloc(st.st_size);
+	if(NULL == buf)
+	{
+		ERROR_LOG("malloc %ld failed!\n", (long)st.st_size);
+		return -1;
+	}
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+	{
+		free(buf);
+		return -1;
+	}
+	int ret = read(fd, buf, st.st_size);
+	close(fd);
+	if(ret != st.st_size)
+	{
+		ERROR_LOG("read file : %s error!\n", path);
+		free(buf);
+		return -1;
+	}
+
+	memcpy(head, buf, sizeof(param_log_head_t));
+	if(PARAM_LOG_MAGIC != head->magic || param_head_crc(head) != head->crc)
+	{
+		free(buf);
+		return -1;
+	}
+
+	HLE_U32 pos = sizeof(param_log_head_t);
+	while(pos + sizeof(param_record_t) <= (HLE_U32)st.st_size)
+	{
+		param_record_t rec;
+		memcpy(&rec, buf + pos, sizeof(rec));
+		if(PARAM_REC_MAGIC != rec.magic || pos + sizeof(rec) + rec.length > (HLE_U32)st.st_size
+			|| param_record_crc(&rec, buf + pos + sizeof(rec)) != rec.crc)
+			break; //掉电时没写完的记录，之后的数据都不要
+
+		if(rec.key < PARAM_KEY_NUM) //新固件增加的分区，旧固件忽略
+		{
+			HLE_U16 size = g_param_keys[rec.key].size;
+			memcpy((HLE_U8 *)param + g_param_keys[rec.key].offset, buf + pos + sizeof(rec), rec.length < size ? rec.length : size);
+		}
+		if((HLE_S32)(rec.version - g_param_log.version) > 0)
+			g_param_log.version = rec.version;
+		pos += sizeof(rec) + rec.length;
+	}
+
+	*valid_len = pos;
+	*file_len = st.st_size;
+	free(buf);
+	return 0;
+}
+
+/*******************************************************************************
+*@ Description    :整理：把全部参数写入另一个日志文件，成功后切换到该文件
+*@ Input          :<param>参数
+*@ Output         :
+*@ Return         :成功：0；失败：-1（继续使用原来的日志）
+*@ attention      :调用者持有 io_lock。文件头最后写，写到一半掉电时原来的日志仍然有效
+*******************************************************************************/
+static HLE_S32 param_log_compact(const system_parameter_t *param)
+{
+	HLE_S32 index = (0 == g_param_log.active) ? 1 : 0;
+	const char *path = g_param_log_files[index];
+	param_log_head_t head;
+	HLE_U32 len;
+
+	HLE_U8 *buf = (HLE_U8 *)malloc(sizeof(head) + PARAM_KEY_NUM * sizeof(param_record_t) + sizeof(system_parameter_t));
+	if(NULL == buf)
+	{
+		ERROR_LOG("malloc failed!\n");
+		return -1;
+	}
+	memset(&head, 0, sizeof(head));
+	memcpy(buf, &head, sizeof(head)); //先写一个无效的文件头占位
+	len = sizeof(head) + param_encode_records(param, (1 << PARAM_KEY_NUM) - 1, buf + sizeof(head));
+
+	int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if(fd < 0)
+	{
+		ERROR_LOG("create file %s failed!\n", path);
+		free(buf);
+		return -1;
+	}
+	if(param_write_all(fd, buf, len) < 0 || fsync(fd) < 0)
+	{
+		ERROR_LOG("write file : %s failed!\n", path);
+		goto fail;
+	}
+
+	head.magic = PARAM_LOG_MAGIC;
+	head.generation = g_param_log.generation + 1;
+	head.crc = param_head_crc(&head);
+	if(lseek(fd, 0, SEEK_SET) < 0 || param_write_all(fd, &head, sizeof(head)) < 0 || fsync(fd) < 0)
+	{
+		ERROR_LOG("write file : %s head failed!\n", path);
+		goto fail;
+	}
+	close(fd);
+	free(buf);
+
+	g_param_log.active = index;
+	g_param_log.generation = head.generation;
+	g_param_log.log_size = len;
+	g_param_log.need_compact = 0;
+	DEBUG_LOG("param log compact to %s, generation(%u) size(%u)\n", path, head.generation, len);
+	return 0;
+
+fail:
+	close(fd);
+	free(buf);
+	return -1;
+}
+
+/*******************************************************************************
+*@ Description    :把修改过的分区写入日志
+*@ Input          :<param>参数
+					<keys>修改过的分区（位图）
+*@ Output         :
+*@ Return         :成功：0；失败：-1
+*@ attention      :调用者持有 io_lock。日志写满或尾部损坏时改为整理
+*******************************************************************************/
+static HLE_S32 param_log_commit(const system_parameter_t *param, HLE_U32 keys)
+{
+	HLE_U8 buf[PARAM_KEY_NUM * sizeof(param_record_t) + sizeof(system_parameter_t)];
+	HLE_U32 len;
+
+	if(g_param_log.active < 0 || g_param_log.need_compact)
+		return param_log_compact(param);
+
+	len = param_encode_records(param, keys, buf);
+	if(0 == len)
+		return 0;
+	if(g_param_log.log_size + len > PARAM_LOG_MAX_SIZE)
+		return param_log_compact(param);
+
+	const char *path = g_param_log_files[g_param_log.active];
+	int fd = open(path, O_WRONLY|O_APPEND);
+	if(fd < 0)
+	{
+		ERROR_LOG("can't open file: %s\n", path);
+		return param_log_compact(param);
+	}
+	if(param_write_all(fd, buf, len) < 0 || fsync(fd) < 0)
+	{
+		ERROR_LOG("write file : %s failed!\n", path);
+		close(fd);
+		g_param_log.need_compact = 1; //可能写了半条记录，不能再往后追加
+		return param_log_compact(param);
+	}
+	close(fd);
+	g_param_log.log_size += len;
+	return 0;
+}
+
+/*发布读快照，调用者持有 g_sys_param_lock*/
+static void param_publish(void)
+{
+	HLE_S32 next = 1 - __atomic_load_n(&g_sys_snap_cur, __ATOMIC_SEQ_CST);
+
+	while(__sync_add_and_fetch(&g_sys_snap_ref[next], 0) != 0) //还有读者在用上上次的快照（读者只做拷贝，很快会释放）
+		usleep(1000);
+	memcpy(&g_sys_snap[next], &g_sys_param, sizeof(g_sys_param));
+	__atomic_store_n(&g_sys_snap_cur, next, __ATOMIC_SEQ_CST);
+}
+
+/*修改了参数分区：发布快照并通知提交线程，调用者持有 g_sys_param_lock*/
+static void param_mark_dirty(HLE_U32 keys)
+{
+	long long now = param_now_ms();
+
+	param_publish();
+	if(0 == g_param_log.dirty)
+		g_param_log.first_ms = now;
+	g_param_log.last_ms = now;
+	g_param_log.dirty |= keys;
+	pthread_cond_signal(&g_param_log.cond);
+}
+
+/*把未写入的修改写入日志，io_lock 保证日志按修改顺序写入*/
+static HLE_S32 param_flush(void)
+{
+	system_parameter_t param;
+	HLE_U32 keys;
+	HLE_S32 ret;
+
+	pthread_mutex_lock(&g_param_log.io_lock);
+	pthread_mutex_lock(&g_sys_param_lock);
+	keys = g_param_log.dirty;
+	g_param_log.dirty = 0;
+	memcpy(&param, &g_sys_param, sizeof(param));
+	pthread_mutex_unlock(&g_sys_param_lock);
+
+	ret = (0 == keys) ? 0 : param_log_commit(&param, keys);
+	if(ret < 0) //写失败，放回去等下次
+	{
+		pthread_mutex_lock(&g_sys_param_lock);
+		if(0 == g_param_log.dirty)
+			g_param_log.first_ms = param_now_ms();
+		g_param_log.dirty |= keys;
+		pthread_mutex_unlock(&g_sys_param_lock);
+	}
+	pthread_mutex_unlock(&g_param_log.io_lock);
+	return ret;
+}
+
+/*******************************************************************************
+*@ Description    :提交线程：最后一次修改 PARAM_COMMIT_DELAY 后写入，
+					连续修改时最迟 PARAM_COMMIT_MAX 写入一次
+*@ Input          :
+*@ Output         :
+*@ Return         :
+*@ attention      :
+*******************************************************************************/
+static void *param_commit_thread(void *args)
+{
+	pthread_mutex_lock(&g_sys_param_lock);
+	while(g_param_log.running)
+	{
+		if(0 == g_param_log.dirty)
+		{
+			pthread_cond_wait(&g_param_log.cond, &g_sys_param_lock);
+			continue;
+		}
+
+		long long deadline = g_param_log.last_ms + PARAM_COMMIT_DELAY;
+		if(deadline > g_param_log.first_ms + PARAM_COMMIT_MAX)
+			deadline = g_param_log.first_ms + PARAM_COMMIT_MAX;
+		long long now = param_now_ms();
+		if(now < deadline)
+		{
+			struct timespec ts;
+			struct timeval tv;
+			long long wait = deadline - now;
+			gettimeofday(&tv, NULL);
+			ts.tv_sec = tv.tv_sec + wait / 1000;
+			ts.tv_nsec = tv.tv_usec * 1000 + (wait % 1000) * 1000000;
+			if(ts.tv_nsec >= 1000000000)
+			{
+				ts.tv_sec ++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&g_param_log.cond, &g_sys_param_lock, &ts);
+			continue;
+		}
+
+		pthread_mutex_unlock(&g_sys_param_lock);
+		if(param_flush() < 0)
+			sleep(1); //flash 写失败，不要连续重试
+		pthread_mutex_lock(&g_sys_param_lock);
+	}
+	pthread_mutex_unlock(&g_sys_param_lock);
+	return NULL;
+}
+
+/*默认参数*/
+static void param_set_default(system_parameter_t *param)
+{
+	memset(param, 0, sizeof(system_parameter_t));
+
+	/*---#无线（默认）参数部分------------------------------------------------------------*/
+	param->Net_param.current_flag = 0;
+	strncpy(param->Net_param.ssid,"hle666",strlen("hle666")+1);
+	strncpy(param->Net_param.password,"lanhe666",strlen("lanhe666")+1);
+	param->Net_param.mode = AVIOTC_WIFIAPMODE_ADHOC;
+	param->Net_param.enctype = AVIOTC_WIFIAPENC_WPA2_PSK_AES;//默认使用 WPA2_PSK_TKIP 和 WPA2_PSK_AES
+
+	/*---#有线（默认）参数部分------------------------------------------------------------*/
+	strncpy(param->Net_param.ip,"192.168.3.22",strlen("192.168.3.22")+1);
+	strncpy(param->Net_param.mask,"255.255.255.0",strlen("255.255.255.0")+1);
+	strncpy(param->Net_param.gateway,"192.168.3.1",strlen("192.168.3.1")+1);
+	strncpy(param->Net_param.dns_server,"114.114.114.114",strlen("114.114.114.114")+1);
+
+	//param->P2P_param 部分
+	//param->MD_param 部分
+	//param->Acodec_param 部分
+	//param->Vcodec_param 部分
+
+	/*---#LED灯（默认）参数部分------------------------------------------------------------*/
+	param->Light_param.onff = 0;
+	param->Light_param.brightness = 50;
+	param->Light_param.mode = 1;//自动模式
+	param->Light_param.lux = 50;
+	param->Light_param.pir_time = 50;
+	param->Light_param.pir_len = 30;
+	param->Light_param.pir_alarm = 1;
+	param->Light_param.auto_start = 0;
+	param->Light_param.auto_end = 0;
+	param->Light_param.shimmer_start = 0;
+	param->Light_param.shimmer_end = 0;
+	param->Light_param.timing_start = 0;
+	param->Light_param.timing_end = 0;
+}
+
+/*旧格式的参数文件（整个结构体）：读出来后删掉，由调用者整理到日志*/
+static HLE_S32 param_load_legacy(system_parameter_t *param)
+{
+	if(access(SYS_PARAM_FILE,F_OK) != 0)
+		return -1;
+
+	int fd = open(SYS_PARAM_FILE, O_RDONLY);
+	if (fd < 0)
+	{
+		ERROR_LOG("can't open file: %s\n", SYS_PARAM_FILE);
+		return -1;
+	}
+	int ret = read(fd,param,sizeof(system_parameter_t));
+	close(fd);
+	if(ret != sizeof(system_parameter_t))
+	{
+		ERROR_LOG("read file : %s error!\n",SYS_PARAM_FILE);
+		param_set_default(param);
+		return -1;
+	}
+	DEBUG_LOG("migrate %s to parameter log\n", SYS_PARAM_FILE);
+	return 0;
+}
 
 
 /*******************************************************************************
@@ -33,87 +543,109 @@ pthread_mutex_t 			g_sys_param_lock;//g_sys_param的读写锁
 *******************************************************************************/
 int sys_param_init(void)
 {
-	/*---#读取文件数据，初始化参数变量g_sys_param------------------------------------------------------------*/
-
-	int fd = -1;
-	int ret = 0;
+	/*---#读取日志，初始化参数变量g_sys_param------------------------------------------------------------*/
+	param_log_head_t head[2];
+	HLE_U32 valid_len[2] = {0, 0}, file_len[2] = {0, 0};
+	HLE_S32 valid[2];
+	HLE_S32 i, active = -1;
 
 	pthread_mutex_init(&g_sys_param_lock,NULL);
-	
-	if(access(SYS_PARAM_FILE,F_OK) != 0)//文件不存在，生成默认参数文件
-	{
-		fd = open(SYS_PARAM_FILE, O_RDWR|O_CREAT);
-	    if (fd < 0) {
-	        ERROR_LOG("create file %s failed!\n", SYS_PARAM_FILE);
-	        return -1;
-	    }
-
-		/*---#无线（默认）参数部分------------------------------------------------------------*/
-		g_sys_param.Net_param.current_flag = 0;
-		strncpy(g_sys_param.Net_param.ssid,"hle666",strlen("hle666")+1);
-		strncpy(g_sys_param.Net_param.password,"lanhe666",strlen("lanhe666")+1);
-		g_sys_param.Net_param.mode = AVIOTC_WIFIAPMODE_ADHOC;	
-		g_sys_param.Net_param.enctype = AVIOTC_WIFIAPENC_WPA2_PSK_AES;//默认使用 WPA2_PSK_TKIP 和 WPA2_PSK_AES
-
-		/*---#有线（默认）参数部分------------------------------------------------------------*/	
-		strncpy(g_sys_param.Net_param.ip,"192.168.3.22",strlen("192.168.3.22")+1);
-		strncpy(g_sys_param.Net_param.mask,"255.255.255.0",strlen("255.255.255.0")+1);
-		strncpy(g_sys_param.Net_param.gateway,"192.168.3.1",strlen("192.168.3.1")+1);
-		strncpy(g_sys_param.Net_param.dns_server,"114.114.114.114",strlen("114.114.114.114")+1);
-
-		//g_sys_param.P2P_param 部分
-		//g_sys_param.MD_param 部分
-		//g_sys_param.Acodec_param 部分
-		//g_sys_param.Vcodec_param 部分
-		
-		/*---#LED灯（默认）参数部分------------------------------------------------------------*/
-		g_sys_param.Light_param.onff = 0;
-		g_sys_param.Light_param.brightness = 50;
-		g_sys_param.Light_param.mode = 1;//自动模式
-		g_sys_param.Light_param.lux = 50;
-		g_sys_param.Light_param.pir_time = 50;
-		g_sys_param.Light_param.pir_len = 30;
-		g_sys_param.Light_param.pir_alarm = 1;
-		g_sys_param.Light_param.auto_start = 0;
-		g_sys_param.Light_param.auto_end = 0;
-		g_sys_param.Light_param.shimmer_start = 0;
-		g_sys_param.Light_param.shimmer_end = 0;
-		g_sys_param.Light_param.timing_start = 0;
-		g_sys_param.Light_param.timing_end = 0;
-		
-		/*---#将参数写入到配置文件------------------------------------------------------------*/
-		ret = write(fd,&g_sys_param,sizeof(g_sys_param));
-		if(ret <= 0)
-		{
-			ERROR_LOG("write file : %s failed!\n",SYS_PARAM_FILE);
-			close(fd);
-			return -1;
-		}
+	pthread_mutex_init(&g_param_log.io_lock,NULL);
+	pthread_cond_init(&g_param_log.cond,NULL);
 
-		close(fd);
-		return 0;
-		
+	/*两个日志都有效时使用 generation 大的（另一个是整理之前的旧日志）*/
+	for(i = 0; i < 2; i++)
+	{
+		system_parameter_t tmp;
+		valid[i] = (0 == param_log_load(i, &tmp, &head[i], &valid_len[i], &file_len[i]));
+	}
+	if(valid[0] && (!valid[1] || (HLE_S32)(head[0].generation - head[1].generation) > 0))
+		active = 0;
+	else if(valid[1])
+		active = 1;
+
+	param_set_default(&g_sys_param);
+	if(active >= 0)
+	{
+		param_log_load(active, &g_sys_param, &head[active], &valid_len[active], &file_len[active]);
+		g_param_log.active = active;
+		g_param_log.generation = head[active].generation;
+		g_param_log.log_size = valid_len[active];
+		g_param_log.need_compact = (valid_len[active] != file_len[active]); //尾部有没写完的记录
+		if(g_param_log.need_compact)
+			ERROR_LOG("param log %s tail damaged (%u/%u)\n", g_param_log_files[active], valid_len[active], file_len[active]);
 	}
-	else //文件存在,读取文件，初始化参数变量
+	else if(param_load_legacy(&g_sys_param) < 0) //第一次启动（没有日志也没有旧参数文件），使用默认参数
 	{
-		fd = open(SYS_PARAM_FILE, O_RDWR);
-	    if (fd < 0) {
-	        ERROR_LOG("can't open file: %s\n", SYS_PARAM_FILE);
-	        return -1;
-	    }
+		DEBUG_LOG("no parameter file, use default\n");
+	}
 
-		ret = read(fd,&g_sys_param,sizeof(g_sys_param));
-		if(ret != sizeof(g_sys_param))
+	if(active < 0 || g_param_log.need_compact)
+	{
+		if(param_log_compact(&g_sys_param) < 0)
 		{
-			ERROR_LOG("read file : %s error!\n",SYS_PARAM_FILE);
-			close(fd);
+			ERROR_LOG("create parameter log failed!\n");
 			return -1;
 		}
+		if(active < 0)
+			unlink(SYS_PARAM_FILE);
+	}
 
-		close(fd);
-		return 0;
+	memcpy(&g_sys_snap[0], &g_sys_param, sizeof(g_sys_param));
+	memcpy(&g_sys_snap[1], &g_sys_param, sizeof(g_sys_param));
+	__atomic_store_n(&g_sys_snap_cur, 0, __ATOMIC_SEQ_CST);
+
+	g_param_log.running = 1;
+	if(pthread_create(&g_param_log.tid, NULL, param_commit_thread, NULL) != 0)
+	{
+		ERROR_LOG("pthread_create param_commit_thread failed!\n");
+		g_param_log.running = 0;
+		return -1;
+	}
+	return 0;
+
+}
+
+/*******************************************************************************
+*@ Description    :获取参数读快照
+*@ Input          :
+*@ Output         :
+*@ Return         :当前参数的只读快照
+*@ attention      :不加锁；用完必须尽快调用 sys_param_release（持有期间写者会等待）
+*******************************************************************************/
+const system_parameter_t *sys_param_acquire(void)
+{
+	while(1)
+	{
+		HLE_S32 cur = __atomic_load_n(&g_sys_snap_cur, __ATOMIC_SEQ_CST);
+		__sync_add_and_fetch(&g_sys_snap_ref[cur], 1);
+		if(cur == __atomic_load_n(&g_sys_snap_cur, __ATOMIC_SEQ_CST)) //引用之后快照没有被切换，写者不会再改它
+			return &g_sys_snap[cur];
+		__sync_sub_and_fetch(&g_sys_snap_ref[cur], 1);
 	}
-		
+}
+
+/*释放 sys_param_acquire 得到的快照*/
+void sys_param_release(const system_parameter_t *snap)
+{
+	__sync_sub_and_fetch(&g_sys_snap_ref[snap - g_sys_snap], 1);
+}
+
+/*拷贝快照中的一部分*/
+static void param_read(void *out, HLE_U32 offset, HLE_U32 size)
+{
+	const system_parameter_t *snap = sys_param_acquire();
+	memcpy(out, (const HLE_U8 *)snap + offset, size);
+	sys_param_release(snap);
+}
+
+/*修改一个参数分区（只写内存，提交线程合并后写入日志）*/
+static void param_write(HLE_S32 key, const void *in)
+{
+	pthread_mutex_lock(&g_sys_param_lock);
+	memcpy((HLE_U8 *)&g_sys_param + g_param_keys[key].offset, in, g_param_keys[key].size);
+	param_mark_dirty(1 << key);
+	pthread_mutex_unlock(&g_sys_param_lock);
 }
 
 /*******************************************************************************
@@ -129,9 +661,7 @@ int get_sys_param(system_parameter_t* sys_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(sys_param,&g_sys_param,sizeof(g_sys_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(sys_param, 0, sizeof(system_parameter_t));
 	return 0;
 }
 
@@ -140,7 +670,7 @@ int get_sys_param(system_parameter_t* sys_param)
 *@ Input          :
 *@ Output         :
 *@ Return         :成功：0；失败：-1
-*@ attention      :
+*@ attention      :只更新内存，稍后由提交线程写入（需要立即写入时调用 sys_param_flush）
 *******************************************************************************/
 int save_sys_param(system_parameter_t* sys_param)
 {
@@ -150,33 +680,36 @@ int save_sys_param(system_parameter_t* sys_param)
 	}
 
 	pthread_mutex_lock(&g_sys_param_lock);
-	if(sys_param != &g_sys_param)//如果传入的地址已经是&g_sys_param，则不需要再拷贝
+	HLE_U32 keys = 0;
+	HLE_S32 key;
+	for(key = 0; key < PARAM_KEY_NUM; key++) //只有内容变了的分区才写日志
 	{
-		memcpy(&g_sys_param,sys_param,sizeof(g_sys_param));
+		HLE_U8 *dst = (HLE_U8 *)&g_sys_param + g_param_keys[key].offset;
+		const HLE_U8 *src = (const HLE_U8 *)sys_param + g_param_keys[key].offset;
+		if(memcmp(dst, src, g_param_keys[key].size) != 0)
+		{
+			memcpy(dst, src, g_param_keys[key].size);
+			keys |= 1 << key;
+		}
 	}
+	if(keys)
+		param_mark_dirty(keys);
+	pthread_mutex_unlock(&g_sys_param_lock);
 
-	int fd = open(SYS_PARAM_FILE, O_RDWR|O_TRUNC);
-	if (fd < 0) 
-	{
-	      ERROR_LOG("can't open file: %s\n", SYS_PARAM_FILE);
-		  pthread_mutex_unlock(&g_sys_param_lock);
-	      return -1;
-	}
+	return 0;
 
-	int ret = write(fd,&g_sys_param,sizeof(g_sys_param));
-	if(ret <= 0)
-	{
-		ERROR_LOG("write file : %s failed!\n",SYS_PARAM_FILE);
-		pthread_mutex_unlock(&g_sys_param_lock);
-		close(fd);
-		return -1;
-	}
+}
 
-	close(fd);
-	pthread_mutex_unlock(&g_sys_param_lock);
-	
-	return 0;
-	
+/*******************************************************************************
+*@ Description    :把还没写入的参数修改立即写入 flash
+*@ Input          :
+*@ Output         :
+*@ Return         :成功：0；失败：-1
+*@ attention      :重启/升级之前调用
+*******************************************************************************/
+int sys_param_flush(void)
+{
+	return param_flush();
 }
 
 /*******************************************************************************
@@ -192,9 +725,7 @@ int get_Net_param(Net_parameter_t* Net_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(Net_param,&g_sys_param.Net_param,sizeof(Net_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(Net_param, offsetof(system_parameter_t, Net_param), sizeof(Net_parameter_t));
 	return 0;
 }
 
@@ -211,18 +742,9 @@ int save_Net_param(Net_parameter_t* Net_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.Net_param,Net_param,sizeof(Net_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-
+	param_write(PARAM_KEY_NET, Net_param);
 	return 0;
-	
+
 }
 
 
@@ -239,9 +761,7 @@ int get_P2P_param(P2P_parameter_t* P2P_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(P2P_param,&g_sys_param.P2P_param,sizeof(P2P_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(P2P_param, offsetof(system_parameter_t, P2P_param), sizeof(P2P_parameter_t));
 	return 0;
 }
 
@@ -259,18 +779,9 @@ int save_P2P_param(P2P_parameter_t* P2P_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.P2P_param,P2P_param,sizeof(P2P_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-	
+	param_write(PARAM_KEY_P2P, P2P_param);
 	return 0;
-	
+
 }
 
 
@@ -287,9 +798,7 @@ int get_MD_param(MD_parameter_t* MD_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(MD_param,&g_sys_param.MD_param,sizeof(MD_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(MD_param, offsetof(system_parameter_t, MD_param), sizeof(MD_parameter_t));
 	return 0;
 }
 
@@ -306,18 +815,9 @@ int save_MD_param(MD_parameter_t* MD_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.MD_param,MD_param,sizeof(MD_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-
+	param_write(PARAM_KEY_MD, MD_param);
 	return 0;
-	
+
 }
 
 
@@ -334,10 +834,7 @@ int get_Acodec_param(Acodec_parameter_t* Acodec_param)
 	{
 		return -1;
 	}
-	
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(Acodec_param,&g_sys_param.Acodec_param,sizeof(Acodec_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(Acodec_param, offsetof(system_parameter_t, Acodec_param), sizeof(Acodec_parameter_t));
 	return 0;
 }
 
@@ -354,18 +851,9 @@ int save_Acodec_param(Acodec_parameter_t* Acodec_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.Acodec_param,Acodec_param,sizeof(Acodec_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-
+	param_write(PARAM_KEY_ACODEC, Acodec_param);
 	return 0;
-	
+
 }
 
 
@@ -383,17 +871,15 @@ int get_Vcodec_param(Vcodec_parameter_t* Vcodec_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(Vcodec_param,&g_sys_param.Vcodec_param,sizeof(Vcodec_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(Vcodec_param, offsetof(system_parameter_t, Vcodec_param), sizeof(Vcodec_parameter_t));
 	return 0;
 }
 
 /*******************************************************************************
-*@ Description    :
+*@ Description    :保存video编码参数
 *@ Input          :
 *@ Output         :
-*@ Return         :
+*@ Return         :成功：0；失败：-1
 *@ attention      :
 *******************************************************************************/
 int save_Vcodec_param(Vcodec_parameter_t* Vcodec_param)
@@ -402,18 +888,9 @@ int save_Vcodec_param(Vcodec_parameter_t* Vcodec_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.Vcodec_param,Vcodec_param,sizeof(Vcodec_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-
+	param_write(PARAM_KEY_VCODEC, Vcodec_param);
 	return 0;
-	
+
 }
 
 
@@ -430,11 +907,9 @@ int get_Light_param(Light_parameter_t* Light_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(Light_param,&g_sys_param.Light_param,sizeof(Light_param));
-	pthread_mutex_unlock(&g_sys_param_lock);
+	param_read(Light_param, offsetof(system_parameter_t, Light_param), sizeof(Light_parameter_t));
 	return 0;
-	
+
 }
 
 /*******************************************************************************
@@ -450,31 +925,27 @@ int save_Light_param(Light_parameter_t* Light_param)
 	{
 		return -1;
 	}
-	pthread_mutex_lock(&g_sys_param_lock);
-	memcpy(&g_sys_param.Light_param,Light_param,sizeof(Light_param));
-	if(save_sys_param(&g_sys_param) < 0)
-	{
-		ERROR_LOG("save_sys_param failed!\n");
-		pthread_mutex_unlock(&g_sys_param_lock);
-		return -1;
-	}
-	pthread_mutex_unlock(&g_sys_param_lock);
-
+	param_write(PARAM_KEY_LIGHT, Light_param);
 	return 0;
-	
+
 }
 
 
 
 int sys_param_exit(void)
 {
+	//停止提交线程，把还没写入的修改写入日志
+	pthread_mutex_lock(&g_sys_param_lock);
+	HLE_S32 running = g_param_log.running;
+	g_param_log.running = 0;
+	pthread_cond_signal(&g_param_log.cond);
+	pthread_mutex_unlock(&g_sys_param_lock);
+	if(running)
+		pthread_join(g_param_log.tid, NULL);
 
-	//参数有更新时都立即写入到文件，退出操作不需要做什么。
+	HLE_S32 ret = param_flush();
+	pthread_cond_destroy(&g_param_log.cond);
+	pthread_mutex_destroy(&g_param_log.io_lock);
 	pthread_mutex_destroy(&g_sys_param_lock);
+	return ret;
 }
-
- 
-
-
-
-
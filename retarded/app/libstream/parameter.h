@@ -1,9 +1,13 @@
 /***************************************************************************
-* @file:parameter.h 
-* @author:   
+* @file:parameter.h
+* @author:
 * @date:  7,9,2019
-* @brief:  
+* @brief:
 * @attention:参数文件保存+提取+解析相关函数
+			1.参数按分区（网络/P2P/MD/音频/视频/LED灯）保存成带版本号和 CRC 的记录，追加写入日志文件，
+			  日志写满时整理到另一个日志文件（A/B 交替，文件头最后写），掉电只会丢失没写完的那条记录。
+			2.save_xxx 只修改内存，提交线程合并一段时间内的修改后一次写入；需要立即写入时调用 sys_param_flush。
+			3.get_xxx 从读快照拷贝，不加锁。
 ***************************************************************************/
 
 #ifndef _PARAMETER_H
@@ -12,8 +16,31 @@
 #include "media_server_signal_def.h"
 
 
+int sys_param_init(void);
+int sys_param_exit(void);
+int sys_param_flush(void);
+
+/*读快照：不加锁，用完尽快 release*/
+const system_parameter_t *sys_param_acquire(void);
+void sys_param_release(const system_parameter_t *snap);
+
+int get_sys_param(system_parameter_t* sys_param);
+int save_sys_param(system_parameter_t* sys_param);
+int get_Net_param(Net_parameter_t* Net_param);
+int save_Net_param(Net_parameter_t* Net_param);
+int get_P2P_param(P2P_parameter_t* P2P_param);
+int save_P2P_param(P2P_parameter_t* P2P_param);
+int get_MD_param(MD_parameter_t* MD_param);
+int save_MD_param(MD_parameter_t* MD_param);
+int get_Acodec_param(Acodec_parameter_t* Acodec_param);
+int save_Acodec_param(Acodec_parameter_t* Acodec_param);
+int get_Vcodec_param(Vcodec_parameter_t* Vcodec_param);
+int save_Vcodec_param(Vcodec_parameter_t* Vcodec_param);
+int get_Light_param(Light_parameter_t* Light_param);
+int save_Light_param(Light_parameter_t* Light_param);
 
 
 #endif
 
 
+
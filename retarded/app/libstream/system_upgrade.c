@@ -6,9 +6,18 @@
 * @brief:  系统升级部分函数
 * @attention: 如若该部分分区有修改，则uboot也需要做同步的修改，主要涉及文件：
 				u-boot-2010.06/common/cmd_hle_double_system_bootm.c
+			  升级流程：接收升级包头 -> 校验签名/版本 -> 标记升级分区损坏 -> 边接收边按扇区擦写回读
+			  -> 镜像 SHA256 与升级包头一致后才把升级分区标记为正常（uboot 从版本高的正常分区启动）
 ***************************************************************************/
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+#include <openssl/rsa.h>
+#include <openssl/pem.h>
+#include <openssl/objects.h>
 #include "spinor.h"
 #include "typeport.h"
 #include "system_upgrade.h"
@@ -58,6 +67,19 @@ typedef struct _config_info_t
 	 hle_image_info_t	 image_info[2]; //两个分区镜像的描述信息 
 }config_info_t;
 
+//config 分区中 config_info_t 之后的版本记录（uboot 不使用），用于拒绝版本回退
+#define 	UPGRADE_RECORD_OFFSET	0x1000
+typedef struct _upgrade_record_t
+{
+	 int				 magic_flag;	 //HLE_MAGIC，没有记录时两个版本都按 0 处理
+	 unsigned int		 fw_version[2];	 //两个分区镜像的固件版本号（升级包头中的 fw_version）
+}upgrade_record_t;
+
+#define 	UPGRADE_SECTOR_SIZE		0x10000		//flash 擦除扇区大小（64K），也是一次写入的大小
+#define 	UPGRADE_BUF_NUM			3			//扇区缓存数：接收侧填一个，flash 线程写一个，多一个吸收网络抖动
+#define 	UPGRADE_ERASE_AHEAD		2			//flash 线程等待数据时最多提前擦除的扇区数
+#define 	UPGRADE_READ_CHUNK		4096		//回读校验的分块大小
+
 
 	
 void printf_config_info(config_info_t* info)
@@ -146,99 +168,538 @@ int selet_upgrade_region(unsigned long* addr,int* region)
 }
 
 
+/*---# 流式升级 ------------------------------------------------------------*/
+
+struct _upgrade_ctx_t
+{
+	upgrade_status_e	status;				//第一个错误，出错后不再接收数据
+	upgrade_manifest_t	manifest;			//升级包头
+	unsigned int		received;			//已经收到的字节数（含升级包头）
+	int					region;				//升级分区（0/1），-1：还没有收完升级包头
+	unsigned long		region_addr;
+	upgrade_record_t	record;				//config 分区中的版本记录
+
+	HLE_U8				*buf[UPGRADE_BUF_NUM];	//扇区缓存，按扇区序号轮流使用
+	unsigned int		len[UPGRADE_BUF_NUM];	//缓存中的数据长度
+	unsigned int		fill;				//接收侧正在填的扇区已有的字节数
+	unsigned int		sector_num;			//镜像占用的扇区数
+
+	/*以下由 lock 保护（flash 线程和接收侧共用）*/
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	unsigned int		submitted;			//已经交给 flash 线程的扇区数
+	unsigned int		done;				//已经写完并回读校验的扇区数
+	int					finishing;			//数据已经全部提交
+	int					aborting;			//放弃升级
+	upgrade_status_e	flash_status;		//flash 线程的错误
+
+	/*以下只有 flash 线程使用*/
+	pthread_t			tid;
+	unsigned int		erased;				//已经擦除的扇区数
+	SHA256_CTX			sha;				//回读数据的 SHA256
+	HLE_U8				rbuf[UPGRADE_READ_CHUNK];
+};
+
+static int g_upgrade_running = 0;
+static pthread_mutex_t g_upgrade_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifndef UPGRADE_PUBKEY_PEM
+/*升级包签名公钥（开发密钥），正式发布时编译参数中定义 UPGRADE_PUBKEY_PEM 替换为发布签名密钥的公钥*/
+#define UPGRADE_PUBKEY_PEM \
+	"-----BEGIN PUBLIC KEY-----\n" \
+	"MIIBIjANBgkqhkiG9w0BAQEFAAOCAQ8AMIIBCgKCAQEA3BY3ggLE9+P3oEjC/V1W\n" \
+	"DOXQf8Nwxx3YKuQ6YDGLF4wj2Z/t0jLaxC7Tt3N/QL8L45xAcdU8IHUPeMRNos1w\n" \
+	"IkMiJB16K0V9mLftlHjGxqE7UYAqEJhhiW7pb50w/pIlImmFm4iyZvzpN5reAMWO\n" \
+	"ShrkpgwSLNSjKfQ25aiW/qy6zj6VFO6AnOypUOjooAhqGs0e58t8BsCGL5jtYlsl\n" \
+	"b3UK3/qPEugcWzFHjcBA4Y1Neu+pKngRumcVHdEffoFJrEzmyALEzLbo6eYehW0i\n" \
+	"xLrlE6y2/PYjVEjS5d3s5xc9yWGVkc+XmyaOGnKKo95+VSfcx+StO0UI7Ekj7WH5\n" \
+	"OwIDAQAB\n" \
+	"-----END PUBLIC KEY-----\n"
+#endif
+static const char *g_upgrade_pubkey = UPGRADE_PUBKEY_PEM;
+
+
 /*******************************************************************************
-*@ Description    :升级业务，写分区部分（双系统）
-*@ Input          :<buf> 升级文件的buf位置
-					<buf_lem>升级文件的buf大小（注意不能超过 IMAGE0/1 分区大小）
+*@ Description    :重写 config 分区（启动分区描述 + 版本记录）
+*@ Input          :<info>启动分区描述
+					<record>版本记录
+*@ Output         :
+*@ Return         :成功：0；失败：-1
+*@ attention      :config 分区只有一个扇区，擦除到写完之间掉电 uboot 会使用默认配置
+*******************************************************************************/
+static int config_region_write(config_info_t *info, upgrade_record_t *record)
+{
+	if(hispinor_erase((unsigned long)CONFIG_REGION_START,(unsigned long)CONFIG_REGION_SIZE) != 0)
+	{
+		ERROR_LOG("hispinor_erase CONFIG failed!\n");
+		return -1;
+	}
+	if(hispinor_write(info,CONFIG_REGION_START,sizeof(config_info_t)) != 0 ||
+	   hispinor_write(record,CONFIG_REGION_START + UPGRADE_RECORD_OFFSET,sizeof(upgrade_record_t)) != 0)
+	{
+		ERROR_LOG("hispinor_write CONFIG failed!\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*读取 config 分区中的版本记录，没有记录（旧固件升级上来）时两个版本都为 0*/
+static void upgrade_record_read(upgrade_record_t *record)
+{
+	hispinor_read(record, CONFIG_REGION_START + UPGRADE_RECORD_OFFSET, sizeof(upgrade_record_t));
+	if(record->magic_flag != HLE_MAGIC)
+	{
+		memset(record, 0, sizeof(upgrade_record_t));
+		record->magic_flag = HLE_MAGIC;
+	}
+}
+
+/*校验升级包头的格式和签名*/
+static upgrade_status_e upgrade_verify_manifest(const upgrade_manifest_t *manifest)
+{
+	HLE_U8 md[SHA256_DIGEST_LENGTH];
+	upgrade_status_e ret = UP_SIGNATURE_FAILED;
+
+	if(manifest->magic != UPGRADE_MANIFEST_MAGIC || 0 == manifest->image_size ||
+	   0 == manifest->sig_len || manifest->sig_len > UPGRADE_SIGNATURE_MAX)
+	{
+		ERROR_LOG("bad upgrade manifest magic(%#x) image_size(%u) sig_len(%u)\n",
+				  manifest->magic, manifest->image_size, manifest->sig_len);
+		return UP_BAD_MANIFEST;
+	}
+
+	SHA256((const HLE_U8 *)manifest, offsetof(upgrade_manifest_t, sig_len), md);
+
+	BIO *bio = BIO_new_mem_buf((void *)g_upgrade_pubkey, -1);
+	RSA *rsa = bio ? PEM_read_bio_RSA_PUBKEY(bio, NULL, NULL, NULL) : NULL;
+	if(NULL == rsa)
+	{
+		ERROR_LOG("load upgrade public key failed!\n");
+	}
+	else if(1 == RSA_verify(NID_sha256, md, sizeof(md), manifest->signature, manifest->sig_len, rsa))
+	{
+		ret = UP_OK;
+	}
+	else
+	{
+		ERROR_LOG("upgrade manifest signature verify failed!\n");
+	}
+
+	if(rsa)
+		RSA_free(rsa);
+	if(bio)
+		BIO_free(bio);
+	return ret;
+}
+
+/*******************************************************************************
+*@ Description    :flash 线程：按扇区顺序 擦除 -> 写 -> 回读（回读数据计算 SHA256），
+					等待数据时提前擦除后面的扇区
+*@ Input          :<args>升级上下文
 *@ Output         :
 *@ Return         :
 *@ attention      :
 *******************************************************************************/
-upgrade_status_e upgrade_write_norflash(void *buf,unsigned int buf_len)
+static void *upgrade_flash_thread(void *args)
 {
-	if(NULL == buf || buf_len <= 0)
+	upgrade_ctx_t *ctx = (upgrade_ctx_t *)args;
+	upgrade_status_e status = UP_OK;
+
+	pthread_mutex_lock(&ctx->lock);
+	while(!ctx->aborting)
 	{
-		return  UP_ILLEGAL_PARAMETER;
-	}
-	
-	int ret = 0;
+		if(ctx->done == ctx->submitted)
+		{
+			if(ctx->finishing)
+				break;
+			/*没有数据可写：提前擦除后面的扇区（擦除比写慢得多，和网络接收重叠）*/
+			if(ctx->erased < ctx->sector_num && ctx->erased < ctx->done + 1 + UPGRADE_ERASE_AHEAD)
+			{
+				unsigned long addr = ctx->region_addr + (unsigned long)ctx->erased * UPGRADE_SECTOR_SIZE;
+				pthread_mutex_unlock(&ctx->lock);
+				if(hispinor_erase(addr, UPGRADE_SECTOR_SIZE) != 0)
+				{
+					ERROR_LOG("hispinor_erase addr(%#lx) failed!\n", addr);
+					status = UP_ERASE_FAILED;
+					pthread_mutex_lock(&ctx->lock);
+					break;
+				}
+				ctx->erased ++;
+				pthread_mutex_lock(&ctx->lock);
+				continue;
+			}
+			pthread_cond_wait(&ctx->cond, &ctx->lock);
+			continue;
+		}
 
+		unsigned int sector = ctx->done;
+		HLE_U8 *buf = ctx->buf[sector % UPGRADE_BUF_NUM];
+		unsigned int len = ctx->len[sector % UPGRADE_BUF_NUM];
+		unsigned long addr = ctx->region_addr + (unsigned long)sector * UPGRADE_SECTOR_SIZE;
+		unsigned int off;
+		pthread_mutex_unlock(&ctx->lock);
 
-	//CRC校验
+		if(sector >= ctx->erased)
+		{
+			if(hispinor_erase(addr, UPGRADE_SECTOR_SIZE) != 0)
+			{
+				ERROR_LOG("hispinor_erase addr(%#lx) failed!\n", addr);
+				status = UP_ERASE_FAILED;
+				pthread_mutex_lock(&ctx->lock);
+				break;
+			}
+			ctx->erased = sector + 1;
+		}
+		if(hispinor_write(buf, addr, len) != 0)
+		{
+			ERROR_LOG("hispinor_write addr(%#lx) failed!\n", addr);
+			status = UP_WRITE_FAILED;
+			pthread_mutex_lock(&ctx->lock);
+			break;
+		}
+		/*回读：确认 flash 中的数据和收到的一致，SHA256 也按 flash 中的数据计算*/
+		for(off = 0; off < len; off += UPGRADE_READ_CHUNK)
+		{
+			unsigned int n = (len - off < UPGRADE_READ_CHUNK) ? len - off : UPGRADE_READ_CHUNK;
+			hispinor_read(ctx->rbuf, addr + off, n);
+			if(memcmp(ctx->rbuf, buf + off, n) != 0)
+			{
+				ERROR_LOG("flash verify addr(%#lx) failed!\n", addr + off);
+				status = UP_WRITE_FAILED;
+				break;
+			}
+			SHA256_Update(&ctx->sha, ctx->rbuf, n);
+		}
 
-	//版本校验
+		pthread_mutex_lock(&ctx->lock);
+		if(status != UP_OK)
+			break;
+		ctx->done ++;
+		pthread_cond_broadcast(&ctx->cond);
+	}
+	ctx->flash_status = status;
+	pthread_cond_broadcast(&ctx->cond);
+	pthread_mutex_unlock(&ctx->lock);
+	return NULL;
+}
 
+/*******************************************************************************
+*@ Description    :升级包头收齐之后：校验签名，选择分区，校验大小和版本，
+					把升级分区标记为损坏，启动 flash 线程
+*@ Input          :<ctx>升级上下文
+*@ Output         :
+*@ Return         :UP_OK 或错误码
+*@ attention      :签名校验通过之前不会擦写 flash
+*******************************************************************************/
+static upgrade_status_e upgrade_start(upgrade_ctx_t *ctx)
+{
+	upgrade_manifest_t *manifest = &ctx->manifest;
+	upgrade_status_e ret = upgrade_verify_manifest(manifest);
+	if(ret != UP_OK)
+		return ret;
 
-	//选择 IMAGE 分区
 	unsigned long upgrade_addr = 0;
 	int region = 0; //IMAGE 分区序号
-	ret = selet_upgrade_region(&upgrade_addr,&region);
-	if(ret < 0)
+	if(selet_upgrade_region(&upgrade_addr,&region) < 0)
 	{
 		ERROR_LOG("selet_upgrade_region failed !\n");
 		return UP_SELECT_REGION_FAILED;
 	}
-	
-	DEBUG_LOG("erase region is : %d  addr:%#x\n",region,upgrade_addr);
-	
-	unsigned long region_size = 0;
-	if(0 == region)
-		region_size = IMAGE0_REGION_SIZE;
-	else
-		region_size = IMAGE1_REGION_SIZE;
-
-	if(buf_len > region_size)
+	unsigned long region_size = (0 == region) ? IMAGE0_REGION_SIZE : IMAGE1_REGION_SIZE;
+	if(manifest->image_size > region_size)
 	{
-		ERROR_LOG("upgrade buf is too long , upgrade region overflow!!\n");
+		ERROR_LOG("upgrade image(%u) is too long , upgrade region overflow!!\n", manifest->image_size);
 		return UP_REGION_OVERFLOW;
 	}
 
-	//1.擦除   CONFIG 分区
-	//DEBUG_LOG("hispinor_erase CONFIG...\n");
-	hispinor_erase((unsigned long)CONFIG_REGION_START,(unsigned long)CONFIG_REGION_SIZE);
-	
-	//2.写 CONFIG 分区（非升级分区的参数）
-	if(0 == region)
+	upgrade_record_read(&ctx->record);
+	if(manifest->fw_version <= ctx->record.fw_version[1 - region])
 	{
-		hispinor_write(&config_info.magic_flag,CONFIG_REGION_START,sizeof(config_info.magic_flag));
-		//空出中间 IMAGE0 的部分
-		unsigned long start = CONFIG_REGION_START + sizeof(config_info.magic_flag) + sizeof(hle_image_info_t);
-		hispinor_write(&config_info.image_info[1],start,sizeof(hle_image_info_t));
+		ERROR_LOG("upgrade fw_version(%u) not newer than running(%u)\n",
+				  manifest->fw_version, ctx->record.fw_version[1 - region]);
+		return UP_VERSION_FAILED;
 	}
-	else
+
+	DEBUG_LOG("upgrade \"%.64s\" fw_version(%u) size(%u) to region(%d) addr(%#lx)\n",
+			  manifest->fw_name, manifest->fw_version, manifest->image_size, region, upgrade_addr);
+
+	/*先把升级分区标记为损坏再擦写，中途掉电 uboot 也不会从这个分区启动*/
+	config_info.image_info[region].damage_flag = FLAG_BAD;
+	ctx->record.fw_version[region] = 0;
+	if(config_region_write(&config_info, &ctx->record) < 0)
+		return UP_WRITE_FAILED;
+
+	ctx->region = region;
+	ctx->region_addr = (0 == region) ? IMAGE0_REGION_START : IMAGE1_REGION_START;
+	ctx->sector_num = (manifest->image_size + UPGRADE_SECTOR_SIZE - 1) / UPGRADE_SECTOR_SIZE;
+	SHA256_Init(&ctx->sha);
+	if(pthread_create(&ctx->tid, NULL, upgrade_flash_thread, ctx) != 0)
 	{
-		hispinor_write(&config_info,CONFIG_REGION_START,sizeof(config_info)-sizeof(hle_image_info_t));
-		//空出后部分 IMAGE1 的部分
+		ERROR_LOG("pthread_create upgrade_flash_thread failed!\n");
+		ctx->region = -1;
+		return UP_NO_MEMORY;
 	}
+	return UP_OK;
+}
 
-	//3.擦除 IMAGE 分区（升级文件）
-	DEBUG_LOG("hispinor_erase IMAGE ... erase size(%#x)\n",region_size);
-	hispinor_erase(upgrade_addr,region_size);
-	
-	//4.写 IMAGE 分区 （升级文件）
-	DEBUG_LOG("hispinor_write IMAGE ... write size(%d)\n",buf_len);
-	hispinor_write(buf,upgrade_addr, buf_len);
-
-	//5.写 CONFIG 分区（升级分区的参数）
-	config_info.image_info[region].image_version = config_info.image_info[1 - region].image_version + 1;
-	config_info.image_info[region].damage_flag = FLAG_OK;
-	if(0 == region)
+/*把接收侧填好的扇区交给 flash 线程*/
+static void upgrade_submit(upgrade_ctx_t *ctx)
+{
+	pthread_mutex_lock(&ctx->lock);
+	ctx->len[ctx->submitted % UPGRADE_BUF_NUM] = ctx->fill;
+	ctx->submitted ++;
+	pthread_cond_broadcast(&ctx->cond);
+	pthread_mutex_unlock(&ctx->lock);
+	ctx->fill = 0;
+}
+
+upgrade_ctx_t *upgrade_begin(upgrade_status_e *status)
+{
+	upgrade_status_e ret = UP_OK;
+	int i;
+
+	pthread_mutex_lock(&g_upgrade_lock);
+	if(g_upgrade_running)
 	{
-		config_info.image_info[region].start_address = IMAGE0_REGION_START;
-		//写中间 IMAGE0 的部分
-		unsigned long start = CONFIG_REGION_START + sizeof(config_info.magic_flag);
-		hispinor_write(&config_info.image_info[0],start,sizeof(hle_image_info_t));
+		pthread_mutex_unlock(&g_upgrade_lock);
+		ERROR_LOG("upgrade is running!\n");
+		if(status)
+			*status = UP_BUSY;
+		return NULL;
 	}
-	else
+	g_upgrade_running = 1;
+	pthread_mutex_unlock(&g_upgrade_lock);
+
+	upgrade_ctx_t *ctx = (upgrade_ctx_t *)calloc(1, sizeof(upgrade_ctx_t));
+	if(NULL == ctx)
 	{
-		config_info.image_info[region].start_address = IMAGE1_REGION_START;
-		//写后部分 IMAGE1 的部分
-		unsigned long start = CONFIG_REGION_START + sizeof(config_info.magic_flag) + sizeof(hle_image_info_t);
-		hispinor_write(&config_info.image_info[1],start,sizeof(hle_image_info_t));
+		ret = UP_NO_MEMORY;
+		goto fail;
 	}
-	
-	
-	return 0;
+	for(i = 0; i < UPGRADE_BUF_NUM; i++)
+	{
+		ctx->buf[i] = (HLE_U8 *)malloc(UPGRADE_SECTOR_SIZE);
+		if(NULL == ctx->buf[i])
+		{
+			ret = UP_NO_MEMORY;
+			goto fail;
+		}
+	}
+	ctx->region = -1;
+	pthread_mutex_init(&ctx->lock, NULL);
+	pthread_cond_init(&ctx->cond, NULL);
+	if(status)
+		*status = UP_OK;
+	return ctx;
+
+fail:
+	ERROR_LOG("upgrade_begin malloc failed!\n");
+	if(ctx)
+	{
+		for(i = 0; i < UPGRADE_BUF_NUM; i++)
+			free(ctx->buf[i]);
+		free(ctx);
+	}
+	pthread_mutex_lock(&g_upgrade_lock);
+	g_upgrade_running = 0;
+	pthread_mutex_unlock(&g_upgrade_lock);
+	if(status)
+		*status = ret;
+	return NULL;
+}
+
+upgrade_status_e upgrade_feed(upgrade_ctx_t *ctx, const void *data, unsigned int len)
+{
+	const HLE_U8 *p = (const HLE_U8 *)data;
+
+	if(NULL == ctx || (NULL == data && len > 0))
+		return UP_ILLEGAL_PARAMETER;
+
+	while(len > 0 && UP_OK == ctx->status)
+	{
+		/*1.升级包头*/
+		if(ctx->received < UPGRADE_MANIFEST_SIZE)
+		{
+			unsigned int n = UPGRADE_MANIFEST_SIZE - ctx->received;
+			if(n > len)
+				n = len;
+			memcpy((HLE_U8 *)&ctx->manifest + ctx->received, p, n);
+			ctx->received += n;
+			p += n;
+			len -= n;
+			if(UPGRADE_MANIFEST_SIZE == ctx->received)
+				ctx->status = upgrade_start(ctx);
+			continue;
+		}
+
+		/*2.镜像：按扇区填缓存*/
+		if(ctx->received - UPGRADE_MANIFEST_SIZE + len > ctx->manifest.image_size)
+		{
+			ERROR_LOG("upgrade data longer than image_size(%u)\n", ctx->manifest.image_size);
+			ctx->status = UP_CHECKSUM_FAILED;
+			break;
+		}
+		if(0 == ctx->fill) //开始填新的扇区，等 flash 线程空出缓存
+		{
+			pthread_mutex_lock(&ctx->lock);
+			while(ctx->submitted - ctx->done >= UPGRADE_BUF_NUM && UP_OK == ctx->flash_status)
+				pthread_cond_wait(&ctx->cond, &ctx->lock);
+			if(ctx->flash_status != UP_OK)
+				ctx->status = ctx->flash_status;
+			pthread_mutex_unlock(&ctx->lock);
+			if(ctx->status != UP_OK)
+				break;
+		}
+		unsigned int n = UPGRADE_SECTOR_SIZE - ctx->fill;
+		if(n > len)
+			n = len;
+		memcpy(ctx->buf[ctx->submitted % UPGRADE_BUF_NUM] + ctx->fill, p, n);
+		ctx->fill += n;
+		ctx->received += n;
+		p += n;
+		len -= n;
+		if(UPGRADE_SECTOR_SIZE == ctx->fill)
+			upgrade_submit(ctx);
+	}
+	return ctx->status;
+}
+
+upgrade_status_e upgrade_end(upgrade_ctx_t *ctx, int commit)
+{
+	HLE_U8 md[SHA256_DIGEST_LENGTH];
+	int i;
+
+	if(NULL == ctx)
+		return UP_ILLEGAL_PARAMETER;
+
+	if(commit && UP_OK == ctx->status && ctx->received != UPGRADE_MANIFEST_SIZE + ctx->manifest.image_size)
+	{
+		ERROR_LOG("upgrade data incomplete, received(%u) image_size(%u)\n", ctx->received, ctx->manifest.image_size);
+		ctx->status = (ctx->received < UPGRADE_MANIFEST_SIZE) ? UP_BAD_MANIFEST : UP_CHECKSUM_FAILED;
+	}
+
+	if(ctx->region >= 0) //flash 线程已经启动
+	{
+		if(UP_OK == ctx->status && ctx->fill > 0)
+			upgrade_submit(ctx);
+		pthread_mutex_lock(&ctx->lock);
+		if(commit && UP_OK == ctx->status)
+			ctx->finishing = 1;
+		else
+			ctx->aborting = 1;
+		pthread_cond_broadcast(&ctx->cond);
+		pthread_mutex_unlock(&ctx->lock);
+		pthread_join(ctx->tid, NULL);
+
+		if(UP_OK == ctx->status)
+			ctx->status = ctx->flash_status;
+		if(UP_OK == ctx->status)
+		{
+			SHA256_Final(md, &ctx->sha);
+			if(memcmp(md, ctx->manifest.image_sha256, sizeof(md)) != 0)
+			{
+				ERROR_LOG("upgrade image sha256 mismatch!\n");
+				ctx->status = UP_CHECKSUM_FAILED;
+			}
+		}
+		/*镜像已经写入并校验通过，切换启动分区*/
+		if(commit && UP_OK == ctx->status)
+		{
+			int region = ctx->region;
+			config_info.image_info[region].image_version = config_info.image_info[1 - region].image_version + 1;
+			config_info.image_info[region].damage_flag = FLAG_OK;
+			config_info.image_info[region].start_address = ctx->region_addr;
+			ctx->record.fw_version[region] = ctx->manifest.fw_version;
+			if(config_region_write(&config_info, &ctx->record) < 0)
+				ctx->status = UP_WRITE_FAILED;
+			else
+				printf_config_info(&config_info);
+		}
+	}
+	else if(UP_OK == ctx->status && !commit)
+	{
+		ctx->status = UP_ILLEGAL_PARAMETER;
+	}
+
+	upgrade_status_e ret = ctx->status;
+	DEBUG_LOG("upgrade end, commit(%d) ret(%d)\n", commit, ret);
+	pthread_mutex_destroy(&ctx->lock);
+	pthread_cond_destroy(&ctx->cond);
+	for(i = 0; i < UPGRADE_BUF_NUM; i++)
+		free(ctx->buf[i]);
+	free(ctx);
+
+	pthread_mutex_lock(&g_upgrade_lock);
+	g_upgrade_running = 0;
+	pthread_mutex_unlock(&g_upgrade_lock);
+	return ret;
+}
+
+int upgrade_progress(const upgrade_ctx_t *ctx)
+{
+	if(NULL == ctx || ctx->received < UPGRADE_MANIFEST_SIZE || 0 == ctx->sector_num)
+		return 0;
+	return ctx->done * 100 / ctx->sector_num;
+}
+
+int upgrade_is_running(void)
+{
+	pthread_mutex_lock(&g_upgrade_lock);
+	int running = g_upgrade_running;
+	pthread_mutex_unlock(&g_upgrade_lock);
+	return running;
+}
+
+extern int http_get_stream(const char *url, int (*on_data)(void *arg, const void *data, int len), void *arg);
+
+static int upgrade_http_data(void *arg, const void *data, int len)
+{
+	return (UP_OK == upgrade_feed((upgrade_ctx_t *)arg, data, len)) ? 0 : -1;
+}
+
+upgrade_status_e upgrade_from_url(const char *url)
+{
+	upgrade_status_e ret;
+
+	if(NULL == url || 0 == url[0])
+		return UP_ILLEGAL_PARAMETER;
+
+	upgrade_ctx_t *ctx = upgrade_begin(&ret);
+	if(NULL == ctx)
+		return ret;
+
+	DEBUG_LOG("upgrade from url: %s\n", url);
+	if(http_get_stream(url, upgrade_http_data, ctx) < 0)
+	{
+		ret = ctx->status; //写 flash 出错中断下载时返回该错误
+		upgrade_end(ctx, 0);
+		return (UP_OK == ret) ? UP_DOWNLOAD_FAILED : ret;
+	}
+	return upgrade_end(ctx, 1);
+}
+
+/*******************************************************************************
+*@ Description    :升级业务，写分区部分（双系统）
+*@ Input          :<buf> 升级包（升级包头 + 镜像）
+					<buf_lem>升级包大小
+*@ Output         :
+*@ Return         :
+*@ attention      :整个升级包已经在内存中时使用，流程同 upgrade_begin/upgrade_feed/upgrade_end
+*******************************************************************************/
+upgrade_status_e upgrade_write_norflash(void *buf,unsigned int buf_len)
+{
+	upgrade_status_e ret;
+
+	if(NULL == buf || buf_len <= 0)
+	{
+		return  UP_ILLEGAL_PARAMETER;
+	}
+
+	upgrade_ctx_t *ctx = upgrade_begin(&ret);
+	if(NULL == ctx)
+		return ret;
+	upgrade_feed(ctx, buf, buf_len);
+	return upgrade_end(ctx, 1);
 
 }
 
@@ -269,20 +730,8 @@ int set_boot_region_bad(void)
 	int curr_boot_region = 1 - region;
 
 	info.image_info[curr_boot_region].damage_flag = FLAG_BAD;
-	hispinor_erase((unsigned long)CONFIG_REGION_START,(unsigned long)CONFIG_REGION_SIZE);
-	hispinor_write(&info,CONFIG_REGION_START,sizeof(config_info_t));
-
-	return 0;
+	upgrade_record_t record;
+	upgrade_record_read(&record);
+	return config_region_write(&info, &record);
 	
 }
-
-
-
-
-
-
-
-
-
-
-
@@ -86,7 +86,8 @@ int  write_file_to_nor_flash(int argc,char**argv)
 	2.虚拟机（linux主机）下运行客户端程序 send_and_write_file_to_norflash
 		格式：send_and_write_file_to_norflash [file name] [deviceIP]
 		eg： ./send_and_write_file_to_norflash ipc18.bin 192.168.3.82
-注意：目前没有加入文件校验机制
+注意：发送的文件必须是签名的升级包（升级包头 + 镜像，见 system_upgrade.h），
+	边接收边写 flash（upgrade_feed），不需要把整个文件缓存到内存
 *******************************************************************/
 #define portnum  5555  //端口有可能端口被占用，可以改端口才能通
 int  receive_and_write_file_to_nor_flash(int argc,char**argv)
@@ -108,14 +109,7 @@ int  receive_and_write_file_to_nor_flash(int argc,char**argv)
 	int new_fd;//建立连接后会返回一个新的fd
 	struct sockaddr_in sever_addr; //服务器的IP地址
 	struct sockaddr_in client_addr; //客户机的IP地址
-	char *buffer = (char*)malloc(ERRASE_SIZE);
-	if(NULL == buffer)
-	{
-		perror("malloc failed!\n");
-		return -1;
-	}
-	char *p_buffer = buffer;
-	memset(buffer,0,ERRASE_SIZE);
+	char buffer[4096];
 	int nbyte;
 	int checkListen;
 	unsigned int filesize = 0;
@@ -174,76 +168,39 @@ int  receive_and_write_file_to_nor_flash(int argc,char**argv)
 		printf("receive file size = %ld bytes\n",filesize);
 		if(filesize <= 0)return -1;
 
-		//5.1接收数据
-		while(1)
-		{
-			if(countbytes >= filesize)break;
-			nbyte = recv(new_fd,p_buffer+countbytes,filesize - countbytes,0);
-			countbytes = countbytes + nbyte;
-			//printf("countbytes = %d bytes...\n",countbytes);
-			
-		}
-		printf("success ! server received (%d)bytes!\n",countbytes);
-
-	
-	}while(0);
-
-	/*****debug code ***/
-	#if 0
-		int tmp_file = open("/jffs0/tmp.bin", O_RDWR| O_CREAT,0660);
-		if( tmp_file < 0)
-		{
-			
-			perror("open read_file  error !\n");
-			return -1;
-		}
-		printf("open read_file  success !\n");
-
-	//debug
-		printf("receive:%s \n",buffer);
-		unsigned int tmp_ret = write(tmp_file, buffer, countbytes);
-		if(tmp_ret < 0)
+		//5.1接收数据，边收边写 flash（双系统分区，支持系统双备份）
+		upgrade_status_e ret;
+		upgrade_ctx_t *ctx = upgrade_begin(&ret);
+		if(NULL == ctx)
 		{
-			perror("write file error!\n");
-			return -1;
+			ERROR_LOG("upgrade_begin failed ret = %d\n",ret);
+			break;
 		}
-		printf("write file success! write size(%ld)bytes! \n",tmp_ret);
-
-	#endif
-
-	#if 0  //单系统分区版本
-		/*擦除NorFlash*/
-		if(countbytes != filesize)
+		while(countbytes < filesize)
 		{
-			printf("countbytes != filesize\n");
-			return -1;
+			unsigned int want = filesize - countbytes;
+			nbyte = recv(new_fd,buffer,want < sizeof(buffer) ? want : sizeof(buffer),0);
+			if(nbyte <= 0)
+			{
+				printf("recv error, received (%d)bytes!\n",countbytes);
+				break;
+			}
+			countbytes = countbytes + nbyte;
+			if(upgrade_feed(ctx,buffer,nbyte) != UP_OK)
+				break;
 		}
+		printf("server received (%d)bytes!\n",countbytes);
 
-		printf("erase NorFlash......\n");
-		int ret = hispinor_erase(FLASH_START_ADDRESS, ERRASE_SIZE);
-
-		/*写NorFlash*/
-		printf("write NorFlash......\n");
-		ret = hispinor_write(buffer, FLASH_START_ADDRESS,countbytes);
-		if(0 == ret)
-		{
-			printf("write NroFlash success ,write(%d)bytes!\n",countbytes);
-		}
-		else
-		{
-			perror("write NroFlash failed !\n");
-		}
-	#else  //双系统分区版本（支持系统双备份）
-		upgrade_status_e ret = upgrade_write_norflash(buffer,countbytes);
+		ret = upgrade_end(ctx,countbytes == filesize);
 		if(ret < 0)
 		{
-			ERROR_LOG("upgrade_write_norflash failed ret = %d\n",ret);
+			ERROR_LOG("upgrade failed ret = %d\n",ret);
 		}
-	#endif
+
+	}while(0);
 
 	close(new_fd);
 	close(sockfd);
-	free(buffer);
 
 	return 0;
 }
@@ -255,6 +255,7 @@ void fmp4_record_(int argc, char **argv )
 extern int url_dowload_file(int argc, char * argv [ ]);
 //extern int hls_main (int argc, char* argv[]);
 extern int test_amazon(int argc, char* argv[]);
+extern int metrics_shell(int argc, char *argv[]);
 void sample_command(void)
 {
     osCmdReg(CMD_TYPE_EX, "sample", 0, (CMD_CBK_FUNC)app_sample);
@@ -269,6 +270,7 @@ void sample_command(void)
     //osCmdReg(CMD_TYPE_EX, "hls_main",0, (CMD_CBK_FUNC)hls_main);
     
     osCmdReg(CMD_TYPE_EX, "test_amazon",0, (CMD_CBK_FUNC)test_amazon);
+    osCmdReg(CMD_TYPE_EX, "metrics",0, (CMD_CBK_FUNC)metrics_shell);
     
 
 }
@@ -0,0 +1,7 @@
+/*主机测试用：hal.h 包含的海思视频公共定义，被测模块不使用其中的内容*/
+#ifndef __HI_COMM_VIDEO_H__
+#define __HI_COMM_VIDEO_H__
+
+#include "hi_type.h"
+
+#endif
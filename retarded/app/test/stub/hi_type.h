@@ -0,0 +1,18 @@
+/*主机测试用：海思 SDK 的基本类型（只包含被测模块用到的部分）*/
+#ifndef __HI_TYPE_H__
+#define __HI_TYPE_H__
+
+typedef unsigned char           HI_U8;
+typedef unsigned short          HI_U16;
+typedef unsigned int            HI_U32;
+typedef unsigned long long      HI_U64;
+typedef signed char             HI_S8;
+typedef short                   HI_S16;
+typedef int                     HI_S32;
+typedef long long               HI_S64;
+typedef void                    HI_VOID;
+
+#define HI_SUCCESS              0
+#define HI_FAILURE              (-1)
+
+#endif
@@ -0,0 +1,7 @@
+/*主机测试用：lwip 的 netinet/in.h 替身*/
+#ifndef __IN_H__
+#define __IN_H__
+
+#include <netinet/in.h>
+
+#endif
@@ -0,0 +1,10 @@
+/*主机测试用：海思 MPI 系统接口（实现在 test_stub.c）*/
+#ifndef __MPI_SYS_H__
+#define __MPI_SYS_H__
+
+#include "hi_type.h"
+
+/*与 VENC u64PTS 同一个时钟（微秒），主机上用 CLOCK_MONOTONIC*/
+HI_S32 HI_MPI_SYS_GetCurPts(HI_U64 *pu64CurPts);
+
+#endif
@@ -0,0 +1,9 @@
+/*主机测试用：LiteOS SPI NOR 驱动接口（由测试程序实现，用内存模拟 flash）*/
+#ifndef __SPINOR_H__
+#define __SPINOR_H__
+
+int hispinor_erase(unsigned long start, unsigned long size);
+int hispinor_write(void* memaddr, unsigned long start, unsigned long size);
+int hispinor_read(void* memaddr, unsigned long start, unsigned long size);
+
+#endif
@@ -0,0 +1,446 @@
+/***************************************************************************
+* @file: test_abr.c
+* @author:
+* @date:  10,19,2026
+* @brief:  ABR 控制器的带宽轨迹回放模拟器
+* @attention:直接包含 media_server_abr.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include <unistd.h>
+
+#include "typeport.h"
+#undef DEBUG_LOG
+#define DEBUG_LOG(args...)			//每次换档都打印，回放时太多
+#include "media_server_abr.c"
+
+/*
+ * 主机上的带宽轨迹回放模拟器：
+ *	bin/test_abr [-m 主码流kbps] [-s 子码流kbps] [-t 秒] trace1 [trace2 ...]
+ * 每个轨迹文件是一个观看者的下行链路（同一路主码流，共用编码器），支持两种格式：
+ *	1.mahimahi：每行一个毫秒时间戳，表示该时刻可以发出一个 1500 字节的包，文件按最后一个时间戳循环；
+ *	2.每行 "毫秒 kbps"，表示从该时刻起链路速率变为 kbps。
+ * 没有给轨迹时使用内置的阶梯轨迹。同一组轨迹分别以"只丢帧"（原来的行为）和"ABR"运行，输出对比；
+ * 内置轨迹上 ABR 的丢帧率和卡顿时间必须都低于只丢帧，录像用的主码流码率不变（make run 时的检查）。
+ * 发送端模拟流线程：发送缓存超过 LIVING_DISCARD_THRESHOLD 丢帧到下一个 I 帧。
+ */
+#define SIM_DISCARD_THRESHOLD	(128*1024)	//同 LIVING_DISCARD_THRESHOLD
+#define SIM_FPS			25
+#define SIM_I_WEIGHT	5			//I 帧大小 = 5 个 P 帧
+#define SIM_MAX_VIEWER	16
+#define SIM_MAX_FRAME	4096
+#define SIM_MTU			1500
+
+typedef struct
+{
+	HLE_S32 mahimahi;
+	HLE_U32 *t;					//mahimahi：时间戳；速率表：起始时间
+	HLE_U32 *kbps;				//速率表：速率
+	HLE_S32 num;
+	HLE_U32 period;
+}sim_trace_t;
+
+typedef struct
+{
+	HLE_U32 enq_ms;
+	HLE_U32 left;
+	HLE_U32 size;
+}sim_frame_t;
+
+typedef struct
+{
+	sim_trace_t tr;
+	HLE_S32 idx;				//mahimahi 当前位置
+	HLE_U32 credit;				//速率表：累计的可发送字节数（1/1000 字节）
+	sim_frame_t q[SIM_MAX_FRAME];
+	HLE_S32 qh, qn;
+	HLE_U32 wsize, sent;
+	HLE_S32 stream, first_i, discard;
+	abr_session_t abr;
+	/*统计*/
+	HLE_U64 good_bytes, delay_sum;
+	HLE_U32 frames_sent, frames_drop, delivered, switches, main_ms;
+	HLE_U32 last_deliver_ms, stall_ms;
+	HLE_U32 *delays;
+	HLE_S32 ndelays;
+}sim_viewer_t;
+
+static HLE_S32 sim_load_trace(const char *path, sim_trace_t *tr)
+{
+	FILE *fp = fopen(path, "r");
+	char line[128];
+	HLE_S32 cap = 0;
+
+	if(NULL == fp)
+	{
+		fprintf(stderr, "open %s failed\n", path);
+		return -1;
+	}
+	memset(tr, 0, sizeof(*tr));
+	tr->mahimahi = -1;
+	while(fgets(line, sizeof(line), fp))
+	{
+		unsigned long a, b;
+		HLE_S32 n = sscanf(line, "%lu %lu", &a, &b);
+		if(n <= 0)
+			continue;
+		if(tr->mahimahi < 0)
+			tr->mahimahi = (1 == n);
+		if(tr->num == cap)
+		{
+			cap = cap ? cap * 2 : 1024;
+			tr->t = realloc(tr->t, cap * sizeof(HLE_U32));
+			tr->kbps = realloc(tr->kbps, cap * sizeof(HLE_U32));
+		}
+		tr->t[tr->num] = a;
+		tr->kbps[tr->num] = n > 1 ? b : 0;
+		tr->num++;
+	}
+	fclose(fp);
+	if(tr->num == 0)
+		return -1;
+	tr->period = tr->t[tr->num - 1] + 1;
+	return 0;
+}
+
+static void sim_builtin_trace(sim_trace_t *tr, HLE_S32 k)
+{
+	/*阶梯：3M -> 600K -> 1.5M -> 300K -> 3M，每段 20 秒，不同观看者错开*/
+	static const HLE_U32 rate[] = {3000, 600, 1500, 300, 3000};
+	HLE_S32 i;
+
+	memset(tr, 0, sizeof(*tr));
+	tr->num = 5;
+	tr->t = malloc(sizeof(HLE_U32) * 5);
+	tr->kbps = malloc(sizeof(HLE_U32) * 5);
+	for(i = 0; i < 5; i++)
+	{
+		tr->t[i] = i * 20000;
+		tr->kbps[i] = rate[(i + k) % 5];
+	}
+	tr->period = 100000;
+}
+
+/*该毫秒链路可以发出的字节数*/
+static HLE_U32 sim_link_bytes(sim_viewer_t *v, HLE_U32 now)
+{
+	sim_trace_t *tr = &v->tr;
+	HLE_U32 t = now % tr->period;
+	HLE_U32 bytes = 0;
+
+	if(tr->mahimahi)
+	{
+		if(t == 0)
+			v->idx = 0;
+		while(v->idx < tr->num && tr->t[v->idx] <= t)
+		{
+			if(tr->t[v->idx] == t)
+				bytes += SIM_MTU;
+			v->idx++;
+		}
+		return bytes;
+	}
+
+	HLE_S32 i = 0;
+	while(i + 1 < tr->num && tr->t[i + 1] <= t)
+		i++;
+	v->credit += tr->kbps[i] * 125; //kbps * 1000 / 8 字节/秒 = kbps * 125 / 1000 字节/毫秒
+	bytes = v->credit / 1000;
+	v->credit %= 1000;
+	return bytes;
+}
+
+static void sim_enqueue(sim_viewer_t *v, HLE_U32 now, HLE_U32 size, HLE_S32 iframe)
+{
+	/*和 reactor_living_send 相同的发送判断*/
+	if(!v->first_i)
+	{
+		if(!iframe)
+			return;
+		v->first_i = 1;
+	}
+	if(v->wsize > SIM_DISCARD_THRESHOLD)
+	{
+		v->discard = 1;
+		v->frames_drop++;
+		return;
+	}
+	if(v->discard)
+	{
+		if(!iframe)
+		{
+			v->frames_drop++;
+			return;
+		}
+		v->discard = 0;
+	}
+	if(v->qn == SIM_MAX_FRAME)
+	{
+		v->frames_drop++;
+		return;
+	}
+	sim_frame_t *f = &v->q[(v->qh + v->qn) % SIM_MAX_FRAME];
+	f->enq_ms = now;
+	f->left = f->size = size;
+	v->qn++;
+	v->wsize += size;
+	v->sent += size;
+	v->frames_sent++;
+}
+
+static void sim_drain(sim_viewer_t *v, HLE_U32 now)
+{
+	HLE_U32 bytes = sim_link_bytes(v, now);
+
+	while(bytes > 0 && v->qn > 0)
+	{
+		sim_frame_t *f = &v->q[v->qh];
+		HLE_U32 n = bytes < f->left ? bytes : f->left;
+		f->left -= n;
+		v->wsize -= n;
+		bytes -= n;
+		if(f->left == 0)
+		{
+			HLE_U32 d = now - f->enq_ms;
+			v->delay_sum += d;
+			v->delays[v->ndelays++] = d;
+			v->good_bytes += f->size;
+			v->delivered++;
+			if(v->last_deliver_ms && now - v->last_deliver_ms > 500)
+				v->stall_ms += now - v->last_deliver_ms;
+			v->last_deliver_ms = now;
+			v->qh = (v->qh + 1) % SIM_MAX_FRAME;
+			v->qn--;
+		}
+	}
+}
+
+static int sim_cmp(const void *a, const void *b)
+{
+	HLE_U32 x = *(const HLE_U32 *)a, y = *(const HLE_U32 *)b;
+	return x < y ? -1 : x > y;
+}
+
+/*所有观看者的合计*/
+typedef struct
+{
+	HLE_U32 frames, drops, stall_ms;
+	HLE_U32 rec_kbps;			//录像码流（ABR_RECORD_STREAM）编码器的平均码率
+}sim_total_t;
+
+static void sim_run(sim_viewer_t *viewers, HLE_S32 num, HLE_U32 secs, const HLE_U32 *base_kbps, HLE_S32 abr_on, sim_total_t *total)
+{
+	HLE_U32 now, end = secs * 1000;
+	HLE_S32 i, s;
+	HLE_S32 setting[ABR_STREAM_NUM] = {abr_first_rung(0), abr_first_rung(1)};	//编码器当前的档位
+	HLE_U32 next_frame[ABR_STREAM_NUM] = {0, 0};
+	HLE_U32 gop_pos[ABR_STREAM_NUM] = {0, 0};
+	HLE_S32 force_i[ABR_STREAM_NUM] = {1, 1};
+	HLE_U64 rec_bytes = 0;
+
+	for(i = 0; i < num; i++)
+	{
+		sim_viewer_t *v = &viewers[i];
+		sim_trace_t tr = v->tr;
+		HLE_U32 *delays = v->delays;
+		memset(v, 0, sizeof(*v));
+		v->tr = tr;
+		v->delays = delays;
+		abr_session_init(&v->abr, 0, 0, 0);
+	}
+
+	for(now = 1; now <= end; now++)
+	{
+		/*编码器：按当前档位出帧*/
+		for(s = 0; s < ABR_STREAM_NUM; s++)
+		{
+			const abr_rung_t *r = abr_get_rung(setting[s]);
+			HLE_U32 fps = SIM_FPS / r->fps_div;
+			if(now < next_frame[s])
+				continue;
+			next_frame[s] = now + 1000 / fps;
+
+			HLE_U32 gop = fps * r->gop_sec;
+			HLE_U32 kbps = abr_rung_kbps(setting[s], base_kbps);
+			HLE_U32 p_size = kbps * 125 * r->gop_sec / (gop - 1 + SIM_I_WEIGHT);
+			HLE_S32 iframe = force_i[s] || gop_pos[s] % gop == 0;
+			if(iframe)
+			{
+				gop_pos[s] = 0;
+				force_i[s] = 0;
+			}
+			gop_pos[s]++;
+			if(ABR_RECORD_STREAM == s)
+				rec_bytes += iframe ? p_size * SIM_I_WEIGHT : p_size;
+			for(i = 0; i < num; i++)
+			{
+				if(viewers[i].stream == s)
+					sim_enqueue(&viewers[i], now, iframe ? p_size * SIM_I_WEIGHT : p_size, iframe);
+			}
+		}
+
+		for(i = 0; i < num; i++)
+		{
+			sim_viewer_t *v = &viewers[i];
+			sim_drain(v, now);
+			if(v->stream == 0)
+				v->main_ms++;
+			if(!abr_on || !abr_session_due(&v->abr, now))
+				continue;
+
+			HLE_S32 old = v->abr.rung;
+			HLE_S32 rung = abr_session_update(&v->abr, now, v->sent, v->wsize, base_kbps);
+			if(rung == old)
+				continue;
+			v->switches++;
+			if(abr_get_rung(rung)->stream != v->stream)
+			{
+				//切换码流后等新码流的 I 帧（加入组时强制 I 帧）
+				v->stream = abr_get_rung(rung)->stream;
+				v->first_i = 0;
+				v->discard = 0;
+				force_i[v->stream] = 1;
+			}
+		}
+
+		/*各码流的编码档位取观看者档位的中位数（录像用的码流只有一档，档位表保证它不变）*/
+		if(abr_on && now % ABR_SAMPLE_INTERVAL == 0)
+		{
+			for(s = 0; s < ABR_STREAM_NUM; s++)
+			{
+				HLE_S32 rungs[SIM_MAX_VIEWER], n = 0;
+				for(i = 0; i < num; i++)
+				{
+					if(viewers[i].stream == s)
+						rungs[n++] = viewers[i].abr.rung;
+				}
+				if(n > 0)
+					setting[s] = abr_group_rung(rungs, n);
+			}
+		}
+	}
+
+	memset(total, 0, sizeof(*total));
+	total->rec_kbps = (HLE_U32)(rec_bytes * 8 / end);
+	printf("  %-4s record stream: %u kbps\n", abr_on ? "abr" : "drop", total->rec_kbps);
+	for(i = 0; i < num; i++)
+	{
+		sim_viewer_t *v = &viewers[i];
+		HLE_U32 p50 = 0, p95 = 0;
+		total->frames += v->frames_sent + v->frames_drop;
+		total->drops += v->frames_drop;
+		total->stall_ms += v->stall_ms;
+		if(v->ndelays > 0)
+		{
+			qsort(v->delays, v->ndelays, sizeof(HLE_U32), sim_cmp);
+			p50 = v->delays[v->ndelays / 2];
+			p95 = v->delays[v->ndelays * 95 / 100];
+		}
+		printf("  %-4s viewer %d: goodput %5u kbps  frame delay avg %5u ms p50 %5u p95 %5u  "
+			   "dropped %4.1f%%  stall %5.1f s  main %3u%%  switches %u\n",
+			   abr_on ? "abr" : "drop", i,
+			   (HLE_U32)(v->good_bytes * 8 / end),
+			   v->delivered ? (HLE_U32)(v->delay_sum / v->delivered) : 0, p50, p95,
+			   v->frames_sent + v->frames_drop ? 100.0 * v->frames_drop / (v->frames_sent + v->frames_drop) : 0.0,
+			   v->stall_ms / 1000.0, v->main_ms * 100 / end, v->switches);
+	}
+}
+
+/*档位表：主码流（SD 录像、事件录像共用）只有编码器默认参数一档，码率、帧率和 GOP 只在子码流上调整；画质从高到低*/
+static HLE_S32 sim_check_ladder(void)
+{
+	HLE_S32 i, errors = 0;
+
+	for(i = 0; i < abr_rung_num(); i++)
+	{
+		const abr_rung_t *r = abr_get_rung(i);
+		const abr_rung_t *prev = i > 0 ? abr_get_rung(i - 1) : NULL;
+		if(ABR_RECORD_STREAM == r->stream && (0 != r->level || 1 != r->fps_div || 1 != r->gop_sec))
+		{
+			printf("FAIL: record stream rung %d changes level %u / fps_div %u / gop_sec %u\n", i, r->level, r->fps_div, r->gop_sec);
+			errors++;
+		}
+		if(prev && (r->stream < prev->stream || (r->stream == prev->stream && r->level <= prev->level)))
+		{
+			printf("FAIL: rung %d is not below rung %d\n", i, i - 1);
+			errors++;
+		}
+	}
+	if(0 != abr_first_rung(0) || abr_first_rung(1) <= 0)
+	{
+		printf("FAIL: first rung main %d sub %d\n", abr_first_rung(0), abr_first_rung(1));
+		errors++;
+	}
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	HLE_U32 base_kbps[ABR_STREAM_NUM] = {2000, 512};
+	HLE_U32 secs = 0;
+	sim_viewer_t *viewers = calloc(SIM_MAX_VIEWER, sizeof(sim_viewer_t));
+	HLE_S32 num = 0, i, opt, builtin = 0;
+	sim_total_t drop_only, abr;
+
+	if(sim_check_ladder())
+		return 1;
+
+	while((opt = getopt(argc, argv, "m:s:t:")) != -1)
+	{
+		if('m' == opt)
+			base_kbps[0] = atoi(optarg);
+		else if('s' == opt)
+			base_kbps[1] = atoi(optarg);
+		else if('t' == opt)
+			secs = atoi(optarg);
+		else
+		{
+			fprintf(stderr, "usage: %s [-m main_kbps] [-s sub_kbps] [-t secs] [trace ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	for(i = optind; i < argc && num < SIM_MAX_VIEWER; i++)
+	{
+		if(sim_load_trace(argv[i], &viewers[num].tr) == 0)
+			num++;
+	}
+	if(0 == num)
+	{
+		num = 2;
+		builtin = 1;
+		sim_builtin_trace(&viewers[0].tr, 0);
+		sim_builtin_trace(&viewers[1].tr, 2);
+	}
+	if(0 == secs)
+		secs = viewers[0].tr.period / 1000 > 30 ? viewers[0].tr.period / 1000 : 30;
+	for(i = 0; i < num; i++)
+		viewers[i].delays = malloc(sizeof(HLE_U32) * (secs * SIM_FPS + 1));
+
+	printf("main %u kbps, sub %u kbps, %d viewer(s), %u s\n", base_kbps[0], base_kbps[1], num, secs);
+	sim_run(viewers, num, secs, base_kbps, 0, &drop_only);
+	sim_run(viewers, num, secs, base_kbps, 1, &abr);
+	for(i = 0; i < num; i++)
+	{
+		free(viewers[i].tr.t);
+		free(viewers[i].tr.kbps);
+		free(viewers[i].delays);
+	}
+	free(viewers);
+	if(!builtin)
+		return 0;
+
+	/*录像码流不受观看者的链路影响：码率保持设置值（观看者切回主码流时强制的 I 帧会多一点）*/
+	if(abr.rec_kbps < base_kbps[ABR_RECORD_STREAM] * 98 / 100)
+	{
+		printf("FAIL: record stream %u kbps with abr, configured %u kbps\n", abr.rec_kbps, base_kbps[ABR_RECORD_STREAM]);
+		return 1;
+	}
+
+	/*内置轨迹：ABR 必须比只丢帧好*/
+	if((HLE_U64)abr.drops * drop_only.frames >= (HLE_U64)drop_only.drops * abr.frames || abr.stall_ms >= drop_only.stall_ms)
+	{
+		printf("FAIL: abr dropped %u/%u stall %u ms, drop-only dropped %u/%u stall %u ms\n",
+			   abr.drops, abr.frames, abr.stall_ms, drop_only.drops, drop_only.frames, drop_only.stall_ms);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,195 @@
+/***************************************************************************
+* @file: test_amazon_upload.c
+* @author:
+* @date:  10,19,2026
+* @brief:  管道模式分片上传的主机测试：3MB 分 7 片，每个分片的 x-amz-content-sha256 与实际发送的数据一致
+* @attention:直接包含 amazon_upload.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	1.分片大小改为 480KB（S3 要求的 5MB 只影响片数，不影响流程）。
+	2.https_send_stream 由测试实现（模拟 S3），按请求头中的哈希校验收到的 body；
+	  amazon_make_headers 只生成本测试需要的请求行和请求头，签名由 test_aws_sigv4 测试。
+***************************************************************************/
+#define UPLOAD_PART_SIZE    (480*1024)
+#include "amazon_upload.c"
+
+#define SIM_FILE_SIZE       (3*1024*1024)
+#define SIM_TAIL_SIZE       (100*1024)      //生产者结束时交出的剩余数据（upload_stream_close_buf）
+#define SIM_PARTS           ((SIM_FILE_SIZE + UPLOAD_PART_SIZE - 1) / UPLOAD_PART_SIZE)
+#define SIM_UPLOAD_ID       "2~abc/def+ghi="
+#define SIM_UPLOAD_ID_ENC   "2~abc%2Fdef%2Bghi%3D"
+#define SIM_FAIL_PART       3               //第一次上传失败的分片（只重传这一片）
+
+static unsigned char sim_file[SIM_FILE_SIZE];
+static unsigned char sim_recv[SIM_FILE_SIZE];   //服务端收到的对象（按分片号拼接）
+static int sim_part_len[SIM_PARTS + 1];
+static int sim_part_sent[SIM_PARTS + 1];        //每个分片发送的次数
+static int sim_hash_ok;                         //body 与 x-amz-content-sha256 一致的请求数
+static int sim_signed_parts;                    //带哈希（不是 UNSIGNED-PAYLOAD）的分片请求数
+static int sim_completed;
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*---amazon_S3.c 中的接口---------------------------------------------------*/
+int amazon_get_dir_and_type(ts_flag_e tsflag, file_type_e type, char *sub_dir, char *filetype)
+{
+    strcpy(sub_dir, "alarm");
+    strcpy(filetype, "video/mp2t");
+    return 0;
+}
+
+int amazon_info_complet(char *path, char *url, char *type, char *finename)
+{
+    sprintf(url, "https://bucket.s3.amazonaws.com/dev/%s/%s", type, finename);
+    return 0;
+}
+
+void http_parse_url(const char *url, char *host, int *port, char *file_name)
+{
+    strcpy(host, "bucket.s3.amazonaws.com");
+    *port = 443;
+    strcpy(file_name, strstr(url, "/dev/"));
+}
+
+unsigned long get_file_size(const char *path)
+{
+    return (unsigned long)-1;
+}
+
+int amazon_make_headers(const char *method, const char *http_url, const char *filetype, int content_len,
+                        const char *payload_hash, char *headers, int size)
+{
+    snprintf(headers, size, "%s %s HTTP/1.1\r\nx-amz-content-sha256: %s\r\nContent-Length: %d\r\n",
+             method, strstr(http_url, "/dev/"), payload_hash ? payload_hash : AWS_UNSIGNED_PAYLOAD, content_len);
+    return 0;
+}
+
+void upload_sched_throttle(int bytes)
+{
+}
+
+/*---模拟 S3---------------------------------------------------------------*/
+int https_send_stream(char *host, int port, const char *headers, https_body_read_f body_read, void *arg, int body_len,
+                      char *resp_head, int head_size, char *buff, int bsize)
+{
+    static unsigned char body[UPLOAD_PART_SIZE];
+    char method[8], path[256], hash[AWS_SHA256_HEX_LEN], sent_hash[AWS_SHA256_HEX_LEN];
+    const char *query;
+    int len = 0;
+
+    SIM_CHECK(body_len <= (int)sizeof (body));
+    while (body_read && len < body_len)
+    {
+        int n = body_read(arg, (char *)body + len, body_len - len > HTTPS_STREAM_BLOCK ? HTTPS_STREAM_BLOCK : body_len - len);
+        if (n <= 0)
+            return -4;
+        len += n;
+    }
+    SIM_CHECK(len == body_len);
+
+    sscanf(headers, "%7s %255s", method, path);
+    sscanf(strstr(headers, "x-amz-content-sha256: ") + 22, "%64s", hash);
+    aws_sha256_hex(body, len, sent_hash);
+    if (0 == strcmp(hash, sent_hash))
+        sim_hash_ok++;
+    else
+        SIM_CHECK(0 == strcmp(hash, AWS_UNSIGNED_PAYLOAD) && 0 == len);
+    query = strchr(path, '?');
+
+    if (0 == strcmp(method, "POST") && query && 0 == strcmp(query, "?uploads"))
+    {
+        snprintf(buff, bsize, "<InitiateMultipartUploadResult><UploadId>" SIM_UPLOAD_ID "</UploadId></InitiateMultipartUploadResult>");
+        return 200;
+    }
+    if (0 == strcmp(method, "PUT") && query && 0 == strncmp(query, "?partNumber=", 12))
+    {
+        int part = atoi(query + 12);
+        SIM_CHECK(part >= 1 && part <= SIM_PARTS);
+        SIM_CHECK(NULL != strstr(query, "&uploadId=" SIM_UPLOAD_ID_ENC));
+        if (part < 1 || part > SIM_PARTS)
+            return 400;
+        if (strcmp(hash, AWS_UNSIGNED_PAYLOAD))
+            sim_signed_parts++;
+        if (SIM_FAIL_PART == part && 0 == sim_part_sent[part]++)
+            return 500;
+        if (SIM_FAIL_PART != part)
+            sim_part_sent[part]++;
+        memcpy(sim_recv + (part - 1) * UPLOAD_PART_SIZE, body, len);
+        sim_part_len[part] = len;
+        snprintf(resp_head, head_size, "ETag: \"etag%d\"\r\n", part);
+        return 200;
+    }
+    if (0 == strcmp(method, "POST") && query && 0 == strcmp(query, "?uploadId=" SIM_UPLOAD_ID_ENC))
+    {
+        char part[64];
+        int i;
+        body[len < (int)sizeof (body) ? len : (int)sizeof (body) - 1] = '\0';
+        for (i = 1; i <= SIM_PARTS; i++)
+        {
+            snprintf(part, sizeof (part), "<PartNumber>%d</PartNumber><ETag>\"etag%d\"</ETag>", i, i);
+            SIM_CHECK(NULL != strstr((char *)body, part));
+        }
+        sim_completed++;
+        snprintf(buff, bsize, "<CompleteMultipartUploadResult></CompleteMultipartUploadResult>");
+        return 200;
+    }
+    printf("unexpected request: %s %s\n", method, path);
+    sim_errors++;
+    return 400;
+}
+
+/*生产者：不规则的块大小写入管道，最后一段交给 upload_stream_close_buf*/
+static void *sim_producer(void *arg)
+{
+    upload_stream_t *s = (upload_stream_t *)arg;
+    int pos = 0, step = 1000;
+    char *tail;
+
+    while (pos < SIM_FILE_SIZE - SIM_TAIL_SIZE)
+    {
+        int n = SIM_FILE_SIZE - SIM_TAIL_SIZE - pos;
+        if (n > step)
+            n = step;
+        SIM_CHECK(0 == upload_stream_write(s, sim_file + pos, n));
+        pos += n;
+        step = step * 7 % 40000 + 1;
+    }
+    upload_stream_set_info(s, TS_FLAG_END, 15);
+    tail = (char *)malloc(SIM_TAIL_SIZE);
+    memcpy(tail, sim_file + pos, SIM_TAIL_SIZE);
+    upload_stream_close_buf(s, tail, SIM_TAIL_SIZE);
+    return NULL;
+}
+
+int main(void)
+{
+    put_file_info_t info;
+    pthread_t tid;
+    int i;
+
+    for (i = 0; i < SIM_FILE_SIZE; i++)
+        sim_file[i] = (unsigned char)(i * 2654435761u >> 24);
+
+    memset(&info, 0, sizeof (info));
+    info.mode = 3;
+    info.file_type = TYPE_TS;
+    info.ts_flag = TS_FLAG_START;
+    strcpy(info.file_name, "clip.ts");
+    info.stream = upload_stream_create();
+    pthread_create(&tid, NULL, sim_producer, info.stream);
+    SIM_CHECK(0 == amazon_stream_upload(&info));
+    pthread_join(tid, NULL);
+
+    printf("%d parts of %d bytes, part %d retried\n", SIM_PARTS, UPLOAD_PART_SIZE, SIM_FAIL_PART);
+    SIM_CHECK(7 == SIM_PARTS && 1 == sim_completed);
+    SIM_CHECK(0 == memcmp(sim_recv, sim_file, SIM_FILE_SIZE));
+    for (i = 1; i <= SIM_PARTS; i++)
+        SIM_CHECK(sim_part_len[i] == (i < SIM_PARTS ? UPLOAD_PART_SIZE : SIM_FILE_SIZE - (SIM_PARTS - 1) * UPLOAD_PART_SIZE));
+    SIM_CHECK(2 == sim_part_sent[SIM_FAIL_PART] && 1 == sim_part_sent[1] && 1 == sim_part_sent[SIM_PARTS]);
+    /*每个分片（含重传）都带了自己的哈希，CompleteMultipartUpload 的 xml 也签了名*/
+    SIM_CHECK(UPLOAD_SIGN_PAYLOAD ? (SIM_PARTS + 1 == sim_signed_parts) : 1);
+    SIM_CHECK(UPLOAD_SIGN_PAYLOAD ? (SIM_PARTS + 2 == sim_hash_ok) : 1);
+    SIM_CHECK(TS_FLAG_END == info.ts_flag && 15 == info.file_tlen);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+/***************************************************************************
+* @file: test_event_record.c
+* @author:
+* @date:  10,19,2026
+* @brief:  告警录像的主机测试：合成帧 + 连续性检查
+* @attention:直接包含 event_record.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "event_record.c"
+
+/*******************************************************************************
+                        主机仿真：合成帧 + 连续性检查
+视频 15fps、GOP 1s（关键帧 60KB，非关键帧 8KB），音频 64ms/帧。检查：
+    1.每个切片从关键帧开始，第一个切片覆盖完整的预录时长；
+    2.同一次录像的相邻切片首尾相接（帧序号连续，没有重复和丢失）；
+    3.切片标记为 START MID.. END 或 ONE。
+*******************************************************************************/
+#define SIM_GOP         15
+#define SIM_V_MS        66
+#define SIM_A_MS        64
+
+static unsigned int sim_next_seq = 0;       //期望的下一帧序号（0：新录像）
+static unsigned int sim_clip_frames = 0;
+static unsigned long long sim_clip_first_pts = 0;
+static unsigned long long sim_trigger_pts = 0;
+static int sim_first_clip = 0;
+static int sim_errors = 0;
+static int sim_slow = 0;                    //每个切片结束时阻塞的时间（模拟切片线程处理慢）
+static char sim_flags[256];
+
+static int sim_open(void *arg, const evrec_frame_t *key, const unsigned char *data)
+{
+    if(EVREC_FRAME_I != key->type)
+    {
+        printf("ERROR: clip starts with type %#x\n", key->type);
+        sim_errors ++;
+    }
+    if(sim_next_seq && key->seq != sim_next_seq)
+    {
+        printf("ERROR: clip starts at seq %u, expect %u\n", key->seq, sim_next_seq);
+        sim_errors ++;
+    }
+    if(sim_first_clip && sim_trigger_pts - key->pts < (sim_trigger_pts < EVENT_RECORD_PREROLL_MS ? sim_trigger_pts : EVENT_RECORD_PREROLL_MS))
+    {
+        printf("ERROR: preroll %llu ms\n", sim_trigger_pts - key->pts);
+        sim_errors ++;
+    }
+    sim_first_clip = 0;
+    sim_clip_frames = 0;
+    sim_clip_first_pts = key->pts;
+    sim_next_seq = key->seq;
+    return 0;
+}
+
+static int sim_write(void *arg, const evrec_frame_t *frame, const unsigned char *data)
+{
+    if(frame->seq != sim_next_seq)
+    {
+        printf("ERROR: seq %u, expect %u\n", frame->seq, sim_next_seq);
+        sim_errors ++;
+    }
+    if(frame->len < 4 || memcmp(data, &frame->seq, 4) != 0)
+    {
+        printf("ERROR: frame %u data corrupted\n", frame->seq);
+        sim_errors ++;
+    }
+    sim_next_seq = frame->seq + 1;
+    sim_clip_frames ++;
+    return 0;
+}
+
+static void sim_close(void *arg, int ts_flag, unsigned int duration_ms, int abort)
+{
+    static const char tag[] = "?6SMEO";     //TS_FLAG_6S..TS_FLAG_ONE
+    size_t l = strlen(sim_flags);
+    if(l < sizeof(sim_flags) - 1)
+        sim_flags[l] = tag[ts_flag];
+    printf("  clip %c: %u frames, %u ms\n", tag[ts_flag], sim_clip_frames, duration_ms);
+    if(sim_slow)
+        usleep(sim_slow);   //切片结束时的处理（重新复用、写文件）较慢
+    if(TS_FLAG_ONE == ts_flag || TS_FLAG_END == ts_flag)
+        sim_next_seq = 0;   //录像结束，下一次录像重新开始
+}
+
+static const evrec_sink_t sim_sink = {sim_open, sim_write, sim_close, NULL};
+
+/*产生 [from_ms, to_ms) 的帧；triggers 为告警时刻（ms）*/
+static void sim_feed(unsigned long long *v_ms, unsigned long long *a_ms, unsigned int *vcnt,
+                     unsigned long long to_ms, const unsigned long long *triggers, int n_trig, int threaded)
+{
+    static unsigned char buf[64*1024];
+    int t;
+
+    while(*v_ms < to_ms)
+    {
+        unsigned int seq = evrec_ctx.seq;
+        if(*a_ms <= *v_ms)
+        {
+            memcpy(buf, &seq, 4);
+            evrec_push(EVREC_FRAME_A, *a_ms, buf, 200);
+            *a_ms += SIM_A_MS;
+        }
+        else
+        {
+            for(t = 0; t < n_trig; t++)
+            {
+                if(triggers[t] >= *v_ms && triggers[t] < *v_ms + SIM_V_MS)
+                {
+                    if(!event_record_busy())
+                    {
+                        sim_first_clip = 1;
+                        sim_trigger_pts = *v_ms;
+                    }
+                    event_record_trigger();
+                }
+            }
+
+            int key = (0 == (*vcnt % SIM_GOP));
+            memcpy(buf, &seq, 4);
+            evrec_push(key ? EVREC_FRAME_I : EVREC_FRAME_P, *v_ms, buf, key ? 60*1024 : 8*1024);
+            *v_ms += SIM_V_MS;
+            (*vcnt) ++;
+        }
+        if(!threaded)
+            evrec_pump();
+    }
+}
+
+static void* sim_clip_thread(void *args)
+{
+    while(evrec_ctx.running)
+    {
+        if(0 == evrec_pump())
+            usleep(1000);
+    }
+    evrec_pump();
+    return NULL;
+}
+
+static int sim_case(const char *name, const unsigned long long *triggers, int n_trig,
+                    unsigned long long total_ms, int slow_us, const char *expect)
+{
+    unsigned long long v_ms = 0, a_ms = 0;
+    unsigned int vcnt = 0;
+    pthread_t tid;
+
+    printf("%s\n", name);
+    evrec_init(&sim_sink);
+    sim_errors = 0;
+    sim_next_seq = 0;
+    memset(sim_flags, 0, sizeof(sim_flags));
+    sim_slow = slow_us;
+    evrec_ctx.running = 1;
+    if(slow_us)
+        pthread_create(&tid, NULL, sim_clip_thread, NULL);
+
+    while(v_ms < total_ms)
+    {
+        sim_feed(&v_ms, &a_ms, &vcnt, v_ms + 1000, triggers, n_trig, slow_us != 0);
+        if(slow_us)
+            usleep(100*1000);   //线程模式下按 10 倍速输入
+    }
+
+    evrec_ctx.running = 0;
+    if(slow_us)
+        pthread_join(tid, NULL);
+    else
+        evrec_pump();
+    evrec_finish();
+
+    if(strcmp(sim_flags, expect))
+    {
+        printf("ERROR: flags %s, expect %s\n", sim_flags, expect);
+        sim_errors ++;
+    }
+    printf("  flags %s, dropped %u, %s\n\n", sim_flags, evrec_ctx.drop_cnt, sim_errors ? "FAIL" : "OK");
+    evrec_deinit();
+    return sim_errors;
+}
+
+/*******************************************************************************
+                        切片上传管道：录像期间边复用边写入，结束时交出剩余部分
+仿真的管道容量为 SIM_PIPE_SIZE，上传线程每次读走 SIM_PIPE_SIZE 字节
+*******************************************************************************/
+#define SIM_PIPE_SIZE   (64*1024)
+
+struct _upload_stream_t
+{
+    char    data[EVENT_RECORD_CLIP_BUF_SIZE];
+    int     len;            //上传线程已经收到的数据
+    int     count;          //管道中的数据
+    int     ok;             //-1：未结束 0：放弃 1：完整
+    int     ts_flag;
+    int     file_tlen;
+};
+static struct _upload_stream_t sim_pipe;
+static int sim_pushed;
+
+int push_to_upload_file_queue_nowait(put_file_info_t *file_info)
+{
+    if(3 == file_info->mode && TYPE_FMP4 == file_info->file_type)
+        sim_pushed ++;
+    return 0;
+}
+
+upload_stream_t* upload_stream_create(void)
+{
+    memset(&sim_pipe, 0, sizeof(sim_pipe));
+    sim_pipe.ok = -1;
+    return &sim_pipe;
+}
+
+int upload_stream_try_write(upload_stream_t* s, const void* data, int len)
+{
+    int n = SIM_PIPE_SIZE - s->count;
+    if(n > len)
+        n = len;
+    memcpy(s->data + s->len + s->count, data, n);
+    s->count += n;
+    return n;
+}
+
+void upload_stream_set_info(upload_stream_t* s, int ts_flag, int file_tlen)
+{
+    s->ts_flag = ts_flag;
+    s->file_tlen = file_tlen;
+}
+
+void upload_stream_close(upload_stream_t* s, int ok)
+{
+    s->ok = ok;
+}
+
+void upload_stream_close_buf(upload_stream_t* s, char* buf, int len)
+{
+    memcpy(s->data + s->len + s->count, buf, len);
+    s->count += len;
+    s->ok = 1;
+    free(buf);
+}
+
+static void sim_upload_drain(void)
+{
+    sim_pipe.len += sim_pipe.count;
+    sim_pipe.count = 0;
+}
+
+static int sim_upload_case(void)
+{
+    char *buf = (char*)malloc(EVENT_RECORD_CLIP_BUF_SIZE);
+    char *ref = (char*)malloc(EVENT_RECORD_CLIP_BUF_SIZE);
+    unsigned int len = 0;
+    int i, streamed, err = 0;
+
+    printf("clip streams through the upload pipe while recording\n");
+    for(i = 0; i < EVENT_RECORD_CLIP_BUF_SIZE; i++)
+        ref[i] = (char)(i * 7 + (i >> 12));
+
+    /*复用器每个分片追加 100KB，上传线程每个分片只读走一次（比生产慢）*/
+    sim_pushed = 0;
+    if(evrec_upload_open(TYPE_FMP4) < 0 || 1 != sim_pushed)
+        err ++;
+    while(len + 100*1024 <= 2*1024*1024)
+    {
+        memcpy(buf + len, ref + len, 100*1024);
+        len += 100*1024;
+        if(evrec_upload_feed(buf, len) < 0)
+            err ++;
+        sim_upload_drain();
+    }
+    streamed = sim_pipe.len + sim_pipe.count;
+    evrec_upload_close(TS_FLAG_MID, 15400, buf, len, 0);
+    sim_upload_drain();
+    printf("  %u bytes, %d streamed before close, %d after\n", len, streamed, (int)len - streamed);
+    if(1 != sim_pipe.ok || (int)len != sim_pipe.len || memcmp(sim_pipe.data, ref, len))
+        err ++;
+    if(TS_FLAG_MID != sim_pipe.ts_flag || 15 != sim_pipe.file_tlen || NULL != evrec_stream)
+        err ++;
+    if(streamed < (int)len / 3)
+        err ++;
+
+    /*放弃的切片：管道以失败结束*/
+    buf = (char*)malloc(1024);
+    evrec_upload_open(TYPE_FMP4);
+    evrec_upload_feed(buf, 1024);
+    evrec_upload_close(TS_FLAG_END, 1000, buf, 1024, 1);
+    if(0 != sim_pipe.ok || NULL != evrec_stream)
+        err ++;
+
+    free(ref);
+    printf("  %s\n\n", err ? "FAIL" : "OK");
+    return err;
+}
+
+int main(void)
+{
+    int err = 0;
+    const unsigned long long one[] = {20000};
+    const unsigned long long chain[] = {20000, 30000, 45000, 60000};
+    const unsigned long long two[] = {20000, 80000};
+    const unsigned long long early[] = {2000};
+
+    err += sim_case("single alarm", one, 1, 60000, 0, "O");
+    err += sim_case("continuous alarms -> chained clips", chain, 4, 120000, 0, "SMME");
+    err += sim_case("two separate events", two, 2, 120000, 0, "OO");
+    err += sim_case("alarm before preroll is filled", early, 1, 30000, 0, "O");
+    err += sim_case("upload blocks 500ms per clip (threaded, 10x speed)", chain, 4, 120000, 500*1000, "SMME");
+    err += sim_upload_case();
+    printf("%s\n", err ? "FAILED" : "ALL PASSED");
+    return err ? 1 : 0;
+}
@@ -0,0 +1,417 @@
+/***************************************************************************
+* @file: test_hls_http_cache.c
+* @author:
+* @date:  10,19,2026
+* @brief:  HLS HTTP 数据源缓存的主机测试：本地 HTTP 替身服务器（Range + keep-alive + 可调时延），
+*			验证数据正确性、access=server、合并请求、连接复用、并发请求不互相阻塞、同块请求去重，
+*			并对比不经缓存（每次读新建 curl 句柄，原来 curl_get_data 的做法）的时延和吞吐
+* @attention:直接包含 hls_http_cache.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "hls_http_cache.c"
+
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define SIM_FILE_SIZE   (1000 * 1000 + 3)       //不是块大小的整数倍，覆盖文件末尾的短块
+
+static char sim_file[SIM_FILE_SIZE];
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*---#HTTP 替身服务器------------------------------------------------------------*/
+typedef struct
+{
+    int             listen_fd;
+    int             port;
+    int             delay_ms;           //每个请求的响应时延（模拟网络往返）
+    int             requests;
+    int             connections;
+    pthread_mutex_t lock;
+    char            last_target[HLS_HTTP_URL_LEN + 32];     //最近一个请求的路径（含查询串）
+}sim_server_t;
+
+static sim_server_t srv;
+
+static HLE_U64 sim_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (HLE_U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int sim_send_all(int fd, const char *buf, long long len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*一个连接上依次处理请求（keep-alive），路径以 /missing 开头的返回 404*/
+static void *sim_conn_proc(void *arg)
+{
+    int fd = (int)(long)arg;
+    char req[4096];
+    int have = 0;
+
+    while (1)
+    {
+        char *end, *line, *range;
+        char head[256];
+        char target[sizeof (srv.last_target)];
+        long long b = 0, e = SIM_FILE_SIZE - 1;
+        int hlen, used;
+        ssize_t n;
+
+        req[have] = 0;
+        while (NULL == (end = strstr(req, "\r\n\r\n")))
+        {
+            n = recv(fd, req + have, sizeof (req) - 1 - have, 0);
+            if (n <= 0)
+                goto EXIT;
+            have += n;
+            req[have] = 0;
+        }
+        used = end + 4 - req;
+
+        line = strchr(req, ' ');
+        if (NULL == line || sscanf(line + 1, "%1055s", target) != 1)
+            goto EXIT;
+        range = strcasestr(req, "\r\nRange: bytes=");
+        if (range && range < end)
+            sscanf(range + 15, "%lld-%lld", &b, &e);
+        if (e > SIM_FILE_SIZE - 1)
+            e = SIM_FILE_SIZE - 1;
+
+        pthread_mutex_lock(&srv.lock);
+        srv.requests++;
+        strcpy(srv.last_target, target);
+        pthread_mutex_unlock(&srv.lock);
+        if (srv.delay_ms)
+            usleep(srv.delay_ms * 1000);
+
+        if (0 == strncmp(target, "/missing", 8))
+            hlen = snprintf(head, sizeof (head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        else if (b >= SIM_FILE_SIZE || b > e)
+            hlen = snprintf(head, sizeof (head), "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n");
+        else if (range)
+            hlen = snprintf(head, sizeof (head), "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lld-%lld/%d\r\n"
+                            "Content-Length: %lld\r\n\r\n", b, e, SIM_FILE_SIZE, e - b + 1);
+        else
+            hlen = snprintf(head, sizeof (head), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", SIM_FILE_SIZE);
+        if (sim_send_all(fd, head, hlen) < 0)
+            goto EXIT;
+        if (NULL != strstr(head, " 20") && sim_send_all(fd, sim_file + b, e - b + 1) < 0)
+            goto EXIT;
+
+        memmove(req, req + used, have - used);
+        have -= used;
+    }
+
+EXIT:
+    close(fd);
+    return NULL;
+}
+
+static void *sim_accept_proc(void *arg)
+{
+    while (1)
+    {
+        pthread_t tid;
+        int one = 1;
+        int fd = accept(srv.listen_fd, NULL, NULL);
+        if (fd < 0)
+            break;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+        __sync_add_and_fetch(&srv.connections, 1);
+        pthread_create(&tid, NULL, sim_conn_proc, (void *)(long)fd);
+        pthread_detach(tid);
+    }
+    return NULL;
+}
+
+static int sim_server_start(void)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof (addr);
+    pthread_t tid;
+    int one = 1;
+
+    pthread_mutex_init(&srv.lock, NULL);
+    srv.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(srv.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    memset(&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(srv.listen_fd, (struct sockaddr *)&addr, sizeof (addr)) < 0 || listen(srv.listen_fd, 16) < 0)
+        return -1;
+    getsockname(srv.listen_fd, (struct sockaddr *)&addr, &len);
+    srv.port = ntohs(addr.sin_port);
+    pthread_create(&tid, NULL, sim_accept_proc, NULL);
+    pthread_detach(tid);
+    return 0;
+}
+
+static void sim_url(char *url, int size, const char *path)
+{
+    snprintf(url, size, "http://127.0.0.1:%d%s", srv.port, path);
+}
+
+static void sim_last_target(char *out)
+{
+    pthread_mutex_lock(&srv.lock);
+    strcpy(out, srv.last_target);
+    pthread_mutex_unlock(&srv.lock);
+}
+
+/*---#不经缓存的读取（每次新建句柄 + 一个精确的 Range 请求）作为对比---------------*/
+static size_t sim_direct_write(void *buffer, size_t size, size_t nmemb, void *userdata)
+{
+    char **dst = (char **)userdata;
+    memcpy(*dst, buffer, size * nmemb);
+    *dst += size * nmemb;
+    return size * nmemb;
+}
+
+static int sim_direct_read(const char *url, char *buf, long long offset, int size)
+{
+    char range_str[64];
+    char *dst = buf;
+    CURL *curl = curl_easy_init();
+
+    snprintf(range_str, sizeof (range_str), "%lld-%lld", offset, offset + size - 1);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range_str);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sim_direct_write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &dst);
+    curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return dst - buf;
+}
+
+/*---#并发读取------------------------------------------------------------*/
+typedef struct
+{
+    char            url[HLS_HTTP_URL_LEN];
+    long long       offset;
+    int             size;
+    int             ret;
+    int             ok;
+    pthread_barrier_t *barrier;
+}sim_reader_t;
+
+static void *sim_reader_proc(void *arg)
+{
+    sim_reader_t *r = (sim_reader_t *)arg;
+    char *buf = (char *)malloc(r->size);
+
+    pthread_barrier_wait(r->barrier);
+    r->ret = hls_http_cache_read(r->url, buf, r->offset, r->size, 0);
+    r->ok = (r->ret == r->size && 0 == memcmp(buf, sim_file + r->offset, r->size));
+    free(buf);
+    return NULL;
+}
+
+/*n 个线程同时读，返回总耗时（毫秒）*/
+static int sim_concurrent(sim_reader_t *r, int n)
+{
+    pthread_t tid[8];
+    pthread_barrier_t barrier;
+    HLE_U64 t0;
+    int i;
+
+    pthread_barrier_init(&barrier, NULL, n + 1);
+    for (i = 0; i < n; i++)
+    {
+        r[i].barrier = &barrier;
+        pthread_create(&tid[i], NULL, sim_reader_proc, &r[i]);
+    }
+    t0 = sim_now_us();
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < n; i++)
+        pthread_join(tid[i], NULL);
+    pthread_barrier_destroy(&barrier);
+    return (int)((sim_now_us() - t0) / 1000);
+}
+
+/*---#顺序扫描（解析 fMP4 时的访问方式：逐个 box 头的小读 + 样本数据的大读）---------------*/
+static double sim_scan(const char *url, int direct, int *reads)
+{
+    static char buf[64 * 1024];
+    long long pos = 0;
+    HLE_U64 t0 = sim_now_us();
+    int n = 0;
+
+    while (pos < SIM_FILE_SIZE)
+    {
+        int size = (n & 1) ? 8 : 12 * 1024;     //box 头 + 样本
+        if (pos + size > SIM_FILE_SIZE)
+            size = SIM_FILE_SIZE - pos;
+        if (direct)
+            sim_direct_read(url, buf, pos, size);
+        else
+            hls_http_cache_read(url, buf, pos, size, 0);
+        if (memcmp(buf, sim_file + pos, size))
+            sim_errors++;
+        pos += size;
+        n++;
+    }
+    *reads = n;
+    return (sim_now_us() - t0) / 1000.0;
+}
+
+int main(void)
+{
+    static char buf[64 * 1024];
+    hls_http_cache_stat_t st0, st;
+    sim_reader_t r[8];
+    char url[HLS_HTTP_URL_LEN];
+    char target[sizeof (srv.last_target)];
+    char path[32];
+    int i, n, ms, req0, reads;
+    double t_direct, t_cache;
+
+    for (i = 0; i < SIM_FILE_SIZE; i++)
+        sim_file[i] = (char)(i ^ (i >> 8) ^ (i >> 16));
+    if (sim_server_start() < 0)
+    {
+        printf("start server failed: %s\n", strerror(errno));
+        return 1;
+    }
+    SIM_CHECK(0 == hls_http_cache_init());
+
+    /*1.首次访问不带 access=server；之后的请求带上（URL 已有查询串时用 &）*/
+    sim_url(url, sizeof (url), "/a.mp4");
+    SIM_CHECK(SIM_FILE_SIZE == hls_http_cache_get_size(url, HLS_HTTP_FIRST_ACCESS));
+    sim_last_target(target);
+    SIM_CHECK(0 == strcmp(target, "/a.mp4"));
+    SIM_CHECK(100 == hls_http_cache_read(url, buf, 500 * 1000, 100, 0));
+    sim_last_target(target);
+    SIM_CHECK(0 == strcmp(target, "/a.mp4?access=server"));
+    sim_url(url, sizeof (url), "/q.mp4?token=1");
+    SIM_CHECK(10 == hls_http_cache_read(url, buf, 0, 10, 0));
+    sim_last_target(target);
+    SIM_CHECK(0 == strcmp(target, "/q.mp4?token=1&access=server"));
+
+    /*2.随机读与源文件一致，文件末尾返回短读*/
+    sim_url(url, sizeof (url), "/a.mp4");
+    srand(1);
+    for (i = 0; i < 2000; i++)
+    {
+        long long off = rand() % SIM_FILE_SIZE;
+        int size = 1 + rand() % (int)sizeof (buf);
+        int expect = off + size > SIM_FILE_SIZE ? SIM_FILE_SIZE - off : size;
+        n = hls_http_cache_read(url, buf, off, size, 0);
+        if (n != expect || memcmp(buf, sim_file + off, expect))
+        {
+            printf("FAIL random read off %lld size %d -> %d (expect %d)\n", off, size, n, expect);
+            sim_errors++;
+            break;
+        }
+    }
+    SIM_CHECK(10 == hls_http_cache_read(url, buf, SIM_FILE_SIZE - 10, 100, 0));
+    SIM_CHECK(hls_http_cache_read(url, buf, SIM_FILE_SIZE + HLS_HTTP_CACHE_BLOCK_SIZE, 100, 0) <= 0);
+
+    /*3.顺序读：合并 + 预读，请求数约为 文件大小 / (块大小 * 合并块数)，连接全部复用*/
+    hls_http_cache_invalidate(url);
+    hls_http_cache_get_stat(&st0);
+    req0 = srv.connections;
+    for (i = 0; i < SIM_FILE_SIZE; i += 4096)
+        SIM_CHECK(hls_http_cache_read(url, buf, i, 4096, 0) == (i + 4096 > SIM_FILE_SIZE ? SIM_FILE_SIZE - i : 4096));
+    hls_http_cache_get_stat(&st);
+    printf("sequential 4K reads: %u reads, %u requests, %u new connections, %lld bytes fetched\n",
+           st.read_calls - st0.read_calls, st.requests - st0.requests, srv.connections - req0,
+           st.bytes_fetched - st0.bytes_fetched);
+    SIM_CHECK(st.requests - st0.requests <= SIM_FILE_SIZE / (HLS_HTTP_CACHE_BLOCK_SIZE * HLS_HTTP_MAX_COALESCE) + 2);
+    SIM_CHECK(srv.connections - req0 == 0);
+    SIM_CHECK(srv.connections <= HLS_HTTP_HANDLE_NUM);
+
+    /*4.不同块的请求并行：两个 URL 各读一个未缓存的块，耗时接近一个请求的时延*/
+    srv.delay_ms = 200;
+    memset(r, 0, sizeof (r));
+    for (i = 0; i < 2; i++)
+    {
+        snprintf(path, sizeof (path), "/c%d.mp4", i);
+        sim_url(r[i].url, sizeof (r[i].url), path);
+        r[i].offset = 100 * 1000;
+        r[i].size = 1000;
+    }
+    ms = sim_concurrent(r, 2);
+    printf("2 readers, different blocks, %d ms server delay: %d ms\n", srv.delay_ms, ms);
+    SIM_CHECK(r[0].ok && r[1].ok);
+    SIM_CHECK(ms < srv.delay_ms * 3 / 2);
+
+    /*5.多个线程读同一个未缓存的块：只发一个请求，其余等待该块加载完成*/
+    req0 = srv.requests;
+    hls_http_cache_get_stat(&st0);
+    memset(r, 0, sizeof (r));
+    for (i = 0; i < 4; i++)
+    {
+        sim_url(r[i].url, sizeof (r[i].url), "/d.mp4");
+        r[i].offset = 300 * 1000 + i * 100;
+        r[i].size = 100;
+    }
+    ms = sim_concurrent(r, 4);
+    hls_http_cache_get_stat(&st);
+    printf("4 readers, same block, %d ms server delay: %d ms, %d requests, %u waits\n",
+           srv.delay_ms, ms, srv.requests - req0, st.block_waits - st0.block_waits);
+    for (i = 0; i < 4; i++)
+        SIM_CHECK(r[i].ok);
+    SIM_CHECK(1 == srv.requests - req0);
+    SIM_CHECK(st.block_waits - st0.block_waits >= 3);
+    srv.delay_ms = 0;
+
+    /*6.请求失败：返回 -1，块被释放，重试仍然失败而不是挂住*/
+    sim_url(url, sizeof (url), "/missing.mp4");
+    SIM_CHECK(-1 == hls_http_cache_read(url, buf, 0, 100, 0));
+    SIM_CHECK(-1 == hls_http_cache_get_size(url, HLS_HTTP_FIRST_ACCESS));
+    for (i = 0; i < HLS_HTTP_CACHE_BLOCKS; i++)
+        SIM_CHECK(cache_ctx.block[i].state != BLOCK_LOADING);
+
+    /*7.基准：模拟 fMP4 解析的顺序扫描，对比每次读新建连接的直接请求*/
+    for (i = 0; i < 2; i++)
+    {
+        srv.delay_ms = i ? 2 : 0;
+        sim_url(url, sizeof (url), i ? "/bench1.mp4" : "/bench0.mp4");
+        t_direct = sim_scan(url, 1, &reads);
+        t_cache = sim_scan(url, 0, &reads);
+        printf("scan %d bytes in %d reads, server delay %d ms: direct %.1f ms (%.1f us/read, %.1f MB/s), "
+               "cached %.1f ms (%.1f us/read, %.1f MB/s), x%.1f\n",
+               SIM_FILE_SIZE, reads, srv.delay_ms,
+               t_direct, t_direct * 1000 / reads, SIM_FILE_SIZE / t_direct / 1000,
+               t_cache, t_cache * 1000 / reads, SIM_FILE_SIZE / t_cache / 1000, t_direct / t_cache);
+        SIM_CHECK(t_cache < t_direct);
+    }
+    /*命中时的读时延*/
+    {
+        HLE_U64 t0 = sim_now_us();
+        for (i = 0; i < 10000; i++)
+            hls_http_cache_read(url, buf, (i * 4099LL) % (SIM_FILE_SIZE - 64), 64, 0);
+        printf("warm 64-byte read: %.2f us\n", (sim_now_us() - t0) / 10000.0);
+    }
+    srv.delay_ms = 0;
+
+    hls_http_cache_get_stat(&st);
+    printf("total: reads %u hits %u misses %u waits %u requests %u connects %u bytes %lld\n",
+           st.read_calls, st.block_hits, st.block_misses, st.block_waits, st.requests, st.connects, st.bytes_fetched);
+    hls_http_cache_exit();
+    SIM_CHECK(-1 == hls_http_cache_read(url, buf, 0, 10, 0));
+    /*exit 后可以重新初始化*/
+    SIM_CHECK(0 == hls_http_cache_init());
+    SIM_CHECK(10 == hls_http_cache_read(url, buf, 0, 10, 0) && 0 == memcmp(buf, sim_file, 10));
+    hls_http_cache_exit();
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+/***************************************************************************
+* @file: test_hls_media_mp4.c
+* @author:
+* @date:  10,19,2026
+* @brief:  fMP4 sample 表的主机测试：trun sample_count 越界、扩容溢出、.stbl 缓存过期
+* @attention:直接包含 hls_media_mp4.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "hls_media_mp4.c"
+
+#include <utime.h>
+
+#define SIM_MP4_PATH    "/tmp/test_hls_mp4.mp4"
+#define SIM_V_TRAK      1
+#define SIM_A_TRAK      2
+#define SIM_TFHD_POS    16
+#define SIM_TFDT_POS    64
+#define SIM_TRUN_POS    128
+#define SIM_MP4_SIZE    4096
+
+static unsigned char sim_mp4[SIM_MP4_SIZE];
+static int sim_reads;
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+static void sim_put32(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static int sim_read(FILE_info_t *mp4_file, file_handle_t *handler, void *buf, int size, int offset, int flags)
+{
+    sim_reads++;
+    if (offset < 0 || offset >= SIM_MP4_SIZE)
+        return 0;
+    if (size > SIM_MP4_SIZE - offset)
+        size = SIM_MP4_SIZE - offset;
+    memcpy(buf, sim_mp4 + offset, size);
+    return size;
+}
+
+static int sim_get_file_size(FILE_info_t *mp4_file, file_handle_t *handler, int flags)
+{
+    return SIM_MP4_SIZE;
+}
+
+/*moof-->traf-->tfhd/tfdt/trun，box 内容在 sim_mp4 中*/
+static MP4_BOX sim_root, sim_moof, sim_traf, sim_tfhd, sim_tfdt, sim_trun;
+
+static void sim_box(MP4_BOX *box, MP4_BOX *parent, const char *type, int pos, int size)
+{
+    memset(box, 0, sizeof (*box));
+    memcpy(box->box_type, type, 4);
+    box->box_first_byte = pos;
+    box->box_size = size;
+    box->parent = parent;
+    if (parent)
+        parent->child_ptr[parent->child_count++] = box;
+}
+
+/*
+tfhd 带 default_sample_duration（和可选的 default_sample_size），trun 带 data_offset
+@entries：trun 中实际写入的 sample 个数，每个 sample 的字段由 tr_flags 决定
+*/
+static void sim_build(int track_id, unsigned int default_size, unsigned int tr_flags, unsigned int count, int entries)
+{
+    unsigned char *p;
+    int i, trun_size;
+
+    memset(sim_mp4, 0, sizeof (sim_mp4));
+    sim_box(&sim_root, NULL, "root", 0, SIM_MP4_SIZE);
+    sim_box(&sim_moof, &sim_root, "moof", 0, SIM_TRUN_POS);
+    sim_box(&sim_traf, &sim_moof, "traf", 8, SIM_TRUN_POS);
+
+    p = sim_mp4 + SIM_TFHD_POS;
+    memcpy(p + 4, "tfhd", 4);
+    sim_put32(p + 8, TFHD_DEFAULT_SAMPLE_DURATION | (default_size ? TFHD_DEFAULT_SAMPLE_SIZE : 0));
+    sim_put32(p + 12, track_id);
+    sim_put32(p + 16, 3000);
+    sim_put32(p + 20, default_size);
+    sim_box(&sim_tfhd, &sim_traf, "tfhd", SIM_TFHD_POS, default_size ? 24 : 20);
+
+    p = sim_mp4 + SIM_TFDT_POS;
+    p[8] = 1;
+    sim_put32(p + 16, 90000);
+    sim_box(&sim_tfdt, &sim_traf, "tfdt", SIM_TFDT_POS, 20);
+
+    p = sim_mp4 + SIM_TRUN_POS;
+    sim_put32(p + 8, tr_flags | E_data_offset);
+    sim_put32(p + 12, count);
+    sim_put32(p + 16, 1024);
+    p += 20;
+    for (i = 0; i < entries; i++)
+    {
+        if (tr_flags & E_sample_size)       { sim_put32(p, 100 + i); p += 4; }
+        if (tr_flags & E_sample_flags)      { sim_put32(p, i ? 0x01010000 : 0x02000000); p += 4; }
+    }
+    trun_size = p - (sim_mp4 + SIM_TRUN_POS);
+    sim_put32(sim_mp4 + SIM_TRUN_POS, trun_size);
+    sim_box(&sim_trun, &sim_traf, "trun", SIM_TRUN_POS, trun_size);
+}
+
+static file_source_t sim_source = {NULL, sim_read, sim_get_file_size, NULL, NULL, 0};
+
+static int sim_init(FILE_info_t *mp4_file)
+{
+    free_sample_table();
+    sim_reads = 0;
+    return init_sample_table(mp4_file, NULL, (file_handle_t *)1, &sim_source, &sim_root);
+}
+
+static void sim_write_mp4(time_t mtime)
+{
+    struct utimbuf ut;
+    FILE *fp = fopen(SIM_MP4_PATH, "wb");
+
+    if (fp)
+    {
+        fwrite(sim_mp4, 1, sizeof (sim_mp4), fp);
+        fclose(fp);
+    }
+    ut.actime = ut.modtime = mtime;
+    utime(SIM_MP4_PATH, &ut);
+}
+
+int main(void)
+{
+    FILE_info_t mp4_file;
+    sample_table_t tab;
+    unsigned int cap;
+    time_t now = time(NULL);
+
+    memset(&mp4_file, 0, sizeof (mp4_file));
+    strcpy(mp4_file.file_name, SIM_MP4_PATH);
+    set_video_trak_id(SIM_V_TRAK);
+    set_audio_trak_id(SIM_A_TRAK);
+    set_run_mode(HLS_FILE_MODE);
+    remove(SIM_MP4_PATH SAMPLE_TABLE_POSTFIX);
+
+    /*1.正常的 trun：10 个视频帧，建表并保存 .stbl*/
+    sim_build(SIM_V_TRAK, 0, E_sample_size | E_sample_flags, 10, 10);
+    sim_write_mp4(now - 100);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(10 == sample_table.V_sample_num && 0 == sample_table.A_sample_num);
+    SIM_CHECK(1024 == sample_table.V_offset[0] && 1124 == sample_table.V_offset[1] && 109 == sample_table.V_size[9]);
+    SIM_CHECK(0 == sample_table.V_dts[0] && 27000 == sample_table.V_dts[9]);
+    SIM_CHECK(0 == access(SIM_MP4_PATH SAMPLE_TABLE_POSTFIX, F_OK));
+    printf("build: %d reads, video(%u)\n", sim_reads, sample_table.V_sample_num);
+
+    /*2.源文件没变：直接加载 .stbl，不读 trun*/
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(0 == sim_reads && 10 == sample_table.V_sample_num && 109 == sample_table.V_size[9]);
+
+    /*3.同名文件被覆盖（大小不变，修改时间不同）：.stbl 过期，重新解析*/
+    sim_build(SIM_V_TRAK, 0, E_sample_size | E_sample_flags, 8, 8);
+    sim_write_mp4(now - 50);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(sim_reads > 0 && 8 == sample_table.V_sample_num && 107 == sample_table.V_size[7]);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(0 == sim_reads && 8 == sample_table.V_sample_num);
+    remove(SIM_MP4_PATH SAMPLE_TABLE_POSTFIX);
+    set_run_mode(HLS_MEMO_MODE);
+
+    /*4.sample_count 远大于 trun 中的实际数据：按 box 大小截断，不会越界或按 count 分配*/
+    sim_build(SIM_V_TRAK, 0, E_sample_size | E_sample_flags, 0xFFFFFFFF, 10);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(10 == sample_table.V_sample_num && SAMPLE_TABLE_INIT_NUM >= sample_table.V_capacity);
+
+    sim_build(SIM_A_TRAK, 0, E_sample_size, 0x80000001, 5);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(5 == sample_table.A_sample_num && 104 == sample_table.A_size[4]);
+
+    /*5.所有字段都用默认值的 trun：按文件大小 / default_sample_size 截断*/
+    sim_build(SIM_A_TRAK, 64, 0, 0xFFFFFFF0, 0);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(SIM_MP4_SIZE / 64 == sample_table.A_sample_num && 64 == sample_table.A_size[0]);
+
+    /*6.没有默认大小也没有逐帧字段：每个 sample 按 1 字节算，不超过文件大小*/
+    sim_build(SIM_A_TRAK, 0, 0, 0xFFFFFFFF, 0);
+    SIM_CHECK(0 == sim_init(&mp4_file));
+    SIM_CHECK(SIM_MP4_SIZE == sample_table.A_sample_num);
+
+    /*7.容量计算不回绕：V_sample_num + V_add 溢出、容量翻倍到 0 都返回失败*/
+    memset(&tab, 0, sizeof (tab));
+    tab.V_sample_num = 100;
+    SIM_CHECK(sample_table_reserve(NULL, &tab, 0xFFFFFFF0, 0) < 0 && NULL == tab.block);
+    SIM_CHECK(sample_table_reserve(NULL, &tab, 0, SAMPLE_TABLE_MAX_NUM + 1) < 0 && NULL == tab.block);
+    cap = 0x80000000;
+    SIM_CHECK(sample_table_grow(0, 0x80000001, &cap) < 0);
+    cap = 3 << 22;
+    SIM_CHECK(0 == sample_table_grow(SAMPLE_TABLE_MAX_NUM - 1, 1, &cap) && SAMPLE_TABLE_MAX_NUM == cap);
+    cap = 0;
+    SIM_CHECK(0 == sample_table_grow(0, 513, &cap) && 1024 == cap);
+    SIM_CHECK(0 == sample_table_reserve(NULL, &tab, 1, 1) && tab.block && 512 == tab.A_capacity);
+    free(tab.block);
+
+    free_sample_table();
+    remove(SIM_MP4_PATH);
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,329 @@
+/***************************************************************************
+* @file: test_https_post.c
+* @author:
+* @date:  10,19,2026
+* @brief:  https_post 连接池的主机测试和基准：keep-alive 复用、会话恢复、失效连接重连、多线程统计
+* @attention:直接包含 https_post.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	1.服务端在本进程内（127.0.0.1，自签名证书，TLS1.2 与 S3 一致）。
+	2.url 为 /close 时服务端回 Connection: close 并断开，/drop 时回 keep-alive 但随后断开。
+	3.基准只打印每个请求的平均耗时，不作为通过条件（SAN=thread 时会慢很多）。
+***************************************************************************/
+#include "https_post.c"
+
+#include <sys/socket.h>
+#include <signal.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#define SIM_HOST        "127.0.0.1"
+#define SIM_THREADS     HTTPS_POOL_SIZE
+#define SIM_THREAD_REQS 100
+#define SIM_BENCH_REQS  200
+
+typedef struct _sim_server_t
+{
+    SSL_CTX *ctx;
+    int listen_fd;
+    int port;
+    int accepts;            //接受的 TCP 连接数
+    int requests;           //处理的请求数
+}sim_server_t;
+
+static sim_server_t sim_srv;        //允许会话恢复
+static sim_server_t sim_srv_full;   //每个连接都是完整握手（模拟原来的实现）
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*自签名证书（EC P-256，生成比 RSA 快）*/
+static SSL_CTX *sim_server_ctx(int resume)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY *pkey = EVP_EC_gen("P-256");
+    X509 *x509 = X509_new();
+    X509_NAME *name;
+
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)SIM_HOST, -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    X509_sign(x509, pkey, EVP_sha256());
+
+    SSL_CTX_use_certificate(ctx, x509);
+    SSL_CTX_use_PrivateKey(ctx, pkey);
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char *)"sim", 3);
+    if (!resume)
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return ctx;
+}
+
+/*读一个请求（头 + Content-Length 的 body），返回请求类型：'c' /close，'d' /drop，0 其他，连接出错 -1*/
+static int sim_read_request(SSL *ssl, int *body_len)
+{
+    char buf[4096];
+    int len = 0, re, content_len = 0;
+    char *end, *p;
+
+    for (;;)
+    {
+        re = SSL_read(ssl, buf + len, sizeof (buf) - 1 - len);
+        if (re <= 0)
+            return -1;
+        len += re;
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+        if (end)
+            break;
+        if (len >= (int)sizeof (buf) - 1)
+            return -1;
+    }
+    p = strcasestr(buf, "Content-Length:");
+    if (p)
+        content_len = atoi(p + 15);
+    *body_len = content_len;
+    /*body 剩余部分*/
+    content_len -= len - (end + 4 - buf);
+    while (content_len > 0)
+    {
+        re = SSL_read(ssl, buf, content_len < (int)sizeof (buf) ? content_len : (int)sizeof (buf));
+        if (re <= 0)
+            return -1;
+        content_len -= re;
+    }
+    if (0 == strncmp(buf, "POST /close", 11))
+        return 'c';
+    if (0 == strncmp(buf, "POST /drop", 10))
+        return 'd';
+    return 0;
+}
+
+typedef struct _sim_conn_arg_t
+{
+    sim_server_t *srv;
+    int fd;
+}sim_conn_arg_t;
+
+static void *sim_conn_thread(void *arg)
+{
+    sim_conn_arg_t *a = (sim_conn_arg_t *)arg;
+    SSL *ssl = SSL_new(a->srv->ctx);
+
+    SSL_set_fd(ssl, a->fd);
+    if (SSL_accept(ssl) == 1)
+    {
+        for (;;)
+        {
+            char resp[256], body[64];
+            int body_len = 0, bl;
+            int type = sim_read_request(ssl, &body_len);
+
+            if (type < 0)
+                break;
+            __atomic_fetch_add(&a->srv->requests, 1, __ATOMIC_RELAXED);
+            bl = snprintf(body, sizeof (body), "{\"ok\":1,\"len\":%d}", body_len);
+            snprintf(resp, sizeof (resp), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %d\r\nConnection: %s\r\n\r\n%s", bl, type == 'c' ? "close" : "keep-alive", body);
+            if (SSL_write(ssl, resp, strlen(resp)) <= 0 || type)
+                break;
+        }
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(a->fd);
+    free(a);
+    return NULL;
+}
+
+static void *sim_accept_thread(void *arg)
+{
+    sim_server_t *srv = (sim_server_t *)arg;
+
+    for (;;)
+    {
+        pthread_t tid;
+        sim_conn_arg_t *a;
+        int fd = accept(srv->listen_fd, NULL, NULL);
+
+        if (fd < 0)
+            break;
+        __atomic_fetch_add(&srv->accepts, 1, __ATOMIC_RELAXED);
+        a = (sim_conn_arg_t *)malloc(sizeof (*a));
+        a->srv = srv;
+        a->fd = fd;
+        pthread_create(&tid, NULL, sim_conn_thread, a);
+        pthread_detach(tid);
+    }
+    return NULL;
+}
+
+static int sim_server_start(sim_server_t *srv, int resume)
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof (addr);
+    pthread_t tid;
+    int on = 1;
+
+    srv->ctx = sim_server_ctx(resume);
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+    memset(&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof (addr)) < 0 || listen(srv->listen_fd, 16) < 0)
+        return -1;
+    getsockname(srv->listen_fd, (struct sockaddr *)&addr, &alen);
+    srv->port = ntohs(addr.sin_port);
+    pthread_create(&tid, NULL, sim_accept_thread, srv);
+    pthread_detach(tid);
+    return 0;
+}
+
+static const char sim_json[] = "{\"device_id\":\"HLE0000000001\",\"event\":\"motion\",\"ts\":1760860800}";
+
+static int sim_post(sim_server_t *srv, char *url)
+{
+    char buff[128];
+    int ret = https_post(SIM_HOST, srv->port, url, NULL, sim_json, strlen(sim_json), buff, sizeof (buff));
+    char expect[64];
+
+    snprintf(expect, sizeof (expect), "{\"ok\":1,\"len\":%d}", (int)strlen(sim_json));
+    if (ret != (int)strlen(expect) || strcmp(buff, expect))
+        return -1;
+    return 0;
+}
+
+static void sim_stat(https_stat_t *stat)
+{
+    stat->handshakes = __atomic_load_n(&https_stat.handshakes, __ATOMIC_RELAXED);
+    stat->resumed = __atomic_load_n(&https_stat.resumed, __ATOMIC_RELAXED);
+    stat->reused = __atomic_load_n(&https_stat.reused, __ATOMIC_RELAXED);
+}
+
+static double sim_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void *sim_post_thread(void *arg)
+{
+    int i, *fails = (int *)arg;
+
+    for (i = 0; i < SIM_THREAD_REQS; i++)
+    {
+        if (sim_post(&sim_srv, "/event") < 0)
+            (*fails)++;
+    }
+    return NULL;
+}
+
+/*关闭池中所有空闲连接（下一个请求新建连接）*/
+static void sim_pool_drop(void)
+{
+    int i;
+    for (i = 0; i < HTTPS_POOL_SIZE; i++)
+    {
+        if (conn_pool[i].ssl && !conn_pool[i].busy)
+        {
+            conn_pool[i].busy = 1;
+            conn_close(&conn_pool[i]);
+        }
+    }
+}
+
+int main(void)
+{
+    https_stat_t st0, st1;
+    pthread_t tid[SIM_THREADS];
+    int fails[SIM_THREADS] = {0};
+    char snap[METRICS_JSON_MAX];
+    double t0, ms_full, ms_resume, ms_pool;
+    int i, accepts;
+
+    signal(SIGPIPE, SIG_IGN);
+    SIM_CHECK(0 == sim_server_start(&sim_srv, 1));
+    SIM_CHECK(0 == sim_server_start(&sim_srv_full, 0));
+
+    /*1.连续请求复用一条连接：一次完整握手*/
+    for (i = 0; i < 20; i++)
+        SIM_CHECK(0 == sim_post(&sim_srv, "/event"));
+    sim_stat(&st0);
+    SIM_CHECK(1 == st0.handshakes && 0 == st0.resumed && 19 == st0.reused);
+    SIM_CHECK(1 == sim_srv.accepts && 20 == sim_srv.requests);
+
+    /*2.服务端 Connection: close：连接不放回池，下一次新建连接并恢复会话*/
+    SIM_CHECK(0 == sim_post(&sim_srv, "/close"));
+    SIM_CHECK(0 == sim_post(&sim_srv, "/event"));
+    sim_stat(&st1);
+    SIM_CHECK(1 == st1.handshakes - st0.handshakes && 1 == st1.resumed - st0.resumed);
+    SIM_CHECK(2 == sim_srv.accepts);
+
+    /*3.服务端在 keep-alive 之后断开：复用前探测到连接失效，换新连接*/
+    SIM_CHECK(0 == sim_post(&sim_srv, "/drop"));
+    usleep(50 * 1000);
+    st0 = st1;
+    SIM_CHECK(0 == sim_post(&sim_srv, "/event"));
+    sim_stat(&st1);
+    SIM_CHECK(1 == st1.handshakes - st0.handshakes && 1 == st1.resumed - st0.resumed);
+    SIM_CHECK(3 == sim_srv.accepts);
+
+    /*4.多线程：统计是原子更新的，握手次数 + 复用次数 = 请求数*/
+    sim_stat(&st0);
+    accepts = sim_srv.accepts;
+    for (i = 0; i < SIM_THREADS; i++)
+        pthread_create(&tid[i], NULL, sim_post_thread, &fails[i]);
+    for (i = 0; i < SIM_THREADS; i++)
+    {
+        pthread_join(tid[i], NULL);
+        SIM_CHECK(0 == fails[i]);
+    }
+    sim_stat(&st1);
+    SIM_CHECK(SIM_THREADS * SIM_THREAD_REQS == (st1.handshakes - st0.handshakes) + (st1.reused - st0.reused));
+    SIM_CHECK(st1.handshakes - st0.handshakes == (unsigned int)(sim_srv.accepts - accepts));
+    SIM_CHECK(st1.handshakes - st0.handshakes <= SIM_THREADS);
+    printf("threads: %d x %d requests, %u handshakes, %u reused\n", SIM_THREADS, SIM_THREAD_REQS,
+           st1.handshakes - st0.handshakes, st1.reused - st0.reused);
+
+    /*5.metrics 快照中有 "https" 对象*/
+    SIM_CHECK(metrics_snapshot(snap, sizeof (snap)) > 0);
+    SIM_CHECK(NULL != strstr(snap, "\"https\":{\"handshakes\":"));
+
+    /*6.基准：每次完整握手（原来的实现）/ 每次新连接但恢复会话 / 连接池复用*/
+    t0 = sim_now_ms();
+    for (i = 0; i < SIM_BENCH_REQS; i++)
+        SIM_CHECK(0 == sim_post(&sim_srv_full, "/close"));
+    ms_full = (sim_now_ms() - t0) / SIM_BENCH_REQS;
+
+    sim_pool_drop();
+    sim_stat(&st0);
+    t0 = sim_now_ms();
+    for (i = 0; i < SIM_BENCH_REQS; i++)
+        SIM_CHECK(0 == sim_post(&sim_srv, "/close"));
+    ms_resume = (sim_now_ms() - t0) / SIM_BENCH_REQS;
+    sim_stat(&st1);
+    SIM_CHECK(SIM_BENCH_REQS == st1.resumed - st0.resumed);
+
+    sim_pool_drop();
+    t0 = sim_now_ms();
+    for (i = 0; i < SIM_BENCH_REQS; i++)
+        SIM_CHECK(0 == sim_post(&sim_srv, "/event"));
+    ms_pool = (sim_now_ms() - t0) / SIM_BENCH_REQS;
+
+    printf("bench: %d small JSON POSTs over loopback\n", SIM_BENCH_REQS);
+    printf("  full handshake each      %.3f ms/req\n", ms_full);
+    printf("  new connection, resumed  %.3f ms/req\n", ms_resume);
+    printf("  pooled keep-alive        %.3f ms/req\n", ms_pool);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
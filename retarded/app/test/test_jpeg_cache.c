@@ -0,0 +1,172 @@
+/***************************************************************************
+* @file: test_jpeg_cache.c
+* @author:
+* @date:  10,19,2026
+* @brief:  JPEG 抓拍缓存的主机测试：请求合并、新鲜度、编码失败
+* @attention:直接包含 jpeg_cache.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "jpeg_cache.c"
+
+#define SIM_ENCODE_MS   150     //模拟一次 JPEG 通道的配置 + 启动 + 取帧 + 停止
+#define SIM_JPEG_SIZE   (200*1024)
+
+static int sim_encodes;
+static int sim_fail;
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*模拟编码：图片内容为编码序号*/
+static char *sim_encode(int channel, int *size, int image_size)
+{
+    char *data;
+    int n = __sync_add_and_fetch(&sim_encodes, 1);
+
+    usleep(SIM_ENCODE_MS * 1000);
+    if (sim_fail)
+        return NULL;
+
+    data = (char *)malloc(SIM_JPEG_SIZE);
+    memset(data, n, SIM_JPEG_SIZE);
+    *size = SIM_JPEG_SIZE;
+    return data;
+}
+
+typedef struct
+{
+    int max_age_ms;
+    int period_ms;
+    int count;
+    int got[64];
+    HLE_U32 max_ms;
+}sim_client_t;
+
+static void *sim_client(void *arg)
+{
+    sim_client_t *c = (sim_client_t *)arg;
+    HLE_U32 t0, used;
+    char *jpg;
+    int i, size;
+
+    for (i = 0; i < c->count; i++)
+    {
+        t0 = jcache_now_ms();
+        jpg = jpeg_cache_request(0, IMAGE_SIZE_1920x1080, c->max_age_ms, &size, NULL);
+        used = jcache_now_ms() - t0;
+        if (used > c->max_ms)
+            c->max_ms = used;
+        c->got[i] = jpg ? jpg[size - 1] : -1;
+        free(jpg);
+        if (c->period_ms)
+            usleep(c->period_ms * 1000);
+    }
+    return NULL;
+}
+
+static void sim_print(const char *name)
+{
+    jpeg_cache_stat_t st;
+
+    jpeg_cache_get_stat(&st, 1);
+    printf("%-28s requests %3u hits %3u merged %3u misses %3u failures %u, encode avg %u max %u ms\n",
+           name, st.requests, st.hits, st.merged, st.misses, st.failures, st.avg_encode_ms, st.max_encode_ms);
+}
+
+int main(void)
+{
+    pthread_t tid[8];
+    sim_client_t c[8];
+    jpeg_cache_stat_t st;
+    HLE_U32 t0;
+    char *jpg;
+    int i, size, before;
+
+    jpeg_cache_init(sim_encode);
+
+    /*1.8 个请求同时到达：只编码一次，都拿到同一张图*/
+    memset(c, 0, sizeof (c));
+    for (i = 0; i < 8; i++)
+    {
+        c[i].max_age_ms = 0;
+        c[i].count = 1;
+        pthread_create(&tid[i], NULL, sim_client, &c[i]);
+    }
+    for (i = 0; i < 8; i++)
+        pthread_join(tid[i], NULL);
+    jpeg_cache_get_stat(&st, 0);
+    sim_print("8 concurrent (max_age 0):");
+    SIM_CHECK(1 == sim_encodes && 1 == st.misses && 7 == st.merged);
+    for (i = 0; i < 8; i++)
+        SIM_CHECK(1 == c[i].got[0]);
+
+    /*2.新鲜度窗口内命中，不调用编码；过期后重新编码*/
+    t0 = jcache_now_ms();
+    jpg = jpeg_cache_request(0, IMAGE_SIZE_1920x1080, 1000, &size, NULL);
+    SIM_CHECK(jpg && SIM_JPEG_SIZE == size && 1 == jpg[0] && jcache_now_ms() - t0 < 50);
+    free(jpg);
+    usleep(300 * 1000);
+    jpg = jpeg_cache_request(0, IMAGE_SIZE_1920x1080, 200, &size, NULL);
+    SIM_CHECK(jpg && 2 == jpg[0]);
+    free(jpg);
+    jpeg_cache_get_stat(&st, 0);
+    sim_print("fresh hit, then expired:");
+    SIM_CHECK(1 == st.hits && 1 == st.misses && 2 == sim_encodes);
+
+    /*3.分辨率分开缓存*/
+    jpg = jpeg_cache_request(0, IMAGE_SIZE_960x544, 1000, &size, NULL);
+    SIM_CHECK(jpg && 3 == jpg[0]);
+    free(jpg);
+    jpg = jpeg_cache_request(0, IMAGE_SIZE_1920x1080, 1000, &size, NULL);
+    SIM_CHECK(jpg && 2 == jpg[0]);
+    free(jpg);
+    sim_print("per resolution:");
+
+    /*4.编码失败：等待者都返回 NULL，之后的请求重新编码*/
+    sim_fail = 1;
+    for (i = 0; i < 4; i++)
+    {
+        memset(&c[i], 0, sizeof (c[i]));
+        c[i].count = 1;
+        pthread_create(&tid[i], NULL, sim_client, &c[i]);
+    }
+    for (i = 0; i < 4; i++)
+    {
+        pthread_join(tid[i], NULL);
+        SIM_CHECK(-1 == c[i].got[0]);
+    }
+    jpeg_cache_get_stat(&st, 0);
+    sim_print("encoder failure:");
+    SIM_CHECK(1 == st.failures && 3 == st.merged);
+    sim_fail = 0;
+
+    /*5.三类调用者：告警推送（每 400ms，窗口 1s）、APP 缩略图（每 250ms，窗口 2s）、云端预览（每 1s，窗口 0）*/
+    before = sim_encodes;
+    memset(c, 0, sizeof (c));
+    c[0].max_age_ms = 1000;
+    c[0].period_ms = 400;
+    c[0].count = 10;
+    c[1].max_age_ms = 2000;
+    c[1].period_ms = 250;
+    c[1].count = 16;
+    c[2].max_age_ms = 0;
+    c[2].period_ms = 1000;
+    c[2].count = 4;
+    t0 = jcache_now_ms();
+    for (i = 0; i < 3; i++)
+        pthread_create(&tid[i], NULL, sim_client, &c[i]);
+    for (i = 0; i < 3; i++)
+        pthread_join(tid[i], NULL);
+    jpeg_cache_get_stat(&st, 0);
+    sim_print("mixed callers (4.5 s):");
+    printf("  %d requests -> %d encodes in %u ms (uncached: %d x %d ms), worst wait %u/%u/%u ms\n",
+           c[0].count + c[1].count + c[2].count, sim_encodes - before, jcache_now_ms() - t0,
+           c[0].count + c[1].count + c[2].count, SIM_ENCODE_MS, c[0].max_ms, c[1].max_ms, c[2].max_ms);
+    SIM_CHECK(sim_encodes - before < (c[0].count + c[1].count + c[2].count) / 2);
+    for (i = 0; i < c[0].count; i++)
+        SIM_CHECK(c[0].got[i] > 0);
+
+    jpeg_cache_exit();
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
+
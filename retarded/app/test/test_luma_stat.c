@@ -0,0 +1,365 @@
+/***************************************************************************
+* @file: test_luma_stat.c
+* @author:
+* @date:  10,19,2026
+* @brief:  亮度统计的主机测试：与参考实现比对、场景判决、耗时
+* @attention:直接包含 luma_stat.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "luma_stat.c"
+
+/*
+1.不带参数：
+  a.与逐像素参考实现比对（任意宽高、行跨度、首地址不对齐、逐行/隔行采样）
+  b.场景判决：白天、夜晚、亮度在门限之间波动（不应反复切换）、逆光（建议宽动态）
+  c.480x272 和 1920x1080 合成图像的耗时：本实现 / 原 stat_luma 的列优先遍历 / 逐像素统计全部统计量
+2.bin/test_luma_stat <file> <width> <height> [gray|yuv420]：统计采集的序列（ffmpeg -pix_fmt gray 或 yuv420p），
+  逐帧打印均值、方差、暗/亮像素占比和场景判决，最后打印平均耗时
+*/
+#include <sys/time.h>
+
+static HLE_U32 bench_seed = 12345;
+static int bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return (bench_seed >> 16) & 0x7FFF;
+}
+
+static HLE_U64 bench_now_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (HLE_U64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*参考实现：逐像素，分块均值用全部行，方差和直方图用采样行*/
+static void bench_ref(const HLE_U8 *y, int width, int height, int stride,
+					  int tiles_x, int tiles_y, int hist_step, luma_stat_t *st)
+{
+	static HLE_U64 sum[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X], ssum[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X];
+	static HLE_U64 sq[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X];
+	static HLE_U32 n[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X], ns[LUMA_TILE_MAX_Y][LUMA_TILE_MAX_X];
+	HLE_U64 total = 0, hs = 0, hq = 0;
+	HLE_U32 hn = 0;
+	int i, j, tx, ty;
+
+	memset(sum, 0, sizeof (sum));
+	memset(ssum, 0, sizeof (ssum));
+	memset(sq, 0, sizeof (sq));
+	memset(n, 0, sizeof (n));
+	memset(ns, 0, sizeof (ns));
+	memset(st, 0, sizeof (*st));
+
+	for (j = 0; j < height; j++)
+	{
+		for (ty = 0; (ty + 1) * height / tiles_y <= j; ty++)
+			;
+		for (i = 0; i < width; i++)
+		{
+			HLE_U32 v = y[j * stride + i];
+			for (tx = 0; (tx + 1) * width / tiles_x <= i; tx++)
+				;
+			sum[ty][tx] += v;
+			n[ty][tx]++;
+			total += v;
+			if (0 == j % hist_step)
+			{
+				ssum[ty][tx] += v;
+				sq[ty][tx] += v * v;
+				ns[ty][tx]++;
+				st->hist[v]++;
+				hs += v;
+				hq += v * v;
+				hn++;
+			}
+		}
+	}
+
+	st->width = width;
+	st->height = height;
+	st->tiles_x = tiles_x;
+	st->tiles_y = tiles_y;
+	for (ty = 0; ty < tiles_y; ty++)
+	{
+		for (tx = 0; tx < tiles_x; tx++)
+		{
+			st->tile_mean[ty][tx] = (sum[ty][tx] + n[ty][tx] / 2) / n[ty][tx];
+			st->tile_var[ty][tx] = ns[ty][tx] ? (sq[ty][tx] - ssum[ty][tx] * ssum[ty][tx] / ns[ty][tx]) / ns[ty][tx] : 0;
+		}
+	}
+	st->mean = (total + width * height / 2) / (width * height);
+	st->samples = hn;
+	st->variance = hn ? (hq - hs * hs / hn) / hn : 0;
+}
+
+static int bench_cmp(const luma_stat_t *a, const luma_stat_t *b)
+{
+	int tx, ty;
+
+	if (a->mean != b->mean || a->variance != b->variance || a->samples != b->samples
+		|| memcmp(a->hist, b->hist, sizeof (a->hist)))
+		return -1;
+
+	for (ty = 0; ty < a->tiles_y; ty++)
+		for (tx = 0; tx < a->tiles_x; tx++)
+			if (a->tile_mean[ty][tx] != b->tile_mean[ty][tx] || a->tile_var[ty][tx] != b->tile_var[ty][tx])
+				return -1;
+
+	return 0;
+}
+
+static int bench_test_ref(void)
+{
+	static const int sizes[][2] = {{480, 272}, {477, 271}, {64, 9}, {1920, 1080}, {33, 17}, {1023, 5}};
+	static HLE_U8 buf[1928 * 1081 + 8];
+	static luma_stat_t a, b;
+	int k, fail = 0;
+
+	for (k = 0; k < 60; k++)
+	{
+		int width = sizes[k % 6][0];
+		int height = sizes[k % 6][1];
+		int stride = width + (k % 3) * 3;
+		int off = k % 4; //首地址不对齐
+		int tiles_x = 1 + bench_rand() % ((width < LUMA_TILE_MAX_X) ? width : LUMA_TILE_MAX_X);
+		int tiles_y = 1 + bench_rand() % ((height < LUMA_TILE_MAX_Y) ? height : LUMA_TILE_MAX_Y);
+		int step = 1 + k % 3;
+		int i;
+
+		for (i = 0; i < stride * height + off; i++)
+			buf[i] = (k & 1) ? bench_rand() & 0xFF : ((i % stride) * 255 / stride + bench_rand() % 16) & 0xFF;
+		if (k % 10 == 9)
+			memset(buf, 255, stride * height + off); //全饱和（通道累加的上限）
+
+		luma_stat_compute(buf + off, width, height, stride, tiles_x, tiles_y, step, &a);
+		bench_ref(buf + off, width, height, stride, tiles_x, tiles_y, step, &b);
+		if (bench_cmp(&a, &b))
+		{
+			printf("ref mismatch: %dx%d stride %d off %d tiles %dx%d step %d (mean %d/%d var %u/%u)\n",
+				   width, height, stride, off, tiles_x, tiles_y, step, a.mean, b.mean, a.variance, b.variance);
+			fail++;
+		}
+	}
+
+	printf("reference compare: %s\n", fail ? "FAIL" : "ok");
+	return fail;
+}
+
+/*合成图像：均值 mean 的噪声背景，可选一块亮区（逆光的窗户）*/
+static void bench_scene(HLE_U8 *y, int width, int height, int mean, int noise, int bright_w)
+{
+	int i, j;
+
+	for (j = 0; j < height; j++)
+	{
+		for (i = 0; i < width; i++)
+		{
+			int v = mean + (noise ? bench_rand() % (2 * noise + 1) - noise : 0);
+			if (i < bright_w)
+				v = 240 + bench_rand() % 16;
+			y[j * width + i] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+		}
+	}
+}
+
+static int bench_test_scene(void)
+{
+	static HLE_U8 img[480 * 272];
+	static luma_stat_t st;
+	luma_scene_t sc;
+	int k, toggles = 0, last = 0, fail = 0;
+
+	memset(&sc, 0, sizeof (sc));
+
+	/*白天 -> 夜晚：连续 LUMA_NIGHT_HYST 次才切换*/
+	for (k = 0; k < 10; k++)
+	{
+		bench_scene(img, 480, 272, (k < 3) ? 120 : 20, 8, 0);
+		luma_stat_compute(img, 480, 272, 480, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+		st.seq = k + 1;
+		luma_scene_update(&sc, &st);
+		if ((k < 3 + LUMA_NIGHT_HYST - 1 && sc.night) || (k >= 3 + LUMA_NIGHT_HYST - 1 && !sc.night))
+			fail++;
+	}
+	printf("day -> night after %d stats: %s\n", LUMA_NIGHT_HYST, fail ? "FAIL" : "ok");
+
+	/*亮度在门限附近波动（黄昏、车灯扫过）：不应反复切换*/
+	for (k = 0; k < 100; k++)
+	{
+		bench_scene(img, 480, 272, (k & 1) ? 35 : 85, 4, 0);
+		luma_stat_compute(img, 480, 272, 480, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+		luma_scene_update(&sc, &st);
+		if (sc.night != last)
+			toggles++;
+		last = sc.night;
+	}
+	printf("flicker 35/85: %d toggles: %s\n", toggles, (toggles <= 1) ? "ok" : "FAIL");
+	fail += toggles > 1;
+
+	/*逆光：画面左侧 1/5 为窗户（接近饱和），其余较暗*/
+	memset(&sc, 0, sizeof (sc));
+	for (k = 0; k < LUMA_WDR_HYST + 5; k++)
+	{
+		bench_scene(img, 480, 272, 35, 10, 96);
+		luma_stat_compute(img, 480, 272, 480, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+		luma_scene_update(&sc, &st);
+	}
+	printf("backlit: dark %d%% bright %d%% var %u -> wdr %d: %s\n",
+		   luma_stat_hist_percent(&st, 0, LUMA_WDR_DARK - 1),
+		   luma_stat_hist_percent(&st, LUMA_WDR_BRIGHT, 255), st.variance, sc.wdr, sc.wdr ? "ok" : "FAIL");
+	fail += !sc.wdr;
+
+	/*正常场景（均匀照明）：不建议宽动态*/
+	memset(&sc, 0, sizeof (sc));
+	for (k = 0; k < LUMA_WDR_HYST + 5; k++)
+	{
+		bench_scene(img, 480, 272, 110, 40, 0);
+		luma_stat_compute(img, 480, 272, 480, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+		luma_scene_update(&sc, &st);
+	}
+	printf("normal: var %u -> wdr %d: %s\n", st.variance, sc.wdr, sc.wdr ? "FAIL" : "ok");
+	fail += sc.wdr;
+
+	/*区域均值：OSD 区域（右上角）在亮区上*/
+	bench_scene(img, 480, 272, 30, 0, 0);
+	for (k = 0; k < 272 / 4; k++)
+		memset(img + k * 480 + 360, 250, 120);
+	luma_stat_feed(img, 480, 272, 480);
+	int m1 = luma_stat_region_mean(6144, 0, 2048, 1024, 8192, 8192);
+	int m2 = luma_stat_region_mean(0, 4096, 4096, 4096, 8192, 8192);
+	printf("region mean: bright corner %d, dark area %d: %s\n", m1, m2, (m1 > 200 && m2 < 40) ? "ok" : "FAIL");
+	fail += !(m1 > 200 && m2 < 40);
+
+	return fail;
+}
+
+/*原 stat_luma 的遍历方式（列优先，按宽度连续读取），只统计 64x64 分块均值，用于对比*/
+static void bench_old_stat(const HLE_U8 *pY, int width, int height, HLE_U32 *sum)
+{
+	int x, y;
+	for (x = 0; x < width; x++)
+		for (y = 0; y < height; y++)
+			sum[(y / 64) * 32 + x / 64] += pY[y * width + x];
+}
+
+/*逐像素统计全部统计量（与本实现等价，不使用按字处理）*/
+static void bench_naive(const HLE_U8 *y, int width, int height, int tiles_x, int tiles_y, luma_stat_t *st)
+{
+	static HLE_U32 tsum[LUMA_TILE_MAX_X], tsq[LUMA_TILE_MAX_X];
+	int i, j, tx, ty;
+
+	memset(st->hist, 0, sizeof (st->hist));
+	for (ty = 0; ty < tiles_y; ty++)
+	{
+		memset(tsum, 0, sizeof (tsum));
+		memset(tsq, 0, sizeof (tsq));
+		for (j = ty * height / tiles_y; j < (ty + 1) * height / tiles_y; j++)
+		{
+			const HLE_U8 *row = y + j * width;
+			for (tx = 0; tx < tiles_x; tx++)
+			{
+				for (i = tx * width / tiles_x; i < (tx + 1) * width / tiles_x; i++)
+				{
+					HLE_U32 v = row[i];
+					tsum[tx] += v;
+					tsq[tx] += v * v;
+					st->hist[v]++;
+				}
+			}
+		}
+		for (tx = 0; tx < tiles_x; tx++)
+			st->tile_mean[ty][tx] = tsum[tx] / ((width / tiles_x) * (height / tiles_y));
+	}
+}
+
+static void bench_speed(int width, int height, int loops)
+{
+	HLE_U8 *img = malloc(width * height);
+	HLE_U32 *old_sum = calloc(32 * 32, sizeof (HLE_U32));
+	static luma_stat_t st;
+	HLE_U64 t0, t_new, t_full, t_old, t_naive;
+	int k;
+
+	if (NULL == img || NULL == old_sum)
+		return;
+
+	//样张：水平渐变 + 噪声 + 一块亮区
+	bench_scene(img, width, height, 0, 0, 0);
+	for (k = 0; k < width * height; k++)
+		img[k] = ((k % width) * 200 / width + bench_rand() % 32 + ((k / width < height / 4 && k % width > width * 3 / 4) ? 60 : 0)) & 0xFF;
+
+	t0 = bench_now_us();
+	for (k = 0; k < loops; k++)
+		luma_stat_compute(img, width, height, width, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+	t_new = bench_now_us() - t0;
+
+	t0 = bench_now_us();
+	for (k = 0; k < loops; k++)
+		luma_stat_compute(img, width, height, width, LUMA_TILES_X, LUMA_TILES_Y, 1, &st);
+	t_full = bench_now_us() - t0;
+
+	t0 = bench_now_us();
+	for (k = 0; k < loops; k++)
+		bench_naive(img, width, height, LUMA_TILES_X, LUMA_TILES_Y, &st);
+	t_naive = bench_now_us() - t0;
+
+	t0 = bench_now_us();
+	for (k = 0; k < loops; k++)
+		bench_old_stat(img, width, height, old_sum);
+	t_old = bench_now_us() - t0;
+
+	printf("%4dx%-4d: luma_stat(step %d) %6llu us, luma_stat(step 1) %6llu us, per-pixel %6llu us, old column-major (mean only) %6llu us\n",
+		   width, height, LUMA_HIST_STEP, t_new / loops, t_full / loops, t_naive / loops, t_old / loops);
+
+	free(old_sum);
+	free(img);
+}
+
+static int bench_file(const char *path, int width, int height, int yuv420)
+{
+	FILE *fp = fopen(path, "rb");
+	if (NULL == fp)
+	{
+		printf("open %s fail\n", path);
+		return -1;
+	}
+
+	int frame_size = yuv420 ? width * height * 3 / 2 : width * height;
+	HLE_U8 *buf = malloc(frame_size);
+	static luma_stat_t st;
+	luma_scene_t sc;
+	HLE_U64 t_total = 0;
+	int n = 0;
+
+	memset(&sc, 0, sizeof (sc));
+	while (buf && fread(buf, 1, frame_size, fp) == (size_t)frame_size)
+	{
+		HLE_U64 t0 = bench_now_us();
+		luma_stat_compute(buf, width, height, width, LUMA_TILES_X, LUMA_TILES_Y, LUMA_HIST_STEP, &st);
+		t_total += bench_now_us() - t0;
+		st.seq = ++n;
+		luma_scene_update(&sc, &st);
+		printf("frame %4d: mean %3d var %5u dark %3d%% bright %3d%% night %d wdr %d\n", n, st.mean, st.variance,
+			   luma_stat_hist_percent(&st, 0, LUMA_WDR_DARK - 1),
+			   luma_stat_hist_percent(&st, LUMA_WDR_BRIGHT, 255), sc.night, sc.wdr);
+	}
+	if (n)
+		printf("%d frames, %llu us/frame\n", n, t_total / n);
+
+	free(buf);
+	fclose(fp);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 4)
+		return bench_file(argv[1], atoi(argv[2]), atoi(argv[3]), argc >= 5 && 0 == strcmp(argv[4], "yuv420"));
+
+	int fail = bench_test_ref();
+	fail += bench_test_scene();
+	bench_speed(480, 272, 2000);
+	bench_speed(1920, 1080, 100);
+
+	printf("%s\n", fail ? "FAIL" : "PASS");
+	return fail ? 1 : 0;
+}
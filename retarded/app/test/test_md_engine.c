@@ -0,0 +1,537 @@
+/***************************************************************************
+* @file: test_md_engine.c
+* @author:
+* @date:  10,19,2026
+* @brief:  移动侦测引擎的主机测试：自检、合成序列、耗时，以及采集序列回放
+* @attention:直接包含 md_engine.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "md_engine.c"
+
+/*
+1.不带参数：自检
+  a.按字并行实现与逐像素实现逐位比对（SAD 位图、背景）
+  b.连通区域标记与洪水填充参考实现比对（随机位图），各检测区域的面积统计与逐宏块统计比对
+  c.合成序列：带噪声的静止场景、缓慢亮度变化（不应告警），移动目标（应告警），掩码屏蔽目标（不应告警），
+    多区域：摇动的树枝所在区域不告警、行人所在区域告警，小目标按最小目标面积过滤
+  d.480x272 每帧耗时
+2.bin/test_md_engine <file> <width> <height> [gray|yuv420] [level]：回放采集的序列（ffmpeg -pix_fmt gray 或 yuv420p），
+  逐帧打印运动面积和告警状态，最后统计告警次数（静止场景的告警次数即误报次数）
+*/
+#include <sys/time.h>
+
+static HLE_U32 sim_seed = 12345;
+static int sim_rand(void)
+{
+	sim_seed = sim_seed * 1103515245 + 12345;
+	return (sim_seed >> 16) & 0x7FFF;
+}
+
+static HLE_U64 sim_now_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (HLE_U64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int sim_fail;
+#define SIM_CHECK(cond, ...) do { if (!(cond)) { printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); sim_fail++; } } while (0)
+
+/*---a.按字并行与逐像素比对---------*/
+static void sim_test_swar(void)
+{
+	int w = 100, h = 52, stride = 104, f;
+	static HLE_U8 buf[104 * 52 + 8];
+	HLE_U8 *aligned = buf;
+	HLE_U8 *unaligned = buf + 1;
+	static md_result_t r1, r2;
+	md_engine_t *e1 = md_engine_create(w, h);
+	md_engine_t *e2 = md_engine_create(w, h);
+	int i, words;
+
+	for (f = 0; f < 50; f++)
+	{
+		for (i = 0; i < stride * h; i++)
+			aligned[i] = (f & 1) ? sim_rand() & 0xFF : (i * 7 + f) & 0xFF;
+		md_engine_process(e1, aligned, stride, &r1);
+		memmove(unaligned, aligned, stride * h);
+		md_engine_process(e2, unaligned, stride, &r2);
+		memmove(aligned, unaligned, stride * h);
+
+		SIM_CHECK(0 == memcmp(e1->bg, e2->bg, e1->width * e1->height), "bg differ frame %d", f);
+		md_engine_motion_map(e1, &words);
+		SIM_CHECK(0 == memcmp(e1->motion, e2->motion, words * e1->bh * 4), "motion map differ frame %d", f);
+		SIM_CHECK(r1.blob_num == r2.blob_num && r1.motion_area == r2.motion_area, "result differ frame %d", f);
+	}
+
+	//单个宏块的 SAD：逐像素核对阈值边界
+	for (i = 0; i < 2000; i++)
+	{
+		HLE_U32 c = ((HLE_U32)sim_rand() << 17) ^ ((HLE_U32)sim_rand() << 2) ^ sim_rand();
+		HLE_U32 b = ((HLE_U32)sim_rand() << 17) ^ ((HLE_U32)sim_rand() << 2) ^ sim_rand();
+		HLE_U32 l = md_absdiff_lanes(c, b);
+		int k, ref = 0;
+		for (k = 0; k < 4; k++)
+			ref += abs((int)((c >> (k * 8)) & 0xFF) - (int)((b >> (k * 8)) & 0xFF));
+		SIM_CHECK((int)((l & 0xFFFF) + (l >> 16)) == ref, "absdiff %08x %08x", c, b);
+		l = md_avg4(c, b);
+		for (k = 0; k < 4; k++)
+			SIM_CHECK(((l >> (k * 8)) & 0xFF) == ((((c >> (k * 8)) & 0xFF) + ((b >> (k * 8)) & 0xFF)) >> 1), "avg");
+	}
+
+	md_engine_destroy(e1);
+	md_engine_destroy(e2);
+}
+
+/*---b.连通区域标记与洪水填充比对---------*/
+static int sim_get(const md_engine_t *e, int bx, int by)
+{
+	return (e->motion[by * e->words + (bx >> 5)] >> (31 - (bx & 31))) & 1;
+}
+
+static void sim_test_ccl(void)
+{
+	int sizes[][2] = {{480, 272}, {132, 40}, {256, 16}, {4, 4}};
+	static md_result_t res;
+	static HLE_S32 lab[120 * 68];
+	static HLE_S32 stack[120 * 68];
+	static HLE_S32 comp_area[120 * 68];
+	static HLE_U8 zmask[120 * 68];
+	HLE_U32 min_area[3] = {0, 16 * 4, 16 * 20};
+	int s, t;
+
+	for (s = 0; s < 4; s++)
+	{
+		md_engine_t *e = md_engine_create(sizes[s][0], sizes[s][1]);
+		md_zone_map_t *zm = md_zone_create(e->bw, e->bh);
+		md_engine_set_area_thr(e, 0, 16);
+		md_engine_set_zones(e, zm);
+		for (t = 0; t < 40; t++)
+		{
+			int density = 5 + t * 2;	//5%-83%
+			int bx, by, n = 0, z;
+			HLE_S32 rect[8], tri[6];
+
+			//区域 0：矩形，区域 1：三角形，区域 2：随机掩码
+			rect[0] = rect[6] = sim_rand() % sizes[s][0];
+			rect[2] = rect[4] = sim_rand() % sizes[s][0];
+			rect[1] = rect[3] = sim_rand() % sizes[s][1];
+			rect[5] = rect[7] = sim_rand() % sizes[s][1];
+			md_polygon_mask(e->bw, e->bh, rect, 4, zmask);
+			md_zone_set(zm, 0, zmask, min_area[0]);
+			for (z = 0; z < 6; z++)
+				tri[z] = sim_rand() % sizes[s][z & 1];
+			md_polygon_mask(e->bw, e->bh, tri, 3, zmask);
+			md_zone_set(zm, 1, zmask, min_area[1]);
+			for (z = 0; z < e->bw * e->bh; z++)
+				zmask[z] = sim_rand() & 1;
+			md_zone_set(zm, 2, zmask, min_area[2]);
+
+			memset(e->motion, 0, e->words * e->bh * 4);
+			for (by = 0; by < e->bh; by++)
+				for (bx = 0; bx < e->bw; bx++)
+					if (sim_rand() % 100 < density)
+						e->motion[by * e->words + (bx >> 5)] |= 0x80000000U >> (bx & 31);
+			md_label(e, &res);
+
+			//参考：光栅顺序洪水填充，区域顺序与行程并查集一致（按区域最上最左的宏块）
+			memset(lab, 0xFF, sizeof(lab));
+			for (by = 0; by < e->bh; by++)
+			{
+				for (bx = 0; bx < e->bw; bx++)
+				{
+					int sp = 0, area = 0, l = bx, r = bx, tp = by, bt = by;
+					if (!sim_get(e, bx, by) || lab[by * e->bw + bx] >= 0)
+						continue;
+					lab[by * e->bw + bx] = n;
+					stack[sp++] = by * e->bw + bx;
+					while (sp)
+					{
+						int p = stack[--sp], px = p % e->bw, py = p / e->bw, d;
+						int nx[4] = {px - 1, px + 1, px, px}, ny[4] = {py, py, py - 1, py + 1};
+						area++;
+						if (px < l) l = px;
+						if (px > r) r = px;
+						if (py < tp) tp = py;
+						if (py > bt) bt = py;
+						for (d = 0; d < 4; d++)
+						{
+							if (nx[d] < 0 || ny[d] < 0 || nx[d] >= e->bw || ny[d] >= e->bh)
+								continue;
+							if (sim_get(e, nx[d], ny[d]) && lab[ny[d] * e->bw + nx[d]] < 0)
+							{
+								lab[ny[d] * e->bw + nx[d]] = n;
+								stack[sp++] = ny[d] * e->bw + nx[d];
+							}
+						}
+					}
+					if (n < MD_MAX_BLOBS && res.area_thr == 0)
+					{
+						md_blob_t *b = &res.blob[n];
+						SIM_CHECK(b->area == (HLE_U32)area * 16 && b->left == l * 4 && b->right == r * 4 + 3
+							&& b->top == tp * 4 && b->bottom == bt * 4 + 3,
+							"blob %d differ (%dx%d density %d)", n, e->bw, e->bh, density);
+					}
+					comp_area[n] = area * 16;
+					n++;
+				}
+			}
+			if (n <= MD_MAX_BLOBS)
+			{
+				SIM_CHECK(res.blob_num == n && res.area_thr == 0, "blob num %d != %d", res.blob_num, n);
+
+				//逐宏块统计各区域面积
+				for (z = 0; z < 3; z++)
+				{
+					HLE_U32 expect = 0;
+					for (by = 0; by < e->bh; by++)
+						for (bx = 0; bx < e->bw; bx++)
+						{
+							int l = lab[by * e->bw + bx];
+							if (l >= 0 && (HLE_U32)comp_area[l] >= min_area[z]
+								&& ((zm->plane[z][by * zm->words + (bx >> 5)] >> (31 - (bx & 31))) & 1))
+								expect += 16;
+						}
+					SIM_CHECK(res.zone_area[z] == expect, "zone %d area %u != %u (%dx%d density %d)",
+						z, res.zone_area[z], expect, e->bw, e->bh, density);
+				}
+			}
+			else
+			{
+				SIM_CHECK(res.blob_num <= MD_MAX_BLOBS && res.area_thr > 0, "blob limit %d", res.blob_num);
+			}
+		}
+		md_engine_destroy(e);
+		md_zone_destroy(zm);
+	}
+}
+
+/*---多边形与外接矩形分配---------*/
+static void sim_test_zone_geometry(void)
+{
+	static HLE_U8 mask[120 * 68];
+	static md_result_t res;
+	md_zone_map_t *zm = md_zone_create(120, 68);
+	HLE_S32 rect[8] = {40, 20, 200, 20, 200, 100, 40, 100};	//宏块 10..49 x 5..24
+	HLE_S32 tri[6] = {0, 0, 400, 0, 0, 200};
+	int n;
+
+	n = md_polygon_mask(120, 68, rect, 4, mask);
+	SIM_CHECK(n == 40 * 20 && mask[5 * 120 + 10] && mask[24 * 120 + 49] && !mask[4 * 120 + 10] && !mask[5 * 120 + 50],
+		"rect polygon %d blocks", n);
+	n = md_polygon_mask(120, 68, tri, 3, mask);
+	SIM_CHECK(n > 100 * 50 / 2 - 60 && n < 100 * 50 / 2 + 60, "triangle polygon %d blocks", n);
+
+	//外接矩形一半在区域内：面积按比例计入；小于最小目标面积的不计入
+	md_polygon_mask(120, 68, rect, 4, mask);
+	md_zone_set(zm, 1, mask, 16 * 10);
+	res.blob_num = 2;
+	res.blob[0].area = 16 * 40;	//宏块 30..69 x 10
+	res.blob[0].left = 120;
+	res.blob[0].right = 279;
+	res.blob[0].top = res.blob[0].bottom = 40;
+	res.blob[1].area = 16 * 4;	//小目标，在区域内
+	res.blob[1].left = 160;
+	res.blob[1].right = 175;
+	res.blob[1].top = res.blob[1].bottom = 60;
+	md_zone_assign(zm, &res);
+	SIM_CHECK(res.zone_area[1] == 16 * 20 && res.blob[0].zones == 2 && res.blob[1].zones == 0 && res.zone_area[0] == 0,
+		"bbox assign %u %x %x", res.zone_area[1], res.blob[0].zones, res.blob[1].zones);
+	SIM_CHECK(md_zone_used(zm) == 2 && md_zone_area(zm, 1) == 16 * 800, "zone used/area");
+	md_zone_set(zm, 1, NULL, 0);
+	SIM_CHECK(md_zone_used(zm) == 0 && md_zone_area(zm, 1) == 0, "zone delete");
+
+	md_zone_destroy(zm);
+}
+
+/*---c.合成序列---------*/
+#define SIM_W	480
+#define SIM_H	272
+
+static HLE_U8 sim_scene[SIM_W * SIM_H];
+static HLE_U8 sim_frame[SIM_W * SIM_H];
+
+//纹理背景 + 亮度偏移 + 传感器噪声（±noise），可选一个每帧移动 16 像素的方块
+static void sim_render(int f, int noise, int drift, int box)
+{
+	int x, y;
+	for (y = 0; y < SIM_H; y++)
+	{
+		for (x = 0; x < SIM_W; x++)
+		{
+			int v = sim_scene[y * SIM_W + x] + drift;
+			if (box)
+			{
+				int bx = 16 + f * 16 % 320, by = 64;
+				if (x >= bx && x < bx + 128 && y >= by && y < by + 128)
+					v = 230 - ((x ^ y) & 15);
+			}
+			if (noise)
+				v += sim_rand() % (2 * noise + 1) - noise;
+			sim_frame[y * SIM_W + x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+		}
+	}
+}
+
+//运行一段合成序列，返回告警帧数
+static int sim_run(md_engine_t *e, int level, int frames, int noise, int drift_per_frame, int box)
+{
+	static const HLE_U16 md_thres[MD_LEVEL_NUM] = MD_SAD_THRES_TABLE;
+	static md_result_t res;
+	md_alarm_t alarm = {0, 0};
+	int f, alarm_frames = 0;
+
+	md_engine_reset(e);
+	md_engine_set_sad_thr(e, md_thres[level]);
+	for (f = 0; f < frames; f++)
+	{
+		sim_render(f, noise, f * drift_per_frame / 10, box);
+		md_engine_process(e, sim_frame, SIM_W, &res);
+		alarm_frames += md_alarm_update(&alarm, res.motion_area, SIM_W * SIM_H, level);
+	}
+	return alarm_frames;
+}
+
+/*多区域场景：左边 160 列是摇动的树枝（每帧随机纹理），右边一个 64x128 的行人每帧走 12 像素，
+  SIM_SPOTS：每帧随机出现 40 个 8x8 的闪烁小点（飞虫、雨点）*/
+#define SIM_TREE	1
+#define SIM_WALKER	2
+#define SIM_SPOTS	4
+static void sim_render_zones(int f, int flags)
+{
+	int x, y, i;
+
+	for (y = 0; y < SIM_H; y++)
+	{
+		for (x = 0; x < SIM_W; x++)
+		{
+			int v = sim_scene[y * SIM_W + x] + sim_rand() % 7 - 3;
+			if ((flags & SIM_TREE) && x < 160)
+				v = 40 + (sim_rand() & 127);
+			if ((flags & SIM_WALKER) && y >= 100 && y < 228)
+			{
+				int wx = 240 + f * 12 % 176;
+				if (x >= wx && x < wx + 64)
+					v = 200 - ((y >> 3) & 7) * 8;
+			}
+			sim_frame[y * SIM_W + x] = v < 0 ? 0 : (v > 255 ? 255 : v);
+		}
+	}
+	if (flags & SIM_SPOTS)
+	{
+		for (i = 0; i < 40; i++)
+		{
+			int sx = (sim_rand() % (SIM_W / 8)) * 8, sy = (sim_rand() % (SIM_H / 8)) * 8;
+			for (y = sy; y < sy + 8; y++)
+				for (x = sx; x < sx + 8; x++)
+					sim_frame[y * SIM_W + x] = 250;
+		}
+	}
+}
+
+//运行多区域序列，alarm_frames[z] 返回各区域的告警帧数
+static void sim_run_zones(md_engine_t *e, const md_zone_map_t *zm, const int *level, int frames, int flags, int *alarm_frames)
+{
+	static const HLE_U16 md_thres[MD_LEVEL_NUM] = MD_SAD_THRES_TABLE;
+	static md_result_t res;
+	md_alarm_t alarm[MD_ZONE_MAX];
+	int f, z;
+
+	memset(alarm, 0, sizeof(alarm));
+	memset(alarm_frames, 0, MD_ZONE_MAX * sizeof(int));
+	md_engine_reset(e);
+	md_engine_set_sad_thr(e, md_thres[0]);
+	md_engine_set_zones(e, zm);
+	for (f = 0; f < frames; f++)
+	{
+		sim_render_zones(f, flags);
+		md_engine_process(e, sim_frame, SIM_W, &res);
+		for (z = 0; z < MD_ZONE_MAX; z++)
+		{
+			if (md_zone_used(zm) & (1U << z))
+				alarm_frames[z] += md_alarm_update(&alarm[z], res.zone_area[z], md_zone_area(zm, z), level[z]);
+		}
+	}
+	md_engine_set_zones(e, NULL);
+}
+
+static void sim_test_zones(md_engine_t *e)
+{
+	static HLE_U8 mask[(SIM_W / 4) * (SIM_H / 4)];
+	md_zone_map_t *zm = md_zone_create(SIM_W / 4, SIM_H / 4);
+	HLE_S32 full[8] = {0, 0, SIM_W, 0, SIM_W, SIM_H, 0, SIM_H};
+	HLE_S32 tree[8] = {0, 0, 160, 0, 160, SIM_H, 0, SIM_H};
+	HLE_S32 road[8] = {176, 0, SIM_W, 0, SIM_W, SIM_H, 176, SIM_H};
+	int level[MD_ZONE_MAX] = {2, 0, 0};
+	int alarm[MD_ZONE_MAX];
+
+	//整幅图像一个区域：树枝引起告警（原来的行为）
+	md_polygon_mask(SIM_W / 4, SIM_H / 4, full, 4, mask);
+	md_zone_set(zm, 0, mask, 0);
+	sim_run_zones(e, zm, level, 50, SIM_TREE, alarm);
+	SIM_CHECK(alarm[0] >= 45, "single zone tree: %d", alarm[0]);
+	printf("single full zone, swaying tree, level 2: %d alarm frames / 50\n", alarm[0]);
+
+	//区域 0：树（level 4），区域 1：路面（level 0）
+	md_polygon_mask(SIM_W / 4, SIM_H / 4, tree, 4, mask);
+	md_zone_set(zm, 0, mask, 0);
+	md_polygon_mask(SIM_W / 4, SIM_H / 4, road, 4, mask);
+	md_zone_set(zm, 1, mask, 0);
+	level[0] = 4;
+	sim_run_zones(e, zm, level, 50, SIM_TREE, alarm);
+	SIM_CHECK(alarm[1] == 0, "tree only, road zone: %d", alarm[1]);
+	printf("zones tree(level 4)/road(level 0), tree only: tree %d, road %d alarm frames / 50\n", alarm[0], alarm[1]);
+	sim_run_zones(e, zm, level, 50, SIM_TREE | SIM_WALKER, alarm);
+	SIM_CHECK(alarm[1] >= 45, "walker, road zone: %d", alarm[1]);
+	printf("zones tree(level 4)/road(level 0), tree + walker: tree %d, road %d alarm frames / 50\n", alarm[0], alarm[1]);
+
+	//小目标：没有最小目标面积时告警，最小目标面积 16x16 时不告警，行人仍然告警
+	md_zone_set(zm, 0, NULL, 0);
+	sim_run_zones(e, zm, level, 50, SIM_SPOTS, alarm);
+	SIM_CHECK(alarm[1] >= 45, "spots without min size: %d", alarm[1]);
+	printf("road zone, 8x8 spots, min size 0: %d alarm frames / 50\n", alarm[1]);
+	md_zone_set(zm, 1, mask, 16 * 16);
+	sim_run_zones(e, zm, level, 50, SIM_SPOTS, alarm);
+	SIM_CHECK(alarm[1] == 0, "spots with min size: %d", alarm[1]);
+	printf("road zone, 8x8 spots, min size 16x16: %d alarm frames / 50\n", alarm[1]);
+	sim_run_zones(e, zm, level, 50, SIM_SPOTS | SIM_WALKER, alarm);
+	SIM_CHECK(alarm[1] >= 45, "spots + walker with min size: %d", alarm[1]);
+	printf("road zone, 8x8 spots + walker, min size 16x16: %d alarm frames / 50\n", alarm[1]);
+
+	md_zone_destroy(zm);
+}
+
+static void sim_test_sequence(void)
+{
+	md_engine_t *e = md_engine_create(SIM_W, SIM_H);
+	static HLE_U8 mask[(SIM_W / 4) * (SIM_H / 4)];
+	int i, n;
+
+	for (i = 0; i < SIM_W * SIM_H; i++)
+		sim_scene[i] = 60 + ((i % SIM_W) / 8 + (i / SIM_W) / 8) % 2 * 40 + (sim_rand() & 31);
+
+	n = sim_run(e, 0, 200, 6, 0, 0);
+	SIM_CHECK(0 == n, "static noisy scene: %d alarm frames", n);
+	printf("static scene, noise +-6, level 0: %d alarm frames / 200\n", n);
+
+	n = sim_run(e, 0, 200, 3, 5, 0);	//每帧亮度 +0.5
+	SIM_CHECK(0 == n, "slow illumination drift: %d alarm frames", n);
+	printf("illumination drift 0.5/frame, level 0: %d alarm frames / 200\n", n);
+
+	n = sim_run(e, 0, 50, 3, 0, 1);
+	SIM_CHECK(n >= 45, "moving box level 0: %d alarm frames", n);
+	printf("moving 128x128 box, level 0: %d alarm frames / 50\n", n);
+
+	n = sim_run(e, 4, 50, 3, 0, 1);
+	SIM_CHECK(0 == n, "moving box level 4: %d alarm frames", n);
+	printf("moving 128x128 box, level 4: %d alarm frames / 50\n", n);
+
+	//屏蔽方块经过的区域（y 64..191）
+	for (i = 0; i < (int)sizeof(mask); i++)
+		mask[i] = (i / (SIM_W / 4) < 16 || i / (SIM_W / 4) >= 48);
+	md_engine_set_mask(e, mask);
+	n = sim_run(e, 0, 50, 3, 0, 1);
+	SIM_CHECK(0 == n, "masked box: %d alarm frames", n);
+	printf("moving box in masked area, level 0: %d alarm frames / 50\n", n);
+	md_engine_set_mask(e, NULL);
+
+	sim_test_zones(e);
+	md_engine_destroy(e);
+}
+
+/*---d.耗时---------*/
+static void sim_bench(void)
+{
+	md_engine_t *e = md_engine_create(SIM_W, SIM_H);
+	static HLE_U8 frames[2][SIM_W * SIM_H + 4];
+	static md_result_t res;
+	HLE_U64 t0, t_swar, t_c;
+	int f, i, loops = 2000;
+
+	for (f = 0; f < 2; f++)
+		for (i = 0; i < SIM_W * SIM_H + 4; i++)
+			frames[f][i] = sim_scene[i % (SIM_W * SIM_H)] + ((f && (i % SIM_W) > 200 && (i % SIM_W) < 300) ? 80 : 0);
+
+	md_engine_process(e, frames[0], SIM_W, &res);
+	t0 = sim_now_us();
+	for (f = 0; f < loops; f++)
+		md_engine_process(e, frames[f & 1], SIM_W, &res);
+	t_swar = sim_now_us() - t0;
+
+	md_engine_reset(e);
+	md_engine_process(e, frames[0] + 1, SIM_W, &res);
+	t0 = sim_now_us();
+	for (f = 0; f < loops; f++)
+		md_engine_process(e, frames[f & 1] + 1, SIM_W, &res);
+	t_c = sim_now_us() - t0;
+
+	printf("480x272 per frame: word-parallel %.1f us, per-pixel %.1f us (%d blobs)\n",
+		(double)t_swar / loops, (double)t_c / loops, res.blob_num);
+	md_engine_destroy(e);
+}
+
+static int sim_replay(const char *file, int w, int h, int yuv420, int level)
+{
+	static const HLE_U16 md_thres[MD_LEVEL_NUM] = MD_SAD_THRES_TABLE;
+	static md_result_t res;
+	md_alarm_t alarm = {0, 0};
+	md_engine_t *e;
+	FILE *fp;
+	HLE_U8 *frame;
+	size_t frame_size = (size_t)w * h * (yuv420 ? 3 : 2) / 2;
+	int f = 0, alarm_frames = 0, alarm_events = 0, last = 0;
+	HLE_U64 t_total = 0;
+
+	if (!yuv420)
+		frame_size = (size_t)w * h;
+	fp = fopen(file, "rb");
+	e = md_engine_create(w, h);
+	frame = (HLE_U8 *)malloc(frame_size + 4);
+	if (NULL == fp || NULL == e || NULL == frame)
+	{
+		printf("open %s / create engine fail\n", file);
+		return 1;
+	}
+
+	md_engine_set_sad_thr(e, md_thres[level]);
+	while (fread(frame, 1, frame_size, fp) == frame_size)
+	{
+		HLE_U64 t0 = sim_now_us();
+		int a;
+		md_engine_process(e, frame, w, &res);
+		t_total += sim_now_us() - t0;
+		a = md_alarm_update(&alarm, res.motion_area, e->width * e->height, level);
+		printf("%d area=%u (%u%%) blobs=%d alarm=%d\n", f, res.motion_area,
+			(unsigned)((HLE_U64)res.motion_area * 100 / (e->width * e->height)), res.blob_num, a);
+		alarm_frames += a;
+		alarm_events += (a && !last);
+		last = a;
+		f++;
+	}
+	printf("frames=%d alarm_frames=%d alarm_events=%d avg=%.1f us/frame\n",
+		f, alarm_frames, alarm_events, f ? (double)t_total / f : 0.0);
+
+	free(frame);
+	md_engine_destroy(e);
+	fclose(fp);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4)
+	{
+		int yuv420 = (argc >= 5) ? (0 == strcmp(argv[4], "yuv420")) : 0;
+		int level = (argc >= 6) ? atoi(argv[5]) : 2;
+		if (level < 0 || level >= MD_LEVEL_NUM)
+			level = 2;
+		return sim_replay(argv[1], atoi(argv[2]), atoi(argv[3]), yuv420, level);
+	}
+
+	sim_test_swar();
+	sim_test_ccl();
+	sim_test_zone_geometry();
+	sim_test_sequence();
+	sim_bench();
+	printf("%s (%d failures)\n", sim_fail ? "FAILED" : "PASSED", sim_fail);
+	return sim_fail ? 1 : 0;
+}
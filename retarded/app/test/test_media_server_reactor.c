@@ -0,0 +1,706 @@
+/***************************************************************************
+* @file: test_media_server_reactor.c
+* @author:
+* @date:  10,19,2026
+* @brief:  P2P 会话反应器的主机测试：所有会话的信令由一个线程处理、实时流从 I 帧开始并过滤音频、
+		   logout 和对端关闭时清理会话并归还编码包；同一路码流的观看者共用一个编码队列（广播组）
+* @attention:直接包含 media_server_reactor.c 和 p2p_transport_sock.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	1.传输层用 p2p_transport_sock.c 的 TCP 实现，客户端按它的帧格式直接用 socket 实现。
+	2.编码模块、会话状态数组和信令解析由测试实现：信令只解析打开/关闭实时流和 logout，
+	  信令体从反应器收齐的整条信令中取，不读传输层。
+	3.ABR 由 test_abr 测试，这里关闭（REACTOR_ABR_ENABLE=0），会话一直留在请求的码流上。
+***************************************************************************/
+#include "media_server_reactor.c"
+#include "p2p_transport_sock.c"
+
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define SIM_QUEUE_BASE      10          //码流队列 ID = SIM_QUEUE_BASE + 码流下标
+#define SIM_QUEUE_SIZE      128         //大于 REACTOR_GROUP_RING，测试环满
+#define SIM_GROUP_FRAMES    40          //广播组测试每个观看者收到的帧数（多于 REACTOR_SENDV_MAX）
+#define SIM_WAIT_MS         2000
+
+typedef struct
+{
+    HLE_U32 videoType;
+    HLE_U32 openAudio;
+}sim_living_open_t;
+
+/*模拟编码队列（sim_enc_lock 保护）*/
+typedef struct
+{
+    int requested;                      //encoder_request_stream 次数
+    int freed;                          //encoder_free_stream 次数
+    int force_iframe;                   //encoder_force_iframe 次数
+    void (*notify)(void *arg);
+    void *arg;
+    unsigned char *pack[SIM_QUEUE_SIZE];
+    int len[SIM_QUEUE_SIZE];
+    int head, tail;
+}sim_queue_t;
+
+med_ser_init_info_t g_med_ser_envir;
+
+static pthread_mutex_t sim_enc_lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_queue_t sim_queue[REACTOR_GROUP_NUM];
+static int sim_outstanding;             //流线程取走还没有归还的编码包
+
+static pthread_mutex_t sim_sess_lock = PTHREAD_MUTEX_INITIALIZER;
+static session_status_t sim_status[MAX_CLIENT_NUM];
+
+static pthread_t sim_parse_tid[16];     //处理信令的线程
+static int sim_parse_num;
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*---media_server_p2p.c 中的接口------------------------------------------------*/
+unsigned long getTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+const p2p_transport_t *p2p_transport_get(const HLE_S8 **param)
+{
+    return &g_p2p_transport_tcp;
+}
+
+HLE_S32 p2p_recv(HLE_S32 SessionID, HLE_U8 Channel, void *buf, HLE_S32 *length, HLE_U32 timeout_ms)
+{
+    return g_p2p_transport_tcp.read(SessionID, Channel, buf, length, timeout_ms);
+}
+
+HLE_S32 p2p_sendv(HLE_S32 SessionID, HLE_U8 Channel, const struct iovec *iov, HLE_S32 iovcnt)
+{
+    return g_p2p_transport_tcp.writev(SessionID, Channel, iov, iovcnt);
+}
+
+HLE_S32 p2p_check_buffer(HLE_S32 SessionID, HLE_U8 Channel, HLE_U32 *wsize)
+{
+    return g_p2p_transport_tcp.check_buffer(SessionID, Channel, wsize);
+}
+
+HLE_S32 p2p_close(HLE_S32 SessionID)
+{
+    return g_p2p_transport_tcp.close(SessionID);
+}
+
+const HLE_S8 *getP2PErrorCodeInfo(HLE_S32 err)
+{
+    return (const HLE_S8 *)"sim";
+}
+
+/*---media_server_signal_parse.c 中的会话状态数组（线性查找）---------------------*/
+static int sim_sess_find(HLE_S32 SessionID)
+{
+    int i;
+    for (i = 0; i < MAX_CLIENT_NUM; i++)
+    {
+        if (sim_status[i].node_is_used && sim_status[i].SessionID == SessionID)
+            return i;
+    }
+    return -1;
+}
+
+HLE_S32 add_one_session_to_arr(HLE_S32 SessionID)
+{
+    int i;
+
+    pthread_mutex_lock(&sim_sess_lock);
+    i = sim_sess_find(SessionID);
+    for (i = i >= 0 ? i : 0; i < MAX_CLIENT_NUM; i++)
+    {
+        if (!sim_status[i].node_is_used)
+        {
+            sim_status[i].SessionID = SessionID;
+            sim_status[i].node_is_used = 1;
+        }
+        if (sim_status[i].SessionID == SessionID)
+            break;
+    }
+    pthread_mutex_unlock(&sim_sess_lock);
+    return i < MAX_CLIENT_NUM ? i : HLE_RET_ENORESOURCE;
+}
+
+HLE_S32 get_session_status(HLE_S32 SessionID, session_status_t *status)
+{
+    int i;
+
+    pthread_mutex_lock(&sim_sess_lock);
+    i = sim_sess_find(SessionID);
+    if (i >= 0)
+        *status = sim_status[i];
+    pthread_mutex_unlock(&sim_sess_lock);
+    return i >= 0 ? i : HLE_RET_ERROR;
+}
+
+HLE_S32 set_session_status(HLE_S32 SessionID, session_status_t *status)
+{
+    int i;
+
+    pthread_mutex_lock(&sim_sess_lock);
+    i = sim_sess_find(SessionID);
+    if (i >= 0)
+    {
+        sim_status[i] = *status;
+        sim_status[i].SessionID = SessionID;
+        sim_status[i].node_is_used = 1;
+    }
+    pthread_mutex_unlock(&sim_sess_lock);
+    return i >= 0 ? i : HLE_RET_ERROR;
+}
+
+HLE_S32 is_session_online(HLE_S32 SessionID)
+{
+    session_status_t status;
+    if (get_session_status(SessionID, &status) < 0)
+        return OFFLINE;
+    return ONLINE == status.Session_status ? ONLINE : OFFLINE;
+}
+
+HLE_S32 del_one_session_from_arr(HLE_S32 SessionID)
+{
+    int i;
+
+    pthread_mutex_lock(&sim_sess_lock);
+    i = sim_sess_find(SessionID);
+    if (i >= 0)
+        memset(&sim_status[i], 0, sizeof (session_status_t));
+    pthread_mutex_unlock(&sim_sess_lock);
+    return i >= 0 ? i : HLE_RET_ERROR;
+}
+
+/*信令解析：只在反应器的信令线程中调用*/
+HLE_S32 med_ser_cmd_parse(HLE_S32 SessionID, cmd_header_t *data, HLE_S32 length)
+{
+    sim_living_open_t body;
+    session_status_t status;
+
+    if (sim_parse_num < (int)(sizeof (sim_parse_tid) / sizeof (sim_parse_tid[0])))
+        sim_parse_tid[sim_parse_num++] = pthread_self();
+    SIM_CHECK(HLE_MAGIC == data->head);
+    SIM_CHECK((HLE_S32)sizeof (cmd_header_t) + data->length == length);
+
+    switch (data->command)
+    {
+        case CMD_GET_LIVING_OPEN:
+            SIM_CHECK(sizeof (body) == data->length);
+            memcpy(&body, data + 1, sizeof (body));
+            return reactor_open_living(SessionID, body.videoType, body.openAudio);
+        case CMD_SET_LIVING_CLOSE:
+            reactor_close_living(SessionID);
+            return 0;
+        case CMD_SET_LOGOUT:
+            get_session_status(SessionID, &status);
+            status.Session_status = OFFLINE;
+            set_session_status(SessionID, &status);
+            return 0;
+        default:
+            printf("unexpected command %#x\n", data->command);
+            sim_errors++;
+            return -1;
+    }
+}
+
+/*---模拟编码模块--------------------------------------------------------------*/
+static HLE_S32 sim_enc_request_stream(int channel, int stream_index, int auto_rc)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_queue[stream_index].requested++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return SIM_QUEUE_BASE + stream_index;
+}
+
+static HLE_S32 sim_enc_free_stream(int stream_id)
+{
+    sim_queue_t *q = &sim_queue[stream_id - SIM_QUEUE_BASE];
+
+    pthread_mutex_lock(&sim_enc_lock);
+    q->freed++;
+    while (q->tail != q->head)
+        free(q->pack[q->tail++ % SIM_QUEUE_SIZE]);
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+static HLE_S32 sim_enc_try_get_packet(HLE_S32 queue_id, HLE_S8 have_audio, void **pack_addr, void **frame_addr, HLE_S32 *frame_length)
+{
+    sim_queue_t *q = &sim_queue[queue_id - SIM_QUEUE_BASE];
+
+    pthread_mutex_lock(&sim_enc_lock);
+    *pack_addr = NULL;
+    if (q->tail != q->head)
+    {
+        *pack_addr = *frame_addr = q->pack[q->tail % SIM_QUEUE_SIZE];
+        *frame_length = q->len[q->tail % SIM_QUEUE_SIZE];
+        q->tail++;
+        sim_outstanding++;
+    }
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+static HLE_S32 sim_enc_release_packet(void *pack)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_outstanding--;
+    pthread_mutex_unlock(&sim_enc_lock);
+    free(pack);
+    return 0;
+}
+
+static HLE_S32 sim_enc_force_iframe(HLE_S32 channel, HLE_S32 stream_index)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_queue[stream_index].force_iframe++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+static HLE_S32 sim_enc_set_packet_notify(int stream_id, void (*notify)(void *arg), void *arg)
+{
+    sim_queue_t *q = &sim_queue[stream_id - SIM_QUEUE_BASE];
+
+    pthread_mutex_lock(&sim_enc_lock);
+    q->notify = notify;
+    q->arg = arg;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+/*编码线程：生成一帧（帧头 + 描述信息 + 4 字节序号）放入码流队列，队列由空变为非空时通知*/
+static void sim_enc_push(int stream_index, HLE_U8 type, HLE_U32 seq)
+{
+    sim_queue_t *q = &sim_queue[stream_index];
+    int info = 0xF8 == type ? sizeof (IFRAME_INFO) : 0xF9 == type ? sizeof (PFRAME_INFO) : sizeof (AFRAME_INFO);
+    int len = sizeof (FRAME_HDR) + info + sizeof (seq);
+    unsigned char *frame = (unsigned char *)calloc(1, len);
+    void (*notify)(void *arg) = NULL;
+    void *arg = NULL;
+
+    frame[2] = 0x01;
+    frame[3] = type;
+    memcpy(frame + len - sizeof (seq), &seq, sizeof (seq));
+
+    pthread_mutex_lock(&sim_enc_lock);
+    if (q->head - q->tail >= SIM_QUEUE_SIZE)
+    {
+        free(frame);
+        pthread_mutex_unlock(&sim_enc_lock);
+        return;
+    }
+    if (q->head == q->tail)
+    {
+        notify = q->notify;
+        arg = q->arg;
+    }
+    q->pack[q->head % SIM_QUEUE_SIZE] = frame;
+    q->len[q->head % SIM_QUEUE_SIZE] = len;
+    q->head++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    if (notify)
+        notify(arg);
+}
+
+static int sim_enc_get(int *value)
+{
+    int v;
+    pthread_mutex_lock(&sim_enc_lock);
+    v = *value;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return v;
+}
+
+/*---客户端-----------------------------------------------------------------*/
+static int sim_connect(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = g_sock.local;
+    struct timeval tv = {SIM_WAIT_MS / 1000, 0};
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    return fd;
+}
+
+/*接入一个客户端并交给反应器，返回客户端 socket*/
+static int sim_accept(p2p_handle_t *handle, HLE_S32 *session)
+{
+    int fd = sim_connect();
+
+    SIM_CHECK(fd >= 0);
+    *session = g_p2p_transport_tcp.listen(NULL, 1, NULL);
+    SIM_CHECK(*session >= 0);
+    SIM_CHECK(0 == reactor_add_session(*session));
+    return fd;
+}
+
+/*在 CH_CMD 上发送一个 TCP 数据帧*/
+static void sim_send_frame(int fd, const void *data, int len)
+{
+    unsigned char buf[64];
+
+    buf[0] = CH_CMD;
+    buf[1] = len >> 16;
+    buf[2] = len >> 8;
+    buf[3] = len;
+    memcpy(buf + 4, data, len);
+    SIM_CHECK(send(fd, buf, 4 + len, 0) == 4 + len);
+}
+
+static void sim_make_header(cmd_header_t *header, HLE_U32 command, int body_len)
+{
+    header->head = HLE_MAGIC;
+    header->length = body_len;
+    header->type = 1;
+    header->command = command;
+}
+
+/*发送一条信令（信令头和信令体在同一个 TCP 数据帧中）*/
+static void sim_send_cmd(int fd, HLE_U32 command, const void *body, int body_len)
+{
+    unsigned char buf[48];
+
+    sim_make_header((cmd_header_t *)buf, command, body_len);
+    if (body_len > 0)
+        memcpy(buf + sizeof (cmd_header_t), body, body_len);
+    sim_send_frame(fd, buf, sizeof (cmd_header_t) + body_len);
+}
+
+static void sim_open_living(int fd, HLE_U32 videoType, HLE_U32 openAudio)
+{
+    sim_living_open_t body = {videoType, openAudio};
+    sim_send_cmd(fd, CMD_GET_LIVING_OPEN, &body, sizeof (body));
+}
+
+/*从 CH_STREAM 读 num 个编码帧（一个 TCP 数据帧中可能有多个编码帧），返回读到的帧数*/
+static int sim_read_frames(int fd, HLE_U8 *types, HLE_U32 *seqs, int num)
+{
+    static unsigned char data[4096];
+    unsigned char hdr[4];
+    int got = 0;
+
+    while (got < num)
+    {
+        int len, pos = 0;
+
+        if (recv(fd, hdr, 4, MSG_WAITALL) != 4)
+            break;
+        len = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+        if (CH_STREAM != hdr[0] || len > (int)sizeof (data) || recv(fd, data, len, MSG_WAITALL) != len)
+            break;
+        while (pos < len && got < num)
+        {
+            HLE_U8 type = data[pos + 3];
+            int info = 0xF8 == type ? sizeof (IFRAME_INFO) : 0xF9 == type ? sizeof (PFRAME_INFO) : sizeof (AFRAME_INFO);
+
+            SIM_CHECK(0 == data[pos] && 0 == data[pos + 1] && 1 == data[pos + 2]);
+            pos += sizeof (FRAME_HDR) + info;
+            types[got] = type;
+            memcpy(&seqs[got], data + pos, sizeof (HLE_U32));
+            pos += sizeof (HLE_U32);
+            got++;
+        }
+    }
+    return got;
+}
+
+/*对端关闭连接（读到 EOF）*/
+static int sim_is_closed(int fd)
+{
+    unsigned char buf[256];
+    int n;
+
+    while ((n = recv(fd, buf, sizeof (buf), 0)) > 0)
+        ;
+    return 0 == n;
+}
+
+static int sim_session_num(p2p_handle_t *handle)
+{
+    int n;
+    pthread_mutex_lock(&handle->lock);
+    n = handle->Session_num;
+    pthread_mutex_unlock(&handle->lock);
+    return n;
+}
+
+static int sim_thread_num(void)
+{
+    DIR *dir = opendir("/proc/self/task");
+    struct dirent *ent;
+    int n = 0;
+
+    if (NULL == dir)
+        return -1;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if ('.' != ent->d_name[0])
+            n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+/*广播组状态（live_lock 保护），index：广播组下标*/
+static int sim_group_viewers(int index)
+{
+    int n;
+    pthread_mutex_lock(&g_reactor.live_lock);
+    n = g_reactor.group[index].viewers;
+    pthread_mutex_unlock(&g_reactor.live_lock);
+    return n;
+}
+
+static int sim_group_queue(int index)
+{
+    int id;
+    pthread_mutex_lock(&g_reactor.live_lock);
+    id = g_reactor.group[index].queue_id;
+    pthread_mutex_unlock(&g_reactor.live_lock);
+    return id;
+}
+
+/*等待 cond 成立，最多 SIM_WAIT_MS*/
+#define SIM_WAIT(cond) do { int _ms = 0; while (!(cond) && _ms < SIM_WAIT_MS) { usleep(1000); _ms++; } } while (0)
+
+/*广播组：三个观看者共用主码流的一个编码队列，后加入的从下一个 I 帧开始，最后一个离开时释放队列*/
+static void sim_group_case(p2p_handle_t *handle)
+{
+    HLE_U8 types[SIM_GROUP_FRAMES];
+    HLE_U32 seqs[SIM_GROUP_FRAMES];
+    HLE_S32 session[3];
+    int fd[3], i, j;
+
+    for (i = 0; i < 3; i++)
+        fd[i] = sim_accept(handle, &session[i]);
+    sim_open_living(fd[0], MAIN_STREAM, 1);
+    SIM_WAIT(2 == sim_enc_get(&sim_queue[0].requested));
+    sim_open_living(fd[1], MAIN_STREAM, 1);
+    SIM_WAIT(1 == sim_enc_get(&sim_queue[0].force_iframe));
+    SIM_CHECK(2 == sim_enc_get(&sim_queue[0].requested));   //第二个观看者只强制 I 帧，不申请队列
+    SIM_CHECK(2 == sim_group_viewers(0));
+
+    /*两个观看者收到相同的帧序列，多帧合成一次 p2p_sendv*/
+    for (i = 0; i < SIM_GROUP_FRAMES; i++)
+        sim_enc_push(0, 0 == i % 20 ? 0xF8 : 0 == i % 3 ? 0xFA : 0xF9, 100 + i);
+    for (j = 0; j < 2; j++)
+    {
+        SIM_CHECK(SIM_GROUP_FRAMES == sim_read_frames(fd[j], types, seqs, SIM_GROUP_FRAMES));
+        for (i = 0; i < SIM_GROUP_FRAMES; i++)
+            SIM_CHECK(100 + i == (int)seqs[i]);
+    }
+    SIM_WAIT(0 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(0 == sim_enc_get(&sim_outstanding));
+
+    /*第三个观看者加入：跳过 I 帧之前的帧，先加入的观看者不受影响*/
+    sim_open_living(fd[2], MAIN_STREAM, 1);
+    SIM_WAIT(2 == sim_enc_get(&sim_queue[0].force_iframe));
+    SIM_CHECK(2 == sim_enc_get(&sim_queue[0].requested) && 3 == sim_group_viewers(0));
+    sim_enc_push(0, 0xF9, 200);
+    sim_enc_push(0, 0xF8, 201);
+    sim_enc_push(0, 0xF9, 202);
+    for (j = 0; j < 2; j++)
+    {
+        SIM_CHECK(3 == sim_read_frames(fd[j], types, seqs, 3));
+        SIM_CHECK(200 == seqs[0] && 202 == seqs[2]);
+    }
+    SIM_CHECK(2 == sim_read_frames(fd[2], types, seqs, 2));
+    SIM_CHECK(0xF8 == types[0] && 201 == seqs[0] && 202 == seqs[1]);
+
+    /*观看者逐个离开，最后一个离开时才释放编码队列*/
+    sim_send_cmd(fd[0], CMD_SET_LIVING_CLOSE, NULL, 0);
+    sim_send_cmd(fd[1], CMD_SET_LOGOUT, NULL, 0);
+    SIM_WAIT(1 == sim_session_num(handle));
+    SIM_WAIT(1 == sim_group_viewers(0));
+    SIM_CHECK(1 == sim_group_viewers(0) && 1 == sim_enc_get(&sim_queue[0].freed));
+    sim_enc_push(0, 0xF9, 203);
+    SIM_CHECK(1 == sim_read_frames(fd[2], types, seqs, 1) && 203 == seqs[0]);
+    sim_send_cmd(fd[2], CMD_SET_LIVING_CLOSE, NULL, 0);
+    SIM_WAIT(2 == sim_enc_get(&sim_queue[0].freed));
+    SIM_CHECK(2 == sim_enc_get(&sim_queue[0].freed) && 0 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(-1 == sim_group_queue(0));
+
+    for (i = 0; i < 3; i++)
+        close(fd[i]);
+    SIM_WAIT(0 == sim_session_num(handle));
+    SIM_CHECK(0 == sim_session_num(handle));
+}
+
+/*信令体分几次到达：反应器不等待，期间照常处理其他会话的信令；信令体超长时断开会话*/
+static void sim_split_case(p2p_handle_t *handle)
+{
+    sim_living_open_t body = {LOWER_STREAM, 1};
+    cmd_header_t header;
+    HLE_S32 sa, sb;
+    int fa, fb;
+
+    fa = sim_accept(handle, &sa);
+    fb = sim_accept(handle, &sb);
+
+    /*a 只发了信令头，b 的 logout 照常处理*/
+    sim_make_header(&header, CMD_GET_LIVING_OPEN, sizeof (body));
+    sim_send_frame(fa, &header, sizeof (header));
+    usleep(50 * 1000);
+    sim_send_cmd(fb, CMD_SET_LOGOUT, NULL, 0);
+    SIM_WAIT(1 == sim_session_num(handle));
+    SIM_CHECK(1 == sim_session_num(handle) && sim_is_closed(fb));
+    SIM_CHECK(1 == sim_enc_get(&sim_queue[1].requested));
+
+    /*a 的信令体分两次到达，收齐后才分发*/
+    sim_send_frame(fa, &body, 3);
+    usleep(50 * 1000);
+    SIM_CHECK(1 == sim_enc_get(&sim_queue[1].requested));
+    sim_send_frame(fa, (char *)&body + 3, sizeof (body) - 3);
+    SIM_WAIT(2 == sim_enc_get(&sim_queue[1].requested));
+    SIM_CHECK(2 == sim_enc_get(&sim_queue[1].requested) && 1 == sim_group_viewers(1));
+
+    /*信令体长度超过 REACTOR_CMD_MAX：无法找到下一条信令，断开会话并释放实时流*/
+    sim_make_header(&header, CMD_GET_LIVING_OPEN, REACTOR_CMD_MAX);
+    sim_send_frame(fa, &header, sizeof (header));
+    SIM_WAIT(0 == sim_session_num(handle));
+    SIM_CHECK(0 == sim_session_num(handle) && sim_is_closed(fa));
+    SIM_CHECK(2 == sim_enc_get(&sim_queue[1].freed) && -1 == sim_group_queue(1));
+
+    close(fa);
+    close(fb);
+}
+
+/*广播组的帧环（反应器停止后直接调用内部函数）：环满时停止取帧，所有观看者都发过的帧才归还*/
+static void sim_group_ring_case(void)
+{
+    reactor_living_t *a = &g_reactor.session[0].living;
+    reactor_living_t *b = &g_reactor.session[1].living;
+    reactor_group_t *group = &g_reactor.group[1];
+    int i;
+
+    memset(a, 0, sizeof (*a));
+    memset(b, 0, sizeof (*b));
+    SIM_CHECK(0 == reactor_living_join(a, 1));
+    SIM_CHECK(0 == reactor_living_join(b, 1));
+    for (i = 0; i < REACTOR_GROUP_RING + 6; i++)
+        sim_enc_push(1, 0xF9, i);
+
+    SIM_CHECK(REACTOR_GROUP_RING == reactor_group_fill(group));
+    SIM_CHECK(0 == reactor_group_fill(group));
+    SIM_CHECK(REACTOR_GROUP_RING == sim_enc_get(&sim_outstanding));
+
+    a->cursor += 10;
+    reactor_group_trim(1);
+    SIM_CHECK(REACTOR_GROUP_RING == sim_enc_get(&sim_outstanding));   //b 还没发
+    b->cursor += 4;
+    reactor_group_trim(1);
+    SIM_CHECK(REACTOR_GROUP_RING - 4 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(4 == reactor_group_fill(group));                        //环里空出 4 帧，取完剩下的帧
+
+    reactor_living_free(b);                                           //只剩 a，归还到 a 的游标
+    SIM_CHECK(REACTOR_GROUP_RING + 4 - 10 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(group->queue_id >= 0 && 1 == group->viewers);
+    reactor_living_free(a);
+    SIM_CHECK(0 == sim_enc_get(&sim_outstanding) && -1 == group->queue_id);
+}
+
+int main(void)
+{
+    p2p_handle_t handle;
+    session_status_t status;
+    HLE_S32 s1, s2;
+    HLE_U8 types[8];
+    HLE_U32 seqs[8];
+    int fd1, fd2, threads, i;
+
+    memset(&handle, 0, sizeof (handle));
+    pthread_mutex_init(&handle.lock, NULL);
+    g_med_ser_envir.encoder_request_stream = sim_enc_request_stream;
+    g_med_ser_envir.encoder_free_stream = sim_enc_free_stream;
+    g_med_ser_envir.encoder_try_get_packet = sim_enc_try_get_packet;
+    g_med_ser_envir.encoder_release_packet = sim_enc_release_packet;
+    g_med_ser_envir.encoder_set_packet_notify = sim_enc_set_packet_notify;
+    g_med_ser_envir.encoder_force_iframe = sim_enc_force_iframe;
+
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.init((const HLE_S8 *)"127.0.0.1:0"));
+    SIM_CHECK(0 == reactor_start(&handle));
+
+    /*1.接入客户端不创建线程，信令由反应器的信令线程处理*/
+    threads = sim_thread_num();
+    fd1 = sim_accept(&handle, &s1);
+    fd2 = sim_accept(&handle, &s2);
+    SIM_CHECK(2 == sim_session_num(&handle));
+    SIM_CHECK(threads == sim_thread_num());
+
+    /*2.主码流不要音频：从 I 帧开始发送，音频帧被过滤*/
+    sim_open_living(fd1, MAIN_STREAM, 0);
+    SIM_WAIT(1 == sim_enc_get(&sim_queue[0].requested));
+    SIM_CHECK(1 == sim_enc_get(&sim_queue[0].requested));
+    sim_enc_push(0, 0xF9, 1);
+    sim_enc_push(0, 0xFA, 2);
+    sim_enc_push(0, 0xF8, 3);
+    sim_enc_push(0, 0xF9, 4);
+    sim_enc_push(0, 0xFA, 5);
+    sim_enc_push(0, 0xF9, 6);
+    SIM_CHECK(3 == sim_read_frames(fd1, types, seqs, 3));
+    SIM_CHECK(0xF8 == types[0] && 3 == seqs[0]);
+    SIM_CHECK(0xF9 == types[1] && 4 == seqs[1]);
+    SIM_CHECK(0xF9 == types[2] && 6 == seqs[2]);
+
+    /*3.子码流要音频：所有帧按顺序发送*/
+    sim_open_living(fd2, LOWER_STREAM, 1);
+    SIM_WAIT(1 == sim_enc_get(&sim_queue[1].requested));
+    sim_enc_push(1, 0xF8, 10);
+    sim_enc_push(1, 0xFA, 11);
+    sim_enc_push(1, 0xF9, 12);
+    SIM_CHECK(3 == sim_read_frames(fd2, types, seqs, 3));
+    for (i = 0; i < 3; i++)
+        SIM_CHECK(10 + i == (int)seqs[i]);
+    SIM_CHECK(0xFA == types[1]);
+    SIM_CHECK(get_session_status(s2, &status) >= 0 && OPEN == status.stream_status && LOWER_STREAM == status.current_stream);
+    SIM_WAIT(0 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(0 == sim_enc_get(&sim_outstanding));
+
+    /*4.logout：会话被清理，编码队列释放，连接关闭*/
+    sim_send_cmd(fd1, CMD_SET_LOGOUT, NULL, 0);
+    SIM_WAIT(1 == sim_session_num(&handle));
+    SIM_CHECK(1 == sim_session_num(&handle));
+    SIM_CHECK(1 == sim_enc_get(&sim_queue[0].freed));
+    SIM_CHECK(get_session_status(s1, &status) < 0);
+    SIM_CHECK(sim_is_closed(fd1));
+    close(fd1);
+
+    /*5.对端关闭：信令线程 poll 到断开后清理会话，所有编码包都已归还*/
+    sim_enc_push(1, 0xF9, 13);
+    close(fd2);
+    SIM_WAIT(0 == sim_session_num(&handle));
+    SIM_CHECK(0 == sim_session_num(&handle));
+    SIM_CHECK(1 == sim_enc_get(&sim_queue[1].freed));
+    SIM_CHECK(0 == sim_enc_get(&sim_outstanding));
+    SIM_CHECK(-1 == sim_group_queue(0) && -1 == sim_group_queue(1));
+
+    /*所有信令都在同一个线程（反应器的信令线程）中处理*/
+    SIM_CHECK(3 == sim_parse_num);
+    for (i = 0; i < sim_parse_num; i++)
+        SIM_CHECK(pthread_equal(sim_parse_tid[i], g_reactor.cmd_tid));
+
+    /*6.广播组*/
+    sim_group_case(&handle);
+
+    /*7.信令体分次到达、超长*/
+    sim_split_case(&handle);
+
+    reactor_stop();
+    SIM_CHECK(threads - 2 == sim_thread_num());
+    sim_group_ring_case();
+    g_p2p_transport_tcp.deinit();
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+/***************************************************************************
+* @file: test_metrics.c
+* @author:
+* @date:  10,19,2026
+* @brief:  运行统计的主机测试：正确性和埋点开销
+* @attention:直接包含 metrics.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "metrics.c"
+
+#define SIM_THREADS		6
+#define SIM_LOOPS		200000
+
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+static HLE_U64 sim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (HLE_U64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*模拟一个埋点密集的热点路径*/
+static void *sim_worker(void *arg)
+{
+	int i, id = (int)(long)arg;
+	volatile HLE_U32 sink = 0;
+
+	for (i = 0; i < SIM_LOOPS; i++)
+	{
+		METRICS_INC(MET_C_VENC_FRAMES);
+		METRICS_ADD(MET_C_NET_BYTES, 100);
+		METRICS_HIST(MET_H_NET_MS, (HLE_U32)(i & 1023));
+		METRICS_GAUGE(MET_G_NET_RING, i & 63);
+		METRICS_TRACE(TRACE_NET_SEND, id, 0xF9, (HLE_U32)i, 100);
+		sink += i;
+	}
+	return NULL;
+}
+
+static double sim_run(int threads)
+{
+	pthread_t tid[SIM_THREADS];
+	HLE_U64 t0 = sim_now_ns();
+	int i;
+
+	for (i = 0; i < threads; i++)
+		pthread_create(&tid[i], NULL, sim_worker, (void *)(long)i);
+	for (i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+	return (double)(sim_now_ns() - t0) / ((double)threads * SIM_LOOPS);
+}
+
+static void sim_collect(json_writer_t *w)
+{
+	json_write_int(w, "queues", 3);
+}
+
+int main(void)
+{
+	char buf[METRICS_JSON_MAX];
+	metrics_trace_rec_t rec[8];
+	metrics_hist_t h;
+	HLE_U64 sum;
+	HLE_U32 cursor;
+	double ns_off, ns_on, ns_trace;
+	int n;
+
+	/*桶的边界*/
+	SIM_CHECK(metrics_bucket(0) == 0);
+	SIM_CHECK(metrics_bucket(1) == 1);
+	SIM_CHECK(metrics_bucket(2) == 2 && metrics_bucket(3) == 2);
+	SIM_CHECK(metrics_bucket(1023) == 10 && metrics_bucket(1024) == 11);
+	SIM_CHECK(metrics_bucket(0xFFFFFFFFu) == METRICS_HIST_BUCKETS - 1);
+
+	/*关闭时的开销*/
+	metrics_set_flags(0);
+	ns_off = sim_run(1);
+	SIM_CHECK(metrics_counter_sum(MET_C_VENC_FRAMES) == 0);
+
+	/*打开时的开销（单线程），然后多线程计数（线程落在不同分片时不会丢计数）*/
+	metrics_set_flags(METRICS_F_ON);
+	ns_on = sim_run(1);
+	metrics_clear();
+	sim_run(SIM_THREADS);
+	printf("venc_frames = %u (expect %u)\n", metrics_counter_sum(MET_C_VENC_FRAMES), SIM_THREADS * SIM_LOOPS);
+	SIM_CHECK(metrics_counter_sum(MET_C_VENC_FRAMES) <= SIM_THREADS * SIM_LOOPS);
+	SIM_CHECK(metrics_counter_sum(MET_C_VENC_FRAMES) >= SIM_THREADS * SIM_LOOPS * 9 / 10);
+
+	metrics_hist_sum(MET_H_NET_MS, &h, &sum);
+	SIM_CHECK(h.count <= SIM_THREADS * SIM_LOOPS && h.count >= SIM_THREADS * SIM_LOOPS * 9 / 10);
+	SIM_CHECK(h.max == 1023);
+	SIM_CHECK(metrics_hist_percentile(&h, 50) == 511);
+	SIM_CHECK(metrics_hist_percentile(&h, 99) == 1023);
+	SIM_CHECK(metrics_ctx.gauge[MET_G_NET_RING].peak == 63);
+
+	/*跟踪*/
+	SIM_CHECK(metrics_set_flags(METRICS_F_ON | METRICS_F_TRACE) == HLE_RET_OK);
+	ns_trace = sim_run(1);
+	sim_run(SIM_THREADS);
+	metrics_set_flags(METRICS_F_ON);
+	SIM_CHECK(metrics_trace_pos() == (SIM_THREADS + 1) * SIM_LOOPS);
+	cursor = 0;
+	n = metrics_trace_read(&cursor, rec, 8);
+	SIM_CHECK(n == 8 && cursor == metrics_trace_pos() - METRICS_TRACE_NUM + 8);
+	SIM_CHECK(rec[0].event == TRACE_NET_SEND && rec[0].type == 0xF9 && rec[0].arg2 == 100 && rec[0].stream < SIM_THREADS);
+	cursor = metrics_trace_pos() - 2;
+	SIM_CHECK(metrics_trace_read(&cursor, rec, 8) == 2);
+	SIM_CHECK(metrics_trace_read(&cursor, rec, 8) == 0);
+
+	/*快照*/
+	SIM_CHECK(metrics_register_collector("sim", sim_collect) == HLE_RET_OK);
+	n = metrics_snapshot(buf, sizeof (buf));
+	SIM_CHECK(n > 0);
+	printf("snapshot %d bytes: %s\n", n, buf);
+	SIM_CHECK(strstr(buf, "\"sim\":{\"queues\":3}") != NULL);
+	SIM_CHECK(metrics_snapshot(buf, 64) < 0);
+	metrics_register_collector("sim", NULL);
+
+	metrics_clear();
+	SIM_CHECK(metrics_counter_sum(MET_C_VENC_FRAMES) == 0);
+
+	printf("per iteration (5 probes): off %.1f ns, on %.1f ns, on+trace %.1f ns\n", ns_off, ns_on, ns_trace);
+	printf("%s: %d error(s)\n", sim_errors ? "FAILED" : "PASSED", sim_errors);
+	return sim_errors ? 1 : 0;
+}
+
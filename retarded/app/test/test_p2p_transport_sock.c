@@ -0,0 +1,234 @@
+/***************************************************************************
+* @file: test_p2p_transport_sock.c
+* @author:
+* @date:  10,19,2026
+* @brief:  P2P 传输层 TCP/UDP 实现的主机测试：建立会话、通道解复用、拆包/粘包、超时、断开、会话 ID 复用
+* @attention:直接包含 p2p_transport_sock.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	客户端按 p2p_transport_sock.c 文件头说明的帧格式直接用 socket 实现。
+***************************************************************************/
+#include "p2p_transport_sock.c"
+
+#include <signal.h>
+
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*---TCP 客户端-------------------------------------------------------------*/
+static int sim_tcp_connect(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = g_sock.local;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*生成一个 TCP 数据帧，返回帧长度*/
+static int sim_tcp_frame(unsigned char *out, int ch, const void *data, int len)
+{
+    out[0] = ch;
+    out[1] = len >> 16;
+    out[2] = len >> 8;
+    out[3] = len;
+    memcpy(out + 4, data, len);
+    return len + 4;
+}
+
+/*读一个 TCP 数据帧，返回数据长度*/
+static int sim_tcp_read_frame(int fd, int *ch, unsigned char *data, int size)
+{
+    unsigned char hdr[4];
+    int len, got = 0;
+
+    if (recv(fd, hdr, 4, MSG_WAITALL) != 4)
+        return -1;
+    *ch = hdr[0];
+    len = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+    if (len > size)
+        return -1;
+    while (got < len)
+    {
+        int n = recv(fd, data + got, len - got, 0);
+        if (n <= 0)
+            return -1;
+        got += n;
+    }
+    return len;
+}
+
+static void sim_tcp_case(void)
+{
+    unsigned char stream[256], buf[256];
+    struct iovec iov[3];
+    struct sockaddr_in remote;
+    HLE_S32 session, size, mode, len, i, ch;
+    int fd;
+
+    printf("tcp\n");
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.init((const HLE_S8 *)"127.0.0.1:0"));
+    SIM_CHECK(ERROR_PPCS_TIME_OUT == g_p2p_transport_tcp.listen(NULL, 0, NULL));
+
+    fd = sim_tcp_connect();
+    SIM_CHECK(fd >= 0);
+    session = g_p2p_transport_tcp.listen(NULL, 1, NULL);
+    SIM_CHECK(session >= 0);
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.check(session, &remote, &mode));
+    SIM_CHECK(htonl(INADDR_LOOPBACK) == remote.sin_addr.s_addr && 0 == mode);
+
+    /*1.两个通道交错，整段数据一个字节一个字节地发（拆包），先读后到的通道*/
+    len = sim_tcp_frame(stream, 0, "login", 5);
+    len += sim_tcp_frame(stream + len, 1, "video-0", 7);
+    len += sim_tcp_frame(stream + len, 0, "!", 1);
+    len += sim_tcp_frame(stream + len, 1, "", 0);
+    len += sim_tcp_frame(stream + len, 1, "video-1", 7);
+    for (i = 0; i < len; i++)
+        SIM_CHECK(1 == send(fd, stream + i, 1, 0));
+    size = 14;
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.read(session, 1, buf, &size, 1000));
+    SIM_CHECK(14 == size && 0 == memcmp(buf, "video-0video-1", 14));
+    /*通道 0 的数据已经在读通道 1 时分发到缓存，不需要再等 socket*/
+    size = 6;
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.read(session, 0, buf, &size, 0));
+    SIM_CHECK(6 == size && 0 == memcmp(buf, "login!", 6));
+
+    /*2.超时：返回已读到的部分*/
+    SIM_CHECK(4 == send(fd, stream, 4, 0) && 2 == send(fd, "ab", 2, 0));
+    size = 5;
+    SIM_CHECK(ERROR_PPCS_TIME_OUT == g_p2p_transport_tcp.read(session, 0, buf, &size, 50));
+    SIM_CHECK(2 == size && 0 == memcmp(buf, "ab", 2));
+    SIM_CHECK(3 == send(fd, "cde", 3, 0));
+    size = 3;
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.read(session, 0, buf, &size, 1000));
+    SIM_CHECK(0 == memcmp(buf, "cde", 3));
+
+    /*3.设备发送：write 一帧，writev 多段合并成一帧*/
+    SIM_CHECK(4 == g_p2p_transport_tcp.write(session, 2, "resp", 4));
+    iov[0].iov_base = "hdr|";
+    iov[0].iov_len = 4;
+    iov[1].iov_base = "";
+    iov[1].iov_len = 0;
+    iov[2].iov_base = "payload";
+    iov[2].iov_len = 7;
+    SIM_CHECK(11 == g_p2p_transport_tcp.writev(session, 1, iov, 3));
+    SIM_CHECK(4 == sim_tcp_read_frame(fd, &ch, buf, sizeof (buf)) && 2 == ch && 0 == memcmp(buf, "resp", 4));
+    SIM_CHECK(11 == sim_tcp_read_frame(fd, &ch, buf, sizeof (buf)) && 1 == ch && 0 == memcmp(buf, "hdr|payload", 11));
+    SIM_CHECK(ERROR_PPCS_INVALID_PARAMETER == g_p2p_transport_tcp.write(session, P2P_TRANSPORT_CH_NUM, "x", 1));
+
+    /*4.对端关闭：缓存中的数据读完后返回远端关闭*/
+    len = sim_tcp_frame(stream, 3, "bye", 3);
+    SIM_CHECK(len == send(fd, stream, len, 0));
+    close(fd);
+    size = 10;
+    SIM_CHECK(ERROR_PPCS_SESSION_CLOSED_REMOTE == g_p2p_transport_tcp.read(session, 3, buf, &size, 1000));
+    SIM_CHECK(3 == size && 0 == memcmp(buf, "bye", 3));
+    SIM_CHECK(ERROR_PPCS_SESSION_CLOSED_REMOTE == g_p2p_transport_tcp.check(session, NULL, NULL));
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.close(session));
+
+    /*5.会话槽位复用后，旧的会话 ID 不能再操作新会话*/
+    fd = sim_tcp_connect();
+    i = g_p2p_transport_tcp.listen(NULL, 1, NULL);
+    SIM_CHECK(i >= 0 && i != session && i % P2P_SOCK_MAX_SESSION == session % P2P_SOCK_MAX_SESSION);
+    SIM_CHECK(ERROR_PPCS_INVALID_SESSION_HANDLE == g_p2p_transport_tcp.write(session, 0, "x", 1));
+    SIM_CHECK(ERROR_PPCS_INVALID_SESSION_HANDLE == g_p2p_transport_tcp.close(session));
+
+    /*6.非法的通道号：会话断开*/
+    stream[0] = P2P_TRANSPORT_CH_NUM;
+    stream[1] = stream[2] = 0;
+    stream[3] = 1;
+    SIM_CHECK(5 == send(fd, stream, 5, 0));
+    size = 1;
+    SIM_CHECK(ERROR_PPCS_SESSION_CLOSED_INSUFFICIENT_MEMORY == g_p2p_transport_tcp.read(session = i, 0, buf, &size, 1000));
+    close(fd);
+
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_tcp.deinit());
+    SIM_CHECK(ERROR_PPCS_INVALID_SESSION_HANDLE == g_p2p_transport_tcp.check(session, NULL, NULL));
+}
+
+/*---UDP 客户端-------------------------------------------------------------*/
+static int sim_udp_send(int fd, int ch, int flag, int seq, const void *data, int len)
+{
+    unsigned char pkt[SOCK_RX_BUF_SIZE];
+
+    pkt[0] = ch;
+    pkt[1] = flag;
+    pkt[2] = seq >> 8;
+    pkt[3] = seq;
+    if (len > 0)
+        memcpy(pkt + 4, data, len);
+    return send(fd, pkt, len + 4, 0) == len + 4 ? 0 : -1;
+}
+
+static void sim_udp_case(void)
+{
+    unsigned char big[P2P_UDP_MTU * 2 + 100], pkt[SOCK_RX_BUF_SIZE], buf[256];
+    struct sockaddr_in addr;
+    struct timeval tv = {1, 0};
+    HLE_S32 session, size, i, n;
+    int fd;
+
+    printf("udp\n");
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_udp.init((const HLE_S8 *)"127.0.0.1:0"));
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    addr = g_sock.local;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, (struct sockaddr *)&addr, sizeof (addr));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+    /*1.HELLO 握手：会话建立前的数据报丢弃，设备回 HELLO*/
+    SIM_CHECK(0 == sim_udp_send(fd, 0, SOCK_UDP_DATA, 0, "early", 5));
+    SIM_CHECK(0 == sim_udp_send(fd, 0, SOCK_UDP_HELLO, 0, NULL, 0));
+    session = g_p2p_transport_udp.listen(NULL, 1, NULL);
+    SIM_CHECK(session >= 0);
+    SIM_CHECK(4 == recv(fd, pkt, sizeof (pkt), 0) && SOCK_UDP_HELLO == pkt[1]);
+
+    /*2.数据按通道分发，序号不连续时记为丢包*/
+    SIM_CHECK(0 == sim_udp_send(fd, 1, SOCK_UDP_DATA, 0, "abc", 3));
+    SIM_CHECK(0 == sim_udp_send(fd, 0, SOCK_UDP_DATA, 1, "cmd", 3));
+    SIM_CHECK(0 == sim_udp_send(fd, 1, SOCK_UDP_DATA, 4, "def", 3));
+    size = 6;
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_udp.read(session, 1, buf, &size, 1000));
+    SIM_CHECK(0 == memcmp(buf, "abcdef", 6));
+    size = 3;
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_udp.read(session, 0, buf, &size, 0));
+    SIM_CHECK(0 == memcmp(buf, "cmd", 3));
+    SIM_CHECK(2 == sock_find(session)->rx_lost);
+
+    /*3.设备发送：超过 MTU 的数据拆成多个数据报，序号递增*/
+    for (i = 0; i < (int)sizeof (big); i++)
+        big[i] = i;
+    SIM_CHECK((int)sizeof (big) == g_p2p_transport_udp.write(session, 2, big, sizeof (big)));
+    for (i = 0, size = 0; size < (int)sizeof (big); i++)
+    {
+        n = recv(fd, pkt, sizeof (pkt), 0);
+        SIM_CHECK(n > 4 && n <= P2P_UDP_MTU + 4 && 2 == pkt[0] && SOCK_UDP_DATA == pkt[1]);
+        SIM_CHECK(i == ((pkt[2] << 8) | pkt[3]));
+        if (n <= 4)
+            break;
+        SIM_CHECK(0 == memcmp(pkt + 4, big + size, n - 4));
+        size += n - 4;
+    }
+    SIM_CHECK(3 == i);
+
+    /*4.BYE：会话断开*/
+    SIM_CHECK(0 == sim_udp_send(fd, 0, SOCK_UDP_BYE, 0, NULL, 0));
+    size = 1;
+    SIM_CHECK(ERROR_PPCS_SESSION_CLOSED_REMOTE == g_p2p_transport_udp.read(session, 0, buf, &size, 1000));
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_udp.close(session));
+    close(fd);
+    SIM_CHECK(ERROR_PPCS_SUCCESSFUL == g_p2p_transport_udp.deinit());
+}
+
+int main(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+    sim_tcp_case();
+    sim_udp_case();
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+/***************************************************************************
+* @file: test_parameter.c
+* @author:
+* @date:  10,19,2026
+* @brief:  参数日志的主机测试：旧参数文件迁移、连续修改合并成一条记录、重启后恢复、
+		   日志尾部损坏只丢最后一条记录、A/B 交替整理、读快照不会读到写了一半的结构体
+* @attention:直接包含 parameter.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	参数文件放在 bin/param（PARAM_DIR），每次运行前清空。
+***************************************************************************/
+#define PARAM_DIR           "bin/param"
+#include "parameter.c"
+
+#define SIM_RECORD_SIZE     (sizeof (param_record_t) + sizeof (Light_parameter_t))
+#define SIM_SAVES           20000
+#define SIM_READERS         3
+#define SIM_READ_MS         200
+
+static int sim_errors;
+static int sim_stop;
+static long long sim_reads;
+static int sim_torn;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+static long sim_file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) < 0 ? -1 : (long)st.st_size;
+}
+
+/*LED 灯参数的每个字段都填 v，读者据此判断有没有读到写了一半的结构体*/
+static void sim_light(Light_parameter_t *light, int v)
+{
+    int *p = (int *)light;
+    unsigned i;
+    for (i = 0; i < sizeof (*light) / sizeof (int); i++)
+        p[i] = v;
+}
+
+static int sim_light_value(const Light_parameter_t *light)
+{
+    const int *p = (const int *)light;
+    unsigned i;
+    for (i = 1; i < sizeof (*light) / sizeof (int); i++)
+    {
+        if (p[i] != p[0])
+            return -1;
+    }
+    return p[0];
+}
+
+/*模拟重启：停止提交线程并写入未提交的修改，清掉内存中的日志状态后重新加载*/
+static void sim_reboot(void)
+{
+    SIM_CHECK(0 == sys_param_exit());
+    memset(&g_param_log, 0, sizeof (g_param_log));
+    g_param_log.active = -1;
+    memset(&g_sys_param, 0, sizeof (g_sys_param));
+    SIM_CHECK(0 == sys_param_init());
+}
+
+static void *sim_reader(void *arg)
+{
+    long long n = 0;
+
+    while (!__atomic_load_n(&sim_stop, __ATOMIC_RELAXED))
+    {
+        Light_parameter_t light;
+        SIM_CHECK(0 == get_Light_param(&light));
+        if (sim_light_value(&light) < 0)
+            __atomic_add_fetch(&sim_torn, 1, __ATOMIC_RELAXED);
+        n++;
+    }
+    __atomic_add_fetch(&sim_reads, n, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(void)
+{
+    system_parameter_t param;
+    Light_parameter_t light;
+    Net_parameter_t net;
+    pthread_t tid[SIM_READERS];
+    long size, waited;
+    int i, fd, active, generation, flips;
+
+    system("rm -rf " PARAM_DIR " && mkdir -p " PARAM_DIR);
+
+    /*1.第一次启动：旧格式的参数文件迁移到日志后删除*/
+    param_set_default(&param);
+    param.Light_param.brightness = 77;
+    strcpy(param.Net_param.ssid, "legacy");
+    fd = open(SYS_PARAM_FILE, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    SIM_CHECK(fd >= 0 && write(fd, &param, sizeof (param)) == sizeof (param));
+    close(fd);
+    SIM_CHECK(0 == sys_param_init());
+    SIM_CHECK(0 != access(SYS_PARAM_FILE, F_OK));
+    SIM_CHECK(0 == g_param_log.active && 1 == g_param_log.generation);
+    SIM_CHECK(0 == get_sys_param(&param));
+    SIM_CHECK(77 == param.Light_param.brightness && 0 == strcmp(param.Net_param.ssid, "legacy"));
+
+    /*2.连续修改只写一条记录（get/save 拷贝整个结构体）*/
+    size = sim_file_size(PARAM_LOG_FILE_A);
+    for (i = 1; i <= SIM_SAVES; i++)
+    {
+        sim_light(&light, i);
+        SIM_CHECK(0 == save_Light_param(&light));
+    }
+    SIM_CHECK(0 == get_Light_param(&light) && SIM_SAVES == sim_light_value(&light));
+    SIM_CHECK(size == sim_file_size(PARAM_LOG_FILE_A));     //还没写
+    SIM_CHECK(0 == sys_param_flush());
+    SIM_CHECK(size + (long)SIM_RECORD_SIZE == sim_file_size(PARAM_LOG_FILE_A));
+    printf("%d saves -> one %ld byte record\n", SIM_SAVES, sim_file_size(PARAM_LOG_FILE_A) - size);
+
+    /*内容没变的分区不写；提交线程在最后一次修改 PARAM_COMMIT_DELAY 之后写入*/
+    SIM_CHECK(0 == get_sys_param(&param));
+    SIM_CHECK(0 == save_sys_param(&param) && 0 == g_param_log.dirty);
+    size = sim_file_size(PARAM_LOG_FILE_A);
+    SIM_CHECK(0 == get_Net_param(&net));
+    strcpy(net.ssid, "committed");
+    SIM_CHECK(0 == save_Net_param(&net));
+    for (waited = 0; waited < PARAM_COMMIT_DELAY + 1000 && size == sim_file_size(PARAM_LOG_FILE_A); waited += 10)
+        usleep(10 * 1000);
+    SIM_CHECK(waited >= PARAM_COMMIT_DELAY - 100 && waited < PARAM_COMMIT_DELAY + 1000);
+    SIM_CHECK(size + (long)(sizeof (param_record_t) + sizeof (Net_parameter_t)) == sim_file_size(PARAM_LOG_FILE_A));
+
+    /*3.重启后恢复*/
+    sim_reboot();
+    SIM_CHECK(0 == get_Net_param(&net) && 0 == strcmp(net.ssid, "committed"));
+    SIM_CHECK(0 == get_Light_param(&light) && SIM_SAVES == sim_light_value(&light));
+    SIM_CHECK(0 == g_param_log.active && 0 == g_param_log.need_compact);
+
+    /*4.日志尾部损坏（掉电）：只丢最后一条记录，整理到另一个文件*/
+    sim_light(&light, 5);
+    SIM_CHECK(0 == save_Light_param(&light) && 0 == sys_param_flush());
+    sim_light(&light, 6);
+    SIM_CHECK(0 == save_Light_param(&light) && 0 == sys_param_flush());
+    size = sim_file_size(PARAM_LOG_FILE_A);
+    SIM_CHECK(0 == truncate(PARAM_LOG_FILE_A, size - 10));
+    sim_reboot();
+    SIM_CHECK(0 == get_Light_param(&light) && 5 == sim_light_value(&light));
+    SIM_CHECK(0 == get_Net_param(&net) && 0 == strcmp(net.ssid, "committed"));
+    SIM_CHECK(1 == g_param_log.active && 2 == g_param_log.generation && 0 == g_param_log.need_compact);
+
+    /*B 的文件头损坏：回到 A（A 的尾部仍然是坏的，再整理一次）*/
+    fd = open(PARAM_LOG_FILE_B, O_WRONLY);
+    SIM_CHECK(fd >= 0 && 4 == write(fd, "XXXX", 4));
+    close(fd);
+    sim_reboot();
+    SIM_CHECK(0 == get_Light_param(&light) && 5 == sim_light_value(&light));
+    SIM_CHECK(1 == g_param_log.active && 2 == g_param_log.generation);
+
+    /*5.日志写满时 A/B 交替整理，整理后参数不变*/
+    active = g_param_log.active;
+    generation = g_param_log.generation;
+    flips = 0;
+    for (i = 0; i < 600; i++)
+    {
+        sim_light(&light, 1000 + i);
+        SIM_CHECK(0 == save_Light_param(&light) && 0 == sys_param_flush());
+        SIM_CHECK(g_param_log.log_size <= PARAM_LOG_MAX_SIZE);
+        if (g_param_log.active != active)
+        {
+            active = g_param_log.active;
+            flips++;
+        }
+    }
+    SIM_CHECK(flips >= 2 && generation + flips == (int)g_param_log.generation);
+    printf("600 flushes: %d compactions, generation %u\n", flips, g_param_log.generation);
+    sim_reboot();
+    SIM_CHECK(0 == get_Light_param(&light) && 1599 == sim_light_value(&light));
+    SIM_CHECK(0 == get_Net_param(&net) && 0 == strcmp(net.ssid, "committed"));
+    SIM_CHECK(active == g_param_log.active);
+
+    /*6.读快照：写者不停修改时，读者不会读到写了一半的结构体*/
+    sim_stop = 0;
+    for (i = 0; i < SIM_READERS; i++)
+        pthread_create(&tid[i], NULL, sim_reader, NULL);
+    for (i = 0; i < SIM_READ_MS; i++)
+    {
+        int j;
+        for (j = 0; j < 3; j++)
+        {
+            sim_light(&light, i * 3 + j);
+            save_Light_param(&light);
+        }
+        usleep(1000);
+    }
+    __atomic_store_n(&sim_stop, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < SIM_READERS; i++)
+        pthread_join(tid[i], NULL);
+    SIM_CHECK(0 == sim_torn && sim_reads > 0);
+    printf("%lld snapshot reads, %d torn\n", sim_reads, sim_torn);
+
+    SIM_CHECK(0 == sys_param_exit());
+    system("rm -rf " PARAM_DIR);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/***************************************************************************
+* @file: test_pcm_resample.c
+* @author:
+* @date:  10,19,2026
+* @brief:  PCM 重采样的主机测试：正弦信号的信噪比、输出长度、分块与整块结果一致、直流增益、吞吐
+* @attention:直接包含 pcm_resample.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	信噪比：输出按已知频率做最小二乘拟合（a*sin + b*cos，不需要知道滤波器延迟），
+	拟合残差作为噪声。跳过开头的滤波器建立过程。
+***************************************************************************/
+#include <stdio.h>
+#include <time.h>
+#include "pcm_resample.c"
+
+#define SIM_SECONDS         2
+#define SIM_TONE_HZ         1000.0
+#define SIM_AMPLITUDE       16000.0
+#define SIM_SKIP            256         //跳过的输出样本数（滤波器建立）
+#define SIM_SNR_MIN         70.0        //dB
+#define SIM_BENCH_SAMPLES   (4*1024*1024)
+
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+static double sim_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sim_tone(short *buf, int samples, int channels, int rate)
+{
+    int i, ch;
+    for (i = 0; i < samples; i++)
+    {
+        double v = SIM_AMPLITUDE * sin(2.0 * M_PI * SIM_TONE_HZ * i / rate);
+        for (ch = 0; ch < channels; ch++)
+            buf[i * channels + ch] = (short)lrint(ch ? -v : v);
+    }
+}
+
+/*一个声道的信噪比（dB）：最小二乘拟合已知频率的正弦，残差为噪声*/
+static double sim_snr(const short *buf, int samples, int channels, int ch, int rate)
+{
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, a, b, det, sig = 0, noise = 0;
+    int i;
+
+    for (i = SIM_SKIP; i < samples; i++)
+    {
+        double s = sin(2.0 * M_PI * SIM_TONE_HZ * i / rate);
+        double c = cos(2.0 * M_PI * SIM_TONE_HZ * i / rate);
+        double y = buf[i * channels + ch];
+        ss += s * s; cc += c * c; sc += s * c; ys += y * s; yc += y * c;
+    }
+    det = ss * cc - sc * sc;
+    a = (ys * cc - yc * sc) / det;
+    b = (yc * ss - ys * sc) / det;
+    for (i = SIM_SKIP; i < samples; i++)
+    {
+        double s = sin(2.0 * M_PI * SIM_TONE_HZ * i / rate);
+        double c = cos(2.0 * M_PI * SIM_TONE_HZ * i / rate);
+        double fit = a * s + b * c;
+        double e = buf[i * channels + ch] - fit;
+        sig += fit * fit;
+        noise += e * e;
+    }
+    return 10.0 * log10(sig / (noise > 1e-9 ? noise : 1e-9));
+}
+
+/*整段信号分不规则的块送入重采样，检查长度和信噪比；再整块送一次，结果应逐样本相同*/
+static void sim_case(int in_rate, int out_rate, int channels)
+{
+    int in_samples = in_rate * SIM_SECONDS;
+    int out_size = (int)((long long)in_samples * out_rate / in_rate) + 64;
+    short *in = (short *)malloc(in_samples * channels * sizeof(short));
+    short *out = (short *)malloc(out_size * channels * sizeof(short));
+    short *whole = (short *)malloc(out_size * channels * sizeof(short));
+    pcm_resample_t *rs = pcm_resample_create(in_rate, out_rate, channels);
+    pcm_resample_stat_t stat;
+    int pos = 0, step = 1, out_cnt = 0, whole_cnt, ch;
+    long long expect;
+    double snr = 1e9;
+
+    SIM_CHECK(rs != NULL && in && out && whole);
+    if (NULL == rs || !in || !out || !whole)
+        goto out;
+
+    sim_tone(in, in_samples, channels, in_rate);
+    while (pos < in_samples)
+    {
+        int n = in_samples - pos < step ? in_samples - pos : step;
+        int ret = pcm_resample_process(rs, in + pos * channels, n, out + out_cnt * channels,
+                                       out_size - out_cnt);
+        SIM_CHECK(ret >= 0 && ret <= pcm_resample_max_output(rs, n));
+        if (ret < 0)
+            goto out;
+        out_cnt += ret;
+        pos += n;
+        step = step * 5 % 997 + 1;
+    }
+
+    /*输出长度：in * L / M，误差不超过 1 个样本*/
+    expect = (long long)in_samples * out_rate / in_rate;
+    SIM_CHECK(out_cnt >= expect - 1 && out_cnt <= expect + 1);
+    pcm_resample_get_stat(rs, &stat);
+    SIM_CHECK(stat.in_samples == (unsigned long long)in_samples && stat.out_samples == (unsigned long long)out_cnt);
+    SIM_CHECK(0 == stat.clipped);
+
+    for (ch = 0; ch < channels; ch++)
+    {
+        double s = sim_snr(out, out_cnt, channels, ch, out_rate);
+        if (s < snr)
+            snr = s;
+    }
+    SIM_CHECK(snr >= SIM_SNR_MIN);
+
+    pcm_resample_reset(rs);
+    whole_cnt = pcm_resample_process(rs, in, in_samples, whole, out_size);
+    SIM_CHECK(whole_cnt == out_cnt);
+    SIM_CHECK(whole_cnt == out_cnt && 0 == memcmp(whole, out, out_cnt * channels * sizeof(short)));
+
+    printf("%5d -> %5d x%d: L/M %d/%d, %d -> %d samples, SNR %.1f dB\n",
+           in_rate, out_rate, channels, stat.up, stat.down, in_samples, out_cnt, snr);
+out:
+    pcm_resample_destroy(rs);
+    free(in);
+    free(out);
+    free(whole);
+}
+
+/*恒定输入，稳定后输出严格等于输入（每个相位直流增益为 1）*/
+static void sim_dc(int in_rate, int out_rate)
+{
+    short in[6000];
+    pcm_resample_t *rs = pcm_resample_create(in_rate, out_rate, 1);
+    short *out = (short *)malloc(pcm_resample_max_output(rs, 6000) * sizeof(short));
+    int i, n, bad = 0;
+
+    SIM_CHECK(rs != NULL && out != NULL);
+    if (rs && out)
+    {
+        for (i = 0; i < 6000; i++)
+            in[i] = -12345;
+        n = pcm_resample_process(rs, in, 6000, out, pcm_resample_max_output(rs, 6000));
+        for (i = SIM_SKIP; i < n; i++)
+            bad += (out[i] != -12345);
+        SIM_CHECK(n > SIM_SKIP && 0 == bad);
+    }
+    pcm_resample_destroy(rs);
+    free(out);
+}
+
+static void sim_bench(int in_rate, int out_rate)
+{
+    pcm_resample_t *rs = pcm_resample_create(in_rate, out_rate, 1);
+    short *in = (short *)malloc(SIM_BENCH_SAMPLES * sizeof(short));
+    short *out = (short *)malloc(pcm_resample_max_output(rs, SIM_BENCH_SAMPLES) * sizeof(short));
+    double t;
+    int n;
+
+    SIM_CHECK(rs && in && out);
+    if (rs && in && out)
+    {
+        sim_tone(in, SIM_BENCH_SAMPLES, 1, in_rate);
+        t = sim_now();
+        n = pcm_resample_process(rs, in, SIM_BENCH_SAMPLES, out, pcm_resample_max_output(rs, SIM_BENCH_SAMPLES));
+        t = sim_now() - t;
+        SIM_CHECK(n > 0);
+        printf("bench %5d -> %5d: %.1f Msamples/s in, %.1f Msamples/s out\n",
+               in_rate, out_rate, SIM_BENCH_SAMPLES / t / 1e6, n / t / 1e6);
+    }
+    pcm_resample_destroy(rs);
+    free(in);
+    free(out);
+}
+
+int main(void)
+{
+    pcm_resample_t *rs;
+    short buf[16];
+
+    /*参数检查*/
+    SIM_CHECK(NULL == pcm_resample_create(0, 16000, 1));
+    SIM_CHECK(NULL == pcm_resample_create(16000, 16000, 3));
+    SIM_CHECK(NULL == pcm_resample_create(44100, 44101, 1));    //约分后相位数太多
+    rs = pcm_resample_create(16000, 48000, 1);
+    SIM_CHECK(rs != NULL && pcm_resample_process(rs, buf, 16, buf, 16) < 0);  //输出空间不足
+    pcm_resample_destroy(rs);
+
+    sim_case(44100, 48000, 1);
+    sim_case(16000, 44100, 1);
+    sim_case(8000, 48000, 1);
+    sim_case(48000, 16000, 1);
+    sim_case(16000, 16000, 1);
+    sim_case(22050, 16000, 2);
+    sim_dc(8000, 44100);
+    sim_dc(48000, 8000);
+
+    sim_bench(16000, 48000);
+    sim_bench(44100, 48000);
+    sim_bench(48000, 16000);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
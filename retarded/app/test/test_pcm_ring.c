@@ -0,0 +1,144 @@
+/***************************************************************************
+* @file: test_pcm_ring.c
+* @author:
+* @date:  10,19,2026
+* @brief:  PCM 环形缓存的主机测试：AI 线程和 AAC 编码线程并发读写，消费者停顿时整帧丢弃，
+		   读出的每个样本和时间戳都与采集时一致，只有一处不连续
+* @attention:直接包含 pcm_ring.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	1.生产者每 3ms 写一帧 480 个样本（16K 采样 30ms 的数据，按 10 倍速送），共 1500 帧；
+	  样本值为采集序号（低 16 位），时间戳为采集序号 / 采样率。
+	2.消费者每次取 1024 个样本（AAC 一帧），中途停顿 400ms 使缓存溢出。
+	3.用 make SAN=thread 检查无锁读写。
+***************************************************************************/
+#include <unistd.h>
+#include "pcm_ring.c"
+
+#define SIM_RATE            16000
+#define SIM_FRAMES          1500
+#define SIM_FRAME_SAMPLES   480
+#define SIM_FRAME_US        3000            //生产者写一帧的间隔
+#define SIM_READ_SAMPLES    1024
+#define SIM_STALL_AT        100             //消费者取到第 N 帧后停顿
+#define SIM_STALL_MS        400
+#define SIM_TOTAL           (SIM_FRAMES * SIM_FRAME_SAMPLES)
+#define SIM_READS_MAX       (SIM_TOTAL / SIM_READ_SAMPLES)
+
+static pcm_ring_t sim_ring;
+static int sim_errors;
+static int sim_done;
+static char sim_accepted[SIM_FRAMES];                   //生产者：每帧是否写入成功
+static unsigned int sim_dropped_frames;
+static short sim_out[SIM_READS_MAX * SIM_READ_SAMPLES]; //消费者取出的全部样本
+static unsigned long long sim_pts[SIM_READS_MAX];
+static int sim_reads;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*采集序号对应的时间戳（us）*/
+static unsigned long long sim_index_pts(unsigned int index)
+{
+    return (unsigned long long)index * 1000000ULL / SIM_RATE;
+}
+
+static void sim_sleep_until(struct timespec *ts, long us)
+{
+    ts->tv_nsec += us * 1000;
+    while (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ts, NULL);
+}
+
+/*AI 采集线程：按绝对时间每 SIM_FRAME_US 写一帧*/
+static void *sim_producer(void *arg)
+{
+    short frame[SIM_FRAME_SAMPLES];
+    struct timespec ts;
+    int i, k;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (i = 0; i < SIM_FRAMES; i++)
+    {
+        unsigned int index = i * SIM_FRAME_SAMPLES;
+        for (k = 0; k < SIM_FRAME_SAMPLES; k++)
+            frame[k] = (short)(index + k);
+        if (0 == pcm_ring_write(&sim_ring, frame, SIM_FRAME_SAMPLES, sim_index_pts(index)))
+            sim_accepted[i] = 1;
+        else
+            sim_dropped_frames++;
+        sim_sleep_until(&ts, SIM_FRAME_US);
+    }
+    __atomic_store_n(&sim_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/*AAC 编码线程：生产者结束且剩余不足一帧时退出*/
+static void *sim_consumer(void *arg)
+{
+    while (sim_reads < SIM_READS_MAX)
+    {
+        if (__atomic_load_n(&sim_done, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&sim_ring.head, __ATOMIC_ACQUIRE) - sim_ring.tail < SIM_READ_SAMPLES)
+            break;
+        if (pcm_ring_read(&sim_ring, sim_out + sim_reads * SIM_READ_SAMPLES, SIM_READ_SAMPLES, &sim_pts[sim_reads]) < 0)
+            continue;
+        if (++sim_reads == SIM_STALL_AT)
+            usleep(SIM_STALL_MS * 1000);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    static unsigned int expect[SIM_TOTAL];  //写入成功的样本的采集序号，按写入顺序
+    pthread_t ptid, ctid;
+    unsigned int frames, samples, n, j;
+    int i, k, gaps = 0, bad_data = 0, bad_pts = 0;
+
+    SIM_CHECK(pcm_ring_init(&sim_ring, 0) < 0 && pcm_ring_init(NULL, SIM_RATE) < 0);
+    SIM_CHECK(0 == pcm_ring_init(&sim_ring, SIM_RATE));
+
+    pthread_create(&ctid, NULL, sim_consumer, NULL);
+    pthread_create(&ptid, NULL, sim_producer, NULL);
+    pthread_join(ptid, NULL);
+    pthread_join(ctid, NULL);
+
+    /*写入成功的样本按顺序排成一个序列，取出的样本应当是它的前缀*/
+    n = 0;
+    for (i = 0; i < SIM_FRAMES; i++)
+    {
+        for (k = 0; sim_accepted[i] && k < SIM_FRAME_SAMPLES; k++)
+            expect[n++] = i * SIM_FRAME_SAMPLES + k;
+    }
+    SIM_CHECK(n == sim_ring.head);
+    SIM_CHECK((unsigned int)sim_reads * SIM_READ_SAMPLES == sim_ring.tail);
+    SIM_CHECK(n - sim_ring.tail < SIM_READ_SAMPLES);
+
+    for (j = 0; j < sim_ring.tail; j++)
+    {
+        if (sim_out[j] != (short)expect[j])
+            bad_data++;
+        if (j > 0 && expect[j] != expect[j - 1] + 1)
+            gaps++;
+    }
+    for (i = 0; i < sim_reads; i++)
+    {
+        if (sim_pts[i] != sim_index_pts(expect[i * SIM_READ_SAMPLES]))
+            bad_pts++;
+    }
+
+    /*编码的 + 丢弃的 + 缓存中剩余的 = 采集的全部样本*/
+    SIM_CHECK(0 == pcm_ring_get_overrun(&sim_ring, &frames, &samples));
+    SIM_CHECK(frames == sim_dropped_frames && samples == frames * SIM_FRAME_SAMPLES);
+    SIM_CHECK(sim_ring.tail + samples + (n - sim_ring.tail) == SIM_TOTAL);
+    SIM_CHECK(frames > 0);
+    SIM_CHECK(1 == gaps);
+    SIM_CHECK(0 == bad_data && 0 == bad_pts);
+    printf("%d reads, %u dropped frames (%u samples), %d gaps, %d data / %d pts mismatches\n",
+           sim_reads, frames, samples, gaps, bad_data, bad_pts);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
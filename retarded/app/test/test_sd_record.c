@@ -0,0 +1,301 @@
+/***************************************************************************
+* @file: test_sd_record.c
+* @author:
+* @date:  10,19,2026
+* @brief:  SD 卡连续录像的主机测试（镜像文件上运行 FatFs）
+* @attention:直接包含 sd_record.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "sd_record.c"
+
+#include <fcntl.h>
+
+#define HARNESS_SEG_SIZE    (8*1024*1024)
+#define HARNESS_FPS         25
+#define HARNESS_GOP         50
+#define HARNESS_BASE_MS     1760000000000ULL
+#define HARNESS_MAX_FRAME   (160*1024)
+
+static int harness_fail;
+
+#define HARNESS_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); harness_fail++; } } while (0)
+
+/*模拟 4Mbps 码流：每 GOP 一个约 110KB 的 I 帧，P 帧 12~20KB；内容为帧号 + 与帧号相关的填充*/
+static int harness_frame(HLE_U32 n, HLE_U8 *buf, int *key)
+{
+    int len;
+
+    *key = (0 == n % HARNESS_GOP);
+    len = *key ? 100*1024 + (int)(n * 37 % 20000) : 12*1024 + (int)(n * 7919 % 8192);
+    memset(buf, (int)(n * 131), len);
+    memcpy(buf, &n, sizeof (n));
+    return len;
+}
+
+static HLE_U64 harness_time(HLE_U32 n)
+{
+    return HARNESS_BASE_MS + (HLE_U64)n * 1000 / HARNESS_FPS;
+}
+
+static int harness_verify(const HLE_U8 *buf, int len, HLE_U32 *n)
+{
+    memcpy(n, buf, sizeof (*n));
+    return len > 8 && buf[len - 1] == (HLE_U8)(*n * 131) && buf[len / 2] == (HLE_U8)(*n * 131);
+}
+
+static double harness_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*写入 [from, to) 帧，pace_us 为每帧间隔（0 为不限速），返回送帧的最长耗时（ms）*/
+static double harness_feed(HLE_U8 *buf, HLE_U32 from, HLE_U32 to, int pace_us, HLE_U32 *dropped)
+{
+    double t0, t, max = 0, next = harness_sec();
+    HLE_U32 n;
+    int len, key, ret;
+
+    for (n = from; n < to; n++)
+    {
+        len = harness_frame(n, buf, &key);
+        t0 = harness_sec();
+        ret = sd_rec_put(buf, len, key, harness_time(n));
+        t = harness_sec() - t0;
+        if (t > max)
+            max = t;
+        if (HLE_RET_EBUSY == ret)
+            (*dropped)++;
+        else if (ret < 0)
+        {
+            printf("sd_rec_put frame %u: %d\n", n, ret);
+            harness_fail++;
+            break;
+        }
+
+        if (pace_us > 0)
+        {
+            next += pace_us / 1e6;
+            t = next - harness_sec();
+            if (t > 0)
+                usleep((useconds_t)(t * 1e6));
+        }
+    }
+
+    return max * 1000;
+}
+
+/*从 time 开始顺序读到最新，检查帧号连续，返回读到的帧数*/
+static HLE_U32 harness_read_all(HLE_U8 *buf, HLE_U32 time, HLE_U32 *first, HLE_U32 *last)
+{
+    sd_rec_pos_t pos;
+    HLE_U64 time_ms;
+    HLE_U32 n, count = 0;
+    int len, key;
+
+    HARNESS_CHECK(sd_rec_find(time, &pos) == 0);
+    while ((len = sd_rec_read(&pos, buf, HARNESS_MAX_FRAME, &time_ms, &key)) > 0)
+    {
+        HARNESS_CHECK(harness_verify(buf, len, &n));
+        HARNESS_CHECK(time_ms == harness_time(n));
+        HARNESS_CHECK(key == (0 == n % HARNESS_GOP));
+        if (0 == count)
+        {
+            HARNESS_CHECK(key);
+            *first = n;
+        }
+        else if (n != *last + 1)
+        {
+            printf("gap: frame %u after %u\n", n, *last);
+            harness_fail++;
+        }
+        *last = n;
+        count++;
+    }
+    HARNESS_CHECK(0 == len);
+    return count;
+}
+
+/*按随机时间查找：第一帧是关键帧，时间不晚于查找时间且相差不超过 GOP + 索引间隔*/
+static void harness_seek(HLE_U8 *buf, int times)
+{
+    sd_rec_status_t st;
+    sd_rec_pos_t pos;
+    HLE_U64 time_ms;
+    HLE_U32 t, n, late = 0;
+    int i, len, key;
+
+    sd_rec_get_status(&st);
+    for (i = 0; i < times; i++)
+    {
+        t = st.oldest + 1 + (HLE_U32)rand() % (st.newest - st.oldest);
+        HARNESS_CHECK(sd_rec_find(t, &pos) == 0);
+        len = sd_rec_read(&pos, buf, HARNESS_MAX_FRAME, &time_ms, &key);
+        HARNESS_CHECK(len > 0 && harness_verify(buf, len, &n) && key);
+        if (time_ms / 1000 > t || t - time_ms / 1000 > HARNESS_GOP / HARNESS_FPS + 1)
+            late++;
+    }
+    printf("seek: %d random times, %u out of window\n", times, late);
+    HARNESS_CHECK(0 == late);
+}
+
+/*对比：同样的码流每帧 f_write，每秒 f_sync 一次*/
+static void harness_naive(HLE_U8 *buf, HLE_U32 frames)
+{
+    sd_disk_stat_t ds;
+    FIL fp;
+    UINT bw;
+    HLE_U64 bytes = 0;
+    HLE_U32 n;
+    double t0, t, max = 0, start;
+    int len, key;
+
+    HARNESS_CHECK(f_open(&fp, "/NAIVE.DAT", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    sd_disk_get_stat(&ds, 1);
+    start = harness_sec();
+    for (n = 0; n < frames; n++)
+    {
+        len = harness_frame(n, buf, &key);
+        t0 = harness_sec();
+        HARNESS_CHECK(f_write(&fp, buf, len, &bw) == FR_OK && bw == (UINT)len);
+        if ((n + 1) % HARNESS_FPS == 0)
+            HARNESS_CHECK(f_sync(&fp) == FR_OK);
+        t = harness_sec() - t0;
+        if (t > max)
+            max = t;
+        bytes += len;
+    }
+    f_close(&fp);
+    t = harness_sec() - start;
+    sd_disk_get_stat(&ds, 1);
+    f_unlink("/NAIVE.DAT");
+
+    printf("naive f_write: %.1f MB in %.2f s, %.1f MB/s, %u disk writes (%.1f KB avg), "
+           "%.1f writes/MB, max call %.2f ms\n",
+           bytes / 1048576.0, t, bytes / 1048576.0 / t, ds.writes,
+           ds.write_sectors * 512.0 / 1024 / ds.writes, ds.writes / (bytes / 1048576.0), max * 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *image = argc > 1 ? argv[1] : "/tmp/test_sd_record.img";
+    HLE_U32 size_mb = argc > 2 ? atoi(argv[2]) : 256;
+    int sync = argc > 3 && 0 == strcmp(argv[3], "sync");
+    sd_rec_status_t st;
+    sd_disk_stat_t ds;
+    HLE_U8 *buf = (HLE_U8 *)malloc(HARNESS_MAX_FRAME);
+    HLE_U32 frames, total, first = 0, last = 0, count, dropped = 0, seq;
+    HLE_U64 bytes = 0;
+    double t0, t, max_put;
+    int fd, i, len, key;
+
+    fd = open(image, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)size_mb * 1024 * 1024) < 0)
+    {
+        printf("create %s fail\n", image);
+        return 1;
+    }
+    close(fd);
+
+    /*0.空白的卡不自动格式化（开机路径 format 为 0），卡上的数据不变*/
+    HARNESS_CHECK(sd_disk_attach(image, sync) == 0);
+    HARNESS_CHECK(sd_rec_open(NULL, HARNESS_SEG_SIZE, 0) == HLE_RET_ENOTSUPPORTED);
+    sd_disk_get_stat(&ds, 1);
+    HARNESS_CHECK(0 == ds.writes);
+
+    /*1.格式化并建立切片*/
+    t0 = harness_sec();
+    HARNESS_CHECK(sd_rec_open(NULL, HARNESS_SEG_SIZE, 1) == 0);
+    sd_rec_get_status(&st);
+    sd_disk_get_stat(&ds, 1);
+    printf("image %u MB%s: %u segments x %u KB, chunk %u KB, format + layout %.2f s\n",
+           size_mb, sync ? " (O_DSYNC)" : "", st.seg_num, st.seg_size / 1024, st.chunk_size / 1024,
+           harness_sec() - t0);
+
+    /*2.不限速写满约 3 圈，送帧阻塞等待写卡，测持续吞吐*/
+    sdrec_put_wait_ms = 10000;
+    for (i = 0; i < HARNESS_GOP; i++)
+        bytes += harness_frame(i, buf, &key) + sizeof (sd_rec_hdr_t);
+    frames = (HLE_U32)((HLE_U64)st.seg_num * st.seg_size * 3 / (bytes / HARNESS_GOP));
+    frames -= frames % HARNESS_GOP;
+    t0 = harness_sec();
+    max_put = harness_feed(buf, 0, frames, 0, &dropped);
+    t = harness_sec() - t0;
+    sd_rec_get_status(&st);
+    sd_disk_get_stat(&ds, 1);
+    printf("sustained: %u frames, %.1f MB in %.2f s, %.1f MB/s, chunk write max %u ms, put max %.2f ms\n",
+           frames, st.bytes / 1048576.0, t, st.bytes / 1048576.0 / t, st.max_write_ms, max_put);
+    printf("  disk: %u writes (%u chunks + %u index slots, %u other), %.1f writes/MB, max write %.2f ms, "
+           "segments rotated %u\n", ds.writes, st.chunks, st.index_writes,
+           ds.writes - st.chunks - st.index_writes, ds.writes / (st.bytes / 1048576.0),
+           ds.max_write_us / 1000.0, st.cur_seq);
+    HARNESS_CHECK(0 == dropped && 0 == st.dropped);
+    HARNESS_CHECK(ds.writes == st.chunks + st.index_writes);
+    HARNESS_CHECK(st.cur_seq > st.seg_num * 2);
+
+    /*3.按实时的 4 倍速度写 500 帧，默认等待时间下不应丢帧*/
+    sdrec_put_wait_ms = SD_REC_PUT_WAIT_MS;
+    max_put = harness_feed(buf, frames, frames + 500, 1000000 / HARNESS_FPS / 4, &dropped);
+    total = frames + 500;
+    sd_rec_get_status(&st);
+    printf("paced 4x realtime: 500 frames, dropped %u, put max %.2f ms, wait max %u ms\n",
+           st.dropped, max_put, st.max_wait_ms);
+    HARNESS_CHECK(0 == dropped && 0 == st.dropped);
+
+    /*4.读取：从最早读到最新，帧号连续，最后一帧之前的都已写到卡上*/
+    count = harness_read_all(buf, 0, &first, &last);
+    printf("read all: %u frames [%u, %u], oldest %u newest %u\n", count, first, last, st.oldest, st.newest);
+    HARNESS_CHECK(count > 0 && last + 1 < total && last + 1 + st.chunk_size * 2 / 12288 >= total);
+    harness_seek(buf, 200);
+
+    /*5.关闭后重新挂载：剩余数据已写出，序号接着增加，新旧数据连续*/
+    sd_rec_get_status(&st);
+    seq = st.cur_seq;
+    sd_rec_close();
+    HARNESS_CHECK(sd_disk_attach(image, sync) == 0);
+    HARNESS_CHECK(sd_rec_open(NULL, HARNESS_SEG_SIZE, 1) == 0);
+    sd_rec_get_status(&st);
+    HARNESS_CHECK(st.cur_seq == seq);
+    count = harness_read_all(buf, 0, &first, &last);
+    HARNESS_CHECK(last + 1 == total);
+    harness_feed(buf, total, total + 250, 0, &dropped);
+    total += 250;
+    count = harness_read_all(buf, (HLE_U32)(harness_time(total - 400) / 1000), &first, &last);
+    sd_rec_get_status(&st);
+    printf("reopen: seq %u -> %u, read %u frames [%u, %u] across the reopen\n", seq, st.cur_seq, count, first, last);
+    HARNESS_CHECK(st.cur_seq == seq + 1 && first < total - 250 && last + 1 <= total);
+
+    /*6.对比每帧 f_write（写线程空闲，共用同一个 FatFs 卷）*/
+    harness_naive(buf, 500);
+
+    /*7.最早的切片被覆盖后，旧位置读取失败*/
+    {
+        sd_rec_pos_t pos;
+
+        HARNESS_CHECK(sd_rec_find(0, &pos) == 0);
+        sdrec_put_wait_ms = 10000;
+        harness_feed(buf, total, total + (HLE_U32)((HLE_U64)st.seg_size * 2 / (bytes / HARNESS_GOP)), 0, &dropped);
+        len = sd_rec_read(&pos, buf, HARNESS_MAX_FRAME, NULL, &key);
+        HARNESS_CHECK(len < 0);
+    }
+
+    /*8.用户命令格式化：录像打开时拒绝，关闭后格式化，原有的录像全部清除*/
+    HARNESS_CHECK(sd_rec_format(image) == HLE_RET_EBUSY);
+    sd_rec_close();
+    HARNESS_CHECK(sd_rec_format(image) == 0);
+    HARNESS_CHECK(sd_disk_attach(image, sync) == 0);
+    HARNESS_CHECK(sd_rec_open(NULL, HARNESS_SEG_SIZE, 0) == 0);
+    sd_rec_get_status(&st);
+    {
+        sd_rec_pos_t pos;
+        HARNESS_CHECK(0 == st.cur_seq && sd_rec_find(0, &pos) < 0);
+    }
+    printf("format: %u segments, seq %u\n", st.seg_num, st.cur_seq);
+
+    sd_rec_close();
+    free(buf);
+    printf("%s\n", harness_fail ? "FAIL" : "PASS");
+    return harness_fail ? 1 : 0;
+}
+
@@ -0,0 +1,77 @@
+/***************************************************************************
+* @file: test_stub.c
+* @author:
+* @date:  10,19,2026
+* @brief:  主机测试：被测模块调用的 SDK/编码/上传接口的默认实现
+* @attention:都是弱符号，需要观察调用的测试程序可以自己实现同名函数
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "typeport.h"
+#include "mpi_sys.h"
+#include "encoder.h"
+#include "amazon_S3.h"
+
+#define TEST_WEAK __attribute__((weak))
+
+TEST_WEAK HI_S32 HI_MPI_SYS_GetCurPts(HI_U64 *pu64CurPts)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*pu64CurPts = (HI_U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	return HI_SUCCESS;
+}
+
+/*---编码：默认没有码流------------------------------*/
+TEST_WEAK int encoder_request_stream(int channel, int stream_index, int auto_rc)
+{
+	return -1;
+}
+
+TEST_WEAK int encoder_free_stream(int stream_id)
+{
+	return 0;
+}
+
+TEST_WEAK ENC_STREAM_PACK *encoder_get_packet(int stream_id)
+{
+	return NULL;
+}
+
+TEST_WEAK ENC_STREAM_PACK *encoder_try_get_packet(int stream_id)
+{
+	return NULL;
+}
+
+TEST_WEAK int encoder_release_packet(ENC_STREAM_PACK *pack)
+{
+	return 0;
+}
+
+TEST_WEAK int encoder_force_iframe(int channel, int stream_index)
+{
+	return 0;
+}
+
+/*---上传：直接丢弃（与上传模块一样负责释放 file_buf）------------------------------*/
+TEST_WEAK int push_to_upload_file_queue(put_file_info_t *file_info)
+{
+	if (2 == file_info->mode)
+		free(file_info->file_buf);
+	return 0;
+}
+
+TEST_WEAK int push_to_upload_file_queue_nowait(put_file_info_t *file_info)
+{
+	return push_to_upload_file_queue(file_info);
+}
+
+/*---网络：默认下载失败------------------------------*/
+TEST_WEAK int http_get_stream(const char *url, int (*on_data)(void *arg, const void *data, int len), void *arg)
+{
+	return -1;
+}
@@ -0,0 +1,266 @@
+/***************************************************************************
+* @file: test_surface_scaler.c
+* @author:
+* @date:  10,19,2026
+* @brief:  OSD 缩放的主机测试：golden 图、与参考实现比对、吞吐
+* @attention:直接包含 surface_scaler.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "surface_scaler.c"
+
+/*
+（HLE_SURFACE 用 32 位保存地址，64 位主机上测试图片都放在静态区，需要 -no-pie，见 Makefile）
+1.golden：几个能手算结果的小图（常量图、两点插值、2x2 均值、对齐）逐像素比对
+2.快速实现与逐分量参考实现逐位比对（随机图 + OSD 文字图，多种尺寸）
+3.吞吐：与原来的浮点最邻近插值比较
+*/
+#include <stdio.h>
+#include <sys/time.h>
+
+/*---参考实现：逐像素、逐分量，不做任何缓存和打包--------*/
+static HLE_U32 sfc_ref_lerp(HLE_U32 a, HLE_U32 b, HLE_U32 f)
+{
+	return (a * (SFC_ONE - f) + b * f + SFC_ONE / 2) >> SFC_FRAC_BITS;
+}
+
+static void sfc_ref_bilinear(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	const HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	sfc_axis_t ax[1024], ay[1024];
+	int x, y, c;
+
+	sfc_axis_bilinear(ax, dst_w, src_w);
+	sfc_axis_bilinear(ay, dst_h, src_h);
+	for (y = 0; y < dst_h; y++)
+	{
+		for (x = 0; x < dst_w; x++)
+		{
+			HLE_U16 p00 = src_bmp[ay[y].i0 * src_w + ax[x].i0];
+			HLE_U16 p01 = src_bmp[ay[y].i0 * src_w + ax[x].i1];
+			HLE_U16 p10 = src_bmp[ay[y].i1 * src_w + ax[x].i0];
+			HLE_U16 p11 = src_bmp[ay[y].i1 * src_w + ax[x].i1];
+			HLE_U32 fx = ax[x].f, fy = ay[y].f;
+			HLE_U16 out = 0;
+
+			for (c = 0; c < 15; c += 5)	//B、G、R
+			{
+				HLE_U32 top = sfc_ref_lerp((p00 >> c) & 0x1F, (p01 >> c) & 0x1F, fx);
+				HLE_U32 bot = sfc_ref_lerp((p10 >> c) & 0x1F, (p11 >> c) & 0x1F, fx);
+				out |= sfc_ref_lerp(top, bot, fy) << c;
+			}
+			HLE_U32 at = SFC_ALPHA(p00) * (SFC_ONE - fx) + SFC_ALPHA(p01) * fx;
+			HLE_U32 ab = SFC_ALPHA(p10) * (SFC_ONE - fx) + SFC_ALPHA(p11) * fx;
+			if ((at * (SFC_ONE - fy) + ab * fy) * 2 >= SFC_ONE * SFC_ONE)
+				out |= 0x8000;
+			dst_bmp[y * dst_w + x] = out;
+		}
+	}
+}
+
+static void sfc_ref_box(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	const HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	sfc_axis_t ax[1024], ay[1024];
+	int x, y, sx, sy, c;
+
+	sfc_axis_box(ax, dst_w, src_w);
+	sfc_axis_box(ay, dst_h, src_h);
+	for (y = 0; y < dst_h; y++)
+	{
+		for (x = 0; x < dst_w; x++)
+		{
+			HLE_U32 sum[4] = {0};
+			HLE_U32 n = (ax[x].i1 - ax[x].i0) * (ay[y].i1 - ay[y].i0);
+			for (sy = ay[y].i0; sy < ay[y].i1; sy++)
+			{
+				for (sx = ax[x].i0; sx < ax[x].i1; sx++)
+				{
+					HLE_U16 p = src_bmp[sy * src_w + sx];
+					for (c = 0; c < 3; c++)
+						sum[c] += (p >> (c * 5)) & 0x1F;
+					sum[3] += SFC_ALPHA(p);
+				}
+			}
+			HLE_U16 out = (sum[3] * 2 >= n) ? 0x8000 : 0;
+			for (c = 0; c < 3; c++)
+				out |= ((2 * sum[c] + n) / (2 * n)) << (c * 5);
+			dst_bmp[y * dst_w + x] = out;
+		}
+	}
+}
+
+/*原来的浮点最邻近插值（对比吞吐用）*/
+static void sfc_old_nearest(HLE_U16 *dst_bmp, HLE_U32 dst_w, HLE_U32 dst_h,
+	HLE_U16 *src_bmp, HLE_U32 src_w, HLE_U32 src_h)
+{
+	float w_scale = (float) ((1.0 * src_w) / dst_w);
+	float h_scale = (float) ((1.0 * src_h) / dst_h);
+	int x, y;
+
+	for (y = 0; y < dst_h; y++)
+	{
+		int src_y = (int) (y * h_scale);
+		if (src_y > src_h - 1)
+			src_y = src_h - 1;
+		for (x = 0; x < dst_w; x++)
+		{
+			int src_x = (int) (x * w_scale);
+			if (src_x > src_w - 1)
+				src_x = src_w - 1;
+			*(dst_bmp + dst_w * y + x) = *(src_bmp + src_w * src_y + src_x);
+		}
+	}
+}
+
+static int test_fail;
+
+#define TEST_CHECK(cond, args...) do { if (!(cond)) { printf("FAIL %s:%d: ", __func__, __LINE__); printf(args); printf("\n"); test_fail++; } } while (0)
+
+static int test_scale(HLE_U16 *dst, int dst_w, int dst_h, HLE_U16 *src, int src_w, int src_h, sfc_scale_mode_e mode)
+{
+	HLE_SURFACE d = {(HLE_U32)(unsigned long) dst, dst_w, dst_h};
+	HLE_SURFACE s = {(HLE_U32)(unsigned long) src, src_w, src_h};
+	return scale_surface_mode(&d, &s, mode);
+}
+
+static unsigned int test_rand_seed = 12345;
+static HLE_U16 test_rand(void)
+{
+	test_rand_seed = test_rand_seed * 1103515245 + 12345;
+	return (HLE_U16)(test_rand_seed >> 8);
+}
+
+/*模拟 OSD：白色前景（alpha 1）的斜线/竖线文字笔画 + 黑色背景（alpha 0）*/
+static void test_make_osd(HLE_U16 *bmp, int w, int h)
+{
+	int x, y;
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+			bmp[y * w + x] = ((x % 9) < 2 || ((x + y) % 11) < 2) ? 0xFFFF : 0x0000;
+}
+
+static void test_golden(void)
+{
+	static HLE_U16 src[16], dst[64];
+	int i;
+
+	/*常量图任意缩放都不变*/
+	for (i = 0; i < 16; i++)
+		src[i] = 0x8000 | (21 << 10) | (9 << 5) | 30;
+	int modes[] = {SFC_SCALE_NEAREST, SFC_SCALE_BILINEAR, SFC_SCALE_BOX};
+	int m;
+	for (m = 0; m < 3; m++)
+	{
+		test_scale(dst, 7, 5, src, 4, 4, modes[m]);
+		for (i = 0; i < 35; i++)
+			TEST_CHECK(dst[i] == src[0], "mode %d constant %d: %#x", modes[m], i, dst[i]);
+	}
+
+	/*1x2 -> 1x4（纵向放大 2 倍，双线性）：中心对齐，权重 1/4、3/4*/
+	src[0] = 0x0000;		//黑，alpha 0
+	src[1] = 0xFFFF;		//白，alpha 1
+	test_scale(dst, 1, 4, src, 1, 2, SFC_SCALE_BILINEAR);
+	HLE_U16 golden_up[4] = {0x0000, 0x2108, 0xDEF7, 0xFFFF};	//0、8、23、31；alpha 在 0.5 处翻转
+	for (i = 0; i < 4; i++)
+		TEST_CHECK(dst[i] == golden_up[i], "bilinear 2x up %d: %#x != %#x", i, dst[i], golden_up[i]);
+
+	/*4x2 -> 2x1（box 缩小 2 倍）：每个目标像素是 2x2 的平均*/
+	src[0] = 0x0000; src[1] = 0x7FFF; src[2] = 0x8000 | (31 << 10); src[3] = 0x8000 | 31;
+	src[4] = 0x0000; src[5] = 0x7FFF; src[6] = 0x8000 | (31 << 10); src[7] = 0x8000 | 31;
+	test_scale(dst, 2, 1, src, 4, 2, SFC_SCALE_AUTO);
+	TEST_CHECK(dst[0] == ((16 << 10) | (16 << 5) | 16), "box 0: %#x", dst[0]);	//15.5 四舍五入为 16，alpha 0/4
+	TEST_CHECK(dst[1] == (0x8000 | (16 << 10) | 16), "box 1: %#x", dst[1]);		//alpha 4/4
+
+	/*最邻近：3 -> 6 每个像素重复两次*/
+	src[0] = 1; src[1] = 2; src[2] = 3;
+	test_scale(dst, 6, 1, src, 3, 1, SFC_SCALE_NEAREST);
+	for (i = 0; i < 6; i++)
+		TEST_CHECK(dst[i] == src[i / 2], "nearest %d: %#x", i, dst[i]);
+}
+
+static void test_against_reference(void)
+{
+	static HLE_U16 src[544 * 64], dst[1024 * 128], ref[1024 * 128];
+	static const int sizes[][4] = {	//src_w, src_h, dst_w, dst_h
+		{152, 16, 544, 64}, {152, 16, 280, 32}, {544, 64, 152, 16}, {544, 64, 280, 32},
+		{280, 32, 544, 64}, {280, 32, 152, 16}, {13, 7, 97, 31}, {97, 31, 13, 7},
+		{100, 50, 99, 51}, {64, 64, 20, 20}, {300, 20, 299, 9}
+	};
+	int k, t, i;
+
+	for (t = 0; t < 2; t++)
+	{
+		for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+		{
+			int sw = sizes[k][0], sh = sizes[k][1], dw = sizes[k][2], dh = sizes[k][3];
+			if (t == 0)
+				test_make_osd(src, sw, sh);
+			else
+				for (i = 0; i < sw * sh; i++)
+					src[i] = test_rand();
+
+			test_scale(dst, dw, dh, src, sw, sh, SFC_SCALE_BILINEAR);
+			sfc_ref_bilinear(ref, dw, dh, src, sw, sh);
+			TEST_CHECK(memcmp(dst, ref, dw * dh * 2) == 0, "bilinear %dx%d->%dx%d (%s) differs from reference",
+				sw, sh, dw, dh, t ? "random" : "osd");
+
+			if (dw <= sw && dh <= sh)
+			{
+				test_scale(dst, dw, dh, src, sw, sh, SFC_SCALE_BOX);
+				sfc_ref_box(ref, dw, dh, src, sw, sh);
+				TEST_CHECK(memcmp(dst, ref, dw * dh * 2) == 0, "box %dx%d->%dx%d (%s) differs from reference",
+					sw, sh, dw, dh, t ? "random" : "osd");
+			}
+		}
+	}
+}
+
+static long long test_now_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void test_benchmark(void)
+{
+	static HLE_U16 src[544 * 64], dst[544 * 64];
+	static const int sizes[][4] = {{152, 16, 544, 64}, {544, 64, 280, 32}, {544, 64, 152, 16}};
+	const int loops = 2000;
+	int k, i;
+
+	for (k = 0; k < 3; k++)
+	{
+		int sw = sizes[k][0], sh = sizes[k][1], dw = sizes[k][2], dh = sizes[k][3];
+		long long t0, t_old, t_near, t_auto;
+
+		test_make_osd(src, sw, sh);
+		t0 = test_now_us();
+		for (i = 0; i < loops; i++)
+			sfc_old_nearest(dst, dw, dh, src, sw, sh);
+		t_old = test_now_us() - t0;
+
+		t0 = test_now_us();
+		for (i = 0; i < loops; i++)
+			test_scale(dst, dw, dh, src, sw, sh, SFC_SCALE_NEAREST);
+		t_near = test_now_us() - t0;
+
+		t0 = test_now_us();
+		for (i = 0; i < loops; i++)
+			test_scale(dst, dw, dh, src, sw, sh, SFC_SCALE_AUTO);
+		t_auto = test_now_us() - t0;
+
+		printf("%3dx%-3d -> %3dx%-3d: float nearest %.2f us, fixed nearest %.2f us, %s %.2f us (%.1f Mpix/s)\n",
+			sw, sh, dw, dh, (double) t_old / loops, (double) t_near / loops,
+			(dw * 2 <= sw || dh * 2 <= sh) ? "box" : "bilinear", (double) t_auto / loops,
+			(double) dw * dh * loops / t_auto);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	test_golden();
+	test_against_reference();
+	test_benchmark();
+	printf("%s (%d failures)\n", test_fail ? "FAILED" : "PASSED", test_fail);
+	return test_fail ? 1 : 0;
+}
@@ -0,0 +1,471 @@
+/***************************************************************************
+* @file: test_system_upgrade.c
+* @author:
+* @date:  10,19,2026
+* @brief:  流式升级的主机测试：NOR flash 模拟、打包工具
+* @attention:直接包含 system_upgrade.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "typeport.h"
+#undef DEBUG_LOG
+#define DEBUG_LOG(args...)
+#include "system_upgrade.c"
+
+/*******************************************************************************
+主机上的升级模拟器：
+1.打包：bin/test_system_upgrade -k <私钥.pem> -v <fw_version> -p <镜像> <升级包>
+2.测试：bin/test_system_upgrade [-s 镜像大小KB] [-r 下载速率kbps] [-e 扇区擦除ms] [-w 页写入us] [-x 时间缩放]
+	用内存模拟 16M NOR flash（擦除置 0xFF、写入只能把 1 变 0、按扇区/页计时），
+	依次验证正常升级、镜像被篡改、签名错误、版本回退、中途放弃，并对比旧流程（先收完整个升级包，
+	擦除整个分区再写）和流式升级的耗时。
+	最后用本机的 HTTP 服务经 upgrade_from_url -> http_get_stream（media_server_http.c）下载：
+	分块传输、Content-Length、分块传输中途断开、块大小格式错误。
+*******************************************************************************/
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <openssl/bn.h>
+
+#define SIM_FLASH_SIZE		0x1000000
+#define SIM_PAGE_SIZE		256
+
+static HLE_U8 *g_sim_flash;
+static int g_sim_erase_ms = 400;		//64K 扇区擦除（典型 SPI NOR）
+static int g_sim_page_us = 600;			//256 字节页写入
+static int g_sim_scale = 20;			//模拟时间缩放（所有等待除以该值，统计时再乘回来）
+static char g_sim_pubkey[1024];
+
+static void sim_delay_us(long long us)
+{
+	if(us / g_sim_scale > 0)
+		usleep(us / g_sim_scale);
+}
+
+static long long sim_now_us(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return ((long long)tv.tv_sec * 1000000 + tv.tv_usec) * g_sim_scale;
+}
+
+int hispinor_erase(unsigned long start, unsigned long size)
+{
+	if(start % UPGRADE_SECTOR_SIZE || size % UPGRADE_SECTOR_SIZE || start + size > SIM_FLASH_SIZE)
+		return -1;
+	memset(g_sim_flash + start, 0xFF, size);
+	sim_delay_us((long long)g_sim_erase_ms * 1000 * (size / UPGRADE_SECTOR_SIZE));
+	return 0;
+}
+
+int hispinor_write(void* memaddr, unsigned long start, unsigned long size)
+{
+	unsigned long i;
+	if(start + size > SIM_FLASH_SIZE)
+		return -1;
+	for(i = 0; i < size; i++) //NOR 写入只能把 1 变成 0
+		g_sim_flash[start + i] &= ((HLE_U8 *)memaddr)[i];
+	sim_delay_us((long long)g_sim_page_us * ((size + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE));
+	return 0;
+}
+
+int hispinor_read(void* memaddr, unsigned long start, unsigned long size)
+{
+	if(start + size > SIM_FLASH_SIZE)
+		return -1;
+	memcpy(memaddr, g_sim_flash + start, size);
+	return 0;
+}
+
+/*打包：填升级包头并签名*/
+static void sim_pack(upgrade_manifest_t *m, const HLE_U8 *image, unsigned int size, unsigned int version, RSA *rsa)
+{
+	HLE_U8 md[SHA256_DIGEST_LENGTH];
+	memset(m, 0, sizeof(*m));
+	m->magic = UPGRADE_MANIFEST_MAGIC;
+	m->fw_version = version;
+	m->image_size = size;
+	SHA256(image, size, m->image_sha256);
+	snprintf(m->fw_name, sizeof(m->fw_name), "sim image v%u", version);
+	SHA256((const HLE_U8 *)m, offsetof(upgrade_manifest_t, sig_len), md);
+	RSA_sign(NID_sha256, md, sizeof(md), m->signature, &m->sig_len, rsa);
+}
+
+static int sim_pack_file(const char *key_file, unsigned int version, const char *in, const char *out)
+{
+	upgrade_manifest_t m;
+	FILE *fp = fopen(key_file, "r");
+	RSA *rsa = fp ? PEM_read_RSAPrivateKey(fp, NULL, NULL, NULL) : NULL;
+	if(fp)
+		fclose(fp);
+	if(NULL == rsa)
+	{
+		printf("load private key %s failed\n", key_file);
+		return 1;
+	}
+	fp = fopen(in, "rb");
+	if(NULL == fp)
+	{
+		printf("open %s failed\n", in);
+		return 1;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	HLE_U8 *image = (HLE_U8 *)malloc(size);
+	if(fread(image, 1, size, fp) != (size_t)size)
+		size = 0;
+	fclose(fp);
+	sim_pack(&m, image, size, version, rsa);
+	fp = fopen(out, "wb");
+	if(NULL == fp || fwrite(&m, sizeof(m), 1, fp) != 1 || fwrite(image, 1, size, fp) != (size_t)size)
+	{
+		printf("write %s failed\n", out);
+		return 1;
+	}
+	fclose(fp);
+	printf("%s: fw_version %u image %ld bytes\n", out, version, size);
+	free(image);
+	RSA_free(rsa);
+	return 0;
+}
+
+/*出厂状态：uboot 只写了 image0，image1 为空*/
+static void sim_factory(void)
+{
+	config_info_t info;
+	memset(g_sim_flash, 0xFF, SIM_FLASH_SIZE);
+	memset(&info, 0, sizeof(info));
+	info.magic_flag = HLE_MAGIC;
+	info.image_info[0].image_version = 1;
+	info.image_info[0].damage_flag = FLAG_OK;
+	info.image_info[0].start_address = IMAGE0_REGION_START;
+	info.image_info[1].damage_flag = FLAG_BAD;
+	info.image_info[1].start_address = IMAGE1_REGION_START;
+	memcpy(g_sim_flash + CONFIG_REGION_START, &info, sizeof(info));
+	memset(g_sim_flash + IMAGE0_REGION_START, 0x5A, 0x100000);
+}
+
+/*按下载速率分段输入升级包，返回耗时（模拟时间，毫秒）*/
+static upgrade_status_e sim_stream(const HLE_U8 *pkg, unsigned int size, int kbps, long long *ms)
+{
+	upgrade_status_e ret;
+	long long t0 = sim_now_us();
+	unsigned int off = 0;
+	upgrade_ctx_t *ctx = upgrade_begin(&ret);
+	if(NULL == ctx)
+		return ret;
+	while(off < size && UP_OK == ret)
+	{
+		unsigned int n = (size - off < 8192) ? size - off : 8192;
+		long long due = t0 + (long long)(off + n) * 8 * 1000 / kbps; //网络按速率到达
+		long long now = sim_now_us();
+		if(due > now)
+			sim_delay_us(due - now);
+		ret = upgrade_feed(ctx, pkg + off, n);
+		off += n;
+	}
+	ret = upgrade_end(ctx, UP_OK == ret);
+	*ms = (sim_now_us() - t0) / 1000;
+	return ret;
+}
+
+/*旧流程：整个升级包收到内存后擦除整个分区，再一次写入（同样按速率下载）*/
+static long long sim_legacy(unsigned int size, int kbps)
+{
+	long long t0 = sim_now_us();
+	sim_delay_us((long long)size * 8 * 1000 / kbps);
+	HLE_U8 *tmp = (HLE_U8 *)malloc(size);
+	memset(tmp, 0x00, size);
+	hispinor_erase(CONFIG_REGION_START, CONFIG_REGION_SIZE);
+	hispinor_erase(IMAGE1_REGION_START, IMAGE1_REGION_SIZE);
+	hispinor_write(tmp, IMAGE1_REGION_START, size);
+	free(tmp);
+	return (sim_now_us() - t0) / 1000;
+}
+
+/*本机 HTTP 服务：接受一个连接，回应升级包*/
+enum
+{
+	SIM_HTTP_LENGTH,		//Content-Length
+	SIM_HTTP_CHUNKED,		//分块传输：块大小不等，有大写十六进制、块扩展和尾部字段
+	SIM_HTTP_BAD_CHUNK		//分块传输，第二个块的大小行不是十六进制
+};
+
+typedef struct
+{
+	int fd;					//监听 socket
+	const HLE_U8 *data;
+	unsigned int size;
+	int mode;				//SIM_HTTP_xxx
+	unsigned int cut;		//非 0 时发送 cut 字节的 body 数据后断开
+	char request[128];		//收到的请求行
+}sim_http_t;
+
+/*被 media_server_http.c 引用（下载到文件的旧接口）*/
+unsigned long get_file_size(const char *path)
+{
+	return 0;
+}
+
+static int sim_send(int fd, const void *buf, unsigned int len)
+{
+	while(len > 0)
+	{
+		int n = send(fd, buf, len, MSG_NOSIGNAL);
+		if(n <= 0)
+			return -1;
+		buf = (const char *)buf + n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void *sim_http_server(void *arg)
+{
+	sim_http_t *srv = (sim_http_t *)arg;
+	char req[1024], line[64];
+	int len = 0, n, k;
+	unsigned int off = 0, body = srv->cut ? srv->cut : srv->size;
+
+	int fd = accept(srv->fd, NULL, NULL);
+	if(fd < 0)
+		return NULL;
+	while(len < (int)sizeof(req) - 1 && (n = read(fd, req + len, sizeof(req) - 1 - len)) > 0)
+	{
+		len += n;
+		req[len] = '\0';
+		if(strstr(req, "\r\n\r\n"))
+			break;
+	}
+	req[len] = '\0';
+	sscanf(req, "%127[^\r]", srv->request);
+
+	if(SIM_HTTP_LENGTH == srv->mode)
+	{
+		n = snprintf(req, sizeof(req), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+					 "Content-Length: %u\r\n\r\n", srv->size);
+		if(0 == sim_send(fd, req, n))
+			sim_send(fd, srv->data, body);
+		close(fd);
+		return NULL;
+	}
+
+	n = snprintf(req, sizeof(req), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+				 "Transfer-Encoding: chunked\r\n\r\n");
+	if(sim_send(fd, req, n) < 0)
+		goto out;
+	for(k = 0; off < body; k++)
+	{
+		unsigned int piece = 1 + (unsigned int)k * 7919 % 6000;
+		if(piece > body - off)
+			piece = body - off;
+		if(SIM_HTTP_BAD_CHUNK == srv->mode && 1 == k)
+			n = snprintf(line, sizeof(line), "zz\r\n");
+		else if(0 == k % 5)
+			n = snprintf(line, sizeof(line), "%x;name=v%d\r\n", piece, k);
+		else
+			n = snprintf(line, sizeof(line), (k & 1) ? "%X\r\n" : "%x\r\n", piece);
+		if(sim_send(fd, line, n) < 0 || sim_send(fd, srv->data + off, piece) < 0 || sim_send(fd, "\r\n", 2) < 0)
+			goto out;
+		off += piece;
+	}
+	if(0 == srv->cut)
+	{
+		const char *last = "0\r\nX-Trailer: done\r\n\r\n";
+		sim_send(fd, last, strlen(last));
+	}
+out:
+	close(fd);
+	return NULL;
+}
+
+/*经本机 HTTP 服务升级*/
+static upgrade_status_e sim_http(const HLE_U8 *pkg, unsigned int size, int mode, unsigned int cut, char *request)
+{
+	sim_http_t srv;
+	struct sockaddr_in addr;
+	socklen_t alen = sizeof(addr);
+	pthread_t tid;
+	char url[64];
+	upgrade_status_e ret;
+
+	memset(&srv, 0, sizeof(srv));
+	srv.data = pkg;
+	srv.size = size;
+	srv.mode = mode;
+	srv.cut = cut;
+	srv.fd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(srv.fd < 0 || bind(srv.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(srv.fd, 1) < 0
+	   || getsockname(srv.fd, (struct sockaddr *)&addr, &alen) < 0)
+	{
+		printf("local http server fail\n");
+		return UP_DOWNLOAD_FAILED;
+	}
+	pthread_create(&tid, NULL, sim_http_server, &srv);
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/fw/update.bin", ntohs(addr.sin_port));
+	ret = upgrade_from_url(url);
+	pthread_join(tid, NULL);
+	close(srv.fd);
+	strcpy(request, srv.request);
+	return ret;
+}
+
+static int sim_errors;
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*uboot 是否会从 image1 启动（image1 正常且版本比 image0 高）；image0 必须始终正常*/
+static int sim_boot_image1(void)
+{
+	config_info_t info;
+	hispinor_read(&info, CONFIG_REGION_START, sizeof(info));
+	if(FLAG_OK != info.image_info[0].damage_flag)
+		return -1;
+	return FLAG_OK == info.image_info[1].damage_flag && info.image_info[1].image_version > info.image_info[0].image_version;
+}
+
+static const char *sim_boot(void)
+{
+	config_info_t info;
+	static char desc[64];
+	hispinor_read(&info, CONFIG_REGION_START, sizeof(info));
+	snprintf(desc, sizeof(desc), "img0 v%d %s, img1 v%d %s",
+			 info.image_info[0].image_version, FLAG_OK == info.image_info[0].damage_flag ? "ok" : "bad",
+			 info.image_info[1].image_version, FLAG_OK == info.image_info[1].damage_flag ? "ok" : "bad");
+	return desc;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int image_kb = 4096, version = 0;
+	int kbps = 8000, opt;
+	const char *key_file = NULL, *pack_in = NULL;
+	long long ms;
+
+	while((opt = getopt(argc, argv, "s:r:e:w:x:k:v:p:")) != -1)
+	{
+		switch(opt)
+		{
+			case 's': image_kb = atoi(optarg); break;
+			case 'r': kbps = atoi(optarg); break;
+			case 'e': g_sim_erase_ms = atoi(optarg); break;
+			case 'w': g_sim_page_us = atoi(optarg); break;
+			case 'x': g_sim_scale = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+			case 'k': key_file = optarg; break;
+			case 'v': version = atoi(optarg); break;
+			case 'p': pack_in = optarg; break;
+			default: return 1;
+		}
+	}
+	if(pack_in)
+		return (key_file && optind < argc) ? sim_pack_file(key_file, version, pack_in, argv[optind]) : 1;
+
+	/*测试用密钥*/
+	RSA *rsa = RSA_new();
+	BIGNUM *e = BN_new();
+	BN_set_word(e, RSA_F4);
+	RSA_generate_key_ex(rsa, 2048, e, NULL);
+	BIO *bio = BIO_new(BIO_s_mem());
+	PEM_write_bio_RSA_PUBKEY(bio, rsa);
+	BIO_read(bio, g_sim_pubkey, sizeof(g_sim_pubkey) - 1);
+	BIO_free(bio);
+	g_upgrade_pubkey = g_sim_pubkey;
+
+	unsigned int size = image_kb * 1024;
+	HLE_U8 *pkg = (HLE_U8 *)malloc(UPGRADE_MANIFEST_SIZE + size);
+	HLE_U8 *image = pkg + UPGRADE_MANIFEST_SIZE;
+	unsigned int i;
+	g_sim_flash = (HLE_U8 *)malloc(SIM_FLASH_SIZE);
+	srand(1);
+	for(i = 0; i < size; i++)
+		image[i] = rand();
+	printf("image %u KB, download %d kbps, erase %d ms/64K, program %d us/256B\n", image_kb, kbps, g_sim_erase_ms, g_sim_page_us);
+
+	/*1.正常升级*/
+	sim_factory();
+	sim_pack((upgrade_manifest_t *)pkg, image, size, 100, rsa);
+	upgrade_status_e ret = sim_stream(pkg, UPGRADE_MANIFEST_SIZE + size, kbps, &ms);
+	int same = (0 == memcmp(g_sim_flash + IMAGE1_REGION_START, image, size));
+	printf("stream upgrade: ret %d, %lld ms (%.0f KB/s), flash %s, boot: %s\n",
+		   ret, ms, size / 1024.0 / (ms / 1000.0), same ? "match" : "MISMATCH", sim_boot());
+	SIM_CHECK(UP_OK == ret && same && 1 == sim_boot_image1());
+	long long download_ms = (long long)(UPGRADE_MANIFEST_SIZE + size) * 8 / kbps;
+	long long flash_ms = (long long)((size + UPGRADE_SECTOR_SIZE - 1) / UPGRADE_SECTOR_SIZE) * g_sim_erase_ms
+						 + (long long)(size / SIM_PAGE_SIZE) * g_sim_page_us / 1000;
+	printf("  download alone %lld ms, erase+program alone %lld ms\n", download_ms, flash_ms);
+	printf("legacy (buffer all, erase 7M region, program): %lld ms, %u KB RAM (stream: %d KB)\n",
+		   sim_legacy(UPGRADE_MANIFEST_SIZE + size, kbps), (UPGRADE_MANIFEST_SIZE + size) / 1024,
+		   (UPGRADE_BUF_NUM * UPGRADE_SECTOR_SIZE + (int)sizeof(upgrade_ctx_t)) / 1024);
+
+	/*2.镜像被篡改：签名的升级包头不变，镜像改一个字节*/
+	sim_factory();
+	image[size / 2] ^= 1;
+	ret = sim_stream(pkg, UPGRADE_MANIFEST_SIZE + size, kbps * 8, &ms);
+	printf("tampered image: ret %d (expect %d), boot: %s\n", ret, UP_CHECKSUM_FAILED, sim_boot());
+	SIM_CHECK(UP_CHECKSUM_FAILED == ret && 0 == sim_boot_image1());
+	image[size / 2] ^= 1;
+
+	/*3.签名错误*/
+	sim_factory();
+	((upgrade_manifest_t *)pkg)->fw_version = 101;
+	ret = sim_stream(pkg, UPGRADE_MANIFEST_SIZE + size, kbps * 8, &ms);
+	printf("bad signature: ret %d (expect %d), image1 untouched %s\n", ret, UP_SIGNATURE_FAILED,
+		   0xFF == g_sim_flash[IMAGE1_REGION_START] ? "yes" : "NO");
+	SIM_CHECK(UP_SIGNATURE_FAILED == ret && 0xFF == g_sim_flash[IMAGE1_REGION_START] && 0 == sim_boot_image1());
+
+	/*4.版本回退：先升级 v100 到 image1，再升级 v90*/
+	sim_factory();
+	sim_pack((upgrade_manifest_t *)pkg, image, size, 100, rsa);
+	sim_stream(pkg, UPGRADE_MANIFEST_SIZE + size, kbps * 8, &ms);
+	sim_pack((upgrade_manifest_t *)pkg, image, size, 90, rsa);
+	ret = sim_stream(pkg, UPGRADE_MANIFEST_SIZE + size, kbps * 8, &ms);
+	printf("rollback v90 over v100: ret %d (expect %d), boot: %s\n", ret, UP_VERSION_FAILED, sim_boot());
+	SIM_CHECK(UP_VERSION_FAILED == ret && 1 == sim_boot_image1());
+
+	/*5.中途放弃（下载断开）*/
+	sim_factory();
+	sim_pack((upgrade_manifest_t *)pkg, image, size, 100, rsa);
+	upgrade_ctx_t *ctx = upgrade_begin(&ret);
+	upgrade_feed(ctx, pkg, UPGRADE_MANIFEST_SIZE + size / 2);
+	ret = upgrade_end(ctx, 1);
+	printf("truncated download: ret %d (expect %d), boot: %s\n", ret, UP_CHECKSUM_FAILED, sim_boot());
+	SIM_CHECK(UP_CHECKSUM_FAILED == ret && 0 == sim_boot_image1());
+
+	/*6.HTTP 分块传输：块大小行不能混进升级包*/
+	char request[128];
+	sim_factory();
+	ret = sim_http(pkg, UPGRADE_MANIFEST_SIZE + size, SIM_HTTP_CHUNKED, 0, request);
+	same = (0 == memcmp(g_sim_flash + IMAGE1_REGION_START, image, size));
+	printf("http chunked: ret %d, flash %s, boot: %s\n", ret, same ? "match" : "MISMATCH", sim_boot());
+	SIM_CHECK(UP_OK == ret && same && 1 == sim_boot_image1());
+	SIM_CHECK(0 == strcmp(request, "GET /fw/update.bin HTTP/1.1"));
+
+	/*7.HTTP Content-Length*/
+	sim_factory();
+	ret = sim_http(pkg, UPGRADE_MANIFEST_SIZE + size, SIM_HTTP_LENGTH, 0, request);
+	printf("http content-length: ret %d, boot: %s\n", ret, sim_boot());
+	SIM_CHECK(UP_OK == ret && 1 == sim_boot_image1());
+
+	/*8.分块传输中途断开（没有大小为 0 的块）*/
+	sim_factory();
+	ret = sim_http(pkg, UPGRADE_MANIFEST_SIZE + size, SIM_HTTP_CHUNKED, UPGRADE_MANIFEST_SIZE + size / 2, request);
+	printf("http chunked, closed midway: ret %d (expect %d), boot: %s\n", ret, UP_DOWNLOAD_FAILED, sim_boot());
+	SIM_CHECK(UP_DOWNLOAD_FAILED == ret && 0 == sim_boot_image1());
+
+	/*9.块大小格式错误*/
+	sim_factory();
+	ret = sim_http(pkg, UPGRADE_MANIFEST_SIZE + size, SIM_HTTP_BAD_CHUNK, 0, request);
+	printf("http bad chunk size: ret %d (expect %d), boot: %s\n", ret, UP_DOWNLOAD_FAILED, sim_boot());
+	SIM_CHECK(UP_DOWNLOAD_FAILED == ret && 0 == sim_boot_image1());
+
+	free(pkg);
+	free(g_sim_flash);
+	RSA_free(rsa);
+	BN_free(e);
+	printf("%s\n", sim_errors ? "FAIL" : "PASS");
+	return sim_errors ? 1 : 0;
+}
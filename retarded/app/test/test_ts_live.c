@@ -0,0 +1,436 @@
+/***************************************************************************
+* @file: test_ts_live.c
+* @author:
+* @date:  10,19,2026
+* @brief:  直播 HLS 切片的主机测试：达到目标时长后在关键帧处切片、滑动窗口和保留分片的回收、
+		   m3u8 内容、m3u8 先写临时文件再 rename；发布线程停止时先退出再释放码流队列
+* @attention:直接包含 ts_live.c 和 hls_live.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+	1.视频 10fps，GOP 1.5s（关键帧在 T0 + 1500 * n），目标时长 2s：每个分片 3s（第二个关键帧处才切）。
+	2.窗口 3 个分片 + 1 个保留分片 + 1 个正在写的分片，共 5 个缓存。
+	3.编码模块由测试实现：队列为空时 encoder_try_get_packet 返回 NULL，释放后再访问队列记为错误。
+***************************************************************************/
+#include "ts_live.c"
+#include "hls_live.c"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define SIM_T0              100000ULL   //第一个关键帧的时间戳（ms）
+#define SIM_FRAME_MS        100
+#define SIM_GOP_MS          1500
+#define SIM_SEG_MS          3000        //GOP 1.5s、目标 2s 时的分片时长
+#define SIM_SEG_BUF         (128*1024)
+#define SIM_STREAM_ID       0x10005
+#define SIM_QUEUE_SIZE      64
+#define SIM_WAIT_MS         2000
+
+static int sim_errors;
+static char sim_dir[64];
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*等待 cond 成立，最多 SIM_WAIT_MS*/
+#define SIM_WAIT(cond) do { int _ms = 0; while (!(cond) && _ms < SIM_WAIT_MS) { usleep(1000); _ms++; } } while (0)
+
+/*H264 帧：起始码 + NAL 头 + 填充*/
+static int sim_video_frame(unsigned char *buf, int key, unsigned long long pts)
+{
+    int len = key ? 3000 : 800 + (int)(pts % 7) * 50;
+
+    memset(buf, (int)(pts / SIM_FRAME_MS), len);
+    buf[0] = 0;
+    buf[1] = 0;
+    buf[2] = 0;
+    buf[3] = 1;
+    buf[4] = key ? 0x65 : 0x41;
+    return len;
+}
+
+/*送入 [from, to) 的音视频帧，关键帧在 T0 + SIM_GOP_MS * n*/
+static void sim_feed(unsigned long long from, unsigned long long to)
+{
+    static unsigned char buf[4096];
+    unsigned char aac[200];
+    unsigned long long pts;
+
+    memset(aac, 0x21, sizeof (aac));
+    for (pts = from; pts < to; pts += SIM_FRAME_MS)
+    {
+        int key = pts >= SIM_T0 && 0 == (pts - SIM_T0) % SIM_GOP_MS;
+        int len = sim_video_frame(buf, key, pts);
+
+        SIM_CHECK(0 == TS_live_put_video(buf, len, key, pts));
+        SIM_CHECK(0 == TS_live_put_audio(aac, sizeof (aac), pts));
+    }
+}
+
+static void sim_path(char *path, int size, const char *name)
+{
+    snprintf(path, size, "%s/%s", sim_dir, name);
+}
+
+static int sim_exists(const char *name)
+{
+    char path[128];
+    sim_path(path, sizeof (path), name);
+    return 0 == access(path, F_OK);
+}
+
+/*读文件（fd 或路径），返回长度*/
+static int sim_read_fd(int fd, char *buf, int size)
+{
+    int n = pread(fd, buf, size - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+static int sim_read_file(const char *name, char *buf, int size)
+{
+    char path[128];
+    int fd, n;
+
+    sim_path(path, sizeof (path), name);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    n = sim_read_fd(fd, buf, size);
+    close(fd);
+    return n;
+}
+
+static void sim_init(int window, int buf_size, const char *out_dir)
+{
+    ts_live_init_t init;
+
+    memset(&init, 0, sizeof (init));
+    init.target_duration = 2;
+    init.window_size = window;
+    init.segment_buf_size = buf_size;
+    strcpy(init.name_prefix, "live");
+    if (out_dir)
+        strncpy(init.out_dir, out_dir, sizeof (init.out_dir) - 1);
+    init.audio_config.profile = 1;
+    init.audio_config.sampling_frequency_index = 0x8;
+    init.audio_config.sample_rate = 16000;
+    init.audio_config.n_ch = 1;
+    SIM_CHECK(0 == TS_live_init(&init));
+}
+
+/*分片的内存数据按块读出，与写出的文件一致；每个 TS 包以 0x47 开头，第一个包是 PAT*/
+static void sim_check_segment(unsigned int seq)
+{
+    static char mem[SIM_SEG_BUF], file[SIM_SEG_BUF + 1];
+    char name[32];
+    int size = TS_live_get_segment_size(seq);
+    int pos = 0, n, i, bad = 0;
+
+    SIM_CHECK(size > 0 && 0 == size % TS_PACKET_SIZE);
+    if (size <= 0)
+        return;
+    while ((n = TS_live_read_segment(seq, mem + pos, 1000, pos)) > 0)
+        pos += n;
+    SIM_CHECK(0 == n && pos == size);
+    for (i = 0; i < size; i += TS_PACKET_SIZE)
+        bad += (0x47 != (unsigned char)mem[i]);
+    SIM_CHECK(0 == bad);
+    SIM_CHECK(0 == (mem[1] & 0x1F) && 0 == mem[2]);
+
+    snprintf(name, sizeof (name), "live_%u.ts", seq);
+    SIM_CHECK(sim_read_file(name, file, sizeof (file)) == size && 0 == memcmp(file, mem, size));
+}
+
+/*切片、窗口、m3u8*/
+static void sim_segment_case(void)
+{
+    char m3u8[TS_LIVE_M3U8_BUF_SIZE], old[TS_LIVE_M3U8_BUF_SIZE], file[TS_LIVE_M3U8_BUF_SIZE];
+    char path[128];
+    struct stat st_old, st_new;
+    int fd, i;
+
+    sim_init(3, SIM_SEG_BUF, sim_dir);
+
+    /*关键帧之前的帧都丢弃，m3u8 为空列表*/
+    sim_feed(SIM_T0 - 3 * SIM_FRAME_MS, SIM_T0);
+    SIM_CHECK(NULL == live_ctx.cur && 3 == live_ctx.drop_frames);
+    SIM_CHECK(TS_live_get_playlist(m3u8, sizeof (m3u8)) > 0);
+    SIM_CHECK(0 == strcmp(m3u8, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:2\n#EXT-X-MEDIA-SEQUENCE:0\n"));
+
+    /*T0 + 1500 的关键帧不切片（不到 2s），T0 + 3000 的关键帧切片*/
+    sim_feed(SIM_T0, SIM_T0 + SIM_SEG_MS);
+    SIM_CHECK(-1 == TS_live_get_segment_size(0));
+    SIM_CHECK(!sim_exists("live.m3u8"));
+    sim_feed(SIM_T0 + SIM_SEG_MS, SIM_T0 + SIM_SEG_MS + SIM_FRAME_MS);
+    SIM_CHECK(live_ctx.slot[0].state == SLOT_READY && SIM_SEG_MS == live_ctx.slot[0].duration_ms);
+    sim_check_segment(0);
+    SIM_CHECK(TS_live_get_playlist(m3u8, sizeof (m3u8)) > 0);
+    SIM_CHECK(0 == strcmp(m3u8, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:3\n#EXT-X-MEDIA-SEQUENCE:0\n"
+                                "#EXTINF:3.000,\nlive_0.ts\n"));
+
+    /*m3u8 先写临时文件再 rename：切片前打开的文件内容不变（旧文件没有被改写），新文件是新的列表*/
+    sim_path(path, sizeof (path), "live.m3u8");
+    fd = open(path, O_RDONLY);
+    SIM_CHECK(fd >= 0 && 0 == fstat(fd, &st_old));
+    SIM_CHECK(sim_read_fd(fd, old, sizeof (old)) > 0 && 0 == strcmp(old, m3u8));
+    sim_feed(SIM_T0 + SIM_SEG_MS + SIM_FRAME_MS, SIM_T0 + 2 * SIM_SEG_MS + SIM_FRAME_MS);
+    SIM_CHECK(sim_read_fd(fd, file, sizeof (file)) > 0 && 0 == strcmp(file, old));
+    close(fd);
+    SIM_CHECK(0 == stat(path, &st_new) && st_new.st_ino != st_old.st_ino);
+    SIM_CHECK(TS_live_get_playlist(m3u8, sizeof (m3u8)) > 0);
+    SIM_CHECK(sim_read_file("live.m3u8", file, sizeof (file)) > 0 && 0 == strcmp(file, m3u8));
+    SIM_CHECK(!sim_exists("live.m3u8.tmp"));
+    SIM_CHECK(strstr(m3u8, "live_1.ts\n") != NULL);
+
+    /*切到第 8 个分片：m3u8 是最新的 3 个（5 6 7），4 还可以读（保留分片），3 被回收（文件删除），8 正在写*/
+    sim_feed(SIM_T0 + 2 * SIM_SEG_MS + SIM_FRAME_MS, SIM_T0 + 8 * SIM_SEG_MS + SIM_FRAME_MS);
+    SIM_CHECK(9 == live_ctx.next_seq && 8 == live_ctx.cur->seq);
+    for (i = 0; i <= 3; i++)
+        SIM_CHECK(-1 == TS_live_get_segment_size(i));
+    for (i = 4; i <= 7; i++)
+        sim_check_segment(i);
+    SIM_CHECK(-1 == TS_live_get_segment_size(8));
+    SIM_CHECK(!sim_exists("live_3.ts") && !sim_exists("live_0.ts") && sim_exists("live_4.ts"));
+    SIM_CHECK(TS_live_get_playlist(m3u8, sizeof (m3u8)) > 0);
+    SIM_CHECK(0 == strcmp(m3u8, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:3\n#EXT-X-MEDIA-SEQUENCE:5\n"
+                                "#EXTINF:3.000,\nlive_5.ts\n#EXTINF:3.000,\nlive_6.ts\n#EXTINF:3.000,\nlive_7.ts\n"));
+    SIM_CHECK(sim_read_file("live.m3u8", file, sizeof (file)) > 0 && 0 == strcmp(file, m3u8));
+
+    /*读取越界、不存在的分片、缓存不够放 m3u8*/
+    SIM_CHECK(0 == TS_live_read_segment(7, file, 100, TS_live_get_segment_size(7)));
+    SIM_CHECK(-1 == TS_live_read_segment(100, file, 100, 0));
+    SIM_CHECK(-1 == TS_live_get_playlist(file, 16));
+    SIM_CHECK(0 == live_ctx.drop_frames - 3);
+
+    TS_live_exit();
+    SIM_CHECK(-1 == TS_live_get_segment_size(7));
+}
+
+/*分片缓存不够：丢到下一个关键帧，并在那里提前切片（不到目标时长）*/
+static void sim_overflow_case(void)
+{
+    static unsigned char big[20000];
+    unsigned char buf[4096];
+    char m3u8[TS_LIVE_M3U8_BUF_SIZE];
+    int len;
+
+    sim_init(2, 16 * 1024, NULL);
+    len = sim_video_frame(buf, 1, SIM_T0);
+    SIM_CHECK(0 == TS_live_put_video(buf, len, 1, SIM_T0));
+    memset(big, 0, sizeof (big));
+    big[3] = 1;
+    SIM_CHECK(0 == TS_live_put_video(big, sizeof (big), 0, SIM_T0 + 100));
+    SIM_CHECK(1 == live_ctx.wait_idr && 1 == live_ctx.drop_frames);
+    len = sim_video_frame(buf, 0, SIM_T0 + 200);
+    SIM_CHECK(0 == TS_live_put_video(buf, len, 0, SIM_T0 + 200));
+    SIM_CHECK(2 == live_ctx.drop_frames && -1 == TS_live_get_segment_size(0));
+
+    len = sim_video_frame(buf, 1, SIM_T0 + 500);
+    SIM_CHECK(0 == TS_live_put_video(buf, len, 1, SIM_T0 + 500));
+    SIM_CHECK(0 == live_ctx.wait_idr && TS_live_get_segment_size(0) > 0);
+    SIM_CHECK(TS_live_get_playlist(m3u8, sizeof (m3u8)) > 0 && strstr(m3u8, "#EXTINF:0.500,\nlive_0.ts\n") != NULL);
+    TS_live_exit();
+}
+
+/*---模拟编码模块（hls_live 使用）----------------------------------------------*/
+static pthread_mutex_t sim_enc_lock = PTHREAD_MUTEX_INITIALIZER;
+static ENC_STREAM_PACK sim_pack[SIM_QUEUE_SIZE];
+static unsigned char *sim_pack_buf[SIM_QUEUE_SIZE];
+static int sim_head, sim_tail;
+static int sim_released;
+static int sim_freed;
+static int sim_after_free;                  //释放队列之后还访问队列的次数
+static int sim_free_with_notify;            //释放队列时回调还没有取消
+static void (*sim_notify)(void *arg);
+static void *sim_notify_arg;
+
+int encoder_request_stream(int channel, int stream_index, int auto_rc)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_freed = 0;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return SIM_STREAM_ID;
+}
+
+int encoder_free_stream(int stream_id)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    SIM_CHECK(SIM_STREAM_ID == stream_id);
+    sim_freed++;
+    if (sim_notify)
+        sim_free_with_notify++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+ENC_STREAM_PACK *encoder_try_get_packet(int stream_id)
+{
+    ENC_STREAM_PACK *pack = NULL;
+
+    pthread_mutex_lock(&sim_enc_lock);
+    if (sim_freed)
+        sim_after_free++;
+    else if (sim_tail != sim_head)
+        pack = &sim_pack[sim_tail++ % SIM_QUEUE_SIZE];
+    pthread_mutex_unlock(&sim_enc_lock);
+    return pack;
+}
+
+ENC_STREAM_PACK *encoder_get_packet(int stream_id)
+{
+    printf("encoder_get_packet blocks until the next frame, hls_live must not use it\n");
+    sim_errors++;
+    return NULL;
+}
+
+int encoder_release_packet(ENC_STREAM_PACK *pack)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_released++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+int encoder_set_packet_notify(int stream_id, void (*notify)(void *arg), void *arg)
+{
+    pthread_mutex_lock(&sim_enc_lock);
+    sim_notify = notify;
+    sim_notify_arg = arg;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return 0;
+}
+
+/*编码线程：放入一帧，队列由空变为非空时通知*/
+static void sim_enc_push(int key, unsigned long long pts)
+{
+    void (*notify)(void *arg) = NULL;
+    void *arg = NULL;
+    unsigned char *buf;
+    int info = key ? sizeof (IFRAME_INFO) : sizeof (PFRAME_INFO);
+    int len;
+
+    pthread_mutex_lock(&sim_enc_lock);
+    buf = sim_pack_buf[sim_head % SIM_QUEUE_SIZE];
+    len = sim_video_frame(buf + sizeof (FRAME_HDR) + info, key, pts);
+    memset(buf, 0, sizeof (FRAME_HDR) + info);
+    buf[2] = 1;
+    buf[3] = key ? 0xF8 : 0xF9;
+    if (key)
+        ((IFRAME_INFO *)(buf + sizeof (FRAME_HDR)))->pts_msec = pts;
+    else
+        ((PFRAME_INFO *)(buf + sizeof (FRAME_HDR)))->pts_msec = pts;
+    sim_pack[sim_head % SIM_QUEUE_SIZE].data = buf;
+    sim_pack[sim_head % SIM_QUEUE_SIZE].length = sizeof (FRAME_HDR) + info + len;
+    if (sim_head == sim_tail)
+    {
+        notify = sim_notify;
+        arg = sim_notify_arg;
+    }
+    sim_head++;
+    pthread_mutex_unlock(&sim_enc_lock);
+    if (notify)
+        notify(arg);
+}
+
+static int sim_enc_get(int *value)
+{
+    int v;
+    pthread_mutex_lock(&sim_enc_lock);
+    v = *value;
+    pthread_mutex_unlock(&sim_enc_lock);
+    return v;
+}
+
+static double sim_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*发布线程：通知驱动取帧切片；停止时不等下一帧，线程退出后才释放队列*/
+static void sim_hls_live_case(void)
+{
+    unsigned long long pts;
+    double t;
+    int i, pushed = 0;
+
+    for (i = 0; i < SIM_QUEUE_SIZE; i++)
+        sim_pack_buf[i] = (unsigned char *)malloc(sizeof (FRAME_HDR) + sizeof (IFRAME_INFO) + 4096);
+
+    SIM_CHECK(0 == hls_live_start(0, NULL));
+    SIM_CHECK(1 == hls_live_is_running() && HLE_RET_EBUSY == hls_live_start(0, NULL));
+    SIM_CHECK(NULL != sim_notify);
+
+    /*分几批送，每批都等发布线程取完（编码线程每次都是由空变为非空时通知）*/
+    for (pts = SIM_T0; pts <= SIM_T0 + SIM_SEG_MS; pts += SIM_FRAME_MS)
+    {
+        sim_enc_push(0 == (pts - SIM_T0) % SIM_GOP_MS, pts);
+        pushed++;
+        if (0 == pushed % 8)
+            SIM_WAIT(pushed == sim_enc_get(&sim_released));
+    }
+    SIM_WAIT(pushed == sim_enc_get(&sim_released));
+    SIM_CHECK(pushed == sim_enc_get(&sim_released));
+    SIM_CHECK(TS_live_get_segment_size(0) > 0);
+
+    /*队列为空，发布线程在等通知：停止立即返回*/
+    usleep(20 * 1000);
+    t = sim_now();
+    hls_live_stop();
+    t = sim_now() - t;
+    SIM_CHECK(t < HLS_LIVE_WAIT_MS / 1000.0);
+    SIM_CHECK(0 == hls_live_is_running());
+    SIM_CHECK(1 == sim_enc_get(&sim_freed) && 0 == sim_enc_get(&sim_free_with_notify));
+    SIM_CHECK(0 == sim_enc_get(&sim_after_free));
+    SIM_CHECK(-1 == hls_live_ctx.stream_id && 0 == live_ctx.init_done);
+    printf("hls_live: %d frames, stop took %.1f ms\n", pushed, t * 1000);
+
+    /*停止后可以再启动；立即停止（线程可能还没开始取帧）*/
+    SIM_CHECK(0 == hls_live_start(0, NULL));
+    hls_live_stop();
+    SIM_CHECK(0 == sim_enc_get(&sim_after_free) && 0 == sim_enc_get(&sim_free_with_notify));
+    hls_live_stop();
+
+    for (i = 0; i < SIM_QUEUE_SIZE; i++)
+        free(sim_pack_buf[i]);
+}
+
+int main(void)
+{
+    ts_live_init_t init;
+    char path[128];
+    int i;
+
+    /*参数检查*/
+    memset(&init, 0, sizeof (init));
+    init.target_duration = 2;
+    init.segment_buf_size = SIM_SEG_BUF;
+    SIM_CHECK(TS_live_init(NULL) < 0);
+    init.window_size = 0;
+    SIM_CHECK(TS_live_init(&init) < 0);
+    init.window_size = TS_LIVE_MAX_WINDOW + 1;
+    SIM_CHECK(TS_live_init(&init) < 0);
+    init.window_size = 3;
+    SIM_CHECK(0 == TS_live_init(&init) && TS_live_init(&init) < 0);
+    TS_live_exit();
+
+    strcpy(sim_dir, "/tmp/test_ts_live_XXXXXX");
+    SIM_CHECK(NULL != mkdtemp(sim_dir));
+
+    sim_segment_case();
+    sim_overflow_case();
+    sim_hls_live_case();
+
+    /*清理输出目录*/
+    for (i = 0; i < 16; i++)
+    {
+        snprintf(path, sizeof (path), "%s/live_%d.ts", sim_dir, i);
+        unlink(path);
+    }
+    sim_path(path, sizeof (path), "live.m3u8");
+    unlink(path);
+    SIM_CHECK(0 == rmdir(sim_dir));
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+/***************************************************************************
+* @file: test_upload_sched.c
+* @author:
+* @date:  10,19,2026
+* @brief:  上传调度器的主机测试：按字节数准入、挤掉低优先级、阻塞入队（背压）和不阻塞入队（丢最旧）
+* @attention:直接包含 upload_sched.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "upload_sched.c"
+
+#define SIM_FILE_SIZE   (1024*1024)     //每个文件 1MB，队列最多放 4 个
+
+static int sim_errors;
+static char sim_dropped[1024];          //被丢弃的文件名，按顺序用空格分开
+
+#define SIM_CHECK(cond) do { if (!(cond)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #cond); sim_errors++; } } while (0)
+
+/*upload_sched.c 只在 mode 3 时调用，测试只用 mode 2*/
+void upload_stream_release(upload_stream_t* s)
+{
+}
+
+static void sim_drop(put_file_info_t *info, const char *reason)
+{
+    strcat(sim_dropped, info->file_name);
+    strcat(sim_dropped, " ");
+}
+
+static int sim_push(const char *name, int file_type, int nowait)
+{
+    put_file_info_t info;
+
+    memset(&info, 0, sizeof (info));
+    info.mode = 2;
+    info.file_type = file_type;
+    info.ts_flag = file_type == TYPE_JPG ? TS_FLAG_JPG : TS_FLAG_START;
+    info.file_buf = (char *)malloc(SIM_FILE_SIZE);
+    info.file_buf_len = SIM_FILE_SIZE;
+    snprintf(info.file_name, sizeof (info.file_name), "%s", name);
+    return nowait ? upload_sched_push_nowait(&info) : upload_sched_push(&info);
+}
+
+/*取出所有节点，返回文件名（按出队顺序）*/
+static void sim_pop_all(char *names, int size)
+{
+    put_file_info_t info;
+    int prio;
+
+    names[0] = '\0';
+    while (g_sched.num > 0 && 0 == upload_sched_pop(&info, &prio))
+    {
+        snprintf(names + strlen(names), size - strlen(names), "%s ", info.file_name);
+        free(info.file_buf);
+        upload_sched_done(prio);
+    }
+}
+
+static double sim_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*上传线程：200ms 之后取走一个节点*/
+static void *sim_worker(void *arg)
+{
+    put_file_info_t info;
+    int prio;
+
+    usleep(200 * 1000);
+    if (0 == upload_sched_pop(&info, &prio))
+    {
+        free(info.file_buf);
+        upload_sched_done(prio);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    char names[256];
+    pthread_t tid;
+    double t0;
+
+    SIM_CHECK(0 == upload_sched_init(sim_drop));
+
+    /*1.不阻塞入队：同优先级放不下时立即丢掉最旧的录像*/
+    SIM_CHECK(0 == sim_push("c1", TYPE_TS, 1));
+    SIM_CHECK(0 == sim_push("c2", TYPE_TS, 1));
+    SIM_CHECK(0 == sim_push("c3", TYPE_TS, 1));
+    SIM_CHECK(0 == sim_push("c4", TYPE_TS, 1));
+    t0 = sim_now_ms();
+    SIM_CHECK(0 == sim_push("c5", TYPE_TS, 1));
+    SIM_CHECK(sim_now_ms() - t0 < 100);
+    SIM_CHECK(0 == strcmp(sim_dropped, "c1 "));
+
+    /*2.高优先级的图片挤掉最旧的录像，并且先出队*/
+    SIM_CHECK(0 == sim_push("j1", TYPE_JPG, 1));
+    SIM_CHECK(0 == strcmp(sim_dropped, "c1 c2 "));
+    sim_pop_all(names, sizeof (names));
+    SIM_CHECK(0 == strcmp(names, "j1 c3 c4 c5 "));
+    SIM_CHECK(0 == g_sched.bytes);
+
+    /*3.队列中全是更高优先级的图片：不阻塞入队立即拒绝新的录像*/
+    sim_dropped[0] = '\0';
+    SIM_CHECK(0 == sim_push("j1", TYPE_JPG, 0));
+    SIM_CHECK(0 == sim_push("j2", TYPE_JPG, 0));
+    SIM_CHECK(0 == sim_push("j3", TYPE_JPG, 0));
+    SIM_CHECK(0 == sim_push("j4", TYPE_JPG, 0));
+    t0 = sim_now_ms();
+    SIM_CHECK(sim_push("c6", TYPE_TS, 1) < 0);
+    SIM_CHECK(sim_now_ms() - t0 < 100);
+    SIM_CHECK(0 == strcmp(sim_dropped, "c6 "));
+
+    /*4.阻塞入队：等上传线程取走一个节点后放入，不丢弃*/
+    pthread_create(&tid, NULL, sim_worker, NULL);
+    t0 = sim_now_ms();
+    SIM_CHECK(0 == sim_push("c7", TYPE_TS, 0));
+    t0 = sim_now_ms() - t0;
+    pthread_join(tid, NULL);
+    SIM_CHECK(t0 >= 150 && t0 < UPLOAD_SCHED_WAIT_TIME * 1000);
+    SIM_CHECK(0 == strcmp(sim_dropped, "c6 "));
+    sim_pop_all(names, sizeof (names));
+    SIM_CHECK(0 == strcmp(names, "j2 j3 j4 c7 "));
+    printf("blocking push waited %.0f ms for the worker\n", t0);
+
+    printf("%s\n", sim_errors ? "FAIL" : "PASS");
+    return sim_errors ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+* @file: test_ziku.c
+* @author:
+* @date:  10,19,2026
+* @brief:  OSD 字形缓存的主机基准测试
+* @attention:直接包含 ziku.c，可以访问模块内部的函数和结构；构建和运行见 Makefile
+***************************************************************************/
+#include "ziku.c"
+
+/*
+对三个字库逐秒绘制时间 OSD，比较 逐位展开 / 查表展开 / 字形缓存+增量绘制 三种方式，并逐像素核对结果
+*/
+#include <sys/time.h>
+
+#define BENCH_LOOPS     20000
+#define BENCH_FG        (0x7FFF | 0x8000)
+#define BENCH_BG        0x0000
+
+static long long bench_now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/*原 draw_bmp 的逐位展开*/
+static void bench_draw_bitwise(const OSD_matrix_info_t *info, HLE_U16 *bitmap)
+{
+    int matrix_len = info->bpl * info->height;
+    const HLE_U8 *matrix = info->matrix_data;
+    int i, j;
+
+    for (i = 0; i < matrix_len; i++)
+    {
+        for (j = 0; j < 8; j++)
+            *(bitmap++) = (*matrix & (0x01 << (7 - j))) ? BENCH_FG : BENCH_BG;
+        matrix++;
+    }
+}
+
+static void bench_time_str(unsigned int n, HLE_U8 *str)
+{
+    snprintf((char *)str, 20, "2026-10-19 %02u:%02u:%02u", (n / 3600) % 24, (n / 60) % 60, n % 60);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int res_w[] = {1920, 960, 480};
+    static const int res_h[] = {1080, 544, 272};
+    HLE_U8 str[20];
+    int r, n, fail = 0;
+
+    if (zk_init() < 0)
+        return 1;
+
+    for (r = 0; r < 3; r++)
+    {
+        OSD_matrix_info_t info;
+        OSD_canvas_t canvas;
+        HLE_U16 *ref = NULL;
+        long long t0, t_bit = 0, t_lut = 0, t_canvas = 0;
+        long long drawn = 0;
+        int mismatch = 0;
+
+        memset(&canvas, 0, sizeof(canvas));
+        for (n = 0; n < BENCH_LOOPS; n++)
+        {
+            bench_time_str(n, str);
+
+            t0 = bench_now_us();
+            if (str2matrix_vector(str, &info, res_w[r], res_h[r]) < 0)
+                return 1;
+            if (ref == NULL)
+                ref = malloc(info.width * info.height * sizeof(HLE_U16));
+            bench_draw_bitwise(&info, ref);
+            free(info.matrix_data);
+            t_bit += bench_now_us() - t0;
+
+            t0 = bench_now_us();
+            if (str2matrix_vector(str, &info, res_w[r], res_h[r]) < 0)
+                return 1;
+            zk_expand_bits(ref, info.matrix_data, info.bpl * info.height, BENCH_FG, BENCH_BG);
+            free(info.matrix_data);
+            t_lut += bench_now_us() - t0;
+
+            t0 = bench_now_us();
+            int ret = zk_canvas_render(&canvas, str, res_w[r], res_h[r], BENCH_FG, BENCH_BG);
+            t_canvas += bench_now_us() - t0;
+            if (ret < 0)
+                return 1;
+            drawn += ret;
+
+            if (canvas.width != info.width || canvas.height != info.height
+                || memcmp(canvas.bmp, ref, info.width * info.height * sizeof(HLE_U16)) != 0)
+                mismatch++;
+        }
+
+        printf("font w%d: osd %dx%d, %d frames, per frame: bitwise %.2f us, lut %.2f us, "
+               "atlas+diff %.2f us (%.2f cells), mismatch %d\n",
+               res_w[r], canvas.width, canvas.height, BENCH_LOOPS,
+               (double)t_bit / BENCH_LOOPS, (double)t_lut / BENCH_LOOPS,
+               (double)t_canvas / BENCH_LOOPS, (double)drawn / BENCH_LOOPS, mismatch);
+        fail += mismatch;
+
+        free(ref);
+        zk_canvas_release(&canvas);
+    }
+
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    return fail ? 1 : 0;
+}